@@ -24,7 +24,8 @@
 **	Entry Routines
 */
 /*
-DTSError	LoadImage( CLImage * image, DTSKeyFile * file, int nColr, const uchar * custColrs );
+DTSError	LoadImage( CLImage * image, DTSKeyFile * file, int nColr, const uchar * custColrs,
+				bool bKnownGood );
 DTSError	TaggedReadAlloc( DTSKeyFile *, DTSKeyType, DTSKeyID, void *&, const char * );
  
 DTSColor	GetCLColor( uint8_t idx );
@@ -144,10 +145,12 @@ static const uint32_t *	gD2CPixelTable;
 **	LoadImage()
 **
 **	load a compressed image from the key file
+**	bKnownGood skips the checksum, for images the caller has already verified
 */
 DTSError
 LoadImage( CLImage * image, DTSKeyFile * file,
-			int numColors /* = 0 */, const uchar * customColors /* = nullptr */ )
+			int numColors /* = 0 */, const uchar * customColors /* = nullptr */,
+			bool bKnownGood /* = false */ )
 {
 	BitsDef * bits = nullptr;
 	uchar colors[ 256 ];
@@ -191,7 +194,8 @@ LoadImage( CLImage * image, DTSKeyFile * file,
 		}
 	
 	// verify the checksum
-	if ( not (image->cliPictDef.pdFlags & kPictDefFlagNoChecksum) )
+	if ( not bKnownGood
+	&&   not (image->cliPictDef.pdFlags & kPictDefFlagNoChecksum) )
 		{
 		uint32_t sum;
 		if ( noErr == result )
@@ -692,6 +692,10 @@ public:
 	DTSError	CalculateChecksum( DTSKeyFile * file, uint32_t * sum );
 	DTSError	CalculateChecksum( DTSKeyFile * file, const void * bits,
 									const void * colors, const void * light, uint32_t * sum );
+	static uint32_t	ChecksumRecords( DTSKeyID id, const PictDef& pd,
+									const void * bits, size_t bitsLen,
+									const void * colors, size_t colorsLen,
+									const void * light );
 	bool		HasLightingData() const
 		{
 		// return 'true' if there's any significant lighting data
@@ -988,7 +992,7 @@ private:
 #if ! CL_SERVER
 // ImageComp_cl.cp
 DTSError	LoadImage( CLImage * image, DTSKeyFile * file, int numColors = 0,
-					   const uchar * customColors = nullptr );
+					   const uchar * customColors = nullptr, bool bKnownGood = false );
 
 DTSColor	GetCLColor( uint8_t idx );
 const RGBColor8 *	GetCLColorTable();
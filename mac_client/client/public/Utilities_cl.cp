@@ -23,6 +23,14 @@
 #include "DatabaseTypes_cl.h"
 #include "Public_cl.h"
 
+#if defined( __SSE2__ )
+# include <emmintrin.h>
+# define CHECKSUM_SSE2		1
+#elif defined( __ARM_NEON__ ) || defined( __ARM_NEON )
+# include <arm_neon.h>
+# define CHECKSUM_NEON		1
+#endif
+
 using std::snprintf;
 using std::vsnprintf;
 using std::memcpy;
@@ -677,24 +685,132 @@ SafeString::Read( DTSKeyFile * file, DTSKeyType aType, DTSKeyID id )
 // FIXME: Rethink endianness issues here
 
 #if ! CL_SERVER
+/*
+**	adler32 constants
+*/
+const uint32_t	kAdlerBase		= 65521;	// must be prime
+const size_t	kAdlerMaxRun	= 5552;		// the most bytes we can sum before s2 could
+											// overflow 32 bits (zlib's NMAX)
+											
+											
+#if CHECKSUM_SSE2
+/*
+**	HorizontalSum()
+**
+**	add up the four 32-bit lanes
+*/
+static inline uint32_t
+HorizontalSum( __m128i v )
+{
+	v = _mm_add_epi32( v, _mm_shuffle_epi32( v, _MM_SHUFFLE( 1, 0, 3, 2 ) ) );
+	v = _mm_add_epi32( v, _mm_shuffle_epi32( v, _MM_SHUFFLE( 2, 3, 0, 1 ) ) );
+	return static_cast<uint32_t>( _mm_cvtsi128_si32( v ) );
+}
+#endif	// CHECKSUM_SSE2
+
+
+#if CHECKSUM_SSE2 || CHECKSUM_NEON
+/*
+**	DoChecksumBlocks()
+**
+**	add 16-byte blocks to the unreduced sums, without any modulo;
+**	the caller keeps the run short enough that nothing overflows.
+**	Over one block, s1 gains the sum of the bytes, and s2 gains 16 times the old s1
+**	plus each byte weighted by how many of the 16 partial sums it appears in
+*/
+static void
+DoChecksumBlocks( const uchar * p, size_t blocks, uint32_t& ioS1, uint32_t& ioS2 )
+{
+	uint64_t sum1, prior, sum2;
+	
+# if CHECKSUM_SSE2
+	const __m128i zero   = _mm_setzero_si128();
+	const __m128i tapsLo = _mm_setr_epi16( 16, 15, 14, 13, 12, 11, 10, 9 );
+	const __m128i tapsHi = _mm_setr_epi16(  8,  7,  6,  5,  4,  3,  2, 1 );
+	__m128i vS1 = zero;			// byte sums (in lanes 0 and 2)
+	__m128i vPrior = zero;		// vS1 as it stood before each block
+	__m128i vS2 = zero;			// weighted byte sums
+	for ( size_t n = 0; n < blocks; ++n, p += 16 )
+		{
+		__m128i bytes = _mm_loadu_si128( reinterpret_cast<const __m128i *>( p ) );
+		vPrior = _mm_add_epi32( vPrior, vS1 );
+		vS1 = _mm_add_epi32( vS1, _mm_sad_epu8( bytes, zero ) );
+		vS2 = _mm_add_epi32( vS2,
+				_mm_madd_epi16( _mm_unpacklo_epi8( bytes, zero ), tapsLo ) );
+		vS2 = _mm_add_epi32( vS2,
+				_mm_madd_epi16( _mm_unpackhi_epi8( bytes, zero ), tapsHi ) );
+		}
+	sum1  = HorizontalSum( vS1 );
+	prior = HorizontalSum( vPrior );
+	sum2  = HorizontalSum( vS2 );
+# else
+	static const uint8_t kTapsLo[ 8 ] = { 16, 15, 14, 13, 12, 11, 10, 9 };
+	static const uint8_t kTapsHi[ 8 ] = {  8,  7,  6,  5,  4,  3,  2, 1 };
+	const uint8x8_t tapsLo = vld1_u8( kTapsLo );
+	const uint8x8_t tapsHi = vld1_u8( kTapsHi );
+	uint32x4_t vS1 = vdupq_n_u32( 0 );
+	uint32x4_t vPrior = vdupq_n_u32( 0 );
+	uint32x4_t vS2 = vdupq_n_u32( 0 );
+	for ( size_t n = 0; n < blocks; ++n, p += 16 )
+		{
+		uint8x16_t bytes = vld1q_u8( p );
+		vPrior = vaddq_u32( vPrior, vS1 );
+		vS1 = vpadalq_u16( vS1, vpaddlq_u8( bytes ) );
+		vS2 = vpadalq_u16( vS2, vmull_u8( vget_low_u8( bytes ), tapsLo ) );
+		vS2 = vpadalq_u16( vS2, vmull_u8( vget_high_u8( bytes ), tapsHi ) );
+		}
+	sum1  = uint64_t( vgetq_lane_u32( vS1, 0 ) ) + vgetq_lane_u32( vS1, 1 )
+		  + vgetq_lane_u32( vS1, 2 ) + vgetq_lane_u32( vS1, 3 );
+	prior = uint64_t( vgetq_lane_u32( vPrior, 0 ) ) + vgetq_lane_u32( vPrior, 1 )
+		  + vgetq_lane_u32( vPrior, 2 ) + vgetq_lane_u32( vPrior, 3 );
+	sum2  = uint64_t( vgetq_lane_u32( vS2, 0 ) ) + vgetq_lane_u32( vS2, 1 )
+		  + vgetq_lane_u32( vS2, 2 ) + vgetq_lane_u32( vS2, 3 );
+# endif	// CHECKSUM_NEON
+	
+	ioS2 = static_cast<uint32_t>( ioS2 + uint64_t( ioS1 ) * ( blocks << 4 )
+						+ ( prior << 4 ) + sum2 );
+	ioS1 = static_cast<uint32_t>( ioS1 + sum1 );
+}
+#endif	// CHECKSUM_SSE2 || CHECKSUM_NEON
+
+
 /*
 **	DoChecksum()
 **
 **	perform the adler32 calculation (well, approximately)
+**	the modulo is put off until kAdlerMaxRun bytes have gone by, and whole 16-byte
+**	blocks are summed with SSE2 or NEON where we have them; the answer is the
+**	same as reducing after every byte
 */
 static void
 DoChecksum( const void * ptr, size_t len, uint32_t& ioS1, uint32_t& ioS2 )
 {
-	const uint32_t BASE = 65521;	// must be prime
-	
 	const uchar * p = static_cast<const uchar *>( ptr );
 	uint32_t s1 = ioS1;
 	uint32_t s2 = ioS2;
 	
-	for ( const uchar * end = p + len;  p < end;  ++p )
+	while ( len > 0 )
 		{
-		s1 = (s1 + *p) % BASE;
-		s2 = (s2 + s1) % BASE;
+		size_t run = ( len < kAdlerMaxRun ) ? len : kAdlerMaxRun;
+		len -= run;
+		
+#if CHECKSUM_SSE2 || CHECKSUM_NEON
+		if ( size_t blocks = run >> 4 )
+			{
+			DoChecksumBlocks( p, blocks, s1, s2 );
+			p   += blocks << 4;
+			run &= 15;
+			}
+#endif	// CHECKSUM_SSE2 || CHECKSUM_NEON
+		
+		for ( const uchar * end = p + run;  p < end;  ++p )
+			{
+			s1 += *p;
+			s2 += s1;
+			}
+		
+		s1 %= kAdlerBase;
+		s2 %= kAdlerBase;
 		}
 	
 	ioS1 = s1;
@@ -781,13 +897,9 @@ CLImage::CalculateChecksum( DTSKeyFile * file,
 			const void * ilInfo,
 			uint32_t * sum )
 {
-	size_t len;
+	size_t bitsLen, colorsLen;
 	*sum = 0;
 	
-	// adler32 checksum accumulators: s1 is sum of bytes, s2 is sum of sums
-	uint32_t s1 = 1;		// ensures that checksum depends on length of sequence
-	uint32_t s2 = 0;
-	
 	if ( not bits
 	||	 not colors
 //	||	 not ilInfo	// NULL light data just means "don't checksum it"
@@ -796,80 +908,99 @@ CLImage::CalculateChecksum( DTSKeyFile * file,
 		return -1;
 		}
 	
-	DTSError result = file->GetSize( kTypePictureBits, cliPictDef.pdBitsID, &len );
+	DTSError result = file->GetSize( kTypePictureBits, cliPictDef.pdBitsID, &bitsLen );
+	if ( noErr == result )
+		result = file->GetSize( kTypePictureColors, cliPictDef.pdColorsID, &colorsLen );
+	
 	if ( noErr == result )
 		{
-		// bits
-		DoChecksum( bits, len, s1, s2 );
-		result = file->GetSize( kTypePictureColors, cliPictDef.pdColorsID, &len );
+		*sum = ChecksumRecords( cliPictDefID, cliPictDef, bits, bitsLen,
+					colors, colorsLen, ilInfo );
 		}
 	
-	if ( noErr == result )
+	return result;
+}
+
+
+/*
+**	CLImage::ChecksumRecords()
+**
+**	the arithmetic behind CalculateChecksum(), given the records and their sizes.
+**	It touches no file and no CLImage, so it is safe to call from any thread.
+*/
+uint32_t
+CLImage::ChecksumRecords( DTSKeyID id, const PictDef& pd,
+			const void * bits, size_t bitsLen,
+			const void * colors, size_t colorsLen,
+			const void * ilInfo )
+{
+	// adler32 checksum accumulators: s1 is sum of bytes, s2 is sum of sums
+	uint32_t s1 = 1;		// ensures that checksum depends on length of sequence
+	uint32_t s2 = 0;
+	
+	// bits
+	DoChecksum( bits, bitsLen, s1, s2 );
+	
+	// colors
+	DoChecksum( colors, colorsLen, s1, s2 );
+	
+	// lighting info
+	if ( ilInfo )
 		{
-		// colors
-		DoChecksum( colors, len, s1, s2 );
-		
-		// lighting info
-		if ( ilInfo )
-			{
 #if DTS_BIG_ENDIAN
-			DoChecksum( ilInfo, sizeof(LightingData), s1, s2 );
+		DoChecksum( ilInfo, sizeof(LightingData), s1, s2 );
 #else
-			LightingData ldTmp = * static_cast<const LightingData *>( ilInfo );
-			BigToNativeEndian( &ldTmp );
-			
-			DoChecksum( &ldTmp, sizeof ldTmp, s1, s2 );
-#endif
-			}
+		LightingData ldTmp = * static_cast<const LightingData *>( ilInfo );
+		BigToNativeEndian( &ldTmp );
 		
-		// PictDef
-		// but not the checksum itself, nor the irrelevant animation frames.
-		//
-		// It's kind of regrettable that the sum is defined to include the
-		// bitsID, colorsID, and lightingID fields; if those were ignored
-		// then the checksum for any arbitrary picture would be constant:
-		// it would not vary even if the picture's bits or colors records should
-		// ever happen to receive new DTSKeyIDs. For example, in the CLEditor,
-		// if you copy and paste/replace an image on top of itself, its
-		// colors, bits, & lighting may well be stored under new KeyIDs
-		// (thanks to the simple-mindedness of DTSKeyFile::GetUnusedID()),
-		// which means that the otherwise identical image will nonetheless be
-		// given an entirely new checksum value.
-		
-		len = offsetof( PictDef, pdAnimFrameTable )
-				 + cliPictDef.pdNumAnims * sizeof cliPictDef.pdAnimFrameTable[0];
+		DoChecksum( &ldTmp, sizeof ldTmp, s1, s2 );
+#endif
+		}
+	
+	// PictDef
+	// but not the checksum itself, nor the irrelevant animation frames.
+	//
+	// It's kind of regrettable that the sum is defined to include the
+	// bitsID, colorsID, and lightingID fields; if those were ignored
+	// then the checksum for any arbitrary picture would be constant:
+	// it would not vary even if the picture's bits or colors records should
+	// ever happen to receive new DTSKeyIDs. For example, in the CLEditor,
+	// if you copy and paste/replace an image on top of itself, its
+	// colors, bits, & lighting may well be stored under new KeyIDs
+	// (thanks to the simple-mindedness of DTSKeyFile::GetUnusedID()),
+	// which means that the otherwise identical image will nonetheless be
+	// given an entirely new checksum value.
+	
+	size_t len = offsetof( PictDef, pdAnimFrameTable )
+				 + pd.pdNumAnims * sizeof pd.pdAnimFrameTable[0];
+	PictDef tempPD = pd;
 #if DTS_BIG_ENDIAN
-		uint32_t savesum = cliPictDef.pdChecksum;
-		cliPictDef.pdChecksum = 0;
-		DoChecksum( &cliPictDef, len, s1, s2 );
-		cliPictDef.pdChecksum = savesum;
-		
-		// image ID, so people can't just copy one from elsewhere in the file
-		DoChecksum( &cliPictDefID, sizeof cliPictDefID, s1, s2 );
+	tempPD.pdChecksum = 0;
+	DoChecksum( &tempPD, len, s1, s2 );
+	
+	// image ID, so people can't just copy one from elsewhere in the file
+	DoChecksum( &id, sizeof id, s1, s2 );
 #else
-		// must byteswap this PictDef back to BE before summing it
-		PictDef tempPD = cliPictDef;
-		NativeToBigEndian( &tempPD );
-		tempPD.pdChecksum = 0;
-		DoChecksum( &tempPD, len, s1, s2 );
-		
-		// image ID, so people can't just copy one from elsewhere in the file
-		DTSKeyID tempID = NativeToBigEndian( cliPictDefID );
-		DoChecksum( &tempID, sizeof tempID, s1, s2 );
+	// must byteswap this PictDef back to BE before summing it
+	NativeToBigEndian( &tempPD );
+	tempPD.pdChecksum = 0;
+	DoChecksum( &tempPD, len, s1, s2 );
+	
+	// image ID, so people can't just copy one from elsewhere in the file
+	DTSKeyID tempID = NativeToBigEndian( id );
+	DoChecksum( &tempID, sizeof tempID, s1, s2 );
 #endif  // ! DTS_BIG_ENDIAN
-		
+
 #if DTS_BIG_ENDIAN
-		*sum = static_cast<uint32_t>( (s2 << 16) + (s1 & 0x0FFFF) );
-		SimpleEncrypt( sum, sizeof *sum );
+	uint32_t sum = static_cast<uint32_t>( (s2 << 16) + (s1 & 0x0FFFF) );
+	SimpleEncrypt( &sum, sizeof sum );
+	return sum;
 #else
-		uint32_t tsum = NativeToBigEndian( static_cast<uint32_t>(
-							(s2 << 16) + (s1 & 0x0FFFF) ) );
-		SimpleEncrypt( &tsum, sizeof tsum );
-		*sum = BigToNativeEndian( tsum );
+	uint32_t tsum = NativeToBigEndian( static_cast<uint32_t>(
+						(s2 << 16) + (s1 & 0x0FFFF) ) );
+	SimpleEncrypt( &tsum, sizeof tsum );
+	return BigToNativeEndian( tsum );
 #endif
-		}
-	
-	return result;
 }
 #endif  // ! CL_SERVER
 
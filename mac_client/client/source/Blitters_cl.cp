@@ -18,6 +18,21 @@
 
 #include "ClanLord.h"
 
+#if defined( __SSE2__ )
+# include <emmintrin.h>
+# define BLIT_SSE2		1
+# if defined( __clang__ ) || ( defined( __GNUC__ ) && __GNUC__ >= 5 )
+#  include <immintrin.h>
+#  define BLIT_AVX2		1		// per function; see HaveAVX2()
+# endif
+#elif defined( __aarch64__ )
+# include <arm_neon.h>
+# define BLIT_NEON		1
+#endif
+#if defined( __APPLE__ )
+# include <sys/sysctl.h>
+#endif
+
 
 /*
 **	Entry Routines
@@ -66,6 +81,352 @@ static ushort *	gBlendRGBTable;
 static uchar *	gBlendInvTable;
 
 
+/*
+**	Row kernels
+**
+**	every blitter here boils down to one of two inner loops:
+**	copy the source pixels selected by a repeating 4-pixel stipple pattern
+**	(optionally skipping transparent, zero, pixels), or find how long a run
+**	of transparent pixels is. InitBlitters() picks the widest implementation
+**	the CPU has; the scalar ones are the reference the others must match.
+**	the quality blenders carry their error-diffusion dither from pixel to
+**	pixel, so they can only borrow the run finder.
+*/
+typedef void	(*MaskedRowProc)( const uchar * src, uchar * dst, int count,
+					const uchar pattern[ 4 ], bool transparent );
+typedef int		(*ZeroRunProc)( const uchar * src, int count );
+
+struct SBlitKernels
+{
+	const char *	bkName;
+	MaskedRowProc	bkMaskedRow;	// copy pattern-selected (nonzero) pixels
+	ZeroRunProc		bkZeroRun;		// count leading zero pixels
+};
+
+
+/*
+**	ScalarMaskedRow()
+**
+**	copy src[i] to dst[i] wherever pattern[ i & 3 ] is set,
+**	and, if transparent, src[i] isn't zero
+*/
+static void
+ScalarMaskedRow( const uchar * src, uchar * dst, int count,
+	const uchar pattern[ 4 ], bool transparent )
+{
+	for ( int i = 0;  i < count;  ++i )
+		{
+		int pixel = src[ i ];
+		if ( pattern[ i & 3 ]
+		&&   ( pixel || not transparent ) )
+			{
+			dst[ i ] = pixel;
+			}
+		}
+}
+
+
+/*
+**	ScalarZeroRun()
+**
+**	how many of the first count pixels are zero
+*/
+static int
+ScalarZeroRun( const uchar * src, int count )
+{
+	int i = 0;
+	while ( i < count && not src[ i ] )
+		++i;
+	return i;
+}
+
+
+#if BLIT_SSE2
+/*
+**	SSE2MaskedRow()
+**
+**	sixteen pixels at a time: a byte compare against zero makes the
+**	transparency mask, and and/andnot/or merge source into destination
+*/
+static void
+SSE2MaskedRow( const uchar * src, uchar * dst, int count,
+	const uchar pattern[ 4 ], bool transparent )
+{
+	uint32_t pattern32;
+	memcpy( &pattern32, pattern, sizeof pattern32 );
+	const __m128i stipple = _mm_set1_epi32( pattern32 );
+	const __m128i zero = _mm_setzero_si128();
+	
+	int i = 0;
+	for ( ;  i + 16 <= count;  i += 16 )
+		{
+		__m128i s = _mm_loadu_si128( reinterpret_cast<const __m128i *>( src + i ) );
+		__m128i * p = reinterpret_cast<__m128i *>( dst + i );
+		__m128i mask = stipple;
+		if ( transparent )
+			mask = _mm_andnot_si128( _mm_cmpeq_epi8( s, zero ), stipple );
+		__m128i d = _mm_loadu_si128( p );
+		_mm_storeu_si128( p,
+			_mm_or_si128( _mm_and_si128( mask, s ), _mm_andnot_si128( mask, d ) ) );
+		}
+	
+	// i is a multiple of 4, so the pattern lines up
+	if ( i < count )
+		ScalarMaskedRow( src + i, dst + i, count - i, pattern, transparent );
+}
+
+
+/*
+**	SSE2ZeroRun()
+*/
+static int
+SSE2ZeroRun( const uchar * src, int count )
+{
+	const __m128i zero = _mm_setzero_si128();
+	int i = 0;
+	for ( ;  i + 16 <= count;  i += 16 )
+		{
+		__m128i s = _mm_loadu_si128( reinterpret_cast<const __m128i *>( src + i ) );
+		uint zeros = _mm_movemask_epi8( _mm_cmpeq_epi8( s, zero ) );
+		if ( zeros != 0xFFFF )
+			return i + __builtin_ctz( ~zeros );
+		}
+	return i + ScalarZeroRun( src + i, count - i );
+}
+#endif  // BLIT_SSE2
+
+
+#if BLIT_AVX2
+/*
+**	AVX2MaskedRow()
+**
+**	same as SSE2MaskedRow(), 32 pixels at a time
+*/
+static void __attribute__(( target( "avx2" ) ))
+AVX2MaskedRow( const uchar * src, uchar * dst, int count,
+	const uchar pattern[ 4 ], bool transparent )
+{
+	uint32_t pattern32;
+	memcpy( &pattern32, pattern, sizeof pattern32 );
+	const __m256i stipple = _mm256_set1_epi32( pattern32 );
+	const __m256i zero = _mm256_setzero_si256();
+	
+	int i = 0;
+	for ( ;  i + 32 <= count;  i += 32 )
+		{
+		__m256i s = _mm256_loadu_si256( reinterpret_cast<const __m256i *>( src + i ) );
+		__m256i * p = reinterpret_cast<__m256i *>( dst + i );
+		__m256i mask = stipple;
+		if ( transparent )
+			mask = _mm256_andnot_si256( _mm256_cmpeq_epi8( s, zero ), stipple );
+		_mm256_storeu_si256( p, _mm256_blendv_epi8( _mm256_loadu_si256( p ), s, mask ) );
+		}
+	
+	if ( i < count )
+		ScalarMaskedRow( src + i, dst + i, count - i, pattern, transparent );
+}
+
+
+/*
+**	AVX2ZeroRun()
+*/
+static int __attribute__(( target( "avx2" ) ))
+AVX2ZeroRun( const uchar * src, int count )
+{
+	const __m256i zero = _mm256_setzero_si256();
+	int i = 0;
+	for ( ;  i + 32 <= count;  i += 32 )
+		{
+		__m256i s = _mm256_loadu_si256( reinterpret_cast<const __m256i *>( src + i ) );
+		uint zeros = _mm256_movemask_epi8( _mm256_cmpeq_epi8( s, zero ) );
+		if ( zeros != 0xFFFFFFFFU )
+			return i + __builtin_ctz( ~zeros );
+		}
+	return i + ScalarZeroRun( src + i, count - i );
+}
+#endif  // BLIT_AVX2
+
+
+#if BLIT_NEON
+/*
+**	NEONMaskedRow()
+**
+**	vtst finds the nonzero pixels, vbsl does the merge
+*/
+static void
+NEONMaskedRow( const uchar * src, uchar * dst, int count,
+	const uchar pattern[ 4 ], bool transparent )
+{
+	uint32_t pattern32;
+	memcpy( &pattern32, pattern, sizeof pattern32 );
+	const uint8x16_t stipple = vreinterpretq_u8_u32( vdupq_n_u32( pattern32 ) );
+	
+	int i = 0;
+	for ( ;  i + 16 <= count;  i += 16 )
+		{
+		uint8x16_t s = vld1q_u8( src + i );
+		uint8x16_t mask = stipple;
+		if ( transparent )
+			mask = vandq_u8( vtstq_u8( s, s ), stipple );
+		vst1q_u8( dst + i, vbslq_u8( mask, s, vld1q_u8( dst + i ) ) );
+		}
+	
+	if ( i < count )
+		ScalarMaskedRow( src + i, dst + i, count - i, pattern, transparent );
+}
+
+
+/*
+**	NEONZeroRun()
+*/
+static int
+NEONZeroRun( const uchar * src, int count )
+{
+	int i = 0;
+	for ( ;  i + 16 <= count;  i += 16 )
+		{
+		if ( vmaxvq_u8( vld1q_u8( src + i ) ) )
+			break;
+		}
+	return i + ScalarZeroRun( src + i, count - i );
+}
+#endif  // BLIT_NEON
+
+
+static const SBlitKernels gScalarKernels	= { "scalar", ScalarMaskedRow, ScalarZeroRun };
+#if BLIT_SSE2
+static const SBlitKernels gSSE2Kernels		= { "SSE2", SSE2MaskedRow, SSE2ZeroRun };
+#endif
+#if BLIT_AVX2
+static const SBlitKernels gAVX2Kernels		= { "AVX2", AVX2MaskedRow, AVX2ZeroRun };
+#endif
+#if BLIT_NEON
+static const SBlitKernels gNEONKernels		= { "NEON", NEONMaskedRow, NEONZeroRun };
+#endif
+
+// the ones InitBlitters() picked
+static const SBlitKernels *	gBlitKernels = &gScalarKernels;
+
+
+/*
+**	HaveAVX2()
+**
+**	does this CPU (and OS) do AVX2?
+*/
+static bool
+HaveAVX2()
+{
+#if BLIT_AVX2
+# if defined( __APPLE__ )
+	int avx2 = 0;
+	size_t size = sizeof avx2;
+	if ( 0 == sysctlbyname( "hw.optional.avx2_0", &avx2, &size, nullptr, 0 ) )
+		return avx2 != 0;
+	return false;
+# else
+	return __builtin_cpu_supports( "avx2" );
+# endif
+#else
+	return false;
+#endif  // BLIT_AVX2
+}
+
+
+/*
+**	GetBlitKernels()
+**
+**	list the kernel sets this CPU can run, scalar first, best last
+*/
+static int
+GetBlitKernels( const SBlitKernels * oKernels[ kBlitBenchmarkKernels ] )
+{
+	int count = 0;
+	oKernels[ count++ ] = &gScalarKernels;
+#if BLIT_SSE2
+	oKernels[ count++ ] = &gSSE2Kernels;
+#endif
+#if BLIT_AVX2
+	if ( HaveAVX2() )
+		oKernels[ count++ ] = &gAVX2Kernels;
+#endif
+#if BLIT_NEON
+	oKernels[ count++ ] = &gNEONKernels;
+#endif
+	return count;
+}
+
+
+/*
+**	BlitMaskedRows()
+**
+**	run the masked-row kernel down a rectangle; the stipple alternates
+**	between two patterns on alternate rows
+*/
+static void
+BlitMaskedRows( const SBlitKernels * kernels,
+	const uchar * srcbits, int srcrowbytes, uchar * dstbits, int dstrowbytes,
+	int width, int height, const uchar patterns[ 2 ][ 4 ], bool transparent )
+{
+	MaskedRowProc proc = kernels->bkMaskedRow;
+	for ( int row = 0;  row < height;  ++row )
+		{
+		proc( srcbits, dstbits, width, patterns[ row & 1 ], transparent );
+		srcbits += srcrowbytes;
+		dstbits += dstrowbytes;
+		}
+}
+
+
+/*
+**	QualityBlendTransparentRows()
+**
+**	the inner loops of the QualityBlitBlendXXTransparent() blitters.
+**	wanted = srcweight/4 of the source color plus the rest of the
+**	destination color, plus the dither left over from the last pixel.
+**	runs of transparent pixels leave the dither alone, so they can be
+**	skipped wholesale. the row offsets are as from BlitClipApparatus().
+*/
+static inline void
+QualityBlendTransparentRows( const SBlitKernels * kernels,
+	const uchar * srcbits, int srcrowbytes, uchar * dstbits, int dstrowbytes,
+	int width, int height, int srcweight )
+{
+	ZeroRunProc zeroRun = kernels->bkZeroRun;
+	const ushort * rgbtable = gBlendRGBTable;
+	const uchar * invtable  = gBlendInvTable;
+	const int dstweight = 4 - srcweight;
+	int dither = kBlendDither;
+	for ( ;  height > 0;  --height )
+		{
+		// for each pixel
+		for ( int diff = width;  diff > 0;  )
+			{
+			int pixel = *srcbits;
+			if ( not pixel )
+				{
+				int run = zeroRun( srcbits, diff );
+				srcbits += run;
+				dstbits += run;
+				diff    -= run;
+				continue;
+				}
+			
+			int wanted = srcweight * rgbtable[ pixel ]
+					   + dstweight * rgbtable[ *dstbits ] + dither;
+			pixel      = invtable[ wanted >> 2 ];
+			*dstbits++ = pixel;
+			dither     = wanted - ( rgbtable[ pixel ] << 2 );
+			++srcbits;
+			--diff;
+			}
+		
+		// offset to next row
+		srcbits += srcrowbytes;
+		dstbits += dstrowbytes;
+		}
+}
+
+
 /*
 **	InitBlitters()
 **
@@ -92,6 +453,10 @@ InitBlitters()
 		++p;
 		}
 #endif  // DTS_LITTLE_ENDIAN
+	
+	// the best of the row kernels this CPU can run
+	const SBlitKernels * kernels[ kBlitBenchmarkKernels ];
+	gBlitKernels = kernels[ GetBlitKernels( kernels ) - 1 ];
 }
 
 
@@ -235,89 +600,11 @@ BlitTransparent( const DTSOffView * view, const DTSImage * srcimage,
 			height, width, srcrowbytes, dstrowbytes, srcbits, dstbits ) )
 		return;
 	
-#if 0
-	{
-		// for each row
-		for ( ;  height > 0;  --height )
-			{
-			// for each pixel
-			BlitTransparentRunB( srcbits, dstbits, width );
-			
-			// offset to next row
-			srcbits += srcrowbytes;
-			dstbits += dstrowbytes;
-			}
-	}
-#else
-	// byte based transparent blitter
-	// manually unroll the loop
-	// and manually schedule instructions.
-	// yeah, yeah i know it looks pretty scary to nest a for loop inside
-	// a switch statement but it works, it's compact, and it's fast
-	// and i think it's perty.
-	// 61 (38) ms
-	{
-		// number of times to loop through the block
-		// including the first partial block.
-		int nloops  = ( width - 1 ) >> 3;
-		
-		// where to start in the first partial block.
-		int start   = 9 - ( width - ( nloops << 3 ) );
-		
-		// modify pointers and offsets as if the first partial
-		// block was a full block.
-		// adjust for the trailing pixel.
-		srcbits     -= start;
-		dstbits     -= start;
-		srcrowbytes -= start - 1;
-		dstrowbytes -= start - 1;
-		
-		// for each row
-		for ( ;  height > 0;  --height )
-			{
-			// initialize the pixel holder
-			uchar pixel0;
-			uchar pixel1;
-			pixel0 = pixel1 = srcbits[start];
-			
-			// switch into the right place for first partial block
-			int count = nloops;
-			switch ( start )
-				{
-				// unroll the loop 8 times.
-				// unrolling more gives marginal improvement.
-				// compilers optimize for loop counters like this easily.
-				for ( ;  count >= 0;  --count )
-					{
-					// interleave the load of the next pixel with the test 
-					// and store of the previous pixel.
-					// interleaving more than two pixels like this gives 
-					// no improvement.
-				        pixel1 = srcbits[ 1]; if ( pixel0 ) dstbits[ 0] = pixel0;
-				case 1: pixel0 = srcbits[ 2]; if ( pixel1 ) dstbits[ 1] = pixel1;
-				case 2: pixel1 = srcbits[ 3]; if ( pixel0 ) dstbits[ 2] = pixel0;
-				case 3: pixel0 = srcbits[ 4]; if ( pixel1 ) dstbits[ 3] = pixel1;
-				case 4: pixel1 = srcbits[ 5]; if ( pixel0 ) dstbits[ 4] = pixel0;
-				case 5: pixel0 = srcbits[ 6]; if ( pixel1 ) dstbits[ 5] = pixel1;
-				case 6: pixel1 = srcbits[ 7]; if ( pixel0 ) dstbits[ 6] = pixel0;
-				case 7: pixel0 = srcbits[ 8]; if ( pixel1 ) dstbits[ 7] = pixel1;
-					
-					// bump the pointers
-				default:
-					srcbits += 8;
-					dstbits += 8;
-					}
-				}
-			
-			// test and store the trailing pixel.
-			if ( pixel0 ) dstbits[ 0] = pixel0;
-			
-			// offset to next row
-			srcbits += srcrowbytes;
-			dstbits += dstrowbytes;
-			}
-	}
-#endif
+	// every pixel, unless it's transparent
+	static const uchar patterns[ 2 ][ 4 ] =
+		{ { 0xFF, 0xFF, 0xFF, 0xFF }, { 0xFF, 0xFF, 0xFF, 0xFF } };
+	BlitMaskedRows( gBlitKernels, srcbits, srcrowbytes + width,
+		dstbits, dstrowbytes + width, width, height, patterns, true );
 
 #if 1
 	} // timing tests
@@ -396,31 +683,8 @@ QualityBlitBlend25Transparent( const DTSOffView * view, const DTSImage * srcimag
 			srcrowbytes, dstrowbytes, srcbits, dstbits ) )
 		return;
 	
-	// for each row
-	const ushort * rgbtable = gBlendRGBTable;
-	const uchar * invtable  = gBlendInvTable;
-	int dither = kBlendDither;
-	for ( ;  height > 0;  --height )
-		{
-		// for each pixel
-		for ( int diff = width;  diff > 0;  --diff )
-			{
-			int pixel = *srcbits++;
-			if ( pixel )
-				{
-				int wanted = rgbtable[ pixel ];
-				wanted  += ( wanted << 1 ) +  rgbtable[ *dstbits ] + dither;
-				pixel    = invtable[ wanted >> 2 ];
-				*dstbits = pixel;
-				dither   = wanted - ( rgbtable[ pixel ] << 2 );
-				}
-			++dstbits;
-			}
-		
-		// offset to next row
-		srcbits += srcrowbytes;
-		dstbits += dstrowbytes;
-		}
+	QualityBlendTransparentRows( gBlitKernels, srcbits, srcrowbytes,
+		dstbits, dstrowbytes, width, height, 3 );
 }
 
 
@@ -494,30 +758,8 @@ QualityBlitBlend50Transparent( const DTSOffView * view, const DTSImage * srcimag
 			srcrowbytes, dstrowbytes, srcbits, dstbits ) )
 		return;
 	
-	// for each row
-	const ushort * rgbtable = gBlendRGBTable;
-	const uchar * invtable  = gBlendInvTable;
-	int dither = kBlendDither;
-	for ( ;  height > 0;  --height )
-		{
-		// for each pixel
-		for ( int diff = width;  diff > 0;  --diff )
-			{
-			int pixel = *srcbits++;
-			if ( pixel )
-				{
-				int wanted = ( ( rgbtable[ pixel ] + rgbtable[ *dstbits ] ) << 1 ) + dither;
-				pixel    = invtable[ wanted >> 2 ];
-				*dstbits = pixel;
-				dither   = wanted - ( rgbtable[ pixel ] << 2 );
-				}
-			++dstbits;
-			}
-		
-		// offset to next row
-		srcbits += srcrowbytes;
-		dstbits += dstrowbytes;
-		}
+	QualityBlendTransparentRows( gBlitKernels, srcbits, srcrowbytes,
+		dstbits, dstrowbytes, width, height, 2 );
 }
 
 
@@ -592,31 +834,8 @@ QualityBlitBlend75Transparent( const DTSOffView * view, const DTSImage * srcimag
 			srcrowbytes, dstrowbytes, srcbits, dstbits ) )
 		return;
 	
-	// for each row
-	const ushort * rgbtable = gBlendRGBTable;
-	const uchar * invtable  = gBlendInvTable;
-	int dither = kBlendDither;
-	for ( ;  height > 0;  --height )
-		{
-		// for each pixel
-		for ( int diff = width;  diff > 0;  --diff )
-			{
-			int pixel = *srcbits++;
-			if ( pixel )
-				{
-				int wanted = rgbtable[ *dstbits ];
-				wanted  += ( wanted << 1 ) +  rgbtable[ pixel ] + dither;
-				pixel    = invtable[ wanted >> 2 ];
-				*dstbits = pixel;
-				dither   = wanted - ( rgbtable[ pixel ] << 2 );
-				}
-			++dstbits;
-			}
-		
-		// offset to next row
-		srcbits += srcrowbytes;
-		dstbits += dstrowbytes;
-		}
+	QualityBlendTransparentRows( gBlitKernels, srcbits, srcrowbytes,
+		dstbits, dstrowbytes, width, height, 1 );
 }
 
 
@@ -808,31 +1027,16 @@ FastBlitBlend25( const DTSOffView * view, const DTSImage * srcimage,
 		+ dstrowbytes * ( dsttop - dstimageBounds.rectTop )
 		+ ( dstleft - dstimageBounds.rectLeft );
 	
-	// change rowbytes to offsets
-	srcrowbytes -= width;
-	dstrowbytes -= width;
-	
-	// for each row
-	for ( ;  height > 0;  --height )
+	// 3 of every 4 pixels, skipping the one at rowinset;
+	// the gap moves over by 2 on alternate rows
+	uchar patterns[ 2 ][ 4 ];
+	for ( int i = 0;  i < 4;  ++i )
 		{
-		// for each pixel
-		int counter = rowinset;
-		for ( diff = width;  diff > 0;  --diff )
-			{
-			if ( counter & 3 )
-				{
-				*dstbits = *srcbits;
-				}
-			++srcbits;
-			++dstbits;
-			--counter;
-			}
-		
-		// offset to next row
-		srcbits += srcrowbytes;
-		dstbits += dstrowbytes;
-		rowinset ^= 2;
+		patterns[ 0 ][ i ] = ( i != rowinset ) ? 0xFF : 0;
+		patterns[ 1 ][ i ] = ( i != ( rowinset ^ 2 ) ) ? 0xFF : 0;
 		}
+	BlitMaskedRows( gBlitKernels, srcbits, srcrowbytes, dstbits, dstrowbytes,
+		width, height, patterns, false );
 }
 
 
@@ -913,33 +1117,16 @@ FastBlitBlend25Transparent( const DTSOffView * view, const DTSImage * srcimage,
 		+ dstrowbytes * ( dsttop - dstimageBounds.rectTop )
 		+ ( dstleft - dstimageBounds.rectLeft );
 	
-	// change rowbytes to offsets
-	srcrowbytes -= width;
-	dstrowbytes -= width;
-	
-	// for each row
-	for ( ;  height > 0;  --height )
+	// 3 of every 4 pixels, skipping the one at rowinset;
+	// the gap moves over by 2 on alternate rows
+	uchar patterns[ 2 ][ 4 ];
+	for ( int i = 0;  i < 4;  ++i )
 		{
-		// for each pixel
-		int counter = rowinset;
-		for ( diff = width;  diff > 0;  --diff )
-			{
-			if ( counter & 3 )
-				{
-				int pixel = *srcbits;
-				if ( pixel )
-					*dstbits = pixel;
-				}
-			++srcbits;
-			++dstbits;
-			--counter;
-			}
-		
-		// offset to next row
-		srcbits += srcrowbytes;
-		dstbits += dstrowbytes;
-		rowinset ^= 2;
+		patterns[ 0 ][ i ] = ( i != rowinset ) ? 0xFF : 0;
+		patterns[ 1 ][ i ] = ( i != ( rowinset ^ 2 ) ) ? 0xFF : 0;
 		}
+	BlitMaskedRows( gBlitKernels, srcbits, srcrowbytes, dstbits, dstrowbytes,
+		width, height, patterns, true );
 }
 
 
@@ -1020,55 +1207,15 @@ FastBlitBlend50( const DTSOffView * view, const DTSImage * srcimage,
 		+ dstrowbytes * ( dsttop - dstimageBounds.rectTop )
 		+ ( dstleft - dstimageBounds.rectLeft );
 	
-	// for each row
-	const uchar * srcrow = srcbits;
-	uchar * dstrow = dstbits;
-	if ( skipoddnumrows )
-		goto oddrow;
-	
-	for(;;)
+	// a checkerboard
+	uchar patterns[ 2 ][ 4 ];
+	for ( int i = 0;  i < 4;  ++i )
 		{
-		// for each pixel
-		for ( diff = width;  diff > 0;  diff -= 2 )
-			{
-			*dstbits = *srcbits;
-			srcbits += 2;
-			dstbits += 2;
-			}
-		
-		// next row
-		--height;
-		if ( height <= 0 )
-			break;
-		
-		// offset to next row
-		srcrow += srcrowbytes;
-		dstrow += dstrowbytes;
-		srcbits = srcrow;
-		dstbits = dstrow;
-oddrow:
-		++srcbits;
-		++dstbits;
-		
-		// for each pixel
-		for ( diff = width - 1;  diff > 0;  diff -= 2 )
-			{
-			*dstbits = *srcbits;
-			srcbits += 2;
-			dstbits += 2;
-			}
-		
-		// next row
-		--height;
-		if ( height <= 0 )
-			break;
-		
-		// offset to next row
-		srcrow += srcrowbytes;
-		dstrow += dstrowbytes;
-		srcbits = srcrow;
-		dstbits = dstrow;
+		patterns[ 0 ][ i ] = ( ( i & 1 ) == skipoddnumrows ) ? 0xFF : 0;
+		patterns[ 1 ][ i ] = ( ( i & 1 ) != skipoddnumrows ) ? 0xFF : 0;
 		}
+	BlitMaskedRows( gBlitKernels, srcbits, srcrowbytes, dstbits, dstrowbytes,
+		width, height, patterns, false );
 }
 
 
@@ -1148,60 +1295,15 @@ FastBlitBlend50Transparent( const DTSOffView * view, const DTSImage * srcimage,
 		+ dstrowbytes * ( dsttop - dstimageBounds.rectTop )
 		+ ( dstleft - dstimageBounds.rectLeft );
 	
-	// for each row
-	const uchar * srcrow = srcbits;
-	uchar * dstrow = dstbits;
-	if ( skipoddnumrows )
-		goto oddrow;
-	
-	for(;;)
+	// a checkerboard
+	uchar patterns[ 2 ][ 4 ];
+	for ( int i = 0;  i < 4;  ++i )
 		{
-		// for each pixel
-		int pixel;
-		for ( diff = width;  diff > 0;  diff -= 2 )
-			{
-			pixel = *srcbits;
-			if ( pixel )
-				*dstbits = pixel;
-			srcbits += 2;
-			dstbits += 2;
-			}
-		
-		// next row
-		--height;
-		if ( height <= 0 )
-			break;
-		
-		// offset to next row
-		srcrow += srcrowbytes;
-		dstrow += dstrowbytes;
-		srcbits = srcrow;
-		dstbits = dstrow;
-oddrow:
-		++srcbits;
-		++dstbits;
-		
-		// for each pixel
-		for ( diff = width - 1;  diff > 0;  diff -= 2 )
-			{
-			pixel = *srcbits;
-			if ( pixel )
-				*dstbits = pixel;
-			srcbits += 2;
-			dstbits += 2;
-			}
-		
-		// next row
-		--height;
-		if ( height <= 0 )
-			break;
-		
-		// offset to next row
-		srcrow += srcrowbytes;
-		dstrow += dstrowbytes;
-		srcbits = srcrow;
-		dstbits = dstrow;
+		patterns[ 0 ][ i ] = ( ( i & 1 ) == skipoddnumrows ) ? 0xFF : 0;
+		patterns[ 1 ][ i ] = ( ( i & 1 ) != skipoddnumrows ) ? 0xFF : 0;
 		}
+	BlitMaskedRows( gBlitKernels, srcbits, srcrowbytes, dstbits, dstrowbytes,
+		width, height, patterns, true );
 }
 
 
@@ -1282,30 +1384,16 @@ FastBlitBlend75( const DTSOffView * view, const DTSImage * srcimage,
 		+ dstrowbytes * ( dsttop - dstimageBounds.rectTop )
 		+ ( dstleft - dstimageBounds.rectLeft );
 	
-	// for each row
-	const uchar * srcrow = srcbits;
-	uchar * dstrow = dstbits;
-	for ( ;  height > 0;  --height )
+	// 1 of every 4 pixels, the one at rowinset;
+	// it moves over by 2 on alternate rows
+	uchar patterns[ 2 ][ 4 ];
+	for ( int i = 0;  i < 4;  ++i )
 		{
-		// inset the row;
-		srcbits += rowinset;
-		dstbits += rowinset;
-		
-		// for each pixel
-		for ( diff = width - rowinset;  diff > 0;  diff -= 4 )
-			{
-			*dstbits = *srcbits;
-			srcbits += 4;
-			dstbits += 4;
-			}
-		
-		// offset to next row
-		srcrow += srcrowbytes;
-		dstrow += dstrowbytes;
-		srcbits = srcrow;
-		dstbits = dstrow;
-		rowinset ^= 2;
+		patterns[ 0 ][ i ] = ( i == rowinset ) ? 0xFF : 0;
+		patterns[ 1 ][ i ] = ( i == ( rowinset ^ 2 ) ) ? 0xFF : 0;
 		}
+	BlitMaskedRows( gBlitKernels, srcbits, srcrowbytes, dstbits, dstrowbytes,
+		width, height, patterns, false );
 }
 
 
@@ -1386,32 +1474,156 @@ FastBlitBlend75Transparent( const DTSOffView * view, const DTSImage * srcimage,
 		+ dstrowbytes * ( dsttop - dstimageBounds.rectTop )
 		+ ( dstleft - dstimageBounds.rectLeft );
 	
-	// for each row
-	const uchar * srcrow = srcbits;
-	uchar * dstrow = dstbits;
-	for ( ;  height > 0;  --height )
+	// 1 of every 4 pixels, the one at rowinset;
+	// it moves over by 2 on alternate rows
+	uchar patterns[ 2 ][ 4 ];
+	for ( int i = 0;  i < 4;  ++i )
 		{
-		// inset the row;
-		srcbits += rowinset;
-		dstbits += rowinset;
+		patterns[ 0 ][ i ] = ( i == rowinset ) ? 0xFF : 0;
+		patterns[ 1 ][ i ] = ( i == ( rowinset ^ 2 ) ) ? 0xFF : 0;
+		}
+	BlitMaskedRows( gBlitKernels, srcbits, srcrowbytes, dstbits, dstrowbytes,
+		width, height, patterns, true );
+}
+
+
+
+
+/*
+**	BlitBenchmark()
+**
+**	check each vector kernel set against the scalar one, pixel for pixel,
+**	then time all of them on a made-up sprite: ragged transparent runs
+**	over a busy background, the way the playfield looks
+*/
+DTSError
+BlitBenchmark( int rounds, SBlitBenchmark * oResult )
+{
+	bzero( oResult, sizeof *oResult );
+	oResult->bbRounds = rounds;
+	oResult->bbSelected = gBlitKernels->bkName;
+	
+	const SBlitKernels * kernels[ kBlitBenchmarkKernels ];
+	int numKernels = GetBlitKernels( kernels );
+	oResult->bbNumKernels = numKernels;
+	for ( int k = 0;  k < numKernels;  ++k )
+		oResult->bbKernel[ k ] = kernels[ k ]->bkName;
+	
+	const int kWidth  = 512;
+	const int kHeight = 256;
+	const int kSize   = kWidth * kHeight;
+	oResult->bbPixels = kSize;
+	
+	uchar * sprite = NEW_TAG("BlitBenchmark") uchar[ kSize ];
+	uchar * background = NEW_TAG("BlitBenchmark") uchar[ kSize ];
+	uchar * dst = NEW_TAG("BlitBenchmark") uchar[ kSize ];
+	uchar * ref = NEW_TAG("BlitBenchmark") uchar[ kSize ];
+	CheckPointer( sprite );
+	CheckPointer( background );
+	CheckPointer( dst );
+	CheckPointer( ref );
+	if ( not sprite || not background || not dst || not ref )
+		{
+		delete[] sprite;
+		delete[] background;
+		delete[] dst;
+		delete[] ref;
+		return memFullErr;
+		}
+	
+	for ( int i = 0;  i < kSize;  )
+		{
+		// alternate runs of 1..40 opaque and transparent pixels
+		int run = 1 + GetRandom( 40 );
+		bool opaque = GetRandom( 3 ) != 0;
+		for ( ;  run > 0 && i < kSize;  --run, ++i )
+			sprite[ i ] = opaque ? 1 + GetRandom( 255 ) : 0;
+		}
+	for ( int i = 0;  i < kSize;  ++i )
+		background[ i ] = GetRandom( 256 );
+	
+	// the stipples of BlitTransparent, FastBlitBlend25, 50 and 75
+	static const uchar patterns[ 4 ][ 2 ][ 4 ] =
+		{
+			{ { 0xFF, 0xFF, 0xFF, 0xFF }, { 0xFF, 0xFF, 0xFF, 0xFF } },
+			{ { 0xFF, 0xFF, 0xFF, 0x00 }, { 0xFF, 0x00, 0xFF, 0xFF } },
+			{ { 0xFF, 0x00, 0xFF, 0x00 }, { 0x00, 0xFF, 0x00, 0xFF } },
+			{ { 0x00, 0x00, 0x00, 0xFF }, { 0x00, 0xFF, 0x00, 0x00 } }
+		};
+	static const char * const opNames[ kBlitBenchmarkOps ] =
+		{
+		"transparent",
+		"25%", "25% transparent",
+		"50%", "50% transparent",
+		"75%", "75% transparent",
+		"quality 50% transparent"
+		};
+	
+	bool haveQuality = gBlendRGBTable && gBlendInvTable;
+	
+	for ( int op = 0;  op < kBlitBenchmarkOps;  ++op )
+		{
+		oResult->bbOp[ op ] = opNames[ op ];
+		if ( op == kBlitBenchmarkOps - 1 && not haveQuality )
+			continue;
 		
-		// for each pixel
-		for ( diff = width - rowinset;  diff > 0;  diff -= 4 )
+		for ( int k = 0;  k < numKernels;  ++k )
 			{
-			int pixel = *srcbits;
-			if ( pixel )
-				*dstbits = pixel;
-			srcbits += 4;
-			dstbits += 4;
+			// first, the exactness check, including every ragged right edge
+			if ( k > 0 )
+				{
+				for ( int width = 1;  width <= 80;  ++width )
+					{
+					int offset = GetRandom( kWidth - width );
+					int height = 8;
+					memcpy( ref, background, kSize );
+					memcpy( dst, background, kSize );
+					if ( op < kBlitBenchmarkOps - 1 )
+						{
+						const uchar (* rowPatterns)[ 4 ] = patterns[ ( op + 1 ) / 2 ];
+						bool transparent = 0 == op || 0 == ( op & 1 );
+						BlitMaskedRows( kernels[ 0 ], sprite + offset, kWidth,
+							ref + offset, kWidth, width, height, rowPatterns, transparent );
+						BlitMaskedRows( kernels[ k ], sprite + offset, kWidth,
+							dst + offset, kWidth, width, height, rowPatterns, transparent );
+						}
+					else
+						{
+						QualityBlendTransparentRows( kernels[ 0 ], sprite + offset,
+							kWidth - width, ref + offset, kWidth - width, width, height, 2 );
+						QualityBlendTransparentRows( kernels[ k ], sprite + offset,
+							kWidth - width, dst + offset, kWidth - width, width, height, 2 );
+						}
+					if ( memcmp( ref, dst, kSize ) )
+						++oResult->bbMismatches;
+					}
+				}
+			
+			// then the clock
+			memcpy( dst, background, kSize );
+			EventTime start = GetCurrentEventTime();
+			for ( int round = 0;  round < rounds;  ++round )
+				{
+				if ( op < kBlitBenchmarkOps - 1 )
+					{
+					BlitMaskedRows( kernels[ k ], sprite, kWidth, dst, kWidth,
+						kWidth, kHeight, patterns[ ( op + 1 ) / 2 ],
+						0 == op || 0 == ( op & 1 ) );
+					}
+				else
+					{
+					QualityBlendTransparentRows( kernels[ k ], sprite, 0,
+						dst, 0, kWidth, kHeight, 2 );
+					}
+				}
+			oResult->bbSeconds[ k ][ op ] = GetCurrentEventTime() - start;
 			}
-		
-		// offset to next row
-		srcrow += srcrowbytes;
-		dstrow += dstrowbytes;
-		srcbits = srcrow;
-		dstbits = dstrow;
-		rowinset ^= 2;
 		}
+	
+	delete[] sprite;
+	delete[] background;
+	delete[] dst;
+	delete[] ref;
+	
+	return noErr;
 }
-
-
@@ -19,6 +19,7 @@
 #include "ClanLord.h"
 #include "Movie_cl.h"
 #include "LaunchURL_cl.h"
+#include "Shadows_cl.h"
 #ifdef USE_OPENGL
 # include "OpenGL_cl.h"
 #endif	// USE_OPENGL
@@ -80,6 +81,10 @@ static void		CacheInit( ImageCache * cache );
 static void		Update1Anim( ImageCache * cache );
 #endif  // IRREGULAR_ANIMATIONS
 static void		MyNewHandler();
+#ifdef USE_OPENGL
+static void		BuildColorRemap( ImageColorCache * ccache, int numColors,
+					const uchar * colors );
+#endif	// USE_OPENGL
 
 
 /*
@@ -87,6 +92,7 @@ static void		MyNewHandler();
 */
 static DTSKeyID				gCacheID;
 uint						CacheObject::sCachedImageCount = 0;
+uint						CacheObject::sCachedShadowCount = 0;
 static std::new_handler		gOldNewHandler;
 
 
@@ -101,6 +107,7 @@ InitCaches()
 	gCacheID = kNoSuchCacheID;
 	
 	CacheObject::sCachedImageCount = 0;
+	CacheObject::sCachedShadowCount = 0;
 	
 	gOldNewHandler = std::set_new_handler( MyNewHandler );
 }
@@ -162,7 +169,6 @@ CacheObject::~CacheObject()
 **	returns true if the object can be deleted.
 **	false if it cannot currently be deleted.
 **	like say, something's pointing at it.
-**	or a sound is still playing.
 */
 bool
 CacheObject::CanBeDeleted() const
@@ -425,7 +431,25 @@ LoadCachePicture( DTSKeyID id, const PictDef * pd, ImageCache ** pc, int numColo
 		{
 		cache->icImage.cliPictDefID = id;
 		cache->icImage.cliPictDef   = * pd;
-		result = LoadImage( &cache->icImage, &gClientImagesFile, numColors, colors );
+		
+			// a frame decoded in an earlier session is just mapped in
+		if ( not FindDecodedImage( id, pd, numColors, colors, cache ) )
+			{
+				// don't sum it again if it has passed before
+			bool bVerified = IsImageVerified( id, pd );
+			result = LoadImage( &cache->icImage, &gClientImagesFile, numColors, colors, bVerified );
+			
+			if ( noErr == result
+			&&	 not bVerified
+			&&	 not (pd->pdFlags & kPictDefFlagNoChecksum) )
+				{
+				MarkImageVerified( id, pd );
+				}
+			
+				// and next session, it won't need decoding
+			if ( noErr == result )
+				KeepDecodedImage( id, pd, numColors, colors, &cache->icImage );
+			}
 		}
 	
 	// verify the checksum
@@ -438,6 +462,12 @@ LoadCachePicture( DTSKeyID id, const PictDef * pd, ImageCache ** pc, int numColo
 			}
 		}
 	
+#ifdef USE_OPENGL
+	// work out how to draw our colors from the uncolored image's texture
+	if ( noErr == result  &&  numColors )
+		BuildColorRemap( static_cast<ImageColorCache *>( cache ), numColors, colors );
+#endif	// USE_OPENGL
+	
 	// recover from an error
 	if ( result != noErr )
 		{
@@ -455,6 +485,70 @@ LoadCachePicture( DTSKeyID id, const PictDef * pd, ImageCache ** pc, int numColo
 }
 
 
+#ifdef USE_OPENGL
+/*
+**	BuildColorRemap()
+**
+**	the image bits hold the picture's own color table applied to its local indices,
+**	and custom colors just overwrite the front of that table. So the colored image
+**	is the uncolored one pushed through a 256-entry remap -- provided no CLUT index
+**	in the table stands for two local indices that end up different colors.
+*/
+void
+BuildColorRemap( ImageColorCache * ccache, int numColors, const uchar * colors )
+{
+	ccache->icRemapExact = false;
+	for ( int i = 0; i < 256; ++i )
+		ccache->icRemap[ i ] = i;
+	
+	// LoadImage() only honors the custom colors if the picture asks for them
+	if ( not (ccache->icImage.cliPictDef.pdFlags & kPictDefCustomColors) )
+		{
+		ccache->icRemapExact = true;
+		return;
+		}
+	
+	// the picture's own color table
+	uchar base[ 256 ];
+	size_t size = 0;
+	DTSKeyID colorsID = ccache->icImage.cliPictDef.pdColorsID;
+	memset( base, 0, sizeof base );
+	if ( gClientImagesFile.GetSize( kTypePictureColors, colorsID, &size ) != noErr
+	||   gClientImagesFile.Read( kTypePictureColors, colorsID, base, sizeof base ) != noErr )
+		{
+		return;
+		}
+	if ( size > sizeof base )
+		size = sizeof base;
+	if ( numColors > int( size ) )
+		numColors = size;
+	
+	bool mapped[ 256 ];
+	memset( mapped, 0, sizeof mapped );
+	
+	// the customized entries...
+	for ( int i = 0; i < numColors; ++i )
+		{
+		uchar index = base[ i ];
+		if ( mapped[ index ]  &&  ccache->icRemap[ index ] != colors[ i ] )
+			return;
+		ccache->icRemap[ index ] = colors[ i ];
+		mapped[ index ] = true;
+		}
+	
+	// ... mustn't collide with the ones left alone
+	for ( int i = numColors; i < int( size ); ++i )
+		{
+		uchar index = base[ i ];
+		if ( mapped[ index ]  &&  ccache->icRemap[ index ] != index )
+			return;
+		}
+	
+	ccache->icRemapExact = true;
+}
+#endif	// USE_OPENGL
+
+
 /*
 **	HandleChecksumError()
 **
@@ -515,7 +609,8 @@ ShowChecksumError( DTSKeyID id )
 **	ChecksumUsualSuspects()
 **
 **	verify checksums for some of the most commonly modified images
-**	unfortunate that this fills up the cache with images that may not be needed
+**	unfortunate that this fills up the cache with images that may not be needed,
+**	so skip the ones that have already been verified
 */
 DTSError
 ChecksumUsualSuspects()
@@ -523,7 +618,17 @@ ChecksumUsualSuspects()
 	DTSError result = noErr;
 	for ( const int16_t * p = sUsualImageSuspects; *p; ++p )
 		{
-		(void) CachePicture( static_cast<DTSKeyID>( *p ) );
+		DTSKeyID id = static_cast<DTSKeyID>( *p );
+		PictDef pd;
+		memset( &pd, 0, sizeof pd );
+		if ( noErr == gClientImagesFile.Read( kTypePictureDefinition, id, &pd, sizeof pd ) )
+			{
+			BigToNativeEndian( &pd );
+			if ( IsImageVerified( id, &pd ) )
+				continue;
+			}
+		
+		(void) CachePicture( id );
 		if ( gChecksumMsgGiven )
 			{
 			result = kImageChecksumError;
@@ -671,9 +776,55 @@ Update1Anim( ImageCache * cache )
 ImageColorCache::~ImageColorCache()
 {
 //	ShowMessage( "Deallocated %d", (int) icImageID);
+
+#ifdef USE_OPENGL
+	// stop sharing the uncolored image's texture
+	if ( icBase )
+		{
+		ImageColorCache ** link = &icBase->icTinted;
+		while ( *link != this )
+			link = &(*link)->icNextTinted;
+		*link = icNextTinted;
+		}
+	ForgetTextureRemap( this );
+#endif	// USE_OPENGL
 }
 
 
+#ifdef USE_OPENGL
+/*
+**	ImageColorCache::GetBaseImage()
+**
+**	find (loading if need be) the uncolored image whose texture we draw through our remap
+**	returns nullptr if the remap can't reproduce our colors
+*/
+ImageCache *
+ImageColorCache::GetBaseImage()
+{
+	if ( not icRemapExact )
+		return nullptr;
+	
+	if ( icBase )
+		icBase->Touch();
+	else
+		{
+		// loading might run the new_handler, which mustn't reap us
+		DisableFlush();
+		icBase = CachePicture( icImageID );
+		EnableFlush();
+		
+		if ( icBase )
+			{
+			icNextTinted = icBase->icTinted;
+			icBase->icTinted = this;
+			}
+		}
+	
+	return icBase;
+}
+#endif	// USE_OPENGL
+
+
 /*
 **	ImageCache::~ImageCache()
 **
@@ -683,8 +834,25 @@ ImageCache::~ImageCache()
 {
 	icImage.cliImage.DisposeBits();
 	
+	// or, if they were in CL_Decoded, let go of the file
+	if ( icMapping )
+		DTS_releasemap( icMapping );
+	
+	// our shadows live on in the cache until they're reaped, but can't be found
+	DetachShadows( this );
+	
 #ifdef USE_OPENGL
 	delete textureObject;
+	
+	// colored variants will have to find us again
+	ImageColorCache * next;
+	for ( ImageColorCache * tinted = icTinted;  tinted;  tinted = next )
+		{
+		next = tinted->icNextTinted;
+		tinted->icBase = nullptr;
+		tinted->icNextTinted = nullptr;
+		}
+	icTinted = nullptr;
 #endif	// USE_OPENGL
 }
 
@@ -809,6 +977,9 @@ DeleteTextureObjects()
 			ic->textureObject = nullptr;
 			}
 		}
+	ResetResidentTextures();
+	ResetIndexedTextures();
+	
 #ifdef DEBUG_VERSION
 	gLargestTextureDimension = 0;
 	gLargestTexturePixels = 0;
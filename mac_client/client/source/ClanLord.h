@@ -226,7 +226,7 @@ enum
 **	update kPrefsVersion when you change the PrefsData structure
 **	Also, if possible, add the relevant case to UpdatePrefs()
 */
-const int kPrefsVersion		= 52;
+const int kPrefsVersion		= 53;
 const int kItemPrefsVersion	= 3;
 
 struct PrefsData
@@ -337,6 +337,10 @@ struct PrefsData
 
 // v50
 	int32_t			pdLanguageID;			// initial gRealLangID, if MULTILINGUAL (else ignored)
+
+// v53
+	int32_t			pdSmoothMotion;				// draw through the jitter buffer
+	int32_t			pdSmoothLatency;			// its latency budget, milliseconds
 };
 
 #pragma pack( pop )
@@ -363,9 +367,12 @@ enum
 **	CacheObject
 **
 **	cached memory objects
-**	currently we have images (both with and without custom colors), and sounds
+**	currently we have images, both with and without custom colors,
+**	and the shadows cast from them (see Shadows_cl.cp)
+**	gRootCacheObject is kept in least-recently-used order; Touch() sends an
+**	object to the back, and RemoveOneObject() reaps from the front.
 */
-class CacheObject : public DTSLinkedList<CacheObject>
+class CacheObject : public DTSDLinkedList<CacheObject>
 {
 public:
 	enum CacheObjectType
@@ -373,7 +380,7 @@ public:
 		kCacheTypeNone,
 		kCacheTypeImage,
 		kCacheTypeImageColor,
-		kCacheTypeSound
+		kCacheTypeShadow
 		};
 	
 	const CacheObjectType	coType;		// one of the above flavors
@@ -403,11 +410,14 @@ public:
 	
 	// census data
 	static uint		sCachedImageCount;
+	static uint		sCachedShadowCount;		// kept by ShadowCache itself
 };
 
 #ifdef USE_OPENGL
 class TextureObject;
 #endif	// USE_OPENGL
+class ShadowCache;
+class ImageColorCache;
 
 
 /*
@@ -422,8 +432,11 @@ public:
 	int				icHeight;
 	DTSRect			icBox;
 	uint			icUsage;
+	ShadowCache *	icShadows;		// shadows cast from this image
+	DTSFileMapping * icMapping;		// CL_Decoded, if the bits live there
 #ifdef USE_OPENGL
 	TextureObject *	textureObject;
+	ImageColorCache * icTinted;		// colored variants drawn with our texture
 	
 private:
 		// make these private, so they can't be called
@@ -437,9 +450,12 @@ public:
 	// constructor/destructor
 					ImageCache( CacheObjectType cType = kCacheTypeImage ) :
 						CacheObject( cType ),
-						icUsage( 0 )
+						icUsage( 0 ),
+						icShadows( nullptr ),
+						icMapping( nullptr )
 #ifdef USE_OPENGL
 						, textureObject( nullptr )
+						, icTinted( nullptr )
 #endif
 						{
 						}
@@ -467,14 +483,34 @@ public:
 	DTSKeyID	icImageID;
 	int			icNumColors;
 	uchar		icColors[ kNumPlyColors ];
+#ifdef USE_OPENGL
+		// with indexed textures, we draw the uncolored image's texture
+		// through a remap row instead of uploading our own
+	ImageCache *		icBase;			// the uncolored image, once linked
+	ImageColorCache *	icNextTinted;	// next variant sharing icBase's texture
+	int					icRemapRow;		// our row in the GL remap texture, or 0
+	bool				icRemapExact;	// does icRemap reproduce our colors?
+	uchar				icRemap[ 256 ];	// uncolored index -> our index
+#endif	// USE_OPENGL
 
 	// constructor/destructor
 					ImageColorCache() :
 						ImageCache( kCacheTypeImageColor ),
 						icImageID( 0 ),
 						icNumColors( 0 )
+#ifdef USE_OPENGL
+						, icBase( nullptr )
+						, icNextTinted( nullptr )
+						, icRemapRow( 0 )
+						, icRemapExact( false )
+#endif	// USE_OPENGL
 						{}
 	virtual			~ImageColorCache();
+	
+#ifdef USE_OPENGL
+	// interface
+	ImageCache *	GetBaseImage();
+#endif	// USE_OPENGL
 };
 
 
@@ -517,6 +553,7 @@ class PlayerNode;
 */
 const int kMaxDescTextLength		= 512;
 
+// DescRecord is a descriptor as movies store it.
 // It's necessary to force an alignment here, because descriptors can & do get
 // written to disk (in movies), and therefore need to be consistently laid out.
 // Forcing 'power' alignment won't cause any harm on 68K machines, but might
@@ -525,7 +562,7 @@ const int kMaxDescTextLength		= 512;
 // The 'descUnused' alignment field was added in v795 to help ensure that.
 #pragma pack( push, 4 )
 
-struct DescTable
+struct DescRecord
 {
 	int32_t				descID;
 	int32_t				descCacheID;
@@ -555,9 +592,127 @@ struct DescTable
 #pragma pack( pop )
 
 
+// While playing, though, the descriptors are kept differently. Every redraw walks
+// the whole table, or every mobile in it, and looks at only a few fields of each;
+// in a DescRecord those fields are spread out around half a kilobyte of bubble
+// text. So DescTable holds just the fields that are used every frame, with the
+// ones every loop wants up front; the bubble counters, which are scanned for every
+// descriptor on every redraw, are an array of their own; and the bubble text is
+// kept off to the side, in gDescBubbleText. Get at those two with the accessors
+// below, which only work for entries of gDescTable. DescToRecord() and
+// RecordToDesc() convert for movies.
+struct DescTable
+{
+	// what the per-mobile loops look at, in the first cache line
+	int32_t				descType;		// v74a: kDescPlayer, kDescMonster, npc, other
+	int32_t				descID;
+	int32_t				descNumColors;
+#ifdef AUTO_HIDENAME
+	int32_t				descSeenFrame;
+	int32_t				descNameVisible;		// can be 0, 25, 50 75, 100
+#endif
+	DTSRect				descLastDstBox;
+	char				descName[ kMaxNameLen ];
+	
+	// the rest
+	int32_t				descCacheID;
+	int32_t				descSize;
+	DSMobile *			descMobile;
+	mutable PlayerNode *	descPlayerRef;
+	int32_t				descBubbleType;
+	int32_t				descBubbleLanguage;
+	int32_t				descBubblePos;
+	int32_t				descBubbleLastPos;
+	DTSRect				descBubbleBox;
+	DTSPoint			descBubbleLoc;
+	uchar				descColors[ kNumPlyColors ];
+	
+	// the parts kept elsewhere
+	int					Index() const;
+	char *				BubbleText() const;		// kMaxDescTextLength bytes
+	int32_t&			BubbleCounter() const;
+};
+
+
 const int kDescTableBaseSize		= 256;
 const int kDescNumberOfThoughts		= 10;
 const int kDescTableSize			= kDescTableBaseSize + kDescNumberOfThoughts;
+const int kDescBenchmarkMobiles		= 200;		// a crowded scene, for \BENCHMARK DESCTABLE
+
+// the results of \BENCHMARK DESCTABLE: seconds spent in the descriptor loops,
+// using DescRecords and using gDescTable
+struct SDescBenchmark
+{
+	int					dbRounds;		// passes with a warm cache
+	int					dbColdRounds;	// ... and with a cold one
+	double				dbWarmRecord;
+	double				dbWarmTable;
+	double				dbColdRecord;
+	double				dbColdTable;
+};
+
+// the results of \BENCHMARK PLAYERS: seconds spent building, and then looking up
+// names in, the players tree and its index
+struct SPlayerBenchmark
+{
+	int					pbPlayers;
+	int					pbLookups;
+	double				pbTreeBuildSeconds;
+	double				pbIndexBuildSeconds;
+	double				pbTreeSeconds;
+	double				pbIndexSeconds;
+};
+
+// the results of \BENCHMARK REGEXP: seconds spent matching some patterns against
+// each line of a text log, with the DFA and with just the backtracking matcher
+const int kRegExpBenchmarkPatterns	= 4;
+
+struct SRegExpBenchmark
+{
+	int					rbLines;
+	long				rbBytes;
+	int					rbRounds;
+	int					rbDisagreements;	// had better be 0
+	const char *		rbPattern[ kRegExpBenchmarkPatterns ];
+	int					rbMatches[ kRegExpBenchmarkPatterns ];
+	double				rbDFASeconds[ kRegExpBenchmarkPatterns ];
+	double				rbBacktrackSeconds[ kRegExpBenchmarkPatterns ];
+};
+
+// the results of \BENCHMARK BLIT: seconds spent by each set of row kernels
+// (scalar, SSE2, AVX2, NEON) on each kind of blit, and how often a vector
+// kernel's output differed from the scalar one's
+const int kBlitBenchmarkKernels	= 3;
+const int kBlitBenchmarkOps		= 8;
+
+struct SBlitBenchmark
+{
+	int					bbRounds;
+	int					bbPixels;			// per blit
+	int					bbNumKernels;
+	int					bbMismatches;		// had better be 0
+	const char *		bbSelected;			// what InitBlitters() chose
+	const char *		bbKernel[ kBlitBenchmarkKernels ];
+	const char *		bbOp[ kBlitBenchmarkOps ];
+	double				bbSeconds[ kBlitBenchmarkKernels ][ kBlitBenchmarkOps ];
+};
+
+struct SDownloadStats
+{
+	int					dsStreams;			// most connections open at once
+	int					dsReconnects;		// ranges asked for again
+	int64_t				dsBytesIn;			// compressed
+	int64_t				dsBytesOut;			// expanded
+	double				dsSeconds;
+};
+
+	// the stages StartupTrace_cl.cp times
+enum
+{
+	kStartupLaunch,				// main() to a usable window
+	kStartupJoin,				// PlayGame() to the game
+	kStartupStages
+};
 
 
 /*
@@ -629,6 +784,8 @@ enum
 */
 extern DataSpool *	gDSSpool;				// the spool that holds the raw draw state data
 extern DescTable *	gDescTable;				// player descriptors
+extern char *		gDescBubbleText;		// ... their bubble text
+extern int32_t *	gDescBubbleCounter;		// ... and frames left for their bubbles
 extern DescTable *	gThisPlayer;			// this player's descriptor; MIGHT be stale
 						// name of the last character for whom a log was opened, or an empty string
 extern char			gLogCharName[ kMaxNameLen ];
@@ -651,6 +808,7 @@ extern bool			gDoneFlag;				// set when the user chooses quit from the file menu
 extern bool			gFastBlendMode;			//  your computer is too slow for quality blend mode
 extern bool			gInBack;
 extern bool			gPlayersListIsStale;
+extern bool			gStartupBenchmark;		// quit once the window is ready; see StartupTrace_cl.cp
 extern int			gFastDrawLimit;
 extern int			gSlowDrawLimit;
 extern DTSKeyFile	gClientImagesFile;		// the images key file
@@ -668,6 +826,7 @@ extern DTSWindow *	gPlayersWindow;			// players window
 extern int			gAckFrame;				// latest state data frame
 extern int			gNumFrames;				// number of frames this session
 extern int			gLostFrames;			// number of lost frames this session
+extern double		gFrameArrival;			// when the latest frame got here
 extern int			gResendFrame;			// request resend of state data frame
 extern ulong		gCommandNumber;			// enumerate the commands sent to the server
 extern int			gInvenCmd;				// player's inventory command
@@ -691,6 +850,14 @@ extern int			gRealLangID;			// real language of client
 #endif
 
 
+/*
+**	DescTable accessors
+*/
+inline int		DescTable::Index() const		{ return this - gDescTable; }
+inline char *	DescTable::BubbleText() const	{ return gDescBubbleText + Index() * kMaxDescTextLength; }
+inline int32_t&	DescTable::BubbleCounter() const	{ return gDescBubbleCounter[ Index() ]; }
+
+
 /*
 **	Entry Routines
 */
@@ -722,6 +889,7 @@ void	QualityBlitBlend75( const DTSOffView *, const DTSImage *,
 			const DTSRect *, const DTSRect * );
 void	QualityBlitBlend75Transparent( const DTSOffView *, const DTSImage *,
 			const DTSRect *, const DTSRect * );
+DTSError	BlitBenchmark( int rounds, SBlitBenchmark * oResult );
 
 // Cache_cl.cp
 void			InitCaches();
@@ -746,12 +914,18 @@ char *		AnswerChallenge( char * dst, const char * password, const char * challen
 void		SetupLogonRequest( LogOn * log, uint messagetag );
 void		ResetupLogonRequest( LogOn * log );
 char *		GetMagicFileInfo( char * ptr );
+void		SetLoopbackPort( int port );
+int			GetLoopbackPort();
 
 // DownloadURL_cl.cp
 DTSError	AutoUpdate( LogOn * msg );
 DTSError	ExpandFile( DTSFileSpec * file );
 void		LaunchNewClient();
 
+// RangeDownload_cl.cp
+DTSError	DownloadInflateURL( const char * url, std::FILE * out,
+				const HFSUniStr255& name, SDownloadStats * oStats );
+
 // FriendsList_cl.cp
 DTSError	SetPermFriend( const char * n, int friendType );
 DTSError	ReadFriends( const char * myName );
@@ -766,12 +940,14 @@ void		CreateCLWindow( const DTSRect * pos );
 void		RedrawCLWindow();
 void		GetGWMouseLoc( DTSPoint * pt );
 void		ExtractImportantData();
+bool		PresentSmoothFrame();
 void		ShowInfoText( const char * text );
 void		ChangeWindowSize();
 void		SetBackColors();
 void		UpdateCommandsMenu( const char * );
 bool	 	MovePlayerToward( int quadrant, int moveSpeed, bool stopIfBalance );
 DescTable *	LocateMobileByPoint( const DTSPoint * where, int inKind );
+void		InvalidateMobileHits();
 void		TouchHealthBars();
 void		KillNotification();
 #if DTS_LITTLE_ENDIAN
@@ -817,6 +993,15 @@ void		ShowMsgDlg( CFStringRef text );
 void		DrawTextBox( DTSView *, CFStringRef, DTSCoord, DTSCoord, int, ThemeFontID );
 DTSCoord	GetTextBoxWidth( const DTSView * view, CFStringRef text, ThemeFontID font );
 void		SetBardVolume( int inPct );
+OSStatus	PerformAutoJoin();
+void		ClearDescTable();
+void		DescToRecord( const DescTable * desc, DescRecord * oRec );
+void		RecordToDesc( const DescRecord * rec, DescTable * desc );
+void		DescTableBenchmark( int rounds, SDescBenchmark * oResult );
+#if DTS_ALLOC_PROFILE
+void		SetAllocProfileLogInterval( int seconds );
+int			GetAllocProfileLogInterval();
+#endif  // DTS_ALLOC_PROFILE
 
 #if ENABLE_MUSIC_FILES
 // Music_cl.cp
@@ -825,12 +1010,17 @@ void		PlayCLMusic();
 bool		CheckMusicCommand( const char * text, size_t len );
 #endif  // ENABLE_MUSIC_FILES
 
+// Night_cl.cp
+DTSError	RegExpBenchmark( const char * fname, int rounds, SRegExpBenchmark * oResult );
+
 // PlayersWin_cl.cp
+void		PrefetchPlayers();
 void		InitPlayers();
 void		DisposePlayers();
 void		ResetPlayers();
 void		CreatePlayersWindow( const DTSRect * pos );
 void		RequestPlayersData();
+void		IdlePlayers();
 bool		ParseInfoText( const char * text, BEPPrefixID prefix, MsgClasses * );
 bool		ParseThinkText( DescTable * desc );
 bool		ResolvePlayerName( SafeString * name, bool showError );
@@ -857,13 +1047,23 @@ void		ResetSharees();
 DTSError	GatherPlayerFileStats( char * outtext );
 void		ListFriends( int label = -1 );
 void		ListShares( SafeString * oList, bool bOutbound );
+void		PlayerIndexBenchmark( int numPlayers, int rounds, SPlayerBenchmark * oResult );
 
 // Sound_cl.cp
 void		CLInitSound();
 void		CLExitSound();
+void		CLStopSounds();
 void		CLPlaySound( DTSKeyID id );
 void		SetSoundVolume( uint volume );
 
+// StartupTrace_cl.cp
+void		BeginStartupTrace( int argc, char ** argv );
+void		BeginStartupStage( int stage );
+void		TraceStartupPhase( const char * phase );
+void		EndStartupStage();
+void		TraceStartupTask( const char * task, CFAbsoluteTime started );
+void		ShowStartupTrace();
+
 // TextPrefs_cl.cp
 void		InitTextStyles();
 void		GetColorPrefs();
@@ -886,5 +1086,23 @@ DTSError	UpdateSoundsFile( int newversion );
 void		OpenKeyFiles();
 void		CloseKeyFiles();
 
+// VerifiedImages_cl.cp
+bool		IsImageVerified( DTSKeyID id, const PictDef * pd );
+void		MarkImageVerified( DTSKeyID id, const PictDef * pd );
+void		IdleVerifiedImages();
+void		StopImageVerifier();
+void		InvalidateVerifiedImages();
+void		SaveVerifiedImages();
+uint32_t	FingerprintPictDef( const PictDef * pd );
+
+// DecodedImages_cl.cp
+void		OpenDecodedImages();
+void		CloseDecodedImages();
+void		InvalidateDecodedImages();
+bool		FindDecodedImage( DTSKeyID id, const PictDef * pd, int numColors,
+				const uchar * colors, ImageCache * cache );
+void		KeepDecodedImage( DTSKeyID id, const PictDef * pd, int numColors,
+				const uchar * colors, const CLImage * image );
+
 #endif  // CLANLORD_H
 
@@ -18,8 +18,10 @@
 
 #include "ClanLord.h"
 #include "KeychainUtils.h"
+#include "JitterBuffer_cl.h"
 #include "LaunchURL_cl.h"
 #include "Movie_cl.h"
+#include "NetStats_cl.h"
 
 
 /*
@@ -35,6 +37,8 @@ DTSError	SendWaitReply( Message * msg, size_t size, char * error );
 char *		AnswerChallenge( char * dst, const char * password, const char * challenge );
 void		SetupLogonRequest( LogOn * logon, ushort messagetag );
 void		ResetupLogonRequest( LogOn * logon );
+void		SetLoopbackPort( int port );
+int			GetLoopbackPort();
 */
 
 
@@ -90,6 +94,7 @@ static DataSpool		gMsgSpoolA;
 static DataSpool		gMsgSpoolB;
 static DataSpool *		gNewMsgSpool;
 static ulong			gCallBackTime;
+static int				gLoopbackPort;		// connect to a local loopback server; see below
 
 
 /*
@@ -140,7 +145,8 @@ InitComm()
 	ClearErrorCode();
 	
 	// make sure we have a character name and password
-//	if ( noErr == result )
+	// (the loopback server doesn't care who we are)
+	if ( not gLoopbackPort )
 		{
 		// attempt to retrieve from keychain
 		if ( gPrefsData.pdCharName[0] )
@@ -156,7 +162,7 @@ InitComm()
 			}
 		}
 	// make sure we have an address for the host
-	if ( noErr == result )
+	if ( noErr == result  &&  not gLoopbackPort )
 		{
 		if ( 0 == gPrefsData.pdHostAddr[0] )
 			{
@@ -189,6 +195,13 @@ InitComm()
 		gResendFrame = -1;
 		gNumFrames   =  0;
 		gLostFrames  =  0;
+		gNetStats.Reset();
+		
+		// from here on, let a thread of its own do the reading, so arrivals are
+		// timestamped as they happen rather than whenever the event loop gets around
+		// to them. If it won't start, Read() goes on polling the sockets itself.
+		DTSError err = gNetChannel.StartReceiveThread( sizeof(Message) );
+		__Check_noErr( err );
 		}
 	
 	// close the connection for an error
@@ -244,6 +257,9 @@ ExitComm()
 	
 	DTSExitNetwork();
 	
+	// a loopback session is good for one connection only
+	gLoopbackPort = 0;
+	
 #ifdef DEBUG_VERSION
 //	ShowMessage( "* ExitComm" );
 #endif
@@ -270,9 +286,13 @@ DoComm()
 		result = Handle1Comm();
 	
 	// bail if we did not receive a drawstate message
+	// (unless smooth motion has something new to show in the meantime)
 	DataSpool * ds = gDSSpool;
 	if ( not ds )
+		{
+		PresentSmoothFrame();
 		return;
+		}
 	
 	if ( not CCLMovie::IsReading() ) // only if on a real server
 		{
@@ -284,7 +304,8 @@ DoComm()
 		}
 	
 	// redraw the game window
-	RedrawCLWindow();
+	if ( not PresentSmoothFrame() )
+		RedrawCLWindow();
 }
 
 
@@ -326,6 +347,17 @@ ResetupLogonRequest( LogOn * logon )
 DTSError
 FindServer()
 {
+	// the loopback server is either there, or not
+	if ( gLoopbackPort )
+		{
+		char addr[ 32 ];
+		snprintf( addr, sizeof addr, "127.0.0.1:%d", gLoopbackPort );
+		DTSError result = gNetChannel.ConnectHost( addr );
+		if ( result != noErr )
+			ShowMessage( _(TXTCL_FAILED_FIND_SERVER), result, addr );
+		return result;
+		}
+	
 	// attempt to connect to the host
 	bool bNeedHostInfo = false;
 	DTSError result;
@@ -736,9 +768,18 @@ Handle1Comm()
 			}
 		else
 			result = +1;	// not the proper time for next frame
+		
+		gFrameArrival = GetCurrentEventTime();
 		}
 	else
+		{
 		result = gNetChannel.Read( data, &length );
+		
+		// when it actually got here, which may have been a little while ago
+		DTSNetReceiveStats stats;
+		gNetChannel.GetReceiveStats( &stats );
+		gFrameArrival = GetCurrentEventTime() - stats.rsLastDelay;
+		}
 	
 	// if recording, go write the frame
 	if ( CCLMovie::IsRecording() && length && noErr == result)
@@ -784,6 +825,10 @@ Handle1Comm()
 	result = spool->GetResult();
 	if ( noErr == result )
 		{
+		// movies don't come over the network
+		if ( not CCLMovie::IsReading() )
+			gNetStats.RecordReceived( tag, length );
+		
 		switch ( tag )
 			{
 			case kMsgDrawState:
@@ -853,6 +898,27 @@ SendInput()
 		ShowMessage( "Milliseconds since last message: %d",
 			int( thisTime - lastTime ) * 50 / 3 );
 		lastTime = thisTime;
+		
+		// and how long it sat in the receive queue before we got to it
+		DTSNetReceiveStats stats;
+		gNetChannel.GetReceiveStats( &stats );
+		if ( stats.rsMessages )
+			{
+			ShowMessage( "Milliseconds queued: %.1f (average %.1f, worst %.1f)",
+				stats.rsLastDelay * 1000, stats.rsMeanDelay * 1000,
+				stats.rsMaxDelay * 1000 );
+			}
+		
+		// and how the smooth-motion jitter buffer is coping
+		if ( gPrefsData.pdSmoothMotion )
+			{
+			CJitterBuffer::SStats jitter;
+			gJitterBuffer.GetStats( &jitter );
+			ShowMessage( "Jitter buffer: %d frames (peak %d), delay %.1f ms, "
+				"late %lu, skipped %lu, extrapolated %lu",
+				jitter.mDepth, jitter.mPeakDepth, jitter.mDelay * 1000,
+				jitter.mLate, jitter.mSkipped, jitter.mExtrapolations );
+			}
 		}
 	
 	// get the input from the player
@@ -884,6 +950,8 @@ SendInput()
 	// send it to the server input
 	size_t size = offsetof( PlayerInput, piKeyString ) + strlen(playerInput.piKeyString) + 1;
 	DTSError result = gNetChannel.Write( &playerInput, size, channel );
+	if ( noErr == result )
+		gNetStats.RecordSent( kMsgPlayerInput, size );
 	
 	// bail if we got an error
 	if ( result != noErr )
@@ -1067,6 +1135,29 @@ AnswerChallenge( char * dst, const char * password, const char * challenge )
 }
 
 
+/*
+**	SetLoopbackPort()
+**	GetLoopbackPort()
+**
+**	Make the next connection to a CLLoopbackServer on this machine, listening on
+**	the given port, instead of the real server; 0 to go back to normal.
+**	That server plays a recorded movie at us over the network, for benchmarking the
+**	whole receive path. It lasts for one connection.
+*/
+void
+SetLoopbackPort( int port )
+{
+	gLoopbackPort = port;
+}
+
+
+int
+GetLoopbackPort()
+{
+	return gLoopbackPort;
+}
+
+
 #pragma mark -
 
 /*
@@ -19,7 +19,10 @@
 
 #include "ClanLord.h"
 #include "Commands_cl.h"
+#include "JitterBuffer_cl.h"
 #include "Movie_cl.h"
+#include "NetStats_cl.h"
+#include "TuneHelper_cl.h"
 
 
 #define COMMAND_MANY_PREFS	1
@@ -72,6 +75,8 @@ gPrefCommandDefs[] =
 	{ "BARDVOLUME",		CommandDefinition::PrefBardVolume,		nullptr,  TXTCL_CMD_HELP_BARDVOLUME },
 	{ "NEWLOG",			CommandDefinition::PrefNewLogEveryJoin,	nullptr,	TXTCL_CMD_HELP_NEWLOG },
 	{ "MOVIELOGS",		CommandDefinition::PrefNoMovieTextLogs,	nullptr,	TXTCL_CMD_HELP_MOVIELOGS },
+	{ "SMOOTHMOTION",	CommandDefinition::PrefSmoothMotion,	nullptr,	TXTCL_CMD_HELP_SMOOTHMOTION },
+	{ "SMOOTHLATENCY",	CommandDefinition::PrefSmoothLatency,	nullptr,	TXTCL_CMD_HELP_SMOOTHLATENCY },
 #endif	// COMMAND_MANY_PREFS
 	
 	COMMAND_GROUP_TERMINATOR
@@ -124,6 +129,46 @@ gMoveSpeedCommandDefs[] =
 };
 
 
+#if DTS_ALLOC_PROFILE
+const CommandDefinition
+gMemStatsCommandDefs[] =
+{
+	{ "SHOW",	CommandDefinition::MemStatsShow,	nullptr,	TXTCL_CMD_HELP_MEMSTATS_SHOW },
+	{ "RESET",	CommandDefinition::MemStatsReset,	nullptr,	TXTCL_CMD_HELP_MEMSTATS_RESET },
+	{ "LOG",	CommandDefinition::MemStatsLog,		nullptr,	TXTCL_CMD_HELP_MEMSTATS_LOG },
+	{ "COUNT",	CommandDefinition::MemStatsCount,	nullptr,	TXTCL_CMD_HELP_MEMSTATS_COUNT },
+	COMMAND_GROUP_TERMINATOR
+};
+#endif	// DTS_ALLOC_PROFILE
+
+
+const CommandDefinition
+gNetStatsCommandDefs[] =
+{
+	{ "SHOW",		CommandDefinition::NetStatsShow,	nullptr,	TXTCL_CMD_HELP_NETSTATS_SHOW },
+	{ "RESET",		CommandDefinition::NetStatsReset,	nullptr,	TXTCL_CMD_HELP_NETSTATS_RESET },
+	{ "OVERLAY",	CommandDefinition::NetStatsOverlay,	nullptr,	TXTCL_CMD_HELP_NETSTATS_OVERLAY },
+	{ "LOG",		CommandDefinition::NetStatsLog,		nullptr,	TXTCL_CMD_HELP_NETSTATS_LOG },
+	COMMAND_GROUP_TERMINATOR
+};
+
+
+const CommandDefinition
+gBenchmarkCommandDefs[] =
+{
+	{ "SOUND",	CommandDefinition::BenchmarkSound,	nullptr,	TXTCL_CMD_HELP_BENCHMARK_SOUND },
+	{ "TUNE",	CommandDefinition::BenchmarkTune,	nullptr,	TXTCL_CMD_HELP_BENCHMARK_TUNE },
+	{ "LOOPBACK",	CommandDefinition::BenchmarkLoopback,	nullptr,	TXTCL_CMD_HELP_BENCHMARK_LOOPBACK },
+	{ "DESCTABLE",	CommandDefinition::BenchmarkDescTable,	nullptr,	TXTCL_CMD_HELP_BENCHMARK_DESCTABLE },
+	{ "PLAYERS",	CommandDefinition::BenchmarkPlayers,	nullptr,	TXTCL_CMD_HELP_BENCHMARK_PLAYERS },
+	{ "REGEXP",	CommandDefinition::BenchmarkRegExp,	nullptr,	TXTCL_CMD_HELP_BENCHMARK_REGEXP },
+	{ "BLIT",	CommandDefinition::BenchmarkBlit,	nullptr,	TXTCL_CMD_HELP_BENCHMARK_BLIT },
+	{ "DOWNLOAD",	CommandDefinition::BenchmarkDownload,	nullptr,	TXTCL_CMD_HELP_BENCHMARK_DOWNLOAD },
+	{ "STARTUP",	CommandDefinition::BenchmarkStartup,	nullptr,	TXTCL_CMD_HELP_BENCHMARK_STARTUP },
+	COMMAND_GROUP_TERMINATOR
+};
+
+
 // Base level commands
 const CommandDefinition
 gCommandDefs[] =
@@ -132,7 +177,12 @@ gCommandDefs[] =
 	{ "BLOCK",		CommandDefinition::Block, 		nullptr,			TXTCL_CMD_HELP_BLOCK },
 	{ "FORGET",		CommandDefinition::Forget, 		nullptr,			TXTCL_CMD_HELP_FORGET },
 	{ "IGNORE",		CommandDefinition::Ignore, 		nullptr,			TXTCL_CMD_HELP_IGNORE },
+	{ "BENCHMARK",	CommandDefinition::Benchmark,	gBenchmarkCommandDefs,	TXTCL_CMD_HELP_BENCHMARK },
+#if DTS_ALLOC_PROFILE
+	{ "MEMSTATS",	CommandDefinition::MemStats,	gMemStatsCommandDefs,	TXTCL_CMD_HELP_MEMSTATS },
+#endif
 	{ "MOVE",		CommandDefinition::Move,		gMoveCommandDefs,	TXTCL_CMD_HELP_MOVE },
+	{ "NETSTATS",	CommandDefinition::NetStats,	gNetStatsCommandDefs,	TXTCL_CMD_HELP_NETSTATS },
 	{ "PREF",		CommandDefinition::Pref, 		gPrefCommandDefs,	TXTCL_CMD_HELP_PREF },
 	{ "RECORD",		CommandDefinition::RecordMovie,	nullptr,			TXTCL_CMD_HELP_RECORD },
 	{ "SELECT",		CommandDefinition::Select, 		nullptr,			TXTCL_CMD_HELP_SELECT },
@@ -456,6 +506,20 @@ HandleCommand( const char * cmd )
 		case CommandDefinition::CatMovie:
 			HandleMovieCommand( &cmdStr );
 			break;
+			
+#if DTS_ALLOC_PROFILE
+		case CommandDefinition::CatMemStats:
+			HandleMemStatsCommand( cmdID, &cmdStr );
+			break;
+#endif
+		
+		case CommandDefinition::CatBenchmark:
+			HandleBenchmarkCommand( cmdID, &cmdStr );
+			break;
+		
+		case CommandDefinition::CatNetStats:
+			HandleNetStatsCommand( cmdID, &cmdStr );
+			break;
 		}
 	
 	return kHandled;	
@@ -714,6 +778,25 @@ HandlePrefCommand( int cmdID, SafeString * cmdStr, const CommandDefinition * def
 				gPrefsData.pdNoMovieTextLogs = not theBool;
 			break;
 		
+		case CommandDefinition::PrefSmoothMotion:
+			bGotParam = ResolveBoolean( &word, &theBool, true );
+			if ( bGotParam )
+				gPrefsData.pdSmoothMotion = theBool;
+			break;
+		
+		case CommandDefinition::PrefSmoothLatency:
+			bGotParam = ResolveInt( &word, &value, true );
+			if ( bGotParam )
+				{
+				if ( value < 0 )
+					value = 0;
+				else
+				if ( value > CJitterBuffer::kMaxLatency )
+					value = CJitterBuffer::kMaxLatency;
+				gPrefsData.pdSmoothLatency = value;
+				}
+			break;
+			
 #endif	// COMMAND_MANY_PREFS
 		}
 	
@@ -885,6 +968,537 @@ HandleMovieCommand( SafeString * cmdStr )
 }
 
 
+#if DTS_ALLOC_PROFILE
+/*
+**	ClientCommand::HandleMemStatsCommand()
+**
+**	report on, or control logging of, the per-tag heap statistics
+*/
+void
+HandleMemStatsCommand( int cmdID, SafeString * cmdStr )
+{
+	SafeString msg;
+	
+	switch ( cmdID )
+		{
+		case CommandDefinition::MemStatsShow:
+			{
+			// how many of the busiest tags to list
+			const int kMaxShown = 10;
+			AllocProfileEntry entries[ kMaxShown ];
+			
+			// the rates are since the previous \MEMSTATS SHOW; but don't
+			// steal the interval out from under the periodic log
+			ulong ticks = 0;
+			bool bMark = ( 0 == GetAllocProfileLogInterval() );
+			int count = AllocProfileSnapshot( entries, kMaxShown, bMark, &ticks );
+			double secs = ticks ? ticks / 60.0 : 1.0;
+			
+				/* "* Memory usage by tag, over the last %.0f seconds:" */
+			msg.Format( _(TXTCL_CMD_MEMSTATS_HEADER), ticks / 60.0 );
+			ShowInfoText( msg.Get() );
+			
+			for ( int ii = 0;  ii < count;  ++ii )
+				{
+				const AllocProfileEntry& e = entries[ ii ];
+				msg.Clear();
+					/* "  %s: %lu KB in %lu blocks, peak %lu KB, %.0f allocs/sec" */
+				msg.Format( _(TXTCL_CMD_MEMSTATS_LINE),
+					e.apeTag,
+					static_cast<ulong>( ( e.apeLiveBytes + 1023 ) / 1024 ),
+					static_cast<ulong>( e.apeLiveBlocks ),
+					static_cast<ulong>( ( e.apePeakBytes + 1023 ) / 1024 ),
+					e.apeIntervalAllocs / secs );
+				ShowInfoText( msg.Get() );
+				}
+			}
+			break;
+		
+		case CommandDefinition::MemStatsReset:
+			AllocProfileResetPeaks();
+				/* "* Memory high-water marks reset." */
+			ShowInfoText( _(TXTCL_CMD_MEMSTATS_RESET) );
+			break;
+		
+		case CommandDefinition::MemStatsLog:
+			{
+			SafeString word;
+			GetWord( cmdStr, &word );
+			
+			// accept a number of seconds, or ON (once a minute) or OFF
+			int seconds = 0;
+			bool bOn;
+			if ( not ResolveInt( &word, &seconds, false ) )
+				{
+				if ( not ResolveBoolean( &word, &bOn, true ) )
+					break;
+				seconds = bOn ? 60 : 0;
+				}
+			
+			SetAllocProfileLogInterval( seconds );
+			
+			if ( seconds > 0 )
+					/* "* Saving memory statistics to \"CL_AllocProfile.txt\" every %d seconds." */
+				msg.Format( _(TXTCL_CMD_MEMSTATS_LOGGING), seconds );
+			else
+					/* "* Stopped saving memory statistics." */
+				msg.Set( _(TXTCL_CMD_MEMSTATS_NOTLOGGING) );
+			ShowInfoText( msg.Get() );
+			}
+			break;
+		
+		case CommandDefinition::MemStatsCount:
+			{
+			SafeString word;
+			GetWord( cmdStr, &word );
+			
+			// no argument just says which it is
+			bool bOn = AllocProfileIsEnabled();
+			if ( word.Size() > 1
+			&&   not ResolveBoolean( &word, &bOn, true ) )
+				{
+				break;
+				}
+			AllocProfileEnable( bOn );
+			
+			if ( bOn )
+					/* "* Counting memory allocations." */
+				ShowInfoText( _(TXTCL_CMD_MEMSTATS_COUNTING) );
+			else
+					/* "* Not counting memory allocations; the figures will drift." */
+				ShowInfoText( _(TXTCL_CMD_MEMSTATS_NOTCOUNTING) );
+			}
+			break;
+		}
+}
+#endif	// DTS_ALLOC_PROFILE
+
+
+/*
+**	ClientCommand::HandleNetStatsCommand()
+**
+**	report on, or control the overlay and logging of, the network telemetry
+*/
+void
+HandleNetStatsCommand( int cmdID, SafeString * cmdStr )
+{
+	SafeString msg;
+	
+	switch ( cmdID )
+		{
+		case CommandDefinition::NetStatsShow:
+			{
+			CNetStats::SStats st;
+			gNetStats.GetStats( &st );
+			
+			if ( st.mRTTCount )
+					/* "* Command round trip: %.0f ms median, %.0f ms 90th percentile, ..." */
+				msg.Format( _(TXTCL_CMD_NETSTATS_RTT),
+					st.mRTT50, st.mRTT90, st.mRTT99, st.mRTTMin, st.mRTTMax, st.mRTTCount );
+			else
+					/* "* No command round trips measured yet." */
+				msg.Set( _(TXTCL_CMD_NETSTATS_NORTT) );
+			ShowInfoText( msg.Get() );
+			
+			msg.Clear();
+				/* "* Frames: %lu received, %.0f ms apart (99th percentile %.0f ms), jitter %.1f ms." */
+			msg.Format( _(TXTCL_CMD_NETSTATS_FRAMES),
+				st.mFrames, st.mInterval50, st.mInterval99, st.mJitter );
+			ShowInfoText( msg.Get() );
+			
+			msg.Clear();
+				/* "* Lost %lu frames in %lu bursts (longest %d; ..." */
+			msg.Format( _(TXTCL_CMD_NETSTATS_LOSS),
+				st.mLost, st.mLossBursts, st.mLongestLoss,
+				st.mLossSizes[0], st.mLossSizes[1], st.mLossSizes[2],
+				st.mLossSizes[3], st.mLossSizes[4] );
+			ShowInfoText( msg.Get() );
+			
+			msg.Clear();
+				/* "* %lu frames came late, in %lu bursts (longest %d, ..." */
+			msg.Format( _(TXTCL_CMD_NETSTATS_LATE),
+				st.mLate, st.mLateBursts, st.mLongestLate, st.mDeepestLate );
+			ShowInfoText( msg.Get() );
+			
+			msg.Clear();
+				/* "* Bandwidth: %.2f KB/sec in, %.2f KB/sec out; ..." */
+			msg.Format( _(TXTCL_CMD_NETSTATS_BANDWIDTH),
+				st.mBytesIn / 1024, st.mBytesOut / 1024,
+				st.mTotalIn / 1024.0, st.mTotalOut / 1024.0 );
+			ShowInfoText( msg.Get() );
+			
+			for ( int tt = 0;  tt < CNetStats::kNumTraffic;  ++tt )
+				{
+				if ( st.mRate[ tt ] <= 0 )
+					continue;
+				msg.Clear();
+					/* "  %s: %.2f KB/sec" */
+				msg.Format( _(TXTCL_CMD_NETSTATS_TRAFFIC),
+					CNetStats::GetTrafficName( tt ), st.mRate[ tt ] / 1024 );
+				ShowInfoText( msg.Get() );
+				}
+			}
+			break;
+		
+		case CommandDefinition::NetStatsReset:
+			gNetStats.Reset();
+				/* "* Network statistics reset." */
+			ShowInfoText( _(TXTCL_CMD_NETSTATS_RESET) );
+			break;
+		
+		case CommandDefinition::NetStatsOverlay:
+			{
+			SafeString word;
+			GetWord( cmdStr, &word );
+			
+			// no argument toggles it
+			bool bOn = not gNetStats.IsOverlayShown();
+			if ( word.Size() > 1
+			&&   not ResolveBoolean( &word, &bOn, true ) )
+				{
+				break;
+				}
+			
+			gNetStats.SetOverlay( bOn );
+				/* "* Showing network statistics over the game field." */
+				/* "* Stopped showing network statistics." */
+			ShowInfoText( bOn ? _(TXTCL_CMD_NETSTATS_OVERLAY_ON)
+							  : _(TXTCL_CMD_NETSTATS_OVERLAY_OFF) );
+			}
+			break;
+		
+		case CommandDefinition::NetStatsLog:
+			{
+			SafeString word;
+			GetWord( cmdStr, &word );
+			
+			// accept a number of seconds, or ON (every ten seconds) or OFF
+			int seconds = 0;
+			bool bOn;
+			if ( not ResolveInt( &word, &seconds, false ) )
+				{
+				if ( not ResolveBoolean( &word, &bOn, true ) )
+					break;
+				seconds = bOn ? 10 : 0;
+				}
+			
+			gNetStats.SetLogInterval( seconds );
+			
+			if ( seconds > 0 )
+					/* "* Saving network statistics to \"CL_NetStats.csv\" every %d seconds." */
+				msg.Format( _(TXTCL_CMD_NETSTATS_LOGGING), seconds );
+			else
+					/* "* Stopped saving network statistics." */
+				msg.Set( _(TXTCL_CMD_NETSTATS_NOTLOGGING) );
+			ShowInfoText( msg.Get() );
+			}
+			break;
+		}
+}
+
+
+/*
+**	ClientCommand::HandleBenchmarkCommand()
+**
+**	time some subsystem against a synthetic worst case
+*/
+void
+HandleBenchmarkCommand( int cmdID, SafeString * cmdStr )
+{
+	SafeString msg;
+	SafeString word;
+	
+	switch ( cmdID )
+		{
+		case CommandDefinition::BenchmarkSound:
+			{
+			// optional voice count and length, defaulting to a big battle
+			int voices = 32;
+			int seconds = 60;
+			GetWord( cmdStr, &word );
+			if ( ResolveInt( &word, &voices, false ) )
+				{
+				GetWord( cmdStr, &word );
+				(void) ResolveInt( &word, &seconds, false );
+				}
+			if ( voices < 1 || voices > kMixMaxVoices )
+				voices = 32;
+			if ( seconds < 1 )
+				seconds = 60;
+			
+			DTSMixBenchmarkResult bench;
+			DTSError result = DTSMixerBenchmark( voices, seconds, &bench );
+			if ( noErr != result )
+				{
+				GenericError( _(TXTCL_CMD_BENCHMARK_SOUND_FAILED), static_cast<int>( result ) );
+				break;
+				}
+			
+				/* "* Mixed %.0f seconds of sound on %d voices in %.3f seconds (%.0fx real time); %lu sounds started, %lu cut short." */
+			msg.Format( _(TXTCL_CMD_BENCHMARK_SOUND),
+				bench.mbAudioSeconds, bench.mbVoices, bench.mbCPUSeconds,
+				bench.mbRealtimeFactor, bench.mbPlayCalls, bench.mbSteals );
+			ShowInfoText( msg.Get() );
+			
+			if ( bench.mbMismatches )
+				{
+					/* "* The mixer differed from the reference mix on %d samples!" */
+				msg.Clear();
+				msg.Format( _(TXTCL_CMD_BENCHMARK_SOUND_DIFFER), bench.mbMismatches );
+				ShowInfoText( msg.Get() );
+				}
+			}
+			break;
+		
+		case CommandDefinition::BenchmarkTune:
+			{
+			// optional number of times to build the trio
+			int rounds = 1000;
+			GetWord( cmdStr, &word );
+			if ( not ResolveInt( &word, &rounds, false ) || rounds < 1 )
+				rounds = 1000;
+			
+			STuneBenchmark bench;
+			OSStatus result = TuneBenchmark( rounds, &bench );
+			if ( noErr != result )
+				{
+				GenericError( _(TXTCL_CMD_BENCHMARK_TUNE_FAILED), static_cast<int>( result ) );
+				break;
+				}
+				
+				/* "* Built %ld songs (%ld ops per trio) in %.3f seconds, or %.3f seconds from the cache; rendered %ld notes in %.3f seconds." */
+			msg.Format( _(TXTCL_CMD_BENCHMARK_TUNE),
+				bench.tbBuilds, bench.tbOps, bench.tbColdSeconds, bench.tbWarmSeconds,
+				bench.tbEvents * rounds, bench.tbRenderSeconds );
+			ShowInfoText( msg.Get() );
+			}
+			break;
+		
+		case CommandDefinition::BenchmarkLoopback:
+			{
+			// one session at a time
+			if ( gPlayingGame )
+				{
+				ShowInfoText( _(TXTCL_CMD_BENCHMARK_LOOPBACK_PLAYING) );
+				break;
+				}
+			
+			// optional port, defaulting to the loopback server's
+			int port = 5010;
+			GetWord( cmdStr, &word );
+			if ( not ResolveInt( &word, &port, false ) || port < 1 || port > 0xFFFF )
+				port = 5010;
+				
+				/* "* Joining the loopback server on port %d." */
+			msg.Format( _(TXTCL_CMD_BENCHMARK_LOOPBACK), port );
+			ShowInfoText( msg.Get() );
+			
+			SetLoopbackPort( port );
+			OSStatus result = PerformAutoJoin();
+			if ( noErr != result )
+				{
+				SetLoopbackPort( 0 );
+				GenericError( _(TXTCL_CMD_BENCHMARK_LOOPBACK_FAILED), static_cast<int>( result ) );
+				}
+			}
+			break;
+		
+		case CommandDefinition::BenchmarkDescTable:
+			{
+			// optional number of passes, each like one redraw plus one drawstate
+			int rounds = 100000;
+			GetWord( cmdStr, &word );
+			if ( not ResolveInt( &word, &rounds, false ) || rounds < 1 )
+				rounds = 100000;
+			
+			SDescBenchmark bench;
+			DescTableBenchmark( rounds, &bench );
+			
+				/* "* Walked %d descriptors and %d mobiles %d times: %.3f seconds as stored (%d bytes each), %.3f seconds as kept (%d bytes each)." */
+			msg.Format( _(TXTCL_CMD_BENCHMARK_DESCTABLE),
+				kDescTableSize, kDescBenchmarkMobiles, bench.dbRounds,
+				bench.dbWarmRecord, static_cast<int>( sizeof(DescRecord) ),
+				bench.dbWarmTable, static_cast<int>( sizeof(DescTable) ) );
+			ShowInfoText( msg.Get() );
+			
+				/* "* With a cold cache, %d times: %.1f microseconds each as stored, %.1f as kept." */
+			msg.Clear();
+			msg.Format( _(TXTCL_CMD_BENCHMARK_DESCTABLE_COLD), bench.dbColdRounds,
+				bench.dbColdRecord * 1.0e6 / bench.dbColdRounds,
+				bench.dbColdTable * 1.0e6 / bench.dbColdRounds );
+			ShowInfoText( msg.Get() );
+			}
+			break;
+		
+		case CommandDefinition::BenchmarkPlayers:
+			{
+			// optional history size and number of frames
+			int players = 10000;
+			int rounds = 10000;
+			GetWord( cmdStr, &word );
+			if ( ResolveInt( &word, &players, false ) )
+				{
+				GetWord( cmdStr, &word );
+				(void) ResolveInt( &word, &rounds, false );
+				}
+			if ( players < 100 || players > 65536 )
+				players = 10000;
+			if ( rounds < 1 )
+				rounds = 10000;
+			
+			SPlayerBenchmark bench;
+			PlayerIndexBenchmark( players, rounds, &bench );
+			
+				/* "* %d players: built the tree in %.3f seconds and the index in %.3f; %d lookups took %.3f seconds in the tree and %.3f in the index." */
+			msg.Format( _(TXTCL_CMD_BENCHMARK_PLAYERS), bench.pbPlayers,
+				bench.pbTreeBuildSeconds, bench.pbIndexBuildSeconds,
+				bench.pbLookups, bench.pbTreeSeconds, bench.pbIndexSeconds );
+			ShowInfoText( msg.Get() );
+			}
+			break;
+		
+		case CommandDefinition::BenchmarkRegExp:
+			{
+			// a text log to read, and optionally how many times to go through it
+			SafeString fname;
+			GetWord( cmdStr, &fname );
+			int rounds = 10;
+			GetWord( cmdStr, &word );
+			if ( not ResolveInt( &word, &rounds, false ) || rounds < 1 )
+				rounds = 10;
+			
+			SRegExpBenchmark bench;
+			DTSError result = RegExpBenchmark( fname.Get(), rounds, &bench );
+			if ( noErr != result )
+				{
+				GenericError( _(TXTCL_CMD_BENCHMARK_REGEXP_NOLOG),
+					fname.Get(), static_cast<int>( result ) );
+				break;
+				}
+			
+			double megabytes = double( bench.rbBytes ) * bench.rbRounds / 1.0e6;
+			for ( int n = 0;  n < kRegExpBenchmarkPatterns;  ++n )
+				{
+				double dfaSeconds = bench.rbDFASeconds[ n ];
+				double backtrackSeconds = bench.rbBacktrackSeconds[ n ];
+				
+					/* "* /%s/ matched %d of %d lines. %d times over took %.3f seconds with the DFA (%.1f MB/s), %.3f without (%.1f MB/s)." */
+				msg.Clear();
+				msg.Format( _(TXTCL_CMD_BENCHMARK_REGEXP),
+					bench.rbPattern[ n ], bench.rbMatches[ n ], bench.rbLines, bench.rbRounds,
+					dfaSeconds, dfaSeconds > 0 ? megabytes / dfaSeconds : 0,
+					backtrackSeconds, backtrackSeconds > 0 ? megabytes / backtrackSeconds : 0 );
+				ShowInfoText( msg.Get() );
+				}
+			
+			if ( bench.rbDisagreements )
+				{
+					/* "* The DFA and the backtracking matcher disagreed %d times!" */
+				msg.Clear();
+				msg.Format( _(TXTCL_CMD_BENCHMARK_REGEXP_DIFFER), bench.rbDisagreements );
+				ShowInfoText( msg.Get() );
+				}
+			}
+			break;
+		
+		case CommandDefinition::BenchmarkBlit:
+			{
+			// optional number of times to blit each way
+			int rounds = 200;
+			GetWord( cmdStr, &word );
+			if ( not ResolveInt( &word, &rounds, false ) || rounds < 1 )
+				rounds = 200;
+			
+			SBlitBenchmark bench;
+			if ( noErr != BlitBenchmark( rounds, &bench ) )
+				{
+				GenericError( _(TXTCL_CMD_BENCHMARK_BLIT_NOMEMORY) );
+				break;
+				}
+				
+				/* "* Blitted %d pixels %d times each way; the game is using the %s blitters." */
+			msg.Format( _(TXTCL_CMD_BENCHMARK_BLIT), bench.bbPixels, bench.bbRounds,
+				bench.bbSelected );
+			ShowInfoText( msg.Get() );
+			
+			double pixels = double( bench.bbPixels ) * bench.bbRounds / 1.0e6;
+			for ( int k = 0;  k < bench.bbNumKernels;  ++k )
+				{
+				double rate[ kBlitBenchmarkOps ];
+				for ( int op = 0;  op < kBlitBenchmarkOps;  ++op )
+					{
+					double seconds = bench.bbSeconds[ k ][ op ];
+					rate[ op ] = seconds > 0 ? pixels / seconds : 0;
+					}
+					
+					/* "* %s: transparent %.0f, 25%% %.0f/%.0f, 50%% %.0f/%.0f, 75%% %.0f/%.0f, quality %.0f megapixels a second." */
+				msg.Clear();
+				msg.Format( _(TXTCL_CMD_BENCHMARK_BLIT_KERNEL), bench.bbKernel[ k ],
+					rate[0], rate[1], rate[2], rate[3], rate[4], rate[5], rate[6], rate[7] );
+				ShowInfoText( msg.Get() );
+				}
+			
+			if ( bench.bbMismatches )
+				{
+					/* "* The vector blitters differed from the scalar ones %d times!" */
+				msg.Clear();
+				msg.Format( _(TXTCL_CMD_BENCHMARK_BLIT_DIFFER), bench.bbMismatches );
+				ShowInfoText( msg.Get() );
+				}
+			}
+			break;
+		
+		case CommandDefinition::BenchmarkDownload:
+			{
+			// the URL of a .gz file; point it at CLRangeServer to time
+			// the downloader without the internet getting in the way
+			SafeString url;
+			GetWord( cmdStr, &url );
+			
+			HFSUniStr255 name;
+			name.length = 0;
+			const char * leaf = strrchr( url.Get(), '/' );
+			if ( CFStringRef cfName = CreateCFString( leaf ? leaf + 1 : url.Get() ) )
+				{
+				(void) FSGetHFSUniStrFromString( cfName, &name );
+				CFRelease( cfName );
+				}
+			
+			// expand it into the void
+			std::FILE * out = std::tmpfile();
+			if ( not out )
+				{
+				GenericError( _(TXTCL_CMD_BENCHMARK_DOWNLOAD_NOTEMP) );
+				break;
+				}
+			SDownloadStats stats;
+			DTSError result = DownloadInflateURL( url.Get(), out, name, &stats );
+			std::fclose( out );
+			if ( noErr != result )
+				{
+				GenericError( _(TXTCL_CMD_BENCHMARK_DOWNLOAD_FAILED),
+					url.Get(), static_cast<int>( result ) );
+				break;
+				}
+			
+			double seconds = stats.dsSeconds > 0 ? stats.dsSeconds : 1.0e-6;
+				/* "* Downloaded %lld bytes (%lld expanded) in %.3f seconds (%.1f MB/s) on %d connections, with %d reconnects." */
+			msg.Format( _(TXTCL_CMD_BENCHMARK_DOWNLOAD),
+				(long long) stats.dsBytesIn, (long long) stats.dsBytesOut, stats.dsSeconds,
+				double( stats.dsBytesIn ) / 1.0e6 / seconds,
+				stats.dsStreams, stats.dsReconnects );
+			ShowInfoText( msg.Get() );
+			}
+			break;
+		
+		case CommandDefinition::BenchmarkStartup:
+			// nothing to run; just report what this session's startup took
+			ShowStartupTrace();
+			break;
+		}
+}
+
+
 // ClientCommand::HandleLoggedServerCommand
 //
 // Print out something that resembles what they did, even though we don't know the outcome
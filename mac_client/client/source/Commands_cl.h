@@ -55,6 +55,11 @@ namespace ClientCommand
 #endif
 	void HandleSelectItemCommand( SafeString * cmdStr );
 	void HandleMovieCommand( SafeString * cmdStr );
+#if DTS_ALLOC_PROFILE
+	void HandleMemStatsCommand( int cmd_id, SafeString * cmdStr );
+#endif
+	void HandleNetStatsCommand( int cmd_id, SafeString * cmdStr );
+	void HandleBenchmarkCommand( int cmd_id, SafeString * cmdStr );
 	
 	void HandleLoggedServerCommand( int cmd_id, SafeString * cmdStr );
 	
@@ -82,7 +87,10 @@ struct CommandDefinition
 //		CatEquip,
 //		CatUnequip,
 		CatSelectItem,
-		CatMovie
+		CatMovie,
+		CatMemStats,
+		CatBenchmark,
+		CatNetStats
 	};
 	
 	// Server commands that we log
@@ -120,6 +128,7 @@ struct CommandDefinition
 			
 			PrefLargeWindow, PrefShowNames, PrefBrightColors,PrefTimeStamps, PrefMaxNightPercent,
 			PrefSoundVolume, PrefNewLogEveryJoin, PrefNoMovieTextLogs, PrefBardVolume,
+			PrefSmoothMotion, PrefSmoothLatency,
 		
 		Move = MakeLong( CatMove, 1 ),
 			MoveWalk, MoveRun,
@@ -131,7 +140,18 @@ struct CommandDefinition
 		
 		SelectItem = MakeLong( CatSelectItem, 1 ),
 		
-		RecordMovie = MakeLong( CatMovie, 1 )
+		RecordMovie = MakeLong( CatMovie, 1 ),
+		
+		MemStats = MakeLong( CatMemStats, 1 ),
+			MemStatsShow, MemStatsReset, MemStatsLog, MemStatsCount,
+		
+		Benchmark = MakeLong( CatBenchmark, 1 ),
+			BenchmarkSound, BenchmarkTune, BenchmarkLoopback, BenchmarkDescTable,
+			BenchmarkPlayers, BenchmarkRegExp, BenchmarkBlit, BenchmarkDownload,
+			BenchmarkStartup,
+		
+		NetStats = MakeLong( CatNetStats, 1 ),
+			NetStatsShow, NetStatsReset, NetStatsOverlay, NetStatsLog
 	};
 };
 
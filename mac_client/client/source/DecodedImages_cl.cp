@@ -0,0 +1,707 @@
+/*
+**	DecodedImages_cl.cp		Clanlord Client
+** 
+**	Copyright 2023 Delta Tao Software, Inc.
+** 
+**	Licensed under the Apache License, Version 2.0 (the "License");
+**	you may not use this file except in compliance with the License.
+**	You may obtain a copy of the License at
+** 
+**     https://www.apache.org/licenses/LICENSE-2.0
+** 
+**	Unless required by applicable law or agreed to in writing, software
+**	distributed under the License is distributed on an "AS IS" BASIS,
+**	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+**	See the License for the specific language governing permissions and
+**	imitations under the License.
+*/
+
+/*
+**	keeps decoded picture frames on disk, from one session to the next.
+**
+**	every picture that came into the cache used to be read out of CL_Images and run
+**	through DecompressImage() again, even the town terrain and bubble frames that
+**	every session draws. now the 8-bit pixels of each frame that gets decoded are
+**	also kept in CL_Decoded, next to CL_Images, keyed by picture ID and custom colors,
+**	and checked against a fingerprint of the PictDef. At startup the file is mapped read-only, and a
+**	picture found there is drawn straight out of the mapping: the ImageCache's
+**	DTSImage points at the mapped pixels, and holds a reference to the mapping so it
+**	stays valid as long as the cache does. Loading such a picture costs a page fault,
+**	not a decode.
+**
+**	the file is only rewritten at quit, and only if new frames were decoded: the frames
+**	used most recently (in sessions) are kept, up to kDecodedImagesMaxSize. If the
+**	session merely used frames already there, only their last-used stamps are patched.
+**	A different images-file version throws the whole thing away.
+*/
+
+#include "ClanLord.h"
+
+
+/*
+**	Entry Routines
+*/
+/*
+void	OpenDecodedImages();
+void	CloseDecodedImages();
+void	InvalidateDecodedImages();
+bool	FindDecodedImage( DTSKeyID id, const PictDef * pd, int numColors,
+			const uchar * colors, ImageCache * cache );
+void	KeepDecodedImage( DTSKeyID id, const PictDef * pd, int numColors,
+			const uchar * colors, const CLImage * image );
+*/
+
+
+/*
+**	Definitions
+*/
+#define kDecodedImagesFName		"CL_Decoded"
+#define kDecodedImagesTempFName	"CL_Decoded.new"
+
+const uint32_t	kDecodedImagesMagic		= 'CLdi';		// also tells us the byte order
+const uint32_t	kDecodedImagesFormat	= 3;		// 3: fingerprints cover record placement
+const uint64_t	kDecodedImagesMaxSize	= 64 * 1024 * 1024;	// bytes of pixels in the file
+const uint64_t	kDecodedFrameAlign		= 16;
+
+
+/*
+**	Internal Classes
+*/
+
+// the file: this header, dhCount entries sorted by CompareDecodedKeys(), then the pixels.
+// It never leaves this machine, so everything is native-endian.
+struct DecodedImagesHeader
+{
+	uint32_t		dhMagic;			// kDecodedImagesMagic
+	uint32_t		dhFormat;			// kDecodedImagesFormat
+	uint32_t		dhEntrySize;		// sizeof( DecodedImageEntry )
+	int32_t			dhImagesVersion;	// gImagesVersion the frames were decoded from
+	uint32_t		dhSession;			// bumped every time the file is written
+	uint32_t		dhCount;
+	uint64_t		dhFileSize;			// to catch a truncated file
+};
+
+struct DecodedImageEntry
+{
+	int32_t			deID;
+	uint32_t		deColorKey;			// hash of the colors; 0 for the picture's own
+	uint32_t		deNumColors;
+	uchar			deColors[ kNumPlyColors ];	// the colors themselves, since hashes collide
+	uint32_t		deFingerprint;		// FingerprintPictDef()
+	uint32_t		deLastUsed;			// dhSession when it was last drawn
+	int32_t			deWidth;
+	int32_t			deHeight;
+	int32_t			deRowBytes;
+	uint32_t		deSize;				// deHeight * deRowBytes
+	uint64_t		deOffset;			// from the start of the file
+	LightingData	deLight;			// native endian
+};
+
+// a frame decoded this session, waiting to be written
+struct PendingFrame
+{
+	DecodedImageEntry	pfEntry;		// deOffset unused
+	uchar *				pfBits;
+};
+
+// one frame that might make it into the next file
+struct DecodedCandidate
+{
+	const DecodedImageEntry *	dcEntry;
+	const uchar *				dcBits;
+	bool						dcNew;			// decoded this session
+};
+
+
+/*
+**	Internal Variables
+*/
+static DTSFileSpec *			sDecodedSpec;		// where the file lives
+static DTSFileMapping *			sDecodedMapping;
+static const DecodedImageEntry *	sDecodedEntries;	// in the mapping; nullptr if none usable
+static uint32_t					sDecodedCount;
+static uint32_t *				sLastUsed;			// [sDecodedCount] our copy of deLastUsed
+static uint32_t					sSession;			// this session's stamp
+static bool						sTouched;			// some sLastUsed changed
+static bool						sStale;				// the file's frames are no good any more
+
+static PendingFrame *			sPending;
+static uint32_t					sNumPending;
+static uint32_t					sMaxPending;
+static uint64_t					sPendingBytes;
+
+
+/*
+**	Internal Routines
+*/
+static void		SetDecodedKey( DecodedImageEntry * e, DTSKeyID id, const PictDef * pd,
+					int numColors, const uchar * colors );
+static int		CompareDecodedKeys( const DecodedImageEntry * e1, const DecodedImageEntry * e2 );
+static int		CompareCandidateKeys( const void *, const void * );
+static int		CompareCandidateAges( const void *, const void * );
+static const DecodedImageEntry *	LookupDecoded( const DecodedImageEntry * key );
+static bool		IsPending( const DecodedImageEntry * key );
+static void		ForgetDecodedImages();
+static void		WriteDecodedImages();
+static void		PatchDecodedImages();
+
+
+/*
+**	OpenDecodedImages()
+**
+**	map CL_Decoded, if it's there and belongs to this images file.
+**	call once CL_Images is open, and gImagesVersion is known.
+*/
+void
+OpenDecodedImages()
+{
+	CloseDecodedImages();
+	
+	// remember where it is, since the current directory won't stay put
+	if ( not sDecodedSpec )
+		{
+		sDecodedSpec = NEW_TAG("DecodedImagesSpec") DTSFileSpec;
+		if ( not sDecodedSpec )
+			return;
+		}
+	sDecodedSpec->GetCurDir();
+	sDecodedSpec->SetFileName( kDecodedImagesFName );
+	
+	sSession = 1;
+	sStale = false;
+	if ( 0 == gImagesVersion
+	||   noErr != DTS_map( sDecodedSpec, &sDecodedMapping ) )
+		{
+		return;
+		}
+	
+	const DecodedImagesHeader * header =
+		reinterpret_cast<const DecodedImagesHeader *>( sDecodedMapping->mapData );
+	size_t size = sDecodedMapping->mapSize;
+	
+	bool bGood = size >= sizeof *header
+			&&   kDecodedImagesMagic == header->dhMagic
+			&&   kDecodedImagesFormat == header->dhFormat
+			&&   sizeof( DecodedImageEntry ) == header->dhEntrySize
+			&&   size == header->dhFileSize
+			&&   header->dhCount <= ( size - sizeof *header ) / sizeof( DecodedImageEntry );
+	if ( bGood )
+		{
+		sSession = header->dhSession + 1;
+		
+		// a new images file: nothing decoded from the old one counts
+		if ( header->dhImagesVersion != gImagesVersion )
+			bGood = false;
+		}
+	
+	// make sure every frame is inside the file
+	const DecodedImageEntry * entries = reinterpret_cast<const DecodedImageEntry *>( header + 1 );
+	for ( uint32_t n = 0; bGood && n < header->dhCount; ++n )
+		{
+		const DecodedImageEntry * e = &entries[ n ];
+		if ( e->deWidth <= 0 || e->deHeight <= 0 || e->deRowBytes < e->deWidth
+		||   uint64_t( e->deHeight ) * uint64_t( e->deRowBytes ) != e->deSize
+		||   e->deOffset > size || e->deSize > size - e->deOffset
+		||   e->deNumColors > uint32_t( kNumPlyColors ) )
+			{
+			bGood = false;
+			}
+		}
+	
+	if ( bGood && header->dhCount )
+		{
+		sLastUsed = NEW_TAG("DecodedLastUsed") uint32_t[ header->dhCount ];
+		if ( not sLastUsed )
+			bGood = false;
+		}
+	
+	if ( not bGood )
+		{
+		// don't leave it to be tried again next time
+		sStale = true;
+		return;
+		}
+	
+	sDecodedEntries = entries;
+	sDecodedCount	= header->dhCount;
+	for ( uint32_t n = 0; n < sDecodedCount; ++n )
+		sLastUsed[ n ] = entries[ n ].deLastUsed;
+}
+
+
+/*
+**	CloseDecodedImages()
+**
+**	write out whatever this session added (or just the fact that it used
+**	what was there), and let go of the file. Caches drawing from the mapping
+**	keep it alive on their own.
+*/
+void
+CloseDecodedImages()
+{
+	if ( sDecodedSpec )
+		{
+		if ( sNumPending )
+			WriteDecodedImages();
+		else
+		if ( sStale )
+			(void) sDecodedSpec->Delete();
+		else
+		if ( sTouched )
+			PatchDecodedImages();
+		}
+	
+	ForgetDecodedImages();
+	
+	if ( sDecodedMapping )
+		DTS_releasemap( sDecodedMapping );
+	sDecodedMapping = nullptr;
+	sStale = false;
+}
+
+
+/*
+**	InvalidateDecodedImages()
+**
+**	the images file is about to be rewritten
+*/
+void
+InvalidateDecodedImages()
+{
+	ForgetDecodedImages();
+	if ( sDecodedSpec )
+		sStale = true;
+}
+
+
+/*
+**	ForgetDecodedImages()
+**
+**	drop the lookup table and anything pending; the mapping itself stays
+*/
+void
+ForgetDecodedImages()
+{
+	for ( uint32_t n = 0; n < sNumPending; ++n )
+		delete[] sPending[ n ].pfBits;
+	delete[] sPending;
+	sPending		= nullptr;
+	sNumPending		= 0;
+	sMaxPending		= 0;
+	sPendingBytes	= 0;
+	
+	delete[] sLastUsed;
+	sLastUsed		= nullptr;
+	sDecodedEntries	= nullptr;
+	sDecodedCount	= 0;
+	sTouched		= false;
+}
+
+
+/*
+**	SetDecodedKey()
+**
+**	fill in the fields that identify a frame: its ID and, if the picture takes
+**	custom colors, the colors and an FNV-1a hash of them. LoadImage() ignores the
+**	colors of any other picture, so those all share the one uncolored frame.
+*/
+void
+SetDecodedKey( DecodedImageEntry * e, DTSKeyID id, const PictDef * pd,
+	int numColors, const uchar * colors )
+{
+	e->deID			= id;
+	e->deColorKey	= 0;
+	e->deNumColors	= 0;
+	memset( e->deColors, 0, sizeof e->deColors );
+	
+	if ( numColors <= 0 || not colors
+	||   not (pd->pdFlags & kPictDefCustomColors) )
+		{
+		return;
+		}
+	if ( numColors > kNumPlyColors )
+		numColors = kNumPlyColors;
+	
+	uint32_t hash = 2166136261U;
+	hash ^= uint32_t( numColors );
+	hash *= 16777619U;
+	for ( int n = 0; n < numColors; ++n )
+		{
+		hash ^= colors[ n ];
+		hash *= 16777619U;
+		}
+	
+	e->deColorKey	= hash ? hash : 1;
+	e->deNumColors	= uint32_t( numColors );
+	memcpy( e->deColors, colors, numColors );
+}
+
+
+/*
+**	CompareDecodedKeys()
+**
+**	the order of the file's entries: by ID, then color hash, then the colors
+**	themselves, so two color sets that hash alike are still told apart
+*/
+int
+CompareDecodedKeys( const DecodedImageEntry * e1, const DecodedImageEntry * e2 )
+{
+	if ( e1->deID != e2->deID )
+		return e1->deID < e2->deID ? -1 : 1;
+	if ( e1->deColorKey != e2->deColorKey )
+		return e1->deColorKey < e2->deColorKey ? -1 : 1;
+	if ( e1->deNumColors != e2->deNumColors )
+		return e1->deNumColors < e2->deNumColors ? -1 : 1;
+	return memcmp( e1->deColors, e2->deColors, sizeof e1->deColors );
+}
+
+
+/*
+**	LookupDecoded()
+**
+**	binary search of the mapped entries
+*/
+const DecodedImageEntry *
+LookupDecoded( const DecodedImageEntry * key )
+{
+	uint32_t lo = 0;
+	uint32_t hi = sDecodedCount;
+	while ( lo < hi )
+		{
+		uint32_t mid = ( lo + hi ) / 2;
+		const DecodedImageEntry * e = &sDecodedEntries[ mid ];
+		int cmp = CompareDecodedKeys( key, e );
+		if ( 0 == cmp )
+			return e;
+		if ( cmp < 0 )
+			hi = mid;
+		else
+			lo = mid + 1;
+		}
+	
+	return nullptr;
+}
+
+
+/*
+**	FindDecodedImage()
+**
+**	if this picture, in these colors, was decoded in an earlier session,
+**	point the cache's image at its pixels in the mapping and return true.
+**	the PictDef must already be in cache->icImage.
+*/
+bool
+FindDecodedImage( DTSKeyID id, const PictDef * pd, int numColors, const uchar * colors,
+	ImageCache * cache )
+{
+	if ( not sDecodedEntries )
+		return false;
+	
+	DecodedImageEntry key;
+	SetDecodedKey( &key, id, pd, numColors, colors );
+	const DecodedImageEntry * e = LookupDecoded( &key );
+	if ( not e
+	||   e->deFingerprint != FingerprintPictDef( pd ) )
+		{
+		return false;
+		}
+	
+	CLImage * image = &cache->icImage;
+	if ( noErr != image->cliImage.Init( nullptr, e->deWidth, e->deHeight, 8 )
+	||   image->cliImage.GetRowBytes() != e->deRowBytes )
+		{
+		return false;
+		}
+	
+	// the bits are read-only; nothing draws into a cached picture
+	image->cliImage.SetBits( const_cast<uchar *>( sDecodedMapping->mapData + e->deOffset ) );
+	image->cliLightInfo = e->deLight;
+	
+	DTS_retainmap( sDecodedMapping );
+	cache->icMapping = sDecodedMapping;
+	
+	uint32_t index = uint32_t( e - sDecodedEntries );
+	if ( sLastUsed[ index ] != sSession )
+		{
+		sLastUsed[ index ] = sSession;
+		sTouched = true;
+		}
+	
+	return true;
+}
+
+
+/*
+**	IsPending()
+**
+**	has this frame already been queued this session?
+*/
+bool
+IsPending( const DecodedImageEntry * key )
+{
+	for ( uint32_t n = 0; n < sNumPending; ++n )
+		{
+		if ( 0 == CompareDecodedKeys( key, &sPending[ n ].pfEntry ) )
+			return true;
+		}
+	
+	return false;
+}
+
+
+/*
+**	KeepDecodedImage()
+**
+**	a picture was just decoded (and checksummed); save its pixels for next time
+*/
+void
+KeepDecodedImage( DTSKeyID id, const PictDef * pd, int numColors, const uchar * colors,
+	const CLImage * image )
+{
+	if ( not sDecodedSpec || 0 == gImagesVersion )
+		return;
+	
+	DTSRect bounds;
+	image->cliImage.GetBounds( &bounds );
+	int32_t width		= bounds.rectRight - bounds.rectLeft;
+	int32_t height		= bounds.rectBottom - bounds.rectTop;
+	int32_t rowBytes	= image->cliImage.GetRowBytes();
+	uint64_t size		= uint64_t( height ) * uint64_t( rowBytes );
+	if ( width <= 0 || height <= 0
+	||   8 != image->cliImage.GetDepth()
+	||   not image->cliImage.GetBits()
+	||   sPendingBytes + size > kDecodedImagesMaxSize )
+		{
+		return;
+		}
+	
+	DecodedImageEntry key;
+	SetDecodedKey( &key, id, pd, numColors, colors );
+	if ( IsPending( &key ) )
+		return;
+	
+	if ( sNumPending >= sMaxPending )
+		{
+		uint32_t newMax = sMaxPending ? 2 * sMaxPending : 256;
+		PendingFrame * newPending = NEW_TAG("DecodedPending") PendingFrame[ newMax ];
+		if ( not newPending )
+			return;
+		if ( sNumPending )
+			memcpy( newPending, sPending, sNumPending * sizeof sPending[0] );
+		delete[] sPending;
+		sPending	= newPending;
+		sMaxPending	= newMax;
+		}
+	
+	uchar * bits = NEW_TAG("DecodedPendingBits") uchar[ size ];
+	if ( not bits )
+		return;
+	memcpy( bits, image->cliImage.GetBits(), size );
+	
+	PendingFrame * pf = &sPending[ sNumPending++ ];
+	memset( &pf->pfEntry, 0, sizeof pf->pfEntry );
+	SetDecodedKey( &pf->pfEntry, id, pd, numColors, colors );
+	pf->pfEntry.deFingerprint	= FingerprintPictDef( pd );
+	pf->pfEntry.deLastUsed		= sSession;
+	pf->pfEntry.deWidth			= width;
+	pf->pfEntry.deHeight		= height;
+	pf->pfEntry.deRowBytes		= rowBytes;
+	pf->pfEntry.deSize			= uint32_t( size );
+	pf->pfEntry.deLight			= image->cliLightInfo;
+	pf->pfBits					= bits;
+	sPendingBytes += size;
+}
+
+
+/*
+**	CompareCandidateAges()
+**
+**	qsort: most recently used first
+*/
+int
+CompareCandidateAges( const void * a, const void * b )
+{
+	const DecodedCandidate * c1 = static_cast<const DecodedCandidate *>( a );
+	const DecodedCandidate * c2 = static_cast<const DecodedCandidate *>( b );
+	if ( c1->dcEntry->deLastUsed != c2->dcEntry->deLastUsed )
+		return c1->dcEntry->deLastUsed > c2->dcEntry->deLastUsed ? -1 : 1;
+	
+	// the ones we had to decode this time are the ones worth keeping
+	if ( c1->dcNew != c2->dcNew )
+		return c1->dcNew ? -1 : 1;
+	return 0;
+}
+
+
+/*
+**	CompareCandidateKeys()
+**
+**	qsort: the file's order
+*/
+int
+CompareCandidateKeys( const void * a, const void * b )
+{
+	const DecodedImageEntry * e1 = static_cast<const DecodedCandidate *>( a )->dcEntry;
+	const DecodedImageEntry * e2 = static_cast<const DecodedCandidate *>( b )->dcEntry;
+	return CompareDecodedKeys( e1, e2 );
+}
+
+
+/*
+**	WriteDecodedImages()
+**
+**	write a new CL_Decoded: this session's frames, plus as many of the old ones as
+**	fit, most recently used first. It's written beside the old file and renamed over
+**	it, so the old mapping -- which is where the old frames come from, and which
+**	caches may still be drawing from -- is never disturbed.
+*/
+void
+WriteDecodedImages()
+{
+	uint32_t maxCandidates = sDecodedCount + sNumPending;
+	DecodedCandidate * candidates = NEW_TAG("DecodedCandidates") DecodedCandidate[ maxCandidates ];
+	DecodedImageEntry * entries = NEW_TAG("DecodedEntries") DecodedImageEntry[ maxCandidates ];
+	if ( not candidates || not entries )
+		{
+		delete[] candidates;
+		delete[] entries;
+		return;
+		}
+	
+	// the old frames get their new last-used stamps; the sort only looks at entries[]
+	uint32_t count = 0;
+	for ( uint32_t n = 0; n < sDecodedCount; ++n )
+		{
+		const DecodedImageEntry * e = &sDecodedEntries[ n ];
+		if ( IsPending( e ) )
+			continue;
+		entries[ count ] = *e;
+		entries[ count ].deLastUsed = sLastUsed[ n ];
+		candidates[ count ].dcEntry = &entries[ count ];
+		candidates[ count ].dcBits  = sDecodedMapping->mapData + e->deOffset;
+		candidates[ count ].dcNew   = false;
+		++count;
+		}
+	for ( uint32_t n = 0; n < sNumPending; ++n )
+		{
+		entries[ count ] = sPending[ n ].pfEntry;
+		candidates[ count ].dcEntry = &entries[ count ];
+		candidates[ count ].dcBits  = sPending[ n ].pfBits;
+		candidates[ count ].dcNew   = true;
+		++count;
+		}
+	
+	// keep the newest, up to the size limit
+	qsort( candidates, count, sizeof candidates[0], CompareCandidateAges );
+	uint64_t pixelBytes = 0;
+	uint32_t kept = 0;
+	for ( ; kept < count; ++kept )
+		{
+		uint64_t size = candidates[ kept ].dcEntry->deSize;
+		if ( pixelBytes + size > kDecodedImagesMaxSize )
+			break;
+		pixelBytes += ( size + kDecodedFrameAlign - 1 ) & ~( kDecodedFrameAlign - 1 );
+		}
+	qsort( candidates, kept, sizeof candidates[0], CompareCandidateKeys );
+	
+	// lay it out
+	DecodedImagesHeader header;
+	memset( &header, 0, sizeof header );
+	header.dhMagic			= kDecodedImagesMagic;
+	header.dhFormat			= kDecodedImagesFormat;
+	header.dhEntrySize		= sizeof( DecodedImageEntry );
+	header.dhImagesVersion	= gImagesVersion;
+	header.dhSession		= sSession;
+	header.dhCount			= kept;
+	
+	uint64_t offset = sizeof header + uint64_t( kept ) * sizeof( DecodedImageEntry );
+	offset = ( offset + kDecodedFrameAlign - 1 ) & ~( kDecodedFrameAlign - 1 );
+	DecodedImageEntry * table = NEW_TAG("DecodedTable") DecodedImageEntry[ kept ? kept : 1 ];
+	if ( not table )
+		{
+		delete[] candidates;
+		delete[] entries;
+		return;
+		}
+	for ( uint32_t n = 0; n < kept; ++n )
+		{
+		table[ n ] = *candidates[ n ].dcEntry;
+		table[ n ].deOffset = offset;
+		offset += ( table[ n ].deSize + kDecodedFrameAlign - 1 ) & ~( kDecodedFrameAlign - 1 );
+		}
+	header.dhFileSize = offset;
+	
+	// write it
+	DTSFileSpec tempSpec = *sDecodedSpec;
+	tempSpec.SetFileName( kDecodedImagesTempFName );
+	(void) tempSpec.Delete();
+	
+	bool bOK = false;
+	if ( std::FILE * fp = tempSpec.fopen( "wb" ) )
+		{
+		static const uchar zeros[ kDecodedFrameAlign ] = { 0 };
+		uint64_t pos = 0;
+		
+		bOK = 1 == std::fwrite( &header, sizeof header, 1, fp )
+		  &&  ( 0 == kept || kept == std::fwrite( table, sizeof table[0], kept, fp ) );
+		pos = sizeof header + uint64_t( kept ) * sizeof table[0];
+		
+		for ( uint32_t n = 0; bOK && n < kept; ++n )
+			{
+			size_t pad = size_t( table[ n ].deOffset - pos );
+			bOK = ( 0 == pad || pad == std::fwrite( zeros, 1, pad, fp ) )
+			  &&  table[ n ].deSize == std::fwrite( candidates[ n ].dcBits, 1,
+											table[ n ].deSize, fp );
+			pos = table[ n ].deOffset + table[ n ].deSize;
+			}
+		if ( bOK && pos < header.dhFileSize )
+			bOK = ( header.dhFileSize - pos ) == std::fwrite( zeros, 1,
+											size_t( header.dhFileSize - pos ), fp );
+		
+		if ( std::fclose( fp ) )
+			bOK = false;
+		}
+	
+	if ( bOK )
+		{
+		(void) sDecodedSpec->Delete();
+		bOK = ( noErr == tempSpec.Rename( kDecodedImagesFName ) );
+		}
+	if ( not bOK )
+		(void) tempSpec.Delete();
+	
+	delete[] table;
+	delete[] candidates;
+	delete[] entries;
+}
+
+
+/*
+**	PatchDecodedImages()
+**
+**	nothing new this session: just update the last-used stamps in place
+*/
+void
+PatchDecodedImages()
+{
+	std::FILE * fp = sDecodedSpec->fopen( "r+b" );
+	if ( not fp )
+		return;
+	
+	// stamp the file with this session, so the next one outranks it
+	long pos = long( offsetof( DecodedImagesHeader, dhSession ) );
+	bool bOK = 0 == std::fseek( fp, pos, SEEK_SET )
+			&& 1 == std::fwrite( &sSession, sizeof sSession, 1, fp );
+	
+	for ( uint32_t n = 0; bOK && n < sDecodedCount; ++n )
+		{
+		if ( sLastUsed[ n ] == sDecodedEntries[ n ].deLastUsed )
+			continue;
+		pos = long( sizeof( DecodedImagesHeader ) + n * sizeof( DecodedImageEntry )
+				  + offsetof( DecodedImageEntry, deLastUsed ) );
+		bOK = 0 == std::fseek( fp, pos, SEEK_SET )
+		   && 1 == std::fwrite( &sLastUsed[ n ], sizeof sLastUsed[0], 1, fp );
+		}
+	
+	std::fclose( fp );
+}
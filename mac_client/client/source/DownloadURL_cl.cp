@@ -60,6 +60,7 @@ static const char *	ExtractFileName( const char * start, const char * search,
 						char * filename, size_t size );
 static DTSError		InternalDownloadURL( const char * url, DTSFileSpec * spec,
 						CFMutableDataRef dest );
+static DTSError		StreamDownloadURL( const char * url, DTSFileSpec * spec );
 static DTSError		GotNewClient( DTSFileSpec& spec );
 static DTSError		AbdicateToNewClient( CFURLRef u );
 static DTSError		CreateURLForUnTarballedClient( CFURLRef inURL, CFURLRef& oURL );
@@ -454,10 +455,7 @@ AutoUpdateDataFile( const LogOn * msg, const char * dir, const char * findme )
 			snprintf( url, sizeof url, "%s%s/%s",
 				baseURL, kDataSubDirectory, filename );
 			DTSFileSpec spec;
-			DTSError result = InternalDownloadURL( url, &spec, nullptr );
-			if ( noErr == result )
-				result = ExpandFile( &spec );
-			return result;
+			return StreamDownloadURL( url, &spec );
 			}
 		
 		search = ExtractFileName( nullptr, search, filename, sizeof filename );
@@ -1045,6 +1043,111 @@ InternalDownloadURL( const char * url, DTSFileSpec * destSpec,
 }
 
 
+/*
+**	StreamDownloadURL()
+**
+**	download a .gz file from 'url' into the Downloads folder, expanding it
+**	as it arrives, so only the expanded file ever lands on disk.
+**	on success, *destSpec points to it (the leaf name minus ".gz"),
+**	which is just where InternalDownloadURL() + ExpandFile() would have left it.
+*/
+DTSError
+StreamDownloadURL( const char * url, DTSFileSpec * destSpec )
+{
+	// the leaf name, sans ".gz"
+	const char * fname = strrchr( url, '/' );
+	if ( not fname )
+		return -1;
+	++fname;
+	size_t namelen = strlen( fname );
+	if ( namelen <= 3
+	||	 strcmp( fname + namelen - 3, ".gz" ) != 0 )
+		{
+		// not something we know how to stream
+		DTSError result = InternalDownloadURL( url, destSpec, nullptr );
+		if ( noErr == result )
+			result = ExpandFile( destSpec );
+		return result;
+		}
+	
+	char outname[ 256 ];
+	StringCopySafe( outname, fname, sizeof outname );
+	outname[ namelen - 3 ] = '\0';
+	
+	// BULLET " Downloading updater data..."
+	ShowInfoText( _(TXTCL_DOWNLOADING_DATA) );
+	
+	DTSFileSpec saveSpec;
+	saveSpec.GetCurDir();
+	
+	// use local "Downloads" folder, same as InternalDownloadURL()
+	destSpec->SetFileName( kDownloadFolder );
+	(void) destSpec->CreateDir();
+	DTSError result = destSpec->SetDir();
+	if ( noErr != result )
+		{
+		// "Unable to create a download directory. (%d)"
+		GenericError( _(TXTCL_UNABLE_CREATE_DOWNLOAD_DIR), result );
+		saveSpec.SetDirNoPath();
+		return result;
+		}
+	destSpec->GetCurDir();
+	destSpec->SetFileName( outname );
+	
+	// delete previous leftovers, including any compressed download
+	// from an older client
+	(void) destSpec->Delete();
+	{
+	DTSFileSpec gzSpec = *destSpec;
+	gzSpec.SetFileName( fname );
+	(void) gzSpec.Delete();
+	}
+	
+	// the progress window wants a Unicode name
+	HFSUniStr255 uniName;
+	uniName.length = 0;
+	if ( CFStringRef cfName = CreateCFString( fname ) )
+		{
+		result = FSGetHFSUniStrFromString( cfName, &uniName );
+		__Check_noErr( result );
+		CFRelease( cfName );
+		}
+	else
+		result = memFullErr;
+	
+	FILE * output_file = nullptr;
+	if ( noErr == result )
+		{
+		output_file = destSpec->fopen( "wb" );
+		if ( not output_file )
+			result = fnOpnErr;
+		}
+	
+	if ( noErr == result )
+		{
+		SDownloadStats stats;
+		result = DownloadInflateURL( url, output_file, uniName, &stats );
+		
+		if ( fclose( output_file ) && noErr == result )
+			result = ioErr;
+			
+#if defined( DEBUG_VERSION )
+		ShowMessage( "%s: %lld -> %lld bytes, %d streams, %d reconnects, %.2f sec",
+			fname, (long long) stats.dsBytesIn, (long long) stats.dsBytesOut,
+			stats.dsStreams, stats.dsReconnects, stats.dsSeconds );
+#endif
+		
+		// don't leave half a file lying around
+		if ( noErr != result )
+			(void) destSpec->Delete();
+		}
+	
+	saveSpec.SetDirNoPath();
+	
+	return result;
+}
+
+
 /*
 **	scaffolding for expanding .gz files.
 */
@@ -39,12 +39,10 @@ void
 CCLFrame::Reset()
 {
 	mFrameLen		= 0;
-#ifdef DEBUG_VERSION
 	mExtraLen		= 0;
 	mDescLen		= 0;
 	mPictLen		= 0;
 	mMobileLen		= 0;
-#endif
 	mAckCmdNum		= 0;
 	mAckFrame		= 0;
 	mResentFrame	= 0;
@@ -67,13 +65,11 @@ CCLFrame::ReadKeyFromSpool( DataSpool * inSpool )
 {
 	int startMark	= inSpool->GetMark();
 	
-#ifdef DEBUG_VERSION
 	// initialize frame stats
 	mExtraLen		= 0;
 	mDescLen		= 0;
 	mPictLen		= 0;
 	mMobileLen		= 0;
-#endif	// DEBUG_VERSION
 	
 	mFrameLen		= 0;
 	
@@ -81,9 +77,7 @@ CCLFrame::ReadKeyFromSpool( DataSpool * inSpool )
 	mAckFrame 		= inSpool->GetNumber( kSpoolUnsignedLong );
 	mResentFrame 	= inSpool->GetNumber( kSpoolUnsignedLong );
 	
-#ifdef DEBUG_VERSION
 	int tempMark	= inSpool->GetMark();
-#endif	// DEBUG_VERSION
 	
 	// extract descriptors
 	mNumDesc		= inSpool->GetNumber( kSpoolUnsignedByte );
@@ -124,9 +118,7 @@ CCLFrame::ReadKeyFromSpool( DataSpool * inSpool )
 		desc.mNumColors	= inSpool->GetNumber( kSpoolUnsignedByte );
 		inSpool->GetData( desc.mColors, desc.mNumColors );
 		}
-#ifdef DEBUG_VERSION
 	mDescLen		= inSpool->GetMark() - tempMark;
-#endif	// DEBUG_VERSION
 	
 	// extract 'me' information
 	mHP				= inSpool->GetNumber( kSpoolUnsignedByte );
@@ -137,9 +129,7 @@ CCLFrame::ReadKeyFromSpool( DataSpool * inSpool )
 	mBalanceMax		= inSpool->GetNumber( kSpoolUnsignedByte );
 	mLightFlags		= inSpool->GetNumber( kSpoolUnsignedByte );
 	
-#ifdef DEBUG_VERSION
 	tempMark		= inSpool->GetMark();
-#endif	// DEBUG_VERSION
 	
 	// extract pictures
 	mNumPict		= inSpool->GetNumber( kSpoolUnsignedByte );
@@ -197,10 +187,8 @@ CCLFrame::ReadKeyFromSpool( DataSpool * inSpool )
 		inSpool->ByteAlignRead();
 #endif	// BITWISE_IMAGE_SPOOL
 	
-#ifdef DEBUG_VERSION
 	mPictLen		= inSpool->GetMark() - tempMark;
 	tempMark		= inSpool->GetMark();
-#endif	// DEBUG_VERSION
 	
 	// extract mobiles
 	mNumMobile		= inSpool->GetNumber( kSpoolUnsignedByte );
@@ -221,9 +209,7 @@ CCLFrame::ReadKeyFromSpool( DataSpool * inSpool )
 		mobile.mV		= inSpool->GetNumber( kSpoolSignedShort  );
 		mobile.mColors	= inSpool->GetNumber( kSpoolUnsignedByte );
 		}
-#ifdef DEBUG_VERSION
 	mMobileLen		= inSpool->GetMark() - tempMark;
-#endif	// DEBUG_VERSION
 	
 	// extract State information
 	mStateLen		= inSpool->GetLimit() - inSpool->GetMark();
@@ -239,13 +225,11 @@ CCLFrame::ReadKeyFromSpool( DataSpool * inSpool )
 	
 	mFrameLen		= inSpool->GetMark() - startMark;
 	
-#ifdef DEBUG_VERSION
 	mExtraLen		= mFrameLen - mStateLen - mMobileLen - mPictLen - mDescLen;
 	// mExtraLen should always be 16:
 	//	ackCmdNum:				1
 	//	{ack,resent}Frame:		4 + 4
 	//	{HP,SP,Bal}{Cur,Max}:	6
 	//	light flags:			1
-#endif	// DEBUG_VERSION
 }
 
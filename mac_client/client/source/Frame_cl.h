@@ -136,13 +136,11 @@ public:
 	
 	
 	int32_t					mFrameLen;
-#ifdef DEBUG_VERSION
-	// these are used for statistical purposes
+	// these are used for statistical purposes; see NetStats_cl.cp
 	int						mExtraLen;
 	int						mDescLen;
 	int						mPictLen;
 	int						mMobileLen;
-#endif	// DEBUG_VERSION
 	
 	int32_t					mAckFrame;
 	int32_t					mResentFrame;
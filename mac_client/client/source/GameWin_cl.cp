@@ -18,11 +18,13 @@
 
 #include "ClanLord.h"
 #include "Frame_cl.h"
+#include "JitterBuffer_cl.h"
 #if USE_STYLED_TEXT
 # include "LaunchURL_cl.h"
 #endif
 #include "Macros_cl.h"
 #include "Movie_cl.h"
+#include "NetStats_cl.h"
 #include "Night_cl.h"
 #include "SendText_cl.h"
 #include "Shadows_cl.h"
@@ -176,6 +178,7 @@ bool	MovePlayerToward( int quadrant, bool fast, bool stopIfBalance );
 CTuneQueue		gTuneQueue;
 #endif
 CCLFrame *		gFrame;
+CJitterBuffer	gJitterBuffer;
 int				gFastDrawLimit = 180;		// need to find the best value for this
 int				gSlowDrawLimit = 245;		// should be less than 250
 // (those draw-time limits are laughable now, but v. important
@@ -400,6 +403,7 @@ public:
 	void	DrawTranslucentHandObjects();
 #endif
 	void	DrawMovieMode();
+	void	DrawNetStats();
 	void	DrawMovieProgress( const DTSRect& );
 	void	DrawFieldInactive();
 
@@ -479,6 +483,54 @@ struct WordTable
 };
 
 
+/*
+**	class CRectGrid
+**
+**	a coarse, uniform grid over the game field, for finding the few
+**	rectangles (of mobiles, or bubbles) near a point or another rectangle
+**	without looking at all of them. each cell lists the items whose
+**	rectangles reach it, most recently inserted first. anything off the
+**	field lands in the edge cells. an item may be listed in a cell it no
+**	longer reaches, so callers always test the real rectangle.
+*/
+class CRectGrid
+{
+public:
+	enum
+		{
+		kCellShift		= 6,		// 64-pixel cells
+		kCellsAcross	= 32,
+		kCellsDown		= 32,
+		kMaxEntries		= 4096,
+		kMaxItems		= kDescTableSize
+		};
+		
+					CRectGrid() : mReady( false ), mOverflow( false ) {}
+	
+	void			Reset( const DTSRect * field );
+	void			Insert( const DTSRect * box, int item );
+	int				Collect( const DTSRect * box, short * oItems ) const;
+	
+	void			Invalidate()		{ mReady = false; }
+	bool			IsReady() const		{ return mReady; }
+	bool			Overflowed() const	{ return mOverflow; }
+
+private:
+	int				CellH( int h ) const;
+	int				CellV( int v ) const;
+	
+	bool			mReady;
+	bool			mOverflow;		// ran out of entries; callers must scan
+	int				mOriginH;
+	int				mOriginV;
+	int				mNumEntries;
+	short			mHead[ kCellsDown * kCellsAcross ];
+	short			mNext[ kMaxEntries ];
+	short			mItem[ kMaxEntries ];
+	mutable uchar	mSeen[ kMaxItems ];
+};
+
+
 /*
 **	Internal Routines
 */
@@ -494,9 +546,12 @@ static void				PositionBubble( DTSRect *, const DTSImage *, const DescTable *, i
 static int				PinBubble( DTSRect * dst, int pos );
 static void				ChooseThoughtPosition( const DTSImage * image, DescTable * desc );
 static void				ExtractDescriptors( const CCLFrame * ds );
-static void				ExtractFramePictures( const CCLFrame * ds );
+static void				ExtractFramePictures( const CCLFrame * ds,
+							int scrollH = 0, int scrollV = 0 );
 static void				Queue1Picture( int nnn, DTSKeyID pictID, int horz, int vert );
 static void				ExtractFrameMobiles( const CCLFrame * ds );
+static bool				IsSmoothMotion();
+static void				InterpolateFrameMobiles( const CJitterBuffer::SPresent& pres );
 static void				ExtractStateData( const CCLFrame * ds, int lastAckFrame, int resend );
 static void				HandleStateData();
 static uchar *			HandleInfoText( uchar * ptr );
@@ -522,6 +577,8 @@ static void				FillUnknownLanguage( int t, int lang, const char * name, char * d
 static void				FillUnknownLanguage( int lang, const char * name, char * dest );
 #endif	// USE_WHISPER_YELL_LANGUAGE
 static void				LoadBubbleImages();
+static void				BuildBubbleGrids();
+static void				BuildMobileHitGrid();
 
 
 /*
@@ -533,12 +590,12 @@ static bool				gNotificationActive;	// is there an OS notification active?
 //static bool			gMoveStopIfBalance;		// to be used later (har, har)
 static bool				gSpecialTedFriendMode;	// self text bubbles not automatically friendly
 static bool				gFlipAllBubbles;		// April Fool's Day mode
+static bool				gBetweenFrames;			// smooth motion is redrawing an old frame
 
 
 #ifdef USE_OPENGL	// needed in OpenGL_cl.cpp
 Layout					gLayout;
 DTSPoint				gFieldCenter;
-static int				gCachedCircularLightmapElementRadius = -1;
 #else
 static Layout			gLayout;
 static DTSPoint			gFieldCenter;
@@ -558,6 +615,13 @@ static int				gPicQueCount;
 static PictureQueue *	gPicQueStart;
 static PictureQueue		gPictureQueue[ kMaxPicQueElems ];
 
+// who is near whom, for placing bubbles and for finding what was clicked
+static CRectGrid		gBubbleGrid;			// descBubbleBox, by descriptor index
+static CRectGrid		gBubbleMobileGrid;		// mobiles' boxes, by mobile number
+static DTSRect			gBubbleMobileBox[ 256 ];	// ... the boxes themselves
+static bool				gBubbleMobileHasPic[ 256 ];	// ... or else just a point
+static CRectGrid		gMobileHitGrid;			// descLastDstBox, by mobile number
+
 #ifdef OGL_SHOW_DRAWTIME
 static float			gOGLDrawTime;
 static bool				gShowDrawTime;
@@ -969,7 +1033,7 @@ void
 InitGameState()
 {
 	// clear the descriptor table
-	bzero( gDescTable, kDescTableSize * sizeof( *gDescTable ) );
+	ClearDescTable();
 	
 	// michel: initialize mobile counter
 	gNumMobiles			= 0;
@@ -985,6 +1049,8 @@ InitGameState()
 #ifdef CL_DO_WEATHER
 	gWeatherInfo.Reset();
 #endif // CL_DO_WEATHER
+	
+	gJitterBuffer.Reset();
 }
 
 
@@ -1294,7 +1360,9 @@ RedrawCLWindow()
 //	RedrawPlayersWindow();
 	
 	// push the animations to the next frame
-	UpdateAnims();
+	// (but not when smooth motion is just filling in between frames)
+	if ( not gBetweenFrames )
+		UpdateAnims();
 	
 	// stop the timer
 	ulong time = timer.StopTimer() / 1000;	// millisecs
@@ -1355,7 +1423,8 @@ RedrawCLWindow()
 		}
 #endif	// 0
 	
-	if ( gPrefsData.pdShowDrawTime )
+	if ( gPrefsData.pdShowDrawTime
+	&&   not gBetweenFrames )
 		{
 		const char * note = "good";
 		if ( time >= (uint) gSlowDrawLimit )
@@ -1925,6 +1994,12 @@ CLWindow::Idle()
 			// for "turbo" movie playback speed, we need super-short naps
 			sleep = 1;
 			}
+		else
+		if ( IsSmoothMotion() )
+			{
+			// likewise to keep things moving in between frames
+			sleep = 1;
+			}
 		
 		gDTSApp->SetSleepTime( sleep );
 		}
@@ -2487,6 +2562,7 @@ CLOffView::DrawValid()
 # endif	// OGL_USE_UPDATE_OVERRIDE
 		// harmless if no stencil buffer
 		glClear( GL_COLOR_BUFFER_BIT | GL_STENCIL_BUFFER_BIT );
+		AgeResidentTextures();
 		if ( gOGLManageTexturePriority )
 			{
 			// if "certain drivers" properly implemented the Least-Recently-
@@ -2515,7 +2591,10 @@ CLOffView::DrawValid()
 	
 	// this removes leftover mobiles, after disconnecting
 	if ( not gPlayingGame )
+		{
 		gNumMobiles = 0;
+		gMobileHitGrid.Invalidate();
+		}
 	
 	// draw all of the pictures below the players
 	DrawQueuedPictures( +0x0000 );
@@ -2600,7 +2679,7 @@ CLOffView::DrawValid()
 				{
 				// this is much faster now, but we've lost the dither,
 				// so it looks like a giant bull's eye
-				qdApplyLightmap();
+				qdApplyLightmap( &offBufferImage );
 				}
 			else
 				{
@@ -2648,6 +2727,13 @@ CLOffView::DrawValid()
 	if ( CCLMovie::HasMovie() )
 		DrawMovieMode();
 	
+	// and the network telemetry, if asked for
+	if ( gNetStats.IsOverlayShown()
+	&&   not CCLMovie::IsReading() )
+		{
+		DrawNetStats();
+		}
+	
 #ifdef OGL_SHOW_DRAWTIME
 	if ( gShowDrawTime )
 		ShowDrawTime();
@@ -2700,12 +2786,15 @@ CLOffView::DrawValid()
 #if 1
 	//
 	// now purge some cache if the image count is too high
-	// avoids memory gluttony under OS X
+	// avoids memory gluttony under OS X.
+	// shadows share the LRU list, so they count too; otherwise reaping
+	// one of them would leave the image count where it was.
 	//
 	if ( true /* gUsingOpenGL */ )
 		{
 		const uint maxcache = 400;	// wild guess
-		if ( gRootCacheObject->sCachedImageCount > maxcache )
+		if ( gRootCacheObject->sCachedImageCount
+				+ gRootCacheObject->sCachedShadowCount > maxcache )
 			gRootCacheObject->RemoveOneObject();
 		}
 #endif	// 1
@@ -2911,10 +3000,9 @@ CLOffView::RebuildNightList( const DTSRect& dst )
 			ushort starlightColorus = 0xFFFF * starlightColorf;
 			RGBColor starlightColorusv =
 				{ starlightColorus, starlightColorus, starlightColorus };
-			Rect box = { gFieldCenter.ptV - 325, gFieldCenter.ptH - 325,
-						 gFieldCenter.ptV + 325, gFieldCenter.ptH + 325 };
 			RGBColor moonlightColorusv = { redshiftus, clearColorus, clearColorus };
 			qdClearLightmap( moonlightColorusv, starlightColorusv );
+			qdFinishLightmap();
 			}
 		}
 # endif	// OGL_QUICKDRAW_LIGHT_EFFECTS
@@ -2993,8 +3081,11 @@ CLOffView::Draw1Picture( const PictureQueue * pq )
 	
 	// push random anims along _before_ drawing
 #ifdef IRREGULAR_ANIMATIONS
-	if ( cache->icImage.cliPictDef.pdFlags & kPictDefFlagRandomAnimation )
+	if ( (cache->icImage.cliPictDef.pdFlags & kPictDefFlagRandomAnimation)
+	&&   not gBetweenFrames )
+		{
 		cache->UpdateAnim( true );
+		}
 #endif	// IRREGULAR_ANIMATIONS
 	
 #ifdef USE_OPENGL
@@ -3378,6 +3469,7 @@ CLOffView::Draw1MobileShadow( const DSMobile * mobile )
 	dstBox.Size( mobileSize, mobileSize );
 	
 	desc->descLastDstBox = dstBox;
+	gMobileHitGrid.Invalidate();
 	
 #ifndef USE_OPENGL
 # ifdef NEW_OVAL_HILITE
@@ -3433,13 +3525,8 @@ CLOffView::Draw1MobileShadow( const DSMobile * mobile )
 					}
 				
 				// draw shadow using rotated, pose-shifted picture
-#ifdef USE_OPENGL
 				CreateShadow( this, ic, &shadowRect, &dstBox,
 					kPictDefShadowNormal /* ic->icImage.cliPictDef.pdFlags */ );
-#else
-				CreateShadow( this, &ic->icImage.cliImage, &shadowRect, &dstBox,
-					kPictDefShadowNormal /* ic->icImage.cliPictDef.pdFlags */ );
-#endif	// USE_OPENGL
 				
 #if defined(USE_OPENGL) && defined(DEBUG_VERSION) && defined(OGL_SHOW_IMAGE_ID)
 	ShowMessage( "upright shadow mobile ID: %d, state: %d",
@@ -3449,13 +3536,8 @@ CLOffView::Draw1MobileShadow( const DSMobile * mobile )
 			else
 				{
 				// dead or prone players draw drop-shadows
-#ifdef USE_OPENGL
 				CreateShadow( this, ic, &srcBox, &dstBox,
 					kPictDefShadowDrop /* ic->icImage.cliPictDef.pdFlags */ );
-#else
-				CreateShadow( this, &ic->icImage.cliImage, &srcBox, &dstBox,
-					kPictDefShadowDrop /* ic->icImage.cliPictDef.pdFlags */ );
-#endif	// USE_OPENGL
 	
 #if defined(USE_OPENGL) && defined(DEBUG_VERSION) && defined(OGL_SHOW_IMAGE_ID)
 	ShowMessage( "drop shadow mobile ID: %d", (int) desc->descID );
@@ -3465,13 +3547,8 @@ CLOffView::Draw1MobileShadow( const DSMobile * mobile )
 		else
 			{
 			// boats, belly-crawlers & 4-leggers draw drop-shadows
-#ifdef USE_OPENGL
 			CreateShadow( this, ic, &srcBox, &dstBox,
 				kPictDefShadowDrop /* ic->icImage.cliPictDef.pdFlags */ );
-#else
-			CreateShadow( this, &ic->icImage.cliImage, &srcBox, &dstBox,
-				kPictDefShadowDrop /* ic->icImage.cliPictDef.pdFlags */ );
-#endif	// USE_OPENGL
 			}
 		}
 }
@@ -3596,6 +3673,7 @@ CLOffView::DrawSelectionHilite()
 		dstBox.Size( mobileSize, mobileSize );
 		
 		desc->descLastDstBox = dstBox;
+		gMobileHitGrid.Invalidate();
 		
 		if ( kDescPlayer == desc->descType
 		&&   gSelectedPlayerName[0]
@@ -4713,6 +4791,16 @@ CLOffView::DrawBubbles()
 	char drawTable[ kDescTableSize ];
 	bzero( drawTable, sizeof drawTable );
 	
+	// bubbles last a certain number of frames, not redraws; so if smooth motion
+	// is just filling in between frames, put their counters back afterward
+	int32_t savedCounters[ kDescTableSize ];
+	if ( gBetweenFrames )
+		memcpy( savedCounters, gDescBubbleCounter, sizeof savedCounters );
+	
+	// the bubble grids get built only if some bubble needs a place
+	gBubbleGrid.Invalidate();
+	gBubbleMobileGrid.Invalidate();
+	
 	// prescan all drawable bubbles
 	DSMobile * dsm = &gDSMobile[0];
 	DescTable * table = gDescTable;
@@ -4722,7 +4810,7 @@ CLOffView::DrawBubbles()
 		DescTable * desc = table + index;
 		
 		// do we have a bubble to draw?
-		if ( desc->descBubbleCounter > 0 )
+		if ( desc->BubbleCounter() > 0 )
 			{
 			// remember we need to draw it
 			drawTable[ index ] = 1;
@@ -4740,12 +4828,13 @@ CLOffView::DrawBubbles()
 	for(;;)
 		{
 		// find the bubble with the oldest counter
+		// (the counters are kept in a column of their own, so this scan is quick)
 		int oldestIndex = -1;
 		int oldestCounter = INT_MAX;
-		table = gDescTable;
-		for ( int index = 0;  index < kDescTableSize;  ++index, ++table )
+		const int32_t * counters = gDescBubbleCounter;
+		for ( int index = 0;  index < kDescTableSize;  ++index )
 			{
-			int counter = table->descBubbleCounter;
+			int counter = counters[ index ];
 			if ( counter <= skipCounter )
 				continue;
 			if ( counter < oldestCounter )
@@ -4759,8 +4848,8 @@ CLOffView::DrawBubbles()
 		skipCounter = oldestCounter - 1;
 		
 		// decrement the counter
+		gDescBubbleCounter[ oldestIndex ] = oldestCounter - 1;
 		table = gDescTable + oldestIndex;
-		table->descBubbleCounter = oldestCounter - 1;
 		
 		// draw all onscreen mobiles
 		if ( drawTable[ oldestIndex ] )
@@ -4804,6 +4893,9 @@ CLOffView::DrawBubbles()
 			continue;
 			}
 		}
+	
+	if ( gBetweenFrames )
+		memcpy( gDescBubbleCounter, savedCounters, sizeof savedCounters );
 }
 
 
@@ -5029,7 +5121,7 @@ CLOffView::Draw1Bubble( DescTable * desc, int mode )
 	// munge the text
 	// prefix the descriptor's name in front
 	char buff[ kMaxDescTextLength + kMaxNameLen + 4 ];
-	const char * text = desc->descBubbleText;
+	const char * text = desc->BubbleText();
 	if ( kDrawBubbleNamePrefix == mode )
 		{
 		snprintf( buff, sizeof buff, "%s: %s", desc->descName, text );
@@ -5112,6 +5204,10 @@ CLOffView::Draw1Bubble( DescTable * desc, int mode )
 	pos = PinBubble( &desc->descBubbleBox, pos );
 	desc->descBubbleLastPos = pos;
 	
+	// later bubbles this frame must see where this one went
+	if ( gBubbleGrid.IsReady() )
+		gBubbleGrid.Insert( &desc->descBubbleBox, desc - gDescTable );
+	
 	// calculate the source rect
 	DTSRect src;
 	int bType = desc->descBubbleType;
@@ -5177,7 +5273,7 @@ CLOffView::Draw1Bubble( DescTable * desc, int mode )
 	if ( gUsingOpenGL )
 		{
 # ifdef OGL_USE_TEXT_FADE
-		if ( desc->descBubbleCounter <= kTextFadeLength )
+		if ( desc->BubbleCounter() <= kTextFadeLength )
 			{
 			if ( kBlitterTransparent == gPrefsData.pdFriendBubbleBlitter
 			||   kBlitterTransparent == gPrefsData.pdBubbleBlitter )
@@ -5185,14 +5281,14 @@ CLOffView::Draw1Bubble( DescTable * desc, int mode )
 				// would be better if this check were farther up,
 				// but don't want to disturb the rest of the code too much
 				
-				desc->descBubbleCounter -= kTextFadeLength;	// or should this be = 0?
+				desc->BubbleCounter() -= kTextFadeLength;	// or should this be = 0?
 				return;
 				}
 			else
 				{
 				const GLfloat invFadeLengthPlusOne = 1.0f / (kTextFadeLength + 1);
 				targetAlphaScale =
-					(desc->descBubbleCounter + 1) * invFadeLengthPlusOne;
+					(desc->BubbleCounter() + 1) * invFadeLengthPlusOne;
 				}
 			}
 # endif	// OGL_USE_TEXT_FADE
@@ -5313,7 +5409,7 @@ CLOffView::Draw1Bubble( DescTable * desc, int mode )
 			disableTexturing();
 			
 # ifdef OGL_USE_TEXT_FADE
-			if ( desc->descBubbleCounter <= kTextFadeLength
+			if ( desc->BubbleCounter() <= kTextFadeLength
 			&&   targetAlphaScale < 1.0f )
 				{
 				enableBlending();
@@ -5383,7 +5479,7 @@ CLOffView::Draw1Bubble( DescTable * desc, int mode )
 #ifdef USE_OPENGL
 			if ( gUsingOpenGL )
 # ifdef OGL_USE_TEXT_FADE
-				if ( desc->descBubbleCounter <= kTextFadeLength
+				if ( desc->BubbleCounter() <= kTextFadeLength
 				&&   targetAlphaScale < 1.0f )
 					{
 					// blending was already enabled above
@@ -5869,6 +5965,175 @@ PinBubble( DTSRect * dst, int pos )
 }
 
 
+/*
+**	CRectGrid::Reset()
+**
+**	empty the grid, and line it up with the field
+*/
+void
+CRectGrid::Reset( const DTSRect * field )
+{
+	mOriginH = field->rectLeft;
+	mOriginV = field->rectTop;
+	mNumEntries = 0;
+	memset( mHead, 0xFF, sizeof mHead );		// all -1
+	bzero( mSeen, sizeof mSeen );
+	mOverflow = false;
+	mReady = true;
+}
+
+
+/*
+**	CRectGrid::CellH()
+**	CRectGrid::CellV()
+**
+**	which column or row a coordinate falls in, pinned to the grid
+*/
+inline int
+CRectGrid::CellH( int h ) const
+{
+	int cell = h - mOriginH;
+	if ( cell < 0 )
+		return 0;
+	cell >>= kCellShift;
+	return cell < kCellsAcross ? cell : kCellsAcross - 1;
+}
+
+
+inline int
+CRectGrid::CellV( int v ) const
+{
+	int cell = v - mOriginV;
+	if ( cell < 0 )
+		return 0;
+	cell >>= kCellShift;
+	return cell < kCellsDown ? cell : kCellsDown - 1;
+}
+
+
+/*
+**	CRectGrid::Insert()
+**
+**	list the item in every cell its box reaches (edges included, to be safe)
+*/
+void
+CRectGrid::Insert( const DTSRect * box, int item )
+{
+	int left   = CellH( box->rectLeft );
+	int right  = CellH( box->rectRight );
+	int top    = CellV( box->rectTop );
+	int bottom = CellV( box->rectBottom );
+	for ( int v = top;  v <= bottom;  ++v )
+		{
+		for ( int h = left;  h <= right;  ++h )
+			{
+			if ( mNumEntries >= kMaxEntries )
+				{
+				mOverflow = true;
+				return;
+				}
+			int cell = v * kCellsAcross + h;
+			mItem[ mNumEntries ] = item;
+			mNext[ mNumEntries ] = mHead[ cell ];
+			mHead[ cell ] = mNumEntries;
+			++mNumEntries;
+			}
+		}
+}
+
+
+/*
+**	CRectGrid::Collect()
+**
+**	gather, once each, the items listed in the cells the box reaches.
+**	for a box within one cell they come out most recently inserted first.
+**	oItems must have room for kMaxItems.
+*/
+int
+CRectGrid::Collect( const DTSRect * box, short * oItems ) const
+{
+	int count  = 0;
+	int left   = CellH( box->rectLeft );
+	int right  = CellH( box->rectRight );
+	int top    = CellV( box->rectTop );
+	int bottom = CellV( box->rectBottom );
+	for ( int v = top;  v <= bottom;  ++v )
+		{
+		for ( int h = left;  h <= right;  ++h )
+			{
+			for ( int entry = mHead[ v * kCellsAcross + h ];
+				  entry >= 0;  entry = mNext[ entry ] )
+				{
+				int item = mItem[ entry ];
+				if ( mSeen[ item ] )
+					continue;
+				mSeen[ item ] = 1;
+				oItems[ count++ ] = item;
+				}
+			}
+		}
+	
+	// clean up for next time
+	for ( int nnn = 0;  nnn < count;  ++nnn )
+		mSeen[ oItems[ nnn ] ] = 0;
+	
+	return count;
+}
+
+
+/*
+**	BuildBubbleGrids()
+**
+**	file the mobiles, and the bubbles that already have places, by where
+**	they are on the field. the mobiles' pictures are looked up here, once,
+**	instead of once per mobile per candidate position per bubble.
+*/
+void
+BuildBubbleGrids()
+{
+	const DTSRect * field = &gLayout.layoFieldBox;
+	
+	gBubbleMobileGrid.Reset( field );
+	const DSMobile * dsm = gDSMobile;
+	for ( int nnn = 0;  nnn < gNumMobiles;  ++nnn, ++dsm )
+		{
+		DTSRect * box = &gBubbleMobileBox[ nnn ];
+		box->rectTop  = dsm->dsmVert + gFieldCenter.ptV;
+		box->rectLeft = dsm->dsmHorz + gFieldCenter.ptH;
+		
+		const ImageCache * ic = CachePicture( gDescTable + dsm->dsmIndex );
+		gBubbleMobileHasPic[ nnn ] = ( ic != nullptr );
+		if ( not ic )
+			{
+			// no picture; only the spot it stands on counts
+			box->rectBottom = box->rectTop  + 1;
+			box->rectRight  = box->rectLeft + 1;
+			}
+		else
+			{
+			int mobileSize = ic->icBox.rectRight / 32;
+			int halfSize   = mobileSize / 2;
+			box->rectTop   -= halfSize;
+			box->rectLeft  -= halfSize;
+			box->rectBottom = box->rectTop  + mobileSize;
+			box->rectRight  = box->rectLeft + mobileSize;
+			}
+		gBubbleMobileGrid.Insert( box, nnn );
+		}
+	
+	gBubbleGrid.Reset( field );
+	const DescTable * table = gDescTable;
+	for ( int index = 0;  index < kDescTableSize;  ++index, ++table )
+		{
+		if ( table->BubbleCounter() > 0
+		&&   kBubblePosNone != table->descBubblePos )
+			{
+			gBubbleGrid.Insert( &table->descBubbleBox, index );
+			}
+		}
+}
+
+
 /*
 **	ChooseBubblePosition()
 **
@@ -5988,32 +6253,39 @@ CalcBubblePosValue( const DTSImage * image, DescTable * desc, int pos )
 		value -= 1000;
 		}
 	
+	// only look at what's nearby; the grids say what that is
+	if ( not gBubbleGrid.IsReady() )
+		BuildBubbleGrids();
+	short nearby[ CRectGrid::kMaxItems ];
+	int numNearby;
+	
 	// check mobiles that are covered
-	const DSMobile * dsm = gDSMobile;
+	if ( gBubbleMobileGrid.Overflowed() )
+		{
+		numNearby = gNumMobiles;
+		for ( int nnn = 0;  nnn < numNearby;  ++nnn )
+			nearby[ nnn ] = nnn;
+		}
+	else
+		numNearby = gBubbleMobileGrid.Collect( &bounds, nearby );
+	
 	DTSRect sect;
-	for ( int count = gNumMobiles;  count > 0;  --count, ++dsm )
+	for ( int nnn = 0;  nnn < numNearby;  ++nnn )
 		{
-		DescTable * otherdesc = gDescTable + dsm->dsmIndex;
-		if ( otherdesc == desc )
+		int mobile = nearby[ nnn ];
+		if ( gDescTable + gDSMobile[ mobile ].dsmIndex == desc )
 			continue;
 		
-		ImageCache * ic = CachePicture( otherdesc );
-		if ( not ic )
+		sect = gBubbleMobileBox[ mobile ];
+		if ( not gBubbleMobileHasPic[ mobile ] )
 			{
 			DTSPoint loc;
-			loc.Set( dsm->dsmHorz + gFieldCenter.ptH,
-					 dsm->dsmVert + gFieldCenter.ptV );
+			loc.Set( sect.rectLeft, sect.rectTop );
 			if ( loc.InRect( &bounds ) )
 				value -= 10;
 			}
 		else
 			{
-			int mobileSize = ic->icBox.rectRight / 32;
-			int halfSize   = mobileSize / 2;
-			sect.rectTop    = dsm->dsmVert + gFieldCenter.ptV - halfSize;
-			sect.rectLeft   = dsm->dsmHorz + gFieldCenter.ptH - halfSize;
-			sect.rectBottom = sect.rectTop  + mobileSize;
-			sect.rectRight  = sect.rectLeft + mobileSize;
 			sect.Intersect( &bounds );
 			if ( not sect.IsEmpty() )
 				value -= 10;
@@ -6021,10 +6293,19 @@ CalcBubblePosValue( const DTSImage * image, DescTable * desc, int pos )
 		}
 	
 	// check other bubbles
-	const DescTable * table = gDescTable;
-	for ( int index = kDescTableSize;  index > 0;  --index, ++table )
+	if ( gBubbleGrid.Overflowed() )
+		{
+		numNearby = kDescTableSize;
+		for ( int nnn = 0;  nnn < numNearby;  ++nnn )
+			nearby[ nnn ] = nnn;
+		}
+	else
+		numNearby = gBubbleGrid.Collect( &bounds, nearby );
+	
+	for ( int nnn = 0;  nnn < numNearby;  ++nnn )
 		{
-		if ( table->descBubbleCounter <= 0 )
+		const DescTable * table = gDescTable + nearby[ nnn ];
+		if ( table->BubbleCounter() <= 0 )
 			continue;
 		int testpos = table->descBubblePos;
 		if ( kBubblePosNone == testpos )
@@ -6683,6 +6964,63 @@ CLOffView::DrawMovieMode()
 }
 
 
+/*
+**	CLOffView::DrawNetStats()
+**
+**	display the network telemetry in the corner of the game field,
+**	below where the movie sign goes
+*/
+void
+CLOffView::DrawNetStats()
+{
+	CNetStats::SStats st;
+	gNetStats.GetStats( &st );
+	
+	int denom = st.mFrames + st.mLost;
+	double pctLost = denom ? st.mLost * 100.0 / denom : 0;
+	
+	const int kNumLines = 4;
+	char lines[ kNumLines ][ 96 ];
+	snprintf( lines[0], sizeof lines[0], "rtt %.0f / %.0f / %.0f ms",
+		st.mRTT50, st.mRTT90, st.mRTT99 );
+	snprintf( lines[1], sizeof lines[1], "frames %.0f ms apart, jitter %.1f ms",
+		st.mInterval50, st.mJitter );
+	snprintf( lines[2], sizeof lines[2], "lost %lu (%.1f%%), late %lu",
+		st.mLost, pctLost, st.mLate );
+	snprintf( lines[3], sizeof lines[3], "%.1f KB/sec in, %.2f KB/sec out",
+		st.mBytesIn / 1024, st.mBytesOut / 1024 );
+	
+	DTSCoord h = gLayout.layoFieldBox.rectLeft + 5;
+	DTSCoord v = gLayout.layoFieldBox.rectTop + 5 + kTextAscent;
+	
+#ifdef USE_OPENGL
+	if ( gUsingOpenGL )
+		{
+		disableBlending();
+		disableAlphaTest();
+		disableTexturing();
+		glColor3us( 0, 0xFFFF, 0 );
+		for ( int n = 0; n < kNumLines; ++n )
+			drawOGLText( h, v + kTextLineHeight * (n + 1), geneva9NormalListBase, lines[ n ] );
+		}
+	else
+#endif  // USE_OPENGL
+		{
+		SetForeColor( &DTSColor::green );
+		
+		// use 9 point geneva
+		SetFont( "Geneva" );
+		SetFontSize( 9 );
+		SetFontStyle( normal );
+		for ( int n = 0; n < kNumLines; ++n )
+			Draw( lines[ n ], h, v + kTextLineHeight * (n + 1), kJustLeft );
+		
+		// restore the color
+		SetForeColor( &DTSColor::black );
+		}
+}
+
+
 /*
 **	CLOffView::DrawMovieProgress()
 **
@@ -6972,11 +7310,12 @@ ExtractImportantData()
 	int newAckFrame = gFrame->mAckFrame;
 	gFrameCounter = newAckFrame;
 	
+	int lostframes = 0;
 	if ( not CCLMovie::IsReading() )
 		{
 		++gNumFrames;
 		++gPrefsData.pdNumFrames;
-		int lostframes = newAckFrame - lastAckFrame - 1;
+		lostframes = newAckFrame - lastAckFrame - 1;
 		if ( lastAckFrame != 0
 		&&   lostframes   >  0 )
 			{
@@ -6985,6 +7324,9 @@ ExtractImportantData()
 			gLostFrames             += lostframes;
 			gPrefsData.pdLostFrames += lostframes;
 			}
+		
+		// timing, losses, late arrivals, and where the bytes went
+		gNetStats.RecordFrame( gFrame, lastAckFrame, gFrameArrival );
 		}
 	
 //	** shadow testing **
@@ -6993,9 +7335,12 @@ ExtractImportantData()
 #endif
 	
 	// oh yuck, packets received out of order
+	// (gNetStats keeps count; see \NETSTATS SHOW)
 	if ( newAckFrame <= lastAckFrame )
 		{
+#ifdef DEBUG_VERSION
 		ShowMessage( "gah! out of order" );
+#endif
 		gDSSpool = nullptr;
 		return;
 		}
@@ -7011,9 +7356,15 @@ ExtractImportantData()
 	gNightInfo.SetFlags( gFrame->mLightFlags );
 	
 	// extract the descriptors, pictures, and mobiles
+	// in smooth-motion mode, the pictures and mobiles wait their turn in the
+	// jitter buffer instead; see PresentSmoothFrame()
 	ExtractDescriptors( gFrame );
-	ExtractFramePictures( gFrame );
-	ExtractFrameMobiles(  gFrame );
+	if ( not IsSmoothMotion()
+	||   noErr != gJitterBuffer.Add( gFrame, lastAckFrame ? lostframes : 0, gFrameArrival ) )
+		{
+		ExtractFramePictures( gFrame );
+		ExtractFrameMobiles(  gFrame );
+		}
 	
 	// extract the state data
 	ExtractStateData( gFrame, lastAckFrame, resend );
@@ -7055,9 +7406,9 @@ ExtractDescriptors( const CCLFrame * ds )
 			target->descSize           = kPlayerSize / 2;
 			target->descBubbleType     = 0;
 			target->descBubbleLanguage = 0;
-			target->descBubbleCounter  = 0;
+			target->BubbleCounter()    = 0;
 			target->descBubblePos      = kBubblePosNone;
-			target->descBubbleText[0]  = '\0';
+			target->BubbleText()[0]    = '\0';
 			StringCopySafe( target->descName, desc.mName, sizeof target->descName );
 			target->descNumColors      = desc.mNumColors;
 			memcpy( target->descColors, desc.mColors, desc.mNumColors );
@@ -7077,7 +7428,7 @@ ExtractDescriptors( const CCLFrame * ds )
 **	extract the frame pictures
 */
 void
-ExtractFramePictures( const CCLFrame * ds )
+ExtractFramePictures( const CCLFrame * ds, int scrollH /* = 0 */, int scrollV /* = 0 */ )
 {
 	// initialize the queue variables
 	gPicQueCount = 0;
@@ -7093,11 +7444,12 @@ ExtractFramePictures( const CCLFrame * ds )
 		{
 		const CCLFrame::SFramePict& pict = ds->mPict[ nnn ];
 		++gPicQueCount;
-		Queue1Picture( nnn, pict.mPictID, pict.mH, pict.mV );
+		Queue1Picture( nnn, pict.mPictID, pict.mH + scrollH, pict.mV + scrollV );
 		}
 	
 	// debugging message
-	if ( gPrefsData.pdShowImageCount )
+	if ( gPrefsData.pdShowImageCount
+	&&   not gBetweenFrames )
 		ShowMessage( "Drawing %d/%d images.",
 			(int) ds->mNumPict, (int) ds->mNumPictAgain );
 	
@@ -7274,11 +7626,15 @@ void
 ExtractFrameMobiles( const CCLFrame * ds )
 {
 	// debugging message
-	if ( gPrefsData.pdShowImageCount )
+	if ( gPrefsData.pdShowImageCount
+	&&   not gBetweenFrames )
+		{
 		ShowMessage( "Drawing %d mobiles.", (int) ds->mNumMobile );
+		}
 	
 	// load the mobiles
 	gNumMobiles = 0;
+	gMobileHitGrid.Invalidate();
 	DSMobile * dsm = &gDSMobile[0];
 	DescTable * newme = nullptr;
 	
@@ -7353,6 +7709,123 @@ ExtractFrameMobiles( const CCLFrame * ds )
 }
 
 
+/*
+**	IsSmoothMotion()
+**
+**	are we drawing through the jitter buffer?
+**	(not for movies; they have their own pace)
+*/
+bool
+IsSmoothMotion()
+{
+	return gPrefsData.pdSmoothMotion && not CCLMovie::IsReading();
+}
+
+
+/*
+**	InterpolateFrameMobiles()
+**
+**	move the mobiles just extracted from pres.mFrame partway toward where they are
+**	in pres.mTarget; or, if there's no target yet, onward the way they came from pres.mPrev.
+**	Mobiles that aren't in the other frame just ride along with the field.
+*/
+void
+InterpolateFrameMobiles( const CJitterBuffer::SPresent& pres )
+{
+	const CCLFrame * other = pres.mTarget;
+	float alpha = pres.mAlpha;
+	if ( not other )
+		{
+		// extrapolating is interpolating backward, from the previous frame
+		other = pres.mPrev;
+		alpha = -alpha;
+		}
+	if ( not other || 0 == alpha )
+		return;
+	
+	// where each descriptor is, in the other frame
+	short where[ kDescTableSize ];
+	memset( where, -1, sizeof where );
+	for ( uint nnn = 0;  nnn < other->mNumMobile;  ++nnn )
+		where[ other->mMobile[ nnn ].mIndex ] = static_cast<short>( nnn );
+	
+	DSMobile * dsm = gDSMobile;
+	for ( int count = gNumMobiles;  count > 0;  --count, ++dsm )
+		{
+		int idx = where[ dsm->dsmIndex ];
+		if ( idx < 0 )
+			{
+			dsm->dsmHorz += pres.mScrollH;
+			dsm->dsmVert += pres.mScrollV;
+			continue;
+			}
+		
+		// leave teleports and the like alone; they'd only streak across the screen
+		const CCLFrame::SFrameMobile& mob = other->mMobile[ idx ];
+		int dh = mob.mH - dsm->dsmHorz;
+		int dv = mob.mV - dsm->dsmVert;
+		if ( abs( dh ) > 2 * CJitterBuffer::kMaxScroll
+		||   abs( dv ) > 2 * CJitterBuffer::kMaxScroll )
+			{
+			continue;
+			}
+		
+		dsm->dsmHorz += static_cast<int>( floorf( alpha * dh + 0.5F ) );
+		dsm->dsmVert += static_cast<int>( floorf( alpha * dv + 0.5F ) );
+		}
+}
+
+
+/*
+**	PresentSmoothFrame()
+**
+**	in smooth-motion mode, put the jitter buffer's idea of the field on screen,
+**	if it has changed since the last time.
+**	Returns false if it isn't up to this, and the caller should just redraw as usual.
+*/
+bool
+PresentSmoothFrame()
+{
+	static int lastScrollH, lastScrollV;
+	static float lastAlpha;
+	
+	if ( not IsSmoothMotion() )
+		{
+		gJitterBuffer.Reset();
+		return false;
+		}
+	
+	gJitterBuffer.SetLatency( gPrefsData.pdSmoothLatency );
+	
+	CJitterBuffer::SPresent pres;
+	if ( not gJitterBuffer.Present( GetCurrentEventTime(), &pres ) )
+		return false;
+	
+	// nothing to do if it would look just the same as last time
+	if ( not pres.mNewFrame
+	&&   pres.mScrollH == lastScrollH
+	&&   pres.mScrollV == lastScrollV
+	&&   fabsf( pres.mAlpha - lastAlpha ) < 0.02F )
+		{
+		return true;
+		}
+	lastScrollH = pres.mScrollH;
+	lastScrollV = pres.mScrollV;
+	lastAlpha   = pres.mAlpha;
+	
+	// drawing empties the picture queue, so it must be refilled every time
+	gBetweenFrames = not pres.mNewFrame;
+	ExtractFramePictures( pres.mFrame, pres.mScrollH, pres.mScrollV );
+	ExtractFrameMobiles( pres.mFrame );
+	InterpolateFrameMobiles( pres );
+	
+	RedrawCLWindow();
+	gBetweenFrames = false;
+	
+	return true;
+}
+
+
 /*
 **	ExtractStateData()
 **
@@ -7650,7 +8123,7 @@ HandleInfoText( uchar * ptr )
 static int
 ExtractTypeThinkBubble( DescTable * target )
 {
-	const char * text = target->descBubbleText;
+	const char * text = target->BubbleText();
 	char bepptype [ sizeof kBEPPThinkBubble_think ];
 	int thinktype = kBubbleThink_none;
 	int pos = 0;
@@ -7700,9 +8173,9 @@ ExtractTypeThinkBubble( DescTable * target )
 	// we saved the type of the think, now we can remove that extra
 	// piece of information from the original bubble text (by copying
 	// the text backwards over the bepp string)
-	StringCopySafe( target->descBubbleText + pos,
-		target->descBubbleText + pos + sizeof kBEPPThinkBubble_think - 1,
-		sizeof target->descBubbleText - pos - sizeof kBEPPThinkBubble_think );
+	StringCopySafe( target->BubbleText() + pos,
+		target->BubbleText() + pos + sizeof kBEPPThinkBubble_think - 1,
+		kMaxDescTextLength - pos - sizeof kBEPPThinkBubble_think );
 	
 	return thinktype;
 }
@@ -7900,7 +8373,7 @@ id		142			141
 		for ( int step = kDescTableBaseSize;
 			  step < kDescTableSize;  ++step, ++thought )
 			{
-			int age = thought->descBubbleCounter;
+			int age = thought->BubbleCounter();
 			if ( age < minAge )
 				{
 				minAge = age;
@@ -7914,25 +8387,25 @@ id		142			141
 	target->descBubbleLoc.Set( horz, vert );
 	target->descBubbleType     = type;
 	target->descBubbleLanguage = lang;
-	target->descBubbleCounter  = kTextDelayLength;
+	target->BubbleCounter()    = kTextDelayLength;
 	
 #ifdef OGL_USE_TEXT_FADE
 	if ( gUsingOpenGL )
-		target->descBubbleCounter += kTextFadeLength;
+		target->BubbleCounter() += kTextFadeLength;
 #endif	// OGL_USE_TEXT_FADE
 	
 	target->descBubblePos = kBubblePosNone;
 	
 	if ( text )
-		StringCopySafeNoDupSpaces( target->descBubbleText,
-			text, sizeof target->descBubbleText );
+		StringCopySafeNoDupSpaces( target->BubbleText(),
+			text, kMaxDescTextLength );
 	else
 		{
 #if USE_WHISPER_YELL_LANGUAGE
 		FillUnknownLanguage( type, lang,
-			target->descName, target->descBubbleText );
+			target->descName, target->BubbleText() );
 #else
-		FillUnknownLanguage( lang, target->descName, target->descBubbleText );
+		FillUnknownLanguage( lang, target->descName, target->BubbleText() );
 #endif	// USE_WHISPER_YELL_LANGUAGE
 		}
 	
@@ -7975,7 +8448,7 @@ id		142			141
 			{
 			// Person says, "message"
 			char punct =
-				target->descBubbleText[ strlen( target->descBubbleText ) - 1];
+				target->BubbleText()[ strlen( target->BubbleText() ) - 1];
 			const char * verb;
 			switch ( punct )
 				{
@@ -7986,7 +8459,7 @@ id		142			141
 			
 			if ( 0 == (type & kBubbleNotCommon) )
 				snprintf( buff, sizeof buff,
-					"%s %s, \"%s\"", speakerName, verb, target->descBubbleText );
+					"%s %s, \"%s\"", speakerName, verb, target->BubbleText() );
 			else
 				{
 				int langindex = (lang & kBubbleLanguageMask) + 1;
@@ -8001,7 +8474,7 @@ id		142			141
 						"%s %s, \"%s\"",
 						speakerName,
 						verb,
-						target->descBubbleText );
+						target->BubbleText() );
 				else
 					snprintf( buff, sizeof buff,
 						// "%s %s in %s, \"%s\"",
@@ -8009,7 +8482,7 @@ id		142			141
 						speakerName,
 						verb,
 						gLanguageTableShort[langindex],
-						target->descBubbleText
+						target->BubbleText()
 						);
 				}
 			}
@@ -8020,7 +8493,7 @@ id		142			141
 			snprintf( buff, sizeof buff,
 				// "%s growls, \"%s\"",
 				_(TXTCL_BUBBLE_GROWL),
-				speakerName, target->descBubbleText );
+				speakerName, target->BubbleText() );
 			break;
 		
 		case kBubbleWhisper:
@@ -8031,7 +8504,7 @@ id		142			141
 				snprintf( buff, sizeof buff,
 					// "%s whispers, \"%s\"",
 					_(TXTCL_BUBBLE_WHISPER),
-					speakerName, target->descBubbleText );
+					speakerName, target->BubbleText() );
 			else
 				{
 				int langindex = (lang & kBubbleLanguageMask) + 1;
@@ -8046,7 +8519,7 @@ id		142			141
 						// "%s whispers, \"%s\"",
 						_(TXTCL_BUBBLE_WHISPER),
 						speakerName,
-						target->descBubbleText );
+						target->BubbleText() );
 				else
 					snprintf( buff, sizeof buff,
 						// "%s %s in %s, \"%s\"",
@@ -8054,13 +8527,13 @@ id		142			141
 						speakerName,
 						gVerbTable[kLanguageWhisperVerb][langindex],
 						gLanguageTableShort[langindex],
-						target->descBubbleText
+						target->BubbleText()
 						);
 				}
 			}
 #else
 			snprintf( buff, sizeof buff, _(TXTCL_BUBBLE_WHISPER),
-				speakerName, target->descBubbleText );
+				speakerName, target->BubbleText() );
 #endif	// USE_WHISPER_YELL_LANGUAGE
 			break;
 		
@@ -8074,7 +8547,7 @@ id		142			141
 				snprintf( buff, sizeof buff,
 					// "%s yells, \"%s\"",
 					_(TXTCL_BUBBLE_YELL),
-					speakerName, target->descBubbleText );
+					speakerName, target->BubbleText() );
 			else
 				{
 				int langindex = ( lang & kBubbleLanguageMask ) + 1;
@@ -8095,7 +8568,7 @@ id		142			141
 						_(TXTCL_BUBBLE_YELL),
 						speakerName,
 //						gVerbTable[kLanguageLogYellVerb][langindex],
-						target->descBubbleText );
+						target->BubbleText() );
 				else
 					switch ( lang & kBubbleCodeMask )
 						{
@@ -8104,7 +8577,7 @@ id		142			141
 								"%s %s, \"%s\"",
 								speakerName,
 								gVerbTable[kLanguageLogYellVerb][langindex],
-								target->descBubbleText
+								target->BubbleText()
 								);
 							break;
 						
@@ -8117,7 +8590,7 @@ id		142			141
 								speakerName,
 								gVerbTable[kLanguageLogYellVerb][langindex],
 								gLanguageTableShort[langindex],
-								target->descBubbleText
+								target->BubbleText()
 								);
 							break;
 						
@@ -8128,7 +8601,7 @@ id		142			141
 								speakerName,
 								gVerbTable[kLanguageLogYellVerb][langindex],
 								gLanguageTableLong[langindex],
-								target->descBubbleText
+								target->BubbleText()
 								);
 							break;
 						}
@@ -8136,24 +8609,24 @@ id		142			141
 			}
 #else
 			snprintf( buff, sizeof buff, _(TXTCL_BUBBLE_YELL),
-				speakerName, target->descBubbleText );
+				speakerName, target->BubbleText() );
 #endif	// USE_WHISPER_YELL_LANGUAGE
 			break;
 		
 		case kBubbleRealAction:
 			// Person does stuff (& hope script added correct punctuation)
-			snprintf( buff, sizeof buff, "%s", target->descBubbleText );
+			snprintf( buff, sizeof buff, "%s", target->BubbleText() );
 			break;
 		
 		case kBubblePlayerAction:
 			// put parens around action to show it's not "real"
-			snprintf( buff, sizeof buff, "(%s)", target->descBubbleText );
+			snprintf( buff, sizeof buff, "(%s)", target->BubbleText() );
 			break;
 		
 		case kBubblePonder:
 			// Person ponders, "thoughts"
 			snprintf( buff, sizeof buff, _(TXTCL_BUBBLE_PONDER),
-				speakerName, target->descBubbleText );
+				speakerName, target->BubbleText() );
 			break;
 		
 		case kBubbleThought:
@@ -8168,10 +8641,10 @@ id		142			141
 			int typeThinkBubble = ExtractTypeThinkBubble( target );
 #endif // MULTILINGUAL
 			
-			const char * ptr2 = strchr( target->descBubbleText, ':' );
+			const char * ptr2 = strchr( target->BubbleText(), ':' );
 			if ( not ptr2 )
 				// a thought without a thinker!?!? How quaint
-				StringCopySafe( buff, target->descBubbleText, sizeof buff );
+				StringCopySafe( buff, target->BubbleText(), sizeof buff );
 			else
 				{
 #if defined( MULTILINGUAL )
@@ -8277,14 +8750,14 @@ id		142			141
 		case kBubbleNarrate:
 			// (person): message
 			snprintf( buff, sizeof buff,
-				"(%s): %s", speakerName, target->descBubbleText );
+				"(%s): %s", speakerName, target->BubbleText() );
 			break;
 		
 		default:
 			// unknown bubble type?!
 			// Person declaims, "message"
 			snprintf( buff, sizeof buff, _(TXTCL_BUBBLE_DECLAIM),
-				speakerName, target->descBubbleText );
+				speakerName, target->BubbleText() );
 			break;
 		}
 	
@@ -8865,6 +9338,38 @@ ShowInfoText( const char * text )
 }
 
 
+/*
+**	BuildMobileHitGrid()
+**
+**	file the mobiles by where they were last drawn, name tags included
+*/
+void
+BuildMobileHitGrid()
+{
+	gMobileHitGrid.Reset( &gLayout.layoFieldBox );
+	const DSMobile * mobile = gDSMobile;
+	for ( int nnn = 0;  nnn < gNumMobiles;  ++nnn, ++mobile )
+		{
+		DTSRect box = gDescTable[ mobile->dsmIndex ].descLastDstBox;
+		box.rectBottom += 14;
+		gMobileHitGrid.Insert( &box, nnn );
+		}
+}
+
+
+/*
+**	InvalidateMobileHits()
+**
+**	for other files that replace gDSMobile or gDescTable wholesale: call once
+**	when done, and the grid is rebuilt before the next hit test
+*/
+void
+InvalidateMobileHits()
+{
+	gMobileHitGrid.Invalidate();
+}
+
+
 /*
 **	LocateMobileByPoint()
 **
@@ -8874,11 +9379,30 @@ DescTable *
 LocateMobileByPoint( const DTSPoint * where, int inKind )
 {
 	// attempt to search in reverse Z order (to the extent that
-	// makes sense for mobiles)
-	const DSMobile * mobile = gDSMobile + gNumMobiles - 1;
+	// makes sense for mobiles). only the ones filed in the point's cell
+	// can be there, and the grid lists them latest first.
+	if ( not gMobileHitGrid.IsReady() )
+		BuildMobileHitGrid();
+	
+	short nearby[ CRectGrid::kMaxItems ];
+	int numNearby;
+	if ( gMobileHitGrid.Overflowed() )
+		{
+		numNearby = gNumMobiles;
+		for ( int nnn = 0;  nnn < numNearby;  ++nnn )
+			nearby[ nnn ] = numNearby - 1 - nnn;
+		}
+	else
+		{
+		DTSRect spot;
+		spot.rectTop    = spot.rectBottom = where->ptV;
+		spot.rectLeft   = spot.rectRight  = where->ptH;
+		numNearby = gMobileHitGrid.Collect( &spot, nearby );
+		}
 	
-	for ( int nnn = gNumMobiles;  nnn > 0;  --nnn, --mobile )
+	for ( int nnn = 0;  nnn < numNearby;  ++nnn )
 		{
+		const DSMobile * mobile = gDSMobile + nearby[ nnn ];
 		DescTable * desc = gDescTable + mobile->dsmIndex;
 		
 		if ( inKind != kDescUnknown && desc->descType != inKind )
@@ -9624,21 +10148,18 @@ fillNightTextureObject()
 		gUseLightMap = true;
 		
 		GLfloat clearColorf = (100 - nightPct) / 100.0f;
-//		ushort clearColorus = clearColorf * 0xFFFF;
 		GLfloat redshiftClearColorf = clearColorf
 									* gNightInfo.GetMorningEveningRedshift();
 		if ( redshiftClearColorf > 1.0f )
 			redshiftClearColorf = 1.0f;
-//		ushort redshiftus = redshiftClearColorf * 0xFFFF;
+#ifdef OGL_QUICKDRAW_LIGHT_EFFECTS
+		ushort clearColorus = clearColorf * 0xFFFF;
+		ushort redshiftus = redshiftClearColorf * 0xFFFF;
+#endif	// OGL_QUICKDRAW_LIGHT_EFFECTS
 		
 		bool bufferIsInverted = false;	// default settings
 		
 #ifdef OGL_QUICKDRAW_LIGHT_EFFECTS
-		CGrafPtr oldCGrafPtr;
-		GDHandle oldGDHandle;
-		Ptr lightmapBaseAddr;
-		int lightmapRowBytes;
-		
 		if ( gUsingOpenGL )
 			{
 #endif	// OGL_QUICKDRAW_LIGHT_EFFECTS
@@ -9690,27 +10211,12 @@ fillNightTextureObject()
 			}
 		else
 			{
-// hmmm.
-// not using one of the DTS constructs, so I can't use SetForeColor,
-// Paint, SetBackColor should I use native OS calls, or try to find the
-// closest dts class and use that?
-			::GetGWorld( &oldCGrafPtr, &oldGDHandle );
-			::SetGWorld( gLightmapGWorld, nullptr );
-			PixMapHandle pmh = ::GetGWorldPixMap ( gLightmapGWorld );
-			::LockPixels( pmh );
-				// the gworld was not created with the pixPurge flag,
-				// so it can't be purged, so LockPixels can't fail (right?)
-			lightmapBaseAddr = ::GetPixBaseAddr( pmh );
-			lightmapRowBytes = ::GetPixRowBytes( pmh ) & 0x3FFF;
-				// carbon + 8.5; will this be a problem?
-			
-			if ( clearColorf >= 0.5f )
-				{
-				RGBColor background = { redshiftus, clearColorus, clearColorus };
-				::RGBBackColor( &background );
-				::EraseRect( DTS2Mac(&gLayout.layoFieldBox) );
-				::RGBBackColor( DTS2Mac(&DTSColor::white) );
-				}
+			// nothing is drawn until qdFinishLightmap(); this only
+			// starts a new frame and queues up the ambient light.
+			// the starlight (below) replaces it when the night is that dark.
+			RGBColor moonlightColorusv = { redshiftus, clearColorus, clearColorus };
+			const RGBColor noStarlight = { 0, 0, 0 };
+			qdClearLightmap( moonlightColorusv, noStarlight );
 			}
 #endif	// OGL_QUICKDRAW_LIGHT_EFFECTS
 
@@ -9765,8 +10271,6 @@ fillNightTextureObject()
 				ushort starlightColorus = 0xFFFF * starlightColorf;
 				RGBColor starlightColorusv
 					 = { starlightColorus, starlightColorus, starlightColorus };
-				Rect box = { gFieldCenter.ptV - 325, gFieldCenter.ptH - 325,
-							 gFieldCenter.ptV + 325, gFieldCenter.ptH + 325 };
 				RGBColor moonlightColorusv = { redshiftus, clearColorus, clearColorus };
 				qdClearLightmap( moonlightColorusv, starlightColorusv );
 				}
@@ -9982,8 +10486,7 @@ fillNightTextureObject()
 									Point center = { gFieldCenter.ptV + pq->pqVert + jitterV,
 													 gFieldCenter.ptH + pq->pqHorz + jitterH };
 									
-									qdLightmapCircularElementBlitter( lightmapBaseAddr,
-										lightmapRowBytes,
+									qdQueueLightmapCaster(
 										center, radius,
 										( cache->icHeight + cache->icBox.rectRight ) / 2,
 										colorus, lightdarkcaster );
@@ -10166,8 +10669,7 @@ fillNightTextureObject()
 												gFieldCenter.ptH + mobile->dsmHorz + jitterH
 												};
 											
-											qdLightmapCircularElementBlitter(
-												lightmapBaseAddr, lightmapRowBytes,
+											qdQueueLightmapCaster(
 												center, radius,
 												cache->icBox.rectRight / 16, colorus,
 												lightdarkcaster );
@@ -10328,9 +10830,8 @@ fillNightTextureObject()
 			}
 		else
 			{
-			::UnlockPixels( ::GetGWorldPixMap ( gLightmapGWorld ) );
-			
-			::SetGWorld( oldCGrafPtr, oldGDHandle );
+				// ambient, casters and clamp, all in one pass
+			qdFinishLightmap();
 			}
 #endif	// OGL_QUICKDRAW_LIGHT_EFFECTS
 		}
@@ -10346,493 +10847,6 @@ fillNightTextureObject()
 			}
 		}
 }
-
-
-void
-qdLightmapCircularElementBlitter(
-	Ptr baseAddr,
-	int rowBytes,
-	const Point& center,
-	int radius,
-	int minimumRadius,
-	const RGBColor& colorus,
-	bool lightdarkcaster )
-{
-	// keep here, or make external, so it can be deleted in deleteNonOGLObjects() ?
-	static bool firstTime = true;
-	static uchar circularScale[kLightmapScaleCircleArraySize][kLightmapScaleCircleArraySize];
-	if ( firstTime )
-		{
-		for ( int x = 0; x < kLightmapScaleCircleArraySize; ++x )
-			{
-			float xPixelCenter = x + 0.5f;
-			for ( int y = 0; y < kLightmapScaleCircleArraySize; ++y )
-				{
-				float yPixelCenter = y + 0.5f;
-				float dist = hypotf( xPixelCenter, yPixelCenter );
-				if ( dist > kLightmapMaximumRadius )
-					circularScale[y][x] = 0;
-				else
-					circularScale[y][x] = 0xFF *
-						( kLightmapMaximumRadius - dist ) / kLightmapMaximumRadius;
-				}
-			}
-		firstTime = false;
-		}
-	
-	static int index[ kLightmapScaleCircleArraySize ];
-	
-	// precalculate the indexes into the circle array
-	// if the radius is too big for the array, clamp it
-	// (this is now redundant with the mainline code)
-	
-	if ( radius > gLightmapRadiusLimit )
-		radius = gLightmapRadiusLimit;
-	if ( radius < minimumRadius )
-		radius = minimumRadius;
-	
-	if ( gCachedCircularLightmapElementRadius != radius )
-		{
-		// gCachedCircularLightmapElementRadius didn't gain me any speed,
-		// so it may disappear in the future
-		for ( int i = 0; i < radius; ++i )
-			index[i] = kLightmapMaximumRadius * i / radius;
-		
-		for ( int i = radius; i < kLightmapScaleCircleArraySize; ++i )
-			index[i] = kLightmapMaximumRadius;
-		
-		gCachedCircularLightmapElementRadius = radius;
-		}
-	
-	const int bytesPerPixel = 4;
-	
-	int startH = center.h - radius < gLayout.layoFieldBox.rectLeft
-					? gLayout.layoFieldBox.rectLeft : center.h - radius;
-	int endH = center.h + radius > gLayout.layoFieldBox.rectRight
-					? gLayout.layoFieldBox.rectRight : center.h + radius;
-	int startV = center.v - radius < gLayout.layoFieldBox.rectTop
-					? gLayout.layoFieldBox.rectTop : center.v - radius;
-	int endV = center.v + radius > gLayout.layoFieldBox.rectBottom
-					? gLayout.layoFieldBox.rectBottom : center.v + radius;
-	
-	int centerH = center.h;
-	int centerV = center.v;
-	
-	for ( int v = startV; v < endV; ++v )
-		{
-		int dv = centerV > v ? centerV - v : v - centerV;
-		int dvCoord = index[dv];
-		
-		char * p = baseAddr + v * rowBytes + ( startH - 1 ) * bytesPerPixel;
-		
-		for ( int h = startH; h < endH; ++h )
-			{
-			int dh = centerH > h ? centerH - h : h - centerH;
-			int dhCoord = index[dh];
-			
-			p += bytesPerPixel;
-			
-			int colorScale = circularScale[dvCoord][dhCoord];
-			
-			if ( colorScale )
-				{
-				int scaledShiftedMaskedRed =
-					( colorus.red * colorScale ) & 0x00ff0000;
-				int scaledShiftedMaskedGreen =
-					( ( colorus.green * colorScale ) >> 8 ) & 0x0000ff00;
-				int scaledShiftedMaskedBlue =
-					( ( colorus.blue * colorScale ) >> 16 ) & 0x000000ff;
-				
-				int oldColor = 0x00ffffff & * reinterpret_cast<int32_t *>( p );
-				int red, green, blue, newColor;
-				
-				if ( lightdarkcaster )
-					{
-					// if  not already fully saturated (white)
-					if ( oldColor != 0x00ffffff )
-						{
-						red = ( oldColor & 0x00ff0000 ) + scaledShiftedMaskedRed;
-						if ( red > 0x00ff0000 )
-							red = 0x00ff0000;
-						
-						green = ( oldColor & 0x0000ff00 ) + scaledShiftedMaskedGreen;
-						if ( green > 0x0000ff00 )
-							green = 0x0000ff00;
-						
-						blue = ( oldColor & 0x000000ff ) + scaledShiftedMaskedBlue;
-						if ( blue > 0x000000ff )
-							blue = 0x000000ff;
-						
-						newColor = red | green | blue;
-						}
-					else
-						newColor = 0x00ffffff;
-					}
-				else
-					{
-					if ( oldColor )	// if != 0x00000000 (fully saturated black)
-						{
-						red = ( oldColor & 0x00ff0000 ) - scaledShiftedMaskedRed;
-						if ( red < 0x0000ffff )
-							red = 0x00000000;
-						
-						green = ( oldColor & 0x0000ff00 ) - scaledShiftedMaskedGreen;
-						if ( green < 0x000000ff )
-							green = 0x00000000;
-						
-						blue = ( oldColor & 0x000000ff ) - scaledShiftedMaskedBlue;
-						if ( blue < 0 )
-							blue = 0x00000000;
-						
-						newColor = red | green | blue;
-						}
-					else
-						newColor = 0x00000000;
-					}
-				if ( newColor != oldColor )
-					* reinterpret_cast<int32_t *>( p ) = newColor;
-				}
-			}
-		}
-}
-
-
-void
-qdClearLightmap( const RGBColor& moonlight, const RGBColor& starlight )
-{
-// keep here, or make external, so it can be deleted in deleteNonOGLObjects() ?
-// we use this circle a lot, so we'll give it its own optimal-size array
-// and eliminate the index scaling
-	
-	static bool firstTime = true;
-	const int circleSize = 326;
-	static uchar circularScale[circleSize][circleSize];
-	if ( firstTime )
-		{
-		for ( int x = 0; x < circleSize; ++x )
-			{
-			for ( int y = 0; y < circleSize; ++y )
-				{
-				float xPixelCenter = x + 0.5f;
-				float yPixelCenter = y + 0.5f;
-				float dist = hypotf( xPixelCenter, yPixelCenter );
-				if ( dist > circleSize )
-					circularScale[y][x] = 0;
-				else
-					circularScale[y][x] = 0xff * (circleSize - dist) / circleSize;
-				}
-			}
-		firstTime = false;
-		}
-	
-	static int circularScaleColored[circleSize][circleSize];
-	static RGBColor oldMoonlight = { 0x0000, 0x0000, 0x0000 };
-	static RGBColor oldStarlight = { 0x0000, 0x0000, 0x0000 };
-	bool colorChanged = false;
-	
-	if ( oldMoonlight.red != moonlight.red
-	||   oldMoonlight.green != moonlight.green
-	||   oldMoonlight.blue != moonlight.blue
-	||   oldStarlight.red != starlight.red
-	||   oldStarlight.green != starlight.green
-	||   oldStarlight.blue != starlight.blue )
-		{
-		colorChanged = true;
-		oldMoonlight = moonlight;
-		oldStarlight = starlight;
-		}
-	
-	PixMapHandle pmh = ::GetGWorldPixMap( gLightmapGWorld );
-	Ptr baseAddr = ::GetPixBaseAddr( pmh );
-	
-	// carbon + 8.5; will this be a problem?
-	int rowBytes = ::GetPixRowBytes( pmh ) & 0x3fff;
-	
-	const int bytesPerPixel = 4;
-	
-	int startH = gLayout.layoFieldBox.rectLeft;
-	int endH = gLayout.layoFieldBox.rectRight;
-	int startV = gLayout.layoFieldBox.rectTop;
-	int endV = gLayout.layoFieldBox.rectBottom;
-	
-	int centerH = gFieldCenter.ptH;
-	int centerV = gFieldCenter.ptV;
-	
-	int moonlightRed = ( moonlight.red << 8 ) & 0x00ff0000;
-	int moonlightGreen = moonlight.green & 0x0000ff00;
-	int moonlightBlue = moonlight.blue  >> 8;
-	
-// trading less computation for more cache thrash was a win
-	
-	for ( int v = centerV; v < endV; ++v )
-		{
-		int dv = centerV > v ? centerV - v : v - centerV;
-		
-		for ( int h = centerH; h < endH; ++h )
-			{
-			int dh = centerH > h ? centerH - h : h - centerH;
-			
-			if ( colorChanged )
-				{
-					// do I need a sanity check to prevent out-of-bounds?
-				int colorScale = circularScale[dv][dh];
-				int newColor;
-				if ( colorScale )
-					{
-					int red = moonlightRed + ( starlight.red * colorScale ) & 0x00ff0000;
-					if ( red > 0x00ff0000 )
-						red = 0x00ff0000;
-					
-					int green = moonlightGreen
-						+ ( ( starlight.green * colorScale ) >> 8 ) & 0x0000ff00;
-					if ( green > 0x0000ff00 )
-						green = 0x0000ff00;
-					
-					int blue = moonlightBlue
-						+ ( ( starlight.blue * colorScale ) >> 16 ) & 0x000000ff;
-					if ( blue > 0x000000ff )
-						blue = 0x000000ff;
-					
-					newColor = red | green | blue;
-					}
-				else
-					newColor = moonlightRed + moonlightGreen + moonlightBlue;
-				
-				char * ll = baseAddr + v * rowBytes
-						  + ( startH + endH - h - 1 ) * bytesPerPixel;
-				* reinterpret_cast<int32_t *>( ll ) = newColor;
-				char * lr = baseAddr + v * rowBytes + h * bytesPerPixel;
-				* reinterpret_cast<int32_t *>( lr ) = newColor;
-				char * ul = baseAddr
-						  + ( startV + endV - v - 1 ) * rowBytes
-						  + ( startH + endH - h - 1 ) * bytesPerPixel;
-				* reinterpret_cast<int32_t *>( ul ) = newColor;
-				char * ur = baseAddr + ( startV + endV - v - 1 ) * rowBytes
-						  + h * bytesPerPixel;
-				* reinterpret_cast<int32_t *>( ur ) = newColor;
-				
-				circularScaleColored[dv][dh] = newColor;
-				}
-			else
-				{
-				int newColor = circularScaleColored[dv][dh];
-				char * ll = baseAddr + v * rowBytes
-						  + ( startH + endH - h - 1 ) * bytesPerPixel;
-				* reinterpret_cast<int32_t *>( ll ) = newColor;
-				char * lr = baseAddr + v * rowBytes + h * bytesPerPixel;
-				* reinterpret_cast<long *>( lr ) = newColor;
-				char * ul = baseAddr + ( startV + endV - v - 1 ) * rowBytes
-						  + ( startH + endH - h - 1 ) * bytesPerPixel;
-				* reinterpret_cast<long *>( ul ) = newColor;
-				char * ur = baseAddr + ( startV + endV - v - 1 ) * rowBytes
-						  + h * bytesPerPixel;
-				* reinterpret_cast<int32_t *>( ur ) = newColor;
-				}
-			}
-		}
-}
-
-
-void
-qdApplyLightmap()
-{
-// also buried deep in the gl initialization
-// to do: find a better (common, once-only) place for this
-	if ( not gIndexToRedMap )
-		{
-		GetAppData( 'BTbl', 5,
-			reinterpret_cast< void** >( &gIndexToRedMap ), nullptr );
-		GetAppData( 'BTbl', 6,
-			reinterpret_cast< void** >( &gIndexToGreenMap ), nullptr );
-		GetAppData( 'BTbl', 7,
-			reinterpret_cast< void** >( &gIndexToBlueMap ), nullptr );
-		}
-#if 0
-	CGrafPtr oldCGrafPtr;
-	GDHandle oldGDHandle;
-	::GetGWorld( &oldCGrafPtr, &oldGDHandle );
-	PixMapHandle pmh = ::GetGWorldPixMap ( oldCGrafPtr );
-	Ptr baseAddr = ::GetPixBaseAddr( pmh );
-	int rowBytes = ::GetPixRowBytes( pmh ) & 0x3fff;
-#else
-	CLWindow * win = static_cast<CLWindow *>( gGameWindow );
-	void * baseAddr = win->winOffView.offBufferImage.GetBits();	// returns baseAddr
-	int rowBytes = win->winOffView.offBufferImage.GetRowBytes();
-#endif
-	
-	PixMapHandle pmh = ::GetGWorldPixMap( gLightmapGWorld );
-	::LockPixels( pmh );
-	Ptr lightmapBaseAddr = ::GetPixBaseAddr( pmh );
-	int lightmapRowBytes = ::GetPixRowBytes( pmh ) & 0x3fff;
-	
-	const int bytesPerPixel = 4;
-	
-	int startH = gLayout.layoFieldBox.rectLeft;
-	int endH = gLayout.layoFieldBox.rectRight;
-	int startV = gLayout.layoFieldBox.rectTop;
-	int endV = gLayout.layoFieldBox.rectBottom;
-	
-	static uchar * gRGB444ToIndexMap = nullptr;
-		// RGB444 is 4 bits each of red, green, blue; 4096 possible combinations
-	if ( not gRGB444ToIndexMap )
-		{
-#if 1	// resource vs make it ourselves
-		GetAppData( 'BTbl', 8,
-			reinterpret_cast<void **>( &gRGB444ToIndexMap ), nullptr );
-#else
-		// pixel needs to be in bounds
-		uchar * address = reinterpret_cast<uchar *>( baseAddr )
-						+ startV * rowBytes + startH;
-		gRGB444ToIndexMap = NEW_TAG("gRGB444ToIndexMap") uchar[16*16*16];
-		if ( not gRGB444ToIndexMap )
-			return;
-		
-		for ( ushort r = 0; r < 16; ++r )
-			{
-			for ( ushort g = 0; g < 16; ++g )
-				{
-				for ( ushort b = 0; b < 16; ++b )
-					{
-					RGBColor c = { r << 12, g << 12, b << 12 };
-					::SetCPixel( startH, startV, &c );
-					ushort index = ( r << 8 ) + ( g << 4 ) + b;
-					gRGB444ToIndexMap[ index ] = *address;
-#if 1	// confidence test
-					int i2cIndex = ::Color2Index( &c );
-						// the docs say we should avoid using Color2Index
-					if ( i2cIndex != gRGB444ToIndexMap[ index ] )
-						{
-						ShowMessage( "unexpected color mismatch when "
-							"generating gRGB444ToIndexMap: "
-							"%d != %d (%x, %x, %x(",
-							i2cIndex, gRGB444ToIndexMap[ index ],
-							c.red, c.green, c.blue );
-//						gRGB444ToIndexMap[ index ] = i2cIndex;
-						}
-#endif	// confidence test
-					}
-				}
-			}
-#if 1	// confidence test
-			// make sure the original colors come through true
-		for ( int index = 0; index < 256; ++index )
-			{
-			ushort r = gIndexToRedMap[ index ];
-			ushort g = gIndexToGreenMap[ index ];
-			ushort b = gIndexToBlueMap[ index ];
-			
-			ulong rgb444 = ( ( r & 0xf000 ) >> 4 )
-						+ ( ( g & 0xf000 ) >> 8 ) + ( ( b & 0xf000 ) >> 12 );
-			
-			if ( gRGB444ToIndexMap[ rgb444 ] != index )
-				{
-				ShowMessage( "mismatch @ %u (%u): %x %x %x != %x %x %x", index, rgb444,
-				gIndexToRedMap[ gRGB444ToIndexMap[ rgb444 ] ],
-				gIndexToGreenMap[ gRGB444ToIndexMap[ rgb444 ] ],
-				gIndexToBlueMap[ gRGB444ToIndexMap[ rgb444 ] ],
-				r, g, b );
-				}
-//			gRGB444ToIndexMap[ rgb444 ] = index;
-			}
-#endif	// confidence test
-
-// barf out the data in rez format so we can make a proper resource out of it
-// (is there a way to suppress the timestamp?)
-		for ( int i = 0;  i < 16*16*16;  i += 16 )
-			{
-			ShowMessage( "\t$\"%2.2x %2.2x %2.2x %2.2x %2.2x %2.2x %2.2x %2.2x "
-							  "%2.2x %2.2x %2.2x %2.2x %2.2x %2.2x %2.2x %2.2x\"",
-				gRGB444ToIndexMap[i+ 0], gRGB444ToIndexMap[i+ 1],
-				gRGB444ToIndexMap[i+ 2], gRGB444ToIndexMap[i+ 3],
-				gRGB444ToIndexMap[i+ 4], gRGB444ToIndexMap[i+ 5],
-				gRGB444ToIndexMap[i+ 6], gRGB444ToIndexMap[i+ 7],
-				gRGB444ToIndexMap[i+ 8], gRGB444ToIndexMap[i+ 9],
-				gRGB444ToIndexMap[i+10], gRGB444ToIndexMap[i+11],
-				gRGB444ToIndexMap[i+12], gRGB444ToIndexMap[i+13],
-				gRGB444ToIndexMap[i+14], gRGB444ToIndexMap[i+15]
-			);
-			}
-#endif	// resource switch
-		}
-	
-	for ( int v = startV; v < endV; ++v )
-		{
-		for ( int h = startH; h < endH; ++h )
-			{
-				// could be slightly faster (use add instead of multiply)
-			ulong * lightmapPtr = reinterpret_cast<ulong *>(
-					 lightmapBaseAddr + v * lightmapRowBytes + h * bytesPerPixel );
-			ulong lightmapColor = * lightmapPtr;
-			
-				// could be slightly faster (use add instead of multiply)
-			uchar * destPtr = reinterpret_cast<uchar *>( baseAddr )
-							+ v * rowBytes + h;
-			uchar destColorIndex = * destPtr;
-			
-				// these four lines could be combined...
-			ushort red   = ( ( ( lightmapColor & 0x00ff0000 ) >> 8 )
-							* gIndexToRedMap  [destColorIndex] ) >> 16;
-			ushort green = (   ( lightmapColor & 0x0000ff00 )
-							* gIndexToGreenMap[destColorIndex] ) >> 16;
-			ushort blue  = ( ( ( lightmapColor & 0x000000ff ) << 8 )
-							* gIndexToBlueMap [destColorIndex] ) >> 16;
-			
-			ushort index = ( ( red & 0xf000 ) >> 4 )
-						 + ( ( green & 0xf000 ) >> 8 )
-						 + ( ( blue & 0xf000 ) >> 12 );
-			* destPtr = gRGB444ToIndexMap[ index ];
-				// could do some black magic and move 8 bytes per write...
-			}
-		}
-	::UnlockPixels( ::GetGWorldPixMap ( gLightmapGWorld ) );
-}
-
-
-void
-qdClampLightmap( float nightCLampColor )
-{
-	PixMapHandle pmh = ::GetGWorldPixMap ( gLightmapGWorld );
-	::LockPixels( pmh );
-	Ptr lightmapBaseAddr = ::GetPixBaseAddr( pmh );
-	int lightmapRowBytes = ::GetPixRowBytes( pmh ) & 0x3fff;	// carbon + 8.5
-	
-	const int bytesPerPixel = 4;
-	
-	int startH = gLayout.layoFieldBox.rectLeft;
-	int endH = gLayout.layoFieldBox.rectRight;
-	int startV = gLayout.layoFieldBox.rectTop;
-	int endV = gLayout.layoFieldBox.rectBottom;
-	
-	uint nightCLampBlue = nightCLampColor * 0xff;
-	uint nightCLampGreen = nightCLampBlue << 8;
-	uint nightCLampRed = nightCLampBlue << 16;
-	
-	for ( int v = startV; v < endV; ++v )
-		{
-		for ( int h = startH; h < endH; ++h )
-			{
-			uint32_t * lightmapPtr = reinterpret_cast<uint32_t *>(
-				lightmapBaseAddr + v * lightmapRowBytes + h * bytesPerPixel );
-			uint32_t lightmapColor = *lightmapPtr;
-			
-			uint red = lightmapColor & 0x00ff0000;
-			if ( red < nightCLampRed )
-				red = nightCLampRed;
-			uint green = lightmapColor & 0x0000ff00;
-			if ( green < nightCLampGreen )
-				green = nightCLampGreen;
-			uint blue = lightmapColor & 0x000000ff;
-			if ( blue < nightCLampBlue )
-				blue = nightCLampBlue;
-			
-			uint32_t color = red | green | blue;
-			
-			if ( lightmapColor != color )
-				*lightmapPtr = color;
-			}
-		}
-	::UnlockPixels( ::GetGWorldPixMap( gLightmapGWorld ) );
-}
 #endif	// USE_OPENGL
 
 
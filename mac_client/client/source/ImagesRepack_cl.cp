@@ -0,0 +1,407 @@
+/*
+**	ImagesRepack_cl.cp		ClanLord
+** 
+**	Copyright 2023 Delta Tao Software, Inc.
+** 
+**	Licensed under the Apache License, Version 2.0 (the "License");
+**	you may not use this file except in compliance with the License.
+**	You may obtain a copy of the License at
+** 
+**     https://www.apache.org/licenses/LICENSE-2.0
+** 
+**	Unless required by applicable law or agreed to in writing, software
+**	distributed under the License is distributed on an "AS IS" BASIS,
+**	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+**	See the License for the specific language governing permissions and
+**	imitations under the License.
+*/
+
+/*
+**	Rewrites CL_Images so that the pictures the client needs together are stored
+**	together.
+**
+**	Updates land wherever DTSKeyFile finds room for them, so the art for any one
+**	area ends up strewn across the whole file, and walking into a new area on a
+**	cold disk is one seek per record. This tool replays recorded movies the way
+**	the client would draw them: every picture a drawstate names -- the mobiles'
+**	descriptors, and the pictures Queue1Picture() hands to CachePicture() -- in
+**	order. The pictures a frame shows for the first time are treated as one set,
+**	since that's the burst of loads the client does on arrival. Each picture's
+**	PictDef, bits, colors and lighting are then laid down in that order by
+**	DTSKeyFile::Repack(); pictures no movie shows follow, as before.
+**
+**	Only the layout changes, so the client's verified-image and decoded-image
+**	caches stay good. Quit the client first: it must not have the file open.
+**
+**	Usage: see Usage(), below.
+*/
+
+#ifndef _dtslib2_
+# include "Prefix_dts.h"
+#endif
+
+#include <unistd.h>
+
+#include "DatabaseTypes_cl.h"
+#include "Public_cl.h"
+#include "MovieScan_cl.h"
+
+using std::fprintf;
+using std::printf;
+using std::memcpy;
+
+
+/*
+**	Definitions
+*/
+const DTSKeyID	kMaxPictID			= 0x10000;	// descriptors have 16-bit IDs
+const int		kRecordsPerPict		= 4;		// def, bits, colors, lighting
+const DTSKeyID	kNoPictID			= 0xFFFF;	// a descriptor that's heard but not seen
+const DTSKeyID	kNoPictStandIn		= 537;		// ... drawn as the boat; see ReadKeyFromSpool()
+
+
+/*
+**	command-line options
+*/
+struct SOptions
+{
+	bool			opDryRun;		// just report
+	const char *	opImagesPath;
+	char **			opMoviePaths;
+	int				opNumMovies;
+};
+
+
+/*
+**	Internal Routines
+*/
+static void			Usage( const char * name );
+static bool			ParseOptions( int argc, char ** argv );
+static DTSError		ReplayMovie( const char * path );
+static void			ReplayFrame( const SMovieFrame& frame, void * refCon );
+static void			ReplayDrawState( const uchar * data, size_t size );
+static void			SeePicture( DTSKeyID pictID );
+static void			PlaceFrame();
+static void			PlaceRecord( DTSKeyType type, DTSKeyID id );
+
+
+/*
+**	Internal Variables
+*/
+static SOptions		gOptions;
+static DTSKeyFile	gImages;
+static uchar *		gSeen;				// [kMaxPictID]; nonzero once a movie has shown it
+static DTSKeyID *	gFrameNew;			// [kMaxPictID]; what this frame shows for the first time
+static int			gNumFrameNew;
+static DTSKeyRef *	gOrder;				// [kMaxPictID * kRecordsPerPict]
+static long			gNumOrder;
+static long			gNumPicts;			// pictures placed
+static long			gNumMissing;		// pictures the movies show that we don't have
+static long			gNumFrames;
+
+
+/*
+**	main()
+**
+**	replay the movies, then repack the images file in the order they showed things
+*/
+int
+main( int argc, char ** argv )
+{
+	if ( not ParseOptions( argc, argv ) )
+		{
+		Usage( argv[0] );
+		return 1;
+		}
+	
+	uint flags = kKeyDontCreateFile
+			   | ( gOptions.opDryRun ? kKeyReadOnlyPerm : kKeyReadWritePerm );
+	DTSError result = gImages.Open( gOptions.opImagesPath, flags );
+	if ( noErr != result )
+		{
+		fprintf( stderr, "Can't open %s: error %d.\n", gOptions.opImagesPath, (int) result );
+		return 1;
+		}
+	
+	gSeen		= NEW_TAG("RepackSeen") uchar[ kMaxPictID ];
+	gFrameNew	= NEW_TAG("RepackFrameNew") DTSKeyID[ kMaxPictID ];
+	gOrder		= NEW_TAG("RepackOrder") DTSKeyRef[ kMaxPictID * kRecordsPerPict ];
+	if ( not gSeen  ||  not gFrameNew  ||  not gOrder )
+		result = memFullErr;
+	else
+		memset( gSeen, 0, kMaxPictID );
+	
+	for ( int i = 0;  noErr == result && i < gOptions.opNumMovies;  ++i )
+		{
+		// a bad movie just doesn't contribute
+		ReplayMovie( gOptions.opMoviePaths[i] );
+		}
+	
+	DTSKeyInfo before;
+	if ( noErr == result )
+		result = gImages.GetInfo( &before );
+	if ( noErr == result )
+		{
+		printf( "%ld frames showed %ld pictures (%ld records); %ld weren't in %s.\n",
+			gNumFrames, gNumPicts, gNumOrder, gNumMissing, gOptions.opImagesPath );
+		}
+	
+	if ( noErr == result
+	&&   not gOptions.opDryRun )
+		{
+		if ( 0 == gNumOrder )
+			printf( "Nothing to do.\n" );
+		else
+			{
+			result = gImages.Repack( gOrder, gNumOrder );
+			
+			DTSKeyInfo after;
+			if ( noErr == result )
+				result = gImages.GetInfo( &after );
+			if ( noErr == result )
+				{
+				printf( "Repacked %ld records; %ld bytes (was %ld).\n",
+					after.keyNumRecords, after.keyFileSize, before.keyFileSize );
+				}
+			}
+		}
+	
+	if ( noErr != result )
+		fprintf( stderr, "Repack failed: error %d.\n", (int) result );
+	
+	gImages.Close();
+	
+	delete[] gOrder;
+	delete[] gFrameNew;
+	delete[] gSeen;
+	
+	return noErr == result ? 0 : 1;
+}
+
+
+/*
+**	Usage()
+*/
+void
+Usage( const char * name )
+{
+	fprintf( stderr,
+		"usage: %s [-n] CL_Images movie.clMov ...\n"
+		"  -n            don't change anything; just report what the movies show\n"
+		"The client must not be running.\n",
+		name );
+}
+
+
+/*
+**	ParseOptions()
+**
+**	fill in gOptions from the command line
+*/
+bool
+ParseOptions( int argc, char ** argv )
+{
+	SOptions& op = gOptions;
+	op.opDryRun		= false;
+	op.opImagesPath	= nullptr;
+	op.opMoviePaths	= nullptr;
+	op.opNumMovies	= 0;
+	
+	int ch;
+	while ( -1 != (ch = getopt( argc, argv, "n" )) )
+		{
+		switch ( ch )
+			{
+			case 'n':	op.opDryRun		= true;		break;
+			default:	return false;
+			}
+		}
+	
+	if ( optind > argc - 2 )
+		return false;
+	op.opImagesPath	= argv[ optind ];
+	op.opMoviePaths	= argv + optind + 1;
+	op.opNumMovies	= argc - optind - 1;
+	
+	return true;
+}
+
+
+#pragma mark -
+
+/*
+**	ReplayMovie()
+**
+**	read the whole movie, and walk its drawstates in order,
+**	skipping pseudo-frames
+*/
+DTSError
+ReplayMovie( const char * path )
+{
+	uchar * data;
+	size_t size;
+	DTSError result = ReadMovieFile( path, &data, &size );
+	if ( noErr != result )
+		return result;
+	
+	ScanMovieFrames( data, size, ReplayFrame, nullptr );
+	delete[] data;
+	
+	return noErr;
+}
+
+
+/*
+**	ReplayFrame()
+**
+**	ScanMovieFrames() callback. Pseudo-frames don't show anything
+*/
+void
+ReplayFrame( const SMovieFrame& frame, void * )
+{
+	if ( not ( frame.mfFlags & kMovieFlagPseudo )
+	&&   kMsgDrawState == Peek16( frame.mfData ) )
+		{
+		ReplayDrawState( frame.mfData, frame.mfSize );
+		}
+}
+
+
+/*
+**	ReplayDrawState()
+**
+**	parse a drawstate the way CCLFrame::ReadKeyFromSpool() does, as far as the
+**	pictures, and note every picture it would have the client load
+*/
+void
+ReplayDrawState( const uchar * data, size_t size )
+{
+	static DataSpool spool;
+	if ( not spool.GetData()  &&  noErr != spool.Init( sizeof(Message) ) )
+		return;
+	if ( size > sizeof(Message) )
+		return;
+	
+	// zero the tail, so a runaway string stops at the end of the message
+	uchar * buffer = static_cast<uchar *>( spool.GetData() );
+	memcpy( buffer, data, size );
+	memset( buffer + size, 0, sizeof(Message) - size );
+	spool.SetLimit( size );
+	spool.SetMark( 0 );
+	spool.ClearResult();
+	
+	spool.GetNumber( kSpoolUnsignedShort );		// tag
+	spool.GetNumber( kSpoolUnsignedByte );		// ack command number
+	spool.GetNumber( kSpoolUnsignedLong );		// ack frame
+	spool.GetNumber( kSpoolUnsignedLong );		// resent frame
+	
+	gNumFrameNew = 0;
+	
+	// descriptors
+	char name[ 256 ];
+	uchar colors[ 256 ];
+	for ( int count = spool.GetNumber( kSpoolUnsignedByte );  count > 0;  --count )
+		{
+		spool.GetNumber( kSpoolUnsignedByte );	// index
+		spool.GetNumber( kSpoolUnsignedByte );	// type
+		DTSKeyID pictID = spool.GetNumber( kSpoolUnsignedShort );
+		if ( kNoPictID == pictID )
+			pictID = kNoPictStandIn;
+		spool.GetString( name, sizeof name );
+		int numColors = spool.GetNumber( kSpoolUnsignedByte );
+		spool.GetData( colors, numColors );
+		
+		if ( noErr == spool.GetResult() )
+			SeePicture( pictID );
+		}
+	
+	// hit points, spell points, balance, and light
+	for ( int i = 0;  i < 7;  ++i )
+		spool.GetNumber( kSpoolUnsignedByte );
+	
+	// pictures
+	int numPict = spool.GetNumber( kSpoolUnsignedByte );
+	if ( 255 == numPict )
+		{
+		spool.GetNumber( kSpoolUnsignedByte );	// pictures again
+		numPict = spool.GetNumber( kSpoolUnsignedByte );
+		}
+	for ( int i = 0;  i < numPict;  ++i )
+		{
+		DTSKeyID pictID;
+		int horz, vert;
+		UnspoolFramePicture( &spool, pictID, horz, vert );
+		
+		if ( noErr == spool.GetResult() )
+			SeePicture( pictID );
+		}
+	
+	// a garbled frame still tells us what it showed before it went wrong
+	PlaceFrame();
+	++gNumFrames;
+}
+
+
+/*
+**	SeePicture()
+**
+**	remember a picture the first time a frame shows it
+*/
+void
+SeePicture( DTSKeyID pictID )
+{
+	if ( pictID <= 0  ||  pictID >= kMaxPictID  ||  gSeen[ pictID ] )
+		return;
+	gSeen[ pictID ] = 1;
+	gFrameNew[ gNumFrameNew++ ] = pictID;
+}
+
+
+/*
+**	PlaceFrame()
+**
+**	add the pictures new in this frame to the order, each with its records in
+**	the order LoadImage() reads them
+*/
+void
+PlaceFrame()
+{
+	for ( int i = 0;  i < gNumFrameNew;  ++i )
+		{
+		DTSKeyID id = gFrameNew[i];
+		
+		// the IDs are in the file big-endian; see BigToNativeEndian( PictDef * )
+		uchar pd[ sizeof(PictDef) ];
+		if ( noErr != gImages.Read( kTypePictureDefinition, id, pd, sizeof pd ) )
+			{
+			++gNumMissing;
+			continue;
+			}
+		++gNumPicts;
+		
+		PlaceRecord( kTypePictureDefinition, id );
+		PlaceRecord( kTypePictureBits, Peek32( pd + offsetof( PictDef, pdBitsID ) ) );
+		PlaceRecord( kTypePictureColors, Peek32( pd + offsetof( PictDef, pdColorsID ) ) );
+		
+		if ( DTSKeyID lightID = Peek32( pd + offsetof( PictDef, pdLightingID ) ) )
+			PlaceRecord( kTypeLightingData, lightID );
+		}
+}
+
+
+/*
+**	PlaceRecord()
+**
+**	add one record to the order. Bits and colors may be shared; Repack() ignores
+**	the repeats, leaving each where its first user put it.
+*/
+void
+PlaceRecord( DTSKeyType type, DTSKeyID id )
+{
+	if ( gNumOrder >= kMaxPictID * kRecordsPerPict )
+		return;
+	
+	DTSKeyRef& ref = gOrder[ gNumOrder++ ];
+	ref.refType	= type;
+	ref.refID	= id;
+}
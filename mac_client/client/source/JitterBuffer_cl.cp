@@ -0,0 +1,459 @@
+/*
+**	JitterBuffer_cl.cp		ClanLord
+** 
+**	Copyright 2023 Delta Tao Software, Inc.
+** 
+**	Licensed under the Apache License, Version 2.0 (the "License");
+**	you may not use this file except in compliance with the License.
+**	You may obtain a copy of the License at
+** 
+**     https://www.apache.org/licenses/LICENSE-2.0
+** 
+**	Unless required by applicable law or agreed to in writing, software
+**	distributed under the License is distributed on an "AS IS" BASIS,
+**	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+**	See the License for the specific language governing permissions and
+**	imitations under the License.
+*/
+
+#include "JitterBuffer_cl.h"
+
+#include "ClanLord.h"
+
+
+/*
+**	Definitions
+*/
+const double	kMaxFrameInterval	= 2.0;		// seconds; anything longer is a stall
+const double	kResyncThreshold	= 1.0;		// seconds adrift before we start over
+const float		kExtrapolateLimit	= 0.5F;		// frames to coast when one's just late...
+const float		kExtrapolateLossy	= 1.5F;		// ... or when they're getting lost
+const int		kLossMemory			= 16;		// frames a loss makes us wary for
+const int		kMaxScrollSamples	= 128;		// pictures examined by EstimateScroll()
+const int		kMaxScrollCandidates = 16;		// matches considered per picture
+
+// one picture's say in EstimateScroll()
+struct ScrollVote
+{
+	uint32_t	svKey;			// packed (h, v) displacement, each biased by 0x8000
+	float		svWeight;		// 1 / number of candidates for that picture
+};
+
+
+/*
+**	Internal Routines
+*/
+static int		ComparePictures( const void * a, const void * b );
+static int		CompareVotes( const void * a, const void * b );
+
+
+/*
+**	CJitterBuffer::CJitterBuffer()
+*/
+CJitterBuffer::CJitterBuffer() :
+	mSlots( nullptr ),
+	mLatency( kDefaultLatency )
+{
+	Reset();
+}
+
+
+/*
+**	CJitterBuffer::~CJitterBuffer()
+*/
+CJitterBuffer::~CJitterBuffer()
+{
+	delete[] mSlots;
+}
+
+
+/*
+**	CJitterBuffer::Reset()
+**
+**	forget every frame, and everything we learned about their timing
+*/
+void
+CJitterBuffer::Reset()
+{
+	mHead			= 0;
+	mCount			= 0;
+	mShown			= -1;
+	mRecentLoss		= 0;
+	mExtrapolating	= false;
+	memset( &mStats, 0, sizeof mStats );
+}
+
+
+/*
+**	CJitterBuffer::SetLatency()
+**
+**	set the most the playout delay is allowed to be, in milliseconds
+*/
+void
+CJitterBuffer::SetLatency( int ms )
+{
+	if ( ms < 0 )
+		ms = 0;
+	else
+	if ( ms > kMaxLatency )
+		ms = kMaxLatency;
+	
+	mLatency = ms;
+}
+
+
+/*
+**	CJitterBuffer::Add()
+**
+**	take a copy of a newly-arrived frame, and schedule it
+*/
+DTSError
+CJitterBuffer::Add( const CCLFrame * frame, int lostFrames, double arrival )
+{
+	if ( not mSlots )
+		{
+		mSlots = NEW_TAG("JitterBuffer") SSlot[ kMaxDepth ];
+		if ( not mSlots )
+			return memFullErr;
+		}
+	
+	// make room, if we must
+	if ( kMaxDepth == mCount )
+		{
+		DropOldest();
+		++mStats.mOverflows;
+		}
+	
+	SSlot * last = mCount > 0 ? &Slot( mCount - 1 ) : nullptr;
+	SSlot& slot = Slot( mCount );
+	
+	slot.mFrame		= *frame;
+	slot.mArrival	= arrival;
+	slot.mPlayout	= arrival;
+	slot.mLost		= lostFrames > 0 ? lostFrames : 0;
+	slot.mScrollH	= 0;
+	slot.mScrollV	= 0;
+	
+	if ( slot.mLost )
+		mRecentLoss = kLossMemory;
+	else
+	if ( mRecentLoss > 0 )
+		--mRecentLoss;
+	
+	if ( last )
+		{
+		EstimateScroll( &last->mFrame, frame, &slot.mScrollH, &slot.mScrollV );
+		
+		// how far apart are the frames getting here, and how steadily?
+		int gap = frame->mAckFrame - last->mFrame.mAckFrame;
+		if ( gap < 1 )
+			gap = 1;
+		double elapsed = arrival - last->mArrival;
+		double interval = elapsed / gap;
+		if ( interval > 0 && interval < kMaxFrameInterval )
+			{
+			if ( 0 == mStats.mInterval )
+				mStats.mInterval = interval;
+			else
+				mStats.mInterval += ( interval - mStats.mInterval ) / 8;
+			
+			mStats.mJitter += ( fabs( elapsed - gap * mStats.mInterval ) - mStats.mJitter ) / 8;
+			}
+		
+		// schedule it one interval (or more, for lost frames) after the last one,
+		// nudged toward when it actually arrived so the clocks can't drift apart
+		double playout = last->mPlayout + gap * mStats.mInterval;
+		playout += ( arrival - playout ) / 16;
+		if ( fabs( arrival - playout ) < kResyncThreshold )
+			slot.mPlayout = playout;
+		
+		// it's late if it should have been on its way to the screen already
+		if ( arrival - mStats.mDelay > slot.mPlayout )
+			++mStats.mLate;
+		}
+	
+	// enough delay to interpolate across one interval plus the usual jitter,
+	// within the budget; ease into it, so the picture doesn't jump
+	double target = mStats.mInterval + 2 * mStats.mJitter;
+	double budget = mLatency / 1000.0;
+	if ( target > budget )
+		target = budget;
+	mStats.mDelay += ( target - mStats.mDelay ) / 8;
+	
+	++mCount;
+	++mStats.mFrames;
+	
+	return noErr;
+}
+
+
+/*
+**	CJitterBuffer::Present()
+**
+**	decide what to draw at this moment. Returns false if there's nothing yet.
+*/
+bool
+CJitterBuffer::Present( double now, SPresent * oPresent )
+{
+	if ( 0 == mCount )
+		return false;
+	
+	double render = now - mStats.mDelay;
+	bool bNewFrame = false;
+	
+	// the very first frame goes straight up
+	if ( mShown < 0 )
+		{
+		mShown = 0;
+		bNewFrame = true;
+		}
+	
+	// move on to the newest frame that's due
+	while ( mShown + 1 < mCount
+	&&      Slot( mShown + 1 ).mPlayout <= render )
+		{
+		if ( bNewFrame )
+			++mStats.mSkipped;
+		++mShown;
+		bNewFrame = true;
+		}
+	
+	// keep one frame behind the current one, for extrapolating
+	while ( mShown > 1 )
+		DropOldest();
+	
+	const SSlot& cur = Slot( mShown );
+	const SSlot * prev = mShown > 0 ? &Slot( mShown - 1 ) : nullptr;
+	
+	oPresent->mFrame	= &cur.mFrame;
+	oPresent->mTarget	= nullptr;
+	oPresent->mPrev		= prev ? &prev->mFrame : nullptr;
+	oPresent->mAlpha	= 0;
+	oPresent->mNewFrame	= bNewFrame;
+	
+	float scrollH = 0;
+	float scrollV = 0;
+	
+	if ( mShown + 1 < mCount )
+		{
+		// partway to the next one
+		const SSlot& next = Slot( mShown + 1 );
+		double span = next.mPlayout - cur.mPlayout;
+		float alpha = span > 0 ? float( ( render - cur.mPlayout ) / span ) : 0;
+		if ( alpha < 0 )
+			alpha = 0;
+		else
+		if ( alpha > 1 )
+			alpha = 1;
+		
+		oPresent->mTarget	= &next.mFrame;
+		oPresent->mAlpha	= alpha;
+		scrollH = alpha * next.mScrollH;
+		scrollV = alpha * next.mScrollV;
+		mExtrapolating = false;
+		}
+	else
+	if ( prev )
+		{
+		// we've run dry. Keep going the way we were, for a bit; further if frames
+		// are being lost, because then the next one isn't merely late
+		double span = cur.mPlayout - prev->mPlayout;
+		float alpha = span > 0 ? float( ( render - cur.mPlayout ) / span ) : 0;
+		float limit = ( cur.mLost || mRecentLoss ) ? kExtrapolateLossy : kExtrapolateLimit;
+		if ( alpha < 0 )
+			alpha = 0;
+		else
+		if ( alpha > limit )
+			alpha = limit;
+		
+		if ( alpha > 0 && not mExtrapolating )
+			{
+			mExtrapolating = true;
+			++mStats.mExtrapolations;
+			}
+		
+		oPresent->mAlpha = alpha;
+		scrollH = alpha * cur.mScrollH;
+		scrollV = alpha * cur.mScrollV;
+		}
+	
+	oPresent->mScrollH = static_cast<int>( floorf( scrollH + 0.5F ) );
+	oPresent->mScrollV = static_cast<int>( floorf( scrollV + 0.5F ) );
+	
+	mStats.mDepth = mCount - mShown - 1;
+	if ( mStats.mDepth > mStats.mPeakDepth )
+		mStats.mPeakDepth = mStats.mDepth;
+	
+	return true;
+}
+
+
+/*
+**	CJitterBuffer::GetStats()
+*/
+void
+CJitterBuffer::GetStats( SStats * oStats ) const
+{
+	*oStats = mStats;
+}
+
+
+/*
+**	CJitterBuffer::DropOldest()
+*/
+void
+CJitterBuffer::DropOldest()
+{
+	if ( 0 == mCount )
+		return;
+	
+	mHead = ( mHead + 1 ) % kMaxDepth;
+	--mCount;
+	
+	// if that was the one on screen, the next Present() shows its successor
+	if ( mShown >= 0 )
+		--mShown;
+}
+
+
+/*
+**	CJitterBuffer::EstimateScroll()
+**
+**	The server doesn't tell us where we are, only where everything is relative to us,
+**	so when we walk the whole field shifts. Work out by how much, by matching up
+**	pictures with the same ID in the two frames and seeing which displacement most
+**	of them agree on. Tiled terrain matches many ways, so each picture's vote is split
+**	among all its candidates; one-of-a-kind pictures decide it.
+**	Returns false (and 0, 0) if there's no consensus.
+*/
+bool
+CJitterBuffer::EstimateScroll( const CCLFrame * from, const CCLFrame * to,
+	int * oHorz, int * oVert )
+{
+	*oHorz = 0;
+	*oVert = 0;
+	
+	int numFrom = from->mNumPict + from->mNumPictAgain;
+	int numTo   = to->mNumPict   + to->mNumPictAgain;
+	if ( 0 == numFrom || 0 == numTo )
+		return false;
+	
+	// the older frame's pictures, by ID then position
+	CCLFrame::SFramePict sorted[ CCLFrame::max_Picture ];
+	memcpy( sorted, from->mPict, numFrom * sizeof sorted[0] );
+	qsort( sorted, numFrom, sizeof sorted[0], ComparePictures );
+	
+	ScrollVote votes[ kMaxScrollSamples * kMaxScrollCandidates ];
+	int numVotes = 0;
+	float voters = 0;
+	
+	int stride = numTo / kMaxScrollSamples + 1;
+	for ( int i = 0;  i < numTo;  i += stride )
+		{
+		const CCLFrame::SFramePict& pict = to->mPict[ i ];
+		
+		// first older picture with this ID that's near enough
+		CCLFrame::SFramePict key = pict;
+		key.mV -= kMaxScroll;
+		key.mH = SHRT_MIN;
+		int lo = 0;
+		int hi = numFrom;
+		while ( lo < hi )
+			{
+			int mid = ( lo + hi ) / 2;
+			if ( ComparePictures( &sorted[ mid ], &key ) < 0 )
+				lo = mid + 1;
+			else
+				hi = mid;
+			}
+		
+		int first = numVotes;
+		for ( ;  lo < numFrom;  ++lo )
+			{
+			const CCLFrame::SFramePict& old = sorted[ lo ];
+			if ( old.mPictID != pict.mPictID
+			||   old.mV > pict.mV + kMaxScroll )
+				{
+				break;
+				}
+			
+			int dh = pict.mH - old.mH;
+			int dv = pict.mV - old.mV;
+			if ( dh < -kMaxScroll || dh > kMaxScroll )
+				continue;
+			
+			votes[ numVotes ].svKey = ( uint32_t( dh + 0x8000 ) << 16 ) | uint32_t( dv + 0x8000 );
+			if ( ++numVotes - first == kMaxScrollCandidates )
+				break;
+			}
+		
+		// split this picture's vote among its candidates
+		if ( int numCandidates = numVotes - first )
+			{
+			for ( int n = first;  n < numVotes;  ++n )
+				votes[ n ].svWeight = 1.0F / numCandidates;
+			voters += 1;
+			}
+		}
+	
+	// tally up
+	qsort( votes, numVotes, sizeof votes[0], CompareVotes );
+	uint32_t bestKey = 0;
+	float bestWeight = 0;
+	for ( int i = 0;  i < numVotes; )
+		{
+		uint32_t key = votes[ i ].svKey;
+		float weight = 0;
+		for ( ;  i < numVotes && votes[ i ].svKey == key;  ++i )
+			weight += votes[ i ].svWeight;
+		if ( weight > bestWeight )
+			{
+			bestWeight = weight;
+			bestKey = key;
+			}
+		}
+	
+	// no telling, unless a fair few of them agree
+	if ( bestWeight < 2 || bestWeight * 4 < voters )
+		return false;
+	
+	*oHorz = int( ( bestKey >> 16 ) & 0xFFFF ) - 0x8000;
+	*oVert = int( bestKey & 0xFFFF ) - 0x8000;
+	return true;
+}
+
+
+/*
+**	ComparePictures()
+**
+**	qsort() helper: order frame pictures by ID, then top to bottom, then left to right
+*/
+int
+ComparePictures( const void * a, const void * b )
+{
+	const CCLFrame::SFramePict * pa = static_cast<const CCLFrame::SFramePict *>( a );
+	const CCLFrame::SFramePict * pb = static_cast<const CCLFrame::SFramePict *>( b );
+	
+	if ( pa->mPictID != pb->mPictID )
+		return pa->mPictID < pb->mPictID ? -1 : 1;
+	if ( pa->mV != pb->mV )
+		return pa->mV < pb->mV ? -1 : 1;
+	if ( pa->mH != pb->mH )
+		return pa->mH < pb->mH ? -1 : 1;
+	return 0;
+}
+
+
+/*
+**	CompareVotes()
+**
+**	qsort() helper
+*/
+int
+CompareVotes( const void * a, const void * b )
+{
+	uint32_t ka = static_cast<const ScrollVote *>( a )->svKey;
+	uint32_t kb = static_cast<const ScrollVote *>( b )->svKey;
+	
+	return ka < kb ? -1 : ka > kb ? 1 : 0;
+}
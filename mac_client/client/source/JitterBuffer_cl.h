@@ -0,0 +1,124 @@
+/*
+**	JitterBuffer_cl.h		ClanLord
+** 
+**	Copyright 2023 Delta Tao Software, Inc.
+** 
+**	Licensed under the Apache License, Version 2.0 (the "License");
+**	you may not use this file except in compliance with the License.
+**	You may obtain a copy of the License at
+** 
+**     https://www.apache.org/licenses/LICENSE-2.0
+** 
+**	Unless required by applicable law or agreed to in writing, software
+**	distributed under the License is distributed on an "AS IS" BASIS,
+**	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+**	See the License for the specific language governing permissions and
+**	imitations under the License.
+*/
+
+#ifndef JITTERBUFFER_CL_H
+#define JITTERBUFFER_CL_H
+
+#include "Frame_cl.h"
+
+//
+// The "smooth motion" presentation mode.
+//
+// Drawstates arrive a few times a second, and not evenly. Rather than drawing each
+// one the moment it lands, we hold copies of the last few frames and play them out
+// on a steadier clock, a little behind real time: the playout delay. In between two
+// frames the field is drawn partway from one to the other, so mobiles glide instead
+// of hopping, and the field scrolls instead of jumping. If the next frame is overdue,
+// we carry on in the same direction for a short while (further if frames are known
+// to be getting lost) and then hold still.
+//
+// The delay adapts to the measured frame interval and jitter, but never exceeds the
+// latency budget. Only the drawing is delayed; text, sounds, and inventory are still
+// handled as soon as each frame arrives.
+//
+class CJitterBuffer
+{
+public:
+	enum
+		{
+		kMaxDepth			= 8,		// frames held, counting the one on screen
+		kDefaultLatency		= 150,		// budget, in milliseconds
+		kMaxLatency			= 1000,
+		kMaxScroll			= 96		// biggest believable move between frames, pixels
+		};
+	
+	// how to draw the field right now
+	struct SPresent
+		{
+		const CCLFrame *	mFrame;			// the frame on screen
+		const CCLFrame *	mTarget;		// the one we're moving toward; or nullptr
+		const CCLFrame *	mPrev;			// the one before mFrame; or nullptr
+		float				mAlpha;			// how far toward mTarget (or past mFrame, if none)
+		int					mScrollH;		// how far the field has moved since mFrame
+		int					mScrollV;
+		bool				mNewFrame;		// mFrame wasn't on screen last time
+		};
+	
+	// telemetry
+	struct SStats
+		{
+		int					mDepth;			// frames waiting behind the one on screen
+		int					mPeakDepth;
+		ulong				mFrames;		// frames added
+		ulong				mLate;			// arrived after they were due on screen
+		ulong				mSkipped;		// never shown, because a later one was also due
+		ulong				mOverflows;		// pushed out because the buffer was full
+		ulong				mExtrapolations;	// times we ran out of frames
+		double				mDelay;			// current playout delay, seconds
+		double				mInterval;		// smoothed time between frames
+		double				mJitter;		// smoothed deviation from that
+		};
+	
+	// constructor/destructor
+						CJitterBuffer();
+						~CJitterBuffer();
+	
+	// interface
+	void				Reset();
+	void				SetLatency( int ms );
+	DTSError			Add( const CCLFrame * frame, int lostFrames, double arrival );
+	bool				Present( double now, SPresent * oPresent );
+	void				GetStats( SStats * oStats ) const;
+	
+	static bool			EstimateScroll( const CCLFrame * from, const CCLFrame * to,
+							int * oHorz, int * oVert );
+
+private:
+	struct SSlot
+		{
+		CCLFrame			mFrame;
+		double				mArrival;		// when it got here
+		double				mPlayout;		// when it's due, before the playout delay
+		int					mLost;			// frames lost just before this one
+		int					mScrollH;		// field movement since the previous frame
+		int					mScrollV;
+		};
+	
+	SSlot *				mSlots;			// kMaxDepth of them, allocated on first use
+	int					mHead;			// oldest slot
+	int					mCount;			// slots in use
+	int					mShown;			// which one's on screen, counting from mHead; or -1
+	int					mLatency;		// the budget, in milliseconds
+	int					mRecentLoss;	// frames to go before we stop expecting losses
+	bool				mExtrapolating;
+	SStats				mStats;
+	
+	SSlot&				Slot( int n )			{ return mSlots[ (mHead + n) % kMaxDepth ]; }
+	const SSlot&		Slot( int n ) const		{ return mSlots[ (mHead + n) % kMaxDepth ]; }
+	void				DropOldest();
+	
+	// declared but not defined
+						CJitterBuffer( const CJitterBuffer& );
+	CJitterBuffer&		operator=( const CJitterBuffer& );
+};
+
+
+// There's only one!
+extern CJitterBuffer	gJitterBuffer;		// from GameWin_cl.cp
+
+#endif  // JITTERBUFFER_CL_H
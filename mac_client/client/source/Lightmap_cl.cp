@@ -0,0 +1,912 @@
+/*
+**	Lightmap_cl.cp		Clanlord Client
+** 
+**	Copyright 2023 Delta Tao Software, Inc.
+** 
+**	Licensed under the Apache License, Version 2.0 (the "License");
+**	you may not use this file except in compliance with the License.
+**	You may obtain a copy of the License at
+** 
+**     https://www.apache.org/licenses/LICENSE-2.0
+** 
+**	Unless required by applicable law or agreed to in writing, software
+**	distributed under the License is distributed on an "AS IS" BASIS,
+**	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+**	See the License for the specific language governing permissions and
+**	imitations under the License.
+*/
+
+/*
+**	the software ("quickdraw") night lightmap.
+**
+**	the old code painted the ambient light, then each light- and darkcaster,
+**	then the night clamp, each as its own pass over the whole 32-bit GWorld.
+**	with a dozen torches on screen that was a dozen-plus trips through a
+**	megabyte of memory, one scalar pixel at a time.
+**
+**	now the casters are only queued as fillNightTextureObject() finds them,
+**	and qdFinishLightmap() composites the lightmap in small tiles: each tile
+**	gets its ambient light, every caster that touches it (in the original
+**	plane/dark/light order, so saturation comes out the same), and the clamp,
+**	while it is still in the cache. the tiles are grouped into horizontal
+**	bands that are handed to worker threads, and the per-pixel arithmetic
+**	runs four pixels at a time with SSE2 or NEON where we have them.
+**	CompositeSpanScalar() is the reference the vector versions must match.
+*/
+
+#include "ClanLord.h"
+#include "OpenGL_cl.h"
+
+#include <dispatch/dispatch.h>
+
+#if defined( __SSE2__ )
+# include <emmintrin.h>
+# define LIGHTMAP_SSE2		1
+#elif defined( __ARM_NEON__ ) || defined( __ARM_NEON )
+# include <arm_neon.h>
+# define LIGHTMAP_NEON		1
+#endif
+
+
+#ifdef USE_OPENGL
+
+// borrowed from GameWin_cl.cp
+extern	Layout			gLayout;
+extern	DTSPoint		gFieldCenter;
+
+
+/*
+**	Definitions
+*/
+const int kLightmapBandRows		= 32;	// rows per band; each band is one worker task
+const int kLightmapTileCols		= 64;	// 64 pixels * 32 rows * 4 bytes = 8K; stays in L1
+const int kStarlightCircleSize	= 326;	// radius of the starlight circle, in pixels
+
+
+/*
+**	Internal Classes
+*/
+
+// one queued light- or darkcaster
+struct SLightCaster
+{
+	int				lcCenterH;
+	int				lcCenterV;
+	int				lcTop;				// bounding box, clipped to the field
+	int				lcLeft;
+	int				lcBottom;
+	int				lcRight;
+	const uchar *	lcIndex;			// distance -> circle table index, for this radius
+	ushort			lcColor[ 4 ];		// blue, green, red, 0: the byte order of
+										// a 0x00RRGGBB pixel on a little-endian CPU
+	bool			lcLight;			// false for darkcasters
+};
+
+
+class CLightmapEngine
+{
+public:
+	// constructor/destructor
+					CLightmapEngine();
+					~CLightmapEngine();
+	
+	// interface
+	void			Begin( const RGBColor& moonlight, const RGBColor& starlight );
+	void			AddCaster( const Point& center, int radius, int minimumRadius,
+						const RGBColor& colorus, bool lightdarkcaster );
+	void			SetClamp( float level );
+	void			Composite( uchar * baseAddr, int rowBytes );
+
+private:
+	SLightCaster *	mCasters;
+	int				mNumCasters;
+	int				mMaxCasters;
+	
+	ushort			mMoonlight[ 4 ];	// same layout as lcColor
+	ushort			mStarlight[ 4 ];
+	uint32_t		mMoonPixel;
+	uint32_t		mClampPixel;		// 0 if no clamp this frame
+	
+	int				mTop;				// the field, and its center
+	int				mLeft;
+	int				mBottom;
+	int				mRight;
+	int				mCenterH;
+	int				mCenterV;
+	int *			mStarDistH;			// distance from the starlight center, per column
+	int				mStarDistCols;
+	
+	uchar *			mBaseAddr;			// only valid during Composite()
+	int				mRowBytes;
+	
+	void			Grow();
+	void			CompositeBand( int band ) const;
+	void			CompositeTile( int top, int bottom, int left, int right ) const;
+	
+	static void		CompositeBandProc( void * context, size_t band );
+	
+	// declared but not defined
+					CLightmapEngine( const CLightmapEngine& );
+	CLightmapEngine&	operator=( const CLightmapEngine& );
+};
+
+
+/*
+**	Internal Variables
+*/
+static CLightmapEngine	gLightmap;
+
+// light intensity by distance, scaled to kLightmapMaximumRadius (casters)
+// or to kStarlightCircleSize (starlight); [y][x]
+static uchar	gCasterCircle[ kLightmapScaleCircleArraySize ][ kLightmapScaleCircleArraySize ];
+static uchar	gStarlightCircle[ kStarlightCircleSize ][ kStarlightCircleSize ];
+static bool		gCirclesBuilt;
+
+// distance -> gCasterCircle index, one row per radius, built as needed
+static uchar	gCasterIndex[ kLightmapScaleCircleArraySize ][ kLightmapScaleCircleArraySize ];
+static bool		gCasterIndexBuilt[ kLightmapScaleCircleArraySize ];
+
+
+/*
+**	Internal Routines
+*/
+static void		BuildCircles();
+static const uchar *	GetCasterIndex( int radius );
+static void		CompositeSpan( uint32_t * pixels, const uint32_t * scales, int count,
+					const ushort color[ 4 ], bool add );
+static void		CompositeSpanScalar( uint32_t * pixels, const uint32_t * scales, int count,
+					const ushort color[ 4 ], bool add );
+static void		ClampSpan( uint32_t * pixels, int count, uint32_t clamp );
+
+
+/*
+**	BuildCircles()
+**
+**	fill in the intensity tables
+**	called on the main thread, before any band is handed out
+*/
+void
+BuildCircles()
+{
+	if ( gCirclesBuilt )
+		return;
+	
+	for ( int x = 0; x < kLightmapScaleCircleArraySize; ++x )
+		{
+		float xPixelCenter = x + 0.5f;
+		for ( int y = 0; y < kLightmapScaleCircleArraySize; ++y )
+			{
+			float yPixelCenter = y + 0.5f;
+			float dist = hypotf( xPixelCenter, yPixelCenter );
+			if ( dist > kLightmapMaximumRadius )
+				gCasterCircle[y][x] = 0;
+			else
+				gCasterCircle[y][x] = 0xFF *
+					( kLightmapMaximumRadius - dist ) / kLightmapMaximumRadius;
+			}
+		}
+	
+	for ( int x = 0; x < kStarlightCircleSize; ++x )
+		{
+		for ( int y = 0; y < kStarlightCircleSize; ++y )
+			{
+			float xPixelCenter = x + 0.5f;
+			float yPixelCenter = y + 0.5f;
+			float dist = hypotf( xPixelCenter, yPixelCenter );
+			if ( dist > kStarlightCircleSize )
+				gStarlightCircle[y][x] = 0;
+			else
+				gStarlightCircle[y][x] = 0xff
+					* ( kStarlightCircleSize - dist ) / kStarlightCircleSize;
+			}
+		}
+	
+	gCirclesBuilt = true;
+}
+
+
+/*
+**	GetCasterIndex()
+**
+**	return the distance -> gCasterCircle index map for this radius
+**	also only called on the main thread
+*/
+const uchar *
+GetCasterIndex( int radius )
+{
+	uchar * index = gCasterIndex[ radius ];
+	if ( not gCasterIndexBuilt[ radius ] )
+		{
+		for ( int i = 0; i < radius; ++i )
+			index[i] = kLightmapMaximumRadius * i / radius;
+		
+		for ( int i = radius; i < kLightmapScaleCircleArraySize; ++i )
+			index[i] = kLightmapMaximumRadius;
+		
+		gCasterIndexBuilt[ radius ] = true;
+		}
+	
+	return index;
+}
+
+
+/*
+**	CompositeSpanScalar()
+**
+**	add (or subtract) color * scale to each pixel, saturating each channel.
+**	scales[] holds the 0..255 intensity in every byte of each word, so
+**	the vector versions can use it as is; we only need the low byte.
+**	this is the reference implementation.
+*/
+void
+CompositeSpanScalar( uint32_t * pixels, const uint32_t * scales, int count,
+	const ushort color[ 4 ], bool add )
+{
+	for ( int i = 0; i < count; ++i )
+		{
+		uint scale = scales[i] & 0xFF;
+		if ( not scale )
+			continue;
+		
+		int red   = ( color[2] * scale ) >> 16;
+		int green = ( color[1] * scale ) >> 16;
+		int blue  = ( color[0] * scale ) >> 16;
+		
+		uint32_t pixel = pixels[i];
+		int oldRed   = ( pixel >> 16 ) & 0xFF;
+		int oldGreen = ( pixel >>  8 ) & 0xFF;
+		int oldBlue  =   pixel         & 0xFF;
+		
+		if ( add )
+			{
+			red   += oldRed;
+			green += oldGreen;
+			blue  += oldBlue;
+			if ( red > 0xFF )
+				red = 0xFF;
+			if ( green > 0xFF )
+				green = 0xFF;
+			if ( blue > 0xFF )
+				blue = 0xFF;
+			}
+		else
+			{
+			red   = oldRed - red;
+			green = oldGreen - green;
+			blue  = oldBlue - blue;
+			if ( red < 0 )
+				red = 0;
+			if ( green < 0 )
+				green = 0;
+			if ( blue < 0 )
+				blue = 0;
+			}
+		
+		pixels[i] = ( pixel & 0xFF000000 ) | ( red << 16 ) | ( green << 8 ) | blue;
+		}
+}
+
+
+/*
+**	CompositeSpan()
+**
+**	vector version of CompositeSpanScalar(), four pixels at a time.
+**	(color * scale) >> 16 is exactly a 16-bit multiply-high, so the
+**	results are bit-for-bit the same as the scalar code's.
+*/
+void
+CompositeSpan( uint32_t * pixels, const uint32_t * scales, int count,
+	const ushort color[ 4 ], bool add )
+{
+	int i = 0;
+	
+#if LIGHTMAP_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	__m128i color16 = _mm_loadl_epi64( reinterpret_cast<const __m128i *>( color ) );
+	color16 = _mm_unpacklo_epi64( color16, color16 );
+	
+	for ( ; i + 4 <= count; i += 4 )
+		{
+		__m128i scale = _mm_loadu_si128( reinterpret_cast<const __m128i *>( scales + i ) );
+		__m128i lo = _mm_mulhi_epu16( _mm_unpacklo_epi8( scale, zero ), color16 );
+		__m128i hi = _mm_mulhi_epu16( _mm_unpackhi_epi8( scale, zero ), color16 );
+		__m128i delta = _mm_packus_epi16( lo, hi );
+		
+		__m128i * p = reinterpret_cast<__m128i *>( pixels + i );
+		__m128i pixel = _mm_loadu_si128( p );
+		if ( add )
+			pixel = _mm_adds_epu8( pixel, delta );
+		else
+			pixel = _mm_subs_epu8( pixel, delta );
+		_mm_storeu_si128( p, pixel );
+		}
+#elif LIGHTMAP_NEON
+	const uint16x4_t color16 = vld1_u16( color );
+	
+	for ( ; i + 4 <= count; i += 4 )
+		{
+		uint8x16_t scale = vld1q_u8( reinterpret_cast<const uint8_t *>( scales + i ) );
+		uint16x8_t slo = vmovl_u8( vget_low_u8( scale ) );
+		uint16x8_t shi = vmovl_u8( vget_high_u8( scale ) );
+		
+		uint16x8_t lo = vcombine_u16(
+			vshrn_n_u32( vmull_u16( vget_low_u16( slo ), color16 ), 16 ),
+			vshrn_n_u32( vmull_u16( vget_high_u16( slo ), color16 ), 16 ) );
+		uint16x8_t hi = vcombine_u16(
+			vshrn_n_u32( vmull_u16( vget_low_u16( shi ), color16 ), 16 ),
+			vshrn_n_u32( vmull_u16( vget_high_u16( shi ), color16 ), 16 ) );
+		uint8x16_t delta = vcombine_u8( vqmovn_u16( lo ), vqmovn_u16( hi ) );
+		
+		uint8_t * p = reinterpret_cast<uint8_t *>( pixels + i );
+		uint8x16_t pixel = vld1q_u8( p );
+		if ( add )
+			pixel = vqaddq_u8( pixel, delta );
+		else
+			pixel = vqsubq_u8( pixel, delta );
+		vst1q_u8( p, pixel );
+		}
+#endif	// LIGHTMAP_SSE2
+	
+	if ( i < count )
+		CompositeSpanScalar( pixels + i, scales + i, count - i, color, add );
+}
+
+
+/*
+**	ClampSpan()
+**
+**	raise each channel to at least the clamp level (the night limit)
+*/
+void
+ClampSpan( uint32_t * pixels, int count, uint32_t clamp )
+{
+	int i = 0;
+	
+#if LIGHTMAP_SSE2
+	const __m128i clamp8 = _mm_set1_epi32( clamp );
+	for ( ; i + 4 <= count; i += 4 )
+		{
+		__m128i * p = reinterpret_cast<__m128i *>( pixels + i );
+		_mm_storeu_si128( p, _mm_max_epu8( _mm_loadu_si128( p ), clamp8 ) );
+		}
+#elif LIGHTMAP_NEON
+	const uint8x16_t clamp8 = vreinterpretq_u8_u32( vdupq_n_u32( clamp ) );
+	for ( ; i + 4 <= count; i += 4 )
+		{
+		uint8_t * p = reinterpret_cast<uint8_t *>( pixels + i );
+		vst1q_u8( p, vmaxq_u8( vld1q_u8( p ), clamp8 ) );
+		}
+#endif	// LIGHTMAP_SSE2
+	
+	const uint32_t clampRed   = clamp & 0x00FF0000;
+	const uint32_t clampGreen = clamp & 0x0000FF00;
+	const uint32_t clampBlue  = clamp & 0x000000FF;
+	for ( ; i < count; ++i )
+		{
+		uint32_t pixel = pixels[i];
+		uint32_t red   = pixel & 0x00FF0000;
+		uint32_t green = pixel & 0x0000FF00;
+		uint32_t blue  = pixel & 0x000000FF;
+		if ( red < clampRed )
+			red = clampRed;
+		if ( green < clampGreen )
+			green = clampGreen;
+		if ( blue < clampBlue )
+			blue = clampBlue;
+		pixels[i] = ( pixel & 0xFF000000 ) | red | green | blue;
+		}
+}
+
+
+/*
+**	CLightmapEngine::CLightmapEngine()
+*/
+CLightmapEngine::CLightmapEngine() :
+	mCasters( nullptr ),
+	mNumCasters( 0 ),
+	mMaxCasters( 0 ),
+	mMoonPixel( 0 ),
+	mClampPixel( 0 ),
+	mTop( 0 ),
+	mLeft( 0 ),
+	mBottom( 0 ),
+	mRight( 0 ),
+	mCenterH( 0 ),
+	mCenterV( 0 ),
+	mStarDistH( nullptr ),
+	mStarDistCols( 0 ),
+	mBaseAddr( nullptr ),
+	mRowBytes( 0 )
+{
+	for ( int i = 0; i < 4; ++i )
+		{
+		mMoonlight[i] = 0;
+		mStarlight[i] = 0;
+		}
+}
+
+
+/*
+**	CLightmapEngine::~CLightmapEngine()
+*/
+CLightmapEngine::~CLightmapEngine()
+{
+	delete[] mCasters;
+	delete[] mStarDistH;
+}
+
+
+/*
+**	CLightmapEngine::Grow()
+**
+**	make room for more casters
+*/
+void
+CLightmapEngine::Grow()
+{
+	int newMax = mMaxCasters ? 2 * mMaxCasters : 32;
+	if ( newMax < gNumLightCasters + gNumDarkCasters )
+		newMax = gNumLightCasters + gNumDarkCasters;
+	
+	SLightCaster * casters = NEW_TAG("SLightCaster") SLightCaster[ newMax ];
+	CheckPointer( casters );
+	if ( not casters )
+		return;
+	
+	for ( int i = 0; i < mNumCasters; ++i )
+		casters[i] = mCasters[i];
+	
+	delete[] mCasters;
+	mCasters = casters;
+	mMaxCasters = newMax;
+}
+
+
+/*
+**	CLightmapEngine::Begin()
+**
+**	start a new frame: forget the old casters, and remember the ambient light
+**	(moonlight everywhere, plus a circle of starlight centered on the field)
+*/
+void
+CLightmapEngine::Begin( const RGBColor& moonlight, const RGBColor& starlight )
+{
+	BuildCircles();
+	
+	mNumCasters = 0;
+	mClampPixel = 0;
+	
+	// countLightDarkCasters() has already told us how many to expect
+	if ( mMaxCasters < gNumLightCasters + gNumDarkCasters )
+		Grow();
+	
+	// only the high byte of each component survives into the GWorld
+	mMoonlight[0] = moonlight.blue & 0xFF00;
+	mMoonlight[1] = moonlight.green & 0xFF00;
+	mMoonlight[2] = moonlight.red & 0xFF00;
+	mMoonlight[3] = 0;
+	mMoonPixel = ( mMoonlight[2] << 8 ) | mMoonlight[1] | ( mMoonlight[0] >> 8 );
+	
+	mStarlight[0] = starlight.blue;
+	mStarlight[1] = starlight.green;
+	mStarlight[2] = starlight.red;
+	mStarlight[3] = 0;
+	
+	mTop	= gLayout.layoFieldBox.rectTop;
+	mLeft	= gLayout.layoFieldBox.rectLeft;
+	mBottom	= gLayout.layoFieldBox.rectBottom;
+	mRight	= gLayout.layoFieldBox.rectRight;
+	mCenterH = gFieldCenter.ptH;
+	mCenterV = gFieldCenter.ptV;
+	
+	// the starlight circle is mirrored about the center of the field,
+	// so precompute each column's distance from it
+	int cols = mRight - mLeft;
+	if ( cols > mStarDistCols )
+		{
+		delete[] mStarDistH;
+		mStarDistH = NEW_TAG("LightmapStarDist") int[ cols ];
+		CheckPointer( mStarDistH );
+		mStarDistCols = mStarDistH ? cols : 0;
+		}
+	for ( int i = 0; i < mStarDistCols && i < cols; ++i )
+		{
+		int h = mLeft + i;
+		int dh = h >= mCenterH ? h - mCenterH : mLeft + mRight - 1 - h - mCenterH;
+		mStarDistH[i] = dh < 0 ? -dh : dh;
+		}
+}
+
+
+/*
+**	CLightmapEngine::AddCaster()
+**
+**	queue a light- or darkcaster
+*/
+void
+CLightmapEngine::AddCaster( const Point& center, int radius, int minimumRadius,
+	const RGBColor& colorus, bool lightdarkcaster )
+{
+	// if the radius is too big for the array, clamp it
+	// (this is now redundant with the mainline code)
+	if ( radius > gLightmapRadiusLimit )
+		radius = gLightmapRadiusLimit;
+	if ( radius < minimumRadius )
+		radius = minimumRadius;
+	if ( radius > kLightmapMaximumRadius )
+		radius = kLightmapMaximumRadius;
+	if ( radius <= 0 )
+		return;
+	
+	int top = center.v - radius < mTop ? mTop : center.v - radius;
+	int bottom = center.v + radius > mBottom ? mBottom : center.v + radius;
+	int left = center.h - radius < mLeft ? mLeft : center.h - radius;
+	int right = center.h + radius > mRight ? mRight : center.h + radius;
+	if ( top >= bottom || left >= right )
+		return;
+	
+	if ( mNumCasters >= mMaxCasters )
+		{
+		Grow();
+		if ( mNumCasters >= mMaxCasters )
+			return;
+		}
+	
+	SLightCaster * caster = &mCasters[ mNumCasters++ ];
+	caster->lcCenterH	= center.h;
+	caster->lcCenterV	= center.v;
+	caster->lcTop		= top;
+	caster->lcLeft		= left;
+	caster->lcBottom	= bottom;
+	caster->lcRight		= right;
+	caster->lcIndex		= GetCasterIndex( radius );
+	caster->lcColor[0]	= colorus.blue;
+	caster->lcColor[1]	= colorus.green;
+	caster->lcColor[2]	= colorus.red;
+	caster->lcColor[3]	= 0;
+	caster->lcLight		= lightdarkcaster;
+}
+
+
+/*
+**	CLightmapEngine::SetClamp()
+**
+**	no channel of the finished lightmap may be darker than this
+*/
+void
+CLightmapEngine::SetClamp( float level )
+{
+	uint32_t clamp = level * 0xFF;
+	mClampPixel = ( clamp << 16 ) | ( clamp << 8 ) | clamp;
+}
+
+
+/*
+**	CLightmapEngine::Composite()
+**
+**	render the queued frame into the lightmap, one band per worker
+*/
+void
+CLightmapEngine::Composite( uchar * baseAddr, int rowBytes )
+{
+	if ( mBottom <= mTop || mRight <= mLeft || mStarDistCols < mRight - mLeft )
+		return;
+	
+	mBaseAddr = baseAddr;
+	mRowBytes = rowBytes;
+	
+	int bands = ( mBottom - mTop + kLightmapBandRows - 1 ) / kLightmapBandRows;
+	dispatch_apply_f( bands,
+		dispatch_get_global_queue( DISPATCH_QUEUE_PRIORITY_HIGH, 0 ),
+		this, CompositeBandProc );
+	
+	mBaseAddr = nullptr;
+}
+
+
+/*
+**	CLightmapEngine::CompositeBandProc()		[static]
+**
+**	dispatch_apply_f() callback
+*/
+void
+CLightmapEngine::CompositeBandProc( void * context, size_t band )
+{
+	static_cast<const CLightmapEngine *>( context )->CompositeBand( band );
+}
+
+
+/*
+**	CLightmapEngine::CompositeBand()
+**
+**	composite one horizontal band, a tile at a time.
+**	bands never share a row, so they need no locking.
+*/
+void
+CLightmapEngine::CompositeBand( int band ) const
+{
+	int top = mTop + band * kLightmapBandRows;
+	int bottom = top + kLightmapBandRows;
+	if ( bottom > mBottom )
+		bottom = mBottom;
+	
+	for ( int left = mLeft; left < mRight; left += kLightmapTileCols )
+		{
+		int right = left + kLightmapTileCols;
+		if ( right > mRight )
+			right = mRight;
+		CompositeTile( top, bottom, left, right );
+		}
+}
+
+
+/*
+**	CLightmapEngine::CompositeTile()
+**
+**	ambient light, then every caster that reaches this tile, then the clamp
+*/
+void
+CLightmapEngine::CompositeTile( int top, int bottom, int left, int right ) const
+{
+	uint32_t scales[ kLightmapTileCols ];
+	int cols = right - left;
+	
+	// ambient: moonlight, plus starlight fading out from the center
+	for ( int v = top; v < bottom; ++v )
+		{
+		uint32_t * row = reinterpret_cast<uint32_t *>( mBaseAddr + v * mRowBytes ) + left;
+		for ( int i = 0; i < cols; ++i )
+			row[i] = mMoonPixel;
+		
+		int dv = v >= mCenterV ? v - mCenterV : mTop + mBottom - 1 - v - mCenterV;
+		if ( dv < 0 )
+			dv = -dv;
+		if ( dv >= kStarlightCircleSize )
+			continue;
+		
+		const uchar * circle = gStarlightCircle[ dv ];
+		const int * distH = mStarDistH + ( left - mLeft );
+		for ( int i = 0; i < cols; ++i )
+			{
+			int dh = distH[i];
+			scales[i] = dh < kStarlightCircleSize ? circle[ dh ] * 0x01010101U : 0;
+			}
+		CompositeSpan( row, scales, cols, mStarlight, true );
+		}
+	
+	// the casters, in the order they were queued
+	const SLightCaster * caster = mCasters;
+	for ( int n = mNumCasters; n > 0; --n, ++caster )
+		{
+		if ( caster->lcBottom <= top || caster->lcTop >= bottom
+		||   caster->lcRight <= left || caster->lcLeft >= right )
+			{
+			continue;
+			}
+		
+		int spanTop = caster->lcTop > top ? caster->lcTop : top;
+		int spanBottom = caster->lcBottom < bottom ? caster->lcBottom : bottom;
+		int spanLeft = caster->lcLeft > left ? caster->lcLeft : left;
+		int spanRight = caster->lcRight < right ? caster->lcRight : right;
+		int spanCols = spanRight - spanLeft;
+		const uchar * index = caster->lcIndex;
+		
+		for ( int v = spanTop; v < spanBottom; ++v )
+			{
+			int dv = caster->lcCenterV > v ? caster->lcCenterV - v : v - caster->lcCenterV;
+			const uchar * circle = gCasterCircle[ index[ dv ] ];
+			
+			for ( int i = 0; i < spanCols; ++i )
+				{
+				int h = spanLeft + i;
+				int dh = caster->lcCenterH > h ? caster->lcCenterH - h : h - caster->lcCenterH;
+				scales[i] = circle[ index[ dh ] ] * 0x01010101U;
+				}
+			
+			uint32_t * row = reinterpret_cast<uint32_t *>( mBaseAddr + v * mRowBytes )
+						   + spanLeft;
+			CompositeSpan( row, scales, spanCols, caster->lcColor, caster->lcLight );
+			}
+		}
+	
+	// and the night limit
+	if ( mClampPixel )
+		{
+		for ( int v = top; v < bottom; ++v )
+			{
+			uint32_t * row = reinterpret_cast<uint32_t *>( mBaseAddr + v * mRowBytes )
+						   + left;
+			ClampSpan( row, cols, mClampPixel );
+			}
+		}
+}
+
+
+/*
+**	qdClearLightmap()
+**
+**	start a new lightmap frame
+*/
+void
+qdClearLightmap( const RGBColor& moonlight, const RGBColor& starlight )
+{
+	gLightmap.Begin( moonlight, starlight );
+}
+
+
+/*
+**	qdQueueLightmapCaster()
+**
+**	add a circular light- or darkcaster to the current frame
+*/
+void
+qdQueueLightmapCaster(
+	const Point& center,
+	int radius,
+	int minimumRadius,
+	const RGBColor& colorus,
+	bool lightdarkcaster )
+{
+	gLightmap.AddCaster( center, radius, minimumRadius, colorus, lightdarkcaster );
+}
+
+
+/*
+**	qdClampLightmap()
+**
+**	apply the night limit when the frame is composited
+*/
+void
+qdClampLightmap( float nightCLampColor )
+{
+	gLightmap.SetClamp( nightCLampColor );
+}
+
+
+/*
+**	qdFinishLightmap()
+**
+**	composite the current frame into gLightmapGWorld
+*/
+void
+qdFinishLightmap()
+{
+	PixMapHandle pmh = ::GetGWorldPixMap( gLightmapGWorld );
+	::LockPixels( pmh );
+	uchar * baseAddr = reinterpret_cast<uchar *>( ::GetPixBaseAddr( pmh ) );
+	int rowBytes = ::GetPixRowBytes( pmh ) & 0x3fff;	// carbon + 8.5
+	
+	gLightmap.Composite( baseAddr, rowBytes );
+	
+	::UnlockPixels( pmh );
+}
+
+
+/*
+**	SApplyLightmap
+**
+**	what the qdApplyLightmap() bands need to know
+*/
+struct SApplyLightmap
+{
+	const uchar *	alLightmap;
+	int				alLightmapRowBytes;
+	uchar *			alDest;
+	int				alDestRowBytes;
+	const uchar *	alRGB444ToIndex;
+	int				alTop;
+	int				alBottom;
+	int				alLeft;
+	int				alRight;
+};
+
+
+/*
+**	ApplyLightmapBand()
+**
+**	dispatch_apply_f() callback: shade one band of the 8-bit offscreen buffer.
+**	each pixel is a gather through three color tables and the inverse
+**	color table, which no vector unit we target can help with, so this
+**	stays scalar, but the bands run in parallel.
+*/
+static void
+ApplyLightmapBand( void * context, size_t band )
+{
+	const SApplyLightmap * al = static_cast<const SApplyLightmap *>( context );
+	
+	int top = al->alTop + band * kLightmapBandRows;
+	int bottom = top + kLightmapBandRows;
+	if ( bottom > al->alBottom )
+		bottom = al->alBottom;
+	
+	const GLushort * i2r = gIndexToRedMap;
+	const GLushort * i2g = gIndexToGreenMap;
+	const GLushort * i2b = gIndexToBlueMap;
+	const uchar * rgb444ToIndex = al->alRGB444ToIndex;
+	
+	for ( int v = top; v < bottom; ++v )
+		{
+		const uint32_t * lightmapPtr = reinterpret_cast<const uint32_t *>(
+				al->alLightmap + v * al->alLightmapRowBytes ) + al->alLeft;
+		uchar * destPtr = al->alDest + v * al->alDestRowBytes + al->alLeft;
+		
+		for ( int n = al->alRight - al->alLeft; n > 0; --n )
+			{
+			uint32_t lightmapColor = * lightmapPtr++;
+			uchar destColorIndex = * destPtr;
+			
+			ushort red   = ( ( ( lightmapColor & 0x00ff0000 ) >> 8 )
+							* i2r[ destColorIndex ] ) >> 16;
+			ushort green = (   ( lightmapColor & 0x0000ff00 )
+							* i2g[ destColorIndex ] ) >> 16;
+			ushort blue  = ( ( ( lightmapColor & 0x000000ff ) << 8 )
+							* i2b[ destColorIndex ] ) >> 16;
+			
+			ushort index = ( ( red & 0xf000 ) >> 4 )
+						 + ( ( green & 0xf000 ) >> 8 )
+						 + ( ( blue & 0xf000 ) >> 12 );
+			* destPtr++ = rgb444ToIndex[ index ];
+			}
+		}
+}
+
+
+/*
+**	qdApplyLightmap()
+**
+**	shade the (8-bit) offscreen buffer with the lightmap
+*/
+void
+qdApplyLightmap( DTSImage * dest )
+{
+// also buried deep in the gl initialization
+// to do: find a better (common, once-only) place for this
+	if ( not gIndexToRedMap )
+		{
+		GetAppData( 'BTbl', 5,
+			reinterpret_cast< void** >( &gIndexToRedMap ), nullptr );
+		GetAppData( 'BTbl', 6,
+			reinterpret_cast< void** >( &gIndexToGreenMap ), nullptr );
+		GetAppData( 'BTbl', 7,
+			reinterpret_cast< void** >( &gIndexToBlueMap ), nullptr );
+		}
+	
+	// RGB444 is 4 bits each of red, green, blue; 4096 possible combinations
+	static uchar * gRGB444ToIndexMap = nullptr;
+	if ( not gRGB444ToIndexMap )
+		{
+		GetAppData( 'BTbl', 8,
+			reinterpret_cast<void **>( &gRGB444ToIndexMap ), nullptr );
+		}
+	if ( not gIndexToRedMap || not gIndexToGreenMap || not gIndexToBlueMap
+	||   not gRGB444ToIndexMap )
+		{
+		return;
+		}
+	
+	PixMapHandle pmh = ::GetGWorldPixMap( gLightmapGWorld );
+	::LockPixels( pmh );
+	
+	SApplyLightmap al;
+	al.alLightmap = reinterpret_cast<const uchar *>( ::GetPixBaseAddr( pmh ) );
+	al.alLightmapRowBytes = ::GetPixRowBytes( pmh ) & 0x3fff;
+	al.alDest = static_cast<uchar *>( dest->GetBits() );
+	al.alDestRowBytes = dest->GetRowBytes();
+	al.alRGB444ToIndex = gRGB444ToIndexMap;
+	al.alTop = gLayout.layoFieldBox.rectTop;
+	al.alBottom = gLayout.layoFieldBox.rectBottom;
+	al.alLeft = gLayout.layoFieldBox.rectLeft;
+	al.alRight = gLayout.layoFieldBox.rectRight;
+	
+	if ( al.alBottom > al.alTop && al.alRight > al.alLeft )
+		{
+		int bands = ( al.alBottom - al.alTop + kLightmapBandRows - 1 ) / kLightmapBandRows;
+		dispatch_apply_f( bands,
+			dispatch_get_global_queue( DISPATCH_QUEUE_PRIORITY_HIGH, 0 ),
+			&al, ApplyLightmapBand );
+		}
+	
+	::UnlockPixels( pmh );
+}
+
+#endif	// USE_OPENGL
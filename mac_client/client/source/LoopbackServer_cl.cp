@@ -0,0 +1,1188 @@
+/*
+**	LoopbackServer_cl.cp		ClanLord
+** 
+**	Copyright 2023 Delta Tao Software, Inc.
+** 
+**	Licensed under the Apache License, Version 2.0 (the "License");
+**	you may not use this file except in compliance with the License.
+**	You may obtain a copy of the License at
+** 
+**     https://www.apache.org/licenses/LICENSE-2.0
+** 
+**	Unless required by applicable law or agreed to in writing, software
+**	distributed under the License is distributed on an "AS IS" BASIS,
+**	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+**	See the License for the specific language governing permissions and
+**	imitations under the License.
+*/
+
+/*
+**	A stand-in for the game server, for load-testing the client's whole receive path.
+**
+**	It listens on a local port, walks one client through the same identifiers /
+**	challenge / logon handshake that Comm_cl.cp expects of the real thing, then plays
+**	a recorded movie at it -- drawstates over UDP, anything else over TCP -- at a
+**	steady rate, with as much loss, reordering and jitter as you care to inject.
+**	The client's acks, resend requests and command numbers are honored the way the
+**	real server would; the round-trip times they reveal are reported at the end.
+**
+**	The movie's pseudo-frames (descriptor tables, cached pictures, saved game state)
+**	aren't sent, since the real server has no such messages; the client learns names
+**	only as the drawstates introduce them. The saved game state does tell us where
+**	in a block the movie's state-data stream begins, so the stream can be trimmed to
+**	whole blocks, and looped without tripping up the client.
+**
+**	Usage: see Usage(), below. Pair it with the client's \BENCHMARK LOOPBACK.
+*/
+
+#ifndef _dtslib2_
+# include "Prefix_dts.h"
+#endif
+
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "DatabaseTypes_cl.h"
+#include "Public_cl.h"
+#include "MovieScan_cl.h"
+
+using std::fprintf;
+using std::printf;
+using std::memcpy;
+
+
+/*
+**	Definitions
+*/
+const ushort	kDefaultPort		= 5010;
+const int		kDefaultInterval	= 200;		// ms; the server's usual 5 fps
+const double	kLogOnTimeout		= 30.0;		// seconds
+const double	kInputTimeout		= 30.0;		// ditto
+const double	kReportInterval		= 10.0;		// ditto, for -v
+
+// the client's state-data framing; see ExtractStateData() in GameWin_cl.cp
+enum
+{
+	kStateSizeHi = 0,
+	kStateSizeLo,
+	kStateData
+};
+
+// drawstate header offsets
+const size_t	kDSAckCmdNumOffset	= 2;
+const size_t	kDSAckFrameOffset	= 3;
+const size_t	kDSResentOffset		= 7;
+
+
+/*
+**	one server message from the movie
+*/
+struct SMovieMsg
+{
+	const uchar *	mmData;			// starting with the message tag
+	size_t			mmSize;
+	bool			mmDrawState;
+	size_t			mmStateOffset;	// drawstates: where the state data begins
+	size_t			mmStateStart;	// ... and the part of it we'll send
+	size_t			mmStateEnd;
+};
+
+
+/*
+**	ScanMovie()'s progress through the movie
+*/
+struct SScanState
+{
+	SMovieMsg *		ssMsgs;			// nullptr when just counting
+	int				ssCount;
+	int *			ssStateMode;
+	int *			ssStateLeft;
+};
+
+
+/*
+**	command-line options
+*/
+struct SOptions
+{
+	ushort			opPort;
+	int				opInterval;		// ms between messages
+	int				opLoss;			// percent of drawstates to drop
+	int				opReorder;		// percent of drawstates to delay past the next one
+	int				opJitter;		// most extra delay, ms
+	int				opLoops;		// times through the movie; 0 = forever
+	uint			opSeed;
+	const char *	opPassword;		// nullptr = anyone may log on
+	bool			opOnce;			// serve one client, then quit
+	bool			opVerbose;
+	const char *	opMoviePath;
+};
+
+
+/*
+**	class CLoopbackClient
+**
+**	one connected client, from logon until it leaves
+*/
+class CLoopbackClient
+{
+public:
+						CLoopbackClient( DTSNetChannel * channel );
+						~CLoopbackClient();
+	
+	DTSError			Handshake( DTSNetChannel * host );
+	DTSError			Stream( DTSNetChannel * host );
+	void				Report( const char * when ) const;
+
+private:
+	enum
+		{
+		kHistory		= 64,		// frames we can resend from
+		kMaxPending		= 32		// datagrams held back for jitter or reordering
+		};
+	
+	struct SSent
+		{
+		int32_t			mFrame;
+		double			mSent;			// when it went out; 0 if dropped, or already acked
+		size_t			mStateLen;
+		uchar			mState[ kMaxMsgSize ];
+		};
+	
+	struct SPending
+		{
+		double			mDue;
+		int32_t			mFrame;
+		size_t			mSize;
+		uchar			mData[ sizeof(Message) ];
+		};
+	
+	struct SStats
+		{
+		ulong			mFrames;		// drawstates generated
+		ulong			mDropped;		// ... that we pretended to lose
+		ulong			mReordered;		// ... or held back past their successor
+		ulong			mResends;		// ... that carried resent state data
+		ulong			mResendRequests;
+		ulong			mUnresendable;	// requests we couldn't satisfy
+		ulong			mReliable;		// other messages, over TCP
+		ulong			mInputs;		// PlayerInput messages received
+		ulong			mRTTCount;
+		double			mRTTSum;
+		double			mRTTMin;
+		double			mRTTMax;
+		};
+	
+	DTSNetChannel *		mChannel;
+	SSent				mHistory[ kHistory ];
+	SPending			mPending[ kMaxPending ];
+	int					mNumPending;
+	int32_t				mFrame;				// last frame number used
+	int32_t				mLastAck;			// latest frame the client has acked
+	int32_t				mResendWanted;		// what the client wants resent; -1 = everything
+	int32_t				mResendInFlight;	// the frame that carried it, until acked
+	uint32_t			mCommandNum;		// the client's latest command number
+	double				mLastInput;
+	double				mStarted;
+	SStats				mStats;
+	
+	void				HandleInput( const Message& msg, size_t size, double now );
+	void				SendMovieMsg( const SMovieMsg& mm, double now );
+	void				QueueDatagram( const uchar * data, size_t size, double now );
+	DTSError			FlushDatagrams( double now, bool all );
+	
+	// declared but not defined
+						CLoopbackClient( const CLoopbackClient& );
+	CLoopbackClient&	operator=( const CLoopbackClient& );
+};
+
+
+/*
+**	Internal Routines
+*/
+static void			Usage( const char * name );
+static bool			ParseOptions( int argc, char ** argv );
+static DTSError		LoadMovie( const char * path );
+static int			ScanMovie( SMovieMsg * oMsgs, int * oStateMode, int * oStateLeft );
+static void			IndexMovieFrame( const SMovieFrame& frame, void * refCon );
+static bool			FindStateData( const uchar * data, size_t size, size_t * oOffset );
+static void			TrimStateStream( int stateMode, int stateLeft );
+static void			AnswerChallenge( const uchar * challenge, const char * password,
+						uchar * oAnswer );
+static DTSError		SendLogOnReply( DTSNetChannel * channel, int tag, DTSError result,
+						const uchar * data, size_t size );
+static double		Now();
+static bool			Chance( int percent );
+
+
+/*
+**	Internal Variables
+*/
+static SOptions		gOptions;
+static uchar *		gMovieData;			// the whole file
+static size_t		gMovieSize;
+static SMovieMsg *	gMovieMsgs;
+static int			gNumMovieMsgs;
+static int			gNumDrawStates;
+
+
+/*
+**	main()
+**
+**	load the movie, then serve clients until told to stop
+*/
+int
+main( int argc, char ** argv )
+{
+	if ( not ParseOptions( argc, argv ) )
+		{
+		Usage( argv[0] );
+		return 1;
+		}
+	
+	DTSError result = LoadMovie( gOptions.opMoviePath );
+	if ( noErr != result )
+		return 1;
+	
+	srandom( gOptions.opSeed );
+	
+	DTSNetChannel host;
+	result = DTSInitNetwork();
+	if ( noErr == result )
+		result = host.InitHost( gOptions.opPort, 1 );
+	if ( noErr != result )
+		{
+		fprintf( stderr, "Can't listen on port %u: error %d.\n",
+			gOptions.opPort, (int) result );
+		return 1;
+		}
+	
+	printf( "Serving %s (%d messages, %d drawstates) on port %u; "
+			"%d ms apart, %d%% loss, %d%% reordering, %d ms jitter, seed %u.\n",
+		gOptions.opMoviePath, gNumMovieMsgs, gNumDrawStates, gOptions.opPort,
+		gOptions.opInterval, gOptions.opLoss, gOptions.opReorder, gOptions.opJitter,
+		gOptions.opSeed );
+	
+	for (;;)
+		{
+		DTSNetChannel * channel = nullptr;
+		result = host.AnswerClient( &channel );
+		if ( noErr != result )
+			{
+			fprintf( stderr, "Lost the listening socket: error %d.\n", (int) result );
+			break;
+			}
+		if ( not channel )
+			{
+			usleep( 10 * 1000 );
+			continue;
+			}
+		
+		printf( "Client connected.\n" );
+		
+		CLoopbackClient * client = NEW_TAG("CLoopbackClient") CLoopbackClient( channel );
+		if ( not client )
+			{
+			delete channel;
+			result = memFullErr;
+			break;
+			}
+		
+		result = client->Handshake( &host );
+		if ( noErr == result )
+			{
+			result = client->Stream( &host );
+			client->Report( "Done" );
+			}
+		delete client;
+		
+		printf( "Client gone (%d).\n", (int) result );
+		if ( gOptions.opOnce )
+			break;
+		}
+	
+	host.Close();
+	DTSExitNetwork();
+	
+	delete[] gMovieMsgs;
+	delete[] gMovieData;
+	
+	return noErr == result ? 0 : 1;
+}
+
+
+/*
+**	Usage()
+*/
+void
+Usage( const char * name )
+{
+	fprintf( stderr,
+		"usage: %s [options] movie.clMov\n"
+		"  -p port       listen here (default %u)\n"
+		"  -i ms         time between frames (default %d)\n"
+		"  -l percent    drop this many drawstates\n"
+		"  -o percent    deliver this many after their successor\n"
+		"  -j ms         delay each drawstate by up to this much\n"
+		"  -n loops      times through the movie; 0 = forever (default 1)\n"
+		"  -s seed       for the loss/reorder/jitter dice (default 1)\n"
+		"  -w password   check the logon against this password\n"
+		"  -1            serve one client, then quit\n"
+		"  -v            report every %d seconds\n",
+		name, kDefaultPort, kDefaultInterval, int( kReportInterval ) );
+}
+
+
+/*
+**	ParseOptions()
+**
+**	fill in gOptions from the command line
+*/
+bool
+ParseOptions( int argc, char ** argv )
+{
+	SOptions& op = gOptions;
+	op.opPort		= kDefaultPort;
+	op.opInterval	= kDefaultInterval;
+	op.opLoss		= 0;
+	op.opReorder	= 0;
+	op.opJitter		= 0;
+	op.opLoops		= 1;
+	op.opSeed		= 1;
+	op.opPassword	= nullptr;
+	op.opOnce		= false;
+	op.opVerbose	= false;
+	op.opMoviePath	= nullptr;
+	
+	int ch;
+	while ( -1 != (ch = getopt( argc, argv, "p:i:l:o:j:n:s:w:1v" )) )
+		{
+		switch ( ch )
+			{
+			case 'p':	op.opPort		= ushort( atoi( optarg ) );		break;
+			case 'i':	op.opInterval	= atoi( optarg );				break;
+			case 'l':	op.opLoss		= atoi( optarg );				break;
+			case 'o':	op.opReorder	= atoi( optarg );				break;
+			case 'j':	op.opJitter		= atoi( optarg );				break;
+			case 'n':	op.opLoops		= atoi( optarg );				break;
+			case 's':	op.opSeed		= uint( strtoul( optarg, nullptr, 0 ) );	break;
+			case 'w':	op.opPassword	= optarg;						break;
+			case '1':	op.opOnce		= true;							break;
+			case 'v':	op.opVerbose	= true;							break;
+			default:	return false;
+			}
+		}
+	
+	if ( optind != argc - 1 )
+		return false;
+	op.opMoviePath = argv[ optind ];
+	
+	return op.opPort > 0
+		&& op.opInterval > 0
+		&& op.opLoss    >= 0  &&  op.opLoss    <= 100
+		&& op.opReorder >= 0  &&  op.opReorder <= 100
+		&& op.opJitter  >= 0
+		&& op.opLoops   >= 0;
+}
+
+
+#pragma mark -
+
+/*
+**	LoadMovie()
+**
+**	read the whole movie, and index the server messages in it
+*/
+DTSError
+LoadMovie( const char * path )
+{
+	DTSError result = ReadMovieFile( path, &gMovieData, &gMovieSize );
+	if ( noErr != result )
+		return result;
+	
+	// count the messages, then index them
+	int stateMode, stateLeft;
+	gNumMovieMsgs = ScanMovie( nullptr, &stateMode, &stateLeft );
+	if ( gNumMovieMsgs > 0 )
+		{
+		gMovieMsgs = NEW_TAG("LoopbackMovieMsgs") SMovieMsg[ gNumMovieMsgs ];
+		if ( not gMovieMsgs )
+			return memFullErr;
+		ScanMovie( gMovieMsgs, &stateMode, &stateLeft );
+		}
+	
+	// find the state data in each drawstate
+	gNumDrawStates = 0;
+	for ( int i = 0;  i < gNumMovieMsgs;  ++i )
+		{
+		SMovieMsg& mm = gMovieMsgs[i];
+		mm.mmDrawState = false;
+		if ( kMsgDrawState == Peek16( mm.mmData )
+		&&   FindStateData( mm.mmData, mm.mmSize, &mm.mmStateOffset ) )
+			{
+			mm.mmDrawState	= true;
+			mm.mmStateStart	= mm.mmStateOffset;
+			mm.mmStateEnd	= mm.mmSize;
+			++gNumDrawStates;
+			}
+		}
+	if ( 0 == gNumDrawStates )
+		{
+		fprintf( stderr, "%s has no frames we can send.\n", path );
+		return paramErr;
+		}
+	
+	TrimStateStream( stateMode, stateLeft );
+	
+	return noErr;
+}
+
+
+/*
+**	ScanMovie()
+**
+**	walk the frames of the movie, skipping pseudo-frames; fill in oMsgs, if any.
+**	Also report how far into a state-data block the recording began, from the
+**	saved game state: the mode, and for kStateData, how many bytes remain.
+**	Return the number of messages.
+*/
+int
+ScanMovie( SMovieMsg * oMsgs, int * oStateMode, int * oStateLeft )
+{
+	*oStateMode = kStateSizeHi;
+	*oStateLeft = 0;
+	
+	SScanState state;
+	state.ssMsgs		= oMsgs;
+	state.ssCount		= 0;
+	state.ssStateMode	= oStateMode;
+	state.ssStateLeft	= oStateLeft;
+	ScanMovieFrames( gMovieData, gMovieSize, IndexMovieFrame, &state );
+	
+	return state.ssCount;
+}
+
+
+/*
+**	IndexMovieFrame()
+**
+**	ScanMovieFrames() callback, for ScanMovie()
+*/
+void
+IndexMovieFrame( const SMovieFrame& frame, void * refCon )
+{
+	SScanState * state = static_cast<SScanState *>( refCon );
+	
+	if ( frame.mfFlags & kMovieFlagPseudo )
+		{
+		// only the game state saved before the first message matters
+		if ( ( frame.mfFlags & kMovieFlagGameState )
+		&&   0 == state->ssCount
+		&&   frame.mfSize >= kMovieGameStateLen )
+			{
+			int mode    = int32_t( Peek32( frame.mfData +  8 ) );
+			int curSize = int32_t( Peek32( frame.mfData + 16 ) );
+			int expSize = int32_t( Peek32( frame.mfData + 20 ) );
+			*state->ssStateMode = mode;
+			if ( kStateData == mode  &&  expSize > curSize )
+				*state->ssStateLeft = expSize - curSize;
+			else
+			if ( kStateSizeLo == mode )
+				*state->ssStateLeft = expSize;		// the hi byte of the size
+			}
+		return;
+		}
+	
+	if ( state->ssMsgs )
+		{
+		SMovieMsg& mm = state->ssMsgs[ state->ssCount ];
+		mm.mmData = frame.mfData;
+		mm.mmSize = frame.mfSize;
+		}
+	++state->ssCount;
+}
+
+
+/*
+**	FindStateData()
+**
+**	parse a drawstate the way CCLFrame::ReadKeyFromSpool() does, to find where
+**	the state data begins
+*/
+bool
+FindStateData( const uchar * data, size_t size, size_t * oOffset )
+{
+	static DataSpool spool;
+	if ( not spool.GetData()  &&  noErr != spool.Init( sizeof(Message) ) )
+		return false;
+	if ( size > sizeof(Message) )
+		return false;
+	
+	// zero the tail, so a runaway string stops at the end of the message
+	uchar * buffer = static_cast<uchar *>( spool.GetData() );
+	memcpy( buffer, data, size );
+	memset( buffer + size, 0, sizeof(Message) - size );
+	spool.SetLimit( size );
+	spool.SetMark( 0 );
+	spool.ClearResult();
+	
+	spool.GetNumber( kSpoolUnsignedShort );		// tag
+	spool.GetNumber( kSpoolUnsignedByte );		// ack command number
+	spool.GetNumber( kSpoolUnsignedLong );		// ack frame
+	spool.GetNumber( kSpoolUnsignedLong );		// resent frame
+	
+	// descriptors
+	char name[ 256 ];
+	uchar colors[ 256 ];
+	for ( int count = spool.GetNumber( kSpoolUnsignedByte );  count > 0;  --count )
+		{
+		spool.GetNumber( kSpoolUnsignedByte );	// index
+		spool.GetNumber( kSpoolUnsignedByte );	// type
+		spool.GetNumber( kSpoolUnsignedShort );	// picture
+		spool.GetString( name, sizeof name );
+		int numColors = spool.GetNumber( kSpoolUnsignedByte );
+		spool.GetData( colors, numColors );
+		}
+	
+	// hit points, spell points, balance, and light
+	for ( int i = 0;  i < 7;  ++i )
+		spool.GetNumber( kSpoolUnsignedByte );
+	
+	// pictures
+	int numPict = spool.GetNumber( kSpoolUnsignedByte );
+	if ( 255 == numPict )
+		{
+		spool.GetNumber( kSpoolUnsignedByte );	// pictures again
+		numPict = spool.GetNumber( kSpoolUnsignedByte );
+		}
+	for ( int i = 0;  i < numPict;  ++i )
+		{
+		DTSKeyID pictID;
+		int horz, vert;
+		UnspoolFramePicture( &spool, pictID, horz, vert );
+		}
+#if BITWISE_IMAGE_SPOOL
+	if ( numPict )
+		spool.ByteAlignRead();
+#endif
+	
+	// mobiles
+	for ( int count = spool.GetNumber( kSpoolUnsignedByte );  count > 0;  --count )
+		{
+		spool.GetNumber( kSpoolUnsignedByte );	// index
+		spool.GetNumber( kSpoolUnsignedByte );	// state
+		spool.GetNumber( kSpoolSignedShort );	// h
+		spool.GetNumber( kSpoolSignedShort );	// v
+		spool.GetNumber( kSpoolUnsignedByte );	// colors
+		}
+	
+	if ( noErr != spool.GetResult()  ||  spool.GetMark() > size )
+		return false;
+	
+	*oOffset = spool.GetMark();
+	return true;
+}
+
+
+/*
+**	TrimStateStream()
+**
+**	The state data of all the drawstates, end to end, is a stream of blocks, each
+**	a 16-bit size and that many bytes. Drop the partial block the recording began
+**	in the middle of, and the partial one it ended in, so that a fresh client can
+**	follow the stream from the first frame, and back around to it again.
+*/
+void
+TrimStateStream( int stateMode, int stateLeft )
+{
+	// gather the stream
+	size_t total = 0;
+	for ( int i = 0;  i < gNumMovieMsgs;  ++i )
+		{
+		const SMovieMsg& mm = gMovieMsgs[i];
+		if ( mm.mmDrawState )
+			total += mm.mmSize - mm.mmStateOffset;
+		}
+	if ( 0 == total )
+		return;
+	
+	uchar * stream = NEW_TAG("LoopbackStateStream") uchar[ total ];
+	if ( not stream )
+		return;
+	size_t pos = 0;
+	for ( int i = 0;  i < gNumMovieMsgs;  ++i )
+		{
+		const SMovieMsg& mm = gMovieMsgs[i];
+		if ( mm.mmDrawState )
+			{
+			size_t len = mm.mmSize - mm.mmStateOffset;
+			memcpy( stream + pos, mm.mmData + mm.mmStateOffset, len );
+			pos += len;
+			}
+		}
+	
+	// where does the first whole block begin?
+	size_t begin = 0;
+	if ( kStateData == stateMode )
+		begin = stateLeft;
+	else
+	if ( kStateSizeLo == stateMode  &&  total > 0 )
+		begin = 1 + ( (stateLeft & 0xFF00) | stream[0] );
+	
+	// and where does the last one end?
+	size_t end = begin;
+	while ( end + 2 <= total )
+		{
+		size_t blockEnd = end + 2 + ( (stream[ end ] << 8) | stream[ end + 1 ] );
+		if ( blockEnd > total )
+			break;
+		end = blockEnd;
+		}
+	delete[] stream;
+	
+	if ( begin > end )
+		begin = end;
+	if ( begin || end < total )
+		{
+		printf( "Trimming %lu bytes from the start of the state data, %lu from the end.\n",
+			(ulong) begin, (ulong) ( total - end ) );
+		}
+	
+	// clip each drawstate's share to [begin, end)
+	pos = 0;
+	for ( int i = 0;  i < gNumMovieMsgs;  ++i )
+		{
+		SMovieMsg& mm = gMovieMsgs[i];
+		if ( not mm.mmDrawState )
+			continue;
+		
+		size_t len = mm.mmSize - mm.mmStateOffset;
+		size_t first = pos < begin ? begin - pos : 0;
+		size_t last  = pos + len > end ? ( end > pos ? end - pos : 0 ) : len;
+		if ( first > last )
+			first = last;
+		mm.mmStateStart = mm.mmStateOffset + first;
+		mm.mmStateEnd   = mm.mmStateOffset + last;
+		pos += len;
+		}
+}
+
+
+#pragma mark -
+
+/*
+**	CLoopbackClient::CLoopbackClient()
+*/
+CLoopbackClient::CLoopbackClient( DTSNetChannel * channel ) :
+	mChannel( channel ),
+	mNumPending( 0 ),
+	mFrame( 0 ),
+	mLastAck( 0 ),
+	mResendWanted( -1 ),		// a new client waits for a "resend" of everything
+	mResendInFlight( 0 ),
+	mCommandNum( 0 ),
+	mLastInput( 0 ),
+	mStarted( 0 )
+{
+	memset( mHistory, 0, sizeof mHistory );
+	memset( &mStats, 0, sizeof mStats );
+}
+
+
+/*
+**	CLoopbackClient::~CLoopbackClient()
+*/
+CLoopbackClient::~CLoopbackClient()
+{
+	if ( mChannel )
+		{
+		mChannel->Close();
+		delete mChannel;
+		}
+}
+
+
+/*
+**	CLoopbackClient::Handshake()
+**
+**	the server's half of ConnectComm() and LogOnToHost():
+**	answer the identifiers with a challenge, and check the answer
+*/
+DTSError
+CLoopbackClient::Handshake( DTSNetChannel * host )
+{
+	uchar challenge[ kChallengeLen ];
+	for ( uint i = 0;  i < sizeof challenge;  ++i )
+		challenge[i] = uchar( random() );
+	
+	double timeout = Now() + kLogOnTimeout;
+	for (;;)
+		{
+		// keep the host's UDP flowing; turn away anyone else
+		DTSNetChannel * other = nullptr;
+		host->AnswerClient( &other );
+		if ( other )
+			{
+			other->Close();
+			delete other;
+			}
+		
+		Message msg;
+		size_t size = sizeof msg;
+		DTSError result = mChannel->Read( &msg, &size );
+		if ( result < noErr )
+			return result;
+		if ( result > noErr )
+			{
+			if ( Now() > timeout )
+				{
+				fprintf( stderr, "Client never logged on.\n" );
+				return kNetworkHandshakeTimeout;
+				}
+			usleep( 5 * 1000 );
+			continue;
+			}
+		
+		const LogOn& logon = msg.msgLogOn;
+		const size_t headLen = offsetof( LogOn, logData );
+		if ( size < headLen )
+			continue;
+		
+		switch ( BigToNativeEndian( logon.logMsgTag ) )
+			{
+			case kMsgIdentifiers:
+				result = SendLogOnReply( mChannel, kMsgChallenge, noErr,
+							challenge, sizeof challenge );
+				if ( noErr != result )
+					return result;
+				break;
+			
+			case kMsgLogOn:
+				{
+				// the name, then the answer to the challenge
+				char * data = msg.msgLogOn.logData;
+				size_t dataLen = size - headLen;
+				SimpleEncrypt( data, dataLen );
+				size_t nameLen = strnlen( data, dataLen );
+				if ( nameLen + 1 + kChallengeLen > dataLen )
+					{
+					const char text[] = "Malformed logon.";
+					return SendLogOnReply( mChannel, kMsgLogOn, kBadCharName,
+								reinterpret_cast<const uchar *>( text ), sizeof text );
+					}
+				const uchar * answer = reinterpret_cast<const uchar *>( data + nameLen + 1 );
+				
+				if ( gOptions.opPassword )
+					{
+					uchar expected[ kChallengeLen ];
+					AnswerChallenge( challenge, gOptions.opPassword, expected );
+					if ( memcmp( answer, expected, sizeof expected ) )
+						{
+						printf( "%s: wrong password.\n", data );
+						const char text[] = "Wrong password.";
+						result = SendLogOnReply( mChannel, kMsgLogOn, kBadCharPass,
+									reinterpret_cast<const uchar *>( text ), sizeof text );
+						if ( noErr != result )
+							return result;
+						timeout = Now() + kLogOnTimeout;
+						break;
+						}
+					}
+				
+				printf( "%s logged on.\n", data );
+				const char text[] = "Welcome to the loopback server.";
+				return SendLogOnReply( mChannel, kMsgLogOn, noErr,
+							reinterpret_cast<const uchar *>( text ), sizeof text );
+				}
+			
+			default:
+				break;
+			}
+		}
+}
+
+
+/*
+**	CLoopbackClient::Stream()
+**
+**	play the movie at the client until it's done, or the client leaves
+*/
+DTSError
+CLoopbackClient::Stream( DTSNetChannel * host )
+{
+	const double interval = gOptions.opInterval / 1000.0;
+	mStarted = mLastInput = Now();
+	double nextSend = mStarted;
+	double nextReport = mStarted + kReportInterval;
+	int next = 0;
+	int loops = 0;
+	
+	DTSError result = noErr;
+	for (;;)
+		{
+		double now = Now();
+		
+		// keep the host's UDP flowing; turn away anyone else
+		DTSNetChannel * other = nullptr;
+		host->AnswerClient( &other );
+		if ( other )
+			{
+			other->Close();
+			delete other;
+			}
+		
+		// hear from the client
+		Message msg;
+		size_t size = sizeof msg;
+		while ( noErr == (result = mChannel->Read( &msg, &size )) )
+			{
+			HandleInput( msg, size, now );
+			size = sizeof msg;
+			}
+		if ( result < noErr )
+			break;
+		if ( now - mLastInput > kInputTimeout )
+			{
+			fprintf( stderr, "Client stopped talking.\n" );
+			result = kNetworkDisconnect;
+			break;
+			}
+		
+		// time for the next message?
+		if ( now >= nextSend )
+			{
+			if ( next >= gNumMovieMsgs )
+				{
+				next = 0;
+				if ( gOptions.opLoops  &&  ++loops >= gOptions.opLoops )
+					{
+					result = FlushDatagrams( now, true );
+					break;
+					}
+				}
+			SendMovieMsg( gMovieMsgs[ next ], now );
+			++next;
+			
+			// keep to the schedule, unless we've fallen hopelessly behind
+			nextSend += interval;
+			if ( nextSend < now - 1.0 )
+				nextSend = now + interval;
+			}
+		
+		result = FlushDatagrams( now, false );
+		if ( result < noErr )
+			break;
+		
+		if ( gOptions.opVerbose  &&  now >= nextReport )
+			{
+			Report( "So far" );
+			nextReport += kReportInterval;
+			}
+		
+		usleep( 1000 );
+		}
+	
+	return result;
+}
+
+
+/*
+**	CLoopbackClient::HandleInput()
+**
+**	note what the client has acked and wants resent
+*/
+void
+CLoopbackClient::HandleInput( const Message& msg, size_t size, double now )
+{
+	if ( size < offsetof( PlayerInput, piKeyString )
+	||   kMsgPlayerInput != BigToNativeEndian( msg.msgTag ) )
+		{
+		return;
+		}
+	
+	const PlayerInput& pi = msg.msgPlayerInput;
+	int32_t ack    = BigToNativeEndian( pi.piAckFrame );
+	int32_t resend = BigToNativeEndian( pi.piResendFrame );
+	mCommandNum    = BigToNativeEndian( pi.piCommandNum );
+	mLastInput     = now;
+	++mStats.mInputs;
+	
+	// the round trip: from sending a frame, to hearing it acked
+	if ( ack > mLastAck )
+		{
+		mLastAck = ack;
+		SSent& sent = mHistory[ ack % kHistory ];
+		if ( sent.mFrame == ack  &&  sent.mSent > 0 )
+			{
+			double rtt = now - sent.mSent;
+			if ( 0 == mStats.mRTTCount  ||  rtt < mStats.mRTTMin )
+				mStats.mRTTMin = rtt;
+			if ( rtt > mStats.mRTTMax )
+				mStats.mRTTMax = rtt;
+			mStats.mRTTSum += rtt;
+			++mStats.mRTTCount;
+			sent.mSent = 0;
+			}
+		}
+	
+	// once the client has seen past our last resend, it may ask again
+	if ( mResendInFlight  &&  ack >= mResendInFlight )
+		mResendInFlight = 0;
+	
+	if ( resend  &&  resend != mResendWanted )
+		++mStats.mResendRequests;
+	mResendWanted = resend;
+}
+
+
+/*
+**	CLoopbackClient::SendMovieMsg()
+**
+**	send one message from the movie: drawstates re-stamped, with a resend
+**	if one is wanted, and subject to loss, reordering, and jitter;
+**	anything else as is, over TCP
+*/
+void
+CLoopbackClient::SendMovieMsg( const SMovieMsg& mm, double now )
+{
+	if ( not mm.mmDrawState )
+		{
+		DTSError result = mChannel->Write( mm.mmData, mm.mmSize, kNetWriteReliable );
+		__Check_noErr( result );
+		++mStats.mReliable;
+		return;
+		}
+	
+	int32_t frame = ++mFrame;
+	++mStats.mFrames;
+	
+	// remember its state data, in case it has to be resent
+	SSent& sent = mHistory[ frame % kHistory ];
+	sent.mFrame    = frame;
+	sent.mSent     = 0;
+	sent.mStateLen = mm.mmStateEnd - mm.mmStateStart;
+	memcpy( sent.mState, mm.mmData + mm.mmStateStart, sent.mStateLen );
+	
+	// the drawstate proper, then the state data
+	uchar buffer[ sizeof(Message) ];
+	size_t headLen = mm.mmStateOffset;
+	memcpy( buffer, mm.mmData, headLen );
+	size_t size = headLen;
+	int32_t resent = 0;
+	
+	if ( mResendWanted  &&  not mResendInFlight )
+		{
+		// resend everything from the wanted frame on, if we still can
+		int32_t from = mResendWanted > 0 ? mResendWanted : 1;
+		bool ok = from <= frame  &&  frame - from < kHistory;
+		for ( int32_t f = from;  ok  &&  f <= frame;  ++f )
+			{
+			const SSent& old = mHistory[ f % kHistory ];
+			if ( old.mFrame != f  ||  size + old.mStateLen > sizeof buffer )
+				ok = false;
+			else
+				{
+				memcpy( buffer + size, old.mState, old.mStateLen );
+				size += old.mStateLen;
+				}
+			}
+		
+		// if not, the client will just have to make do
+		if ( not ok )
+			{
+			++mStats.mUnresendable;
+			if ( gOptions.opVerbose )
+				printf( "Can't resend from frame %d at frame %d.\n", (int) from, (int) frame );
+			size = headLen;
+			memcpy( buffer + size, sent.mState, sent.mStateLen );
+			size += sent.mStateLen;
+			}
+		
+		resent = mResendWanted;
+		mResendInFlight = frame;
+		++mStats.mResends;
+		}
+	else
+		{
+		memcpy( buffer + size, sent.mState, sent.mStateLen );
+		size += sent.mStateLen;
+		}
+	
+	buffer[ kDSAckCmdNumOffset ] = uchar( mCommandNum );
+	Poke32( buffer + kDSAckFrameOffset, frame );
+	Poke32( buffer + kDSResentOffset, resent );
+	
+	// into the ether?
+	if ( Chance( gOptions.opLoss ) )
+		{
+		++mStats.mDropped;
+		return;
+		}
+	
+	QueueDatagram( buffer, size, now );
+}
+
+
+/*
+**	CLoopbackClient::QueueDatagram()
+**
+**	hold a drawstate until its (jittered, maybe reordered) time comes
+*/
+void
+CLoopbackClient::QueueDatagram( const uchar * data, size_t size, double now )
+{
+	double due = now;
+	if ( gOptions.opJitter )
+		due += ( random() % ( gOptions.opJitter + 1 ) ) / 1000.0;
+	
+	// late enough that its successor, however jittered, gets there first
+	if ( Chance( gOptions.opReorder ) )
+		{
+		due = now + ( gOptions.opInterval + gOptions.opJitter + 1 ) / 1000.0;
+		++mStats.mReordered;
+		}
+	
+	// no room? let everything we're holding go early
+	if ( mNumPending >= kMaxPending )
+		{
+		DTSError result = FlushDatagrams( now, true );
+		__Check_noErr( result );
+		}
+	
+	SPending& pend = mPending[ mNumPending++ ];
+	pend.mDue   = due;
+	pend.mFrame = mFrame;
+	pend.mSize  = size;
+	memcpy( pend.mData, data, size );
+}
+
+
+/*
+**	CLoopbackClient::FlushDatagrams()
+**
+**	send the pending drawstates that are due (or all of them), soonest first
+*/
+DTSError
+CLoopbackClient::FlushDatagrams( double now, bool all )
+{
+	DTSError result = noErr;
+	while ( mNumPending > 0  &&  noErr == result )
+		{
+		int soonest = 0;
+		for ( int i = 1;  i < mNumPending;  ++i )
+			{
+			if ( mPending[i].mDue < mPending[ soonest ].mDue )
+				soonest = i;
+			}
+		
+		SPending& pend = mPending[ soonest ];
+		if ( not all  &&  pend.mDue > now )
+			break;
+		
+		result = mChannel->Write( pend.mData, pend.mSize, kNetWriteUnreliable );
+		
+		SSent& sent = mHistory[ pend.mFrame % kHistory ];
+		if ( sent.mFrame == pend.mFrame )
+			sent.mSent = Now();
+		
+		if ( soonest != --mNumPending )
+			pend = mPending[ mNumPending ];
+		}
+	
+	return result;
+}
+
+
+/*
+**	CLoopbackClient::Report()
+*/
+void
+CLoopbackClient::Report( const char * when ) const
+{
+	const SStats& st = mStats;
+	printf( "%s, after %.1f s: %lu frames, %lu dropped, %lu reordered, "
+			"%lu resends for %lu requests (%lu unsatisfiable), %lu other messages.\n",
+		when, Now() - mStarted, st.mFrames, st.mDropped, st.mReordered,
+		st.mResends, st.mResendRequests, st.mUnresendable, st.mReliable );
+	
+	if ( st.mRTTCount )
+		{
+		printf( "    %lu inputs; round trip %.1f ms min, %.1f avg, %.1f max "
+				"over %lu frames.\n",
+			st.mInputs, st.mRTTMin * 1000.0, st.mRTTSum * 1000.0 / st.mRTTCount,
+			st.mRTTMax * 1000.0, st.mRTTCount );
+		}
+	else
+		printf( "    %lu inputs; no round trips measured.\n", st.mInputs );
+	
+	std::fflush( stdout );
+}
+
+
+#pragma mark -
+
+/*
+**	AnswerChallenge()
+**
+**	what the client's AnswerChallenge() ought to have come up with
+*/
+void
+AnswerChallenge( const uchar * challenge, const char * password, uchar * oAnswer )
+{
+	size_t pwlen = strlen( password );
+	uchar plaintext[ kChallengeLen ];
+	DTSDecode( challenge, plaintext, kChallengeLen, password, pwlen );
+	
+	uchar hash[ 16 ];
+	DTSOneWayHash( plaintext, kChallengeLen, hash );
+	
+	DTSEncode( hash, oAnswer, sizeof hash, password, pwlen );
+}
+
+
+/*
+**	SendLogOnReply()
+**
+**	send a LogOn-shaped message with the given tag, result, and data
+*/
+DTSError
+SendLogOnReply( DTSNetChannel * channel, int tag, DTSError result,
+	const uchar * data, size_t size )
+{
+	LogOn reply;
+	memset( &reply, 0, offsetof( LogOn, logData ) );
+	reply.logMsgTag = NativeToBigEndian( uint16_t( tag ) );
+	reply.logResult = NativeToBigEndian( int16_t( result ) );
+	
+	if ( size > sizeof reply.logData )
+		size = sizeof reply.logData;
+	memcpy( reply.logData, data, size );
+	
+	return channel->Write( &reply, offsetof( LogOn, logData ) + size, kNetWriteReliable );
+}
+
+
+/*
+**	Now()
+**
+**	seconds, from some arbitrary point
+*/
+double
+Now()
+{
+	timeval tv;
+	gettimeofday( &tv, nullptr );
+	return tv.tv_sec + tv.tv_usec / 1.0e6;
+}
+
+
+/*
+**	Chance()
+**
+**	roll the dice
+*/
+bool
+Chance( int percent )
+{
+	return percent > 0  &&  random() % 100 < percent;
+}
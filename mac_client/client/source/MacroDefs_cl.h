@@ -131,7 +131,7 @@ struct CMacroKind
 //
 // A linked list
 //
-class CMacro : public DTSLinkedList<CMacro>
+class CMacro : public DTSDLinkedList<CMacro>
 {
 public:
 	int					mKind;
@@ -404,7 +404,7 @@ private:
 //
 //	Linked list of macros which are executing
 //
-class CExecutingMacro : public DTSLinkedList<CExecutingMacro>
+class CExecutingMacro : public DTSDLinkedList<CExecutingMacro>
 {
 public:
 	CMarkMacro * 	exMark;
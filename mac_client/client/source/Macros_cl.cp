@@ -3279,30 +3279,26 @@ CExecutingMacro::Continue()
 		
 		// See if the lowest level function is done
 		DTSError err = noErr;
-		CMarkMacro ** on = &exMark;
-		while ( (*on)->linkNext )
-			on = reinterpret_cast<CMarkMacro **>( &(*on)->linkNext );
+		CMarkMacro * on = static_cast<CMarkMacro *>( CMacro::Last( exMark ) );
 		
 		// Check to see if we are done or an error has occurred
-		while ( err || not (*on)->mTriggers )
+		while ( err || not on->mTriggers )
 			{
 			err = noErr;
 			
 			// Delete this function
-			CMarkMacro::DeleteLinkedList( (CMacro *&) *on );
-			*on = nullptr;
+			on->Remove( reinterpret_cast<CMacro *&>( exMark ) );
+			delete on;
 			
 			// Check the next highest to see if it is done and so on.
 			if ( not exMark )
 				return 1;
 			
-			on = &exMark;
-			while ( (*on)->linkNext )
-				on = reinterpret_cast<CMarkMacro **>( &(*on)->linkNext );
+			on = static_cast<CMarkMacro *>( CMacro::Last( exMark ) );
 			}
 		
 		// Execute a command
-		err = ExecuteCommand( &(*on)->mTriggers, (*on)->mFirst );
+		err = ExecuteCommand( &on->mTriggers, on->mFirst );
 		}
 	
 	return noErr;
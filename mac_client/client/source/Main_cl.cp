@@ -34,8 +34,10 @@
 #include "ClanLord.h"
 #include "VersionNumber_cl.h"
 #include "CommandIDs_cl.h"
+#include "JitterBuffer_cl.h"
 #include "Macros_cl.h"
 #include "Movie_cl.h"
+#include "NetStats_cl.h"
 #include "SendText_cl.h"
 #include "Speech_cl.h"
 #include "TuneHelper_cl.h"
@@ -59,6 +61,8 @@
 */
 DataSpool *		gDSSpool;				// the spool that holds the raw draw state data
 DescTable *		gDescTable;				// player descriptors
+char *			gDescBubbleText;
+int32_t *		gDescBubbleCounter;
 DescTable *		gThisPlayer;
 int				gNumMobiles;
 DSMobile		gDSMobile[ 256 ];
@@ -88,6 +92,7 @@ DTSWindow *		gPlayersWindow;			// players window
 int				gAckFrame;				// latest state data frame
 int				gNumFrames;				// number of frames this session
 int				gLostFrames;			// number of lost frames this session
+double			gFrameArrival;			// when the latest frame got here
 int				gResendFrame;			// request resend of state data frame
 ulong			gCommandNumber = 1;		// enumerate the commands sent to the server
 int				gInvenCmd;				// player's inventory command
@@ -457,6 +462,10 @@ static void		PlayGame();
 static void		SelectShowWindow( DTSWindow * window );
 static bool		DoWindowCmd( long menuCmd );
 static void		AllocDescTable();
+static int		WalkDescRecords( DescRecord * table, const int * mobiles, int numMobiles,
+					const DTSPoint * where, int frame );
+static int		WalkDescTable( const int * mobiles, int numMobiles, const DTSPoint * where,
+					int frame );
 static void		GetWindowPosition( const DTSWindow * window, DTSRect * pos );
 static void		GetMainPrefs();
 static void		ValidateWindowPosition( DTSRect * pos, int windowNumber );
@@ -481,6 +490,9 @@ static void		ResetDockIcon();
 #if defined( DEBUG_IMAGECOUNT )
 static void		DumpImageCounts();
 #endif
+#if DTS_ALLOC_PROFILE
+static void		IdleAllocProfile();
+#endif
 
 
 /*
@@ -510,6 +522,12 @@ static bool			gMusicDisabled;
 // the one & only recorder
 static LatencyRecorder		gLatencyRecorder;
 
+#if DTS_ALLOC_PROFILE
+// periodic heap-profile snapshots
+static int			gAllocProfileInterval;		// seconds between snapshots; 0 = off
+static ulong		gAllocProfileNextTime;		// GetFrameCounter() for the next one
+#endif
+
 #ifdef HANDLE_MUSICOMMANDS
 extern CTuneQueue	gTuneQueue;
 #endif
@@ -523,8 +541,11 @@ extern CTuneQueue	gTuneQueue;
 **	Look for messages from the server.
 */
 int
-main()
+main( int argc, char ** argv )
 {
+	// time everything from here to the window; see StartupTrace_cl.cp
+	BeginStartupTrace( argc, argv );
+	
 	setlocale( LC_ALL, "" );
 	
 	CLApp theCLApp;
@@ -556,18 +577,26 @@ main()
 	
 	// Initialize text styles
 	InitTextStyles();
+	TraceStartupPhase( "InitScreens, InitTextStyles" );
 	
 	// open the key files
 	if ( not gErrorCode )
 		OpenKeyFiles();
+	TraceStartupPhase( "OpenKeyFiles" );
 	
 	// get the prefs data
 	// regardless of whether there was an error opening the key files or not
 	GetPrefsData();
+	TraceStartupPhase( "GetPrefsData" );
 	
 	// Update the files
 	if ( not gErrorCode )
 		UpdateKeyFiles();
+	TraceStartupPhase( "UpdateKeyFiles" );
+	
+	// CL_Players isn't needed until we join, so open it while the windows go up
+	if ( not gErrorCode )
+		PrefetchPlayers();
 	
 	if ( not gErrorCode )
 		{
@@ -604,6 +633,7 @@ main()
 	// initialize the blitters
 	if ( not gErrorCode )
 		InitBlitters();
+	TraceStartupPhase( "InitBlitters" );
 	
 #if ENABLE_MUSIC_FILES
 	// initialize music engine (QuickTime background music, not bards)
@@ -616,6 +646,7 @@ main()
 			gErrorCode = noErr;
 			}
 		}
+	TraceStartupPhase( "InitMusic" );
 #endif  // ENABLE_MUSIC_FILES
 	
 	// initialize the menus
@@ -631,6 +662,7 @@ main()
 	
 	if ( not gErrorCode )
 		theMenu.Setup();
+	TraceStartupPhase( "menus" );
 	
 	// allocate the descriptor table
 	if ( not gErrorCode )
@@ -643,6 +675,7 @@ main()
 	// initialize the frame buffer
 	if ( not gErrorCode )
 		InitFrames();
+	TraceStartupPhase( "AllocDescTable, InitCaches, InitFrames" );
 	
 	//JEB Init the LaunchURLHandler
 	if ( not gErrorCode )
@@ -653,6 +686,7 @@ main()
 	if ( not gErrorCode )
 		InitSpeech();
 #endif
+	TraceStartupPhase( "InitSpeech" );
 	
 	if ( not gErrorCode )
 		{
@@ -668,6 +702,7 @@ main()
 		
 		// create the text window
 		CreateTextWindow( &gPrefsData.pdTextPos );
+		TraceStartupPhase( "players, inventory and text windows" );
 		
 		// create the game window
 		CreateCLWindow( &gPrefsData.pdGWPos );
@@ -716,6 +751,7 @@ main()
 		else
 			gOpenGLEnable = false;
 #endif	// USE_OPENGL
+		TraceStartupPhase( "the rest of the game window" );
 		}
 	
 	// install app scroll wheel handler
@@ -745,11 +781,16 @@ main()
 	SetCommandQStatus( true );		// cmd-q is enabled until we are connected
 	
 	InstallAutoDownloadHandler();
+	TraceStartupPhase( "InitMacros, InitFriends, handlers" );
+	
+	// the window is ready
+	EndStartupStage();
 	
 	// play the game until the user quits
 	// (This is the "outer" main event loop; there's also an "inner main loop" at PlayGame().
 	// Somehow, these two should be merged.)
-	if ( not gErrorCode )
+	if ( not gErrorCode
+	&&   not gStartupBenchmark )
 		{
 		gDoneFlag = false;
 		
@@ -785,6 +826,12 @@ main()
 	// save the window positions
 	SavePrefsData();
 	
+	// in case the players file is open (or still opening) without our having played
+	DisposePlayers();
+	
+	if ( gStartupBenchmark )
+		ShowStartupTrace();
+	
 	// close the movie file
 	CCLMovie::StopMovie();
 	
@@ -1042,6 +1089,69 @@ DumpImageCounts()
 #endif  // DEBUG_IMAGECOUNT
 
 
+#if DTS_ALLOC_PROFILE
+/*
+**	SetAllocProfileLogInterval()
+**
+**	start (or, if seconds is 0, stop) appending a heap-profile snapshot
+**	to "CL_AllocProfile.txt" every so often.
+*/
+void
+SetAllocProfileLogInterval( int seconds )
+{
+	if ( seconds < 0 )
+		seconds = 0;
+	gAllocProfileInterval = seconds;
+	
+	// first snapshot at the next idle; it also marks the start of the first interval
+	gAllocProfileNextTime = GetFrameCounter();
+}
+
+
+/*
+**	GetAllocProfileLogInterval()
+*/
+int
+GetAllocProfileLogInterval()
+{
+	return gAllocProfileInterval;
+}
+
+
+/*
+**	IdleAllocProfile()
+**
+**	append a snapshot to the profile log, if one is due
+*/
+void
+IdleAllocProfile()
+{
+	if ( gAllocProfileInterval <= 0 )
+		return;
+	
+	ulong now = GetFrameCounter();
+	if ( long( now - gAllocProfileNextTime ) < 0 )
+		return;
+	gAllocProfileNextTime = now + gAllocProfileInterval * 60;
+	
+	DTSFileSpec spec;
+	spec.GetCurDir();
+	spec.SetFileName( "CL_AllocProfile.txt" );
+	
+	if ( FILE * stream = spec.fopen( "a" ) )
+		{
+		AllocProfileWrite( stream );
+		fclose( stream );
+		}
+	else
+		{
+		// don't keep trying, once a second, to write where we can't
+		gAllocProfileInterval = 0;
+		}
+}
+#endif  // DTS_ALLOC_PROFILE
+
+
 /*
 **	SendPlyrCommand()
 **
@@ -1583,7 +1693,7 @@ CLMenu::ToggleTextLog()
 **
 **	queue up a Join command request
 */
-static OSStatus
+OSStatus
 PerformAutoJoin()
 {
 	HICommandExtended cmd;
@@ -1815,6 +1925,20 @@ CLApp::Idle()
 		IdleSpeech();
 #endif	// USE_SPEECH
 	
+#if DTS_ALLOC_PROFILE
+	// save heap statistics, if asked to
+	IdleAllocProfile();
+#endif
+	
+	// and network statistics
+	gNetStats.Idle();
+	
+	// and write out any saved players
+	IdlePlayers();
+	
+	// and check the images file in the background
+	IdleVerifiedImages();
+	
 	//	apply cursor change
 	//	flashes a little when user is typing from ObscureCursor() call
 	//  (there's gotta be a better way to do this)
@@ -2437,6 +2561,9 @@ struct PrefsData_40
 #define pref_OpenGLEffects		CFSTR("UseGLEffects")			// bool: pdOpenGLEnableEffects
 #define pref_OpenGLRenderer		CFSTR("OpenGLRenderer")			// integer: pdOpenGLRenderer
 
+#define pref_SmoothMotion		CFSTR("SmoothMotion")			// bool: pdSmoothMotion
+#define pref_SmoothLatency		CFSTR("SmoothMotionLatency")	// integer: pdSmoothLatency
+
 #define pref_InventoryShortcut	CFSTR("InventoryItemQuickKeys")
 		// dictionary { itemID (&) itemIndex -> character [0-9] }
 
@@ -2813,6 +2940,11 @@ UpdatePrefs()
 				// no change in the prefs structure, but .pdAcctPass and .pdCharPass
 				// get migrated into keychain
 				MovePWsToKeychain();
+			
+			case 52:
+				// added smooth motion
+				gPrefsData.pdSmoothMotion = false;
+				gPrefsData.pdSmoothLatency = CJitterBuffer::kDefaultLatency;
 				
 	/*
 	**	Future cases go here
@@ -3036,6 +3168,10 @@ LoadPrefsAux()
 	Get1Bool( OpenGLEffects,		pdOpenGLEnableEffects );
 	Get1Int( OpenGLRenderer,		pdOpenGLRenderer );
 	
+	Get1Bool( SmoothMotion,			pdSmoothMotion );
+	gPrefsData.pdSmoothLatency = Prefs::GetInt( pref_SmoothLatency,
+									CJitterBuffer::kDefaultLatency );
+	
 	GetInventoryShortcutKeys();
 		
 #undef Get1Bool
@@ -3351,6 +3487,8 @@ PrefsSwapEndian()
 	PSE( gPrefsData.pdNoMovieTextLogs );
 	PSE( gPrefsData.pdBardVolume );
 	PSE( gPrefsData.pdLanguageID );
+	PSE( gPrefsData.pdSmoothMotion );
+	PSE( gPrefsData.pdSmoothLatency );
 }
 
 #undef PSE
@@ -3440,6 +3578,9 @@ SavePrefsAux()
 	Set1Bool( OpenGLEffects, pdOpenGLEnableEffects );
 	Set1Pref( OpenGLRenderer, pdOpenGLRenderer );
 	
+	Set1Bool( SmoothMotion, pdSmoothMotion );
+	Set1Pref( SmoothLatency, pdSmoothLatency );
+	
 	SaveInventoryShortcutKeys();
 		
 #undef Set1Bool
@@ -3644,6 +3785,10 @@ DoJoin()
 		return;
 		}
 
+	// the loopback server takes anyone
+	if ( GetLoopbackPort() )
+		PlayGame();
+	else
 	if ( gPrefsData.pdCharName[0] == '\0' )
 		DoSelect();
 	else
@@ -3679,9 +3824,12 @@ PlayGame()
 	if ( gPlayingGame )
 		return;
 	gPlayingGame = true;
+	
+	BeginStartupStage( kStartupJoin );
 
 	// check some commonly modified images
 	DTSError result = ChecksumUsualSuspects();
+	TraceStartupPhase( "ChecksumUsualSuspects" );
 	if ( noErr != result )
 		return;
 	
@@ -3694,14 +3842,17 @@ PlayGame()
 	ClearSendString( gCommandNumber );
 	
 	InitGameState();
+	TraceStartupPhase( "InitGameState" );
 	
 	// clear the click toggle state
 	gClickState = 0;
 	
 	// initialize the sound
 	CLInitSound();
+	TraceStartupPhase( "CLInitSound" );
 	
 	InitPlayers();
+	TraceStartupPhase( "InitPlayers" );
 	
 	// read saved friends
 	ReadFriends( gPrefsData.pdCharName );
@@ -3715,17 +3866,24 @@ PlayGame()
 		StartTextLog( );
 		}
 	
+	TraceStartupPhase( "ReadFriends, StartTextLog" );
+	
 	if ( CCLMovie::IsReading() ) 	// Initialize the client for movie
+		{
 		result = InitReadMovie();
+		TraceStartupPhase( "InitReadMovie" );
+		}
 	else
 		{
 		// initialize the communications
 		result = InitComm();
+		TraceStartupPhase( "InitComm" );
 		
 #if USE_MACRO_FOLDER
 		// initialize macros
 		if ( noErr == result )
 			InitMacros();
+		TraceStartupPhase( "InitMacros" );
 #endif	// USE_MACRO_FOLDER
 		
 		// set cmd-q menu status by prefs
@@ -3743,6 +3901,10 @@ PlayGame()
 # endif // DEBUG_VERSION
 #endif // MULTILINGUAL
 	
+	// we're in
+	if ( noErr == result )
+		EndStartupStage();
+	
 	// play the game
 	if ( noErr == result )
 		{
@@ -4015,8 +4177,339 @@ AllocDescTable()
 {
 	DescTable * table = NEW_TAG("DescTable") DescTable[ kDescTableSize ];
 	CheckPointer( table );
+	char * text = NEW_TAG("DescTable") char[ kDescTableSize * kMaxDescTextLength ];
+	CheckPointer( text );
+	int32_t * counters = NEW_TAG("DescTable") int32_t[ kDescTableSize ];
+	CheckPointer( counters );
+	
+	gDescTable			= table;
+	gDescBubbleText		= text;
+	gDescBubbleCounter	= counters;
 	
-	gDescTable = table;
+	ClearDescTable();
+}
+
+
+/*
+**	ClearDescTable()
+**
+**	forget every descriptor
+*/
+void
+ClearDescTable()
+{
+	bzero( gDescTable, kDescTableSize * sizeof *gDescTable );
+	bzero( gDescBubbleText, kDescTableSize * kMaxDescTextLength );
+	bzero( gDescBubbleCounter, kDescTableSize * sizeof *gDescBubbleCounter );
+}
+
+
+/*
+**	DescToRecord()
+**
+**	gather a descriptor's scattered parts into the form movies store.
+**	The pointers don't mean anything outside this session, so they're left out;
+**	so is the bubble text, which movies store separately.
+*/
+void
+DescToRecord( const DescTable * desc, DescRecord * oRec )
+{
+	bzero( oRec, offsetof( DescRecord, descBubbleText ) );
+	
+	oRec->descID				= desc->descID;
+	oRec->descCacheID			= desc->descCacheID;
+	oRec->descSize				= desc->descSize;
+	oRec->descType				= desc->descType;
+	oRec->descBubbleType		= desc->descBubbleType;
+	oRec->descBubbleLanguage	= desc->descBubbleLanguage;
+	oRec->descBubbleCounter		= desc->BubbleCounter();
+	oRec->descBubblePos			= desc->descBubblePos;
+	oRec->descBubbleLastPos		= desc->descBubbleLastPos;
+	oRec->descBubbleBox			= desc->descBubbleBox;
+	oRec->descNumColors			= desc->descNumColors;
+	oRec->descBubbleLoc			= desc->descBubbleLoc;
+	memcpy( oRec->descColors, desc->descColors, sizeof oRec->descColors );
+	memcpy( oRec->descName, desc->descName, sizeof oRec->descName );
+	oRec->descLastDstBox		= desc->descLastDstBox;
+#ifdef AUTO_HIDENAME
+	oRec->descSeenFrame			= desc->descSeenFrame;
+	oRec->descNameVisible		= desc->descNameVisible;
+#endif
+}
+
+
+/*
+**	RecordToDesc()
+**
+**	the reverse: scatter a stored descriptor into gDescTable and friends.
+**	The pointers are cleared, and the bubble text is left alone.
+*/
+void
+RecordToDesc( const DescRecord * rec, DescTable * desc )
+{
+	desc->descID				= rec->descID;
+	desc->descCacheID			= rec->descCacheID;
+	desc->descMobile			= nullptr;
+	desc->descSize				= rec->descSize;
+	desc->descType				= rec->descType;
+	desc->descBubbleType		= rec->descBubbleType;
+	desc->descBubbleLanguage	= rec->descBubbleLanguage;
+	desc->BubbleCounter()		= rec->descBubbleCounter;
+	desc->descBubblePos			= rec->descBubblePos;
+	desc->descBubbleLastPos		= rec->descBubbleLastPos;
+	desc->descBubbleBox			= rec->descBubbleBox;
+	desc->descNumColors			= rec->descNumColors;
+	desc->descBubbleLoc			= rec->descBubbleLoc;
+	memcpy( desc->descColors, rec->descColors, sizeof desc->descColors );
+	memcpy( desc->descName, rec->descName, sizeof desc->descName );
+	desc->descLastDstBox		= rec->descLastDstBox;
+	desc->descPlayerRef			= nullptr;
+#ifdef AUTO_HIDENAME
+	desc->descSeenFrame			= rec->descSeenFrame;
+	desc->descNameVisible		= rec->descNameVisible;
+#endif
+}
+
+
+/*
+**	WalkDescRecords()
+**
+**	what one redraw and one drawstate do to the descriptors, more or less,
+**	done to the old single-record layout
+*/
+static int
+WalkDescRecords( DescRecord * table, const int * mobiles, int numMobiles,
+				 const DTSPoint * where, int frame )
+{
+	int found = 0;
+	
+	// DrawBubbles(): find the oldest bubble younger than some age, over every descriptor
+	int skip = frame % 40;
+	int oldest = INT_MAX;
+	for ( int index = 0;  index < kDescTableSize;  ++index )
+		{
+		int counter = table[ index ].descBubbleCounter;
+		if ( counter > skip && counter < oldest )
+			oldest = counter;
+		}
+	found += oldest;
+	
+	// LocateMobileByPoint(): kind and box, in reverse order
+	for ( int nnn = numMobiles - 1;  nnn >= 0;  --nnn )
+		{
+		const DescRecord * desc = table + mobiles[ nnn ];
+		if ( desc->descType != kDescPlayer )
+			continue;
+		DTSRect box = desc->descLastDstBox;
+		box.rectBottom += 14;
+		if ( where->InRect( &box ) )
+			{
+			++found;
+			break;
+			}
+		}
+	
+	// ExtractDescriptors(): is each one new?
+	for ( int nnn = 0;  nnn < numMobiles;  ++nnn )
+		{
+		const DescRecord * desc = table + mobiles[ nnn ];
+		if ( desc->descID != mobiles[ nnn ]
+		||   desc->descNumColors != 0
+		||   '?' == desc->descName[ 0 ] )
+			{
+			++found;
+			}
+		}
+	
+	// DrawNames(): the type, whether there's a name at all, and the auto-hide countdown
+	for ( int nnn = 0;  nnn < numMobiles;  ++nnn )
+		{
+		DescRecord * desc = table + mobiles[ nnn ];
+		if ( kDescMonster == desc->descType
+		||   0 == desc->descName[ 0 ] )
+			{
+			continue;
+			}
+#ifdef AUTO_HIDENAME
+		if ( desc->descSeenFrame <= frame )
+			desc->descSeenFrame = frame + 1;
+		if ( kName_Hidden == desc->descNameVisible )
+			continue;
+#endif
+		++found;
+		}
+	
+	return found;
+}
+
+
+/*
+**	WalkDescTable()
+**
+**	the same, done to gDescTable as it is now
+*/
+static int
+WalkDescTable( const int * mobiles, int numMobiles, const DTSPoint * where, int frame )
+{
+	int found = 0;
+	
+	int skip = frame % 40;
+	int oldest = INT_MAX;
+	const int32_t * counters = gDescBubbleCounter;
+	for ( int index = 0;  index < kDescTableSize;  ++index )
+		{
+		int counter = counters[ index ];
+		if ( counter > skip && counter < oldest )
+			oldest = counter;
+		}
+	found += oldest;
+	
+	for ( int nnn = numMobiles - 1;  nnn >= 0;  --nnn )
+		{
+		const DescTable * desc = gDescTable + mobiles[ nnn ];
+		if ( desc->descType != kDescPlayer )
+			continue;
+		DTSRect box = desc->descLastDstBox;
+		box.rectBottom += 14;
+		if ( where->InRect( &box ) )
+			{
+			++found;
+			break;
+			}
+		}
+	
+	for ( int nnn = 0;  nnn < numMobiles;  ++nnn )
+		{
+		const DescTable * desc = gDescTable + mobiles[ nnn ];
+		if ( desc->descID != mobiles[ nnn ]
+		||   desc->descNumColors != 0
+		||   '?' == desc->descName[ 0 ] )
+			{
+			++found;
+			}
+		}
+	
+	for ( int nnn = 0;  nnn < numMobiles;  ++nnn )
+		{
+		DescTable * desc = gDescTable + mobiles[ nnn ];
+		if ( kDescMonster == desc->descType
+		||   0 == desc->descName[ 0 ] )
+			{
+			continue;
+			}
+#ifdef AUTO_HIDENAME
+		if ( desc->descSeenFrame <= frame )
+			desc->descSeenFrame = frame + 1;
+		if ( kName_Hidden == desc->descNameVisible )
+			continue;
+#endif
+		++found;
+		}
+	
+	return found;
+}
+
+
+/*
+**	DescTableBenchmark()
+**
+**	time the descriptor loops over a crowded, made-up scene, laid out both ways:
+**	over and over, with everything in the cache; and then, more realistically,
+**	after something else (standing in for drawing the field) has pushed it all out.
+**	The real table is set aside meanwhile, and put back afterward.
+*/
+void
+DescTableBenchmark( int rounds, SDescBenchmark * oResult )
+{
+	enum { kEvictSize = 8 * 1024 * 1024 };		// bigger than any cache
+	
+	bzero( oResult, sizeof *oResult );
+	oResult->dbRounds		= rounds;
+	oResult->dbColdRounds	= rounds / 100 + 1;
+	
+	DescTable * savedTable		= gDescTable;
+	char * savedText			= gDescBubbleText;
+	int32_t * savedCounters		= gDescBubbleCounter;
+	
+	AllocDescTable();
+	DescRecord * records = NEW_TAG("DescTable") DescRecord[ kDescTableSize ];
+	CheckPointer( records );
+	uchar * evict = NEW_TAG("DescTable") uchar[ kEvictSize ];
+	CheckPointer( evict );
+	bzero( evict, kEvictSize );
+	
+	// scatter the mobiles around the table; one in five is talking
+	int mobiles[ kDescBenchmarkMobiles ];
+	for ( int nnn = 0;  nnn < kDescBenchmarkMobiles;  ++nnn )
+		{
+		int index = (nnn * 97) % kDescTableBaseSize;
+		mobiles[ nnn ] = index;
+		
+		DescTable * desc = gDescTable + index;
+		desc->descID	= index;
+		desc->descType	= (nnn & 1) ? kDescPlayer : kDescMonster;
+		desc->descLastDstBox.Set( nnn * 4, nnn * 2, nnn * 4 + 32, nnn * 2 + 32 );
+#ifdef AUTO_HIDENAME
+		desc->descNameVisible = kName_Visible;
+#endif
+		snprintf( desc->descName, sizeof desc->descName, "Mobile %d", nnn );
+		if ( 0 == nnn % 5 )
+			{
+			desc->BubbleCounter() = 1 + nnn % 40;
+			snprintf( desc->BubbleText(), kMaxDescTextLength, "Hello from %d.", nnn );
+			}
+		}
+	for ( int index = 0;  index < kDescTableSize;  ++index )
+		{
+		DescToRecord( gDescTable + index, records + index );
+		memcpy( records[ index ].descBubbleText, gDescTable[ index ].BubbleText(),
+			sizeof records[ index ].descBubbleText );
+		}
+	
+	// a click that misses everything, so the search goes the whole way
+	DTSPoint where;
+	where.Set( -100, -100 );
+	
+	int found = 0;
+	EventTime start = GetCurrentEventTime();
+	for ( int round = 0;  round < rounds;  ++round )
+		found += WalkDescRecords( records, mobiles, kDescBenchmarkMobiles, &where, round );
+	oResult->dbWarmRecord = GetCurrentEventTime() - start;
+	
+	start = GetCurrentEventTime();
+	for ( int round = 0;  round < rounds;  ++round )
+		found -= WalkDescTable( mobiles, kDescBenchmarkMobiles, &where, round );
+	oResult->dbWarmTable = GetCurrentEventTime() - start;
+	
+	// only the walks are timed, not the evictions
+	for ( int round = 0;  round < oResult->dbColdRounds;  ++round )
+		{
+		for ( int offset = 0;  offset < kEvictSize;  offset += 64 )
+			++evict[ offset ];
+		start = GetCurrentEventTime();
+		found += WalkDescRecords( records, mobiles, kDescBenchmarkMobiles, &where, round );
+		oResult->dbColdRecord += GetCurrentEventTime() - start;
+		
+		for ( int offset = 0;  offset < kEvictSize;  offset += 64 )
+			++evict[ offset ];
+		start = GetCurrentEventTime();
+		found -= WalkDescTable( mobiles, kDescBenchmarkMobiles, &where, round );
+		oResult->dbColdTable += GetCurrentEventTime() - start;
+		}
+	
+	// both ways had better agree
+	if ( found )
+		GenericError( _(TXTCL_CMD_BENCHMARK_DESCTABLE_DIFFER), found );
+	
+	delete[] evict;
+	delete[] records;
+	delete[] gDescTable;
+	delete[] gDescBubbleText;
+	delete[] gDescBubbleCounter;
+	gDescTable			= savedTable;
+	gDescBubbleText		= savedText;
+	gDescBubbleCounter	= savedCounters;
+	InvalidateMobileHits();
 }
 
 
@@ -5097,6 +5590,10 @@ NetStatsDlg::Update()
 	gLatencyRecorder.GetStats( sLat, mLat );
 	snprintf( buff, sizeof buff, "%g ms", int(sLat * 5) / 10.0 );
 	SetText( Item( nsdSampleLatency ), buff );
+	
+	// the median, rather than the mean, so one bad stall doesn't skew it forever
+	if ( gNetStats.GetRTTHistogram().GetCount() )
+		mLat = gNetStats.GetRTTHistogram().GetPercentile( 50 );
 	snprintf( buff, sizeof buff, "%g ms", int(mLat * 5) / 10.0 );
 	SetText( Item( nsdMeanLatency ), buff );
 }
@@ -5164,11 +5661,15 @@ LatencyRecorder::Calc1Latency( int sampleIndex, CFAbsoluteTime when )
 	CmdAckRecord * car = &ackTimes[ sampleIndex ];
 	
 	// convert to milliseconds
-	uint latency = (when - car->carTimestamp) * 1000;
+	double ms = (when - car->carTimestamp) * 1000;
+	uint latency = ms;
 	car->carLatency = latency;
 	
 	++mNumLatencySamples;
 	mTotalLatency += latency;
+	
+	// and let the telemetry keep the whole distribution
+	gNetStats.RecordRTT( ms );
 }
 
 
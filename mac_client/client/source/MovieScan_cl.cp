@@ -0,0 +1,204 @@
+/*
+**	MovieScan_cl.cp		ClanLord
+** 
+**	Copyright 2023 Delta Tao Software, Inc.
+** 
+**	Licensed under the Apache License, Version 2.0 (the "License");
+**	you may not use this file except in compliance with the License.
+**	You may obtain a copy of the License at
+** 
+**     https://www.apache.org/licenses/LICENSE-2.0
+** 
+**	Unless required by applicable law or agreed to in writing, software
+**	distributed under the License is distributed on an "AS IS" BASIS,
+**	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+**	See the License for the specific language governing permissions and
+**	imitations under the License.
+*/
+
+/*
+**	reading recorded movies, for the command-line tools; see MovieScan_cl.h
+*/
+
+#ifndef _dtslib2_
+# include "Prefix_dts.h"
+#endif
+
+#include "Public_cl.h"
+#include "MovieScan_cl.h"
+
+using std::fprintf;
+
+
+/*
+**	ReadMovieFile()
+**
+**	read the whole movie into a new[] block, and check its header.
+**	Problems are reported on stderr.
+*/
+DTSError
+ReadMovieFile( const char * path, uchar ** oData, size_t * oSize )
+{
+	*oData = nullptr;
+	*oSize = 0;
+	
+	FILE * stream = std::fopen( path, "rb" );
+	if ( not stream )
+		{
+		fprintf( stderr, "Can't open %s.\n", path );
+		return fnfErr;
+		}
+	
+	DTSError result = noErr;
+	long fileSize = -1;
+	if ( 0 == std::fseek( stream, 0, SEEK_END ) )
+		fileSize = std::ftell( stream );
+	std::rewind( stream );
+	if ( fileSize <= 0 )
+		result = ioErr;
+	
+	size_t size = 0;
+	uchar * data = nullptr;
+	if ( noErr == result )
+		{
+		size = fileSize;
+		data = NEW_TAG("MovieFile") uchar[ size ];
+		if ( not data )
+			result = memFullErr;
+		}
+	if ( noErr == result
+	&&   size != std::fread( data, 1, size, stream ) )
+		{
+		result = ioErr;
+		}
+	std::fclose( stream );
+	
+	if ( noErr != result )
+		fprintf( stderr, "Can't read %s: error %d.\n", path, (int) result );
+	
+	// check the file header
+	if ( noErr == result
+	&&   ( size < 8  ||  kMovieSignature != Peek32( data ) ) )
+		{
+		fprintf( stderr, "%s isn't a ClanLord movie.\n", path );
+		result = paramErr;
+		}
+	if ( noErr == result )
+		{
+		int version = int16_t( Peek16( data + 4 ) );
+		if ( version < kMovieFirstVersion )
+			{
+			fprintf( stderr, "%s is too old (v%d); v%d or later, please.\n",
+				path, version, kMovieFirstVersion );
+			result = paramErr;
+			}
+		}
+	
+	if ( noErr != result )
+		{
+		delete[] data;
+		return result;
+		}
+	
+	*oData = data;
+	*oSize = size;
+	return noErr;
+}
+
+
+/*
+**	ScanMovieFrames()
+**
+**	walk the frames of a movie read by ReadMovieFile(), handing each to proc.
+**	Pseudo-frames have payloads of their own devising, so their length is taken
+**	to be whatever lies before the next frame's header. Return the number of
+**	regular frames.
+*/
+int
+ScanMovieFrames( const uchar * data, size_t size, MovieFrameProc proc, void * refCon )
+{
+	size_t pos = Peek16( data + 6 );	// header length
+	int count = 0;
+	
+	while ( pos + kMovieFrameHeadLen <= size )
+		{
+		const uchar * head = data + pos;
+		if ( kMovieSignature != Peek32( head ) )
+			{
+			fprintf( stderr, "Movie is damaged at offset %lu; stopping there.\n",
+				(ulong) pos );
+			break;
+			}
+		
+		SMovieFrame frame;
+		frame.mfFrame	= int32_t( Peek32( head + 4 ) );
+		frame.mfSize	= Peek16( head + 8 );
+		frame.mfFlags	= Peek16( head + 10 );
+		pos += kMovieFrameHeadLen;
+		frame.mfData	= data + pos;
+		
+		if ( frame.mfFlags & kMovieFlagPseudo )
+			{
+			size_t next = FindMovieFrameHead( data, size, pos, frame.mfFrame + 1 );
+			frame.mfSize = next - pos;
+			proc( frame, refCon );
+			pos = next;
+			continue;
+			}
+		
+		if ( pos + frame.mfSize > size  ||  frame.mfSize < sizeof(uint16_t) )
+			break;
+		proc( frame, refCon );
+		++count;
+		pos += frame.mfSize;
+		}
+	
+	return count;
+}
+
+
+/*
+**	FindMovieFrameHead()
+**
+**	return the offset of the header of the given frame, at or after pos;
+**	or the end of the movie, if there isn't one
+*/
+size_t
+FindMovieFrameHead( const uchar * data, size_t size, size_t pos, int32_t frame )
+{
+	for ( ;  pos + kMovieFrameHeadLen <= size;  ++pos )
+		{
+		if ( kMovieSignature == Peek32( data + pos )
+		&&   frame == int32_t( Peek32( data + pos + 4 ) ) )
+			{
+			return pos;
+			}
+		}
+	return size;
+}
+
+
+#pragma mark -
+
+/*
+**	ShowMessage()
+**	VShowMessage()
+**
+**	the shared utilities complain through these
+*/
+void
+ShowMessage( const char * format, ... )
+{
+	va_list params;
+	va_start( params, format );
+	VShowMessage( format, params );
+	va_end( params );
+}
+
+
+void
+VShowMessage( const char * format, va_list params )
+{
+	std::vfprintf( stderr, format, params );
+	fprintf( stderr, "\n" );
+}
@@ -0,0 +1,91 @@
+/*
+**	MovieScan_cl.h		ClanLord
+** 
+**	Copyright 2023 Delta Tao Software, Inc.
+** 
+**	Licensed under the Apache License, Version 2.0 (the "License");
+**	you may not use this file except in compliance with the License.
+**	You may obtain a copy of the License at
+** 
+**     https://www.apache.org/licenses/LICENSE-2.0
+** 
+**	Unless required by applicable law or agreed to in writing, software
+**	distributed under the License is distributed on an "AS IS" BASIS,
+**	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+**	See the License for the specific language governing permissions and
+**	imitations under the License.
+*/
+
+#ifndef MOVIESCAN_CL_H
+#define MOVIESCAN_CL_H
+
+//
+// Movie reading for the command-line tools (CLLoopbackServer, CLImagesRepack).
+//
+// They don't link the client's Movie_cl.cp, which plays a movie into the game
+// window; they just want the file in memory and its frames one by one. The whole
+// file is read at once, and walked with big-endian peeks, so nothing here cares
+// about alignment or the host's byte order. MovieScan_cl.cp also supplies the
+// ShowMessage() that the shared utilities complain through, on stderr.
+//
+
+// movie file format; see Movie_cl.h
+const uint32_t	kMovieSignature		= 0xdeadbeef;
+const size_t	kMovieFrameHeadLen	= 12;
+const size_t	kMovieGameStateLen	= 6 * sizeof(int32_t);
+const int		kMovieFirstVersion	= 367;		// picture format changed in v366
+enum
+{
+	kMovieFlagMobileData	= 0x02,
+	kMovieFlagGameState		= 0x04,
+	kMovieFlagPictureTable	= 0x08,
+	kMovieFlagPseudo		= kMovieFlagMobileData | kMovieFlagGameState
+								| kMovieFlagPictureTable
+};
+
+// one frame, as ScanMovieFrames() finds it
+struct SMovieFrame
+{
+	int32_t			mfFrame;
+	uint			mfFlags;		// kMovieFlagXXX
+	const uchar *	mfData;			// the payload: a server message, unless pseudo
+	size_t			mfSize;			// for pseudo-frames, up to the next frame header
+};
+
+typedef void (*MovieFrameProc)( const SMovieFrame& frame, void * refCon );
+
+DTSError	ReadMovieFile( const char * path, uchar ** oData, size_t * oSize );
+int			ScanMovieFrames( const uchar * data, size_t size,
+				MovieFrameProc proc, void * refCon );
+size_t		FindMovieFrameHead( const uchar * data, size_t size, size_t pos, int32_t frame );
+
+
+/*
+**	Peek16(), Peek32(), Poke32()
+**
+**	big-endian, unaligned
+*/
+inline uint
+Peek16( const uchar * p )
+{
+	return (p[0] << 8) | p[1];
+}
+
+
+inline uint32_t
+Peek32( const uchar * p )
+{
+	return (uint32_t( p[0] ) << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+
+inline void
+Poke32( uchar * p, uint32_t value )
+{
+	p[0] = uchar( value >> 24 );
+	p[1] = uchar( value >> 16 );
+	p[2] = uchar( value >>  8 );
+	p[3] = uchar( value );
+}
+
+#endif  // MOVIESCAN_CL_H
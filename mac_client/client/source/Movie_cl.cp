@@ -113,6 +113,7 @@ CCLMovie::Open( bool inWriteMode )
 		
 		// we could maybe read game state data here..
 		gNumMobiles	= 0;	// needed anyway
+		InvalidateMobileHits();
 		
 		// don't read old movies, because
 		// descriptor records changed format in v97.x and again in v105.x
@@ -431,11 +432,11 @@ CCLMovie::SwapEndian( DSMobile& m )
 
 
 /*
-**	CCLMovie::SwapEndian( DescTable )
+**	CCLMovie::SwapEndian( DescRecord )
 **	byteswap a descriptor
 */
 void
-CCLMovie::SwapEndian( DescTable& d )
+CCLMovie::SwapEndian( DescRecord& d )
 {
 	SE( d.descID );
 	SE( d.descCacheID );
@@ -646,9 +647,8 @@ CCLMovie::SaveMobileTable()
 	
 	int mobileCounter = 0;
 	DTSError err = noErr;
-	const size_t maxWriteSize = sizeof(DSMobile) + sizeof(DescTable);
-//	const size_t minDescSize = (gDescTable[0].descBubbleText - (char*)&gDescTable[0]);
-	const size_t minDescSize = offsetof(DescTable, descBubbleText);
+	const size_t maxWriteSize = sizeof(DSMobile) + sizeof(DescRecord);
+	const size_t minDescSize = offsetof(DescRecord, descBubbleText);
 	
 	//
 	// We first save the descriptor pointed to by a Mobile. To be sure,
@@ -673,7 +673,7 @@ CCLMovie::SaveMobileTable()
 			const DSMobile * mob = &gDSMobile[ mobileCounter ];
 			const DescTable * desc = &gDescTable[ mob->dsmIndex ];
 			
-			int16_t bubbleLen = desc->descBubbleCounter ? std::strlen( desc->descBubbleText ) : 0;
+			int16_t bubbleLen = desc->BubbleCounter() ? std::strlen( desc->BubbleText() ) : 0;
 			
 			// Write mobile
 #if DTS_BIG_ENDIAN
@@ -687,15 +687,14 @@ CCLMovie::SaveMobileTable()
 #endif
 			
 			// We write the first part of the descriptor, without the bubble text
-#if DTS_BIG_ENDIAN
-			err	= Write( desc, minDescSize );
-#else
 			{
-			DescTable td = *desc;
+			DescRecord td;
+			DescToRecord( desc, &td );
+#if DTS_LITTLE_ENDIAN
 			SwapEndian( td );
+#endif
 			err = Write( &td, minDescSize );
 			}
-#endif
 			
 			// If the bubble text is relevant, we write it, with its length
 			if ( noErr == err && bubbleLen )
@@ -708,7 +707,7 @@ CCLMovie::SaveMobileTable()
 #endif  // DTS_BIG_ENDIAN
 				
 				if ( noErr == err )
-					err = Write( desc->descBubbleText, bubbleLen );
+					err = Write( desc->BubbleText(), bubbleLen );
 				}
 			
 			// keep tabs of how much we wrote
@@ -765,23 +764,22 @@ CCLMovie::SaveMobileTable()
 				// OK, we found one worth saving
 				if ( save )
 					{
-					int16_t bubbleLen = desc->descBubbleCounter
-						? std::strlen(desc->descBubbleText) : 0;
+					int16_t bubbleLen = desc->BubbleCounter()
+						? std::strlen(desc->BubbleText()) : 0;
 					int32_t counter = NativeToBigEndian( descCounter + kDescTableSize );
 					
 					// Write mobile
 					/* err = */ Write( &counter, sizeof counter );
 					
 					// We write the first part of the descriptor, without the bubble text
-#if DTS_BIG_ENDIAN
-					err	= Write( desc, minDescSize );
-#else
 					{
-					DescTable td = *desc;
+					DescRecord td;
+					DescToRecord( desc, &td );
+#if DTS_LITTLE_ENDIAN
 					SwapEndian( td );
+#endif
 					err = Write( &td, minDescSize );
 					}
-#endif  // DTS_BIG_ENDIAN
 					
 					// If the bubble text is relevant, we write it, with its length
 					if ( noErr == err && bubbleLen )
@@ -794,7 +792,7 @@ CCLMovie::SaveMobileTable()
 #endif  // DTS_BIG_ENDIAN
 						
 						if ( noErr == err )
-							err = Write( desc->descBubbleText, bubbleLen );
+							err = Write( desc->BubbleText(), bubbleLen );
 						}
 					// I think this is wrong:
 //					maxSize -= sizeof(DSMobile) + minDescSize + bubbleLen;
@@ -877,33 +875,37 @@ CCLMovie::ReadMobileTable()
 		
 		// we read the remainder of the descriptor
 		DescTable * desc = &gDescTable[ descIndex ];
+		DescRecord rec;
 		if ( noErr == err )
 			{
 			// handle old descriptors
-			err = Read1Descriptor( desc );
+			err = Read1Descriptor( &rec );
 			}
 		
 		if ( noErr == err )
 			{
 			// first, let's clean it properly
+			// (this also clears the pointers)
+			RecordToDesc( &rec, desc );
 			desc->descCacheID	= 0;
-			desc->descPlayerRef	= nullptr;
-			desc->descMobile	= nullptr;
 			
 			// now read the bubble text, if any
-			if ( desc->descBubbleCounter )
+			if ( desc->BubbleCounter() )
 				{
 				int16_t bubbleLen = 0;
 				err = Read( &bubbleLen, sizeof bubbleLen );
 				if ( noErr == err )
 					{
 					bubbleLen = BigToNativeEndian( bubbleLen );
-					err	= Read( desc->descBubbleText, bubbleLen );
+					err	= Read( desc->BubbleText(), bubbleLen );
 					}
 				}
 			}
 		} while ( noErr == err && descIndex != -1 );
 	
+	// every mobile and its box may have changed
+	InvalidateMobileHits();
+	
 	return err;
 }
 
@@ -917,10 +919,10 @@ CCLMovie::ReadMobileTable()
 **	current format, whatever it might be.
 */
 DTSError
-CCLMovie::Read1Descriptor( DescTable * desc )
+CCLMovie::Read1Descriptor( DescRecord * desc )
 {
 	DTSError err = noErr;
-	size_t minDescSize = offsetof(DescTable, descBubbleText);
+	size_t minDescSize = offsetof(DescRecord, descBubbleText);
 	
 	// this is the breakpoint between current and prior versions.
 	// at the time of writing it was equal to: 192
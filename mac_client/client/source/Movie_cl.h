@@ -124,7 +124,7 @@ protected:
 	DTSError				SaveGameState();
 	DTSError				SaveGameStateData();
 	
-	DTSError				Read1Descriptor( DescTable * desc );
+	DTSError				Read1Descriptor( DescRecord * desc );
 	
 	//
 	// Frame delay (pause, play, fast forward) assessors
@@ -218,7 +218,7 @@ static	ulong				sFrameTicks;
 	static void				SwapEndian(	SFrameHead& );
 	static void				SwapEndian(	SFileHead& );
 	static void				SwapEndian( DSMobile& );
-	static void				SwapEndian( DescTable& );
+	static void				SwapEndian( DescRecord& );
 #endif  // DTS_LITTLE_ENDIAN
 };
 
@@ -0,0 +1,560 @@
+/*
+**	NetStats_cl.cp		ClanLord
+** 
+**	Copyright 2023 Delta Tao Software, Inc.
+** 
+**	Licensed under the Apache License, Version 2.0 (the "License");
+**	you may not use this file except in compliance with the License.
+**	You may obtain a copy of the License at
+** 
+**     https://www.apache.org/licenses/LICENSE-2.0
+** 
+**	Unless required by applicable law or agreed to in writing, software
+**	distributed under the License is distributed on an "AS IS" BASIS,
+**	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+**	See the License for the specific language governing permissions and
+**	imitations under the License.
+*/
+
+#include "NetStats_cl.h"
+
+#include <ctime>
+
+#include "ClanLord.h"
+#include "Frame_cl.h"
+
+
+/*
+**	Definitions
+*/
+const double	kMaxFrameInterval	= 2.0;		// seconds; anything longer is a stall
+const double	kJitterGain			= 1.0 / 16;	// as in RFC 3550
+const char		kLogFileName[]		= "CL_NetStats.csv";
+const char		kOldLogFileName[]	= "CL_NetStats.old.csv";
+
+// upper edges of the histogram buckets, in milliseconds
+static const double gBucketLimits[ CNetHistogram::kNumBuckets - 1 ] =
+{
+	10, 20, 30, 40, 50, 60, 70, 80, 90, 100,
+	125, 150, 175, 200, 250, 300, 350, 400,
+	500, 600, 700, 800, 1000, 1250, 1500, 2000, 3000, 5000
+};
+
+
+/*
+**	Internal Routines
+*/
+static int		BurstSize( int frames );
+
+
+/*
+**	Global Variables
+*/
+CNetStats		gNetStats;
+
+
+/*
+**	CNetHistogram::Reset()
+*/
+void
+CNetHistogram::Reset()
+{
+	memset( mBuckets, 0, sizeof mBuckets );
+	mCount	= 0;
+	mSum	= 0;
+	mMin	= 0;
+	mMax	= 0;
+}
+
+
+/*
+**	CNetHistogram::Add()
+** 
+**	count one more sample
+*/
+void
+CNetHistogram::Add( double ms )
+{
+	if ( ms < 0 )
+		ms = 0;
+	
+	int n = 0;
+	while ( n < kNumBuckets - 1
+	&&      ms > gBucketLimits[ n ] )
+		{
+		++n;
+		}
+	++mBuckets[ n ];
+	
+	if ( 0 == mCount || ms < mMin )
+		mMin = ms;
+	if ( ms > mMax )
+		mMax = ms;
+	mSum += ms;
+	++mCount;
+}
+
+
+/*
+**	CNetHistogram::GetBucketLimit()
+** 
+**	the upper edge of a bucket; the last one has none
+*/
+double
+CNetHistogram::GetBucketLimit( int n )
+{
+	if ( n < kNumBuckets - 1 )
+		return gBucketLimits[ n ];
+	return HUGE_VAL;
+}
+
+
+/*
+**	CNetHistogram::GetPercentile()
+** 
+**	estimate the value that pct percent of the samples are at or below,
+**	assuming they're spread evenly across each bucket
+*/
+double
+CNetHistogram::GetPercentile( double pct ) const
+{
+	if ( 0 == mCount )
+		return 0;
+	
+	double target = mCount * pct / 100.0;
+	double below = 0;
+	for ( int n = 0; n < kNumBuckets; ++n )
+		{
+		ulong count = mBuckets[ n ];
+		if ( count
+		&&   below + count >= target )
+			{
+			// the samples can't be outside what we've actually seen
+			double lo = n ? gBucketLimits[ n - 1 ] : 0;
+			double hi = ( n < kNumBuckets - 1 ) ? gBucketLimits[ n ] : mMax;
+			if ( lo < mMin )
+				lo = mMin;
+			if ( hi > mMax )
+				hi = mMax;
+			
+			return lo + ( hi - lo ) * ( target - below ) / count;
+			}
+		below += count;
+		}
+	
+	return mMax;
+}
+
+
+/*
+**	CNetStats::CNetStats()
+*/
+CNetStats::CNetStats() :
+	mOverlay( false ),
+	mLogInterval( 0 ),
+	mNextLogTime( 0 )
+{
+	Reset();
+}
+
+
+/*
+**	CNetStats::Reset()
+** 
+**	start counting again; the overlay and log settings stay as they are
+*/
+void
+CNetStats::Reset()
+{
+	mRTT.Reset();
+	mInterval.Reset();
+	
+	mLastArrival	= 0;
+	mMeanInterval	= 0;
+	mJitter			= 0;
+	mFrames			= 0;
+	
+	mLost			= 0;
+	mLossBursts		= 0;
+	mLongestLoss	= 0;
+	memset( mLossSizes, 0, sizeof mLossSizes );
+	mLate			= 0;
+	mLateBursts		= 0;
+	mLateRun		= 0;
+	mLongestLate	= 0;
+	mDeepestLate	= 0;
+	
+	memset( mSeconds, 0, sizeof mSeconds );
+	mStartTime		= GetCurrentEventTime();
+	mSecond			= long( mStartTime );
+	mTotalIn		= 0;
+	mTotalOut		= 0;
+}
+
+
+/*
+**	CNetStats::Tick()
+** 
+**	move the bytes/sec window up to now, and return the second now filling
+*/
+CNetStats::SSecond&
+CNetStats::Tick( double now )
+{
+	long second = long( now );
+	if ( second - mSecond >= kRateSeconds )
+		{
+		// it's been quiet a while; nothing in the window is recent
+		memset( mSeconds, 0, sizeof mSeconds );
+		mSecond = second;
+		}
+	while ( mSecond < second )
+		{
+		++mSecond;
+		memset( &mSeconds[ mSecond % kRateSeconds ], 0, sizeof mSeconds[0] );
+		}
+	
+	return mSeconds[ mSecond % kRateSeconds ];
+}
+
+
+/*
+**	CNetStats::Count()
+** 
+**	add to the bytes of one kind of traffic
+*/
+CNetStats::SSecond&
+CNetStats::Count( int traffic, size_t bytes )
+{
+	SSecond& s = Tick( GetCurrentEventTime() );
+	s.mBytes[ traffic ] += bytes;
+	
+	return s;
+}
+
+
+/*
+**	CNetStats::RecordRTT()
+** 
+**	a command took this long to be acknowledged
+*/
+void
+CNetStats::RecordRTT( double ms )
+{
+	mRTT.Add( ms );
+}
+
+
+/*
+**	CNetStats::RecordReceived()
+** 
+**	a whole message came in from the server
+*/
+void
+CNetStats::RecordReceived( int tag, size_t bytes )
+{
+	SSecond& s = Count( kMsgDrawState == tag ? kTrafficDrawState : kTrafficOther, bytes );
+	s.mIn += bytes;
+	mTotalIn += bytes;
+}
+
+
+/*
+**	CNetStats::RecordSent()
+** 
+**	a whole message went out to the server
+*/
+void
+CNetStats::RecordSent( int tag, size_t bytes )
+{
+	SSecond& s = Count( kMsgPlayerInput == tag ? kTrafficPlayerInput : kTrafficOther, bytes );
+	s.mOut += bytes;
+	mTotalOut += bytes;
+}
+
+
+/*
+**	CNetStats::RecordFrame()
+** 
+**	a draw state was unpacked. lastAckFrame is the newest one seen before it, or 0;
+**	arrival is when it got here.
+*/
+void
+CNetStats::RecordFrame( const CCLFrame * frame, int lastAckFrame, double arrival )
+{
+	// where the bytes went; they've been counted once already, as a whole message.
+	// The header includes the message tag.
+	Count( kTrafficDrawHeader,	frame->mExtraLen + sizeof(uint16_t) );
+	Count( kTrafficDescriptors,	frame->mDescLen );
+	Count( kTrafficPictures,	frame->mPictLen );
+	Count( kTrafficMobiles,		frame->mMobileLen );
+	Count( kTrafficStateData,	frame->mStateLen );
+	
+	int newAckFrame = frame->mAckFrame;
+	
+	// older than one we've already seen: it's late, or a duplicate
+	if ( lastAckFrame
+	&&   newAckFrame <= lastAckFrame )
+		{
+		++mLate;
+		if ( 0 == mLateRun++ )
+			++mLateBursts;
+		if ( mLateRun > mLongestLate )
+			mLongestLate = mLateRun;
+		if ( lastAckFrame - newAckFrame > mDeepestLate )
+			mDeepestLate = lastAckFrame - newAckFrame;
+		
+		// it says nothing about when the next one's due
+		return;
+		}
+	mLateRun = 0;
+	++mFrames;
+	
+	// a gap: that many were lost, all in one go
+	int lost = lastAckFrame ? newAckFrame - lastAckFrame - 1 : 0;
+	if ( lost > 0 )
+		{
+		mLost += lost;
+		++mLossBursts;
+		++mLossSizes[ BurstSize( lost ) ];
+		if ( lost > mLongestLoss )
+			mLongestLoss = lost;
+		}
+	
+	// the time since the previous frame, shared among any that went missing
+	if ( mLastArrival > 0 )
+		{
+		double interval = arrival - mLastArrival;
+		if ( interval >= 0
+		&&   interval < kMaxFrameInterval )
+			{
+			double ms = interval * 1000 / ( lost > 0 ? lost + 1 : 1 );
+			mInterval.Add( ms );
+			
+			// jitter is the smoothed deviation from the smoothed interval
+			if ( 0 == mMeanInterval )
+				mMeanInterval = ms;
+			double deviation = fabs( ms - mMeanInterval );
+			mJitter			+= ( deviation - mJitter ) * kJitterGain;
+			mMeanInterval	+= ( ms - mMeanInterval ) * kJitterGain;
+			}
+		}
+	mLastArrival = arrival;
+}
+
+
+/*
+**	BurstSize()
+** 
+**	which mLossSizes[] a run of lost frames counts in: 1, 2, 3, 4-7, 8+
+*/
+int
+BurstSize( int frames )
+{
+	if ( frames <= 3 )
+		return frames - 1;
+	if ( frames <= 7 )
+		return 3;
+	return 4;
+}
+
+
+/*
+**	CNetStats::GetStats()
+** 
+**	sum it all up
+*/
+void
+CNetStats::GetStats( SStats * oStats )
+{
+	SStats& st = *oStats;
+	
+	st.mRTTCount	= mRTT.GetCount();
+	st.mRTTMin		= mRTT.GetMin();
+	st.mRTT50		= mRTT.GetPercentile( 50 );
+	st.mRTT90		= mRTT.GetPercentile( 90 );
+	st.mRTT99		= mRTT.GetPercentile( 99 );
+	st.mRTTMax		= mRTT.GetMax();
+	
+	st.mFrames		= mFrames;
+	st.mInterval50	= mInterval.GetPercentile( 50 );
+	st.mInterval99	= mInterval.GetPercentile( 99 );
+	st.mJitter		= mJitter;
+	
+	st.mLost		= mLost;
+	st.mLossBursts	= mLossBursts;
+	st.mLongestLoss	= mLongestLoss;
+	st.mLate		= mLate;
+	st.mLateBursts	= mLateBursts;
+	st.mLongestLate	= mLongestLate;
+	st.mDeepestLate	= mDeepestLate;
+	memcpy( st.mLossSizes, mLossSizes, sizeof st.mLossSizes );
+	
+	// the window is the last few seconds, and whatever of this one has gone by,
+	// but no further back than the last reset
+	double now = GetCurrentEventTime();
+	Tick( now );
+	double start = mSecond - ( kRateSeconds - 1 );
+	if ( start < mStartTime )
+		start = mStartTime;
+	double window = now - start;
+	if ( window < 1.0 )
+		window = 1.0;
+	
+	double in = 0, out = 0;
+	double bytes[ kNumTraffic ] = { 0 };
+	for ( int n = 0; n < kRateSeconds; ++n )
+		{
+		const SSecond& s = mSeconds[ n ];
+		in  += s.mIn;
+		out += s.mOut;
+		for ( int t = 0; t < kNumTraffic; ++t )
+			bytes[ t ] += s.mBytes[ t ];
+		}
+	st.mBytesIn		= in / window;
+	st.mBytesOut	= out / window;
+	for ( int t = 0; t < kNumTraffic; ++t )
+		st.mRate[ t ] = bytes[ t ] / window;
+	
+	st.mTotalIn		= mTotalIn;
+	st.mTotalOut	= mTotalOut;
+}
+
+
+/*
+**	CNetStats::GetTrafficName()
+** 
+**	for the log and \NETSTATS SHOW
+*/
+const char *
+CNetStats::GetTrafficName( int traffic )
+{
+	static const char * const names[ kNumTraffic ] =
+		{
+		"drawstate",
+		"input",
+		"other",
+		"header",
+		"descriptors",
+		"pictures",
+		"mobiles",
+		"state"
+		};
+	
+	if ( traffic >= 0 && traffic < kNumTraffic )
+		return names[ traffic ];
+	return "?";
+}
+
+
+/*
+**	CNetStats::SetLogInterval()
+** 
+**	start (or, if seconds is 0, stop) appending a line to "CL_NetStats.csv"
+**	every so often
+*/
+void
+CNetStats::SetLogInterval( int seconds )
+{
+	if ( seconds < 0 )
+		seconds = 0;
+	mLogInterval = seconds;
+	
+	// first line at the next idle
+	mNextLogTime = 0;
+}
+
+
+/*
+**	CNetStats::Idle()
+** 
+**	append a line to the log, if one is due
+*/
+void
+CNetStats::Idle()
+{
+	if ( mLogInterval <= 0 )
+		return;
+	
+	double now = GetCurrentEventTime();
+	if ( now < mNextLogTime )
+		return;
+	mNextLogTime = now + mLogInterval;
+	
+	WriteLog();
+}
+
+
+/*
+**	CNetStats::WriteLog()
+** 
+**	append a line of the current figures to the CSV log. When the log gets big,
+**	it's renamed "CL_NetStats.old.csv" (replacing any older one), and a new one begun.
+*/
+void
+CNetStats::WriteLog()
+{
+	DTSFileSpec spec;
+	spec.GetCurDir();
+	spec.SetFileName( kLogFileName );
+	
+	FILE * stream = spec.fopen( "a" );
+	long size = 0;
+	if ( stream )
+		{
+		fseek( stream, 0, SEEK_END );
+		size = ftell( stream );
+		if ( size >= kMaxLogSize )
+			{
+			fclose( stream );
+			
+			DTSFileSpec old;
+			old.GetCurDir();
+			old.SetFileName( kOldLogFileName );
+			old.Delete();
+			spec.Rename( kOldLogFileName );
+			
+			spec.SetFileName( kLogFileName );
+			stream = spec.fopen( "w" );
+			size = 0;
+			}
+		}
+	if ( not stream )
+		{
+		// don't keep trying to write where we can't
+		mLogInterval = 0;
+		return;
+		}
+	
+	// a new file gets the column names
+	if ( 0 == size )
+		{
+		fputs( "time,rtt_count,rtt_min,rtt_p50,rtt_p90,rtt_p99,rtt_max,"
+			"frames,interval_p50,interval_p99,jitter,"
+			"lost,loss_bursts,longest_loss,late,late_bursts,longest_late,"
+			"bytes_in_per_sec,bytes_out_per_sec", stream );
+		for ( int t = 0; t < kNumTraffic; ++t )
+			fprintf( stream, ",%s_per_sec", GetTrafficName( t ) );
+		fputc( '\n', stream );
+		}
+	
+	SStats st;
+	GetStats( &st );
+	
+	char when[ 32 ];
+	time_t now = time( nullptr );
+	strftime( when, sizeof when, "%Y-%m-%d %H:%M:%S", localtime( &now ) );
+	
+	fprintf( stream, "%s,%lu,%.1f,%.1f,%.1f,%.1f,%.1f,"
+		"%lu,%.1f,%.1f,%.1f,"
+		"%lu,%lu,%d,%lu,%lu,%d,"
+		"%.0f,%.0f",
+		when, st.mRTTCount, st.mRTTMin, st.mRTT50, st.mRTT90, st.mRTT99, st.mRTTMax,
+		st.mFrames, st.mInterval50, st.mInterval99, st.mJitter,
+		st.mLost, st.mLossBursts, st.mLongestLoss, st.mLate, st.mLateBursts, st.mLongestLate,
+		st.mBytesIn, st.mBytesOut );
+	for ( int t = 0; t < kNumTraffic; ++t )
+		fprintf( stream, ",%.0f", st.mRate[ t ] );
+	fputc( '\n', stream );
+	
+	fclose( stream );
+}
@@ -0,0 +1,196 @@
+/*
+**	NetStats_cl.h		ClanLord
+** 
+**	Copyright 2023 Delta Tao Software, Inc.
+** 
+**	Licensed under the Apache License, Version 2.0 (the "License");
+**	you may not use this file except in compliance with the License.
+**	You may obtain a copy of the License at
+** 
+**     https://www.apache.org/licenses/LICENSE-2.0
+** 
+**	Unless required by applicable law or agreed to in writing, software
+**	distributed under the License is distributed on an "AS IS" BASIS,
+**	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+**	See the License for the specific language governing permissions and
+**	imitations under the License.
+*/
+
+#ifndef NETSTATS_CL_H
+#define NETSTATS_CL_H
+
+class CCLFrame;
+
+
+//
+// A histogram of times, in milliseconds, with fixed buckets: fine-grained at the
+// low end, where a good connection lives, and coarser out to a few seconds.
+// Percentiles are interpolated within a bucket, so they're only as precise as the
+// buckets are narrow -- which is plenty for telling 80 ms from 120 ms.
+//
+class CNetHistogram
+{
+public:
+	enum { kNumBuckets = 29 };		// the last one catches everything past 5 seconds
+	
+	// constructor/destructor
+						CNetHistogram()		{ Reset(); }
+	
+	// interface
+	void				Reset();
+	void				Add( double ms );
+	
+	ulong				GetCount() const	{ return mCount; }
+	double				GetMin() const		{ return mCount ? mMin : 0; }
+	double				GetMax() const		{ return mMax; }
+	double				GetMean() const		{ return mCount ? mSum / mCount : 0; }
+	double				GetPercentile( double pct ) const;
+	
+	ulong				GetBucket( int n ) const	{ return mBuckets[ n ]; }
+	static double		GetBucketLimit( int n );
+
+private:
+	ulong				mBuckets[ kNumBuckets ];
+	ulong				mCount;
+	double				mSum;
+	double				mMin;
+	double				mMax;
+};
+
+
+//
+// Network path telemetry: how long commands take to be acknowledged, how evenly
+// frames arrive, how many get lost or turn up late (and in what sized bunches),
+// and where the bandwidth goes. Fed from Handle1Comm(), SendInput() and
+// ExtractImportantData(); shown by \NETSTATS and its overlay, and logged to
+// "CL_NetStats.csv". Movies aren't counted: they don't come over the network.
+//
+class CNetStats
+{
+public:
+	// what the bytes were
+	enum
+		{
+		kTrafficDrawState,		// whole messages, by tag...
+		kTrafficPlayerInput,
+		kTrafficOther,
+		kTrafficDrawHeader,		// ... and what's inside the draw states
+		kTrafficDescriptors,
+		kTrafficPictures,
+		kTrafficMobiles,
+		kTrafficStateData,
+		kNumTraffic
+		};
+	
+	// sizes of loss bursts: 1, 2, 3, 4-7, 8+ frames
+	enum { kNumBurstSizes = 5 };
+	
+	enum
+		{
+		kRateSeconds		= 10,			// window for the bytes/sec figures
+		kMaxLogSize			= 1024 * 1024	// roll the CSV over at this size
+		};
+	
+	// a summary of it all
+	struct SStats
+		{
+		ulong				mRTTCount;		// command round trips, milliseconds
+		double				mRTTMin;
+		double				mRTT50;
+		double				mRTT90;
+		double				mRTT99;
+		double				mRTTMax;
+		
+		ulong				mFrames;		// draw states received
+		double				mInterval50;	// time between them, milliseconds
+		double				mInterval99;
+		double				mJitter;		// smoothed deviation from the usual interval
+		
+		ulong				mLost;			// frames never seen
+		ulong				mLossBursts;	// runs of them
+		int					mLongestLoss;
+		ulong				mLate;			// frames older than one already seen
+		ulong				mLateBursts;
+		int					mLongestLate;
+		int					mDeepestLate;	// furthest behind a late frame was
+		ulong				mLossSizes[ kNumBurstSizes ];
+		
+		double				mBytesIn;		// per second, over the last kRateSeconds
+		double				mBytesOut;
+		double				mRate[ kNumTraffic ];
+		uint64_t			mTotalIn;		// since the last reset
+		uint64_t			mTotalOut;
+		};
+	
+	// constructor/destructor
+						CNetStats();
+	
+	// interface
+	void				Reset();
+	
+	void				RecordRTT( double ms );
+	void				RecordReceived( int tag, size_t bytes );
+	void				RecordSent( int tag, size_t bytes );
+	void				RecordFrame( const CCLFrame * frame, int lastAckFrame, double arrival );
+	
+	void				GetStats( SStats * oStats );
+	const CNetHistogram&	GetRTTHistogram() const		{ return mRTT; }
+	static const char *	GetTrafficName( int traffic );
+	
+	void				SetOverlay( bool bShow )	{ mOverlay = bShow; }
+	bool				IsOverlayShown() const		{ return mOverlay; }
+	
+	void				SetLogInterval( int seconds );
+	int					GetLogInterval() const		{ return mLogInterval; }
+	void				Idle();
+
+private:
+	struct SSecond
+		{
+		uint				mBytes[ kNumTraffic ];
+		uint				mIn;
+		uint				mOut;
+		};
+	
+	CNetHistogram		mRTT;
+	CNetHistogram		mInterval;
+	
+	double				mLastArrival;	// of the newest frame; or 0
+	double				mMeanInterval;
+	double				mJitter;
+	ulong				mFrames;
+	
+	ulong				mLost;
+	ulong				mLossBursts;
+	int					mLongestLoss;
+	ulong				mLossSizes[ kNumBurstSizes ];
+	ulong				mLate;
+	ulong				mLateBursts;
+	int					mLateRun;		// late frames in a row, so far
+	int					mLongestLate;
+	int					mDeepestLate;
+	
+	SSecond				mSeconds[ kRateSeconds ];
+	long				mSecond;		// the one now filling; whole seconds of event time
+	double				mStartTime;		// when counting started
+	uint64_t			mTotalIn;
+	uint64_t			mTotalOut;
+	
+	bool				mOverlay;
+	int					mLogInterval;	// seconds between CSV lines; 0 = off
+	double				mNextLogTime;
+	
+	SSecond&			Tick( double now );
+	SSecond&			Count( int traffic, size_t bytes );
+	void				WriteLog();
+	
+	// declared but not defined
+						CNetStats( const CNetStats& );
+	CNetStats&			operator=( const CNetStats& );
+};
+
+
+// There's only one!
+extern CNetStats		gNetStats;		// from NetStats_cl.cp
+
+#endif  // NETSTATS_CL_H
@@ -176,6 +176,129 @@ NightInfo::ScanServerMessage( const char * inCommand, size_t inLen )
 }
 
 
+//
+//	What \BENCHMARK REGEXP runs over a text log: the night message, which every
+//	info line is checked for, and a few patterns of the sort people write to pick
+//	things out of chat -- ones that have to look all along each line.
+//
+static const char * const gBenchmarkREs[ kRegExpBenchmarkPatterns ] =
+	{
+	kNightRE,
+	"([A-Za-z]+) (has fallen|is no longer fallen|has logged on)",
+	"^([A-Z][-A-Za-z' ]+) (says|yells|asks|exclaims|thinks),? \"",
+	".*(slaughtered|killed|vanquished|dispatched) .*(Orga|Vermine|Rat)"
+	};
+
+
+/*
+**	RegExpBenchmark()
+**
+**	time each of the patterns above over every line of a text log,
+**	with and without the DFA; and make sure they agree
+*/
+DTSError
+RegExpBenchmark( const char * fname, int rounds, SRegExpBenchmark * oResult )
+{
+	bzero( oResult, sizeof *oResult );
+	oResult->rbRounds = rounds;
+	
+	std::FILE * stream = std::fopen( fname, "rb" );
+	if ( not stream )
+		return fnfErr;
+	
+	// read it all in; a few megabytes is plenty
+	const long kMaxLogBytes = 16 * 1024 * 1024;
+	std::fseek( stream, 0, SEEK_END );
+	long size = std::ftell( stream );
+	std::fseek( stream, 0, SEEK_SET );
+	if ( size > kMaxLogBytes )
+		size = kMaxLogBytes;
+	if ( size < 0 )
+		size = 0;
+	
+	char * text = NEW_TAG("RegExpBenchmark") char[ size + 1 ];
+	CheckPointer( text );
+	size = static_cast<long>( std::fread( text, 1, size, stream ) );
+	std::fclose( stream );
+	text[ size ] = '\0';
+	
+	// chop it into lines, the way the text arrives
+	int numLines = 0;
+	for ( char * p = text;  p < text + size;  ++p )
+		{
+		if ( '\r' == *p || '\n' == *p )
+			*p = '\0';
+		else
+		if ( p == text || '\0' == p[-1] )
+			++numLines;
+		}
+	
+	const char ** lines = NEW_TAG("RegExpBenchmark") const char *[ numLines + 1 ];
+	CheckPointer( lines );
+	numLines = 0;
+	for ( char * p = text;  p < text + size;  ++p )
+		{
+		if ( *p && ( p == text || '\0' == p[-1] ) )
+			lines[ numLines++ ] = p;
+		}
+	oResult->rbLines = numLines;
+	oResult->rbBytes = size;
+	
+	for ( int n = 0;  n < kRegExpBenchmarkPatterns;  ++n )
+		{
+		CHSRegExp dfa( gBenchmarkREs[ n ] );
+		CHSRegExp backtrack( gBenchmarkREs[ n ] );
+		backtrack.setUseDFA( false );
+		oResult->rbPattern[ n ] = gBenchmarkREs[ n ];
+		
+		// first, the answers had better be the same
+		for ( int line = 0;  line < numLines;  ++line )
+			{
+			bool match = dfa.regexec( lines[ line ] );
+			if ( match != backtrack.regexec( lines[ line ] ) )
+				++oResult->rbDisagreements;
+			else
+			if ( match )
+				{
+				++oResult->rbMatches[ n ];
+				for ( int sub = 0;  sub < CHSRegExp::NSUBEXP;  ++sub )
+					{
+					if ( dfa.mStartPtrs[ sub ] != backtrack.mStartPtrs[ sub ]
+					||   dfa.mEndPtrs[ sub ] != backtrack.mEndPtrs[ sub ] )
+						{
+						++oResult->rbDisagreements;
+						break;
+						}
+					}
+				}
+			}
+		
+		// then, how long they take to get them
+		int matches = 0;
+		EventTime start = GetCurrentEventTime();
+		for ( int round = 0;  round < rounds;  ++round )
+			for ( int line = 0;  line < numLines;  ++line )
+				matches += dfa.regexec( lines[ line ] );
+		oResult->rbDFASeconds[ n ] = GetCurrentEventTime() - start;
+		
+		start = GetCurrentEventTime();
+		for ( int round = 0;  round < rounds;  ++round )
+			for ( int line = 0;  line < numLines;  ++line )
+				matches -= backtrack.regexec( lines[ line ] );
+		oResult->rbBacktrackSeconds[ n ] = GetCurrentEventTime() - start;
+		
+		// (and to keep the optimizer honest)
+		if ( matches )
+			++oResult->rbDisagreements;
+		}
+	
+	delete[] lines;
+	delete[] text;
+	
+	return noErr;
+}
+
+
 /*
 **	NightInfo::SetShadows()
 **
@@ -49,6 +49,7 @@ int gLightmapRadiusLimit = kLightmapMaximumRadius;
 static bool gOGLHaveVersion_1_2 = false;
 static bool gOGLHaveVersion_1_3 = false;
 static bool gOGLHaveVersion_1_4 = false;
+static bool gOGLHaveVersion_2_0 = false;
 static bool gOGLPixelZoomIsEnabled = false;
 
 bool gOpenGLAvailable = false;
@@ -100,6 +101,9 @@ static bool gOGLHavePalettedTextureExtension = true;
 static bool gOGLHaveClampToEdge = false;
 static bool gOGLHaveBGRA = false;
 static bool gOGLHavePackedPixels = false;
+static bool gOGLHavePixelBufferObject = false;
+static GLuint gOGLUploadBuffer = 0;				// streaming GL_PIXEL_UNPACK_BUFFER
+bool gOGLUseIndexedTextures = false;			// index textures + palette program
 bool gOGLHaveBlendSubtract = false;				// can we do dest - source?
 	// core function in 1.4 or if GL_ARB_imaging
 static bool gOGLHaveBlendSubtractCoreFunction = false;
@@ -148,6 +152,17 @@ static float gScaleFactor;
 #endif
 
 
+// texture residency manager; see TouchResidentTexture() below
+static void			SetResidentTextureBudget();
+static void			RegisterResidentTexture( GLuint & slot, TextureObject * owner, long bytes );
+static bool			EvictIdleTextures( long target );
+static GLubyte *	MapTextureUploadBuffer( long bytes );
+static bool			UnmapTextureUploadBuffer();
+
+// index textures drawn through a palette; see selectTextureSource() below
+static bool			setupIndexedTextures();
+
+
 /*
 **	DShowMessage()
 */
@@ -618,6 +633,7 @@ attachOGLContextToGameWindow()
 #endif	// DEBUG_VERSION
 		
 		gOGLRendererID &= 0x00FFFF00;	// per (apple's) john stauffer on the mac-opengl list
+		SetResidentTextureBudget();
 		
 #if defined( DEBUG_VERSION ) && 0
 		switch ( gOGLRendererID )
@@ -809,6 +825,8 @@ attachOGLContextToGameWindow()
 		else
 			gOGLHaveVersion_1_4 = GL_FALSE;
 		
+		gOGLHaveVersion_2_0 = ( majorVersion >= 2 );
+		
 #ifdef OGL_USE_TEXTURE_RECTANGLE
 		gOGLHaveTexRectExtension = HaveExtension( "GL_EXT_texture_rectangle" )
 			|| HaveExtension( "GL_NV_texture_rectangle" );
@@ -908,6 +926,10 @@ attachOGLContextToGameWindow()
 		gOGLHaveClampToEdge = gOGLHaveVersion_1_2 || HaveExtension( "GL_SGIS_texture_edge_clamp" );
 		gOGLHaveBGRA = gOGLHaveVersion_1_2 || HaveExtension( "GL_EXT_bgra" );
 		gOGLHavePackedPixels = gOGLHaveVersion_1_2 || HaveExtension( "GL_APPLE_packed_pixels" );
+		gOGLHavePixelBufferObject = HaveExtension( "GL_ARB_vertex_buffer_object" )
+			&& ( HaveExtension( "GL_ARB_pixel_buffer_object" )
+			||   HaveExtension( "GL_EXT_pixel_buffer_object" ) );
+		gOGLUploadBuffer = 0;	// any old one went away with its context
 		
 #ifdef DEBUG_VERSION
 		DShowMessage( "numeric GL version: <%d.%d.%d>",
@@ -918,6 +940,7 @@ attachOGLContextToGameWindow()
 		Emit1Bool( gOGLHaveVersion_1_2 );
 		Emit1Bool( gOGLHaveVersion_1_3 );
 		Emit1Bool( gOGLHaveVersion_1_4 );
+		Emit1Bool( gOGLHaveVersion_2_0 );
 		
 		if ( gOGLHaveTexRectExtension )
 			{
@@ -944,6 +967,7 @@ attachOGLContextToGameWindow()
 		Emit1Bool( gOGLHaveClampToEdge );
 		Emit1Bool( gOGLHaveBGRA );
 		Emit1Bool( gOGLHavePackedPixels );
+		Emit1Bool( gOGLHavePixelBufferObject );
 		Emit1Bool( gOGLBrokenTexSubImage_ColorIndex );
 		
 #endif	// DEBUG_VERSION
@@ -995,6 +1019,11 @@ attachOGLContextToGameWindow()
 //			IndexToAlphaMap[ kIndexToAlphaMapAlpha100TransparentZero ] );
 			// kIndexToAlphaMapCount isn't a valid id, forcing a mismatch on the first compare
 		gOGLCurrentIndexToAlphaMap = kIndexToAlphaMapCount;
+		
+			// the software renderer would run the fragment program on the cpu
+		gOGLUseIndexedTextures = gOGLHaveVersion_2_0
+			&& not gOGLRendererGeneric
+			&& setupIndexedTextures();
 		}
 	
 	if ( fmt )
@@ -1300,7 +1329,10 @@ drawOGLPixmapAsTexture(
 		}
 #endif	// DEBUG_VERSION
 	
-	if ( not cache->textureObject )
+		// a recolored mobile draws its uncolored base's texture through a remap row
+	ImageCache * tcache = selectTextureSource( cache );
+	
+	if ( not tcache->textureObject )
 		{
 		switch ( textureObjectType )
 			{
@@ -1309,19 +1341,19 @@ drawOGLPixmapAsTexture(
 				break;
 			
 			case TextureObject::kSingleTile:
-				cache->textureObject = NEW_TAG("TexObjSingle") TextureObjectSingle;
+				tcache->textureObject = NEW_TAG("TexObjSingle") TextureObjectSingle;
 				break;
 			
 			case TextureObject::kNAnimatedTiles:
-				cache->textureObject = NEW_TAG("TexObjNAnimated") TextureObjectNAnimated;
+				tcache->textureObject = NEW_TAG("TexObjNAnimated") TextureObjectNAnimated;
 				break;
 			
 			case TextureObject::kMobileArray:
-				cache->textureObject = NEW_TAG("TexObjMobileArray") TextureObjectMobileArray;
+				tcache->textureObject = NEW_TAG("TexObjMobileArray") TextureObjectMobileArray;
 				break;
 			
 			case TextureObject::kBalloonArray:
-				cache->textureObject = NEW_TAG("TexObjBalloonArray") TextureObjectBalloonArray;
+				tcache->textureObject = NEW_TAG("TexObjBalloonArray") TextureObjectBalloonArray;
 				break;
 			
 			default:
@@ -1330,8 +1362,8 @@ drawOGLPixmapAsTexture(
 			}
 		}
 	
-	if ( cache->textureObject )
-		cache->textureObject->draw( src, dst, rowLength, alphamap, targetAlpha, cache );
+	if ( tcache->textureObject )
+		tcache->textureObject->draw( src, dst, rowLength, alphamap, targetAlpha, tcache );
 	else
 		{
 //		ShowMessage( "drawOGLPixmapAsTexture drawOGLPixmap()" );
@@ -1356,6 +1388,7 @@ TextureObjectSingle::draw(	const DTSRect& src,
 	if ( name )
 		{
 		bindTexture( name );
+		TouchResidentTexture( name );
 		if ( gOGLManageTexturePriority )
 			{
 			priority = 1.0f;	// we're using it this frame, so maximize the priority
@@ -1391,6 +1424,10 @@ TextureObjectSingle::draw(	const DTSRect& src,
 			dst.rectLeft, dst.rectBottom
 			};
 		
+		if ( gOGLUseIndexedTextures )
+			beginIndexedDraw( alphamap,
+				0 != (cache->icImage.cliPictDef.pdFlags & kPictDefIsShadow) );
+				
 #ifdef OGL_USE_VERTEX_ARRAYS
 		setVertexArray( 2, GL_SHORT, 0, vertex );
 		setTexCoordArray( 2, GL_FLOAT, 0, texCoord );
@@ -1406,6 +1443,9 @@ TextureObjectSingle::draw(	const DTSRect& src,
 		glEnd();
 #endif	// OGL_USE_VERTEX_ARRAYS
 		
+		if ( gOGLUseIndexedTextures )
+			endIndexedDraw();
+		
 		if ( cache->icImage.cliPictDef.pdFlags & kPictDefIsShadow )
 			disableStencilTest();
 		
@@ -1562,6 +1602,7 @@ TextureObjectNAnimated::draw(	const DTSRect& src,
 			{
 			setTextureEnvironmentMode( GL_REPLACE );
 			bindTexture( name[ frameIndex ] );
+			TouchResidentTexture( name[ frameIndex ] );
 			if ( gOGLManageTexturePriority )
 				{
 					// we're using it this frame, so maximize the priority
@@ -1598,6 +1639,10 @@ TextureObjectNAnimated::draw(	const DTSRect& src,
 				dst.rectLeft, dst.rectBottom
 				};
 
+			if ( gOGLUseIndexedTextures )
+				beginIndexedDraw( alphamap,
+					0 != (cache->icImage.cliPictDef.pdFlags & kPictDefIsShadow) );
+					
 #ifdef OGL_USE_VERTEX_ARRAYS
 			setVertexArray( 2, GL_SHORT, 0, vertex );
 			setTexCoordArray( 2, GL_FLOAT, 0, texCoord );
@@ -1613,6 +1658,9 @@ TextureObjectNAnimated::draw(	const DTSRect& src,
 			glEnd();
 #endif	// OGL_USE_VERTEX_ARRAYS
 			
+			if ( gOGLUseIndexedTextures )
+				endIndexedDraw();
+			
 			if ( cache->icImage.cliPictDef.pdFlags & kPictDefIsShadow )
 				disableStencilTest();
 			
@@ -1793,6 +1841,7 @@ TextureObjectMobileArray::draw(	const DTSRect& src,
 		{
 		setTextureEnvironmentMode( GL_REPLACE );
 		bindTexture( name[frameHIndex][frameVIndex] );
+		TouchResidentTexture( name[frameHIndex][frameVIndex] );
 		if ( gOGLManageTexturePriority )
 			{
 			// we're using it this frame, so maximize the priority
@@ -1820,6 +1869,9 @@ TextureObjectMobileArray::draw(	const DTSRect& src,
 			dst.rectLeft, dst.rectBottom
 			};
 		
+		if ( gOGLUseIndexedTextures )
+			beginIndexedDraw( alphamap, false );
+			
 #ifdef OGL_USE_VERTEX_ARRAYS
 		setVertexArray( 2, GL_SHORT, 0, vertex );
 		setTexCoordArray( 2, GL_FLOAT, 0, texCoord );
@@ -1835,6 +1887,9 @@ TextureObjectMobileArray::draw(	const DTSRect& src,
 		glEnd();
 #endif	// OGL_USE_VERTEX_ARRAYS
 		
+		if ( gOGLUseIndexedTextures )
+			endIndexedDraw();
+		
 		if ( gOGLManageTexturePriority )
 			{
 			GLint resident;
@@ -1882,27 +1937,30 @@ TextureObjectMobileArray::drawAsDropShadow(	const DTSRect& src,
 	int frameVIndex = src.rectTop / mobileSize;	// note that cust color offset rounds out
 	int frameHIndex = src.rectLeft / mobileSize;
 	
-	if ( not name[frameHIndex][frameVIndex] )
+	int blitter = (cache->icImage.cliPictDef.pdFlags & kPictDefBlendMask);
+	IndexToAlphaMapID alphamap;
+	switch ( blitter )
 		{
-		int blitter = (cache->icImage.cliPictDef.pdFlags & kPictDefBlendMask);
-		IndexToAlphaMapID alphamap;
-		switch ( blitter )
-			{
-			case kPictDef75Blend: alphamap = kIndexToAlphaMapAlpha25TransparentZero; break;
-			case kPictDef50Blend: alphamap = kIndexToAlphaMapAlpha50TransparentZero; break;
-			case kPictDef25Blend: alphamap = kIndexToAlphaMapAlpha75TransparentZero; break;
+		case kPictDef75Blend: alphamap = kIndexToAlphaMapAlpha25TransparentZero; break;
+		case kPictDef50Blend: alphamap = kIndexToAlphaMapAlpha50TransparentZero; break;
+		case kPictDef25Blend: alphamap = kIndexToAlphaMapAlpha75TransparentZero; break;
 
-			default:
-			case kPictDefNoBlend: alphamap = kIndexToAlphaMapAlpha100TransparentZero; break;
-			}
-		load( src, alphamap, cache );
+		default:
+		case kPictDefNoBlend: alphamap = kIndexToAlphaMapAlpha100TransparentZero; break;
 		}
 	
+	if ( not name[frameHIndex][frameVIndex] )
+		load( src, alphamap, cache );
+		
+		// index textures can't be filtered, so the program smooths the alpha itself
+	GLfloat texel = gOGLHaveTexRectExtension ? 1.0f : invTexSize;
+	
 	if ( name[frameHIndex][frameVIndex] )
 		{
 		DTSRect dst = dstIn;
 		dst.Offset( hOffset, vOffset );
 		bindTexture( name[frameHIndex][frameVIndex] );
+		TouchResidentTexture( name[frameHIndex][frameVIndex] );
 		if ( gOGLManageTexturePriority )
 			{
 				// we're using it this frame, so maximize the priority
@@ -1918,10 +1976,13 @@ TextureObjectMobileArray::drawAsDropShadow(	const DTSRect& src,
 		
 		setTextureEnvironmentMode( GL_MODULATE );
 		
-		glTexParameteri( gOGLTexTarget2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
-			// this IS stored in the object
-		glTexParameteri( gOGLTexTarget2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
-			// this IS stored in the object
+		if ( not gOGLUseIndexedTextures )
+			{
+			glTexParameteri( gOGLTexTarget2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+				// this IS stored in the object
+			glTexParameteri( gOGLTexTarget2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+				// this IS stored in the object
+			}
 		
 		GLfloat blendcolor[] = { 0.0f, 0.0f, 0.0f, shadowAlpha };
 		glColor4fv( blendcolor );
@@ -1933,6 +1994,9 @@ TextureObjectMobileArray::drawAsDropShadow(	const DTSRect& src,
 			dst.rectLeft, dst.rectBottom
 			};
 		
+		if ( gOGLUseIndexedTextures )
+			beginIndexedDraw( alphamap, true, texel, texel );
+			
 #ifdef OGL_USE_VERTEX_ARRAYS
 		setVertexArray( 2, GL_SHORT, 0, vertex );
 		setTexCoordArray( 2, GL_FLOAT, 0, texCoord );
@@ -1948,6 +2012,9 @@ TextureObjectMobileArray::drawAsDropShadow(	const DTSRect& src,
 		glEnd();
 #endif	// OGL_USE_VERTEX_ARRAYS
 		
+		if ( gOGLUseIndexedTextures )
+			endIndexedDraw();
+		
 		if ( gOGLManageTexturePriority )
 			{
 			GLint resident;
@@ -1967,10 +2034,13 @@ TextureObjectMobileArray::drawAsDropShadow(	const DTSRect& src,
 			}
 		
 		// what would I save by creating "shadow texture" objects?
-		glTexParameteri( gOGLTexTarget2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
-			// this IS stored in the object
-		glTexParameteri( gOGLTexTarget2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
-			// this IS stored in the object
+		if ( not gOGLUseIndexedTextures )
+			{
+			glTexParameteri( gOGLTexTarget2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+				// this IS stored in the object
+			glTexParameteri( gOGLTexTarget2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+				// this IS stored in the object
+			}
 		
 #ifdef OGL_USE_VERTEX_ARRAYS
 		// prevent dangling pointer to 'vertex', no longer in scope
@@ -2001,22 +2071,24 @@ TextureObjectMobileArray::drawAsRotatedShadow(	const DTSRect& src,
 	int frameVIndex = src.rectTop / mobileSize;	// note that cust color offset rounds out
 	int frameHIndex = src.rectLeft / mobileSize;
 	
-	if ( not name[frameHIndex][frameVIndex] )
+	int blitter = (cache->icImage.cliPictDef.pdFlags & kPictDefBlendMask);
+	IndexToAlphaMapID alphamap;
+	switch ( blitter )
 		{
-		int blitter = (cache->icImage.cliPictDef.pdFlags & kPictDefBlendMask);
-		IndexToAlphaMapID alphamap;
-		switch ( blitter )
-			{
-			case kPictDef75Blend: alphamap = kIndexToAlphaMapAlpha25TransparentZero; break;
-			case kPictDef50Blend: alphamap = kIndexToAlphaMapAlpha50TransparentZero; break;
-			case kPictDef25Blend: alphamap = kIndexToAlphaMapAlpha75TransparentZero; break;
+		case kPictDef75Blend: alphamap = kIndexToAlphaMapAlpha25TransparentZero; break;
+		case kPictDef50Blend: alphamap = kIndexToAlphaMapAlpha50TransparentZero; break;
+		case kPictDef25Blend: alphamap = kIndexToAlphaMapAlpha75TransparentZero; break;
 
-			default:
-			case kPictDefNoBlend: alphamap = kIndexToAlphaMapAlpha100TransparentZero; break;
-			}
-		load( src, alphamap, cache );
+		default:
+		case kPictDefNoBlend: alphamap = kIndexToAlphaMapAlpha100TransparentZero; break;
 		}
 	
+	if ( not name[frameHIndex][frameVIndex] )
+		load( src, alphamap, cache );
+		
+		// index textures can't be filtered, so the program smooths the alpha itself
+	GLfloat texel = gOGLHaveTexRectExtension ? 1.0f : invTexSize;
+	
 	if ( name[frameHIndex][frameVIndex] )
 		{
 		const int baseMargin = 2;
@@ -2026,6 +2098,7 @@ TextureObjectMobileArray::drawAsRotatedShadow(	const DTSRect& src,
 		dst.Offset( -centerH, -centerV );
 		dst.rectTop *= scale;
 		bindTexture( name[frameHIndex][frameVIndex] );
+		TouchResidentTexture( name[frameHIndex][frameVIndex] );
 		if ( gOGLManageTexturePriority )
 			{
 				// we're using it this frame, so maximize the priority
@@ -2053,15 +2126,21 @@ TextureObjectMobileArray::drawAsRotatedShadow(	const DTSRect& src,
 			dst.rectRight, dst.rectBottom
 			};
 		
+		if ( gOGLUseIndexedTextures )
+			beginIndexedDraw( alphamap, true, texel, texel );
+			
 #ifdef OGL_USE_VERTEX_ARRAYS
 		setVertexArray( 2, GL_SHORT, 0, vertex );
 		setTexCoordArray( 2, GL_FLOAT, 0, texCoord );
 #endif	// OGL_USE_VERTEX_ARRAYS
 		
-		glTexParameteri( gOGLTexTarget2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
-			// this IS stored in the object
-		glTexParameteri( gOGLTexTarget2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
-			// this IS stored in the object
+		if ( not gOGLUseIndexedTextures )
+			{
+			glTexParameteri( gOGLTexTarget2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+				// this IS stored in the object
+			glTexParameteri( gOGLTexTarget2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+				// this IS stored in the object
+			}
 		
 		glPushMatrix();
 			glTranslatef( centerH, centerV, 0.0f );
@@ -2081,6 +2160,9 @@ TextureObjectMobileArray::drawAsRotatedShadow(	const DTSRect& src,
 		
 		glPopMatrix();
 		
+		if ( gOGLUseIndexedTextures )
+			endIndexedDraw();
+		
 		if ( gOGLManageTexturePriority )
 			{
 			GLint resident;
@@ -2100,10 +2182,13 @@ TextureObjectMobileArray::drawAsRotatedShadow(	const DTSRect& src,
 			}
 		
 		// what would I save by creating "shadow texture" objects?
-		glTexParameteri( gOGLTexTarget2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
-			// this IS stored in the object
-		glTexParameteri( gOGLTexTarget2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
-			// this IS stored in the object
+		if ( not gOGLUseIndexedTextures )
+			{
+			glTexParameteri( gOGLTexTarget2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+				// this IS stored in the object
+			glTexParameteri( gOGLTexTarget2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+				// this IS stored in the object
+			}
 		
 #ifdef OGL_USE_VERTEX_ARRAYS
 		// prevent dangling pointer to 'vertex', no longer in scope
@@ -2201,6 +2286,7 @@ TextureObjectBalloonArray::draw(	const DTSRect& src,
 	if ( name[frameHIndex][frameVIndex] )
 		{
 		bindTexture( name[frameHIndex][frameVIndex] );
+		TouchResidentTexture( name[frameHIndex][frameVIndex] );
 		if ( gOGLManageTexturePriority )
 			{
 				// we're using it this frame, so maximize the priority
@@ -2245,6 +2331,9 @@ TextureObjectBalloonArray::draw(	const DTSRect& src,
 			dst.rectLeft, dst.rectBottom
 			};
 		
+		if ( gOGLUseIndexedTextures )
+			beginIndexedDraw( kIndexToAlphaMapAlpha100TransparentZero, true );
+			
 #ifdef OGL_USE_VERTEX_ARRAYS
 		setVertexArray( 2, GL_SHORT, 0, vertex );
 		setTexCoordArray( 2, GL_FLOAT, 0, texCoord );
@@ -2260,6 +2349,9 @@ TextureObjectBalloonArray::draw(	const DTSRect& src,
 		glEnd();
 #endif	// OGL_USE_VERTEX_ARRAYS
 		
+		if ( gOGLUseIndexedTextures )
+			endIndexedDraw();
+		
 		if ( gOGLManageTexturePriority )
 			{
 			GLint resident;
@@ -2391,6 +2483,696 @@ TextureObjectBalloonArray::load(	const DTSRect& src,
 }
 
 
+/*
+**	Texture residency
+**
+**	Every texture that loadTextureObject() creates is entered here, along with its
+**	size in bytes and the address of the owner's name field. The entries are kept
+**	in least-recently-drawn order; each frame, textures that haven't been drawn for
+**	a whole frame are deleted from the front of that list until the total fits the
+**	budget. The owner sees a zero name and reloads from the cached image bits the
+**	next time it is drawn, so GPU eviction never touches the CPU-side image cache.
+*/
+enum
+	{
+	kMaxResidentTextures	= 8192,
+	kResidentHashSize		= 4096,		// power of 2
+	kResidentNone			= -1
+	};
+
+struct ResidentTexture
+{
+	GLuint *		rtSlot;			// owner's name for it; zeroed on eviction
+	TextureObject *	rtOwner;
+	GLuint			rtName;
+	long			rtBytes;
+	uint			rtFrame;		// last frame it was drawn
+	int				rtPrev;			// LRU links, least recently drawn first
+	int				rtNext;
+	int				rtHashNext;		// next entry in the same hash bucket
+};
+
+static ResidentTexture *	gResident;			// kMaxResidentTextures of them
+static int *				gResidentHash;		// kResidentHashSize bucket heads
+static int					gResidentFree = kResidentNone;
+static int					gResidentFirst = kResidentNone;
+static int					gResidentLast = kResidentNone;
+static long					gResidentBytes;
+static long					gResidentBudget;
+static uint					gResidentFrame = 1;
+
+
+/*
+**	SetResidentTextureBudget()
+**
+**	size the budget from the texture memory the current renderer reports
+*/
+void
+SetResidentTextureBudget()
+{
+	const long kDefaultBudget	= 32L * 1024 * 1024;
+	const long kSmallBudget		= 4L * 1024 * 1024;
+	const long kMaximumBudget	= 512L * 1024 * 1024;
+	
+	long vram = 0;
+	AGLRendererInfo head = aglQueryRendererInfo( nullptr, 0 );
+	for ( AGLRendererInfo info = head;  info;  info = aglNextRendererInfo( info ) )
+		{
+		GLint id, mem;
+		if ( aglDescribeRenderer( info, AGL_RENDERER_ID, &id )
+		&&   ( id & 0x00FFFF00 ) == gOGLRendererID )
+			{
+			if ( aglDescribeRenderer( info, AGL_TEXTURE_MEMORY, &mem ) && mem > 0 )
+				vram = mem;
+			break;
+			}
+		}
+	if ( head )
+		aglDestroyRendererInfo( head );
+		
+		// leave half for the frame buffers, the lightmap, and everyone else
+	if ( vram > 0 )
+		gResidentBudget = vram / 2;
+	else
+	if ( gOGLRendererSmallTextureMemory )
+		gResidentBudget = kSmallBudget;
+	else
+		gResidentBudget = kDefaultBudget;
+	
+	if ( gResidentBudget > kMaximumBudget )
+		gResidentBudget = kMaximumBudget;
+	
+	DShowMessage( "texture budget: %ld bytes (renderer reports %ld)",
+		gResidentBudget, vram );
+}
+
+
+/*
+**	FindResidentTexture()
+**
+**	return the index of the entry for this texture name, or kResidentNone
+*/
+static inline int
+FindResidentTexture( GLuint texture )
+{
+	if ( not gResidentHash )
+		return kResidentNone;
+	
+	int index = gResidentHash[ texture & (kResidentHashSize - 1) ];
+	while ( index != kResidentNone
+	&&      gResident[ index ].rtName != texture )
+		{
+		index = gResident[ index ].rtHashNext;
+		}
+	return index;
+}
+
+
+/*
+**	UnlinkResidentTexture()
+**
+**	take an entry out of the LRU list and its hash bucket, and free it
+*/
+static void
+UnlinkResidentTexture( int index )
+{
+	ResidentTexture & rt = gResident[ index ];
+	
+	if ( rt.rtPrev != kResidentNone )
+		gResident[ rt.rtPrev ].rtNext = rt.rtNext;
+	else
+		gResidentFirst = rt.rtNext;
+	if ( rt.rtNext != kResidentNone )
+		gResident[ rt.rtNext ].rtPrev = rt.rtPrev;
+	else
+		gResidentLast = rt.rtPrev;
+	
+	int * link = &gResidentHash[ rt.rtName & (kResidentHashSize - 1) ];
+	while ( *link != index )
+		link = &gResident[ *link ].rtHashNext;
+	*link = rt.rtHashNext;
+	
+	gResidentBytes -= rt.rtBytes;
+	rt.rtSlot = nullptr;
+	rt.rtOwner = nullptr;
+	rt.rtName = 0;
+	rt.rtNext = gResidentFree;
+	gResidentFree = index;
+}
+
+
+/*
+**	ClearResidentTextures()
+**
+**	empty the table, putting every entry on the free list
+*/
+static void
+ClearResidentTextures()
+{
+	for ( int i = 0; i < kResidentHashSize; ++i )
+		gResidentHash[ i ] = kResidentNone;
+	
+	for ( int i = 0; i < kMaxResidentTextures; ++i )
+		{
+		gResident[ i ].rtSlot = nullptr;
+		gResident[ i ].rtOwner = nullptr;
+		gResident[ i ].rtName = 0;
+		gResident[ i ].rtNext = i + 1 < kMaxResidentTextures ? i + 1 : kResidentNone;
+		}
+	gResidentFree = 0;
+	gResidentFirst = gResidentLast = kResidentNone;
+	gResidentBytes = 0;
+}
+
+
+/*
+**	EvictIdleTextures()
+**
+**	delete least-recently-drawn textures, skipping any drawn this frame or last,
+**	until the total is no more than target bytes
+**	returns true if any were deleted
+*/
+bool
+EvictIdleTextures( long target )
+{
+	bool result = false;
+	while ( gResidentBytes > target
+	&&      gResidentFirst != kResidentNone )
+		{
+		int index = gResidentFirst;
+		ResidentTexture & rt = gResident[ index ];
+		
+			// everything behind this one is newer still
+		if ( rt.rtFrame + 1 >= gResidentFrame )
+			break;
+		
+		GLuint texture = rt.rtName;
+		GLuint * slot = rt.rtSlot;
+		TextureObject * owner = rt.rtOwner;
+		UnlinkResidentTexture( index );
+		
+		unbindTexture( texture );
+		glDeleteTextures( 1, &texture );
+		*slot = 0;
+		owner->textureEvicted();
+		result = true;
+		}
+	return result;
+}
+
+
+/*
+**	RegisterResidentTexture()
+**
+**	a new texture has been uploaded; make room for it and start tracking it
+*/
+void
+RegisterResidentTexture( GLuint & slot, TextureObject * owner, long bytes )
+{
+	if ( not gResident )
+		{
+		gResident = NEW_TAG("ResidentTexture") ResidentTexture[ kMaxResidentTextures ];
+		CheckPointer( gResident );
+		gResidentHash = NEW_TAG("ResidentHash") int[ kResidentHashSize ];
+		CheckPointer( gResidentHash );
+		if ( not gResident || not gResidentHash )
+			{
+			delete[] gResident;
+			gResident = nullptr;
+			delete[] gResidentHash;
+			gResidentHash = nullptr;
+			return;
+			}
+		ClearResidentTextures();
+		}
+	
+	EvictIdleTextures( gResidentBudget - bytes );
+	if ( kResidentNone == gResidentFree )
+		EvictIdleTextures( gResidentBytes - 1 );
+		
+		// if everything is in use, this one just goes untracked
+	int index = gResidentFree;
+	if ( kResidentNone == index )
+		return;
+	
+	ResidentTexture & rt = gResident[ index ];
+	gResidentFree = rt.rtNext;
+	
+	rt.rtSlot = &slot;
+	rt.rtOwner = owner;
+	rt.rtName = slot;
+	rt.rtBytes = bytes;
+	rt.rtFrame = gResidentFrame;
+	
+	rt.rtPrev = gResidentLast;
+	rt.rtNext = kResidentNone;
+	if ( gResidentLast != kResidentNone )
+		gResident[ gResidentLast ].rtNext = index;
+	else
+		gResidentFirst = index;
+	gResidentLast = index;
+	
+	int & bucket = gResidentHash[ slot & (kResidentHashSize - 1) ];
+	rt.rtHashNext = bucket;
+	bucket = index;
+	
+	gResidentBytes += bytes;
+}
+
+
+/*
+**	TouchResidentTexture()
+**
+**	note that a texture is being drawn this frame
+**	the first draw in a frame moves it to the back of the LRU list
+*/
+void
+TouchResidentTexture( GLuint texture )
+{
+	int index = FindResidentTexture( texture );
+	if ( kResidentNone == index )
+		return;
+	
+	ResidentTexture & rt = gResident[ index ];
+	if ( rt.rtFrame == gResidentFrame )
+		return;
+	rt.rtFrame = gResidentFrame;
+	
+	if ( index != gResidentLast )
+		{
+		if ( rt.rtPrev != kResidentNone )
+			gResident[ rt.rtPrev ].rtNext = rt.rtNext;
+		else
+			gResidentFirst = rt.rtNext;
+		gResident[ rt.rtNext ].rtPrev = rt.rtPrev;
+		
+		rt.rtPrev = gResidentLast;
+		rt.rtNext = kResidentNone;
+		gResident[ gResidentLast ].rtNext = index;
+		gResidentLast = index;
+		}
+}
+
+
+/*
+**	ForgetResidentTexture()
+**
+**	the owner is about to delete this texture itself
+*/
+void
+ForgetResidentTexture( GLuint texture )
+{
+	if ( not texture )
+		return;
+	
+	int index = FindResidentTexture( texture );
+	if ( index != kResidentNone )
+		UnlinkResidentTexture( index );
+}
+
+
+/*
+**	AgeResidentTextures()
+**
+**	start a new frame, and bring the total back under budget
+*/
+void
+AgeResidentTextures()
+{
+	++gResidentFrame;
+	if ( gResidentBytes > gResidentBudget )
+		EvictIdleTextures( gResidentBudget );
+}
+
+
+/*
+**	ResetResidentTextures()
+**
+**	forget everything; called once the owners have deleted their textures,
+**	since the context may be going away
+*/
+void
+ResetResidentTextures()
+{
+	if ( gOGLUploadBuffer )
+		{
+		glDeleteBuffersARB( 1, &gOGLUploadBuffer );
+		gOGLUploadBuffer = 0;
+		}
+	
+	if ( gResident )
+		ClearResidentTextures();
+}
+
+
+/*
+**	MapTextureUploadBuffer()
+**
+**	bind the streaming unpack buffer and map a fresh store of the given size
+**	orphaning the previous store lets the driver finish any upload still reading it
+**	while we fill the new one, so glTexSubImage2D() needn't wait on either
+**	returns nullptr (and leaves nothing bound) if pixel buffers can't be used
+*/
+GLubyte *
+MapTextureUploadBuffer( long bytes )
+{
+	if ( not gOGLHavePixelBufferObject )
+		return nullptr;
+	
+	if ( not gOGLUploadBuffer )
+		{
+		glGenBuffersARB( 1, &gOGLUploadBuffer );
+		if ( not gOGLUploadBuffer )
+			{
+			gOGLHavePixelBufferObject = false;
+			return nullptr;
+			}
+		}
+	
+	glBindBufferARB( GL_PIXEL_UNPACK_BUFFER_ARB, gOGLUploadBuffer );
+	glBufferDataARB( GL_PIXEL_UNPACK_BUFFER_ARB, bytes, nullptr, GL_STREAM_DRAW_ARB );
+	GLubyte * pixels = static_cast<GLubyte *>(
+		glMapBufferARB( GL_PIXEL_UNPACK_BUFFER_ARB, GL_WRITE_ONLY_ARB ) );
+	if ( not pixels )
+		glBindBufferARB( GL_PIXEL_UNPACK_BUFFER_ARB, 0 );
+	
+	return pixels;
+}
+
+
+/*
+**	UnmapTextureUploadBuffer()
+**
+**	finish writing the mapped store; it stays bound, so the next glTexSubImage2D()
+**	sources from it (pass a nullptr offset)
+**	returns false if the contents were lost, in which case nothing is left bound
+*/
+bool
+UnmapTextureUploadBuffer()
+{
+	if ( glUnmapBufferARB( GL_PIXEL_UNPACK_BUFFER_ARB ) )
+		return true;
+	
+	glBindBufferARB( GL_PIXEL_UNPACK_BUFFER_ARB, 0 );
+	return false;
+}
+
+
+/*
+**	Indexed textures
+**
+**	With a fragment program available, images are uploaded as one byte per texel,
+**	holding the same global color indices the software blitters use. The program
+**	sends each index through a row of the remap texture, and the result through a
+**	row of the palette texture: one row per alpha map, plus an opaque one. Row 0 of
+**	the remap is the identity; a colored mobile borrows another row for the duration
+**	of its draw, so every recoloring of a picture shares the uncolored texture.
+*/
+enum
+	{
+	kPaletteRows	= kIndexToAlphaMapCount + 1,	// the alpha maps, then opaque
+	kRemapRows		= 256							// row 0 is the identity
+	};
+
+static GLuint	gOGLIndexedProgram;
+static GLuint	gOGLPaletteTexture;
+static GLuint	gOGLRemapTexture;
+static GLint	gOGLPaletteRowUniform;
+static GLint	gOGLRemapRowUniform;
+static GLint	gOGLModulateUniform;
+static GLint	gOGLTexelUniform;
+static const ImageColorCache *	gOGLRemapRowOwner[ kRemapRows ];
+static int		gOGLNextRemapRow = 1;
+static int		gOGLRemapRow;				// for the next beginIndexedDraw()
+
+	// the sampler for the index texture depends on the texture target in use
+static const char kIndexedPrefix2D[] =
+	"#define SAMPLER sampler2D\n"
+	"#define LOOKUP texture2D\n";
+static const char kIndexedPrefixRect[] =
+	"#extension GL_ARB_texture_rectangle : enable\n"
+	"#define SAMPLER sampler2DRect\n"
+	"#define LOOKUP texture2DRect\n";
+static const char kIndexedProgram[] =
+	"uniform SAMPLER uIndices;\n"
+	"uniform sampler2D uPalette;\n"
+	"uniform sampler2D uRemap;\n"
+	"uniform float uPaletteRow;\n"
+	"uniform float uRemapRow;\n"
+	"uniform float uModulate;\n"
+	"uniform vec2 uTexel;\n"
+	"vec4 Lookup( vec2 st )\n"
+	"{\n"
+	"	float index = LOOKUP( uIndices, st ).r * 255.0;\n"
+	"	index = texture2D( uRemap, vec2( ( index + 0.5 ) / 256.0, uRemapRow ) ).r * 255.0;\n"
+	"	return texture2D( uPalette, vec2( ( index + 0.5 ) / 256.0, uPaletteRow ) );\n"
+	"}\n"
+	"void main()\n"
+	"{\n"
+	"	vec2 st = gl_TexCoord[0].st;\n"
+	"	vec4 color;\n"
+	"	if ( uTexel.x > 0.0 )\n"
+	"		{\n"
+		// indices can't be filtered, so blend the four nearest colors ourselves
+	"		vec2 t = st / uTexel - 0.5;\n"
+	"		vec2 f = fract( t );\n"
+	"		st = ( floor( t ) + 0.5 ) * uTexel;\n"
+	"		color = mix( mix( Lookup( st ), Lookup( st + vec2( uTexel.x, 0.0 ) ), f.x ),\n"
+	"			mix( Lookup( st + vec2( 0.0, uTexel.y ) ), Lookup( st + uTexel ), f.x ), f.y );\n"
+	"		}\n"
+	"	else\n"
+	"		color = Lookup( st );\n"
+	"	gl_FragColor = mix( color, color * gl_Color, uModulate );\n"
+	"}\n";
+
+
+/*
+**	setupIndexedTextures()
+**
+**	build the program and its two lookup textures for the current context
+**	returns false if the renderer can't run it, in which case we upload rgba as before
+*/
+bool
+setupIndexedTextures()
+{
+		// any old objects went away with their context
+	gOGLIndexedProgram = 0;
+	gOGLPaletteTexture = 0;
+	gOGLRemapTexture = 0;
+	memset( gOGLRemapRowOwner, 0, sizeof gOGLRemapRowOwner );
+	gOGLNextRemapRow = 1;
+	gOGLRemapRow = 0;
+	
+	bool rect = ( GL_TEXTURE_RECTANGLE_EXT == gOGLTexTarget2D );
+	if ( rect && not HaveExtension( "GL_ARB_texture_rectangle" ) )
+		return false;
+	
+	const GLchar * source[] = { rect ? kIndexedPrefixRect : kIndexedPrefix2D, kIndexedProgram };
+	GLuint shader = glCreateShader( GL_FRAGMENT_SHADER );
+	if ( not shader )
+		return false;
+	glShaderSource( shader, 2, source, nullptr );
+	glCompileShader( shader );
+	
+	GLint ok = GL_FALSE;
+	glGetShaderiv( shader, GL_COMPILE_STATUS, &ok );
+	if ( ok )
+		{
+		gOGLIndexedProgram = glCreateProgram();
+		glAttachShader( gOGLIndexedProgram, shader );
+		glLinkProgram( gOGLIndexedProgram );
+		glGetProgramiv( gOGLIndexedProgram, GL_LINK_STATUS, &ok );
+		}
+	glDeleteShader( shader );	// the program keeps it as long as it needs it
+	
+	if ( not ok )
+		{
+		DShowMessage( "indexed texture program failed to build" );
+		if ( gOGLIndexedProgram )
+			glDeleteProgram( gOGLIndexedProgram );
+		gOGLIndexedProgram = 0;
+		ShowOpenGLErrors();
+		return false;
+		}
+	
+	glUseProgram( gOGLIndexedProgram );
+	glUniform1i( glGetUniformLocation( gOGLIndexedProgram, "uIndices" ), 0 );
+	glUniform1i( glGetUniformLocation( gOGLIndexedProgram, "uPalette" ), 1 );
+	glUniform1i( glGetUniformLocation( gOGLIndexedProgram, "uRemap" ), 2 );
+	gOGLPaletteRowUniform = glGetUniformLocation( gOGLIndexedProgram, "uPaletteRow" );
+	gOGLRemapRowUniform = glGetUniformLocation( gOGLIndexedProgram, "uRemapRow" );
+	gOGLModulateUniform = glGetUniformLocation( gOGLIndexedProgram, "uModulate" );
+	gOGLTexelUniform = glGetUniformLocation( gOGLIndexedProgram, "uTexel" );
+	glUseProgram( 0 );
+	
+		// the same colors the rgba uploads used to bake in, one row per alpha map
+	GLubyte palette[ kPaletteRows ][ 256 ][ 4 ];
+	for ( int row = 0; row < kPaletteRows; ++row )
+		{
+		for ( int i = 0; i < 256; ++i )
+			{
+			palette[ row ][ i ][ 0 ] = gIndexToRedMap  [ i ] >> 8;
+			palette[ row ][ i ][ 1 ] = gIndexToGreenMap[ i ] >> 8;
+			palette[ row ][ i ][ 2 ] = gIndexToBlueMap [ i ] >> 8;
+			palette[ row ][ i ][ 3 ] = ( row < kIndexToAlphaMapCount )
+				? IndexToAlphaMap[ row ][ i ] >> 8 : 255;
+			}
+		}
+	GLubyte identity[ 256 ];
+	for ( int i = 0; i < 256; ++i )
+		identity[ i ] = i;
+		
+		// bound behind texture unit 0's back, so bindTexture()'s cache stays right
+	glGenTextures( 1, &gOGLPaletteTexture );
+	glActiveTexture( GL_TEXTURE1 );
+	glBindTexture( GL_TEXTURE_2D, gOGLPaletteTexture );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+	glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA8, 256, kPaletteRows, 0,
+		GL_RGBA, GL_UNSIGNED_BYTE, palette );
+	
+	glGenTextures( 1, &gOGLRemapTexture );
+	glActiveTexture( GL_TEXTURE2 );
+	glBindTexture( GL_TEXTURE_2D, gOGLRemapTexture );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+	glTexImage2D( GL_TEXTURE_2D, 0, GL_LUMINANCE8, 256, kRemapRows, 0,
+		GL_LUMINANCE, GL_UNSIGNED_BYTE, nullptr );
+	glTexSubImage2D( GL_TEXTURE_2D, 0, 0, 0, 256, 1,
+		GL_LUMINANCE, GL_UNSIGNED_BYTE, identity );
+	glActiveTexture( GL_TEXTURE0 );
+	
+	if ( ShowOpenGLErrors() )
+		{
+		ResetIndexedTextures();
+		return false;
+		}
+	
+	return true;
+}
+
+
+/*
+**	selectTextureSource()
+**
+**	return the image whose texture should be drawn for this one; a colored mobile
+**	gets its uncolored picture, and a remap row for the draw that follows
+*/
+ImageCache *
+selectTextureSource( ImageCache * cache )
+{
+	gOGLRemapRow = 0;
+	if ( not gOGLUseIndexedTextures
+	||   CacheObject::kCacheTypeImageColor != cache->coType )
+		{
+		return cache;
+		}
+	
+	ImageColorCache * ccache = static_cast<ImageColorCache *>( cache );
+	ImageCache * base = ccache->GetBaseImage();
+	if ( not base )
+		return cache;	// collapsing colors; it keeps a texture of its own
+	
+	int row = ccache->icRemapRow;
+	if ( not row || gOGLRemapRowOwner[ row ] != ccache )
+		{
+			// hand out rows round-robin; whoever had this one will upload again
+		row = gOGLNextRemapRow;
+		if ( ++gOGLNextRemapRow >= kRemapRows )
+			gOGLNextRemapRow = 1;
+		
+		gOGLRemapRowOwner[ row ] = ccache;
+		ccache->icRemapRow = row;
+		
+		glActiveTexture( GL_TEXTURE2 );
+		glBindTexture( GL_TEXTURE_2D, gOGLRemapTexture );
+		glTexSubImage2D( GL_TEXTURE_2D, 0, 0, row, 256, 1,
+			GL_LUMINANCE, GL_UNSIGNED_BYTE, ccache->icRemap );
+		glActiveTexture( GL_TEXTURE0 );
+		}
+	gOGLRemapRow = row;
+	
+	return base;
+}
+
+
+/*
+**	ForgetTextureRemap()
+**
+**	a colored image is going away; don't let a new one at the same address
+**	mistake its row for its own
+*/
+void
+ForgetTextureRemap( const ImageColorCache * ccache )
+{
+	int row = ccache->icRemapRow;
+	if ( row > 0 && row < kRemapRows && gOGLRemapRowOwner[ row ] == ccache )
+		gOGLRemapRowOwner[ row ] = nullptr;
+}
+
+
+/*
+**	beginIndexedDraw()
+**
+**	switch to the palette program for one image draw
+**	modulate multiplies by the current color, as GL_MODULATE would have;
+**	a nonzero texel size (in texture coordinates) asks for smoothed alpha
+*/
+void
+beginIndexedDraw( IndexToAlphaMapID alphamap, bool modulate,
+	GLfloat texelWidth /* = 0.0f */, GLfloat texelHeight /* = 0.0f */ )
+{
+	int row = ( alphamap < kIndexToAlphaMapCount ) ? alphamap : kIndexToAlphaMapCount;
+	
+	glUseProgram( gOGLIndexedProgram );
+	glUniform1f( gOGLPaletteRowUniform, ( row + 0.5f ) / kPaletteRows );
+	glUniform1f( gOGLRemapRowUniform, ( gOGLRemapRow + 0.5f ) / kRemapRows );
+	glUniform1f( gOGLModulateUniform, modulate ? 1.0f : 0.0f );
+	glUniform2f( gOGLTexelUniform, texelWidth, texelHeight );
+}
+
+
+/*
+**	endIndexedDraw()
+**
+**	back to the fixed pipeline, and to the identity remap
+*/
+void
+endIndexedDraw()
+{
+	glUseProgram( 0 );
+	gOGLRemapRow = 0;
+}
+
+
+/*
+**	ResetIndexedTextures()
+**
+**	delete the program and its textures; setupIndexedTextures() builds them again
+**	for the next context
+*/
+void
+ResetIndexedTextures()
+{
+	if ( gOGLIndexedProgram )
+		glDeleteProgram( gOGLIndexedProgram );
+	if ( gOGLPaletteTexture )
+		glDeleteTextures( 1, &gOGLPaletteTexture );
+	if ( gOGLRemapTexture )
+		glDeleteTextures( 1, &gOGLRemapTexture );
+	
+	gOGLIndexedProgram = 0;
+	gOGLPaletteTexture = 0;
+	gOGLRemapTexture = 0;
+	memset( gOGLRemapRowOwner, 0, sizeof gOGLRemapRowOwner );
+	gOGLUseIndexedTextures = false;
+}
+
+
 bool
 TextureObject::loadTextureObject(
 	GLuint &			textureObjectName,
@@ -2495,6 +3277,15 @@ TextureObject::loadTextureObject(
 					type = GL_UNSIGNED_BYTE;
 					}
 			
+				// the fragment program does both the color and the alpha lookups,
+				// so all it needs is the raw global index: a quarter the memory of RGBA
+			if ( gOGLUseIndexedTextures )
+				{
+				internalFormat = GL_LUMINANCE8;
+				format = GL_LUMINANCE;
+				type = GL_UNSIGNED_BYTE;
+				}
+				
 					// this does NOT allocate memory:
 					// it checks to see if we are within certain limits
 			GLint testwidth;
@@ -2526,6 +3317,8 @@ if ( ShowOpenGLErrors() )
 				if ( not testwidth )
 					{
 					tryAgain = deleteAllUnusedTextures();
+					if ( EvictIdleTextures( 0 ) )
+						tryAgain = true;
 					DecrementTextureObjectPriorities();
 #ifdef DEBUG_VERSION
 					if ( tryAgain )
@@ -2562,10 +3355,12 @@ if ( ShowOpenGLErrors() )
 				
 				if ( not ShowOpenGLErrors() ) // the most likely error is out-of-memory
 					{
-					if ( not gOGLBrokenTexSubImage_ColorIndex
-					&&   not ( gOGLHaveTexRectExtension && gOGLHavePalettedTextureExtension ) )
+					if ( gOGLUseIndexedTextures
+					||   ( not gOGLBrokenTexSubImage_ColorIndex
+					&&     not ( gOGLHaveTexRectExtension && gOGLHavePalettedTextureExtension ) ) )
 						{
-						setIndexToAlphaMap( alphamap );
+						if ( GL_COLOR_INDEX == format )
+							setIndexToAlphaMap( alphamap );
 						if ( vOffset )
 							glPixelStorei( GL_UNPACK_SKIP_ROWS, vOffset );
 						
@@ -2582,7 +3377,7 @@ if ( ShowOpenGLErrors() )
 						glTexSubImage2D(	gOGLTexTarget2D, 0, 0, 0,
 											srcTexWidth,
 											srcTexHeight,
-											GL_COLOR_INDEX, GL_UNSIGNED_BYTE,
+											format, type,
 											cache->icImage.cliImage.GetBits() );
 						
 						if ( not ShowOpenGLErrors() )	// the most likely error is out-of-memory
@@ -2611,9 +3406,12 @@ if ( ShowOpenGLErrors() )
 #define USE_TEMP_HANDLES	 0
 
 #if ! USE_TEMP_HANDLES
-// the DT way
-						GLubyte * pixels = NEW_TAG("temppixels")
-							GLubyte[ (*dstTexWidth) * (*dstTexHeight) * 4 ];
+// the DT way, unless we can convert straight into a pixel buffer
+						long pixelBytes = (*dstTexWidth) * (*dstTexHeight) * 4;
+						GLubyte * pixels = MapTextureUploadBuffer( pixelBytes );
+						bool mapped = ( pixels != nullptr );
+						if ( not mapped )
+							pixels = NEW_TAG("temppixels") GLubyte[ pixelBytes ];
 #else	// temp memory
 						GLubyte * pixels = nullptr;
 						OSStatus resultCode;
@@ -2692,19 +3490,43 @@ if ( ShowOpenGLErrors() )
 //							glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );	
 								// only some systems do anything with this
 							
-							glTexSubImage2D( gOGLTexTarget2D, 0, 0, 0,
-											srcTexWidth,
-											srcTexHeight,
-											format, type,
-											pixels );
+#if ! USE_TEMP_HANDLES
+							if ( mapped )
+								{
+									// the pixels are now an offset into the bound buffer;
+									// unbind right after so client-memory calls still work
+								if ( UnmapTextureUploadBuffer() )
+									{
+									glTexSubImage2D( gOGLTexTarget2D, 0, 0, 0,
+													srcTexWidth,
+													srcTexHeight,
+													format, type,
+													nullptr );
+									glBindBufferARB( GL_PIXEL_UNPACK_BUFFER_ARB, 0 );
+									
+									if ( not ShowOpenGLErrors() )
+										returnVal = true;
+									}
+								}
+							else
+#endif	// ! USE_TEMP_HANDLES
+								{
+								glTexSubImage2D( gOGLTexTarget2D, 0, 0, 0,
+												srcTexWidth,
+												srcTexHeight,
+												format, type,
+												pixels );
+									
+									// the most likely error is out-of-memory
+								if ( not ShowOpenGLErrors() )
+									returnVal = true;
+								}
 							
 //							glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );	// default
 							
-							if ( not ShowOpenGLErrors() ) // the most likely error is out-of-memory
-								returnVal = true;
-							
 #if ! USE_TEMP_HANDLES	// the DT way
-							delete[] pixels;
+							if ( not mapped )
+								delete[] pixels;
 #else	// temp memory
 							HUnlock( pixelsHandle );
 							DisposeHandle( pixelsHandle );
@@ -2720,6 +3542,21 @@ if ( ShowOpenGLErrors() )
 			++textureCount;
 #endif	// OGL_SHOW_DRAWTIME
 			
+				// 24-bit formats are padded out to 32 by every driver we care about
+			long texelBytes = 4;
+			if ( GL_RGB5 == internalFormat
+			||   GL_RGBA4 == internalFormat )
+				{
+				texelBytes = 2;
+				}
+			else if ( GL_LUMINANCE8 == internalFormat )
+				texelBytes = 1;
+			if ( gOGLHaveTexRectExtension )
+				texelBytes *= srcTexWidth * srcTexHeight;
+			else
+				texelBytes *= (*dstTexWidth) * (*dstTexHeight);
+			RegisterResidentTexture( textureObjectName, this, texelBytes );
+			
 #ifdef DEBUG_VERSION
 # if 0	// bytesPerPixels is unused unless DShowMessage() isn't a no-op
 			int bytesPerPixels;
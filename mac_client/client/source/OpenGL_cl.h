@@ -139,6 +139,21 @@ extern bool gOGLHaveBlendSubtract;
 typedef void (*glBlendEquationProcPtr)( GLenum mode );
 extern glBlendEquationProcPtr gOGLglBlendEquation;	// gOGL... is getting a bit ungainly
 
+// extern bool gOGLHavePixelBufferObject;
+// core api:  2.1
+// extension:  1.5 (or 1.1 + GL_ARB_vertex_buffer_object) if GL_ARB_pixel_buffer_object
+// we only use it as an unpack source, so texture uploads can return before the
+// driver has finished copying the pixels
+#ifndef GL_PIXEL_UNPACK_BUFFER_ARB
+	#define GL_PIXEL_UNPACK_BUFFER_ARB	0x88EC
+#endif	// GL_PIXEL_UNPACK_BUFFER_ARB
+
+// extern bool gOGLHaveVersion_2_0;
+// core api:  2.0
+// needed for the fragment program that draws index textures through the palette;
+// see gOGLUseIndexedTextures below
+extern bool gOGLUseIndexedTextures;	// images are uploaded as 8-bit global color indices
+
 
 // todo: integrate these better
 extern GLuint gOGLTexTarget2D;	// gOGLNominalTextureTarget2D ?
@@ -221,20 +236,21 @@ const int kLightmapMaximumRadius = kLightmapScaleCircleArraySize - 1;
 	// more than that doesn't really make much sense
 	// since there's already enough weirdness with
 	// lights popping on as mobiles enter the playfield
-// extern int gCachedCircularLightmapElementRadius;
 
-void qdLightmapCircularElementBlitter(
-	Ptr baseAddr,
-	int rowBytes,
+	// Lightmap_cl.cp
+	// qdClearLightmap() starts a frame, the caster and clamp calls queue
+	// work, and qdFinishLightmap() composites it all into gLightmapGWorld
+void qdClearLightmap( const RGBColor& moonlight, const RGBColor& starlight );
+void qdQueueLightmapCaster(
 	const Point& center,
 	int radius,
 	int minimumRadius,
 	const RGBColor& colorus,
 	bool lightdarkcaster
 );
-void qdClearLightmap( const RGBColor& moonlight, const RGBColor& starlight );
-void qdApplyLightmap();
 void qdClampLightmap( float nightCLampColor );
+void qdFinishLightmap();
+void qdApplyLightmap( DTSImage * dest );
 
 extern bool gOpenGLAvailable;	// determined at startup
 extern bool gUsingOpenGL;		// are we currently using ogl
@@ -630,6 +646,16 @@ void setupOpenGLGameWindow( AGLContext ctx, bool visible );
 void DeleteTextureObjects();
 void DecrementTextureObjectPriorities();
 bool deleteAllUnusedTextures();
+void TouchResidentTexture( GLuint texture );
+void ForgetResidentTexture( GLuint texture );
+void AgeResidentTextures();
+void ResetResidentTextures();
+ImageCache * selectTextureSource( ImageCache * cache );
+void ForgetTextureRemap( const ImageColorCache * ccache );
+void beginIndexedDraw( IndexToAlphaMapID alphamap, bool modulate,
+	GLfloat texelWidth = 0.0f, GLfloat texelHeight = 0.0f );
+void endIndexedDraw();
+void ResetIndexedTextures();
 //bool deleteFirstUnusedTextures();
 void drawOGLText( GLint x, GLint y, GLuint fontListBase, const char * text );
 void drawOGLText( GLint x, GLint y, GLuint fontListBase, const char * text, GLsizei length );
@@ -686,6 +712,14 @@ public:
 #ifdef OGL_SHOW_DRAWTIME
 		inline int getTextureCount() const { return textureCount; }
 #endif	// OGL_SHOW_DRAWTIME
+			
+			// the residency manager deleted one of our textures
+		inline void textureEvicted()
+			{
+#ifdef OGL_SHOW_DRAWTIME
+			--textureCount;
+#endif	// OGL_SHOW_DRAWTIME
+			}
 	
 protected:
 		virtual void load(	const DTSRect& src,
@@ -744,6 +778,7 @@ public:
 								  "invalid texture object in TextureObjectSingle" );
 #endif	// DEBUG_VERSION
 				
+				ForgetResidentTexture( name );
 				unbindTexture( name );
 				glDeleteTextures( 1, &name );
 				}
@@ -792,6 +827,7 @@ public:
 				if ( priority <= 0.0f )	// never use == with a float
 					{
 //					ShowMessage( "TextureObjectSingle priority == 0, deleting..." );
+					ForgetResidentTexture( name );
 					unbindTexture( name );
 					glDeleteTextures( 1, &name );
 					
@@ -864,6 +900,7 @@ public:
 						}
 #endif	// DEBUG_VERSION
 					
+					ForgetResidentTexture( name[i] );
 					unbindTexture( name[i] );
 					}
 				
@@ -932,6 +969,7 @@ public:
 					if ( name[i] && priority[i] <= 0.0f )	// never use == with a float
 						{
 						ShowMessage( "TextureObjectNAnimated priority == 0, deleting..." );
+						ForgetResidentTexture( name[i] );
 						unbindTexture( name[i] );
 						glDeleteTextures( 1, &name[i] );
 						
@@ -1017,6 +1055,7 @@ public:
 						}
 #endif	// DEBUG_VERSION
 					
+					ForgetResidentTexture( name[w][h] );
 					unbindTexture( name[w][h] );
 					}
 				}
@@ -1083,6 +1122,7 @@ public:
 						if ( name[w][h] && priority[w][h] <= 0.0f )	// never use == with a float
 							{
 							ShowMessage( "TextureObjectMobileArray priority == 0, deleting..." );
+							ForgetResidentTexture( name[w][h] );
 							unbindTexture( name[w][h] );
 							glDeleteTextures( 1, &name[w][h] );
 							
@@ -1172,6 +1212,7 @@ public:
 						}
 #endif	// DEBUG_VERSION
 					
+					ForgetResidentTexture( name[w][h] );
 					unbindTexture( name[w][h] );
 					}
 				}
@@ -1238,6 +1279,7 @@ public:
 						if ( name[w][h] && priority[w][h] <= 0.0f )	// never use == with a float
 							{
 							ShowMessage( "TextureObjectBalloonArray priority == 0, deleting..." );
+							ForgetResidentTexture( name[w][h] );
 							unbindTexture( name[w][h] );
 							glDeleteTextures( 1, &name[w][h] );
 							
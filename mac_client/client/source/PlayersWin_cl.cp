@@ -23,6 +23,8 @@
 #include "Macros_cl.h"
 #include "SendText_cl.h"
 
+#include <dispatch/dispatch.h>
+
 
 #define ALLOW_MACRO_CLICKS		1
 
@@ -261,7 +263,11 @@ class PlayerInfo
 		kHeaderIndex	= 0,
 		
 		kVersion		= 0x0001,
-		kDeleteDelay	= 30 * 24 * 3600		// a month (in seconds)
+		kDeleteDelay	= 30 * 24 * 3600,		// a month (in seconds)
+		
+		kSaveDelay		= 5 * 60,				// most a save waits to be written (in ticks)
+		kSaveBatch		= 32,					// most records written per idle
+		kCompressBatch	= 64					// most records moved per idle, when rebuilding
 		};
 public:
 	enum
@@ -302,16 +308,29 @@ static bool			FindPlayerID( const char * name, DTSKeyType& outType,
 						DTSKeyID& outID, PlayerInfo& outInfo );
 
 static void			OpenFile();
+static void			OpenFile( DTSFileSpec * fs );
 static void			CloseFile();
+static void			PrefetchFile();
+static bool			WaitForFile();
+static void			RunPrefetch( void * );
+static void			ShowConvertNote();
 static DTSError		Convert( int inVersion = kVersion );
 static DTSError		Stats( char * outtext );
 static DTSError		CompressFile();
+static void			RequestCompress()	{ sCompressRequested = true; }
 
 static DTSError		SavePlayer( const PlayerNode * player );
 static bool			LoadPlayer( PlayerNode * player );
+static void			Idle();
+static DTSError		Flush( int maxRecords );
+static DTSError		WriteInfo( PlayerInfo info );
 
 static DTSError		sFileError;
 static DTSKeyFile	sFile;
+static bool			sCompressRequested;		// rebuild the file, a bit at a time
+static dispatch_group_t	sPrefetchGroup;		// opening the file, on another thread
+static DTSFileSpec	sPrefetchSpec;
+static char			sConvertNote[ 80 ];	// Convert()'s report, for the main thread
 
 					// constructor
 			PlayerInfo()
@@ -348,6 +367,9 @@ static DTSKeyFile	sFile;
 **	list would never become onerous. What's more, one can easily imagine desiring to
 **	sort the player-list by other criteria than names: e.g., by clan or class or date-fell...
 **  but the present structure makes that exceedingly tough.
+**
+**	Lookups by name don't use the tree any more, though: see CPlayerIndex, below.
+**	The tree is only splayed to find where a new player goes, or to remove one.
 */
 class PlayerNode
 {
@@ -358,6 +380,7 @@ public:
 	PlayerNode *	pnPrev;
 	
 	char			pnName[ kMaxNameLen ];
+	char			pnKey[ kMaxNameLen ];	// pnName as NameComparison() sees it
 	char			pnLocFell[ 32 ];
 	char			pnKillerName[ 32 ];
 	uint			pnFlags;
@@ -378,6 +401,7 @@ public:
 						pnPictCacheID( kNewbieRacelessPlayerPict )
 					{
 					StringCopySafe( pnName, name, sizeof pnName );
+					CompactName( name, pnKey, sizeof pnKey );
 					
 					pnLocFell[0] 	=
 					pnKillerName[0]	= '\0';
@@ -414,6 +438,100 @@ public:
 };
 
 
+//
+//	CPlayerIndex - finds the player nodes in the tree by name
+//
+//	An open-addressed hash table, keyed by pnKey, so names match just as they do
+//	for NameComparison(). The nodes themselves never move, so the pointers it hands
+//	out stay good until the player is removed. Find() changes nothing at all --
+//	unlike SplayPlayer(), which reshapes the tree on every lookup -- so reads
+//	don't need to be on the same thread as the Players window, only kept from
+//	overlapping with Add(), Remove() and Clear().
+//
+class CPlayerIndex
+{
+public:
+						CPlayerIndex() :
+							mSlots( nullptr ),
+							mCapacity( 0 ),
+							mCount( 0 )
+						{}
+						~CPlayerIndex()		{ delete[] mSlots; }
+	
+	PlayerNode *		Find( const char * key ) const;
+	void				Add( PlayerNode * player );
+	void				Remove( const PlayerNode * player );
+	void				Clear();
+	
+	int					GetCount() const	{ return mCount; }
+	static uint			Hash( const char * key );
+
+private:
+	struct SSlot
+		{
+		PlayerNode *		mPlayer;		// or nullptr, if empty
+		uint				mHash;
+		};
+	
+	SSlot *				mSlots;
+	int					mCapacity;		// always a power of two
+	int					mCount;
+	
+	void				Grow();
+	
+	// declared but not defined
+						CPlayerIndex( const CPlayerIndex& );
+	CPlayerIndex&		operator=( const CPlayerIndex& );
+};
+
+
+//
+//	CPlayerSaveQueue - player records waiting to be written to CL_Players
+//
+//	Players get saved whenever they leave, change clothes, or take up the lute,
+//	which during a busy /who or a ResetPlayers() can be hundreds at once. Rather
+//	than write each one through on the spot, SavePlayer() parks a copy here, and
+//	PlayerInfo::Idle() writes them out in batches. Saving the same player again
+//	before then just updates the copy that's already waiting.
+//
+class CPlayerSaveQueue
+{
+public:
+	struct SEntry
+		{
+		PlayerInfo			mInfo;			// native byte order; mName is filled in
+		uint				mHash;			// of the name
+		ulong				mQueued;		// [ticks] when first queued
+		};
+	
+						CPlayerSaveQueue() :
+							mEntries( nullptr ),
+							mCapacity( 0 ),
+							mCount( 0 )
+						{}
+						~CPlayerSaveQueue()	{ delete[] mEntries; }
+	
+	const SEntry *		Find( const char * name ) const;
+	void				Add( const char * name, const PlayerInfo& info );
+	void				RemoveFirst( int count );
+	void				Clear()				{ mCount = 0; }
+	
+	int					GetCount() const	{ return mCount; }
+	const SEntry&		GetEntry( int n ) const		{ return mEntries[ n ]; }
+
+private:
+	SEntry *			mEntries;		// oldest first
+	int					mCapacity;
+	int					mCount;
+	
+	void				Grow();
+	
+	// declared but not defined
+						CPlayerSaveQueue( const CPlayerSaveQueue& );
+	CPlayerSaveQueue&	operator=( const CPlayerSaveQueue& );
+};
+
+
 //
 //	PlayersList - list container for player nodes in the Players window
 //
@@ -534,10 +652,16 @@ static void				BigToNativeEndian( PlayerInfo& info );
 /*
 **	Internal Variables
 */
-	// gPlayersRoot is the current root of the node tree, i.e. the most-recently-looked-up
-	// player. It changes very frequently.
+	// gPlayersRoot is the current root of the node tree, i.e. the most-recently-added
+	// player (or a neighbor of the most-recently-removed one).
 static PlayerNode *			gPlayersRoot;
 
+	// every node in the tree, by name
+static CPlayerIndex			gPlayerIndex;
+
+	// players saved, but not yet written to CL_Players
+static CPlayerSaveQueue		gPlayerSaves;
+
 	// gPlayersHead/Tail are the ends of the doubly-linked-list; they don't change often
 	// (unless an alphabetically-extreme player is added or removed)
 static PlayerNode *			gPlayersHead;
@@ -567,6 +691,10 @@ bool						gPlayersListIsStale = true;
 	// class statics
 DTSError					PlayerInfo::sFileError;
 DTSKeyFile					PlayerInfo::sFile;
+bool						PlayerInfo::sCompressRequested;
+dispatch_group_t			PlayerInfo::sPrefetchGroup;
+DTSFileSpec					PlayerInfo::sPrefetchSpec;
+char						PlayerInfo::sConvertNote[ 80 ];
 FriendsList *				FriendsList::sFriendsListRoot;
 
 
@@ -634,6 +762,18 @@ MyGetDateTime( UInt32 * when )
 }
 
 
+/*
+**	PrefetchPlayers()
+**	start opening the CL_Players file on another thread, at startup,
+**	so that InitPlayers() finds it ready
+*/
+void
+PrefetchPlayers()
+{
+	PlayerInfo::PrefetchFile();
+}
+
+
 /*
 **	InitPlayers()
 **	get ready for action, just after sign-on (or start of movie playback)
@@ -642,7 +782,10 @@ void
 InitPlayers()
 {
 	ResetPlayers();
-	PlayerInfo::OpenFile();
+	
+	// the first time, PrefetchPlayers() has probably already opened the file
+	if ( not PlayerInfo::WaitForFile() )
+		PlayerInfo::OpenFile();
 }
 
 
@@ -689,6 +832,7 @@ ResetPlayers()
 	gPlayersTail 		= nullptr;
 	gPlayersRoot 		= nullptr;
 	gPlayersHead		= nullptr;
+	gPlayerIndex.Clear();
 	
 	ClearSelection();
 	
@@ -702,6 +846,7 @@ ResetPlayers()
 /*
 **	CompressPlayers()
 **	perform a full rebuild of the CL_Players file
+**	the work is done a little at a time, by IdlePlayers()
 */
 static void
 CompressPlayers()
@@ -711,11 +856,25 @@ CompressPlayers()
 	if ( kGenericOk == result )
 		{
 		ResetPlayers();
-		PlayerInfo::CompressFile();
+		PlayerInfo::WaitForFile();
+		PlayerInfo::RequestCompress();
 		}
 }
 
 
+/*
+**	IdlePlayers()
+**
+**	Called from CLApp::Idle().
+**	Write out saved players, and get on with any rebuild of CL_Players.
+*/
+void
+IdlePlayers()
+{
+	PlayerInfo::Idle();
+}
+
+
 /*
 **	RequestPlayersData()
 **
@@ -2092,12 +2251,12 @@ SplayPlayer( PlayerNode * tree, const char * name )
 	
 	while ( true )
 		{
-		int dir = NameComparisonFixed( cname, tree->pnName );
+		int dir = strcmp( cname, tree->pnKey );
 		if ( dir < 0 )
 			{
 			if ( not tree->pnLeft )
 				break;
-			if ( NameComparisonFixed( cname, tree->pnLeft->pnName ) < 0 )
+			if ( strcmp( cname, tree->pnLeft->pnKey ) < 0 )
 				{
 				tmp = tree->pnLeft;
 				tree->pnLeft = tmp->pnRight;
@@ -2115,7 +2274,7 @@ SplayPlayer( PlayerNode * tree, const char * name )
 			{
 			if ( not tree->pnRight )
 				break;
-			if ( NameComparisonFixed( cname, tree->pnRight->pnName ) > 0 )
+			if ( strcmp( cname, tree->pnRight->pnKey ) > 0 )
 				{
 				tmp = tree->pnRight;
 				tree->pnRight = tmp->pnLeft;
@@ -2131,7 +2290,7 @@ SplayPlayer( PlayerNode * tree, const char * name )
 		else
 			break;
 		
-		dir = NameComparisonFixed( cname, tree->pnName );
+		dir = strcmp( cname, tree->pnKey );
 		if ( dir < 0 )
 			{
 			if ( not tree->pnLeft )
@@ -2152,7 +2311,7 @@ SplayPlayer( PlayerNode * tree, const char * name )
 		else
 			break;
 		
-		dir = NameComparisonFixed( cname, tree->pnName );
+		dir = strcmp( cname, tree->pnKey );
 		if ( dir < 0 )
 			{
 			if ( not tree->pnLeft )
@@ -2173,7 +2332,7 @@ SplayPlayer( PlayerNode * tree, const char * name )
 		else
 			break;
 		
-		dir = NameComparisonFixed( cname, tree->pnName );
+		dir = strcmp( cname, tree->pnKey );
 		if ( dir < 0 )
 			{
 			if ( not tree->pnLeft )
@@ -2204,6 +2363,249 @@ SplayPlayer( PlayerNode * tree, const char * name )
 }
 
 
+/*
+**	CPlayerIndex::Hash()
+**
+**	FNV-1a, over a compacted name
+*/
+uint
+CPlayerIndex::Hash( const char * key )
+{
+	uint32_t hash = 2166136261U;
+	for ( const uchar * p = reinterpret_cast<const uchar *>( key );  *p;  ++p )
+		{
+		hash ^= *p;
+		hash *= 16777619U;
+		}
+	return hash;
+}
+
+
+/*
+**	CPlayerIndex::Find()
+**
+**	return the node whose pnKey matches, or nullptr
+*/
+PlayerNode *
+CPlayerIndex::Find( const char * key ) const
+{
+	if ( not mCount )
+		return nullptr;
+	
+	uint hash = Hash( key );
+	uint mask = mCapacity - 1;
+	for ( uint index = hash & mask;  ;  index = (index + 1) & mask )
+		{
+		const SSlot& slot = mSlots[ index ];
+		if ( not slot.mPlayer )
+			return nullptr;
+		if ( slot.mHash == hash
+		&&   0 == strcmp( slot.mPlayer->pnKey, key ) )
+			{
+			return slot.mPlayer;
+			}
+		}
+}
+
+
+/*
+**	CPlayerIndex::Add()
+**
+**	index a node that's just gone into the tree
+*/
+void
+CPlayerIndex::Add( PlayerNode * player )
+{
+	// keep it no more than half full
+	if ( 2 * (mCount + 1) > mCapacity )
+		Grow();
+	
+	uint hash = Hash( player->pnKey );
+	uint mask = mCapacity - 1;
+	uint index = hash & mask;
+	while ( mSlots[ index ].mPlayer )
+		index = (index + 1) & mask;
+	
+	mSlots[ index ].mPlayer	= player;
+	mSlots[ index ].mHash	= hash;
+	++mCount;
+}
+
+
+/*
+**	CPlayerIndex::Remove()
+**
+**	forget a node that's about to leave the tree
+*/
+void
+CPlayerIndex::Remove( const PlayerNode * player )
+{
+	if ( not mCount )
+		return;
+	
+	uint mask = mCapacity - 1;
+	uint index = Hash( player->pnKey ) & mask;
+	while ( mSlots[ index ].mPlayer != player )
+		{
+		if ( not mSlots[ index ].mPlayer )
+			return;
+		index = (index + 1) & mask;
+		}
+	
+	// close up the gap, so later probes don't stop short:
+	// move back any entry that no longer sits between its home and the hole
+	uint hole = index;
+	for ( index = (index + 1) & mask;  mSlots[ index ].mPlayer;  index = (index + 1) & mask )
+		{
+		uint home = mSlots[ index ].mHash & mask;
+		if ( ((index - home) & mask) >= ((index - hole) & mask) )
+			{
+			mSlots[ hole ] = mSlots[ index ];
+			hole = index;
+			}
+		}
+	mSlots[ hole ].mPlayer = nullptr;
+	--mCount;
+}
+
+
+/*
+**	CPlayerIndex::Clear()
+**
+**	forget everything (but keep the table, since it'll soon be refilled)
+*/
+void
+CPlayerIndex::Clear()
+{
+	if ( mSlots )
+		bzero( mSlots, mCapacity * sizeof *mSlots );
+	mCount = 0;
+}
+
+
+/*
+**	CPlayerIndex::Grow()
+**
+**	double the table, and re-place everything in it
+*/
+void
+CPlayerIndex::Grow()
+{
+	int oldCapacity = mCapacity;
+	SSlot * oldSlots = mSlots;
+	
+	mCapacity = oldCapacity ? 2 * oldCapacity : 256;
+	mSlots = NEW_TAG("CPlayerIndex") SSlot[ mCapacity ];
+	CheckPointer( mSlots );
+	bzero( mSlots, mCapacity * sizeof *mSlots );
+	
+	uint mask = mCapacity - 1;
+	for ( int old = 0;  old < oldCapacity;  ++old )
+		{
+		if ( not oldSlots[ old ].mPlayer )
+			continue;
+		uint index = oldSlots[ old ].mHash & mask;
+		while ( mSlots[ index ].mPlayer )
+			index = (index + 1) & mask;
+		mSlots[ index ] = oldSlots[ old ];
+		}
+	
+	delete[] oldSlots;
+}
+
+
+/*
+**	CPlayerSaveQueue::Find()
+**
+**	return the waiting entry for this player, or nullptr
+*/
+const CPlayerSaveQueue::SEntry *
+CPlayerSaveQueue::Find( const char * name ) const
+{
+	uint hash = CPlayerIndex::Hash( name );
+	size_t len = strlen( name );
+	for ( int n = 0;  n < mCount;  ++n )
+		{
+		const SEntry& entry = mEntries[ n ];
+		if ( entry.mHash == hash
+		&&   len == uchar( entry.mInfo.mName[0] )
+		&&   0 == strncmp( name, &entry.mInfo.mName[1], len ) )
+			{
+			return &entry;
+			}
+		}
+	
+	return nullptr;
+}
+
+
+/*
+**	CPlayerSaveQueue::Add()
+**
+**	queue a player's info for writing,
+**	or update it if they're already waiting
+*/
+void
+CPlayerSaveQueue::Add( const char * name, const PlayerInfo& info )
+{
+	if ( const SEntry * found = Find( name ) )
+		{
+		// keep its place in line
+		const_cast<SEntry *>( found )->mInfo = info;
+		return;
+		}
+	
+	if ( mCount >= mCapacity )
+		Grow();
+	
+	SEntry& entry = mEntries[ mCount++ ];
+	entry.mInfo   = info;
+	entry.mHash   = CPlayerIndex::Hash( name );
+	entry.mQueued = GetFrameCounter();
+}
+
+
+/*
+**	CPlayerSaveQueue::RemoveFirst()
+**
+**	forget the oldest few entries, once they've been written
+*/
+void
+CPlayerSaveQueue::RemoveFirst( int count )
+{
+	if ( count >= mCount )
+		{
+		mCount = 0;
+		return;
+		}
+	
+	mCount -= count;
+	memmove( mEntries, mEntries + count, mCount * sizeof *mEntries );
+}
+
+
+/*
+**	CPlayerSaveQueue::Grow()
+**
+**	double the queue
+*/
+void
+CPlayerSaveQueue::Grow()
+{
+	int oldCapacity = mCapacity;
+	SEntry * oldEntries = mEntries;
+	
+	mCapacity = oldCapacity ? 2 * oldCapacity : 64;
+	mEntries = NEW_TAG("CPlayerSaveQueue") SEntry[ mCapacity ];
+	CheckPointer( mEntries );
+	
+	for ( int n = 0;  n < mCount;  ++n )
+		mEntries[ n ] = oldEntries[ n ];
+	
+	delete[] oldEntries;
+}
+
+
 /*
 **	UpdatePlayer()
 **
@@ -2247,15 +2649,14 @@ UpdatePlayer(	const char * name,
 		return false;
 	
 	// look up the name
-	gPlayersRoot = SplayPlayer( gPlayersRoot, name );
-	
 	char fixedName[ kMaxNameLen ];
 	CompactName( name, fixedName, sizeof fixedName );
 	
-	if ( not gPlayersRoot
-	||	 0 != NameComparisonFixed( fixedName, gPlayersRoot->pnName ) )
+	PlayerNode * found = gPlayerIndex.Find( fixedName );
+	if ( not found )
 		{
-		// not found in tree
+		// not found in tree; splay it to find where the new node should go
+		gPlayersRoot = SplayPlayer( gPlayersRoot, name );
 		PlayerNode * tmp = nullptr;
 		
 		//
@@ -2407,12 +2808,15 @@ UpdatePlayer(	const char * name,
 			{
 			++gPlayersList.plSelectNum;
 			}
+		
+		found = gPlayersRoot;
+		gPlayerIndex.Add( found );
 		}
 	
-	changed |= gPlayersRoot->UpdateFlags( flags, mask );
+	changed |= found->UpdateFlags( flags, mask );
 	
 	if ( player )
-		*player = gPlayersRoot;
+		*player = found;
 	
 	if ( updateList )
 		{
@@ -2445,12 +2849,13 @@ RemovePlayer( const char * name )
 	if ( not win )
 		return false;
 	
-	if ( not gPlayersRoot )
+	char fixedName[ kMaxNameLen ];
+	CompactName( name, fixedName, sizeof fixedName );
+	if ( not gPlayerIndex.Find( fixedName ) )
 		return false;
 	
 	gPlayersRoot = SplayPlayer( gPlayersRoot, name );
-	if ( NameComparison( name, gPlayersRoot->pnName ) != 0 )
-		return false;
+	gPlayerIndex.Remove( gPlayersRoot );
 	
 	// Remove it from the tree;
 	PlayerNode * tmp;
@@ -3734,7 +4139,7 @@ ParseInfoText( const char * text, BEPPrefixID bepID, MsgClasses * msgClass )
 bool
 ParseThinkText( DescTable * target )
 {
-	const char * text = target->descBubbleText;
+	const char * text = target->BubbleText();
 	char name[ kMaxNameLen ];
 
 #if defined( MULTILINGUAL )
@@ -4331,7 +4736,20 @@ PlayerInfo::OpenFile()
 	
 	DTSFileSpec fs;
 	fs.SetFileName( kClientPlayersFName );
-	sFileError = sFile.Open( &fs, kKeyReadWritePerm | kKeyCreateFile, rClientPlayersFREF );
+	OpenFile( &fs );
+	ShowConvertNote();
+}
+
+
+/*
+**	PlayerInfo::OpenFile()
+**
+**	the same, for a file that's been found already
+*/
+void
+PlayerInfo::OpenFile( DTSFileSpec * fs )
+{
+	sFileError = sFile.Open( fs, kKeyReadWritePerm | kKeyCreateFile, rClientPlayersFREF );
 	
 	if ( sFileError )
 		return;
@@ -4455,7 +4873,10 @@ PlayerInfo::Convert( int inVersion )
 	if ( noErr == error && (converted || deleted) )
 		{
 		CompressFile();
-		ShowMessage( BULLET " Updated CL_Player. %d entries, deleted %d, converted %d",
+		
+		// this may be the prefetch thread, which mustn't touch the message window
+		snprintf( sConvertNote, sizeof sConvertNote,
+			BULLET " Updated CL_Player. %d entries, deleted %d, converted %d",
 			total, deleted, converted );
 		}
 	
@@ -4485,6 +4906,10 @@ GatherPlayerFileStats( char * outtext )
 DTSError
 PlayerInfo::Stats( char * outtext )
 {
+	// count the waiting saves too
+	WaitForFile();
+	Flush( INT_MAX );
+	
 	long types;
 	DTSError error = sFile.CountTypes( &types );
 	
@@ -4615,23 +5040,116 @@ PlayerInfo::Stats( char * outtext )
 
 /*
 **	PlayerInfo::CloseFile()			[static]
+**
+**	finish whatever's still waiting to be done to the file first
 */
 void
 PlayerInfo::CloseFile()
 {
+	WaitForFile();
+	
+	if ( sCompressRequested )
+		CompressFile();
+	else
+		Flush( INT_MAX );
+	sCompressRequested = false;
+	gPlayerSaves.Clear();
+	
 	sFile.Close();
 	sFileError = 0;
 }
 
 
+/*
+**	PlayerInfo::PrefetchFile()		[static]
+**
+**	open the file on a background queue. Only the file, and the saves waiting
+**	for it (there are none yet), are touched there; the main thread leaves them
+**	alone until WaitForFile() says it's done.
+*/
+void
+PlayerInfo::PrefetchFile()
+{
+	if ( sPrefetchGroup )
+		return;
+	
+	// find it relative to the current folder now, rather than whenever
+	// the other thread gets round to it
+	sPrefetchSpec.GetCurDir();
+	sPrefetchSpec.SetFileName( kClientPlayersFName );
+	
+	sPrefetchGroup = dispatch_group_create();
+	dispatch_group_async_f( sPrefetchGroup,
+		dispatch_get_global_queue( DISPATCH_QUEUE_PRIORITY_DEFAULT, 0 ),
+		nullptr, RunPrefetch );
+}
+
+
+/*
+**	PlayerInfo::RunPrefetch()		[static]
+**
+**	background queue: open (and if need be, convert) the file
+*/
+void
+PlayerInfo::RunPrefetch( void * )
+{
+	CFAbsoluteTime started = CFAbsoluteTimeGetCurrent();
+	OpenFile( &sPrefetchSpec );
+	TraceStartupTask( "PlayerInfo::OpenFile", started );
+}
+
+
+/*
+**	PlayerInfo::WaitForFile()		[static]
+**
+**	wait for PrefetchFile()'s work to finish, if it was started.
+**	return true if it was, and it left the file open.
+*/
+bool
+PlayerInfo::WaitForFile()
+{
+	if ( not sPrefetchGroup )
+		return false;
+	
+	dispatch_group_wait( sPrefetchGroup, DISPATCH_TIME_FOREVER );
+	dispatch_release( sPrefetchGroup );
+	sPrefetchGroup = nullptr;
+	ShowConvertNote();
+	
+	return noErr == sFileError;
+}
+
+
+/*
+**	PlayerInfo::ShowConvertNote()		[static]
+**
+**	main thread: pass on what Convert() did, if anything
+*/
+void
+PlayerInfo::ShowConvertNote()
+{
+	if ( sConvertNote[0] )
+		{
+		ShowMessage( "%s", sConvertNote );
+		sConvertNote[0] = '\0';
+		}
+}
+
+
 /*
 **	PlayerInfo::CompressFile()		[static]
 **
-**	rebuild the CL_players file by compressing it
+**	rebuild the CL_players file by compressing it, all at once
 */
 DTSError
 PlayerInfo::CompressFile()
 {
+	// finish any rebuild that's under way, so the waiting saves can go in first
+	if ( sFile.IsCompressing() )
+		sFile.Compress();
+	Flush( INT_MAX );
+	
+	sCompressRequested = false;
 	return sFile.Compress();
 }
 
@@ -4721,14 +5239,8 @@ PlayerInfo::SavePlayer( const PlayerNode * player )
 	// would be nice to have similar tests for ranger morphs, costume rentals, etc.
 	// see comment above re other potentially "non-client-cached" pictures.
 	
-	// look up the player's icon-cache-file type and ID, ignoring saved info record
-	PlayerInfo info;
-	DTSKeyType nameID;
-	DTSKeyID nameI;
-	FindPlayerID( player->pnName, nameID, nameI, info );
-	
 	// install newest info data, dated as of this very instant
-	info = player->pnInfo;
+	PlayerInfo info = player->pnInfo;
 	UInt32 now;
 	MyGetDateTime( &now );
 	info.mLastSeen = now;
@@ -4737,6 +5249,114 @@ PlayerInfo::SavePlayer( const PlayerNode * player )
 	info.mName[0] = strlen( player->pnName );
 	memcpy( &info.mName[1], player->pnName, info.mName[0] );
 	
+	// Idle() will write it out, soon
+	gPlayerSaves.Add( player->pnName, info );
+	
+	return noErr;
+}
+
+
+/*
+**	PlayerInfo::Idle()
+**
+**	write out the waiting saves, once there are enough of them, or once
+**	the oldest has waited long enough. Or, if the file is being rebuilt,
+**	move a few more records; the saves wait till that's done.
+*/
+void
+PlayerInfo::Idle()
+{
+	// not while the file is still opening
+	if ( sPrefetchGroup )
+		{
+		if ( 0 != dispatch_group_wait( sPrefetchGroup, DISPATCH_TIME_NOW ) )
+			return;
+		WaitForFile();
+		}
+	
+	int count = gPlayerSaves.GetCount();
+	
+	if ( sCompressRequested )
+		{
+		// everything saved before the rebuild was asked for goes in first
+		if ( count && not sFile.IsCompressing() )
+			Flush( kSaveBatch );
+		else
+			{
+			bool done = false;
+			if ( sFile.CompressSome( kCompressBatch, &done ) != noErr
+			||   done )
+				{
+				sCompressRequested = false;
+				}
+			}
+		return;
+		}
+	
+	if ( count >= kSaveBatch
+	||	 ( count && GetFrameCounter() - gPlayerSaves.GetEntry( 0 ).mQueued >= kSaveDelay ) )
+		{
+		Flush( kSaveBatch );
+		}
+}
+
+
+/*
+**	PlayerInfo::Flush()
+**
+**	write out the oldest few waiting saves
+*/
+DTSError
+PlayerInfo::Flush( int maxRecords )
+{
+	// can't write while the file's being rebuilt
+	if ( sFile.IsCompressing() )
+		return kKeyFileCompressing;
+	
+	int count = gPlayerSaves.GetCount();
+	if ( count > maxRecords )
+		count = maxRecords;
+	if ( count <= 0 )
+		return noErr;
+	
+	// only update the file's table once, at the end of the batch
+	int oldMode = sFile.SetWriteMode( kWriteModeFaster );
+	
+	DTSError result = noErr;
+	for ( int n = 0;  n < count;  ++n )
+		{
+		DTSError err = WriteInfo( gPlayerSaves.GetEntry( n ).mInfo );
+		if ( err )
+			result = err;
+		}
+	
+	sFile.SetWriteMode( oldMode );
+	
+	// the ones that failed are gone, too; there's no sense retrying them
+	gPlayerSaves.RemoveFirst( count );
+	
+	return result;
+}
+
+
+/*
+**	PlayerInfo::WriteInfo()
+**
+**	write one player's record to the file
+*/
+DTSError
+PlayerInfo::WriteInfo( PlayerInfo info )
+{
+	char name[ kMaxNameLen + 1 ];
+	memcpy( name, &info.mName[1], uchar( info.mName[0] ) );
+	name[ uchar( info.mName[0] ) ] = '\0';
+	
+	// look up the player's icon-cache-file type and ID, ignoring saved info record
+	PlayerInfo saved;
+	DTSKeyType nameID;
+	DTSKeyID nameI;
+	FindPlayerID( name, nameID, nameI, saved );
+	
 	// dump to file
 	size_t len = offsetof( PlayerInfo, mName ) + 1 + info.mName[0];
 	NativeToBigEndian( info );
@@ -4744,7 +5364,7 @@ PlayerInfo::SavePlayer( const PlayerNode * player )
 	
 #ifdef DEBUG_VERSION
 	if ( err )
-		ShowMessage( "Error %d writing entry '%s'", (int) err, player->pnName );
+		ShowMessage( "Error %d writing entry '%s'", (int) err, name );
 #endif
 	
 	return err;
@@ -4760,6 +5380,13 @@ PlayerInfo::LoadPlayer( PlayerNode * player )
 	if ( sFileError != noErr )
 		return false;
 	
+	// a save that hasn't been written yet is the latest word
+	if ( const CPlayerSaveQueue::SEntry * waiting = gPlayerSaves.Find( player->pnName ) )
+		{
+		player->pnInfo = waiting->mInfo;
+		return true;
+		}
+	
 	PlayerInfo info;
 	DTSKeyType nameID;
 	DTSKeyID nameI;
@@ -5010,3 +5637,114 @@ ListShares( SafeString * dst, bool bOutbound )
 		}
 }
 
+
+#pragma mark -
+
+
+/*
+**	PlayerIndexBenchmark()
+**
+**	time the name lookups done while drawing, both through CPlayerIndex and through
+**	the old splay-tree walk, for a made-up history of 'numPlayers' players.
+**	Each round looks up a screenful of names, as if none of their descriptors had a
+**	cached descPlayerRef. Nothing here touches the real Players window.
+*/
+void
+PlayerIndexBenchmark( int numPlayers, int rounds, SPlayerBenchmark * oResult )
+{
+	static const char * const syllables[] =
+		{
+		"ka", "lo", "re", "mi", "tu", "sa", "no", "vi",
+		"da", "el", "or", "an", "qu", "ye", "zo", "ph"
+		};
+	enum { kOnScreen = 100 };
+	
+	bzero( oResult, sizeof *oResult );
+	oResult->pbPlayers	= numPlayers;
+	oResult->pbLookups	= rounds * kOnScreen;
+	
+	PlayerNode ** nodes = NEW_TAG("PlayerIndexBenchmark") PlayerNode *[ numPlayers ];
+	CheckPointer( nodes );
+	
+	// name them, four syllables apiece
+	for ( int nnn = 0;  nnn < numPlayers;  ++nnn )
+		{
+		char name[ kMaxNameLen ];
+		snprintf( name, sizeof name, "%s%s%s%s",
+			syllables[ (nnn >> 12) & 15 ], syllables[ (nnn >> 8) & 15 ],
+			syllables[ (nnn >> 4) & 15 ], syllables[ nnn & 15 ] );
+		name[ 0 ] = toupper( name[ 0 ] );
+		nodes[ nnn ] = NEW_TAG("PlayerIndexBenchmark") PlayerNode( name );
+		CheckPointer( nodes[ nnn ] );
+		}
+	
+	// build both, in a scrambled order
+	CPlayerIndex index;
+	PlayerNode * root = nullptr;
+	EventTime start = GetCurrentEventTime();
+	for ( int nnn = 0;  nnn < numPlayers;  ++nnn )
+		{
+		PlayerNode * node = nodes[ (nnn * 7919) % numPlayers ];
+		root = SplayPlayer( root, node->pnName );
+		if ( root )
+			{
+			if ( strcmp( node->pnKey, root->pnKey ) < 0 )
+				{
+				node->pnLeft	= root->pnLeft;
+				node->pnRight	= root;
+				root->pnLeft	= nullptr;
+				}
+			else
+				{
+				node->pnRight	= root->pnRight;
+				node->pnLeft	= root;
+				root->pnRight	= nullptr;
+				}
+			}
+		root = node;
+		}
+	oResult->pbTreeBuildSeconds = GetCurrentEventTime() - start;
+	
+	start = GetCurrentEventTime();
+	for ( int nnn = 0;  nnn < numPlayers;  ++nnn )
+		index.Add( nodes[ (nnn * 7919) % numPlayers ] );
+	oResult->pbIndexBuildSeconds = GetCurrentEventTime() - start;
+	
+	// the same crowd is on screen for a while, then moves on
+	int misses = 0;
+	start = GetCurrentEventTime();
+	for ( int round = 0;  round < rounds;  ++round )
+		{
+		for ( int nnn = 0;  nnn < kOnScreen;  ++nnn )
+			{
+			const PlayerNode * want = nodes[ ((round / 50) * 131 + nnn * 97) % numPlayers ];
+			root = SplayPlayer( root, want->pnName );
+			char key[ kMaxNameLen ];
+			CompactName( want->pnName, key, sizeof key );
+			if ( root != want || strcmp( key, root->pnKey ) )
+				++misses;
+			}
+		}
+	oResult->pbTreeSeconds = GetCurrentEventTime() - start;
+	
+	start = GetCurrentEventTime();
+	for ( int round = 0;  round < rounds;  ++round )
+		{
+		for ( int nnn = 0;  nnn < kOnScreen;  ++nnn )
+			{
+			const PlayerNode * want = nodes[ ((round / 50) * 131 + nnn * 97) % numPlayers ];
+			char key[ kMaxNameLen ];
+			CompactName( want->pnName, key, sizeof key );
+			if ( index.Find( key ) != want )
+				++misses;
+			}
+		}
+	oResult->pbIndexSeconds = GetCurrentEventTime() - start;
+	
+	if ( misses )
+		GenericError( _(TXTCL_CMD_BENCHMARK_PLAYERS_FAILED), misses );
+	
+	for ( int nnn = 0;  nnn < numPlayers;  ++nnn )
+		delete nodes[ nnn ];
+	delete[] nodes;
+}
@@ -0,0 +1,849 @@
+/*
+**	RangeDownload_cl.cp		Clanlord Client
+** 
+**	Copyright 2023 Delta Tao Software, Inc.
+** 
+**	Licensed under the Apache License, Version 2.0 (the "License");
+**	you may not use this file except in compliance with the License.
+**	You may obtain a copy of the License at
+** 
+**     https://www.apache.org/licenses/LICENSE-2.0
+** 
+**	Unless required by applicable law or agreed to in writing, software
+**	distributed under the License is distributed on an "AS IS" BASIS,
+**	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+**	See the License for the specific language governing permissions and
+**	imitations under the License.
+*/
+
+/*
+**	downloads a gzipped file and expands it on the way in.
+**
+**	the file is fetched as a number of byte ranges, several at a time, each on
+**	its own CFReadStream scheduled on the main run loop. If a range's connection
+**	drops or stalls, it is asked for again from where it left off. The ranges are
+**	fed to zlib strictly in order -- a range that arrives early waits in memory --
+**	and zlib checks the gzip CRC and length as it goes, so the compressed file never
+**	touches the disk and there is no second pass over it.
+**
+**	a server that ignores Range: just sends the whole thing on the first connection,
+**	which is expanded the same way, but can't be resumed.
+**
+**	CLRangeServer (RangeServer_cl.cp) serves a file locally either way, and can cut
+**	responses off partway, to try out the resuming; see \BENCHMARK DOWNLOAD.
+*/
+
+#include <zlib.h>
+
+#include "ClanLord.h"
+#include "ProgressWin_cl.h"
+
+
+/*
+**	Entry Routines
+*/
+/*
+DTSError	DownloadInflateURL( const char * url, std::FILE * out,
+				const HFSUniStr255& name, SDownloadStats * oStats );
+*/
+
+
+/*
+**	Definitions
+*/
+const int		kRangeStreams		= 4;				// connections at once
+const int64_t	kRangeChunkSize		= 1024 * 1024;		// bytes per range request
+const int		kRangeWindow		= 16;				// most ranges ahead of the inflater
+const int		kRangeMaxRetries	= 5;				// per range
+const CFTimeInterval kRangeStallTime = 60.0;			// seconds without data before we retry
+const size_t	kInflateBufferSize	= 128 * 1024;
+
+const CFOptionFlags kRangeStreamEvents =
+			kCFStreamEventHasBytesAvailable |
+			kCFStreamEventEndEncountered |
+			kCFStreamEventErrorOccurred;
+
+enum
+{
+	kChunkWaiting,					// not asked for yet
+	kChunkActive,					// on a stream
+	kChunkDone						// all here
+};
+
+const int kProbeChunk		= -2;	// RangeStream::rsChunk for the first request
+const int kNoChunk			= -1;	// ... for an idle stream
+
+
+/*
+**	Internal Classes
+*/
+struct RangeDownload;
+
+	// one byte range of the compressed file
+struct RangeChunk
+{
+	int64_t				rcStart;		// first byte
+	int64_t				rcEnd;			// one past the last; 0 if unknown (whole-file mode)
+	int64_t				rcReceived;		// bytes of it we've got
+	int64_t				rcFed;			// bytes of it zlib has had
+	uchar *				rcData;			// the bytes, till zlib has had them all
+	int					rcState;
+	int					rcRetries;
+};
+
+	// one HTTP connection
+struct RangeStream
+{
+	RangeDownload *		rsOwner;
+	CFReadStreamRef		rsStream;		// nullptr if idle
+	int					rsChunk;		// which chunk it's fetching
+	int64_t				rsAskedFor;		// first byte we asked for
+	bool				rsChecked;		// looked at the response header yet?
+	CFAbsoluteTime		rsLastData;		// for spotting stalls
+};
+
+	// the whole job
+struct RangeDownload
+{
+	CFURLRef			rdURL;
+	std::FILE *			rdOut;
+	z_stream			rdZ;
+	bool				rdZEnded;		// zlib saw the end of a gzip member
+	bool				rdZTrailing;	// ... and what follows isn't another one
+	uchar *				rdOutBuf;
+	
+	RangeChunk *		rdChunks;
+	int					rdNumChunks;
+	int					rdNextChunk;	// next one to ask for
+	int					rdInflateChunk;	// next one for zlib
+	RangeStream			rdStreams[ kRangeStreams ];
+	
+	bool				rdWholeFile;	// the server ignored Range:
+	int64_t				rdTotal;		// compressed size; 0 if unknown
+	int64_t				rdBytesIn;
+	int64_t				rdBytesOut;
+	int					rdReconnects;
+	int					rdMostStreams;
+	DTSError			rdError;
+};
+
+
+/*
+**	Internal Routines
+*/
+static DTSError	OpenRangeStream( RangeStream * rs, int chunk, int64_t first, int64_t last );
+static void		CloseRangeStream( RangeStream * rs );
+static void		RangeStreamCallback( CFReadStreamRef, CFStreamEventType, void * );
+static bool		CheckRangeResponse( RangeStream * rs );
+static bool		SetupChunks( RangeDownload * dl, int64_t total, bool wholeFile );
+static void		ReceiveRangeData( RangeStream * rs, const uchar * data, CFIndex len );
+static void		RangeStreamEnded( RangeStream * rs );
+static void		ResumeRange( RangeStream * rs );
+static void		StartRanges( RangeDownload * dl );
+static void		PumpInflater( RangeDownload * dl );
+static void		FeedInflater( RangeDownload * dl, const uchar * data, size_t len );
+static int64_t	GetHeaderNumber( CFHTTPMessageRef response, CFStringRef field,
+					char delimiter );
+static int		CountActiveStreams( const RangeDownload * dl );
+
+
+/*
+**	DownloadInflateURL()
+**
+**	download 'url', a gzipped file, and write what it expands to into 'out'.
+**	'name' is for the progress window. Runs the event loop till it's done,
+**	the user quits, or it fails; oStats (optional) says how it went.
+*/
+DTSError
+DownloadInflateURL( const char * url, std::FILE * out, const HFSUniStr255& name,
+	SDownloadStats * oStats )
+{
+	CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
+	
+	RangeDownload dl;
+	memset( &dl, 0, sizeof dl );
+	dl.rdOut = out;
+	for ( int n = 0;  n < kRangeStreams;  ++n )
+		{
+		dl.rdStreams[ n ].rsOwner = &dl;
+		dl.rdStreams[ n ].rsChunk = kNoChunk;
+		}
+	
+	dl.rdURL = CFURLCreateWithBytes( kCFAllocatorDefault,
+					reinterpret_cast<const uchar *>( url ), strlen( url ),
+					kCFStringEncodingASCII, nullptr );
+	dl.rdOutBuf = NEW_TAG("InflateBuffer") uchar[ kInflateBufferSize ];
+	if ( not dl.rdURL || not dl.rdOutBuf )
+		dl.rdError = memFullErr;
+	
+	// 16 + MAX_WBITS: expect a gzip header, and check its CRC and length at the end
+	bool zInited = false;
+	if ( noErr == dl.rdError )
+		{
+		if ( Z_OK == inflateInit2( &dl.rdZ, 16 + MAX_WBITS ) )
+			zInited = true;
+		else
+			dl.rdError = memFullErr;
+		}
+	
+	// ask for the first range; the answer tells us how big the file is,
+	// and whether the server does ranges at all
+	if ( noErr == dl.rdError )
+		dl.rdError = OpenRangeStream( &dl.rdStreams[ 0 ], kProbeChunk, 0, kRangeChunkSize - 1 );
+	
+	// now sit around till it's done
+	if ( noErr == dl.rdError )
+		{
+		StProgressWindow pw( name );
+		
+		while ( noErr == dl.rdError
+		&&		not ( dl.rdChunks && dl.rdInflateChunk >= dl.rdNumChunks ) )
+			{
+			RunApp();
+			
+			if ( dl.rdTotal > 0 )
+				pw.SetProgress( ulong( dl.rdBytesIn ), ulong( dl.rdTotal ) );
+			else
+				pw.SetProgress( 0, 0 );			// indeterminate
+			
+			// user might get bored...
+			if ( gDoneFlag )
+				{
+				dl.rdError = userCanceledErr;
+				break;
+				}
+			
+			// retry any range that has gone quiet
+			CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+			for ( int n = 0;  n < kRangeStreams;  ++n )
+				{
+				RangeStream * rs = &dl.rdStreams[ n ];
+				if ( rs->rsStream
+				&&	 now - rs->rsLastData > kRangeStallTime )
+					{
+					ResumeRange( rs );
+					}
+				}
+			
+			// a range can't be retried forever, and nothing must be left hanging
+			if ( noErr == dl.rdError
+			&&	 0 == CountActiveStreams( &dl )
+			&&	 not ( dl.rdChunks && dl.rdInflateChunk >= dl.rdNumChunks ) )
+				{
+				dl.rdError = kNetworkDisconnect;
+				}
+			}
+		}
+	
+	// all the bytes are in; zlib had better agree that was the whole stream
+	if ( noErr == dl.rdError
+	&&	 not dl.rdZEnded )
+		{
+		dl.rdError = Z_DATA_ERROR;
+		}
+	
+	// clean up
+	for ( int n = 0;  n < kRangeStreams;  ++n )
+		CloseRangeStream( &dl.rdStreams[ n ] );
+	if ( dl.rdChunks )
+		{
+		for ( int n = 0;  n < dl.rdNumChunks;  ++n )
+			delete[] dl.rdChunks[ n ].rcData;
+		delete[] dl.rdChunks;
+		}
+	if ( zInited )
+		inflateEnd( &dl.rdZ );
+	delete[] dl.rdOutBuf;
+	if ( dl.rdURL )
+		CFRelease( dl.rdURL );
+	
+	if ( oStats )
+		{
+		oStats->dsStreams		= dl.rdMostStreams;
+		oStats->dsReconnects	= dl.rdReconnects;
+		oStats->dsBytesIn		= dl.rdBytesIn;
+		oStats->dsBytesOut		= dl.rdBytesOut;
+		oStats->dsSeconds		= CFAbsoluteTimeGetCurrent() - startTime;
+		}
+	
+	return dl.rdError;
+}
+
+
+/*
+**	OpenRangeStream()
+**
+**	send a GET for bytes first..last (inclusive) of the file on this stream.
+**	last < 0 means "to the end"; first == 0 && last < 0 means no Range: at all.
+*/
+DTSError
+OpenRangeStream( RangeStream * rs, int chunk, int64_t first, int64_t last )
+{
+	RangeDownload * dl = rs->rsOwner;
+	
+	CFHTTPMessageRef request = CFHTTPMessageCreateRequest( kCFAllocatorDefault,
+									CFSTR("GET"), dl->rdURL, kCFHTTPVersion1_1 );
+	if ( not request )
+		return memFullErr;
+	
+	if ( first > 0 || last >= 0 )
+		{
+		char range[ 64 ];
+		if ( last >= 0 )
+			snprintf( range, sizeof range, "bytes=%lld-%lld", (long long) first, (long long) last );
+		else
+			snprintf( range, sizeof range, "bytes=%lld-", (long long) first );
+		if ( CFStringRef value = CreateCFString( range, kCFStringEncodingASCII ) )
+			{
+			CFHTTPMessageSetHeaderFieldValue( request, CFSTR("Range"), value );
+			CFRelease( value );
+			}
+		}
+	
+	CFReadStreamRef stream = CFReadStreamCreateForHTTPRequest( kCFAllocatorDefault, request );
+	CFRelease( request );
+	if ( not stream )
+		return memFullErr;
+	
+	// follow stale URLs, and keep the connection for the next range
+	(void) CFReadStreamSetProperty( stream,
+				kCFStreamPropertyHTTPShouldAutoredirect, kCFBooleanTrue );
+	(void) CFReadStreamSetProperty( stream,
+				kCFStreamPropertyHTTPAttemptPersistentConnection, kCFBooleanTrue );
+	
+	CFStreamClientContext ctxt;
+	memset( &ctxt, 0, sizeof ctxt );
+	ctxt.info = rs;
+	if ( not CFReadStreamSetClient( stream, kRangeStreamEvents, RangeStreamCallback, &ctxt ) )
+		{
+		CFRelease( stream );
+		return -1;
+		}
+	CFReadStreamScheduleWithRunLoop( stream,
+		(CFRunLoopRef) GetCFRunLoopFromEventLoop( GetCurrentEventLoop() ),
+		kCFRunLoopCommonModes );
+	
+	if ( not CFReadStreamOpen( stream ) )
+		{
+		CFReadStreamSetClient( stream, 0, nullptr, nullptr );
+		CFReadStreamUnscheduleFromRunLoop( stream,
+			(CFRunLoopRef) GetCFRunLoopFromEventLoop( GetCurrentEventLoop() ),
+			kCFRunLoopCommonModes );
+		CFRelease( stream );
+		return -1;
+		}
+	
+	rs->rsStream	= stream;
+	rs->rsChunk		= chunk;
+	rs->rsAskedFor	= first;
+	rs->rsChecked	= false;
+	rs->rsLastData	= CFAbsoluteTimeGetCurrent();
+	
+	int active = CountActiveStreams( dl );
+	if ( active > dl->rdMostStreams )
+		dl->rdMostStreams = active;
+	
+	return noErr;
+}
+
+
+/*
+**	CloseRangeStream()
+**
+**	hang up, and leave the stream idle
+*/
+void
+CloseRangeStream( RangeStream * rs )
+{
+	if ( CFReadStreamRef stream = rs->rsStream )
+		{
+		// unhook the callbacks first, to prevent being called at a bad moment
+		(void) CFReadStreamSetClient( stream, 0, nullptr, nullptr );
+		CFReadStreamUnscheduleFromRunLoop( stream,
+			(CFRunLoopRef) GetCFRunLoopFromEventLoop( GetCurrentEventLoop() ),
+			kCFRunLoopCommonModes );
+		CFReadStreamClose( stream );
+		CFRelease( stream );
+		}
+	rs->rsStream = nullptr;
+	rs->rsChunk  = kNoChunk;
+}
+
+
+/*
+**	RangeStreamCallback()
+**
+**	called by the run loop when something happens on one of our streams
+*/
+void
+RangeStreamCallback( CFReadStreamRef stream, CFStreamEventType evtType, void * ud )
+{
+	try
+		{
+		RangeStream * rs = static_cast<RangeStream *>( ud );
+		if ( stream != rs->rsStream
+		||	 noErr != rs->rsOwner->rdError )
+			{
+			return;
+			}
+		
+		switch ( evtType )
+			{
+			case kCFStreamEventHasBytesAvailable:
+				{
+				// first make sure it's sending what we asked for
+				if ( not rs->rsChecked )
+					{
+					if ( not CheckRangeResponse( rs ) )
+						return;
+					rs->rsChecked = true;
+					}
+				
+				// take what the stream has buffered, if it'll let us
+				uchar buffer[ 8192 ];
+				CFIndex bytesRead;
+				const uchar * data = CFReadStreamGetBuffer( stream, -1, &bytesRead );
+				if ( not data )
+					{
+					bytesRead = CFReadStreamRead( stream, buffer, sizeof buffer );
+					data = buffer;
+					}
+				
+				if ( bytesRead > 0 )
+					ReceiveRangeData( rs, data, bytesRead );
+				else
+				if ( bytesRead < 0 )
+					ResumeRange( rs );
+				else
+					RangeStreamEnded( rs );
+				}
+				break;
+			
+			case kCFStreamEventEndEncountered:
+				// an empty reply (a 404, say) still has a header worth reading
+				if ( not rs->rsChecked )
+					{
+					if ( not CheckRangeResponse( rs ) )
+						return;
+					rs->rsChecked = true;
+					}
+				RangeStreamEnded( rs );
+				break;
+			
+			case kCFStreamEventErrorOccurred:
+				ResumeRange( rs );
+				break;
+			
+			default:
+				break;
+			}
+		}
+	catch ( ... )
+		{
+		}
+}
+
+
+/*
+**	CheckRangeResponse()
+**
+**	look at the response header, the first time a stream has data.
+**	The first request learns the file's size and whether ranges work; every
+**	later one must be a 206 for exactly the bytes we asked for.
+**	returns false (having set rdError) if the download can't go on.
+*/
+bool
+CheckRangeResponse( RangeStream * rs )
+{
+	RangeDownload * dl = rs->rsOwner;
+	
+	CFHTTPMessageRef response = (CFHTTPMessageRef) CFReadStreamCopyProperty( rs->rsStream,
+									kCFStreamPropertyHTTPResponseHeader );
+	if ( not response )
+		{
+		dl->rdError = -1;
+		return false;
+		}
+	
+	CFIndex status = CFHTTPMessageGetResponseStatusCode( response );
+	int64_t first = GetHeaderNumber( response, CFSTR("Content-Range"), ' ' );
+	int64_t total = GetHeaderNumber( response, CFSTR("Content-Range"), '/' );
+	int64_t length = GetHeaderNumber( response, CFSTR("Content-Length"), 0 );
+	CFRelease( response );
+	
+	bool ok;
+	if ( kProbeChunk == rs->rsChunk )
+		{
+		// the first answer decides how this goes
+		if ( 206 == status && 0 == first && total > 0 )
+			ok = SetupChunks( dl, total, false );
+		else
+		if ( 200 == status )
+			ok = SetupChunks( dl, length > 0 ? length : 0, true );
+		else
+			{
+			dl->rdError = ( 404 == status || 410 == status ) ? fnfErr : -1;
+			return false;
+			}
+		if ( not ok )
+			{
+			dl->rdError = memFullErr;
+			return false;
+			}
+		
+		rs->rsChunk = 0;
+		dl->rdChunks[ 0 ].rcState = kChunkActive;
+		dl->rdNextChunk = 1;
+		StartRanges( dl );
+		return true;
+		}
+	
+	// the file mustn't change under us, and the bytes must be the ones we asked for
+	if ( 206 != status
+	||	 first != rs->rsAskedFor
+	||	 total != dl->rdTotal )
+		{
+		dl->rdError = kNetworkDisconnect;
+		return false;
+		}
+	
+	return true;
+}
+
+
+/*
+**	SetupChunks()
+**
+**	divide the file into ranges, now that we know how big it is
+*/
+bool
+SetupChunks( RangeDownload * dl, int64_t total, bool wholeFile )
+{
+	dl->rdTotal		= total;
+	dl->rdWholeFile	= wholeFile;
+	dl->rdNumChunks	= wholeFile ? 1 : int( ( total + kRangeChunkSize - 1 ) / kRangeChunkSize );
+	
+	dl->rdChunks = NEW_TAG("RangeChunks") RangeChunk[ dl->rdNumChunks ];
+	if ( not dl->rdChunks )
+		return false;
+	memset( dl->rdChunks, 0, dl->rdNumChunks * sizeof dl->rdChunks[0] );
+	
+	for ( int n = 0;  n < dl->rdNumChunks;  ++n )
+		{
+		RangeChunk * c = &dl->rdChunks[ n ];
+		c->rcStart = n * kRangeChunkSize;
+		c->rcEnd   = wholeFile ? total : c->rcStart + kRangeChunkSize;
+		if ( c->rcEnd > total )
+			c->rcEnd = total;
+		c->rcState = kChunkWaiting;
+		}
+	
+	// a whole file goes straight to zlib; the first range will be needed right away
+	if ( not wholeFile )
+		{
+		dl->rdChunks[ 0 ].rcData = NEW_TAG("RangeChunkData")
+			uchar[ dl->rdChunks[ 0 ].rcEnd - dl->rdChunks[ 0 ].rcStart ];
+		if ( not dl->rdChunks[ 0 ].rcData )
+			return false;
+		}
+	
+	return true;
+}
+
+
+/*
+**	StartRanges()
+**
+**	put idle streams to work on the next ranges, but don't get too far
+**	ahead of the inflater, since early ranges have to wait in memory
+*/
+void
+StartRanges( RangeDownload * dl )
+{
+	if ( dl->rdWholeFile )
+		return;
+	
+	for ( int n = 0;  n < kRangeStreams;  ++n )
+		{
+		RangeStream * rs = &dl->rdStreams[ n ];
+		if ( rs->rsStream )
+			continue;
+		if ( dl->rdNextChunk >= dl->rdNumChunks
+		||	 dl->rdNextChunk >= dl->rdInflateChunk + kRangeWindow )
+			{
+			break;
+			}
+		
+		int chunk = dl->rdNextChunk;
+		RangeChunk * c = &dl->rdChunks[ chunk ];
+		c->rcData = NEW_TAG("RangeChunkData") uchar[ c->rcEnd - c->rcStart ];
+		if ( not c->rcData )
+			{
+			dl->rdError = memFullErr;
+			return;
+			}
+		
+		dl->rdError = OpenRangeStream( rs, chunk, c->rcStart, c->rcEnd - 1 );
+		if ( noErr != dl->rdError )
+			return;
+		c->rcState = kChunkActive;
+		++dl->rdNextChunk;
+		}
+}
+
+
+/*
+**	ReceiveRangeData()
+**
+**	some bytes have come in on a stream
+*/
+void
+ReceiveRangeData( RangeStream * rs, const uchar * data, CFIndex len )
+{
+	RangeDownload * dl = rs->rsOwner;
+	RangeChunk * c = &dl->rdChunks[ rs->rsChunk ];
+	rs->rsLastData = CFAbsoluteTimeGetCurrent();
+	
+	// a whole file goes straight to zlib
+	if ( dl->rdWholeFile )
+		{
+		dl->rdBytesIn  += len;
+		c->rcReceived  += len;
+		c->rcFed       += len;
+		FeedInflater( dl, data, len );
+		return;
+		}
+	
+	// anything past the end of the range is the server's problem, not ours
+	int64_t room = c->rcEnd - c->rcStart - c->rcReceived;
+	if ( len > room )
+		len = CFIndex( room );
+	memcpy( c->rcData + c->rcReceived, data, len );
+	c->rcReceived += len;
+	dl->rdBytesIn += len;
+	
+	if ( c->rcStart + c->rcReceived >= c->rcEnd )
+		{
+		c->rcState = kChunkDone;
+		CloseRangeStream( rs );
+		}
+	
+	PumpInflater( dl );
+	if ( noErr == dl->rdError )
+		StartRanges( dl );
+}
+
+
+/*
+**	RangeStreamEnded()
+**
+**	a stream says it has nothing more. Fine if its range is all here.
+*/
+void
+RangeStreamEnded( RangeStream * rs )
+{
+	RangeDownload * dl = rs->rsOwner;
+	if ( rs->rsChunk < 0 )
+		{
+		// ended before it said anything at all
+		ResumeRange( rs );
+		return;
+		}
+	
+	RangeChunk * c = &dl->rdChunks[ rs->rsChunk ];
+	if ( dl->rdWholeFile
+	&&	 ( 0 == dl->rdTotal || c->rcReceived >= dl->rdTotal ) )
+		{
+		c->rcState = kChunkDone;
+		CloseRangeStream( rs );
+		PumpInflater( dl );
+		return;
+		}
+	
+	if ( kChunkDone != c->rcState )
+		ResumeRange( rs );
+}
+
+
+/*
+**	ResumeRange()
+**
+**	a stream dropped or stalled; ask for the rest of its range again
+*/
+void
+ResumeRange( RangeStream * rs )
+{
+	RangeDownload * dl = rs->rsOwner;
+	int chunk = rs->rsChunk;
+	CloseRangeStream( rs );
+	
+	// the very first request: just try it again
+	if ( chunk < 0 )
+		{
+		if ( ++dl->rdReconnects > kRangeMaxRetries )
+			dl->rdError = kNetworkDisconnect;
+		else
+			dl->rdError = OpenRangeStream( rs, kProbeChunk, 0, kRangeChunkSize - 1 );
+		return;
+		}
+	
+	RangeChunk * c = &dl->rdChunks[ chunk ];
+	if ( dl->rdWholeFile
+	||	 ++c->rcRetries > kRangeMaxRetries )
+		{
+		// a server that ignores Range: can't pick up where it left off
+		dl->rdError = kNetworkDisconnect;
+		return;
+		}
+	
+	++dl->rdReconnects;
+	dl->rdError = OpenRangeStream( rs, chunk, c->rcStart + c->rcReceived, c->rcEnd - 1 );
+}
+
+
+/*
+**	PumpInflater()
+**
+**	give zlib whatever has arrived, in order
+*/
+void
+PumpInflater( RangeDownload * dl )
+{
+	while ( noErr == dl->rdError
+	&&		dl->rdInflateChunk < dl->rdNumChunks )
+		{
+		RangeChunk * c = &dl->rdChunks[ dl->rdInflateChunk ];
+		if ( c->rcFed < c->rcReceived )
+			{
+			FeedInflater( dl, c->rcData + c->rcFed, size_t( c->rcReceived - c->rcFed ) );
+			c->rcFed = c->rcReceived;
+			}
+		if ( kChunkDone != c->rcState )
+			break;
+		
+		delete[] c->rcData;
+		c->rcData = nullptr;
+		++dl->rdInflateChunk;
+		}
+}
+
+
+/*
+**	FeedInflater()
+**
+**	expand some compressed bytes and write them out. Like gzread(), carry on
+**	through concatenated gzip members, and ignore anything after the last one
+**	that doesn't start like another.
+*/
+void
+FeedInflater( RangeDownload * dl, const uchar * data, size_t len )
+{
+	z_stream * z = &dl->rdZ;
+	while ( len > 0
+	&&		not dl->rdZTrailing )
+		{
+		// between members: is this another?
+		if ( dl->rdZEnded )
+			{
+			if ( 0x1F != data[0]
+			||	 ( len > 1 && 0x8B != data[1] ) )
+				{
+				dl->rdZTrailing = true;
+				return;
+				}
+			if ( Z_OK != inflateReset( z ) )
+				{
+				dl->rdError = Z_DATA_ERROR;
+				return;
+				}
+			dl->rdZEnded = false;
+			}
+		
+		z->next_in  = const_cast<Bytef *>( data );
+		z->avail_in = uInt( len );
+		
+		while ( z->avail_in > 0 )
+			{
+			z->next_out  = dl->rdOutBuf;
+			z->avail_out = uInt( kInflateBufferSize );
+			int zerr = inflate( z, Z_NO_FLUSH );
+			
+			size_t produced = kInflateBufferSize - z->avail_out;
+			if ( produced
+			&&	 std::fwrite( dl->rdOutBuf, 1, produced, dl->rdOut ) != produced )
+				{
+				dl->rdError = ioErr;
+				return;
+				}
+			dl->rdBytesOut += produced;
+			
+			if ( Z_STREAM_END == zerr )
+				{
+				dl->rdZEnded = true;
+				break;
+				}
+			if ( Z_OK != zerr
+			&&	 Z_BUF_ERROR != zerr )
+				{
+				// Z_DATA_ERROR covers a bad CRC or length, as well as garbage
+				dl->rdError = ( Z_NEED_DICT == zerr ) ? Z_DATA_ERROR : zerr;
+				return;
+				}
+			}
+		
+		// whatever followed the end of a member
+		data = z->next_in;
+		len  = z->avail_in;
+		}
+}
+
+
+/*
+**	GetHeaderNumber()
+**
+**	the number in a response header field, after the delimiter if there is one:
+**		' ' gets 100 out of "Content-Range: bytes 100-199/1000", '/' gets 1000.
+**	returns -1 if it isn't there.
+*/
+int64_t
+GetHeaderNumber( CFHTTPMessageRef response, CFStringRef field, char delimiter )
+{
+	int64_t result = -1;
+	if ( CFStringRef value = CFHTTPMessageCopyHeaderFieldValue( response, field ) )
+		{
+		char buff[ 128 ];
+		if ( CFStringGetCString( value, buff, sizeof buff, kCFStringEncodingASCII ) )
+			{
+			const char * p = delimiter ? strchr( buff, delimiter ) : buff;
+			if ( p )
+				{
+				if ( delimiter )
+					++p;
+				char * end;
+				long long n = strtoll( p, &end, 10 );
+				if ( end != p )
+					result = n;
+				}
+			}
+		CFRelease( value );
+		}
+	
+	return result;
+}
+
+
+/*
+**	CountActiveStreams()
+**
+**	how many connections are open
+*/
+int
+CountActiveStreams( const RangeDownload * dl )
+{
+	int count = 0;
+	for ( int n = 0;  n < kRangeStreams;  ++n )
+		if ( dl->rdStreams[ n ].rsStream )
+			++count;
+	
+	return count;
+}
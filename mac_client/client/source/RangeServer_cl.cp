@@ -0,0 +1,511 @@
+/*
+**	RangeServer_cl.cp		ClanLord
+** 
+**	Copyright 2023 Delta Tao Software, Inc.
+** 
+**	Licensed under the Apache License, Version 2.0 (the "License");
+**	you may not use this file except in compliance with the License.
+**	You may obtain a copy of the License at
+** 
+**     https://www.apache.org/licenses/LICENSE-2.0
+** 
+**	Unless required by applicable law or agreed to in writing, software
+**	distributed under the License is distributed on an "AS IS" BASIS,
+**	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+**	See the License for the specific language governing permissions and
+**	imitations under the License.
+*/
+
+/*
+**	A stand-in for the update web server, for trying out RangeDownload_cl.cp.
+**
+**	It serves one file, whatever path is asked for, over HTTP on this computer
+**	only, with a thread per connection and keep-alive honored, so the client's
+**	parallel ranges really do arrive in parallel. By default it answers Range:
+**	with 206s, as the real server does; -n makes it ignore Range: and send the
+**	whole file with a 200, like a server or proxy that doesn't do ranges. -d cuts
+**	some responses off partway, at random, which makes the client resume those
+**	ranges -- or, with -n too, give up, since a whole-file download can't resume.
+**
+**	Usage: see Usage(), below. Pair it with the client's \BENCHMARK DOWNLOAD, e.g.
+**		CLRangeServer -d 20 CL_Images.gz
+**		\BENCHMARK DOWNLOAD http://127.0.0.1:8080/CL_Images.gz
+*/
+
+#ifndef _dtslib2_
+# include "Prefix_dts.h"
+#endif
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <signal.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using std::fprintf;
+using std::printf;
+
+
+/*
+**	Definitions
+*/
+const ushort	kDefaultPort		= 8080;
+const size_t	kMaxRequestSize		= 8192;		// headers and all
+const int		kListenBacklog		= 16;
+
+
+/*
+**	command-line options
+*/
+struct SOptions
+{
+	ushort			opPort;
+	bool			opNoRanges;		// ignore Range:, always send the whole file
+	int				opDrop;			// percent of responses to cut off partway
+	uint			opSeed;
+	bool			opVerbose;
+	const char *	opPath;
+};
+
+
+/*
+**	one accepted connection, handed to its thread
+*/
+struct SConnection
+{
+	int				cnSocket;
+	int				cnNumber;		// for the log
+};
+
+
+/*
+**	Internal Routines
+*/
+static void			Usage( const char * name );
+static bool			ParseOptions( int argc, char ** argv );
+static DTSError		LoadFile( const char * path );
+static void *		ServeConnection( void * refCon );
+static bool			ReadRequest( int sock, char * buffer, size_t * ioLen, size_t * oHeadLen );
+static bool			Respond( const SConnection * conn, const char * request );
+static bool			GetRange( const char * request, int64_t * oFirst, int64_t * oLast );
+static bool			SendAll( int sock, const void * data, size_t len );
+static bool			Chance( int percent );
+
+
+/*
+**	Internal Variables
+*/
+static SOptions		gOptions;
+static uchar *		gFileData;			// the whole file
+static int64_t		gFileSize;
+static pthread_mutex_t	gDiceLock = PTHREAD_MUTEX_INITIALIZER;
+
+
+/*
+**	main()
+**
+**	load the file, then serve connections until killed
+*/
+int
+main( int argc, char ** argv )
+{
+	if ( not ParseOptions( argc, argv ) )
+		{
+		Usage( argv[0] );
+		return 1;
+		}
+	
+	if ( noErr != LoadFile( gOptions.opPath ) )
+		return 1;
+	
+	srandom( gOptions.opSeed );
+	
+	// a client hanging up mid-response is all in a day's work
+	signal( SIGPIPE, SIG_IGN );
+	
+	int host = socket( AF_INET, SOCK_STREAM, 0 );
+	int yes = 1;
+	sockaddr_in addr;
+	memset( &addr, 0, sizeof addr );
+	addr.sin_family			= AF_INET;
+	addr.sin_port			= htons( gOptions.opPort );
+	addr.sin_addr.s_addr	= htonl( INADDR_LOOPBACK );
+	if ( host < 0
+	||   setsockopt( host, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof yes ) < 0
+	||   bind( host, reinterpret_cast<sockaddr *>( &addr ), sizeof addr ) < 0
+	||   listen( host, kListenBacklog ) < 0 )
+		{
+		fprintf( stderr, "Can't listen on port %u: error %d.\n",
+			gOptions.opPort, errno );
+		return 1;
+		}
+	
+	printf( "Serving %s (%lld bytes) at http://127.0.0.1:%u/; "
+			"%s, %d%% dropped, seed %u.\n",
+		gOptions.opPath, (long long) gFileSize, gOptions.opPort,
+		gOptions.opNoRanges ? "no ranges" : "ranges",
+		gOptions.opDrop, gOptions.opSeed );
+	
+	for ( int number = 1;  ;  ++number )
+		{
+		int sock = accept( host, nullptr, nullptr );
+		if ( sock < 0 )
+			{
+			if ( EINTR == errno )
+				continue;
+			fprintf( stderr, "Lost the listening socket: error %d.\n", errno );
+			break;
+			}
+		
+		SConnection * conn = NEW_TAG("RangeConnection") SConnection;
+		pthread_t thread;
+		if ( not conn )
+			{
+			close( sock );
+			continue;
+			}
+		conn->cnSocket = sock;
+		conn->cnNumber = number;
+		if ( 0 != pthread_create( &thread, nullptr, ServeConnection, conn ) )
+			{
+			close( sock );
+			delete conn;
+			continue;
+			}
+		pthread_detach( thread );
+		}
+	
+	close( host );
+	delete[] gFileData;
+	
+	return 1;
+}
+
+
+/*
+**	Usage()
+*/
+void
+Usage( const char * name )
+{
+	fprintf( stderr,
+		"usage: %s [options] file.gz\n"
+		"  -p port       listen here (default %u)\n"
+		"  -n            ignore Range:, and always send the whole file\n"
+		"  -d percent    cut this many responses off partway\n"
+		"  -s seed       for the dice (default 1)\n"
+		"  -v            report every request\n",
+		name, kDefaultPort );
+}
+
+
+/*
+**	ParseOptions()
+**
+**	fill in gOptions from the command line
+*/
+bool
+ParseOptions( int argc, char ** argv )
+{
+	SOptions& op = gOptions;
+	op.opPort		= kDefaultPort;
+	op.opNoRanges	= false;
+	op.opDrop		= 0;
+	op.opSeed		= 1;
+	op.opVerbose	= false;
+	op.opPath		= nullptr;
+	
+	int ch;
+	while ( -1 != (ch = getopt( argc, argv, "p:nd:s:v" )) )
+		{
+		switch ( ch )
+			{
+			case 'p':	op.opPort		= ushort( atoi( optarg ) );		break;
+			case 'n':	op.opNoRanges	= true;							break;
+			case 'd':	op.opDrop		= atoi( optarg );				break;
+			case 's':	op.opSeed		= uint( strtoul( optarg, nullptr, 0 ) );	break;
+			case 'v':	op.opVerbose	= true;							break;
+			default:	return false;
+			}
+		}
+	
+	if ( optind != argc - 1 )
+		return false;
+	op.opPath = argv[ optind ];
+	
+	return op.opPort > 0
+		&& op.opDrop >= 0  &&  op.opDrop <= 100;
+}
+
+
+/*
+**	LoadFile()
+**
+**	read the whole file to be served
+*/
+DTSError
+LoadFile( const char * path )
+{
+	FILE * stream = std::fopen( path, "rb" );
+	if ( not stream )
+		{
+		fprintf( stderr, "Can't open %s.\n", path );
+		return fnfErr;
+		}
+	
+	DTSError result = noErr;
+	long fileSize = -1;
+	if ( 0 == std::fseek( stream, 0, SEEK_END ) )
+		fileSize = std::ftell( stream );
+	std::rewind( stream );
+	if ( fileSize <= 0 )
+		result = ioErr;
+	
+	if ( noErr == result )
+		{
+		gFileData = NEW_TAG("RangeServerFile") uchar[ fileSize ];
+		if ( not gFileData )
+			result = memFullErr;
+		}
+	if ( noErr == result
+	&&   size_t( fileSize ) != std::fread( gFileData, 1, fileSize, stream ) )
+		{
+		result = ioErr;
+		}
+	std::fclose( stream );
+	
+	if ( noErr != result )
+		{
+		fprintf( stderr, "Can't read %s: error %d.\n", path, (int) result );
+		delete[] gFileData;
+		gFileData = nullptr;
+		return result;
+		}
+	
+	gFileSize = fileSize;
+	return noErr;
+}
+
+
+#pragma mark -
+
+/*
+**	ServeConnection()
+**
+**	thread proc: answer requests on one connection till it's closed, either end
+*/
+void *
+ServeConnection( void * refCon )
+{
+	SConnection * conn = static_cast<SConnection *>( refCon );
+	
+	char buffer[ kMaxRequestSize + 1 ];
+	size_t len = 0;
+	size_t headLen;
+	while ( ReadRequest( conn->cnSocket, buffer, &len, &headLen ) )
+		{
+		// answer it, then slide along anything that came in behind it
+		char save = buffer[ headLen ];
+		buffer[ headLen ] = '\0';
+		bool bMore = Respond( conn, buffer );
+		buffer[ headLen ] = save;
+		if ( not bMore )
+			break;
+		
+		len -= headLen;
+		memmove( buffer, buffer + headLen, len );
+		}
+	
+	if ( gOptions.opVerbose )
+		printf( "#%d: closed.\n", conn->cnNumber );
+	
+	close( conn->cnSocket );
+	delete conn;
+	return nullptr;
+}
+
+
+/*
+**	ReadRequest()
+**
+**	read until the buffer holds a whole request header, ending in a blank line.
+**	The buffer already holds ioLen bytes; oHeadLen gets the header's length.
+**	Returns false if the connection closes first, or the header's too big.
+*/
+bool
+ReadRequest( int sock, char * buffer, size_t * ioLen, size_t * oHeadLen )
+{
+	for (;;)
+		{
+		buffer[ *ioLen ] = '\0';
+		if ( const char * end = strstr( buffer, "\r\n\r\n" ) )
+			{
+			*oHeadLen = end + 4 - buffer;
+			return true;
+			}
+		if ( *ioLen >= kMaxRequestSize )
+			return false;
+		
+		ssize_t got = recv( sock, buffer + *ioLen, kMaxRequestSize - *ioLen, 0 );
+		if ( got <= 0 )
+			return false;
+		*ioLen += got;
+		}
+}
+
+
+/*
+**	Respond()
+**
+**	answer one request, whose header is in 'request'.
+**	Returns false if the connection should be closed.
+*/
+bool
+Respond( const SConnection * conn, const char * request )
+{
+	int sock = conn->cnSocket;
+	
+	const char * eol = strstr( request, "\r\n" );
+	int lineLen = eol ? int( eol - request ) : int( strlen( request ) );
+	if ( 0 != strncmp( request, "GET ", 4 ) )
+		{
+		static const char kNotImplemented[] =
+			"HTTP/1.1 501 Not Implemented\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+		(void) SendAll( sock, kNotImplemented, sizeof kNotImplemented - 1 );
+		printf( "#%d: %.*s: not a GET.\n", conn->cnNumber, lineLen, request );
+		return false;
+		}
+	
+	// what part of the file to send
+	int64_t first = 0;
+	int64_t last = gFileSize - 1;
+	bool bRange = not gOptions.opNoRanges && GetRange( request, &first, &last );
+	if ( bRange && last >= gFileSize )
+		last = gFileSize - 1;
+	
+	char header[ 256 ];
+	if ( bRange && first > last )
+		{
+		snprintf( header, sizeof header,
+			"HTTP/1.1 416 Requested Range Not Satisfiable\r\n"
+			"Content-Range: bytes */%lld\r\nContent-Length: 0\r\n\r\n",
+			(long long) gFileSize );
+		printf( "#%d: %.*s: unsatisfiable.\n", conn->cnNumber, lineLen, request );
+		return SendAll( sock, header, strlen( header ) );
+		}
+	
+	int64_t length = last - first + 1;
+	if ( bRange )
+		{
+		snprintf( header, sizeof header,
+			"HTTP/1.1 206 Partial Content\r\n"
+			"Content-Range: bytes %lld-%lld/%lld\r\nContent-Length: %lld\r\n\r\n",
+			(long long) first, (long long) last, (long long) gFileSize, (long long) length );
+		}
+	else
+		{
+		snprintf( header, sizeof header,
+			"HTTP/1.1 200 OK\r\nContent-Length: %lld\r\n\r\n", (long long) length );
+		}
+	
+	// maybe pretend the connection broke, somewhere in the middle
+	int64_t toSend = length;
+	bool bDrop = false;
+	pthread_mutex_lock( &gDiceLock );
+	if ( Chance( gOptions.opDrop ) )
+		{
+		bDrop = true;
+		toSend = random() % length;
+		}
+	pthread_mutex_unlock( &gDiceLock );
+	
+	if ( gOptions.opVerbose || bDrop )
+		{
+		printf( "#%d: %.*s: %s %lld-%lld%s.\n", conn->cnNumber, lineLen, request,
+			bRange ? "206" : "200", (long long) first, (long long) last,
+			bDrop ? ", dropped partway" : "" );
+		}
+	
+	if ( not SendAll( sock, header, strlen( header ) )
+	||   not SendAll( sock, gFileData + first, size_t( toSend ) ) )
+		{
+		return false;
+		}
+	
+	return not bDrop;
+}
+
+
+/*
+**	GetRange()
+**
+**	find "Range: bytes=first-last" or "bytes=first-" in the request header.
+**	A missing last means the end of the file.
+*/
+bool
+GetRange( const char * request, int64_t * oFirst, int64_t * oLast )
+{
+	for ( const char * line = strstr( request, "\r\n" );  line;
+		  line = strstr( line + 2, "\r\n" ) )
+		{
+		if ( 0 != strncasecmp( line + 2, "Range:", 6 ) )
+			continue;
+		
+		const char * p = line + 8;
+		while ( ' ' == *p )
+			++p;
+		if ( 0 != strncmp( p, "bytes=", 6 ) )
+			return false;
+		
+		char * end;
+		long long first = strtoll( p + 6, &end, 10 );
+		if ( end == p + 6 || '-' != *end || first < 0 )
+			return false;
+		p = end + 1;
+		long long last = strtoll( p, &end, 10 );
+		*oFirst = first;
+		*oLast = ( end == p ) ? gFileSize - 1 : last;
+		return true;
+		}
+	
+	return false;
+}
+
+
+/*
+**	SendAll()
+**
+**	write all of it, or fail
+*/
+bool
+SendAll( int sock, const void * data, size_t len )
+{
+	const char * p = static_cast<const char *>( data );
+	while ( len > 0 )
+		{
+		ssize_t sent = send( sock, p, len, 0 );
+		if ( sent < 0 && EINTR == errno )
+			continue;
+		if ( sent <= 0 )
+			return false;
+		p   += sent;
+		len -= sent;
+		}
+	
+	return true;
+}
+
+
+/*
+**	Chance()
+**
+**	roll the dice
+*/
+bool
+Chance( int percent )
+{
+	return percent > 0  &&  random() % 100 < percent;
+}
@@ -37,6 +37,38 @@ const int kShadowVOffset = 5;
 
 // #define SHADOW_TEST
 
+
+/*
+**	class ShadowCache
+**
+**	casting a shadow means re-deriving it pixel by pixel, but the result only
+**	depends on the source frame, the kind of shadow and where the sun is.
+**	so each one is kept as a CacheObject of its own, in the same LRU list as the
+**	images (which reaps it like any other), and chained off the ImageCache it
+**	was cast from. when the sun moves they're all thrown away.
+*/
+class ShadowCache : public CacheObject
+{
+public:
+	ImageCache *	scSource;		// null once the source leaves the cache
+	ShadowCache *	scNext;			// the source's other shadows
+	DTSRect			scSrcRect;		// which frame of the source
+	int				scDstWidth;
+	int				scDstHeight;
+	uint			scKind;			// kPictDefShadowXXX
+	int				scSunAngle;
+	DTSRect			scPlacement;	// relative to the top left of the caller's dstRect
+	DTSImage		scImage;
+	
+	// constructor/destructor
+	explicit		ShadowCache( ImageCache * source ) :
+						CacheObject( kCacheTypeShadow ),
+						scSource( source ),
+						scNext( nullptr )
+						{ ++sCachedShadowCount; }
+	virtual			~ShadowCache();
+};
+
 //
 // internal variables
 //
@@ -77,6 +109,9 @@ static void CreateOvalShadow( const DTSImage * image, DTSImage * shadow,
 	const DTSRect * srcRect, DTSRect * dstRect );
 
 inline static Fixed FixedMul( Fixed a, Fixed b );
+static const ShadowCache * GetShadow( ImageCache * cache, uint kind,
+	const DTSRect * srcRect, const DTSRect * dstRect );
+static void FlushShadows();
 
 
 /*
@@ -108,6 +143,10 @@ SetShadowAngle( int shadowLevel, int sunAngle, int declination )
 	while ( sunAngle < 0 )
 		sunAngle += 360;
 	
+	// the cached shadows are all pointing the wrong way now
+	if ( sunAngle != gSunAngle )
+		FlushShadows();
+	
 	gSunAngle = sunAngle;
 //	ShowMessage( "angle: %d", sunAngle );
 	
@@ -178,11 +217,7 @@ SetShadowAngle( int shadowLevel, int sunAngle, int declination )
 */
 void
 CreateShadow( DTSOffView * view,
-#ifdef USE_OPENGL
 			ImageCache * cache,
-#else
-			const DTSImage * image,
-#endif	// USE_OPENGL
 			const DTSRect * inSrcRect,
 			const DTSRect * inDstRect,
 			uint flags )
@@ -198,14 +233,15 @@ CreateShadow( DTSOffView * view,
 	int hOffset = -kShadowHOffset * sShadowCosine;
 	int vOffset = kShadowVOffset * sShadowSine;
 	
-	DTSImage shadow;
 	DTSRect dstRect = *inDstRect;
 	DTSRect srcRect = *inSrcRect;
+	uint kind = flags & kPictDefShadowMask;
 	
 #ifdef USE_OPENGL
-	const DTSImage * image = &cache->icImage.cliImage;
 	float shadowLevel = float( gShadowLevel ) / 100.0F;
-	TextureObject * tObj = cache->textureObject;
+		// a recolored mobile's texture belongs to its uncolored picture
+	ImageCache * tcache = gUsingOpenGL ? selectTextureSource( cache ) : cache;
+	TextureObject * tObj = tcache->textureObject;
 	
 	// is OGL shadowing permitted?
 	bool bCanShadow = gUsingOpenGL
@@ -214,10 +250,11 @@ CreateShadow( DTSOffView * view,
 					&& tObj != nullptr;
 #endif	// USE_OPENGL
 	
-	// choose the appropriate shadow maker function
-	switch ( flags & kPictDefShadowMask )
+	// let GL cast the shadow if it can
+	switch ( kind )
 		{
 		case kPictDefShadowNone:
+		default:
 			// some images just won't have any shadows
 			return;
 		
@@ -227,12 +264,11 @@ CreateShadow( DTSOffView * view,
 #ifdef USE_OPENGL
 			if ( bCanShadow
 			&&   tObj->drawAsRotatedShadow( srcRect, dstRect,
-					gSunAngle, gLocalSunDeclinationScale, shadowLevel, cache ) )
+					gSunAngle, gLocalSunDeclinationScale, shadowLevel, tcache ) )
 				{
 				return;
 				}
 #endif	// USE_OPENGL
-			CastShadowRotate( image, &shadow, &srcRect, &dstRect );
 			break;
 		
 		case kPictDefShadowDrop:
@@ -241,13 +277,11 @@ CreateShadow( DTSOffView * view,
 #ifdef USE_OPENGL
 			if ( bCanShadow
 			&& 	 tObj->drawAsDropShadow( srcRect, dstRect, hOffset, vOffset,
-					shadowLevel, cache ) )
+					shadowLevel, tcache ) )
 				{
 				return;
 				}
 #endif	// USE_OPENGL
-			CreateDropShadow( image, &shadow, &srcRect, &dstRect );
-			dstRect.Offset( hOffset, vOffset );
 			break;
 		
 		case kPictDefShadowOval:
@@ -256,64 +290,214 @@ CreateShadow( DTSOffView * view,
 // note that we are reusing dropshadow, cuz i don't think oval is being used
 			if ( bCanShadow
 			&&   tObj->drawAsDropShadow( srcRect, dstRect, hOffset, vOffset,
-					shadowLevel, cache ) )
+					shadowLevel, tcache ) )
 				{
 				return;
 				}
 #endif	// USE_OPENGL
-			CreateOvalShadow( image, &shadow, &srcRect, &dstRect );
-			dstRect.Offset( hOffset, vOffset );
 			break;
 		}
 	
-	// the shadow image is now complete
+	// otherwise, find (or cast) the shadow image
+	const ShadowCache * sc = GetShadow( cache, kind, &srcRect, &dstRect );
+	if ( not sc )
+		return;
+	const DTSImage * shadow = &sc->scImage;
+	
+	// put it where it goes
+	dstRect.rectTop    = inDstRect->rectTop  + sc->scPlacement.rectTop;
+	dstRect.rectLeft   = inDstRect->rectLeft + sc->scPlacement.rectLeft;
+	dstRect.rectBottom = inDstRect->rectTop  + sc->scPlacement.rectBottom;
+	dstRect.rectRight  = inDstRect->rectLeft + sc->scPlacement.rectRight;
+	
+	// drop and oval shadows are just offset a bit
+	if ( kPictDefShadowNormal != kind )
+		dstRect.Offset( hOffset, vOffset );
+	
 	// blast the bits into the offview
 	DTSRect shadowBounds;
-	shadow.GetBounds( &shadowBounds );
+	shadow->GetBounds( &shadowBounds );
 	switch ( gShadowLevel )
 		{
 		case 25:
 #ifdef USE_OPENGL
 			if ( gUsingOpenGL )
-				drawOGLPixmap( shadowBounds, dstRect, shadow.GetRowBytes(),
-					kIndexToAlphaMapAlpha25TransparentZero, shadow.GetBits() );
+				drawOGLPixmap( shadowBounds, dstRect, shadow->GetRowBytes(),
+					kIndexToAlphaMapAlpha25TransparentZero, shadow->GetBits() );
 			else
 #endif	// USE_OPENGL
-				QualityBlitBlend75Transparent( view, &shadow, &shadowBounds, &dstRect );
+				QualityBlitBlend75Transparent( view, shadow, &shadowBounds, &dstRect );
 			break;
 		
 		case 50:
 #ifdef USE_OPENGL
 			if ( gUsingOpenGL )
-				drawOGLPixmap( shadowBounds, dstRect, shadow.GetRowBytes(),
-					kIndexToAlphaMapAlpha50TransparentZero, shadow.GetBits() );
+				drawOGLPixmap( shadowBounds, dstRect, shadow->GetRowBytes(),
+					kIndexToAlphaMapAlpha50TransparentZero, shadow->GetBits() );
 			else
 #endif	// USE_OPENGL
-				QualityBlitBlend50Transparent( view, &shadow, &shadowBounds, &dstRect );
+				QualityBlitBlend50Transparent( view, shadow, &shadowBounds, &dstRect );
 			break;
 		
 		case 75:
 #ifdef USE_OPENGL
 			if ( gUsingOpenGL )
-				drawOGLPixmap( shadowBounds, dstRect, shadow.GetRowBytes(),
-					kIndexToAlphaMapAlpha75TransparentZero, shadow.GetBits() );
+				drawOGLPixmap( shadowBounds, dstRect, shadow->GetRowBytes(),
+					kIndexToAlphaMapAlpha75TransparentZero, shadow->GetBits() );
 			else
 #endif	// USE_OPENGL
-				QualityBlitBlend25Transparent( view, &shadow, &shadowBounds, &dstRect );
+				QualityBlitBlend25Transparent( view, shadow, &shadowBounds, &dstRect );
 			break;
 		
 		case 100:
 #ifdef USE_OPENGL
 			if ( gUsingOpenGL )
-				drawOGLPixmap( shadowBounds, dstRect, shadow.GetRowBytes(),
-					kIndexToAlphaMapAlpha100TransparentZero, shadow.GetBits() );
+				drawOGLPixmap( shadowBounds, dstRect, shadow->GetRowBytes(),
+					kIndexToAlphaMapAlpha100TransparentZero, shadow->GetBits() );
 			else
 #endif	// USE_OPENGL
-				BlitTransparent( view, &shadow, &shadowBounds, &dstRect );
+				BlitTransparent( view, shadow, &shadowBounds, &dstRect );
 			break;
 		}
+}
+
+
+/*
+**	GetShadow()
+**
+**	look up the shadow of this frame of the image, with the sun where it
+**	is now; cast and cache it if need be. returns null if out of memory.
+*/
+const ShadowCache *
+GetShadow( ImageCache * cache, uint kind, const DTSRect * srcRect, const DTSRect * dstRect )
+{
+	int dstWidth  = dstRect->rectRight  - dstRect->rectLeft;
+	int dstHeight = dstRect->rectBottom - dstRect->rectTop;
+	
+	// maybe we've already got it
+	ShadowCache ** link = &cache->icShadows;
+	for ( ShadowCache * sc = *link;  sc;  link = &sc->scNext, sc = *link )
+		{
+		if ( sc->scKind     == kind
+		&&   sc->scSunAngle == gSunAngle
+		&&   sc->scDstWidth == dstWidth
+		&&   sc->scDstHeight == dstHeight
+		&&   0 == memcmp( &sc->scSrcRect, srcRect, sizeof *srcRect ) )
+			{
+			// move it to the front of the chain, and the back of the LRU list
+			*link = sc->scNext;
+			sc->scNext = cache->icShadows;
+			cache->icShadows = sc;
+			sc->Touch();
+			return sc;
+			}
+		}
+	
+	// nope; cast it
+	ShadowCache * sc = NEW_TAG("ShadowCache") ShadowCache( cache );
+	CheckPointer( sc );
+	if ( not sc )
+		return nullptr;
 	
-	shadow.DisposeBits();
+	sc->scSrcRect   = *srcRect;
+	sc->scDstWidth  = dstWidth;
+	sc->scDstHeight = dstHeight;
+	sc->scKind      = kind;
+	sc->scSunAngle  = gSunAngle;
+	
+	const DTSImage * image = &cache->icImage.cliImage;
+	DTSRect placement = *dstRect;
+	switch ( kind )
+		{
+		case kPictDefShadowNormal:
+			CastShadowRotate( image, &sc->scImage, srcRect, &placement );
+			break;
+		
+		case kPictDefShadowDrop:
+			CreateDropShadow( image, &sc->scImage, srcRect, &placement );
+			break;
+		
+		case kPictDefShadowOval:
+			CreateOvalShadow( image, &sc->scImage, srcRect, &placement );
+			break;
+		}
+	if ( not sc->scImage.GetBits() )
+		{
+		delete sc;
+		return nullptr;
+		}
+	
+	sc->scPlacement.rectTop    = placement.rectTop    - dstRect->rectTop;
+	sc->scPlacement.rectLeft   = placement.rectLeft   - dstRect->rectLeft;
+	sc->scPlacement.rectBottom = placement.rectBottom - dstRect->rectTop;
+	sc->scPlacement.rectRight  = placement.rectRight  - dstRect->rectLeft;
+	
+	// file it
+	sc->scNext = cache->icShadows;
+	cache->icShadows = sc;
+	sc->InstallLast( gRootCacheObject );
+	
+	return sc;
+}
+
+
+/*
+**	ShadowCache::~ShadowCache()
+**
+**	dispose of the bits, unchain from the source image, and keep the books
+*/
+ShadowCache::~ShadowCache()
+{
+	scImage.DisposeBits();
+	--sCachedShadowCount;
+	
+	if ( scSource )
+		{
+		for ( ShadowCache ** link = &scSource->icShadows;  *link;  link = &(*link)->scNext )
+			{
+			if ( *link == this )
+				{
+				*link = scNext;
+				break;
+				}
+			}
+		}
+}
+
+
+/*
+**	DetachShadows()
+**
+**	the image is leaving the cache. its shadows can't be found any more,
+**	so they'll drift to the front of the LRU list and be reaped.
+*/
+void
+DetachShadows( ImageCache * source )
+{
+	for ( ShadowCache * sc = source->icShadows;  sc;  sc = sc->scNext )
+		sc->scSource = nullptr;
+	source->icShadows = nullptr;
+}
+
+
+/*
+**	FlushShadows()
+**
+**	throw away every cached shadow
+*/
+void
+FlushShadows()
+{
+	CacheObject * next;
+	for ( CacheObject * walk = gRootCacheObject;  walk;  walk = next )
+		{
+		next = walk->linkNext;
+		if ( CacheObject::kCacheTypeShadow == walk->coType )
+			{
+			walk->Remove( gRootCacheObject );
+			delete walk;
+			}
+		}
 }
 
 
@@ -32,6 +32,10 @@
 void	SetShadowAngle( int shadowLevel, int sunAngle, int declination );
 int		GetShadowLevel();
 
+// cast shadows are cached, and chained off the image they were cast from;
+// this orphans them when that image leaves the cache
+void	DetachShadows( ImageCache * source );
+
 
 // Values of the 'flags' param to CreateShadow()
 // Maybe one day they could be incorporated into the true PictDef flags.
@@ -56,13 +60,8 @@ enum
 
 
 // Draw the shadow for the given image
-#ifdef USE_OPENGL
 void	CreateShadow( DTSOffView * view, ImageCache * cache,
 			const DTSRect * srcRect, const DTSRect * dstRect, uint flags );
-#else
-void	CreateShadow( DTSOffView * view, const DTSImage * img,
-			const DTSRect * srcRect, const DTSRect * dstRect, uint flags );
-#endif	// USE_OPENGL
 
 // determine what pose to cast the shadow with, given the sun's angle
 int		ChooseShadowPose( int state );
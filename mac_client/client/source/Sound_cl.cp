@@ -25,6 +25,7 @@
 /*
 void	CLInitSound();
 void	CLExitSound();
+void	CLStopSounds();
 void	CLPlaySound( DTSKeyID sndID );
 void	SetSoundVolume( uint volume );
 */
@@ -37,13 +38,14 @@ const int kNumTracks = 4;				// max # simultaneous channels
 
 
 /*
-**	class CLSound
+**	struct CLTrack
 **
-**	originally borrowed from Dark Castle
+**	originally borrowed from Dark Castle.
+**	Each track owns the DTSSound it plays, which streams its samples straight out
+**	of CL_Sounds; there's no longer any per-sound cache.
 */
-class CLSound : public CacheObject
+struct CLTrack
 {
-public:
 	enum SoundPriority
 		{
 		kPriorityLowest,	// only used when sounds duplicated
@@ -53,44 +55,20 @@ public:
 //		kPriorityContinuous	// shield, waterfall (CL unused)
 		};
 	
-	DTSKeyID		soundID;
-	SoundPriority	soundPriority;
-	DTSSound		soundDTS;
-	
-	// constructor/destructor
-				CLSound() : CacheObject( kCacheTypeSound )	{}
-	virtual		~CLSound();
-	
-	// interface
-	DTSError	Init( DTSKeyID sndID, SoundPriority priority );
-	void		Play();
-	bool		IsDone() const { return soundDTS.IsDone(); }
-	void		Stop() { soundDTS.Stop(); }
-	
-	// overloaded routines
-	virtual bool CanBeDeleted() const { return IsDone(); }
-};
-
-
-/*
-**	struct CLTrack
-**
-**	originally borrowed from Dark Castle
-*/
-struct CLTrack
-{
-	CLSound *		trackSound;
+	DTSSound		trackSound;
+	DTSKeyID		trackSoundID;
 	int				trackPriority;
+	bool			trackBusy;
 	
 	// interface
-	void	Play( CLSound * sound );
+	void	Play( DTSKeyID sndID, SoundPriority priority );
 };
 
 
 /*
 **	Internal Routines
 */
-static CLSound *	CacheSound( DTSKeyID sndID );
+static CLTrack *	ChooseTrack( DTSKeyID sndID );
 
 
 /*
@@ -127,6 +105,22 @@ CLExitSound()
 }
 
 
+/*
+**	CLStopSounds()
+**
+**	Silence every track; their sounds are streamed out of CL_Sounds,
+**	so this must happen before that file is rewritten.
+*/
+void
+CLStopSounds()
+{
+	DTSStopAllSounds();
+	
+	for ( int ii = 0;  ii < kNumTracks;  ++ii )
+		gTrack[ ii ].trackBusy = false;
+}
+
+
 /*
 **	CLPlaySound()
 **
@@ -138,8 +132,8 @@ CLPlaySound( DTSKeyID sndID )
 	if ( not gPrefsData.pdSound )
 		return;
 	
-	if ( CLSound * sound = CacheSound( sndID ) )
-		sound->Play();
+	if ( CLTrack * track = ChooseTrack( sndID ) )
+		track->Play( sndID, CLTrack::kPriorityNormal );
 	
 	// clear the error code, because we don't care if there was an error
 	// but someone later might get confused by our leftover error
@@ -166,80 +160,38 @@ SetSoundVolume( uint volume )
 
 
 /*
-**	CLSound::~CLSound()
-*/
-CLSound::~CLSound()
-{
-	// subtract ourselves from all tracks
-	for ( int ii = 0; ii < kNumTracks; ++ii )
-		{
-		if ( gTrack[ ii ].trackSound == this )
-			gTrack[ ii ].trackSound = nullptr;
-		}
-}
-
-
-/*
-**	CLSound::Init();
-*/
-DTSError
-CLSound::Init( DTSKeyID sndID, SoundPriority priority )
-{
-	void * data = nullptr;
-	size_t len = 0;
-	DTSError result = TaggedReadAlloc( &gClientSoundsFile, kTypeSound,
-							sndID, data, "CLSoundInitSnd" );
-	if ( noErr == result )
-		result = gClientSoundsFile.GetSize( kTypeSound, sndID, &len );
-	if ( noErr == result )
-		result = soundDTS.Init( data, len );
-	if ( noErr == result )
-		soundPriority = priority;
-	
-	// now that the DTSSound has the bytes (and has copied them to its internal storage)
-	// we can safely get rid of our originals, which are redundant & wasteful
-	delete[] static_cast<char *>( data );	// from TaggedReadAlloc()
-	
-	return result;
-}
-
-
-/*
-**	CLSound::Play()
+**	ChooseTrack()
+**
+**	pick the track that should play the given sound:
+**	an idle one if possible, else whichever is playing the least important sound
 */
-void
-CLSound::Play()
+CLTrack *
+ChooseTrack( DTSKeyID sndID )
 {
 	// see what tracks are still playing
 	CLTrack * track = gTrack;	// i.e., &gTrack[ 0 ]
 	int nnn;
 	for ( nnn = kNumTracks - 1;  nnn >= 0;  --nnn, ++track )
 		{
-		if ( const CLSound * sound = track->trackSound )
-			{
-			if ( sound->soundDTS.IsDone() )
-				track->trackSound = nullptr;
-			}
+		if ( track->trackBusy && track->trackSound.IsDone() )
+			track->trackBusy = false;
 		}
 	
 	// lower the priority of all tracks already playing this sound
 	track = gTrack;
 	for ( nnn = kNumTracks - 1;  nnn >= 0;  --nnn, ++track )
 		{
-		if ( track->trackSound == this )
-			track->trackPriority = kPriorityLowest;
+		if ( track->trackBusy && track->trackSoundID == sndID )
+			track->trackPriority = CLTrack::kPriorityLowest;
 		}
 	
 	// find a track that is not playing
-	// if there is one, start playing the sound, and we're done.
+	// if there is one, we're done.
 	track = gTrack;
 	for ( nnn = kNumTracks - 1;  nnn >= 0;  --nnn, ++track )
 		{
-		if ( not track->trackSound )
-			{
-			track->Play( this );
-			return;
-			}
+		if ( not track->trackBusy )
+			return track;
 		}
 	
 	// No tracks were idle.
@@ -257,12 +209,11 @@ CLSound::Play()
 			}
 		}
 	
-	// ... and stop that track; then play this sound in its place
+	// ... and stop that track, so this sound can play in its place
 	if ( lowestTrack )
-		{
-		lowestTrack->trackSound->soundDTS.Stop();
-		lowestTrack->Play( this );
-		}
+		lowestTrack->trackSound.Stop();
+	
+	return lowestTrack;
 }
 
 
@@ -272,90 +223,11 @@ CLSound::Play()
 **	assign a sound to a track, and start it playing
 */
 void
-CLTrack::Play( CLSound * sound )
+CLTrack::Play( DTSKeyID sndID, SoundPriority priority )
 {
-	trackSound    = sound;
-	trackPriority = sound->soundPriority;
-	sound->soundDTS.Play();
-}
-
-
-/*
-**	LoadCacheSound()
-**
-**	load the sound
-*/
-static DTSError
-LoadCacheSound( DTSKeyID sndID, CLSound ** psound )
-{
-	CLSound * sound = nullptr;
-	
-	// allocate a sound record
-	DTSError result = noErr;
-//	if ( noErr == result )
-		{
-		sound = NEW_TAG("CLSound") CLSound;
-		if ( not sound )
-			result = memFullErr;
-		}
-	// load the sound
-	if ( noErr == result )
-		result = sound->Init( sndID, CLSound::kPriorityNormal );
-	
-	// recover from an error
-	if ( result != noErr )
-		{
-		delete sound;
-		sound = nullptr;
-		}
+	DTSError result = trackSound.Play( &gClientSoundsFile, kTypeSound, sndID );
 	
-	// return the sound record and the result
-	if ( psound )
-		*psound = sound;
-	
-	return result;
-}
-
-
-/*
-**	CacheSound()
-**
-**	find the sound in the linked list, or add it
-*/
-CLSound *
-CacheSound( DTSKeyID sndID )
-{
-	// search for it in the sound cache
-	for ( CacheObject * walk = gRootCacheObject;  walk;  walk = walk->linkNext )
-		{
-		if ( CacheObject::kCacheTypeSound == walk->coType )
-			{
-			CLSound * sound = static_cast<CLSound *>( walk );
-			
-			// we found it!
-			if ( sound->soundID == sndID )
-				{
-				// mark it as most-recently-used
-				sound->Touch();
-				return sound;
-				}
-			}
-		}
-	
-	// it was not in the cache
-	CLSound * sound = nullptr;
-	
-	// load the data and deal with memory issues
-	DTSError result = LoadCacheSound( sndID, &sound );
-	
-	// cache the sound
-	if ( noErr == result )
-		{
-		sound->soundID = sndID;
-		sound->InstallLast( gRootCacheObject );
-		}
-	
-	return sound;
+	trackSoundID  = sndID;
+	trackPriority = priority;
+	trackBusy     = (noErr == result);
 }
-
-
@@ -0,0 +1,300 @@
+/*
+**	StartupTrace_cl.cp		Clanlord Client
+** 
+**	Copyright 2023 Delta Tao Software, Inc.
+** 
+**	Licensed under the Apache License, Version 2.0 (the "License");
+**	you may not use this file except in compliance with the License.
+**	You may obtain a copy of the License at
+** 
+**     https://www.apache.org/licenses/LICENSE-2.0
+** 
+**	Unless required by applicable law or agreed to in writing, software
+**	distributed under the License is distributed on an "AS IS" BASIS,
+**	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+**	See the License for the specific language governing permissions and
+**	imitations under the License.
+*/
+
+/*
+**	times the client's way from launch to a usable window, and from the Play
+**	command to the game.
+**
+**	each stage is a run of phases on the main thread. a phase is reported when it
+**	ends, and runs from the end of the one before, so main() and PlayGame() need
+**	only a TraceStartupPhase() after each step. work handed to other threads is
+**	reported as a task, with its own start and end. each stage is traced once per
+**	session; \BENCHMARK STARTUP shows the lot.
+**
+**	with --startup-benchmark on the command line, main() quits as soon as the
+**	window is ready, and the trace goes to stdout.
+*/
+
+#include "ClanLord.h"
+
+#include <sys/sysctl.h>
+#include <unistd.h>
+
+
+/*
+**	Definitions
+*/
+const int		kMaxStartupEvents	= 64;
+const char		kStartupBenchmarkArg[]	= "--startup-benchmark";
+
+
+/*
+**	Internal Classes
+*/
+
+// one phase or task
+struct StartupEvent
+{
+	const char *		seName;			// a string constant
+	int					seStage;		// kStartupStages for background tasks; -1 if abandoned
+	CFAbsoluteTime		seStart;
+	CFAbsoluteTime		seEnd;
+	volatile bool		seDone;			// set last, so the main thread can skip half-written ones
+};
+
+
+/*
+**	Internal Variables
+*/
+bool						gStartupBenchmark;
+
+static StartupEvent			sEvents[ kMaxStartupEvents ];
+static volatile int32_t		sNumEvents;					// slots handed out
+static CFAbsoluteTime		sLaunchTime;				// when the process began
+static int					sStage = kStartupStages;	// the stage being traced, if any
+static CFAbsoluteTime		sMark;						// when its current phase began
+static CFAbsoluteTime		sStageBegin[ kStartupStages ];
+static CFAbsoluteTime		sStageEnd[ kStartupStages ];	// 0 until the stage is done
+static const char * const	sStageNames[ kStartupStages ] =
+	{
+	"Startup",
+	"Joining the game"
+	};
+
+
+/*
+**	Internal Routines
+*/
+static CFAbsoluteTime	GetLaunchTime();
+static void				AddStartupEvent( const char * name, int stage,
+							CFAbsoluteTime start, CFAbsoluteTime end );
+static void				ShowStartupLine( const char * text );
+
+
+/*
+**	BeginStartupTrace()
+**
+**	call first thing in main(); starts the kStartupLaunch stage
+*/
+void
+BeginStartupTrace( int argc, char ** argv )
+{
+	for ( int n = 1;  n < argc;  ++n )
+		{
+		if ( 0 == strcmp( argv[n], kStartupBenchmarkArg ) )
+			gStartupBenchmark = true;
+		}
+	
+	sLaunchTime = GetLaunchTime();
+	sStage = kStartupLaunch;
+	sStageBegin[ sStage ] = sMark = sLaunchTime;
+	TraceStartupPhase( "before main()" );
+}
+
+
+/*
+**	GetLaunchTime()
+**
+**	when the kernel started this process; or now, if it won't say
+*/
+CFAbsoluteTime
+GetLaunchTime()
+{
+	CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+	
+	int mib[] = { CTL_KERN, KERN_PROC, KERN_PROC_PID, getpid() };
+	struct kinfo_proc info;
+	size_t len = sizeof info;
+	if ( 0 != sysctl( mib, sizeof mib / sizeof mib[0], &info, &len, nullptr, 0 ) )
+		return now;
+	
+	const timeval& tv = info.kp_proc.p_starttime;
+	CFAbsoluteTime started = tv.tv_sec + tv.tv_usec / 1.0e6 - kCFAbsoluteTimeIntervalSince1970;
+	
+	// a clock change could make that nonsense
+	if ( started > now  ||  started < now - 60 )
+		return now;
+	return started;
+}
+
+
+/*
+**	BeginStartupStage()
+**
+**	start timing a stage, unless it has already been traced this session.
+**	if an earlier try at it never finished, forget that one's phases.
+*/
+void
+BeginStartupStage( int stage )
+{
+	if ( stage < 0  ||  stage >= kStartupStages  ||  sStageEnd[ stage ] )
+		return;
+	
+	int count = sNumEvents;
+	if ( count > kMaxStartupEvents )
+		count = kMaxStartupEvents;
+	for ( int n = 0;  n < count;  ++n )
+		{
+		if ( stage == sEvents[ n ].seStage )
+			sEvents[ n ].seStage = -1;
+		}
+	
+	sStage = stage;
+	sStageBegin[ sStage ] = sMark = CFAbsoluteTimeGetCurrent();
+}
+
+
+/*
+**	TraceStartupPhase()
+**
+**	main thread: the phase that just ended, named by a string constant
+*/
+void
+TraceStartupPhase( const char * phase )
+{
+	if ( kStartupStages == sStage )
+		return;
+	
+	CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+	AddStartupEvent( phase, sStage, sMark, now );
+	sMark = now;
+}
+
+
+/*
+**	EndStartupStage()
+**
+**	the current stage is done
+*/
+void
+EndStartupStage()
+{
+	if ( kStartupStages == sStage )
+		return;
+	
+	sStageEnd[ sStage ] = CFAbsoluteTimeGetCurrent();
+	sStage = kStartupStages;
+}
+
+
+/*
+**	TraceStartupTask()
+**
+**	any thread: a piece of background work that began at 'started' has just ended
+*/
+void
+TraceStartupTask( const char * task, CFAbsoluteTime started )
+{
+	AddStartupEvent( task, kStartupStages, started, CFAbsoluteTimeGetCurrent() );
+}
+
+
+/*
+**	AddStartupEvent()
+**
+**	claim a slot and fill it in; the trace just stops growing when it's full
+*/
+void
+AddStartupEvent( const char * name, int stage, CFAbsoluteTime start, CFAbsoluteTime end )
+{
+	int32_t slot = __sync_fetch_and_add( &sNumEvents, 1 );
+	if ( slot >= kMaxStartupEvents )
+		return;
+	
+	StartupEvent& ev = sEvents[ slot ];
+	ev.seName	= name;
+	ev.seStage	= stage;
+	ev.seStart	= start;
+	ev.seEnd	= end;
+	__sync_synchronize();
+	ev.seDone	= true;
+}
+
+
+/*
+**	ShowStartupTrace()
+**
+**	list every finished stage, phase by phase, then the background tasks
+*/
+void
+ShowStartupTrace()
+{
+	int count = sNumEvents;
+	if ( count > kMaxStartupEvents )
+		count = kMaxStartupEvents;
+	
+	SafeString msg;
+	for ( int stage = 0;  stage < kStartupStages;  ++stage )
+		{
+		if ( not sStageEnd[ stage ] )
+			continue;
+			
+		msg.Clear();
+			/* "* %s took %.1f ms, and was done %.1f ms after launch." */
+		msg.Format( _(TXTCL_CMD_BENCHMARK_STARTUP), sStageNames[ stage ],
+			( sStageEnd[ stage ] - sStageBegin[ stage ] ) * 1000.0,
+			( sStageEnd[ stage ] - sLaunchTime ) * 1000.0 );
+		ShowStartupLine( msg.Get() );
+		
+		for ( int n = 0;  n < count;  ++n )
+			{
+			const StartupEvent& ev = sEvents[ n ];
+			if ( not ev.seDone  ||  stage != ev.seStage )
+				continue;
+				
+			msg.Clear();
+				/* "*   %s: %.1f ms" */
+			msg.Format( _(TXTCL_CMD_BENCHMARK_STARTUP_PHASE), ev.seName,
+				( ev.seEnd - ev.seStart ) * 1000.0 );
+			ShowStartupLine( msg.Get() );
+			}
+		}
+	
+	for ( int n = 0;  n < count;  ++n )
+		{
+		const StartupEvent& ev = sEvents[ n ];
+		if ( not ev.seDone  ||  kStartupStages != ev.seStage )
+			continue;
+			
+		msg.Clear();
+			/* "* In the background, %s took %.1f ms, from %.1f ms after launch." */
+		msg.Format( _(TXTCL_CMD_BENCHMARK_STARTUP_TASK), ev.seName,
+			( ev.seEnd - ev.seStart ) * 1000.0,
+			( ev.seStart - sLaunchTime ) * 1000.0 );
+		ShowStartupLine( msg.Get() );
+		}
+}
+
+
+/*
+**	ShowStartupLine()
+**
+**	to stdout for --startup-benchmark, since we're about to quit;
+**	otherwise to the text window
+*/
+void
+ShowStartupLine( const char * text )
+{
+	if ( gStartupBenchmark )
+		{
+		std::fputs( text, stdout );
+		std::fputc( '\n', stdout );
+		}
+	else
+		ShowInfoText( text );
+}
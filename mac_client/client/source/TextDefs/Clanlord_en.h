@@ -66,10 +66,32 @@
 #define TXTCL_CMD_HELP_BARDVOLUME "\\PREF BARDVOLUME <0-100> Sets the bard song volume."
 #define TXTCL_CMD_HELP_NEWLOG "\\PREF NEWLOG <TRUE/FALSE> Will set whether to start a new text log file on every Join."
 #define TXTCL_CMD_HELP_MOVIELOGS "\\PREF MOVIELOGS <TRUE/FALSE> Will set whether to save text logs when playing movies."
+#define TXTCL_CMD_HELP_SMOOTHMOTION "\\PREF SMOOTHMOTION <TRUE/FALSE> Will set whether to glide smoothly between frames, at the cost of a little delay."
+#define TXTCL_CMD_HELP_SMOOTHLATENCY "\\PREF SMOOTHLATENCY <MILLISECONDS> Will set the most that smooth motion may delay the display. The default is 150."
 #define TXTCL_CMD_HELP_LABEL "\\LABEL <PLAYER> <LABEL> Labels a player as a friend with that label.  Possible labels are red, orange, green, blue, purple, and none.  \\FORGET will also remove a label."
 #define TXTCL_CMD_HELP_BLOCK "\\BLOCK <PLAYER> Sets a player to be blocked. You will not hear anything they say."
 #define TXTCL_CMD_HELP_FORGET "\\FORGET <PLAYER> Undoes a block, label, or ignore."
 #define TXTCL_CMD_HELP_IGNORE  "\\IGNORE <PLAYER> Sets a player to be ignored. You will not hear anything they say, and they will be invisible."
+#define TXTCL_CMD_HELP_MEMSTATS "\\MEMSTATS <SHOW/RESET/LOG/COUNT> Reports how the client is using memory."
+#define TXTCL_CMD_HELP_MEMSTATS_SHOW "\\MEMSTATS SHOW Lists the biggest users of memory, by subsystem."
+#define TXTCL_CMD_HELP_MEMSTATS_RESET "\\MEMSTATS RESET Forgets the memory high-water marks."
+#define TXTCL_CMD_HELP_MEMSTATS_LOG "\\MEMSTATS LOG <SECONDS/OFF> Periodically saves memory statistics to the file \"CL_AllocProfile.txt\"."
+#define TXTCL_CMD_HELP_MEMSTATS_COUNT "\\MEMSTATS COUNT [ON/OFF] Starts or stops counting memory allocations. Off saves a little time on each one; counting is on at launch."
+#define TXTCL_CMD_HELP_BENCHMARK "\\BENCHMARK <SOUND/TUNE/LOOPBACK/DESCTABLE/PLAYERS/REGEXP/BLIT/DOWNLOAD/STARTUP> Times a part of the client against a made-up worst case."
+#define TXTCL_CMD_HELP_BENCHMARK_SOUND "\\BENCHMARK SOUND [VOICES] [SECONDS] Times the sound mixer playing a huge battle, then checks its output against a plain reference mix."
+#define TXTCL_CMD_HELP_BENCHMARK_TUNE "\\BENCHMARK TUNE [ROUNDS] Times how fast bard songs are compiled, without playing them."
+#define TXTCL_CMD_HELP_BENCHMARK_LOOPBACK "\\BENCHMARK LOOPBACK [PORT] Joins a CLLoopbackServer on this computer, which plays a movie over the network."
+#define TXTCL_CMD_HELP_BENCHMARK_DESCTABLE "\\BENCHMARK DESCTABLE [ROUNDS] Times the loops over the descriptor table, laid out as movies store it and as the client keeps it."
+#define TXTCL_CMD_HELP_BENCHMARK_PLAYERS "\\BENCHMARK PLAYERS [COUNT] [ROUNDS] Times looking up players by name, as the game field does, in a made-up history of COUNT players."
+#define TXTCL_CMD_HELP_BENCHMARK_REGEXP "\\BENCHMARK REGEXP FILE [ROUNDS] Times the regular expressions that read server text over each line of a text log, with and without their DFA."
+#define TXTCL_CMD_HELP_BENCHMARK_BLIT "\\BENCHMARK BLIT [ROUNDS] Checks the vector sprite blitters against the plain ones, then times them all (the opaque/transparent rates are shown in pairs)."
+#define TXTCL_CMD_HELP_BENCHMARK_DOWNLOAD "\\BENCHMARK DOWNLOAD URL Downloads and expands a .gz file the way updates are fetched, without keeping it."
+#define TXTCL_CMD_HELP_BENCHMARK_STARTUP "\\BENCHMARK STARTUP Shows how long each step of starting up and joining the game took. Launch with --startup-benchmark to quit as soon as the window is ready."
+#define TXTCL_CMD_HELP_NETSTATS "\\NETSTATS <SHOW/RESET/OVERLAY/LOG> Reports how well the connection to the server is doing."
+#define TXTCL_CMD_HELP_NETSTATS_SHOW "\\NETSTATS SHOW Lists round-trip times, frame timing, lost and late frames, and bandwidth."
+#define TXTCL_CMD_HELP_NETSTATS_RESET "\\NETSTATS RESET Starts the network statistics afresh."
+#define TXTCL_CMD_HELP_NETSTATS_OVERLAY "\\NETSTATS OVERLAY <ON/OFF> Will set whether to show network statistics over the game field."
+#define TXTCL_CMD_HELP_NETSTATS_LOG "\\NETSTATS LOG <SECONDS/OFF> Periodically saves network statistics to the file \"CL_NetStats.csv\"."
 #define TXTCL_CMD_HELP_MOVE "\\MOVE <DIRECTION> <SPEED> causes your character to move in direction at speed. Speed may be STOP, WALK, or RUN."
 #define TXTCL_CMD_HELP_PREF "\\PREF <PREFERENCE> <VALUE> Sets a client preference."
 #define TXTCL_CMD_HELP_RECORD "\\RECORD <ON/OFF> starts or stops recording a movie."
@@ -87,6 +109,51 @@
 #define TXTCL_CMD_ERR_RECORDINGSTARTED "* Recording started."
 #define TXTCL_CMD_ERR_RECORDINGSTOPPED "* Recording stopped."
 #define TXTCL_CMD_ERR_NOMOVIEISRECORDED "* No movie is being recorded."
+#define TXTCL_CMD_MEMSTATS_HEADER "* Memory usage by tag, over the last %.0f seconds:"
+#define TXTCL_CMD_MEMSTATS_LINE "  %s: %lu KB in %lu blocks, peak %lu KB, %.0f allocs/sec"
+#define TXTCL_CMD_MEMSTATS_RESET "* Memory high-water marks reset."
+#define TXTCL_CMD_MEMSTATS_LOGGING "* Saving memory statistics to \"CL_AllocProfile.txt\" every %d seconds."
+#define TXTCL_CMD_MEMSTATS_NOTLOGGING "* Stopped saving memory statistics."
+#define TXTCL_CMD_MEMSTATS_COUNTING "* Counting memory allocations."
+#define TXTCL_CMD_MEMSTATS_NOTCOUNTING "* Not counting memory allocations; the figures will drift."
+#define TXTCL_CMD_NETSTATS_RTT "* Command round trip: %.0f ms median, %.0f ms 90th percentile, %.0f ms 99th percentile (%.0f to %.0f ms, over %lu commands)."
+#define TXTCL_CMD_NETSTATS_NORTT "* No command round trips measured yet."
+#define TXTCL_CMD_NETSTATS_FRAMES "* Frames: %lu received, %.0f ms apart (99th percentile %.0f ms), jitter %.1f ms."
+#define TXTCL_CMD_NETSTATS_LOSS "* Lost %lu frames in %lu bursts (longest %d; by size 1: %lu, 2: %lu, 3: %lu, 4-7: %lu, 8+: %lu)."
+#define TXTCL_CMD_NETSTATS_LATE "* %lu frames came late, in %lu bursts (longest %d, up to %d frames behind)."
+#define TXTCL_CMD_NETSTATS_BANDWIDTH "* Bandwidth: %.2f KB/sec in, %.2f KB/sec out; %.1f KB in and %.1f KB out in all."
+#define TXTCL_CMD_NETSTATS_TRAFFIC "  %s: %.2f KB/sec"
+#define TXTCL_CMD_NETSTATS_RESET "* Network statistics reset."
+#define TXTCL_CMD_NETSTATS_OVERLAY_ON "* Showing network statistics over the game field."
+#define TXTCL_CMD_NETSTATS_OVERLAY_OFF "* Stopped showing network statistics."
+#define TXTCL_CMD_NETSTATS_LOGGING "* Saving network statistics to \"CL_NetStats.csv\" every %d seconds."
+#define TXTCL_CMD_NETSTATS_NOTLOGGING "* Stopped saving network statistics."
+#define TXTCL_CMD_BENCHMARK_SOUND "* Mixed %.0f seconds of sound on %d voices in %.3f seconds (%.0fx real time); %lu sounds started, %lu cut short."
+#define TXTCL_CMD_BENCHMARK_SOUND_FAILED "Sound benchmark failed (%d)."
+#define TXTCL_CMD_BENCHMARK_SOUND_DIFFER "* The mixer differed from the reference mix on %d samples!"
+#define TXTCL_CMD_BENCHMARK_LOOPBACK "* Joining the loopback server on port %d."
+#define TXTCL_CMD_BENCHMARK_LOOPBACK_PLAYING "* Leave the game before joining the loopback server."
+#define TXTCL_CMD_BENCHMARK_LOOPBACK_FAILED "Loopback benchmark failed (%d)."
+#define TXTCL_CMD_BENCHMARK_DESCTABLE "* Walked %d descriptors and %d mobiles %d times: %.3f seconds as stored (%d bytes each), %.3f seconds as kept (%d bytes each)."
+#define TXTCL_CMD_BENCHMARK_DESCTABLE_COLD "* With a cold cache, %d times: %.1f microseconds each as stored, %.1f as kept."
+#define TXTCL_CMD_BENCHMARK_DESCTABLE_DIFFER "Descriptor benchmark mismatch (%d)."
+#define TXTCL_CMD_BENCHMARK_PLAYERS "* %d players: built the tree in %.3f seconds and the index in %.3f; %d lookups took %.3f seconds in the tree and %.3f in the index."
+#define TXTCL_CMD_BENCHMARK_PLAYERS_FAILED "Player index benchmark: %d lookups failed."
+#define TXTCL_CMD_BENCHMARK_REGEXP "* /%s/ matched %d of %d lines. %d times over took %.3f seconds with the DFA (%.1f MB/s), %.3f without (%.1f MB/s)."
+#define TXTCL_CMD_BENCHMARK_REGEXP_DIFFER "* The DFA and the backtracking matcher disagreed %d times!"
+#define TXTCL_CMD_BENCHMARK_REGEXP_NOLOG "Could not read the text log \"%s\" (%d)."
+#define TXTCL_CMD_BENCHMARK_BLIT "* Blitted %d pixels %d times each way; the game is using the %s blitters."
+#define TXTCL_CMD_BENCHMARK_BLIT_DIFFER "* The vector blitters differed from the scalar ones %d times!"
+#define TXTCL_CMD_BENCHMARK_BLIT_KERNEL "* %s: transparent %.0f, 25%% %.0f/%.0f, 50%% %.0f/%.0f, 75%% %.0f/%.0f, quality %.0f megapixels a second."
+#define TXTCL_CMD_BENCHMARK_BLIT_NOMEMORY "Not enough memory for the blitter benchmark."
+#define TXTCL_CMD_BENCHMARK_DOWNLOAD "* Downloaded %lld bytes (%lld expanded) in %.3f seconds (%.1f MB/s) on %d connections, with %d reconnects."
+#define TXTCL_CMD_BENCHMARK_DOWNLOAD_NOTEMP "Could not make a temporary file."
+#define TXTCL_CMD_BENCHMARK_DOWNLOAD_FAILED "Could not download \"%s\" (%d)."
+#define TXTCL_CMD_BENCHMARK_STARTUP "* %s took %.1f ms, and was done %.1f ms after launch."
+#define TXTCL_CMD_BENCHMARK_STARTUP_PHASE "*   %s: %.1f ms"
+#define TXTCL_CMD_BENCHMARK_STARTUP_TASK "* In the background, %s took %.1f ms, from %.1f ms after launch."
+#define TXTCL_CMD_BENCHMARK_TUNE "* Built %ld songs (%ld ops per trio) in %.3f seconds, or %.3f seconds from the cache; rendered %ld notes in %.3f seconds."
+#define TXTCL_CMD_BENCHMARK_TUNE_FAILED "Tune benchmark failed (%d)."
 #define TXTCL_CMD_LOG_PRAY "You pray, \"%s\""
 #define TXTCL_CMD_LOG_REPORT "You report, \"%s\""
 #define TXTCL_CMD_SUBCOMMANDS "  Subcommands:"
@@ -83,7 +83,8 @@ CTuneBuilder::sErrorMessages[] =
 //	allocate the zero-size container
 //
 CDataHandle::CDataHandle()
-	: mData( nullptr )
+	: mData( nullptr ),
+	  mSize( 0 )
 {
 #if 1
 	mData = CFDataCreateMutable( kCFAllocatorDefault, 0 );
@@ -124,13 +125,26 @@ char *
 CDataHandle::Add( const void * inData, long inSize )
 {
 #if 1
-	CFIndex oldsize = CFDataGetLength( mData );
+	// songs grow an op or two at a time, so don't resize the CFData every time;
+	// double it instead, and keep track of how much is really in use
+	CFIndex oldsize = mSize;
+	CFIndex room = CFDataGetLength( mData );
+	if ( oldsize + inSize > room )
+		{
+		room *= 2;
+		if ( room < oldsize + inSize )
+			room = oldsize + inSize;
+		CFDataSetLength( mData, room );
+		}
+	
+	char * p = (char *) CFDataGetMutableBytePtr( mData ) + oldsize;
 	if ( inData )
-		CFDataAppendBytes( mData, static_cast<const uchar *>( inData ), inSize );
+		memcpy( p, inData, inSize );
 	else
-		CFDataSetLength( mData, oldsize + inSize );
+		memset( p, 0, inSize );		// as CFDataSetLength() would have done
+	mSize += inSize;
 	
-	return (char *) CFDataGetMutableBytePtr( mData ) + oldsize;
+	return p;
 #else
 	long oldsize = ::GetHandleSize( mData );
 	__Check_noErr( ::MemError() );
@@ -146,12 +160,30 @@ CDataHandle::Add( const void * inData, long inSize )
 	
 	if ( inData )
 		::BlockMoveData( inData, *mData + oldsize, inSize );
+	mSize += inSize;
 	
 	return *mData + oldsize;
 #endif  // 1
 }
 
 
+/*
+**	CDataHandle::Reserve()
+**
+**	make sure the next inSize bytes of Add()s won't need to move the data
+*/
+void
+CDataHandle::Reserve( long inSize )
+{
+#if 1
+	if ( mSize + inSize > CFDataGetLength( mData ) )
+		CFDataSetLength( mData, mSize + inSize );
+#else
+# pragma unused( inSize )
+#endif
+}
+
+
 /*
 **	CDataHandle::Reset()
 **
@@ -161,11 +193,12 @@ void
 CDataHandle::Reset()
 {
 #if 1
-	CFDataDeleteBytes( mData, CFRangeMake( 0, CFDataGetLength( mData ) ) );
+	// keep the storage, since it'll most likely be refilled
 #else
 	SetHandleSize( mData, 0 );
 	__Check_noErr( ::MemError() );
 #endif
+	mSize = 0;
 }
 
 
@@ -653,6 +686,9 @@ CCLInstrumentList::Delete( short inIndex )
 CTuneBuilder::CTuneBuilder() :
 		mMelodyVoice( kDefaultVoice ),
 		mChordVoice( kDefaultVoice + 1 )
+#ifndef CL_TUNE_HELPER_APP
+		, mCache( nullptr )
+#endif
 {
 #ifdef CL_TUNE_HELPER_APP
 	mNote2Text = nullptr;
@@ -673,6 +709,9 @@ CTuneBuilder::CTuneBuilder(
 	short					inStartVoice ) :
 		mMelodyVoice( inStartVoice ),
 		mChordVoice( mMelodyVoice + 1 )
+#ifndef CL_TUNE_HELPER_APP
+		, mCache( nullptr )
+#endif
 {
 	SetParameters( inInstrument, inTempo, inVelocity );
 }
@@ -863,6 +902,36 @@ CTuneBuilder::BuildTune(
 	if ( inSong )
 		inSong->Reset();
 	
+#ifndef CL_TUNE_HELPER_APP
+	// maybe we've built this very song before
+	CTuneCache::SKey cacheKey;
+	if ( mCache && inSong )
+		{
+		cacheKey.mInstrument	= mInstrument;
+		cacheKey.mTempo			= mTempo;
+		cacheKey.mVelocity		= mVelocity;
+		cacheKey.mMelodyVoice	= mMelodyVoice;
+		cacheKey.mChordVoice	= mChordVoice;
+		cacheKey.mText			= inMusic;
+		cacheKey.mTextLen		= inMusicLen;
+		
+		SBuildStats stats;
+		if ( mCache->Find( cacheKey, inSong, stats ) )
+			{
+			SetStats( stats );
+			mErrorPosition	= 0;
+			mError			= noErr;
+			return noErr;
+			}
+		}
+#endif  // ! CL_TUNE_HELPER_APP
+	
+	// make room for a note and a rest per character, plus the lead-in and trailing
+	// pauses and the end mark, so the song won't have to grow along the way.
+	// (Repeats can take more than that, but Add() copes.)
+	if ( inSong )
+		inSong->Reserve( (2 * inMusicLen + 3) * sizeof(MusicOpWord) );
+	
 	// reset the flags if present
 #ifdef CL_TUNE_HELPER_APP
 	if ( ioFlags )
@@ -1485,6 +1554,13 @@ CTuneBuilder::BuildTune(
 		StuffEndSong( inSong );
 	
 #ifndef CL_TUNE_HELPER_APP
+	if ( not mError && mCache && inSong )
+		{
+		SBuildStats stats;
+		GetStats( stats );
+		mCache->Store( cacheKey, inSong, stats );
+		}
+	
 	if ( mError && inErrors )
 		{
 		SafeString msg;
@@ -1501,6 +1577,132 @@ CTuneBuilder::BuildTune(
 }
 
 
+/*
+**	CTuneBuilder::GetStats()
+**
+**	retrieve the by-products of the last BuildTune()
+*/
+void
+CTuneBuilder::GetStats( SBuildStats& outStats ) const
+{
+	outStats.mBeat				= mBeat;
+	outStats.mTotalNotes		= mTotalNotes;
+	outStats.mTotalChords		= mTotalChords;
+	outStats.mTotalDuration		= mTotalDuration;
+	outStats.mMaxChordPolyphony	= mMaxChordPolyphony;
+	outStats.mEndTempo			= mTempo;
+}
+
+
+/*
+**	CTuneBuilder::SetStats()
+**
+**	put things back the way BuildTune() would have left them
+*/
+void
+CTuneBuilder::SetStats( const SBuildStats& inStats )
+{
+	mBeat				= inStats.mBeat;
+	mTotalNotes			= inStats.mTotalNotes;
+	mTotalChords		= inStats.mTotalChords;
+	mTotalDuration		= inStats.mTotalDuration;
+	mMaxChordPolyphony	= inStats.mMaxChordPolyphony;
+	if ( inStats.mEndTempo != mTempo )
+		SetTempo( inStats.mEndTempo );
+}
+
+
+/*
+**	CTuneBuilder::SameInstrument()
+**
+**	compare only the parts of two instruments that BuildTune() looks at;
+**	their QuickTime tones only matter to MakeTuneHeader()
+*/
+bool
+CTuneBuilder::SameInstrument( const CCLInstrument& inA, const CCLInstrument& inB )
+{
+	return inA.mOctaveOffset	== inB.mOctaveOffset
+		&& inA.mPolyphony		== inB.mPolyphony
+		&& inA.mFlags			== inB.mFlags
+		&& inA.mChordVelocity	== inB.mChordVelocity
+		&& inA.mMelodyVelocity	== inB.mMelodyVelocity
+		&& 0 == memcmp( inA.mRestrictions, inB.mRestrictions, sizeof inA.mRestrictions );
+}
+
+
+/*
+**	CTuneBuilder::RenderEvents()
+**
+**	walk a built song, without any QuickTime component, and list its notes
+**	with their start times. Handy for checking the builder, and for timing it.
+*/
+long
+CTuneBuilder::RenderEvents(
+	const CDataHandle *		inSong,
+	SNoteEvent *			outEvents,
+	long					inMaxEvents,
+	ulong *					outDuration )
+{
+	long numEvents	= 0;
+	ulong now		= 0;
+	
+	const MusicOpWord * w	= reinterpret_cast<const MusicOpWord *>( inSong->GetPtr() );
+	const MusicOpWord * end	= w + inSong->GetSize() / sizeof(MusicOpWord);
+	while ( w < end && kEndMarkerValue != *w )
+		{
+		SNoteEvent note;
+		bool isNote		= false;
+		ulong opLen		= 1;
+		switch ( qtma_EventType( *w ) )
+			{
+			case kRestEventType:
+				now += qtma_RestDuration( *w );
+				break;
+			
+			case kNoteEventType:
+				isNote			= true;
+				note.mDuration	= qtma_NoteDuration( *w );
+				note.mVoice		= qtma_Part( *w );
+				note.mNote		= qtma_NotePitch( *w );
+				note.mVelocity	= qtma_NoteVelocity( *w );
+				break;
+			
+			case kXNoteEventType:
+				if ( w + 1 >= end )
+					break;
+				isNote			= true;
+				note.mDuration	= qtma_XNoteDuration( w[0], w[1] );
+				note.mVoice		= qtma_XPart( w[0], w[1] );
+				note.mNote		= qtma_XNotePitch( w[0], w[1] );
+				note.mVelocity	= qtma_XNoteVelocity( w[0], w[1] );
+				if ( note.mNote > 0xFF )
+					note.mNote >>= 8;		// fractional pitches are 8.8
+				opLen			= 2;
+				break;
+			
+			default:
+				// anything else says how long it is
+				qtma_EventLengthForward( w, opLen );
+				break;
+			}
+		
+		if ( isNote )
+			{
+			note.mStart = now;
+			if ( outEvents && numEvents < inMaxEvents )
+				outEvents[ numEvents ] = note;
+			++numEvents;
+			}
+		w += opLen;
+		}
+	
+	if ( outDuration )
+		*outDuration = now;
+	
+	return numEvents;
+}
+
+
 //
 // Returns a QTMA low-level duration from a beat duration
 //
@@ -2267,6 +2469,10 @@ CTuneQueue::CTuneQueue()
 {
 	for ( int i = 0; i < max_Players; ++i )
 		mPlayers[i] = nullptr;
+		
+#ifndef CL_TUNE_HELPER_APP
+	mBuilder.SetCache( &mCache );
+#endif
 }
 
 
@@ -2843,3 +3049,282 @@ CTuneSync::Have( ulong inID ) const
 	return false;
 }
 
+
+#ifndef CL_TUNE_HELPER_APP
+#pragma mark -- CTuneCache --
+
+//
+// one remembered song
+//
+class CTuneCacheEntry : public DTSDLinkedList<CTuneCacheEntry>
+{
+public:
+	ulong						ceHash;
+	CTuneCache::SKey			ceKey;			// ceKey.mText points into ceText
+	char *						ceText;
+	char *						ceSong;			// compiled ops
+	long						ceSongLen;
+	CTuneBuilder::SBuildStats	ceStats;
+	
+					CTuneCacheEntry() : ceText( nullptr ), ceSong( nullptr ), ceSongLen( 0 ) {}
+	virtual			~CTuneCacheEntry()
+		{
+		delete[] ceText;
+		delete[] ceSong;
+		}
+	
+	long			Size() const { return ceKey.mTextLen + ceSongLen; }
+};
+
+
+//
+//	Constructor
+//
+CTuneCache::CTuneCache() :
+	mRoot( nullptr ),
+	mCount( 0 ),
+	mBytes( 0 ),
+	mHits( 0 ),
+	mMisses( 0 )
+{
+}
+
+
+//
+//	Destructor
+//
+CTuneCache::~CTuneCache()
+{
+	Flush();
+}
+
+
+/*
+**	CTuneCache::Flush()
+**
+**	forget every song
+*/
+void
+CTuneCache::Flush()
+{
+	while ( CTuneCacheEntry * entry = mRoot )
+		{
+		entry->Remove( mRoot );
+		delete entry;
+		}
+	mCount = 0;
+	mBytes = 0;
+}
+
+
+/*
+**	CTuneCache::Hash()
+**
+**	FNV-1a over everything in the key that can change the song
+*/
+ulong
+CTuneCache::Hash( const SKey& inKey )
+{
+	uint32_t hash = 2166136261U;
+#define HashBytes( p, n )	\
+	for ( const uchar * b = (const uchar *)(p), * e = b + (n); b < e; ++b )	\
+		hash = (hash ^ *b) * 16777619U
+	
+	const CCLInstrument& inst = inKey.mInstrument;
+	short fields[] =
+		{
+		inKey.mTempo, inKey.mVelocity, inKey.mMelodyVoice, inKey.mChordVoice,
+		inst.mOctaveOffset, short( inst.mPolyphony ), short( inst.mFlags ),
+		inst.mChordVelocity, inst.mMelodyVelocity
+		};
+	HashBytes( fields, sizeof fields );
+	HashBytes( inst.mRestrictions, sizeof inst.mRestrictions );
+	HashBytes( inKey.mText, inKey.mTextLen );
+	
+#undef HashBytes
+	return hash;
+}
+
+
+/*
+**	CTuneCache::Find()
+**
+**	look for a song built from the same ingredients
+*/
+bool
+CTuneCache::Find( const SKey& inKey, CDataHandle * outSong, CTuneBuilder::SBuildStats& outStats )
+{
+	ulong hash = Hash( inKey );
+	for ( CTuneCacheEntry * entry = mRoot;  entry;  entry = entry->linkNext )
+		{
+		const SKey& key = entry->ceKey;
+		if ( entry->ceHash == hash
+		&&   key.mTextLen		== inKey.mTextLen
+		&&   key.mTempo			== inKey.mTempo
+		&&   key.mVelocity		== inKey.mVelocity
+		&&   key.mMelodyVoice	== inKey.mMelodyVoice
+		&&   key.mChordVoice	== inKey.mChordVoice
+		&&   CTuneBuilder::SameInstrument( key.mInstrument, inKey.mInstrument )
+		&&   0 == memcmp( key.mText, inKey.mText, inKey.mTextLen ) )
+			{
+			// most recently used goes to the front
+			if ( entry != mRoot )
+				{
+				entry->Remove( mRoot );
+				entry->InstallFirst( mRoot );
+				}
+			
+			outSong->Reset();
+			outSong->Add( entry->ceSong, entry->ceSongLen );
+			outStats = entry->ceStats;
+			++mHits;
+			return true;
+			}
+		}
+	
+	++mMisses;
+	return false;
+}
+
+
+/*
+**	CTuneCache::Store()
+**
+**	remember a freshly-built song; the least recently used make room for it
+*/
+void
+CTuneCache::Store( const SKey& inKey, const CDataHandle * inSong,
+					const CTuneBuilder::SBuildStats& inStats )
+{
+	long songLen = inSong->GetSize();
+	
+	// don't let one epic push out everything else
+	if ( inKey.mTextLen + songLen > max_Bytes / 4 )
+		return;
+	
+	CTuneCacheEntry * entry = NEW_TAG("CTuneCacheEntry") CTuneCacheEntry;
+	if ( not entry )
+		return;
+	entry->ceText = NEW_TAG("CTuneCacheText") char[ inKey.mTextLen ];
+	entry->ceSong = NEW_TAG("CTuneCacheSong") char[ songLen ];
+	if ( not entry->ceText || not entry->ceSong )
+		{
+		delete entry;
+		return;
+		}
+	
+	memcpy( entry->ceText, inKey.mText, inKey.mTextLen );
+	memcpy( entry->ceSong, inSong->GetPtr(), songLen );
+	entry->ceSongLen	= songLen;
+	entry->ceKey		= inKey;
+	entry->ceKey.mText	= entry->ceText;
+	entry->ceHash		= Hash( inKey );
+	entry->ceStats		= inStats;
+	
+	entry->InstallFirst( mRoot );
+	++mCount;
+	mBytes += entry->Size();
+	
+	while ( mCount > max_Entries || mBytes > max_Bytes )
+		{
+		CTuneCacheEntry * oldest = CTuneCacheEntry::Last( mRoot );
+		oldest->Remove( mRoot );
+		--mCount;
+		mBytes -= oldest->Size();
+		delete oldest;
+		}
+}
+
+
+#pragma mark -- Benchmark --
+
+/*
+**	TuneBenchmark()
+**
+**	time the builder on a busy trio: loops with alternate endings, chords,
+**	long chords, tempo and volume changes
+*/
+OSStatus
+TuneBenchmark( int inRounds, STuneBenchmark * outResult )
+{
+	if ( inRounds <= 0 || not outResult )
+		return paramErr;
+	
+	static const char * const kParts[] =
+		{
+		"(cdefg2 p agfed4 |1 ceg2 |2 fag2 ! bag2)3 +c d e -b a g4 p2 "
+		"<second verse> %7 e f g a b C4 %10 (c#d e.f g_g a)2 C8",
+		
+		"[ceg]4 e f g a [dfa]4 f g a b [egb]8 g a b C [ceg]2 "
+		"(c p e p [ceg]2 g p)4 [dfa]$ d e f g a b C2 [dfa]$ c4",
+		
+		"@100 \\c4 g4 c4 g4 (a4 e4 |1 f4 C4 ! g4 d4)2 {2 c8 }2 [\\c g]4 c4 =e4 g4"
+		};
+	const int kNumParts = sizeof kParts / sizeof kParts[0];
+	
+	// a plain instrument that can do everything
+	CCLInstrument inst;
+	memset( &inst.mInstrument, 0, sizeof inst.mInstrument );
+	inst.mPolyphony	= CCLInstrument::default_Polyphony;
+	inst.mUnused	= 0;
+	inst.mFlags		= CCLInstrument::flags_LongChord;
+	
+	CTuneBuilder builder( inst, kDefaultTempo, kDefaultVelocity );
+	CTuneCache cache;
+	CDataHandle songs[ kNumParts ];
+	STuneBenchmark result;
+	memset( &result, 0, sizeof result );
+	result.tbBuilds = long( inRounds ) * kNumParts;
+	
+	OSStatus err = noErr;
+	for ( int pass = 0; pass < 2 && noErr == err; ++pass )
+		{
+		// first without the cache, then with it
+		builder.SetCache( pass ? &cache : nullptr );
+		
+		EventTime start = GetCurrentEventTime();
+		for ( int round = 0; round < inRounds && noErr == err; ++round )
+			{
+			for ( int part = 0; part < kNumParts && noErr == err; ++part )
+				{
+				builder.SetParameters( inst, kDefaultTempo, kDefaultVelocity );
+				err = builder.BuildTune( &songs[ part ], kParts[ part ],
+							strlen( kParts[ part ] ), false );
+				}
+			}
+		double elapsed = GetCurrentEventTime() - start;
+		
+		if ( pass )
+			result.tbWarmSeconds = elapsed;
+		else
+			result.tbColdSeconds = elapsed;
+		}
+	
+	if ( noErr == err )
+		{
+		for ( int part = 0; part < kNumParts; ++part )
+			{
+			result.tbOps += songs[ part ].GetSize() / sizeof(MusicOpWord);
+			result.tbEvents += CTuneBuilder::RenderEvents( &songs[ part ], nullptr, 0, nullptr );
+			}
+		
+		const long kMaxEvents = 512;
+		CTuneBuilder::SNoteEvent * events = NEW_TAG("TuneBenchmark") CTuneBuilder::SNoteEvent[ kMaxEvents ];
+		if ( not events )
+			err = memFullErr;
+		
+		EventTime start = GetCurrentEventTime();
+		for ( int round = 0; round < inRounds && noErr == err; ++round )
+			{
+			for ( int part = 0; part < kNumParts; ++part )
+				CTuneBuilder::RenderEvents( &songs[ part ], events, kMaxEvents, nullptr );
+			}
+		result.tbRenderSeconds = GetCurrentEventTime() - start;
+		
+		delete[] events;
+		}
+	
+	*outResult = result;
+	return err;
+}
+#endif  // ! CL_TUNE_HELPER_APP
@@ -69,6 +69,8 @@ public:
 	
 	char *							Add( const void * inData, long inSize );
 	void							Reset();
+	void							Reserve( long inSize );
+	long							GetSize() const		{ return mSize; }
 #if 1
 	Ptr								GetPtr() const		{ return reinterpret_cast<Ptr>(
 															CFDataGetMutableBytePtr( mData ) ); }
@@ -83,6 +85,7 @@ protected:
 #else
 	Handle							mData;
 #endif
+	long							mSize;		// bytes in use; mData may be bigger
 };
 
 
@@ -232,6 +235,8 @@ protected:
 };
 
 
+class CTuneCache;
+
 //
 // This class is the real text->music converter
 //
@@ -281,6 +286,41 @@ public:
 											const char *			inTune,
 											long					inMusicLen,
 											bool					inErrors );
+											
+#ifndef CL_TUNE_HELPER_APP
+	// Let BuildTune() reuse songs it has built before (nullptr to stop)
+	void							SetCache( CTuneCache * inCache )
+		{
+		mCache = inCache;
+		}
+#endif
+	
+	// Everything BuildTune() learns about a song, besides the song itself
+	struct SBuildStats
+		{
+		long						mBeat;
+		long						mTotalNotes;
+		long						mTotalChords;
+		ulong						mTotalDuration;
+		short						mMaxChordPolyphony;
+		short						mEndTempo;		// after any '@' changes
+		};
+	
+	// Render a built song to a list of timed note events, without playing it.
+	// Returns the total number of notes, even if more than inMaxEvents.
+	struct SNoteEvent
+		{
+		ulong						mStart;			// QT 1/600s since the song began
+		ulong						mDuration;		// likewise
+		short						mVoice;
+		short						mNote;			// MIDI
+		short						mVelocity;
+		};
+	static long						RenderEvents(
+											const CDataHandle *		inSong,
+											SNoteEvent *			outEvents,
+											long					inMaxEvents,
+											ulong *					outDuration );
 
 	
 	// If an error occurred, return position in the text
@@ -366,6 +406,11 @@ public:
 
 	// Error messages
 	static const char * const		sErrorMessages[];
+	
+	// the CCLInstrument fields that make a difference to a built song
+	static bool						SameInstrument(
+											const CCLInstrument&	inA,
+											const CCLInstrument&	inB );
 		
 #ifdef CL_TUNE_HELPER_APP
 	// Flags types for the text. used by coloring.
@@ -408,6 +453,10 @@ protected:
 	short							mChordVolume;
 	short							mMelodyVolume;
 	
+#ifndef CL_TUNE_HELPER_APP
+	CTuneCache *					mCache;						// may be nullptr
+#endif
+	
 	//
 	// State machine states (mStatus) for BuildTune()
 	//
@@ -604,9 +653,90 @@ protected:
 	short							StuffGetNoteDuration(
 											bool					inLinked,
 											short					inDuration ) const;
+	
+	void							GetStats( SBuildStats& outStats ) const;
+	void							SetStats( const SBuildStats& inStats );
 };
 
 
+#ifndef CL_TUNE_HELPER_APP
+//
+// A cache of recently-built songs.
+// Bards replay their repertoire, and an ensemble's parts all arrive, and must all be
+// built, in the instant before they start; so keep the compiled ops around, keyed on
+// everything that went into them: instrument, tempo, velocity, voices, and the text.
+//
+class CTuneCacheEntry;
+class CTuneCache
+{
+public:
+									CTuneCache();
+	/* virtual */					~CTuneCache();
+	
+	enum {
+		max_Entries			= 32,
+		max_Bytes			= 256 * 1024	// of text + compiled ops, all entries together
+	};
+	
+	struct SKey
+		{
+		CCLInstrument				mInstrument;
+		short						mTempo;
+		short						mVelocity;
+		short						mMelodyVoice;
+		short						mChordVoice;
+		const char *				mText;
+		long						mTextLen;
+		};
+	
+	// copy a matching song into outSong; false if there's none
+	bool							Find(
+											const SKey&				inKey,
+											CDataHandle *			outSong,
+											CTuneBuilder::SBuildStats& outStats );
+	void							Store(
+											const SKey&				inKey,
+											const CDataHandle *		inSong,
+											const CTuneBuilder::SBuildStats& inStats );
+	void							Flush();
+	
+	ulong							GetHits() const		{ return mHits; }
+	ulong							GetMisses() const	{ return mMisses; }
+
+protected:
+	CTuneCacheEntry *				mRoot;			// most recently used first
+	int								mCount;
+	long							mBytes;
+	ulong							mHits;
+	ulong							mMisses;
+	
+	static ulong					Hash( const SKey& inKey );
+
+private:
+	// no copying
+									CTuneCache( const CTuneCache& );
+	CTuneCache&						operator=( const CTuneCache& );
+};
+
+
+//
+// Build (and render) a synthetic trio, over and over, as a bard-heavy area would;
+// cold, with no cache, and then warm. Nothing is played, so no sound hardware is needed.
+//
+struct STuneBenchmark
+{
+	long							tbBuilds;			// songs built, each way
+	long							tbOps;				// music ops per round
+	long							tbEvents;			// note events per round
+	double							tbColdSeconds;		// building without the cache
+	double							tbWarmSeconds;		// building with it
+	double							tbRenderSeconds;	// rendering to note events
+};
+
+OSStatus							TuneBenchmark( int inRounds, STuneBenchmark * outResult );
+#endif  // ! CL_TUNE_HELPER_APP
+
+
 //
 // An asynchronous tune player
 //
@@ -738,6 +868,9 @@ protected:
 	
 	CCLInstrumentList				mInstruments;
 	CTuneBuilder					mBuilder;
+#ifndef CL_TUNE_HELPER_APP
+	CTuneCache						mCache;
+#endif
 	CTunePlayer *					mPlayers[ max_Players ];
 	CTuneSync						mSync;
 	
@@ -20,6 +20,8 @@
 #include "VersionNumber_cl.h"
 #include "ProgressWin_cl.h"
 
+#include <dispatch/dispatch.h>
+
 
 /*
 **	Entry Routines
@@ -64,11 +66,49 @@ const uint	kProgressWindowKind		= kWKindMovableDlgBox
 //									| kWKindStandardHandler
 									;
 
+	// merging update files
+const long	kMergeVerifyBatch		= 64;				// records per verifier task
+const long	kMergeWriteRecords		= 512;				// most records per WriteBatch()
+const size_t kMergeWriteBytes		= 8 * 1024 * 1024;	// most bytes per WriteBatch()
+
+
+/*
+**	Internal Classes
+*/
+
+	// one record of an update file, mapped straight out of it
+struct MergeJob
+{
+	DTSKeyRecord	mjRecord;
+	
+		// for picture definitions whose bits, colors, and lighting
+		// (if any) came in the same update, so the checksum can be checked
+	const void *	mjBits;
+	size_t			mjBitsLen;
+	const void *	mjColors;
+	size_t			mjColorsLen;
+	const void *	mjLight;
+	size_t			mjLightLen;
+	
+	DTSError		mjResult;		// from the verifier
+};
+
+	// what the verifier tasks share
+struct MergeVerifyContext
+{
+	MergeJob *		mvJobs;
+	long			mvCount;
+};
+
+
 /*
 **	Internal Routines
 */
 static DTSError	Update1File( DTSKeyFile *, const char *, int, int );
 static DTSError	MergeVersionFile( DTSKeyFile * file, DTSFileSpec * spec );
+static DTSError	MapMergeJob( DTSKeyFile * source, DTSKeyType ttype, DTSKeyID id, MergeJob * job );
+static void		VerifyMergeBatch( void * context, size_t batch );
+static DTSError	VerifyMergeJob( MergeJob * job );
 static DTSError	OpenFind( DTSKeyFile * file, const char * fname, int fref );
 static void		UpdateVersionResource( const char * name, int newversion );
 static DTSError	CreateDummyImages();
@@ -117,6 +157,10 @@ OpenKeyFiles()
 			result = CreateDummySounds();
 		}
 	
+	// the decoded frames are only any good for this images file
+	if ( noErr == result )
+		OpenDecodedImages();
+	
 	SetErrorCode( result );
 }
 
@@ -129,6 +173,11 @@ OpenKeyFiles()
 void
 CloseKeyFiles()
 {
+	// the verifier reads the images file, and its results go in the prefs file
+	StopImageVerifier();
+	SaveVerifiedImages();
+	CloseDecodedImages();
+	
 	gClientImagesFile.Close();
 	gClientSoundsFile.Close();
 	gClientPrefsFile.Close();
@@ -269,6 +318,9 @@ UpdateImagesFile( int newversion )
 		// close the file
 		// open it for writing
 		// (it was previously open read-only)
+		// and forget which of its images had been verified or decoded
+		InvalidateVerifiedImages();
+		InvalidateDecodedImages();
 		gClientImagesFile.Close();
 		result = gClientImagesFile.Open( kClientImagesFName,
 			kKeyReadWritePerm | kKeyDontCreateFile );
@@ -321,9 +373,11 @@ UpdateSoundsFile( int newversion )
 	DTSError result = noErr;
 	//if ( noErr == result )
 		{
+		// stop anything streaming from the file before we rewrite it
 		// close the file
 		// open it for writing
 		// it was open read-only
+		CLStopSounds();
 		gClientSoundsFile.Close();
 		
 		result = gClientSoundsFile.Open( kClientSoundsFName,
@@ -364,7 +418,8 @@ UpdateSoundsFile( int newversion )
 **
 **	helper for Update1File()
 **	merges a single updater, deletes the updater if successful, and
-**	updates our notion of the current version
+**	updates our notion of the current version.
+**	An updater that was downloaded but never expanded is expanded first.
 */
 static DTSError
 ApplyDeleteOneFile( DTSKeyFile *	file,
@@ -373,6 +428,20 @@ ApplyDeleteOneFile( DTSKeyFile *	file,
 					int&			outCurVersion )
 {
 	DTSError result = MergeVersionFile( file, dir );
+	if ( fnfErr == result )
+		{
+		char buff[ 256 ];
+		snprintf( buff, sizeof buff, "%s.gz", dir->GetFileName() );
+		DTSFileSpec compressed = *dir;
+		compressed.SetFileName( buff );
+		if ( std::FILE * probe = compressed.fopen( "rb" ) )
+			{
+			std::fclose( probe );
+			result = ExpandFile( &compressed );
+			if ( noErr == result )
+				result = MergeVersionFile( file, dir );
+			}
+		}
 	if ( noErr == result )
 		{
 		outCurVersion = inVersion;
@@ -578,6 +647,11 @@ Update1File( DTSKeyFile * file, const char * name, const char * fname,
 **	MergeVersionFile()
 **
 **	merge this update file
+**	The records are mapped straight out of the update, checked on worker threads
+**	before anything is written, and then written a batch at a time with
+**	WriteBatch(), which lays each batch down in file order; the data file's
+**	entry table is written once, at the end, and only if every batch went in.
+**	One bad checksum rejects the whole update.
 */
 DTSError
 MergeVersionFile( DTSKeyFile * file, DTSFileSpec * spec )
@@ -586,11 +660,74 @@ MergeVersionFile( DTSKeyFile * file, DTSFileSpec * spec )
 	DTSKeyFile source;
 	int32_t version;
 	DTSKeyInfo info;
+	MergeJob * jobs = nullptr;
+	long numJobs = 0;
 	DTSError result = source.Open( spec, kKeyReadOnlyPerm | kKeyDontCreateFile );
 	if ( noErr == result )
 		result = source.CountTypes( &numTypes );
 	if ( noErr == result )
 		result = source.GetInfo( &info );
+	if ( noErr == result
+	&&	 info.keyNumRecords > 0 )
+		{
+		jobs = NEW_TAG("MergeJobs") MergeJob[ info.keyNumRecords ];
+		if ( not jobs )
+			result = memFullErr;
+		}
+	
+	// find every record
+	for ( int typeIndex = 0;  noErr == result && typeIndex < numTypes;  ++typeIndex )
+		{
+		DTSKeyType ttype;
+		result = source.GetType( typeIndex, &ttype );
+		if ( result != noErr )
+			break;
+		
+		// update the version resource last!
+		if ( kTypeVersion == ttype )
+			continue;
+		
+		long numRecords;
+		result = source.Count( ttype, &numRecords );
+		for ( int index = 0;  noErr == result && index < numRecords;  ++index )
+			{
+			if ( numJobs >= info.keyNumRecords )
+				{
+				result = -1;		// can't happen
+				break;
+				}
+			DTSKeyID id;
+			result = source.GetID( ttype, index, &id );
+			if ( noErr == result )
+				result = MapMergeJob( &source, ttype, id, &jobs[ numJobs ] );
+			if ( noErr == result )
+				++numJobs;
+			}
+		}
+	
+	// check them all, in parallel, so a damaged update fails before it does any harm
+	if ( noErr == result
+	&&	 numJobs > 0 )
+		{
+		size_t batches = static_cast<size_t>( numJobs + kMergeVerifyBatch - 1 ) / kMergeVerifyBatch;
+		for ( long n = 0;  n < numJobs;  ++n )
+			jobs[ n ].mjResult = noErr;
+		
+		MergeVerifyContext ctx = { jobs, numJobs };
+		dispatch_apply_f( batches,
+			dispatch_get_global_queue( DISPATCH_QUEUE_PRIORITY_DEFAULT, 0 ),
+			&ctx, VerifyMergeBatch );
+		
+		for ( long n = 0;  n < numJobs;  ++n )
+			{
+			if ( noErr != jobs[ n ].mjResult )
+				{
+				result = jobs[ n ].mjResult;
+				break;
+				}
+			}
+		}
+	
 	if ( noErr == result )
 		{
 		// create a progress window
@@ -608,47 +745,46 @@ MergeVersionFile( DTSKeyFile * file, DTSFileSpec * spec )
 		snprintf( buff, sizeof buff, _(TXTCL_UPDATING_SOMETHING), destName );
 		StProgressWindow pw( buff );
 		
-		int doneRecords = 0;
-		for ( int typeIndex = 0;  typeIndex < numTypes;  ++typeIndex )
+		// write them out a batch at a time, holding back the entry table till the end
+		int oldMode = file->SetWriteMode( kWriteModeFaster );
+		DTSKeyRecord * batch = NEW_TAG("MergeBatch") DTSKeyRecord[ kMergeWriteRecords ];
+		if ( not batch )
+			result = memFullErr;
+		
+		long doneRecords = 0;
+		while ( noErr == result && doneRecords < numJobs )
 			{
-			DTSKeyType ttype;
-			result = source.GetType( typeIndex, &ttype );
-			if ( result != noErr )
-				break;
-			
-			// update the version resource last!
-			if ( kTypeVersion == ttype )
-				continue;
+			pw.SetProgress( doneRecords, numJobs );
 			
-			long numRecords;
-			result = source.Count( ttype, &numRecords );
-			if ( result != noErr )
-				break;
-			for ( int index = 0;  index < numRecords;  ++index )
+			long count = 0;
+			size_t bytes = 0;
+			while ( doneRecords + count < numJobs
+			&&		count < kMergeWriteRecords
+			&&		( 0 == count || bytes < kMergeWriteBytes ) )
 				{
-				pw.SetProgress( doneRecords, info.keyNumRecords );
-				DTSKeyID id;
-				result = source.GetID( ttype, index, &id );
-				if ( result != noErr )
-					break;
-				size_t size;
-				result = source.GetSize( ttype, id, &size );
-				if ( result != noErr )
-					break;
-				void * data = nullptr;
-				result = TaggedReadAlloc( &source, ttype, id, data, "MergeVersionFile" );
-				if ( noErr == result )
-					result = file->Write( ttype, id, data, size );
-				delete[] static_cast<char *>( data );
-				if ( result != noErr )
-					break;
-				++doneRecords;
+				batch[ count ] = jobs[ doneRecords + count ].mjRecord;
+				bytes += batch[ count ].recSize;
+				++count;
 				}
-			if ( result != noErr )
-				break;
+			
+			result = file->WriteBatch( batch, count );
+			doneRecords += count;
 			}
+		pw.SetProgress( doneRecords, numJobs );
+		
+		delete[] batch;
+		
+		// this writes the table; but after a failure, the table in RAM describes
+		// half a patch. Close without writing it and re-open, so the file keeps
+		// its own table and the whole update can be tried again.
+		if ( noErr == result )
+			file->SetWriteMode( oldMode );
+		else
+			(void) file->Revert();
 		}
 	
+	delete[] jobs;
+	
 	// write the new version number last
 	if ( noErr == result )
 		result = source.Read( kTypeVersion, 0, &version, sizeof version );
@@ -659,6 +795,151 @@ MergeVersionFile( DTSKeyFile * file, DTSFileSpec * spec )
 }
 
 
+/*
+**	MapMergeJob()
+**
+**	find a record in the update file; for picture definitions, also
+**	find the records that its checksum covers, if they came along too
+*/
+DTSError
+MapMergeJob( DTSKeyFile * source, DTSKeyType ttype, DTSKeyID id, MergeJob * job )
+{
+	memset( job, 0, sizeof *job );
+	job->mjRecord.recType = ttype;
+	job->mjRecord.recID   = id;
+	
+	// the mapping belongs to the source file, which holds it till it closes
+	DTSFileMapping * mapping;
+	DTSError result = source->MapRecord( ttype, id,
+						&job->mjRecord.recData, &job->mjRecord.recSize, &mapping );
+	if ( noErr != result )
+		return result;
+	DTS_releasemap( mapping );
+	
+	if ( kTypePictureDefinition != ttype
+	||	 job->mjRecord.recSize < offsetof( PictDef, pdAnimFrameTable ) )
+		{
+		return noErr;
+		}
+	
+	PictDef pd;
+	memcpy( &pd, job->mjRecord.recData, offsetof( PictDef, pdAnimFrameTable ) );
+	DTSKeyID bitsID   = BigToNativeEndian( pd.pdBitsID );
+	DTSKeyID colorsID = BigToNativeEndian( pd.pdColorsID );
+	DTSKeyID lightID  = BigToNativeEndian( pd.pdLightingID );
+	
+	if ( noErr != source->MapRecord( kTypePictureBits, bitsID,
+						&job->mjBits, &job->mjBitsLen, &mapping ) )
+		{
+		return noErr;
+		}
+	DTS_releasemap( mapping );
+	
+	if ( noErr != source->MapRecord( kTypePictureColors, colorsID,
+						&job->mjColors, &job->mjColorsLen, &mapping ) )
+		{
+		job->mjBits = nullptr;
+		return noErr;
+		}
+	DTS_releasemap( mapping );
+	
+	if ( lightID )
+		{
+		if ( noErr != source->MapRecord( kTypeLightingData, lightID,
+							&job->mjLight, &job->mjLightLen, &mapping ) )
+			{
+			job->mjBits   = nullptr;
+			job->mjColors = nullptr;
+			return noErr;
+			}
+		DTS_releasemap( mapping );
+		}
+	
+	return noErr;
+}
+
+
+/*
+**	VerifyMergeBatch()
+**
+**	dispatch_apply_f() callback: check one batch of records
+*/
+void
+VerifyMergeBatch( void * context, size_t batch )
+{
+	const MergeVerifyContext * ctx = static_cast<const MergeVerifyContext *>( context );
+	
+	long first = static_cast<long>( batch ) * kMergeVerifyBatch;
+	long last = first + kMergeVerifyBatch;
+	if ( last > ctx->mvCount )
+		last = ctx->mvCount;
+	
+	for ( long n = first;  n < last;  ++n )
+		ctx->mvJobs[ n ].mjResult = VerifyMergeJob( &ctx->mvJobs[ n ] );
+}
+
+
+/*
+**	VerifyMergeJob()
+**
+**	is this record fit to go into the data file?
+**	Picture definitions must be whole, and if their other records came in the
+**	same update, must match their checksums. Touches nothing but the job.
+*/
+DTSError
+VerifyMergeJob( MergeJob * job )
+{
+	if ( 0 == job->mjRecord.recSize )
+		return eofErr;
+	if ( kTypePictureDefinition != job->mjRecord.recType )
+		return noErr;
+	
+	size_t size = job->mjRecord.recSize;
+	if ( size < offsetof( PictDef, pdAnimFrameTable ) )
+		return eofErr;
+	
+	PictDef pd;
+	memset( &pd, 0, sizeof pd );
+	memcpy( &pd, job->mjRecord.recData, size < sizeof pd ? size : sizeof pd );
+	
+	int nAnims = BigToNativeEndian( pd.pdNumAnims );
+	if ( nAnims < 0
+	||	 nAnims > kPictDefAnimTableSize
+	||	 size < offsetof( PictDef, pdAnimFrameTable ) + nAnims * sizeof pd.pdAnimFrameTable[0] )
+		{
+		return eofErr;
+		}
+	BigToNativeEndian( &pd );
+	
+	// can we check the sum?
+	if ( not job->mjBits
+	||	 not job->mjColors
+	||	 job->mjColorsLen > 256
+	||	 (pd.pdFlags & kPictDefFlagNoChecksum) )
+		{
+		return noErr;
+		}
+	
+	LightingData light;
+	if ( job->mjLight )
+		{
+		memset( &light, 0, sizeof light );
+		memcpy( &light, job->mjLight,
+			job->mjLightLen < sizeof light ? job->mjLightLen : sizeof light );
+		BigToNativeEndian( &light );
+		}
+	
+	uint32_t sum = CLImage::ChecksumRecords( job->mjRecord.recID, pd,
+						job->mjBits, job->mjBitsLen,
+						job->mjColors, job->mjColorsLen,
+						job->mjLight ? &light : nullptr );
+	if ( sum != pd.pdChecksum )
+		return kImageChecksumError;
+	
+	return noErr;
+}
+
+
 /*
 **	SetFileType()
 **
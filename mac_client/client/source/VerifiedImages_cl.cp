@@ -0,0 +1,621 @@
+/*
+**	VerifiedImages_cl.cp	Clanlord Client
+** 
+**	Copyright 2023 Delta Tao Software, Inc.
+** 
+**	Licensed under the Apache License, Version 2.0 (the "License");
+**	you may not use this file except in compliance with the License.
+**	You may obtain a copy of the License at
+** 
+**     https://www.apache.org/licenses/LICENSE-2.0
+** 
+**	Unless required by applicable law or agreed to in writing, software
+**	distributed under the License is distributed on an "AS IS" BASIS,
+**	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+**	See the License for the specific language governing permissions and
+**	imitations under the License.
+*/
+
+/*
+**	remembers which pictures have already passed their checksum.
+**
+**	every picture used to be summed each time it was loaded into the cache, and
+**	ChecksumUsualSuspects() loaded a whole list of them at startup just to sum
+**	them. now a picture that has passed is noted here, keyed by a fingerprint of
+**	its PictDef and of where its records sit in the file, and the table is kept
+**	in CL_Prefs along with the images-file version it belongs to. a picture is
+**	summed again only if it was never verified, or if its PictDef or any of its
+**	records has been rewritten since; a new images file throws the whole table
+**	away.
+**
+**	after an update (or the first time through) the rest of the file is summed in
+**	the background: the records are located on the main thread, straight out of
+**	the file's read-only mapping, and batches of them are summed on worker threads.
+**	the results are harvested at idle time.
+*/
+
+#include "ClanLord.h"
+
+#include <dispatch/dispatch.h>
+
+
+/*
+**	Definitions
+*/
+const DTSKeyType	kTypeVerifiedImages		= 'VfIm';	// in CL_Prefs, ID 0
+const uint32_t		kVerifiedImagesFormat	= 2;		// 2: fingerprints cover record placement
+const int			kVerifiedImageIDs		= kPictFrameIDLimit + 1;
+const size_t		kVerifierBatch			= 64;		// pictures per worker task
+
+
+/*
+**	Internal Classes
+*/
+
+// the CL_Prefs record: this header, then vhCount entries; all big-endian
+struct VerifiedImagesHeader
+{
+	uint32_t		vhFormat;			// kVerifiedImagesFormat
+	int32_t			vhImagesVersion;	// gImagesVersion the entries belong to
+	uint32_t		vhComplete;			// has the background pass been all the way through?
+	uint32_t		vhCount;
+};
+
+struct VerifiedImageEntry
+{
+	int32_t			veID;
+	uint32_t		veFingerprint;
+};
+
+// one picture for the background pass. The pointers are into sVerifierMapping.
+struct VerifyJob
+{
+	DTSKeyID		vjID;
+	PictDef			vjPictDef;			// native endian
+	const void *	vjBits;
+	size_t			vjBitsLen;
+	const void *	vjColors;
+	size_t			vjColorsLen;
+	LightingData	vjLight;			// native endian
+	bool			vjHasLight;
+	uint32_t		vjCandidate;		// FingerprintPictDef(), worked out on the main thread
+	uint32_t		vjFingerprint;		// filled in by the worker; 0 if the sum was wrong
+};
+
+
+/*
+**	Internal Variables
+*/
+static uint32_t *		sFingerprints;		// [kVerifiedImageIDs]; 0 = not verified
+static int32_t			sVersion;			// the images version they are good for
+static bool				sComplete;			// every picture has been looked at
+static bool				sDirty;				// needs saving
+static bool				sGaveUp;			// the background pass can't run this session
+
+// the background pass
+static VerifyJob *		sJobs;
+static size_t			sNumJobs;
+static DTSFileMapping *	sVerifierMapping;
+static dispatch_group_t	sVerifierGroup;
+static volatile int32_t	sVerifierCancel;
+
+
+/*
+**	Internal Routines
+*/
+static bool		LoadVerifiedImages();
+static void		StartImageVerifier();
+static void		FinishImageVerifier( bool harvest );
+static void		RunImageVerifier( void * );
+static void		VerifyBatch( void *, size_t batch );
+static bool		MapVerifyJob( DTSKeyID id, VerifyJob * job );
+
+
+/*
+**	LoadVerifiedImages()
+**
+**	read the table from CL_Prefs the first time we need it, and start over
+**	whenever the images file is a different version than the table's
+**	returns false if there's no table to consult
+*/
+bool
+LoadVerifiedImages()
+{
+	if ( not sFingerprints )
+		{
+		sFingerprints = NEW_TAG("VerifiedImages") uint32_t[ kVerifiedImageIDs ];
+		if ( not sFingerprints )
+			return false;
+		memset( sFingerprints, 0, kVerifiedImageIDs * sizeof sFingerprints[0] );
+		sVersion = 0;
+		
+		void * record = nullptr;
+		size_t size = 0;
+		if ( noErr == gClientPrefsFile.GetSize( kTypeVerifiedImages, 0, &size )
+		&&   size >= sizeof( VerifiedImagesHeader )
+		&&   noErr == gClientPrefsFile.ReadAlloc( kTypeVerifiedImages, 0, record ) )
+			{
+			const VerifiedImagesHeader * header =
+				static_cast<const VerifiedImagesHeader *>( record );
+			uint32_t count = BigToNativeEndian( header->vhCount );
+			if ( kVerifiedImagesFormat == BigToNativeEndian( header->vhFormat )
+			&&   count <= ( size - sizeof *header ) / sizeof( VerifiedImageEntry ) )
+				{
+				sVersion  = BigToNativeEndian( header->vhImagesVersion );
+				sComplete = ( 0 != header->vhComplete );
+				
+				const VerifiedImageEntry * entry =
+					reinterpret_cast<const VerifiedImageEntry *>( header + 1 );
+				for ( uint32_t n = 0; n < count; ++n, ++entry )
+					{
+					int32_t id = BigToNativeEndian( entry->veID );
+					if ( id >= 0 && id < kVerifiedImageIDs )
+						sFingerprints[ id ] = BigToNativeEndian( entry->veFingerprint );
+					}
+				}
+			delete[] static_cast<char *>( record );
+			}
+		}
+	
+	// a new images file: nothing we knew about the old one counts
+	if ( sVersion != gImagesVersion )
+		{
+		memset( sFingerprints, 0, kVerifiedImageIDs * sizeof sFingerprints[0] );
+		sVersion  = gImagesVersion;
+		sComplete = false;
+		sDirty    = true;
+		}
+	
+	return true;
+}
+
+
+/*
+**	SaveVerifiedImages()
+**
+**	write the table back to CL_Prefs, if it has changed
+*/
+void
+SaveVerifiedImages()
+{
+	if ( not sFingerprints || not sDirty )
+		return;
+	
+	uint32_t count = 0;
+	for ( int id = 0; id < kVerifiedImageIDs; ++id )
+		if ( sFingerprints[ id ] )
+			++count;
+	
+	size_t size = sizeof( VerifiedImagesHeader ) + count * sizeof( VerifiedImageEntry );
+	char * record = NEW_TAG("VerifiedImagesRecord") char[ size ];
+	if ( not record )
+		return;
+	
+	VerifiedImagesHeader * header = reinterpret_cast<VerifiedImagesHeader *>( record );
+	header->vhFormat		= NativeToBigEndian( kVerifiedImagesFormat );
+	header->vhImagesVersion	= NativeToBigEndian( sVersion );
+	header->vhComplete		= NativeToBigEndian( uint32_t( sComplete ) );
+	header->vhCount			= NativeToBigEndian( count );
+	
+	VerifiedImageEntry * entry = reinterpret_cast<VerifiedImageEntry *>( header + 1 );
+	for ( int id = 0; id < kVerifiedImageIDs; ++id )
+		{
+		if ( sFingerprints[ id ] )
+			{
+			entry->veID			 = NativeToBigEndian( int32_t( id ) );
+			entry->veFingerprint = NativeToBigEndian( sFingerprints[ id ] );
+			++entry;
+			}
+		}
+	
+	if ( noErr == gClientPrefsFile.Write( kTypeVerifiedImages, 0, record, size ) )
+		sDirty = false;
+	
+	delete[] record;
+}
+
+
+/*
+**	FingerprintPictDef()
+**
+**	FNV-1a over the PictDef fields that decide what its checksum covers, and
+**	over the position and size in gClientImagesFile of the bits, colors and
+**	lighting records it names. Any legitimate change to the picture changes
+**	pdChecksum, and a PictDef pointing at different records changes the rest;
+**	a record that is rewritten without touching the PictDef (a damaged patch,
+**	say) almost always moves or changes size. Never returns 0.
+**	Main thread only: it consults the images file's entry table.
+*/
+uint32_t
+FingerprintPictDef( const PictDef * pd )
+{
+	uint32_t fields[ 8 + 3 * 2 ] =
+		{
+		pd->pdVersion,
+		uint32_t( pd->pdBitsID ),
+		uint32_t( pd->pdColorsID ),
+		pd->pdChecksum,
+		pd->pdFlags,
+		uint32_t( pd->pdLightingID ),
+		uint32_t( uint16_t( pd->pdPlane ) ),
+		uint32_t( uint16_t( pd->pdNumFrames ) ) << 16 | uint16_t( pd->pdNumAnims )
+		};
+	
+	const DTSKeyType types[] = { kTypePictureBits, kTypePictureColors, kTypeLightingData };
+	const DTSKeyID ids[] = { pd->pdBitsID, pd->pdColorsID, pd->pdLightingID };
+	uint32_t * place = &fields[ 8 ];
+	for ( int n = 0; n < 3; ++n, place += 2 )
+		{
+		size_t position, size;
+		if ( noErr == gClientImagesFile.GetPosition( types[ n ], ids[ n ], &position )
+		&&   noErr == gClientImagesFile.GetSize( types[ n ], ids[ n ], &size ) )
+			{
+			place[ 0 ] = uint32_t( position );
+			place[ 1 ] = uint32_t( size );
+			}
+		else
+			{
+			place[ 0 ] = place[ 1 ] = 0xFFFFFFFFU;	// missing, e.g. no lighting
+			}
+		}
+	
+	uint32_t hash = 2166136261U;
+	for ( size_t n = 0; n < sizeof fields / sizeof fields[0]; ++n )
+		{
+		for ( int shift = 0; shift < 32; shift += 8 )
+			{
+			hash ^= ( fields[ n ] >> shift ) & 0x0FF;
+			hash *= 16777619U;
+			}
+		}
+	
+	return hash ? hash : 1;
+}
+
+
+/*
+**	IsImageVerified()
+**
+**	has this picture, as described by this (native) PictDef, passed its checksum?
+*/
+bool
+IsImageVerified( DTSKeyID id, const PictDef * pd )
+{
+	if ( id < 0 || id >= kVerifiedImageIDs )
+		return false;
+	if ( not LoadVerifiedImages() )
+		return false;
+	
+	return sFingerprints[ id ] == FingerprintPictDef( pd );
+}
+
+
+/*
+**	MarkImageVerified()
+**
+**	note that this picture's checksum was good
+*/
+void
+MarkImageVerified( DTSKeyID id, const PictDef * pd )
+{
+	if ( id < 0 || id >= kVerifiedImageIDs )
+		return;
+	if ( not LoadVerifiedImages() )
+		return;
+	
+	uint32_t fingerprint = FingerprintPictDef( pd );
+	if ( sFingerprints[ id ] != fingerprint )
+		{
+		sFingerprints[ id ] = fingerprint;
+		sDirty = true;
+		}
+}
+
+
+/*
+**	InvalidateVerifiedImages()
+**
+**	the images file is about to be rewritten
+*/
+void
+InvalidateVerifiedImages()
+{
+	FinishImageVerifier( false );
+	
+	if ( sFingerprints )
+		memset( sFingerprints, 0, kVerifiedImageIDs * sizeof sFingerprints[0] );
+	sComplete = false;
+	sDirty    = true;
+	sGaveUp   = false;
+}
+
+
+/*
+**	StopImageVerifier()
+**
+**	call before the images file is closed; keeps whatever was already finished
+*/
+void
+StopImageVerifier()
+{
+	FinishImageVerifier( true );
+}
+
+
+/*
+**	IdleVerifiedImages()
+**
+**	start the background pass if the table isn't complete,
+**	and collect its results once it is done
+*/
+void
+IdleVerifiedImages()
+{
+	if ( sVerifierGroup )
+		{
+		if ( 0 == dispatch_group_wait( sVerifierGroup, DISPATCH_TIME_NOW ) )
+			{
+			FinishImageVerifier( true );
+			SaveVerifiedImages();
+			}
+		return;
+		}
+	
+	if ( sGaveUp
+	||   0 == gImagesVersion
+	||   not LoadVerifiedImages()
+	||   sComplete )
+		{
+		return;
+		}
+	
+	StartImageVerifier();
+}
+
+
+/*
+**	StartImageVerifier()
+**
+**	find every picture that still needs summing, and hand them to the workers
+*/
+void
+StartImageVerifier()
+{
+	long count = 0;
+	if ( noErr != gClientImagesFile.Count( kTypePictureDefinition, &count ) )
+		{
+		sGaveUp = true;
+		return;
+		}
+	
+	if ( count > 0 )
+		{
+		sJobs = NEW_TAG("VerifyJobs") VerifyJob[ count ];
+		if ( not sJobs )
+			{
+			sGaveUp = true;
+			return;
+			}
+		}
+	
+	sNumJobs = 0;
+	for ( long index = 0; index < count; ++index )
+		{
+		DTSKeyID id;
+		if ( noErr == gClientImagesFile.GetID( kTypePictureDefinition, index, &id )
+		&&   id >= 0 && id < kVerifiedImageIDs
+		&&   MapVerifyJob( id, &sJobs[ sNumJobs ] ) )
+			{
+			++sNumJobs;
+			}
+		if ( sGaveUp )
+			break;
+		}
+	
+	if ( sGaveUp || 0 == sNumJobs )
+		{
+			// if there was nothing left to do, we're done for this version
+		if ( not sGaveUp )
+			{
+			sComplete = true;
+			sDirty = true;
+			}
+		delete[] sJobs;
+		sJobs = nullptr;
+		sNumJobs = 0;
+		if ( sVerifierMapping )
+			DTS_releasemap( sVerifierMapping );
+		sVerifierMapping = nullptr;
+		return;
+		}
+	
+	sVerifierCancel = 0;
+	sVerifierGroup = dispatch_group_create();
+	dispatch_group_async_f( sVerifierGroup,
+		dispatch_get_global_queue( DISPATCH_QUEUE_PRIORITY_BACKGROUND, 0 ),
+		nullptr, RunImageVerifier );
+}
+
+
+/*
+**	MapVerifyJob()
+**
+**	locate one picture's records in the images file's mapping
+**	returns false if it is already verified, isn't summed at all, or looks damaged;
+**	damaged ones are left for LoadImage() to complain about
+*/
+bool
+MapVerifyJob( DTSKeyID id, VerifyJob * job )
+{
+	const void * data;
+	size_t size;
+	DTSFileMapping * mapping;
+	
+	// the PictDef
+	if ( noErr != gClientImagesFile.MapRecord( kTypePictureDefinition, id,
+						&data, &size, &mapping ) )
+		{
+			// the file isn't mappable (or is open for writing); try again next session
+		sGaveUp = true;
+		return false;
+		}
+	if ( not sVerifierMapping )
+		sVerifierMapping = mapping;		// keep this reference until the workers are done
+	else
+		DTS_releasemap( mapping );		// it's the same mapping every time
+	
+	PictDef * pd = &job->vjPictDef;
+	memset( pd, 0, sizeof *pd );
+	memcpy( pd, data, size < sizeof *pd ? size : sizeof *pd );
+	
+	int nAnims = BigToNativeEndian( pd->pdNumAnims );
+	if ( nAnims < 0
+	||   nAnims > kPictDefAnimTableSize
+	||   size < offsetof( PictDef, pdAnimFrameTable ) + nAnims * sizeof pd->pdAnimFrameTable[0] )
+		{
+		return false;
+		}
+	BigToNativeEndian( pd );
+	
+	if ( pd->pdFlags & kPictDefFlagNoChecksum )
+		return false;
+	job->vjCandidate = FingerprintPictDef( pd );
+	if ( sFingerprints[ id ] == job->vjCandidate )
+		return false;
+	
+	// the bits
+	if ( noErr != gClientImagesFile.MapRecord( kTypePictureBits, pd->pdBitsID,
+						&job->vjBits, &job->vjBitsLen, &mapping ) )
+		{
+		return false;
+		}
+	DTS_releasemap( mapping );
+	
+	// the colors; LoadImage() reads at most 256 of them
+	if ( noErr != gClientImagesFile.MapRecord( kTypePictureColors, pd->pdColorsID,
+						&job->vjColors, &job->vjColorsLen, &mapping ) )
+		{
+		return false;
+		}
+	DTS_releasemap( mapping );
+	if ( job->vjColorsLen > 256 )
+		return false;
+	
+	// the lighting, if any
+	job->vjHasLight = false;
+	memset( &job->vjLight, 0, sizeof job->vjLight );
+	if ( pd->pdLightingID )
+		{
+		if ( noErr != gClientImagesFile.MapRecord( kTypeLightingData, pd->pdLightingID,
+							&data, &size, &mapping ) )
+			{
+			return false;
+			}
+		DTS_releasemap( mapping );
+		memcpy( &job->vjLight, data, size < sizeof job->vjLight ? size : sizeof job->vjLight );
+		BigToNativeEndian( &job->vjLight );
+		job->vjHasLight = true;
+		}
+	
+	job->vjID = id;
+	job->vjFingerprint = 0;
+	
+	return true;
+}
+
+
+/*
+**	RunImageVerifier()
+**
+**	background queue: sum all the jobs, a batch per worker task
+*/
+void
+RunImageVerifier( void * )
+{
+	CFAbsoluteTime started = CFAbsoluteTimeGetCurrent();
+	size_t batches = ( sNumJobs + kVerifierBatch - 1 ) / kVerifierBatch;
+	dispatch_apply_f( batches,
+		dispatch_get_global_queue( DISPATCH_QUEUE_PRIORITY_BACKGROUND, 0 ),
+		nullptr, VerifyBatch );
+	if ( not sVerifierCancel )
+		TraceStartupTask( "verifying images", started );
+}
+
+
+/*
+**	VerifyBatch()
+**
+**	dispatch_apply_f() callback. Each batch owns its own jobs, and reads nothing
+**	but the mapping, so no locking is needed.
+*/
+void
+VerifyBatch( void *, size_t batch )
+{
+	size_t first = batch * kVerifierBatch;
+	size_t last = first + kVerifierBatch;
+	if ( last > sNumJobs )
+		last = sNumJobs;
+	
+	for ( size_t n = first; n < last; ++n )
+		{
+		if ( sVerifierCancel )
+			return;
+		
+		VerifyJob * job = &sJobs[ n ];
+		uint32_t sum = CLImage::ChecksumRecords( job->vjID, job->vjPictDef,
+							job->vjBits, job->vjBitsLen,
+							job->vjColors, job->vjColorsLen,
+							job->vjHasLight ? &job->vjLight : nullptr );
+		if ( sum == job->vjPictDef.pdChecksum )
+			job->vjFingerprint = job->vjCandidate;
+		}
+}
+
+
+/*
+**	FinishImageVerifier()
+**
+**	wait for the workers (cancelling them if they're still going), take their
+**	results if asked, and let go of everything
+*/
+void
+FinishImageVerifier( bool harvest )
+{
+	if ( not sVerifierGroup )
+		return;
+	
+	bool finished = ( 0 == dispatch_group_wait( sVerifierGroup, DISPATCH_TIME_NOW ) );
+	if ( not finished )
+		{
+		__sync_lock_test_and_set( &sVerifierCancel, 1 );
+		dispatch_group_wait( sVerifierGroup, DISPATCH_TIME_FOREVER );
+		}
+	dispatch_release( sVerifierGroup );
+	sVerifierGroup = nullptr;
+	
+		// a cancelled batch just leaves its unsummed jobs at 0
+	if ( harvest && sFingerprints )
+		{
+		for ( size_t n = 0; n < sNumJobs; ++n )
+			{
+			const VerifyJob& job = sJobs[ n ];
+			if ( job.vjFingerprint )
+				{
+				sFingerprints[ job.vjID ] = job.vjFingerprint;
+				sDirty = true;
+				}
+			}
+		if ( finished )
+			{
+			sComplete = true;
+			sDirty = true;
+			}
+		}
+	
+	delete[] sJobs;
+	sJobs = nullptr;
+	sNumJobs = 0;
+	DTS_releasemap( sVerifierMapping );
+	sVerifierMapping = nullptr;
+}
+
@@ -38,6 +38,7 @@
 #include "LinkedList_dts.h"
 #include "Memory_dts.h"
 #include "Menu_dts.h"
+#include "Mixer_dts.h"
 //#include "Music_dts.h"
 #include "New_dts.h"
 #include "Network_dts.h"
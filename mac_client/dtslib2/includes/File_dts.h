@@ -58,7 +58,8 @@ enum
 	kCouldNotWrite			= -31990,
 	kCouldNotSeek			= -31989,
 	kCouldNotGetPos			= -31988,
-	kCouldNotTruncate		= -31987
+	kCouldNotTruncate		= -31987,
+	kKeyFileCompressing		= -31986
 };
 
 
@@ -153,4 +154,22 @@ DTSError	DTS_geteof( int fileref, ulong * eof );
 DTSError	DTS_read( int fileref, void * buffer, size_t size );
 DTSError	DTS_write( int fileref, const void * buffer, size_t size );
 
+
+/*
+**	read-only memory mappings
+**	DTS_map() maps an entire file; the mapping starts with one reference.
+**	The mapped bytes stay valid until the last DTS_releasemap(), as long as
+**	nobody shrinks the file meanwhile; reading past its new end faults.
+*/
+struct DTSFileMapping
+{
+	const uchar *	mapData;		// first byte of the file
+	size_t			mapSize;		// length of the file
+	int32_t			mapRefCount;	// owners; unmapped when this goes to zero
+};
+
+DTSError	DTS_map( DTSFileSpec * spec, DTSFileMapping ** oMapping );
+void		DTS_retainmap( DTSFileMapping * mapping );
+void		DTS_releasemap( DTSFileMapping * mapping );
+
 #endif	// File_dts_h
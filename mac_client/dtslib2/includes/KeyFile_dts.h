@@ -37,6 +37,27 @@
 **	Delete removes the record with the type and id.
 **	Compress compresses the file so there is no wasted space, also the records
 **		are stored in the file in the same order as they were added.
+**	CompressSome does the same job a few records at a time, so it can be spread
+**		over idle time; it sets oDone when the file is finished. Until then, Write
+**		and Delete fail with kKeyFileCompressing (reading is fine), and Close
+**		finishes the job first.
+**	MapRecord returns a pointer straight into a read-only mapping of the file,
+**		plus a reference to that mapping which the caller must DTS_releasemap().
+**		Only read-only files can be mapped.
+**	GetPosition returns where a record's data starts in the file. A record that
+**		is rewritten, or moved by Compress, generally ends up somewhere else.
+**	WriteBatch writes a number of records in one go: it finds a place for all of
+**		them first, then writes their data in file order, coalescing neighbors,
+**		and writes the entry table once at the end (or not at all, in
+**		kWriteModeFaster). A batch may name each type and ID only once. If it
+**		fails, the table in RAM is put back as it was and isn't written.
+**	Revert closes the file without writing the header and table that
+**		kWriteModeFaster has been holding back, and opens it again; the file's
+**		own table is as it was before the held-back writes.
+**	Repack is Compress, except that the named records come first, in the order
+**		given, and the rest follow in table order. Use it to store records that
+**		are read together next to one another. Names that aren't in the file, or
+**		that appear twice, are ignored.
 */
 typedef int32_t DTSKeyType;
 typedef int32_t DTSKeyID;
@@ -49,6 +70,22 @@ struct DTSKeyInfo
 	long	keyCompressedSize;
 };
 
+	// one record for WriteBatch(); the data must stay put until it returns
+struct DTSKeyRecord
+{
+	DTSKeyType		recType;
+	DTSKeyID		recID;
+	const void *	recData;
+	size_t			recSize;
+};
+
+	// one record for Repack()
+struct DTSKeyRef
+{
+	DTSKeyType		refType;
+	DTSKeyID		refID;
+};
+
 class DTSKeyFilePriv;
 
 class DTSKeyFile
@@ -61,16 +98,24 @@ public:
 	DTSError	Open( DTSFileSpec * spec, uint flags, int fTypeID = 0, uint inNumEntries = 0 );
 	
 	void		Close();
+	DTSError	Revert();
 	
 					// returns noErr if the specified entry exists, else -1
 	DTSError	Exists( DTSKeyType type, DTSKeyID id ) const;
 	
 	DTSError	ReadAlloc( DTSKeyType type, DTSKeyID id, void *& oBuffer );
 	DTSError	GetSize( DTSKeyType type, DTSKeyID id, size_t * oSize ) const;
+	DTSError	GetPosition( DTSKeyType type, DTSKeyID id, size_t * oPosition ) const;
 	DTSError	Read( DTSKeyType type, DTSKeyID id, void * buffer, size_t bufsize = ULONG_MAX );
+	DTSError	MapRecord( DTSKeyType type, DTSKeyID id, const void ** oData, size_t * oSize,
+					DTSFileMapping ** oMapping );
 	DTSError	Write( DTSKeyType type, DTSKeyID id, const void * buffer, size_t size );
+	DTSError	WriteBatch( const DTSKeyRecord * records, long count );
 	DTSError	Delete( DTSKeyType type, DTSKeyID id );
 	DTSError	Compress();
+	DTSError	CompressSome( long maxRecords, bool * oDone );
+	DTSError	Repack( const DTSKeyRef * order, long count );
+	bool		IsCompressing() const;
 	DTSError	Count( DTSKeyType type, long * oCount ) const;
 	DTSError	GetID( DTSKeyType type, long index, DTSKeyID * oID ) const;
 	DTSError	GetIndex( DTSKeyType type, DTSKeyID id, long * oIndex ) const;
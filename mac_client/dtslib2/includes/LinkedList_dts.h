@@ -138,4 +138,185 @@ public:
 };
 
 
+/*
+**	A doubly-linked list, for long lists that get appended to, or shuffled, a lot.
+**
+**	It keeps the same shape as DTSLinkedList -- a bare T * root, nullptr-terminated
+**	linkNext chains -- so existing loops over linkNext still work. The difference
+**	is a linkPrev back-pointer on every element; the head's linkPrev points at the
+**	tail, which makes InstallLast(), Remove() and GoToBack() constant-time.
+**	An element that isn't in any list has a null linkPrev.
+**
+**	Because the head knows where the tail is, the links must only be rearranged
+**	via these routines; never write linkNext directly, or chop a list short.
+*/
+class _DTSDLinkedList;
+void	DTSDLinkedList_MoveForward( _DTSDLinkedList * elem, _DTSDLinkedList *& root );
+void	DTSDLinkedList_MoveBack( _DTSDLinkedList * elem, _DTSDLinkedList *& root );
+uint	DTSDLinkedList_Count( const _DTSDLinkedList * elem );
+void	DTSDLinkedList_AppendList( _DTSDLinkedList * elem, _DTSDLinkedList *& root );
+void	DTSDLinkedList_DeleteLinkedList( _DTSDLinkedList *& root );
+void	DTSDLinkedList_ReverseLinkedList( _DTSDLinkedList *& root );
+
+template< class T >
+class DTSDLinkedList
+{
+private:
+	// no copying
+	DTSDLinkedList&		operator=( const DTSDLinkedList& );
+						DTSDLinkedList( const DTSDLinkedList& );
+
+public:
+	T *		linkNext;
+	T *		linkPrev;
+	
+	// constructor/destructor
+					DTSDLinkedList() : linkNext( nullptr ), linkPrev( nullptr ) {}
+	virtual			~DTSDLinkedList() {}
+	
+	// interface routines
+	// is this element in a list?
+	bool	IsLinked() const
+				{
+				return linkPrev != nullptr;
+				}
+	
+	// the last element of a list
+	static T *	Last( T * root )
+				{
+				return root ? root->linkPrev : nullptr;
+				}
+	
+	// install at the front of the linked list
+	void	InstallFirst( T *& root )
+				{
+				if ( root )
+					{
+					linkPrev = root->linkPrev;
+					root->linkPrev = (T *) this;
+					}
+				else
+					linkPrev = (T *) this;
+				linkNext = root;
+				root = (T *) this;
+				}
+	
+	// install in the linked list after the one specified
+	void	InstallBehind( T *& root, T * behind )
+				{
+				linkNext = behind->linkNext;
+				linkPrev = behind;
+				behind->linkNext = (T *) this;
+				if ( linkNext )
+					linkNext->linkPrev = (T *) this;
+				else
+					root->linkPrev = (T *) this;
+				}
+	
+	// install at the end of the linked list
+	void	InstallLast( T *& root )
+				{
+				linkNext = nullptr;
+				if ( T * head = root )
+					{
+					linkPrev = head->linkPrev;
+					linkPrev->linkNext = (T *) this;
+					head->linkPrev = (T *) this;
+					}
+				else
+					{
+					linkPrev = (T *) this;
+					root = (T *) this;
+					}
+				}
+	
+	// remove from the list
+	void	Remove( T *& root )
+				{
+				// ignore elements that aren't in a list
+				if ( not linkPrev )
+					return;
+				
+				if ( root == (T *) this )
+					{
+					root = linkNext;
+					if ( linkNext )
+						linkNext->linkPrev = linkPrev;
+					}
+				else
+					{
+					linkPrev->linkNext = linkNext;
+					if ( linkNext )
+						linkNext->linkPrev = linkPrev;
+					else
+						root->linkPrev = linkPrev;
+					}
+				
+				// just to be safe
+				linkNext = nullptr;
+				linkPrev = nullptr;
+				}
+	
+	// move an element to the front of the list
+	void	GoToFront( T *& root )
+				{
+				Remove( root );
+				InstallFirst( root );
+				}
+	
+	// move an element to the end of the list
+	void	GoToBack( T *& root )
+				{
+				// already there?
+				if ( not linkNext && linkPrev )
+					return;
+				Remove( root );
+				InstallLast( root );
+				}
+	
+	// move an element behind another
+	void	GoBehind( T *& root, T * behind )
+				{
+				Remove( root );
+				InstallBehind( root, behind );
+				}
+	
+	// move forward one element
+	void	MoveForward( T *& root )
+				{
+				DTSDLinkedList_MoveForward( (_DTSDLinkedList *) this, (_DTSDLinkedList *&) root );
+				}
+	
+	// move back    one element 
+	void	MoveBack( T *& root )
+				{
+				DTSDLinkedList_MoveBack( (_DTSDLinkedList *) this, (_DTSDLinkedList *&) root );
+				}
+	
+	// number of elements in the list
+	uint	Count() const
+				{
+				return DTSDLinkedList_Count( (const _DTSDLinkedList *) this );
+				}
+	
+	// append this list to another
+	void	AppendList( T *& root )
+				{
+				DTSDLinkedList_AppendList( (_DTSDLinkedList *) this, (_DTSDLinkedList *&) root );
+				}
+	
+	// delete an entire linked list
+	static void DeleteLinkedList( T *& root )
+				{
+				DTSDLinkedList_DeleteLinkedList( (_DTSDLinkedList *&) root );
+				}
+	
+	// reverse the order of a linked list
+	static void ReverseLinkedList( T *& root )
+				{
+				DTSDLinkedList_ReverseLinkedList( (_DTSDLinkedList *&) root );
+				}
+};
+
+
 #endif  // LinkedList_dts_h
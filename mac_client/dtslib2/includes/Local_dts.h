@@ -197,5 +197,6 @@ class DTSDlgList;
 class DTSTextField;
 class DTSSound;
 class DTSFileSpec;
+struct DTSFileMapping;
 
 #endif // Local_dts_h
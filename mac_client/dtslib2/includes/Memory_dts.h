@@ -37,6 +37,28 @@
 #endif
 
 
+// DTS_ALLOC_PROFILE keeps per-tag heap statistics in every build, by routing all
+// operator new()s through New_dts.cp and a thin malloc()-backed allocator
+// (see AllocProfile_dts.cp). That's a header and a few atomic adds on every
+// allocation; AllocProfileEnable( false ) leaves just the header and a flag test.
+// The block-checking debug allocator has its own, far more expensive, accounting
+// via DumpBlocksSummary(), so the two are exclusive.
+#ifndef DTS_ALLOC_PROFILE
+# if defined( DEBUG_VERSION_NEW ) && DEBUG_VERSION_NEW
+#  define DTS_ALLOC_PROFILE		0
+# else
+#  define DTS_ALLOC_PROFILE		1
+# endif
+#endif
+
+// does NEW_TAG() pass its tag string through to the allocator?
+#if defined( DEBUG_VERSION_TAGS ) || DTS_ALLOC_PROFILE
+# define DTS_NEW_TAGGED			1
+#else
+# define DTS_NEW_TAGGED			0
+#endif
+
+
 /*
 **	leak tracking routines
 */
@@ -46,4 +68,46 @@ void	DumpBlocksSummary( const char * filename );
 #endif
 
 
+/*
+**	allocation profiler
+**
+**	Every block allocated via NEW_TAG() is charged to its tag; everything else
+**	(plain new, STL, the C++ runtime) lands in "<untagged>".
+**	Counters are updated atomically, so other threads may allocate while a snapshot
+**	is being taken; the numbers are then merely approximate, never corrupt.
+*/
+#if DTS_ALLOC_PROFILE
+struct AllocProfileEntry
+{
+	const char *	apeTag;				// tag string (shared by all blocks with that tag)
+	size_t			apeLiveBytes;		// bytes currently allocated
+	size_t			apeLiveBlocks;		// blocks currently allocated
+	size_t			apePeakBytes;		// high-water mark of apeLiveBytes
+	uint64_t		apeTotalAllocs;		// allocations since launch
+	uint64_t		apeTotalBytes;		// bytes allocated since launch
+	uint64_t		apeIntervalAllocs;	// allocations since the previous marked snapshot
+	uint64_t		apeIntervalBytes;	// ditto, bytes
+};
+
+	// fill in up to maxEntries records, busiest (by live bytes) first.
+	// Returns the number of entries stored.
+	// If bMark is set, this snapshot starts a new interval for apeIntervalXXX,
+	// and *oIntervalTicks (if given) receives the length of the interval just ended,
+	// in 60ths of a second.
+int			AllocProfileSnapshot( AllocProfileEntry * oEntries, int maxEntries,
+					bool bMark = false, ulong * oIntervalTicks = nullptr );
+	
+	// forget the high-water marks
+void		AllocProfileResetPeaks();
+
+	// append a marked, timestamped snapshot of every tag to an open text stream
+void		AllocProfileWrite( std::FILE * stream );
+
+	// counting is on at launch. While it's off, new blocks aren't charged to
+	// anyone, so the live figures drift low as older blocks are freed.
+void		AllocProfileEnable( bool bEnable );
+bool		AllocProfileIsEnabled();
+#endif  // DTS_ALLOC_PROFILE
+
+
 #endif	// Memory_dts_h
@@ -0,0 +1,124 @@
+/*
+**	Mixer_dts.h		dtslib2
+** 
+**	Copyright 2023 Delta Tao Software, Inc.
+** 
+**	Licensed under the Apache License, Version 2.0 (the "License");
+**	you may not use this file except in compliance with the License.
+**	You may obtain a copy of the License at
+** 
+**     https://www.apache.org/licenses/LICENSE-2.0
+** 
+**	Unless required by applicable law or agreed to in writing, software
+**	distributed under the License is distributed on an "AS IS" BASIS,
+**	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+**	See the License for the specific language governing permissions and
+**	imitations under the License.
+*/
+
+#ifndef Mixer_dts_h
+#define Mixer_dts_h
+
+#ifndef _dtslib2_
+#include "Prefix_dts.h"
+#endif
+
+#include "Local_dts.h"
+#include "Platform_dts.h"
+
+
+/*
+**	Define the DTSMixer class
+**
+**	A portable software mixer: a fixed pool of voices, each playing one sound at its
+**	own volume and pan, resampled to a common output rate and summed into 16-bit
+**	interleaved stereo.  Nothing here depends on any platform's sound API; the platform
+**	backend merely calls Render() whenever its output device wants more samples.
+**	Render() may run on a different thread than the other calls.
+**
+**	Play() returns a voice ID that won't be reused for millions of sounds, or
+**	kMixNoVoice if every voice is busy with something more important.  When no voice
+**	is free, the one with the lowest priority (oldest first, among equals) is stolen,
+**	provided its priority is no higher than the new sound's.
+**
+**	The sample data must stay valid until the mixer calls the sound's msRelease proc,
+**	which happens exactly once per successful Play(): when the sound ends, or is
+**	stopped or stolen.  That proc may be called from within Render(), so it must not
+**	call back into the mixer.
+**
+**	RenderOffline() mixes the next N seconds into a newly-allocated buffer, which the
+**	caller must delete[]; it's meant for tests and tools, not for live output.
+*/
+enum DTSMixSampleFormat
+{
+	kMixFormat8BitOffset,			// unsigned 8-bit, 0x80 is silence ('raw ')
+	kMixFormat16BitBigEndian		// signed 16-bit, big-endian ('twos')
+};
+
+typedef void (*DTSMixReleaseProc)( void * refCon );
+
+struct DTSMixSound
+{
+	const uchar *		msSamples;		// first frame
+	size_t				msFrames;		// # of frames
+	uint32_t			msRate;			// frames per second
+	int					msChannels;		// 1 or 2
+	DTSMixSampleFormat	msFormat;
+	DTSMixReleaseProc	msRelease;		// may be nullptr
+	void *				msRefCon;		// passed to msRelease
+};
+
+typedef int32_t DTSMixVoiceID;
+const DTSMixVoiceID		kMixNoVoice		= 0;
+const int				kMixMaxVoices	= 255;
+
+class DTSMixerPriv;
+class DTSMixer
+{
+public:
+	DTSImplementNoCopy<DTSMixerPriv> priv;
+	
+	// interface
+	DTSError		Init( int numVoices, uint32_t outputRate );
+	
+	DTSMixVoiceID	Play( const DTSMixSound& sound, float volume = 1.0F,
+						float pan = 0.0F, int priority = 0 );
+	void			Stop( DTSMixVoiceID voice );
+	void			StopAll();
+	bool			IsPlaying( DTSMixVoiceID voice ) const;
+	int				CountPlaying() const;
+	
+	void			SetVolume( float volume );			// master volume, 0 .. 1
+	uint32_t		GetOutputRate() const;
+	ulong			GetStolenCount() const;				// # of voices stolen so far
+	
+					// interleaved, native-endian stereo
+	void			Render( int16_t * out, size_t frames );
+	DTSError		RenderOffline( double seconds, int16_t *& oBuffer, size_t * oFrames );
+};
+
+
+/*
+**	DTSMixerBenchmark()
+**
+**	Mix a synthetic worst-case combat scene -- a burst of new sounds every few
+**	milliseconds, in every supported format and rate, so the pool is always full
+**	and voices are constantly stolen -- in buffer-sized slices, as a backend would.
+**	Reports how much faster than real time that was; then mixes a smaller scene, with
+**	no stealing, both through the mixer and in plain floating point, and counts the
+**	output samples on which they disagree.
+*/
+struct DTSMixBenchmarkResult
+{
+	int			mbVoices;			// size of the voice pool
+	double		mbAudioSeconds;		// length of the mix
+	double		mbCPUSeconds;		// processor time spent mixing it
+	double		mbRealtimeFactor;	// mbAudioSeconds / mbCPUSeconds
+	ulong		mbPlayCalls;		// sounds started
+	ulong		mbSteals;			// voices stolen for them
+	int			mbMismatches;		// samples off from the reference mix; had better be 0
+};
+
+DTSError	DTSMixerBenchmark( int numVoices, double seconds, DTSMixBenchmarkResult * oResult );
+
+#endif	// Mixer_dts_h
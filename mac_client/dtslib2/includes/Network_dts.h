@@ -66,6 +66,23 @@ public:
 };
 
 
+/*
+**	struct DTSNetReceiveStats
+**	what the receive thread has been up to (see DTSNetChannel::StartReceiveThread())
+*/
+struct DTSNetReceiveStats
+{
+	ulong			rsMessages;			// handed to Read()
+	ulong			rsBytes;			// likewise
+	ulong			rsWakeups;			// times the thread found something to read
+	ulong			rsLargestBatch;		// most messages gathered in one wakeup
+	ulong			rsStalls;			// times the queue was full, leaving data in the socket
+	double			rsLastDelay;		// seconds the last message sat between arrival and Read()
+	double			rsMeanDelay;		// moving average of the same
+	double			rsMaxDelay;
+};
+
+
 /*
 **	class DTSNetChannel
 */
@@ -98,6 +115,13 @@ public:
 	// reliable=tcp unreliable=udp
 	DTSError			Write( const void * data, size_t size, int type );
 	
+	// client: read on a thread of our own, so nothing waits in the socket buffers
+	// for the next Read(). Messages are stamped on arrival and queued, at most
+	// maxMsgSize bytes apiece; Read() takes them from the queue from then on.
+	DTSError			StartReceiveThread( size_t maxMsgSize );
+	void				StopReceiveThread();
+	void				GetReceiveStats( DTSNetReceiveStats * oStats ) const;
+	
 	// return non-zero if connected
 	bool				IsConnected() const;
 	
@@ -77,7 +77,7 @@ either cover -all- the bases, or none. Trying to mix & match will always eventua
 crash somewhere. ISO says that the "default behavior" for #4 is to call #1, and for
 #6 to call #2, but I'm not sure we can rely on that.
 
-    When we have DEBUG_VERSION_TAGS on, we also provide these new functions:
+    When we have DEBUG_VERSION_TAGS or DTS_ALLOC_PROFILE on, we also provide these new functions:
     - operator new(size_t, const NewTag *) throw()
     - operator new[](size_t, const NewTag *) throw()
 
@@ -114,16 +114,17 @@ With tagging turned ON, we need to have:
 
 
 // Now define the NEW_TAG macro appropriately:
-//		when DEBUG_VERSION_TAGS is off, NEW_TAG just means new(nothrow)
-//		otherwise it invokes our debugging flavor, new( void *, const NewTag * )
+//		when neither DEBUG_VERSION_TAGS nor DTS_ALLOC_PROFILE is on,
+//		NEW_TAG just means new(nothrow);
+//		otherwise it invokes our tagging flavor, new( void *, const NewTag * )
 
 
-#ifndef DEBUG_VERSION_TAGS
+#if ! DTS_NEW_TAGGED
 
 // standard old-fashioned non-throwing new
 # define NEW_TAG(s) new( std::nothrow )
 
-#else  // DEBUG_VERSION_TAGS
+#else  // DTS_NEW_TAGGED
 
 class NewTag;
 
@@ -134,6 +135,6 @@ class NewTag;
 void *	operator new(   size_t size, const NewTag * tagString ) DOES_NOT_THROW;
 void *	operator new[]( size_t size, const NewTag * tagString ) DOES_NOT_THROW;
 
-#endif  // DEBUG_VERSION_TAGS
+#endif  // DTS_NEW_TAGGED
 
 #endif	// New_dts_h
@@ -67,6 +67,8 @@ A special sequence, like \< or \> can be made into a literal character by droppi
 #undef DEBUG_REGEXP
 // #define DEBUG_REGEXP 1
 
+class CHSRegExpDFA;
+
 
 
 class CHSRegExp
@@ -86,6 +88,10 @@ public:
 	bool	 	regexec( const char * theData );
 	void		setErrorProc( tRegErrorProc theErrorProc ) { mRegErrorProc = theErrorProc; }
 	
+	// patterns without \< or \> are first run through a DFA, which never backtracks;
+	// this turns that off, leaving just the original matcher (e.g. for benchmarks)
+	void		setUseDFA( bool bUse ) { mUseDFA = bUse; }
+
 private:
 	static const uchar MAGIC	= 0234;
 	
@@ -106,6 +112,7 @@ private:
 	bool		regtry( const char * string );
 	bool		regmatch( char * prog );
 	int			regrepeat( const char * p );
+	int			dfaexec( const char * theData, size_t len );
 	void		regError( const char * errorString ) const DOES_NOT_RETURN;
 	
 	tRegErrorProc	mRegErrorProc;
@@ -113,8 +120,15 @@ private:
 	char			mRegstart;		/* Internal use only. */
 	bool			mReganch;		/* Internal use only. */
 	const char *	mRegmust;		/* Internal use only. */
+	size_t			mRegmustlen;	/* Internal use only. */
+	const char *	mRegprefix;		/* Internal use only. */
+	size_t			mRegprefixlen;	/* Internal use only. */
 	char *			mProgram;
 	
+	CHSRegExpDFA *	mScanDFA;		// is there a match anywhere? (unanchored r.e.s only)
+	CHSRegExpDFA *	mAnchorDFA;		// is there a match starting right here?
+	bool			mUseDFA;
+	
 	/*
 	 * Global work variables for regcomp()
 	 */
@@ -23,12 +23,16 @@
 #include "Prefix_dts.h"
 #endif
 
+#include "KeyFile_dts.h"
 #include "Local_dts.h"
 #include "Platform_dts.h"
 
 
 /*
 **	Define DTSSound class
+**
+**	The DTSKeyFile flavors of Init() and Play() stream the samples straight out of
+**	the (read-only) file, rather than keeping a copy of the sound in memory.
 */
 class DTSSoundPriv;
 class DTSSound
@@ -38,7 +42,9 @@ public:
 	
 	// interface
 	DTSError	Init( const void * ptr, size_t len );
+	DTSError	Init( DTSKeyFile * file, DTSKeyType type, DTSKeyID id );
 	void		Play();
+	DTSError	Play( DTSKeyFile * file, DTSKeyType type, DTSKeyID id );
 	void		Stop();
 	bool		IsDone() const;
 };
@@ -49,6 +55,7 @@ public:
 */
 void	DTSInitSound( int numChannels );		// initialize the sound player
 void	DTSExitSound();							// de-initialize the sound player
+void	DTSStopAllSounds();						// silence everything; let go of mapped files
 void	DTSSetSoundVolume( ushort volume );		// set baseline volume for sounds
 // Sound volumes range from 0 = silent to 0xFFFF = hardware maximum
 
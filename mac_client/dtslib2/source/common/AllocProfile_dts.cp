@@ -0,0 +1,449 @@
+/*
+**	AllocProfile_dts.cp		dtslib2
+** 
+**	Copyright 2023 Delta Tao Software, Inc.
+** 
+**	Licensed under the Apache License, Version 2.0 (the "License");
+**	you may not use this file except in compliance with the License.
+**	You may obtain a copy of the License at
+** 
+**		https://www.apache.org/licenses/LICENSE-2.0
+** 
+**	Unless required by applicable law or agreed to in writing, software
+**	distributed under the License is distributed on an "AS IS" BASIS,
+**	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+**	See the License for the specific language governing permissions and
+**	imitations under the License.
+*/
+
+#ifndef _dtslib2_
+# include "Prefix_dts.h"
+#endif
+
+#include "Memory_dts.h"
+
+#if DTS_ALLOC_PROFILE
+
+#include "Memory_cmn.h"
+
+
+/*
+**	Entry Routines
+**
+**	NewAlloc();
+**	NewFree();
+**	AllocProfileSnapshot();
+**	AllocProfileResetPeaks();
+**	AllocProfileWrite();
+**	AllocProfileEnable();
+**	AllocProfileIsEnabled();
+*/
+
+/*
+**	As in Memory_dts.cp, these are deliberately not declared in any header;
+**	only New_dts.cp should be calling them.
+*/
+void *	NewAlloc( size_t size, const char * tagString ) DOES_NOT_THROW;
+void	NewFree( void * ptr ) DOES_NOT_THROW;
+
+
+/*
+**	This is the production-build stand-in for the debugging allocator in Memory_dts.cp.
+**	Blocks come straight from malloc(), with one small header in front:
+**
+**		+-----------------+
+**		| size            |		size requested by caller
+**		| slot            |		index into gAPSlots[] of the block's tag
+**		| 0xA110CA7E      |		so NewFree() can sniff out wild or double deletes
+**		+-----------------+
+**		| caller data     |		pointer returned to the caller
+**		|                 |
+**		+-----------------+
+**
+**	The header is 16 bytes on both 32- and 64-bit, which preserves malloc()'s alignment.
+**	Each tag owns a slot of counters. Tags are (nearly always) string literals, so
+**	the slot is found by hashing the tag pointer, not its text; the same text appearing
+**	in two different source files may well get two slots, which are merged again
+**	whenever a snapshot is taken.
+**
+**	While counting is switched off, blocks still get their header -- NewFree() has to
+**	be able to tell what it's looking at -- but are marked kAPUncountedSlot and leave
+**	the counters alone, coming and going.
+*/
+
+
+/*
+**	Definitions
+*/
+struct APHeader
+{
+	size_t			aphSize;			// the unmodified size of the block
+	uint32_t		aphSlot;			// which tag it's charged to
+	uint32_t		aphMarker;			// kAPMarker while the block is live
+#if ! __LP64__
+	uint32_t		aphPad;				// keep caller data 16-byte aligned
+#endif
+};
+
+struct APSlot
+{
+	const char * volatile	apsTag;				// nullptr if the slot is unused
+	volatile size_t			apsLiveBytes;
+	volatile size_t			apsLiveBlocks;
+	volatile size_t			apsPeakBytes;
+	volatile uint64_t		apsTotalAllocs;
+	volatile uint64_t		apsTotalBytes;
+	uint64_t				apsMarkAllocs;		// apsTotalAllocs as of the last marked snapshot
+	uint64_t				apsMarkBytes;		// ditto, apsTotalBytes
+};
+
+const uint32_t	kAPMarker			= 0xA110CA7EU;
+const uint32_t	kAPNumSlots			= 1024;		// must be a power of 2
+const uint32_t	kAPUntaggedSlot		= 0;		// plain new, or tag-less allocations
+const uint32_t	kAPOverflowSlot		= 1;		// used only if every other slot is taken
+const uint32_t	kAPFirstTagSlot		= 2;
+const uint32_t	kAPUncountedSlot	= 0xFFFFFFFFU;	// allocated while counting was off
+
+const char		kAPUntaggedName[]	= "<untagged>";
+const char		kAPOverflowName[]	= "<other>";
+
+
+/*
+**	Internal Routines
+*/
+static uint32_t		APFindSlot( const char * tag ) DOES_NOT_THROW;
+static const char *	APSlotName( uint32_t slot );
+
+
+/*
+**	Variables
+*/
+static APSlot		gAPSlots[ kAPNumSlots ];
+static ulong		gAPMarkTime;				// GetFrameCounter() at the last mark
+static volatile bool	gAPEnabled = true;		// see AllocProfileEnable()
+
+
+/*
+**	NewAlloc()
+**
+**	allocate memory and charge it to its tag
+*/
+void *
+NewAlloc( size_t size, const char * tagString ) DOES_NOT_THROW
+{
+	// sanity check the size
+	if ( size > size_t( -1 ) - sizeof( APHeader ) )
+		return nullptr;
+	
+	APHeader * hdr = static_cast<APHeader *>( std::malloc( sizeof( APHeader ) + size ) );
+	if ( not hdr )
+		return nullptr;
+	
+	hdr->aphSize   = size;
+	hdr->aphMarker = kAPMarker;
+	if ( not gAPEnabled )
+		{
+		hdr->aphSlot = kAPUncountedSlot;
+		return hdr + 1;
+		}
+	
+	uint32_t slot = APFindSlot( tagString );
+	hdr->aphSlot = slot;
+	
+	APSlot& s = gAPSlots[ slot ];
+	size_t live = __sync_add_and_fetch( &s.apsLiveBytes, size );
+	__sync_fetch_and_add( &s.apsLiveBlocks, 1 );
+	__sync_fetch_and_add( &s.apsTotalAllocs, uint64_t( 1 ) );
+	__sync_fetch_and_add( &s.apsTotalBytes, uint64_t( size ) );
+	
+	// update the high-water mark. If two threads race here, the peak can
+	// come up short by one block; that's not worth a compare-and-swap loop.
+	if ( live > s.apsPeakBytes )
+		s.apsPeakBytes = live;
+	
+	return hdr + 1;
+}
+
+
+/*
+**	NewFree()
+**
+**	release memory, and credit its tag
+*/
+void
+NewFree( void * ptr ) DOES_NOT_THROW
+{
+	if ( not ptr )
+		return;
+	
+	APHeader * hdr = static_cast<APHeader *>( ptr ) - 1;
+	if ( hdr->aphMarker != kAPMarker
+	||   ( hdr->aphSlot >= kAPNumSlots && hdr->aphSlot != kAPUncountedSlot ) )
+		{
+		// either not one of ours, or deleted twice. Either way, leaking it
+		// is safer than handing it to free().
+		PlatformNewErrMsg( "Bad block marker." );
+		return;
+		}
+	hdr->aphMarker = 0;
+	
+	// blocks charged while counting was on are credited even if it's off now
+	if ( hdr->aphSlot != kAPUncountedSlot )
+		{
+		APSlot& s = gAPSlots[ hdr->aphSlot ];
+		__sync_fetch_and_sub( &s.apsLiveBytes, hdr->aphSize );
+		__sync_fetch_and_sub( &s.apsLiveBlocks, 1 );
+		}
+	
+	std::free( hdr );
+}
+
+
+/*
+**	APFindSlot()
+**
+**	find (or claim) the counter slot for a tag
+*/
+uint32_t
+APFindSlot( const char * tag ) DOES_NOT_THROW
+{
+	if ( not tag )
+		return kAPUntaggedSlot;
+	
+	// Fibonacci hash of the pointer; the low bits of string addresses are poorly mixed
+	uintptr_t hash = reinterpret_cast<uintptr_t>( tag );
+	uint32_t index = uint32_t( ( hash ^ ( hash >> 16 ) ) * 2654435761U );
+	
+	const uint32_t kNumTagSlots = kAPNumSlots - kAPFirstTagSlot;
+	for ( uint32_t probe = 0;  probe < kNumTagSlots;  ++probe )
+		{
+		uint32_t slot = kAPFirstTagSlot + ( index + probe ) % kNumTagSlots;
+		const char * cur = gAPSlots[ slot ].apsTag;
+		if ( cur == tag )
+			return slot;
+		
+		// an empty slot: try to claim it
+		if ( not cur )
+			{
+			cur = __sync_val_compare_and_swap( &gAPSlots[ slot ].apsTag,
+						static_cast<const char *>( nullptr ), tag );
+			// we won, or some other thread just claimed it for this very same tag
+			if ( not cur || cur == tag )
+				return slot;
+			}
+		}
+	
+	return kAPOverflowSlot;
+}
+
+
+/*
+**	APSlotName()
+**
+**	the printable name of a slot's tag
+*/
+const char *
+APSlotName( uint32_t slot )
+{
+	if ( kAPUntaggedSlot == slot )
+		return kAPUntaggedName;
+	if ( kAPOverflowSlot == slot )
+		return kAPOverflowName;
+	return gAPSlots[ slot ].apsTag;
+}
+
+#pragma mark -
+
+
+/*
+**	AllocProfileSnapshot()
+**
+**	collect the per-tag counters, merging slots whose tags have the same text,
+**	and sort them by live bytes, largest first.
+*/
+int
+AllocProfileSnapshot( AllocProfileEntry * oEntries, int maxEntries,
+					  bool bMark, ulong * oIntervalTicks )
+{
+	int count = 0;
+	AllocProfileEntry overflow;
+	memset( &overflow, 0, sizeof overflow );
+	overflow.apeTag = kAPOverflowName;
+	
+	for ( uint32_t slot = 0;  slot < kAPNumSlots;  ++slot )
+		{
+		APSlot& s = gAPSlots[ slot ];
+		if ( slot >= kAPFirstTagSlot && not s.apsTag )
+			continue;
+		
+		// take a local copy of the volatile counters
+		uint64_t totalAllocs = s.apsTotalAllocs;
+		uint64_t totalBytes  = s.apsTotalBytes;
+		if ( 0 == totalAllocs )
+			continue;
+		
+		AllocProfileEntry e;
+		e.apeTag            = APSlotName( slot );
+		e.apeLiveBytes      = s.apsLiveBytes;
+		e.apeLiveBlocks     = s.apsLiveBlocks;
+		e.apePeakBytes      = s.apsPeakBytes;
+		e.apeTotalAllocs    = totalAllocs;
+		e.apeTotalBytes     = totalBytes;
+		e.apeIntervalAllocs = totalAllocs - s.apsMarkAllocs;
+		e.apeIntervalBytes  = totalBytes  - s.apsMarkBytes;
+		
+		if ( bMark )
+			{
+			s.apsMarkAllocs = totalAllocs;
+			s.apsMarkBytes  = totalBytes;
+			}
+		
+		// merge with an existing entry of the same name?
+		AllocProfileEntry * dst = nullptr;
+		for ( int ii = 0;  ii < count;  ++ii )
+			{
+			if ( oEntries[ ii ].apeTag == e.apeTag
+			||   0 == std::strcmp( oEntries[ ii ].apeTag, e.apeTag ) )
+				{
+				dst = &oEntries[ ii ];
+				break;
+				}
+			}
+		// or start a new one, if there's room; otherwise lump it in with "<other>"
+		if ( not dst )
+			{
+			if ( count < maxEntries )
+				{
+				dst = &oEntries[ count++ ];
+				*dst = e;
+				continue;
+				}
+			dst = &overflow;
+			}
+		
+		dst->apeLiveBytes      += e.apeLiveBytes;
+		dst->apeLiveBlocks     += e.apeLiveBlocks;
+		dst->apePeakBytes      += e.apePeakBytes;	// an upper bound, since peaks may not coincide
+		dst->apeTotalAllocs    += e.apeTotalAllocs;
+		dst->apeTotalBytes     += e.apeTotalBytes;
+		dst->apeIntervalAllocs += e.apeIntervalAllocs;
+		dst->apeIntervalBytes  += e.apeIntervalBytes;
+		}
+	
+	// the overflow bin takes the place of the smallest entry
+	if ( overflow.apeTotalAllocs && count > 0 )
+		{
+		int smallest = 0;
+		for ( int ii = 1;  ii < count;  ++ii )
+			if ( oEntries[ ii ].apeLiveBytes < oEntries[ smallest ].apeLiveBytes )
+				smallest = ii;
+		if ( oEntries[ smallest ].apeLiveBytes < overflow.apeLiveBytes )
+			oEntries[ smallest ] = overflow;
+		}
+	
+	// insertion sort, biggest first. There are only a few hundred tags.
+	for ( int ii = 1;  ii < count;  ++ii )
+		{
+		AllocProfileEntry e = oEntries[ ii ];
+		int jj = ii;
+		for ( ;  jj > 0 && oEntries[ jj - 1 ].apeLiveBytes < e.apeLiveBytes;  --jj )
+			oEntries[ jj ] = oEntries[ jj - 1 ];
+		oEntries[ jj ] = e;
+		}
+	
+	ulong now = GetFrameCounter();
+	if ( oIntervalTicks )
+		*oIntervalTicks = now - gAPMarkTime;
+	if ( bMark )
+		gAPMarkTime = now;
+	
+	return count;
+}
+
+
+/*
+**	AllocProfileResetPeaks()
+**
+**	start tracking high-water marks afresh
+*/
+void
+AllocProfileResetPeaks()
+{
+	for ( uint32_t slot = 0;  slot < kAPNumSlots;  ++slot )
+		gAPSlots[ slot ].apsPeakBytes = gAPSlots[ slot ].apsLiveBytes;
+}
+
+
+/*
+**	AllocProfileEnable()
+**
+**	start or stop counting allocations
+*/
+void
+AllocProfileEnable( bool bEnable )
+{
+	gAPEnabled = bEnable;
+}
+
+
+/*
+**	AllocProfileIsEnabled()
+*/
+bool
+AllocProfileIsEnabled()
+{
+	return gAPEnabled;
+}
+
+
+/*
+**	AllocProfileWrite()
+**
+**	append one tab-separated snapshot to a text file.
+**	The rates are averaged over the time since the previous marked snapshot.
+*/
+void
+AllocProfileWrite( std::FILE * stream )
+{
+	if ( not stream )
+		return;
+	
+	const int kMaxEntries = 256;
+	AllocProfileEntry * entries = static_cast<AllocProfileEntry *>(
+									std::malloc( kMaxEntries * sizeof( AllocProfileEntry ) ) );
+	if ( not entries )
+		return;
+	
+	ulong ticks = 0;
+	int count = AllocProfileSnapshot( entries, kMaxEntries, true, &ticks );
+	double secs = ticks ? ticks / 60.0 : 1.0;
+	
+	DTSDate date;
+	date.Get();
+	std::fprintf( stream, "# %.4d-%.2d-%.2d %.2d:%.2d:%.2d, interval %.1f s\n",
+		date.dateYear, date.dateMonth, date.dateDay,
+		date.dateHour, date.dateMinute, date.dateSecond,
+		ticks / 60.0 );
+	std::fprintf( stream, "#Tag\tLiveBytes\tLiveBlocks\tPeakBytes\tAllocs\tBytes"
+						  "\tAllocs/s\tBytes/s\n" );
+	
+	for ( int ii = 0;  ii < count;  ++ii )
+		{
+		const AllocProfileEntry& e = entries[ ii ];
+		std::fprintf( stream, "%s\t%lu\t%lu\t%lu\t%llu\t%llu\t%.1f\t%.0f\n",
+			e.apeTag,
+			static_cast<ulong>( e.apeLiveBytes ),
+			static_cast<ulong>( e.apeLiveBlocks ),
+			static_cast<ulong>( e.apePeakBytes ),
+			static_cast<unsigned long long>( e.apeTotalAllocs ),
+			static_cast<unsigned long long>( e.apeTotalBytes ),
+			e.apeIntervalAllocs / secs,
+			e.apeIntervalBytes / secs );
+		}
+	std::fputc( '\n', stream );
+	std::fflush( stream );
+	
+	std::free( entries );
+}
+
+#endif  // DTS_ALLOC_PROFILE
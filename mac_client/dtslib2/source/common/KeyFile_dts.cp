@@ -54,6 +54,7 @@ const int	kKeyVersion			= 2;		// DTSKeyHeader::keyVersion2
 
 const uint	kMinInitEntries		= 8;	// min # entries in newly-made keyfiles
 const int	kTableBumpSize		= 10;	// increment when growing the entry table
+const size_t kBatchBufferSize	= 256 * 1024;	// WriteBatch() coalesces writes up to this
 
 
 	// in-RAM (and on-disk) information about a single record
@@ -73,6 +74,17 @@ struct DTSKeyEntryList
 	DTSKeyEntryList *	keyNext;
 };
 
+	// a record WriteBatch() has found a place for, but not yet written
+struct DTSKeyPendingWrite
+{
+	ulong					pwPosition;		// where it goes
+	long					pwIndex;		// its place in the batch
+	const DTSKeyRecord *	pwRecord;
+	bool					pwIsNew;		// wasn't in the table before the batch
+	int32_t					pwOldPosition;	// otherwise, where it was
+	int32_t					pwOldSize;
+};
+
 	// File-header data (the in-RAM version;
 	// what's on disk is different, and poorly aligned)
 struct DTSKeyHeader
@@ -139,11 +151,18 @@ public:
 	DTSKeyHeader		keyHeader;			// header
 	DTSKeyEntryList *	keyEntry;			// record table
 	DTSKeyEntryList *	keyFirst;			// first entry in file
+	DTSFileMapping *	keyMapping;			// read-only mapping of the file, made on demand
+	DTSFileSpec			keySpec;			// where the file lives, for mapping
 	int					keyRefNum;			// file reference number
 	int					keyWriteMode;		// header write mode
 	long				keyMax;				// max that will fit in entry list
 	bool				keyWritePerm;		// true if has write permission
 	bool				keyHdrDirty;		// true if the header is dirty
+	int					keyCompressPass;	// 0, or which pass of CompressSome() we're in
+	long				keyCompressNext;	// next entry for it to move
+	ulong				keyCompressPos;		// where that entry goes
+	ulong				keyCompressTable;	// end of the entry table, on disk
+	long *				keyCompressOrder;	// entries in the order to move them, or null
 	
 	// constructor/destructor
 				DTSKeyFilePriv();
@@ -152,13 +171,21 @@ public:
 	// interface
 	DTSError	Open( DTSFileSpec * spec, uint flags, int fileTypeID, uint initNumEntries );
 	void		Close();
+	DTSError	Revert();
 	DTSError	Exists( DTSKeyType ttype, DTSKeyID id ) const;
 	DTSError	ReadAlloc( DTSKeyType ttype, DTSKeyID id, void *& oBuffer );
 	DTSError	GetSize( DTSKeyType ttype, DTSKeyID id, size_t * oSize ) const;
+	DTSError	GetPosition( DTSKeyType ttype, DTSKeyID id, size_t * oPosition ) const;
 	DTSError	Read( DTSKeyType ttype, DTSKeyID id, void * buffer, size_t bufsz );
+	DTSError	MapRecord( DTSKeyType ttype, DTSKeyID id, const void ** oData, size_t * oSize,
+					DTSFileMapping ** oMapping );
 	DTSError	Write( DTSKeyType ttype, DTSKeyID id, const void * buffer, size_t size );
+	DTSError	WriteBatch( const DTSKeyRecord * records, long count );
 	DTSError	Delete( DTSKeyType ttype, DTSKeyID id );
 	DTSError	Compress();
+	DTSError	CompressSome( long maxRecords, bool * oDone );
+	DTSError	Repack( const DTSKeyRef * order, long count );
+	bool		IsCompressing() const { return keyCompressPass != 0; }
 	DTSError	Count( DTSKeyType ttype, long * oCount ) const;
 	DTSError	GetID( DTSKeyType ttype, long indx, DTSKeyID * oID ) const;
 	DTSError	GetIndex( DTSKeyType ttype, DTSKeyID id, long * oIindex ) const;
@@ -181,12 +208,15 @@ private:
 	DTSError	WriteHeader();
 	DTSError	WriteTable();
 	DTSError	WriteTableEntry( DTSKeyEntryList * entry );
+	DTSError	CompressMove( DTSKeyEntryList * entry );
 	DTSKeyEntryList *	FindEntry( DTSKeyType ttype, DTSKeyID id ) const;
 	DTSKeyEntryList *	FindEntryFirst( DTSKeyType ttype ) const;
 	DTSKeyEntryList *	FindEntryLast ( DTSKeyType ttype ) const;
 	DTSKeyEntryList *	SortTableWithLinks( DTSKeyType ttype, DTSKeyID id, size_t size );
 	DTSError	FindCreateEntry( DTSKeyType t, DTSKeyID id, size_t sz, DTSKeyEntryList ** entry );
 	DTSError	FindBestPosition( DTSKeyEntryList * e, size_t sz, DTSKeyEntryList **, ulong * p );
+	void		PlaceEntry( DTSKeyEntryList * e, DTSKeyEntryList * after, ulong p, size_t sz );
+	void		UnplaceBatch( const DTSKeyPendingWrite * pending, long count );
 	void		RemovePositionList( DTSKeyEntryList * entry );
 	
 	static DTSError		ReadKeyHeader( int refNum, DTSKeyHeader * header );
@@ -221,6 +251,7 @@ static FILE * gStream;
 #if DEBUG_VERSION_KEYFILES
 static void		LogToStream( const char * format, ... ) PRINTF_LIKE( 1, 2 );
 #endif  // DEBUG_VERSION_KEYFILES
+static int		ComparePendingWrites( const void * a, const void * b );
 
 
 /*
@@ -235,11 +266,17 @@ DTSDefineImplementFirmNoCopy(DTSKeyFilePriv)
 DTSKeyFilePriv::DTSKeyFilePriv() :
 	keyEntry(),								// table not loaded
 	keyFirst(),
+	keyMapping(),							// not mapped
 	keyRefNum( -1 ),						// file not open
 	keyWriteMode( kWriteModeReliable ),		// assume reliable writing
 	keyMax(),								// no entries in table
 	keyWritePerm(),
-	keyHdrDirty()							// header not dirty
+	keyHdrDirty(),							// header not dirty
+	keyCompressPass(),						// not compressing
+	keyCompressNext(),
+	keyCompressPos(),
+	keyCompressTable(),
+	keyCompressOrder()						// table order
 {
 	// initialize the fields
 	InitFields();
@@ -297,6 +334,7 @@ DTSKeyFilePriv::Open( DTSFileSpec * spec, uint flags, int fileTypeID, uint initN
 	// write permission
 	bool bWritePerm = (flags & kKeyReadWritePerm) != 0;
 	keyWritePerm = bWritePerm;
+	keySpec = *spec;
 	
 	DTSError result = DTS_open( spec, bWritePerm, &keyRefNum );
 	if ( fnfErr == result )
@@ -368,6 +406,14 @@ DTSKeyFilePriv::Close()
 	// not already closed?
 	if ( keyRefNum != -1 )
 		{
+		// finish any compression that's under way
+		while ( keyCompressPass )
+			{
+			bool done;
+			if ( CompressSome( LONG_MAX, &done ) != noErr )
+				break;
+			}
+		
 		// ensure the header & entry table are flushed
 		SetWriteMode( kWriteModeReliable );
 		
@@ -376,6 +422,10 @@ DTSKeyFilePriv::Close()
 		
 		// free memory
 		delete[] reinterpret_cast<char *>( keyEntry );
+		delete[] keyCompressOrder;
+		
+		// anyone still streaming from the mapping holds their own reference
+		DTS_releasemap( keyMapping );
 		
 		// re-initialize the fields in case someone opens the file again
 		InitFields();
@@ -387,6 +437,45 @@ DTSKeyFilePriv::Close()
 }
 
 
+/*
+**	DTSKeyFile::Revert()
+**
+**	close the file without flushing the header & table, and re-open it
+*/
+DTSError
+DTSKeyFile::Revert()
+{
+	DTSKeyFilePriv * p = priv.p;
+	return p ? p->Revert() : -1;
+}
+
+
+/*
+**	DTSKeyFilePriv::Revert()
+**
+**	forget the header & table changes that kWriteModeFaster has been holding
+**	back, by closing the file without writing them and opening it again with
+**	the same permission. Record data already written stays where it landed;
+**	the table on disk just never hears of it.
+*/
+DTSError
+DTSKeyFilePriv::Revert()
+{
+	if ( -1 == keyRefNum )
+		return fnOpnErr;
+	if ( keyCompressPass )
+		return kKeyFileCompressing;
+	
+	DTSFileSpec spec = keySpec;
+	uint flags = kKeyDontCreateFile | ( keyWritePerm ? kKeyReadWritePerm : kKeyReadOnlyPerm );
+	
+	keyHdrDirty = false;
+	Close();
+	
+	return Open( &spec, flags, 0, 0 );
+}
+
+
 /*
 **	DTSKeyFilePriv::InitFields()
 **
@@ -397,10 +486,13 @@ DTSKeyFilePriv::InitFields()
 {
 	keyHeader.keyVersion2 = -1;					// header not yet read
 	keyEntry              = nullptr;			// table not loaded
+	keyMapping            = nullptr;			// not mapped
 	keyRefNum             = -1;					// file not open
 	keyWriteMode          = kWriteModeReliable;	// assume reliable writing
 	keyMax                = 0;					// no entries in table
 	keyHdrDirty           = false;				// header not dirty
+	keyCompressPass       = 0;					// not compressing
+	keyCompressOrder      = nullptr;			// table order
 }
 
 
@@ -1638,6 +1730,42 @@ DTSKeyFilePriv::GetSize( DTSKeyType ttype, DTSKeyID id, size_t * psize ) const
 }
 
 
+/*
+**	DTSKeyFile::GetPosition()
+**
+**	return the offset in the file of the designated record's data
+*/
+DTSError
+DTSKeyFile::GetPosition( DTSKeyType ttype, DTSKeyID id, size_t * oPosition ) const
+{
+	const DTSKeyFilePriv * p = priv.p;
+	return p ? p->GetPosition( ttype, id, oPosition ) : -1;
+}
+
+
+/*
+**	DTSKeyFilePriv::GetPosition()
+**
+**	return the position of the record
+*/
+DTSError
+DTSKeyFilePriv::GetPosition( DTSKeyType ttype, DTSKeyID id, size_t * oPosition ) const
+{
+	if ( -1 == keyRefNum || not keyEntry )
+		return fnOpnErr;
+	
+	if ( const DTSKeyEntryList * entry = FindEntry( ttype, id ) )
+		{
+		if ( oPosition )
+			*oPosition = static_cast<size_t>( entry->keyEntry.keyPosition );
+		
+		return noErr;
+		}
+	
+	return -1;
+}
+
+
 /*
 **	DTSKeyFile::Read()
 **
@@ -1689,6 +1817,72 @@ DTSKeyFilePriv::Read( DTSKeyType ttype, DTSKeyID id, void * buffer, size_t bufsz
 }
 
 
+/*
+**	DTSKeyFile::MapRecord()
+**
+**	locate a record within a read-only mapping of the file, without copying it.
+**	On success *oMapping holds a new reference, which the caller must release
+**	via DTS_releasemap() once it has finished with *oData.
+*/
+DTSError
+DTSKeyFile::MapRecord( DTSKeyType ttype, DTSKeyID id, const void ** oData, size_t * oSize,
+	DTSFileMapping ** oMapping )
+{
+	DTSKeyFilePriv * p = priv.p;
+	return p ? p->MapRecord( ttype, id, oData, oSize, oMapping ) : -1;
+}
+
+
+/*
+**	DTSKeyFilePriv::MapRecord()
+**
+**	the whole file is mapped the first time a record is asked for.
+**	Writable files are never mapped, since their records move around.
+*/
+DTSError
+DTSKeyFilePriv::MapRecord( DTSKeyType ttype, DTSKeyID id, const void ** oData, size_t * oSize,
+	DTSFileMapping ** oMapping )
+{
+	__Check( oData );
+	__Check( oSize );
+	__Check( oMapping );
+	if ( not oData || not oSize || not oMapping )
+		return paramErr;
+	
+	if ( -1 == keyRefNum || not keyEntry )
+		return fnOpnErr;
+	if ( keyWritePerm )
+		return wrPermErr;
+	
+	const DTSKeyEntryList * entry = FindEntry( ttype, id );
+	if ( not entry )
+		return -1;
+	
+	if ( not keyMapping )
+		{
+		DTSError result = DTS_map( &keySpec, &keyMapping );
+		if ( noErr != result )
+			return result;
+		}
+	
+	// don't trust the table blindly
+	size_t pos  = static_cast<size_t>( entry->keyEntry.keyPosition );
+	size_t size = static_cast<size_t>( entry->keyEntry.keySize );
+	if ( pos > keyMapping->mapSize
+	||   size > keyMapping->mapSize - pos )
+		{
+		return eofErr;
+		}
+	
+	DTS_retainmap( keyMapping );
+	*oData    = keyMapping->mapData + pos;
+	*oSize    = size;
+	*oMapping = keyMapping;
+	
+	return noErr;
+}
+
+
 /*
 **	DTSKeyFile::ReadAlloc()
 **
@@ -1771,6 +1965,8 @@ DTSKeyFilePriv::Write( DTSKeyType ttype, DTSKeyID id, const void * buffer, size_
 		return memFullErr;
 	if ( not keyWritePerm )
 		return wrPermErr;
+	if ( keyCompressPass )
+		return kKeyFileCompressing;
 	if ( size <= 0 )
 		return -1;
 	
@@ -1815,38 +2011,12 @@ DTSKeyFilePriv::Write( DTSKeyType ttype, DTSKeyID id, const void * buffer, size_
 	if ( noErr == result )
 		{
 		// update the entry
-		size_t orgsize  = static_cast<size_t>( entry->keyEntry.keySize );
-		int orgposition = entry->keyEntry.keyPosition;
-		entry->keyEntry.keySize     = static_cast<int32_t>( size );
-		entry->keyEntry.keyPosition = static_cast<int32_t>( position );
-		
-		// handle an oddball case
-		if ( after == entry )
-			after = entry->keyPrev;
-		
-		// remove ourselves from the list
-		// and re-install ourselves into it
 		// need to do this before the call to WriteTable()
 		// because it might change the position list
 		// which would invalidate 'after'
-		RemovePositionList( entry );
-		DTSKeyEntryList * test;
-		if ( not after )
-			{
-			// install first
-			test = keyFirst;
-			keyFirst = entry;
-			}
-		else
-			{
-			// install after
-			test = after->keyNext;
-			after->keyNext = entry;
-			}
-		entry->keyPrev = after;
-		entry->keyNext = test;
-		if ( test )
-			test->keyPrev = entry;
+		size_t orgsize  = static_cast<size_t>( entry->keyEntry.keySize );
+		int orgposition = entry->keyEntry.keyPosition;
+		PlaceEntry( entry, after, position, size );
 		
 #if DEBUG_VERSION_KEYFILES
 		CheckConsistency();
@@ -1884,6 +2054,274 @@ DTSKeyFilePriv::Write( DTSKeyType ttype, DTSKeyID id, const void * buffer, size_
 }
 
 
+/*
+**	DTSKeyFilePriv::PlaceEntry()
+**
+**	give the entry its new position and size,
+**	and move it to its new place in the position list, after 'after'
+*/
+void
+DTSKeyFilePriv::PlaceEntry( DTSKeyEntryList * entry, DTSKeyEntryList * after,
+	ulong position, size_t size )
+{
+	entry->keyEntry.keySize     = static_cast<int32_t>( size );
+	entry->keyEntry.keyPosition = static_cast<int32_t>( position );
+	
+	// handle an oddball case
+	if ( after == entry )
+		after = entry->keyPrev;
+	
+	// remove ourselves from the list
+	// and re-install ourselves into it
+	RemovePositionList( entry );
+	DTSKeyEntryList * test;
+	if ( not after )
+		{
+		// install first
+		test = keyFirst;
+		keyFirst = entry;
+		}
+	else
+		{
+		// install after
+		test = after->keyNext;
+		after->keyNext = entry;
+		}
+	entry->keyPrev = after;
+	entry->keyNext = test;
+	if ( test )
+		test->keyPrev = entry;
+}
+
+
+/*
+**	DTSKeyFile::WriteBatch()
+**
+**	write a number of records at once.
+**	if the file already contains a record having one of the given types and IDs,
+**	replace it; otherwise add it.
+*/
+DTSError
+DTSKeyFile::WriteBatch( const DTSKeyRecord * records, long count )
+{
+	DTSKeyFilePriv * p = priv.p;
+	return p ? p->WriteBatch( records, count ) : -1;
+}
+
+
+/*
+**	ComparePendingWrites()
+**
+**	qsort() helper: order pending writes by file position, then batch order
+*/
+int
+ComparePendingWrites( const void * a, const void * b )
+{
+	const DTSKeyPendingWrite * wa = static_cast<const DTSKeyPendingWrite *>( a );
+	const DTSKeyPendingWrite * wb = static_cast<const DTSKeyPendingWrite *>( b );
+	
+	if ( wa->pwPosition != wb->pwPosition )
+		return wa->pwPosition < wb->pwPosition ? -1 : 1;
+	return int( wa->pwIndex - wb->pwIndex );
+}
+
+
+/*
+**	DTSKeyFilePriv::WriteBatch()
+**
+**	place every record first, as Write() would, but hold on to the data.
+**	then write it all in file order, gathering records that abut one another
+**	into a single write, and finally write the table once.
+**	If anything fails, the entries are put back where they were and neither the
+**	header nor the table is written. Data already written can only have landed
+**	on free space or on the old copies of records in this batch, so any other
+**	record is untouched; the batch's own records should be written again.
+*/
+DTSError
+DTSKeyFilePriv::WriteBatch( const DTSKeyRecord * records, long count )
+{
+	// paranoid checks
+	if ( -1 == keyRefNum )
+		return fnOpnErr;
+	if ( not keyEntry )
+		return memFullErr;
+	if ( not keyWritePerm )
+		return wrPermErr;
+	if ( keyCompressPass )
+		return kKeyFileCompressing;
+	if ( count <= 0 )
+		return noErr;
+	
+	DTSKeyPendingWrite * pending = NEW_TAG("DTSKeyPendingWrite") DTSKeyPendingWrite[ count ];
+	if ( not pending )
+		return memFullErr;
+	
+	// don't write the table until the data is all down
+	int oldMode = keyWriteMode;
+	keyWriteMode = kWriteModeFaster;
+	bool oldDirty = keyHdrDirty;
+	
+	// remember where everything was, in case we have to put it back
+	for ( long n = 0;  n < count;  ++n )
+		{
+		const DTSKeyRecord * rec = &records[ n ];
+		const DTSKeyEntryList * entry = FindEntry( rec->recType, rec->recID );
+		pending[ n ].pwRecord      = rec;
+		pending[ n ].pwIsNew       = not entry;
+		pending[ n ].pwOldPosition = entry ? entry->keyEntry.keyPosition : 0;
+		pending[ n ].pwOldSize     = entry ? entry->keyEntry.keySize : 0;
+		}
+	
+	// find a place for every record
+	DTSError result = noErr;
+	for ( long n = 0;  n < count;  ++n )
+		{
+		const DTSKeyRecord * rec = &records[ n ];
+		if ( rec->recSize <= 0 )
+			{
+			result = -1;
+			break;
+			}
+		
+		DTSKeyEntryList * entry;
+		result = FindCreateEntry( rec->recType, rec->recID, rec->recSize, &entry );
+		
+		ulong position = 0;
+		DTSKeyEntryList * after = nullptr;
+		if ( noErr == result )
+			result = FindBestPosition( entry, rec->recSize, &after, &position );
+		if ( noErr != result )
+			break;
+		
+		PlaceEntry( entry, after, position, rec->recSize );
+		keyHdrDirty = true;
+		
+		pending[ n ].pwPosition = position;
+		pending[ n ].pwIndex    = n;
+		}
+		
+#if DEBUG_VERSION_KEYFILES
+	CheckConsistency();
+#endif
+	
+	// write the data in file order
+	char * buffer = nullptr;
+	if ( noErr == result )
+		{
+		qsort( pending, static_cast<size_t>( count ), sizeof pending[0], ComparePendingWrites );
+		
+		buffer = NEW_TAG("DTSKeyBatchBuffer") char[ kBatchBufferSize ];
+		if ( not buffer )
+			result = memFullErr;
+		}
+	if ( noErr == result )
+		{
+		ulong runStart = 0;		// file position of buffer[0]
+		size_t runSize = 0;		// bytes waiting in the buffer
+		for ( long n = 0;  n < count && noErr == result;  ++n )
+			{
+			const DTSKeyPendingWrite& pw = pending[ n ];
+			const DTSKeyRecord * rec = pw.pwRecord;
+			
+			// flush the buffer if this record doesn't continue it, or won't fit
+			if ( runSize
+			&&   ( pw.pwPosition != runStart + runSize
+			||     runSize + rec->recSize > kBatchBufferSize ) )
+				{
+				result = DTS_seek( keyRefNum, runStart );
+				if ( noErr == result )
+					result = DTS_write( keyRefNum, buffer, runSize );
+				runSize = 0;
+				if ( noErr != result )
+					break;
+				}
+			
+			// big ones go straight to the file
+			if ( rec->recSize > kBatchBufferSize )
+				{
+				result = DTS_seek( keyRefNum, pw.pwPosition );
+				if ( noErr == result )
+					result = DTS_write( keyRefNum, rec->recData, rec->recSize );
+				continue;
+				}
+			
+			if ( 0 == runSize )
+				runStart = pw.pwPosition;
+			memcpy( buffer + runSize, rec->recData, rec->recSize );
+			runSize += rec->recSize;
+			}
+		if ( noErr == result && runSize )
+			{
+			result = DTS_seek( keyRefNum, runStart );
+			if ( noErr == result )
+				result = DTS_write( keyRefNum, buffer, runSize );
+			}
+		}
+	
+	delete[] buffer;
+	
+	// on failure, make it as if the batch had never been
+	if ( noErr != result )
+		{
+		UnplaceBatch( pending, count );
+		keyHdrDirty = oldDirty;
+		}
+	delete[] pending;
+	
+	// now the header and table, unless the caller is holding them back
+	keyWriteMode = oldMode;
+	if ( noErr == result
+	&&   kWriteModeFaster != oldMode
+	&&   keyHdrDirty )
+		{
+		result = WriteHeader();
+		if ( noErr == result )
+			result = WriteTable();
+		}
+		
+#if DEBUG_VERSION_KEYFILES
+	LogToStream( "%p WriteBatch %ld records\n", this, count );
+	CheckConsistency();
+#endif
+	
+	return result;
+}
+
+
+/*
+**	DTSKeyFilePriv::UnplaceBatch()
+**
+**	undo WriteBatch()'s PlaceEntry() calls: give the old entries back their
+**	positions and sizes, drop the new ones from the table, and rebuild the
+**	position list, whose links can't be trusted any more
+*/
+void
+DTSKeyFilePriv::UnplaceBatch( const DTSKeyPendingWrite * pending, long count )
+{
+	for ( long n = 0;  n < count;  ++n )
+		{
+		const DTSKeyRecord * rec = pending[ n ].pwRecord;
+		DTSKeyEntryList * entry = FindEntry( rec->recType, rec->recID );
+		if ( not entry )
+			continue;
+		
+		if ( not pending[ n ].pwIsNew )
+			{
+			entry->keyEntry.keyPosition = pending[ n ].pwOldPosition;
+			entry->keyEntry.keySize     = pending[ n ].pwOldSize;
+			continue;
+			}
+		
+		// close up the table over the new entry; it stays sorted
+		long last = --keyHeader.keyCount;
+		for ( DTSKeyEntryList * limit = keyEntry + last;  entry < limit;  ++entry )
+			entry[0] = entry[1];
+		}
+	
+	InitPositionList();
+}
+
+
 /*
 **	DTSKeyFilePriv::FindCreateEntry()
 **
@@ -2220,6 +2658,8 @@ DTSKeyFilePriv::Delete( DTSKeyType ttype, DTSKeyID id )
 		return memFullErr;
 	if ( not keyWritePerm )
 		return wrPermErr;
+	if ( keyCompressPass )
+		return kKeyFileCompressing;
 	
 	// find the entry
 	DTSKeyEntryList * entry = FindEntry( ttype, id );
@@ -2400,6 +2840,60 @@ DTSKeyFile::Compress()
 DTSError
 DTSKeyFilePriv::Compress()
 {
+	bool done = false;
+	DTSError result = noErr;
+	while ( noErr == result
+	&&      not done )
+		{
+		result = CompressSome( LONG_MAX, &done );
+		}
+	
+	return result;
+}
+
+
+/*
+**	DTSKeyFile::CompressSome()
+**
+**	move up to maxRecords records toward compressing the file
+*/
+DTSError
+DTSKeyFile::CompressSome( long maxRecords, bool * oDone )
+{
+	DTSKeyFilePriv * p = priv.p;
+	return p ? p->CompressSome( maxRecords, oDone ) : -1;
+}
+
+
+/*
+**	DTSKeyFile::IsCompressing()
+**
+**	return true if CompressSome() has started but not finished
+*/
+bool
+DTSKeyFile::IsCompressing() const
+{
+	const DTSKeyFilePriv * p = priv.p;
+	return p ? p->IsCompressing() : false;
+}
+
+
+/*
+**	DTSKeyFilePriv::CompressSome()
+**
+**	compress the file a few records at a time.
+**	the first pass copies every record to the end of the file;
+**	the second copies them back down, packed tight, and trims the end off.
+**	between calls, every entry in the table points at a good copy of its record,
+**	both in memory and on disk; but the free-space list is stale,
+**	which is why Write() and Delete() have to wait till we're done.
+**	Both passes take the records in keyCompressOrder, if Repack() set one.
+*/
+DTSError
+DTSKeyFilePriv::CompressSome( long maxRecords, bool * oDone )
+{
+	*oDone = false;
+	
 	if ( -1 == keyRefNum )
 		return fnOpnErr;
 	if ( not keyEntry )
@@ -2407,87 +2901,207 @@ DTSKeyFilePriv::Compress()
 	if ( not keyWritePerm )
 		return wrPermErr;
 	
-	// read all of the records and append them to the end of the file
-	DTSKeyEntryList * entry;
-	long nnn;
-	void * temp;
-	ulong position;
-	ulong tableend = 0;
-	size_t size = 0;
 	long count = keyHeader.keyCount;
-	DTSError result = DTS_geteof( keyRefNum, &position );
-	if ( noErr == result )
-		{
-		// make sure there's room on disk for the entire entry table
-		tableend = kSizeOfKeyHeader1 + uint(count) * sizeof(DTSKeyEntry);
-		if ( position < tableend )
-			{
-			position = tableend;
-			result = DTS_seteof( keyRefNum, position );
-			}
-		}
-	if ( noErr == result )
+	DTSError result = noErr;
+	
+	// starting afresh?
+	if ( 0 == keyCompressPass )
 		{
-		entry = keyEntry;
-		for ( nnn = count;  nnn > 0;  --nnn, ++entry )
+		ulong position;
+		result = DTS_geteof( keyRefNum, &position );
+		if ( noErr == result )
 			{
-			result = ReadAlloc( entry->keyEntry.keyType, entry->keyEntry.keyID, temp );
-			if ( result != noErr )
-				break;
-			result = DTS_seek( keyRefNum, position );
-			if ( noErr == result )
+			// make sure there's room on disk for the entire entry table
+			ulong tableend = kSizeOfKeyHeader1 + uint(count) * sizeof(DTSKeyEntry);
+			if ( position < tableend )
 				{
-				size = static_cast<size_t>( entry->keyEntry.keySize );
-				result = DTS_write( keyRefNum, temp, size );
+				position = tableend;
+				result = DTS_seteof( keyRefNum, position );
 				}
-			delete[] static_cast<char *>( temp );
-			if ( result != noErr )
-				break;
-			entry->keyEntry.keyPosition = static_cast<int32_t>( position );
-			position += size;
+			keyCompressTable = tableend;
+			keyCompressPos   = position;
+			}
+		if ( noErr == result )
+			{
+			keyCompressPass = 1;
+			keyCompressNext = 0;
 			}
 		}
 	
-	// okay, we haven't blown away any data in the file yet
-	// (even though we've duplicated every record, after the file's logical end).
-	// let's sync up the header table and the newly written records.
-	// so we can safely blow away the old records
-	// just in case one of those darn users turns the power off.
-	if ( noErr == result )
+	// first pass: read all of the records and append them to the end of the file
+	for ( ;  noErr == result && 1 == keyCompressPass && maxRecords > 0;  --maxRecords )
+		{
+		if ( keyCompressNext < count )
+			{
+			long index = keyCompressNext++;
+			if ( keyCompressOrder )
+				index = keyCompressOrder[ index ];
+			result = CompressMove( &keyEntry[ index ] );
+			continue;
+			}
+		
+		// okay, we haven't blown away any data in the file yet
+		// (even though we've duplicated every record, after the file's logical end).
+		// let's sync up the header table and the newly written records.
+		// so we can safely blow away the old records
+		// just in case one of those darn users turns the power off.
 		result = WriteTable();
+		keyCompressPass = 2;
+		keyCompressNext = 0;
+		keyCompressPos  = keyCompressTable;
+		}
 	
-	// read all of the records which are at the end of the file
+	// second pass: read all of the records which are at the end of the file
 	// and write them to their new locations
-	if ( noErr == result )
+	for ( ;  noErr == result && 2 == keyCompressPass && maxRecords > 0;  --maxRecords )
 		{
-		entry = keyEntry;
-		position = tableend;
-		for ( nnn = count;  nnn > 0;  --nnn, ++entry )
+		if ( keyCompressNext < count )
 			{
-			result = ReadAlloc( entry->keyEntry.keyType, entry->keyEntry.keyID, temp );
-			if ( result != noErr )
-				break;
-			entry->keyEntry.keyPosition = static_cast<int32_t>( position );
-			size = static_cast<size_t>( entry->keyEntry.keySize );
-			result = DTS_seek( keyRefNum, position );
-			if ( noErr == result )
-				result = DTS_write( keyRefNum, temp, size );
-			delete[] static_cast<char *>( temp );
-			if ( result != noErr )
-				break;
-			position += size;
+			long index = keyCompressNext++;
+			if ( keyCompressOrder )
+				index = keyCompressOrder[ index ];
+			result = CompressMove( &keyEntry[ index ] );
+			continue;
 			}
+		
+		// write out the new table (again)
+		InitPositionList();
+		result = WriteTable();
+		
+		// set the new end of the file
+		if ( noErr == result )
+			result = DTS_seteof( keyRefNum, keyCompressPos );
+		
+		keyCompressPass = 0;
+		if ( noErr == result )
+			*oDone = true;
+		
+		delete[] keyCompressOrder;
+		keyCompressOrder = nullptr;
 		}
 	
-	// write out the new table (again)
-	if ( noErr == result )
+	// if something went wrong, give up; the records are all still where
+	// the table says they are, but the free-space list needs rebuilding
+	if ( result != noErr
+	&&   keyCompressPass )
 		{
+		keyCompressPass = 0;
 		InitPositionList();
-		result = WriteTable();
+		
+		delete[] keyCompressOrder;
+		keyCompressOrder = nullptr;
 		}
-	// set the new end of the file
+	
+	return result;
+}
+
+
+/*
+**	DTSKeyFile::Repack()
+**
+**	compress the file, storing the named records first, in the given order
+*/
+DTSError
+DTSKeyFile::Repack( const DTSKeyRef * order, long count )
+{
+	DTSKeyFilePriv * p = priv.p;
+	return p ? p->Repack( order, count ) : -1;
+}
+
+
+/*
+**	DTSKeyFilePriv::Repack()
+**
+**	turn the list of names into an order for CompressSome() to move the entries in:
+**	the named ones first, skipping any we don't have or have already placed,
+**	then everything else in table order.
+*/
+DTSError
+DTSKeyFilePriv::Repack( const DTSKeyRef * refs, long numRefs )
+{
+	// paranoid checks
+	if ( -1 == keyRefNum )
+		return fnOpnErr;
+	if ( not keyEntry )
+		return memFullErr;
+	if ( not keyWritePerm )
+		return wrPermErr;
+	if ( keyCompressPass )
+		return kKeyFileCompressing;
+	
+	long count = keyHeader.keyCount;
+	if ( count <= 0 )
+		return noErr;
+	
+	long * order = NEW_TAG("DTSKeyRepackOrder") long[ count ];
+	char * placed = NEW_TAG("DTSKeyRepackPlaced") char[ count ];
+	if ( not order
+	||   not placed )
+		{
+		delete[] order;
+		delete[] placed;
+		return memFullErr;
+		}
+	memset( placed, 0, count );
+	
+	long next = 0;
+	for ( long n = 0;  n < numRefs;  ++n )
+		{
+		const DTSKeyEntryList * entry = FindEntry( refs[n].refType, refs[n].refID );
+		if ( not entry )
+			continue;
+		long index = entry - keyEntry;
+		if ( placed[ index ] )
+			continue;
+		placed[ index ] = 1;
+		order[ next++ ] = index;
+		}
+	for ( long index = 0;  index < count;  ++index )
+		{
+		if ( not placed[ index ] )
+			order[ next++ ] = index;
+		}
+	delete[] placed;
+	
+	// CompressSome() lets go of the order when it's finished, or gives up partway;
+	// but if it fails before it starts, the order is still ours to free
+	keyCompressOrder = order;
+	
+	DTSError result = Compress();
+	if ( noErr != result )
+		{
+		delete[] keyCompressOrder;
+		keyCompressOrder = nullptr;
+		}
+	
+	return result;
+}
+
+
+/*
+**	DTSKeyFilePriv::CompressMove()
+**
+**	copy one record to keyCompressPos, and point its entry there
+*/
+DTSError
+DTSKeyFilePriv::CompressMove( DTSKeyEntryList * entry )
+{
+	void * temp;
+	DTSError result = ReadAlloc( entry->keyEntry.keyType, entry->keyEntry.keyID, temp );
 	if ( noErr == result )
-		result = DTS_seteof( keyRefNum, position );
+		{
+		size_t size = static_cast<size_t>( entry->keyEntry.keySize );
+		result = DTS_seek( keyRefNum, keyCompressPos );
+		if ( noErr == result )
+			result = DTS_write( keyRefNum, temp, size );
+		delete[] static_cast<char *>( temp );
+		
+		if ( noErr == result )
+			{
+			entry->keyEntry.keyPosition = static_cast<int32_t>( keyCompressPos );
+			keyCompressPos += size;
+			}
+		}
 	
 	return result;
 }
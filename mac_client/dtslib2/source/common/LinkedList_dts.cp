@@ -36,6 +36,13 @@ uint	DTSLinkedList_Count( const _DTSLinkedList * elem );
 void	DTSLinkedList_AppendList( _DTSLinkedList * elem, _DTSLinkedList *& root );
 void	DTSLinkedList_DeleteLinkedList( _DTSLinkedList *& root );
 void	DTSLinkedList_ReverseLinkedList( _DTSLinkedList *& root );
+
+void	DTSDLinkedList_MoveForward( _DTSDLinkedList * elem, _DTSDLinkedList *& root );
+void	DTSDLinkedList_MoveBack( _DTSDLinkedList * elem, _DTSDLinkedList *& root );
+uint	DTSDLinkedList_Count( const _DTSDLinkedList * elem );
+void	DTSDLinkedList_AppendList( _DTSDLinkedList * elem, _DTSDLinkedList *& root );
+void	DTSDLinkedList_DeleteLinkedList( _DTSDLinkedList *& root );
+void	DTSDLinkedList_ReverseLinkedList( _DTSDLinkedList *& root );
 */
 
 /*
@@ -45,6 +52,10 @@ class _DTSLinkedList : public DTSLinkedList<_DTSLinkedList>
 {
 };
 
+class _DTSDLinkedList : public DTSDLinkedList<_DTSDLinkedList>
+{
+};
+
 
 /*
 **	Internal Routines
@@ -263,3 +274,130 @@ DTSLinkedList_ReverseLinkedList( _DTSLinkedList *& root )
 }
 
 
+#pragma mark -
+
+
+/*
+**	DTSDLinkedList_MoveForward()
+**
+**	move one element forward in the doubly-linked list
+*/
+void
+DTSDLinkedList_MoveForward( _DTSDLinkedList * elem, _DTSDLinkedList *& root )
+{
+	// bail if this is the first item in the list, or isn't in one at all
+	if ( elem == root || not elem->linkPrev )
+		return;
+	
+	// old order: pprev prev elem next
+	// new order: pprev elem prev next
+	_DTSDLinkedList * prev = elem->linkPrev;
+	elem->Remove( root );
+	if ( prev == root )
+		elem->InstallFirst( root );
+	else
+		elem->InstallBehind( root, prev->linkPrev );
+}
+
+
+/*
+**	DTSDLinkedList_MoveBack()
+**
+**	move one element back in the doubly-linked list
+*/
+void
+DTSDLinkedList_MoveBack( _DTSDLinkedList * elem, _DTSDLinkedList *& root )
+{
+	// bail if this is the last element in the list
+	_DTSDLinkedList * next = elem->linkNext;
+	if ( not next )
+		return;
+	
+	// old order: prev elem next tail
+	// new order: prev next elem tail
+	elem->Remove( root );
+	elem->InstallBehind( root, next );
+}
+
+
+/*
+**	DTSDLinkedList_Count()
+**
+**	return the number of elements in the list
+*/
+uint
+DTSDLinkedList_Count( const _DTSDLinkedList * elem )
+{
+	uint count = 0;
+	for ( const _DTSDLinkedList * step = elem;  step;  step = step->linkNext )
+		++count;
+	
+	return count;
+}
+
+
+/*
+**	DTSDLinkedList_AppendList()
+**
+**	append this list to another
+*/
+void
+DTSDLinkedList_AppendList( _DTSDLinkedList * elem, _DTSDLinkedList *& root )
+{
+	// trivial cases
+	if ( not elem )
+		return;
+	_DTSDLinkedList * head = root;
+	if ( not head )
+		{
+		root = elem;
+		return;
+		}
+	
+	// splice this list in its entirety after the tail of the other
+	_DTSDLinkedList * newTail = elem->linkPrev;
+	_DTSDLinkedList * oldTail = head->linkPrev;
+	oldTail->linkNext = elem;
+	elem->linkPrev = oldTail;
+	head->linkPrev = newTail;
+}
+
+
+/*
+**	DTSDLinkedList_DeleteLinkedList()
+**
+**	delete every element of a doubly-linked list
+*/
+void
+DTSDLinkedList_DeleteLinkedList( _DTSDLinkedList *& root )
+{
+	// walk through the list
+	// (the elements' destructors are allowed to Remove() themselves)
+	_DTSDLinkedList * next;
+	for ( _DTSDLinkedList * test = root;  test;  test = next )
+		{
+		next = test->linkNext;
+		delete test;
+		}
+	
+	// just to be safe
+	root = nullptr;
+}
+
+
+/*
+**	DTSDLinkedList_ReverseLinkedList()
+**
+**	reverse the order of a doubly-linked list
+*/
+void
+DTSDLinkedList_ReverseLinkedList( _DTSDLinkedList *& root )
+{
+	_DTSDLinkedList * elem = root;
+	root = nullptr;
+	for ( _DTSDLinkedList * next;  elem;  elem = next )
+		{
+		next = elem->linkNext;
+		elem->InstallFirst( root );
+		}
+}
@@ -0,0 +1,1050 @@
+/*
+**	Mixer_dts.cp		dtslib2
+** 
+**	Copyright 2023 Delta Tao Software, Inc.
+** 
+**	Licensed under the Apache License, Version 2.0 (the "License");
+**	you may not use this file except in compliance with the License.
+**	You may obtain a copy of the License at
+** 
+**		https://www.apache.org/licenses/LICENSE-2.0
+** 
+**	Unless required by applicable law or agreed to in writing, software
+**	distributed under the License is distributed on an "AS IS" BASIS,
+**	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+**	See the License for the specific language governing permissions and
+**	imitations under the License.
+*/
+
+#ifndef _dtslib2_
+# include "Prefix_dts.h"
+#endif
+
+#include <pthread.h>
+#include <ctime>
+
+#include "Local_dts.h"
+#include "Memory_dts.h"
+#include "Mixer_dts.h"
+
+
+/*
+**	Entry Routines
+**
+**	DTSMixer::Init();
+**	DTSMixer::Play();
+**	DTSMixer::Stop();
+**	DTSMixer::StopAll();
+**	DTSMixer::IsPlaying();
+**	DTSMixer::CountPlaying();
+**	DTSMixer::SetVolume();
+**	DTSMixer::GetOutputRate();
+**	DTSMixer::GetStolenCount();
+**	DTSMixer::Render();
+**	DTSMixer::RenderOffline();
+**	DTSMixerBenchmark();
+*/
+
+
+/*
+**	Definitions
+*/
+const int		kGainShift			= 12;			// gains are fixed-point, 1.0 == 1 << 12
+const int32_t	kUnityGain			= 1 << kGainShift;
+const int		kPhaseShift			= 16;			// voice positions are 48.16 fixed-point
+const size_t	kMixSliceFrames		= 256;			// Render() works in slices this long
+
+
+/*
+**	struct MixVoice
+**	one slot in the voice pool
+*/
+struct MixVoice
+{
+	DTSMixSound		mvSound;
+	uint64_t		mvPhase;		// position within the sound, in 1/65536ths of a frame
+	uint32_t		mvStep;			// how far to advance per output frame, likewise
+	int32_t			mvGainL;		// fixed-point, see kGainShift
+	int32_t			mvGainR;
+	int				mvPriority;
+	ulong			mvSerial;		// when it started; lower is older
+	DTSMixVoiceID	mvID;			// kMixNoVoice if the slot is free
+};
+
+
+/*
+**	class DTSMixerPriv
+*/
+class DTSMixerPriv
+{
+public:
+	MixVoice *			mixVoices;
+	int					mixNumVoices;
+	uint32_t			mixOutputRate;
+	int32_t				mixMasterGain;		// fixed-point, see kGainShift
+	ulong				mixSerial;			// bumped by each Play()
+	ulong				mixStolen;
+	int32_t *			mixAccum;			// kMixSliceFrames stereo frames
+	mutable pthread_mutex_t	mixLock;
+	
+	// constructor/destructor
+						DTSMixerPriv();
+						~DTSMixerPriv();
+	
+	// interface
+	DTSError			Init( int numVoices, uint32_t outputRate );
+	DTSMixVoiceID		Play( const DTSMixSound& sound, float volume, float pan, int priority );
+	void				Stop( DTSMixVoiceID voice );
+	void				StopAll();
+	bool				IsPlaying( DTSMixVoiceID voice ) const;
+	int					CountPlaying() const;
+	void				Render( int16_t * out, size_t frames );
+	
+	// private interface
+private:
+	MixVoice *			FindVoice( DTSMixVoiceID voice ) const;
+	MixVoice *			ChooseVoice( int priority );
+	void				ReleaseVoice( MixVoice * voice );
+	void				RenderSlice( int16_t * out, size_t frames );
+	void				MixVoiceInto( MixVoice * voice, size_t frames );
+	
+	// no copying
+				DTSMixerPriv( const DTSMixerPriv& );
+	DTSMixerPriv&	operator=( const DTSMixerPriv& );
+};
+
+
+/*
+**	class MixLocker
+**	holds the mixer's lock for the life of the object
+*/
+class MixLocker
+{
+	pthread_mutex_t *	mLock;
+
+public:
+	explicit	MixLocker( pthread_mutex_t * lock ) : mLock( lock )
+					{
+					pthread_mutex_lock( mLock );
+					}
+				~MixLocker()
+					{
+					pthread_mutex_unlock( mLock );
+					}
+
+private:
+				MixLocker( const MixLocker& );
+	MixLocker&	operator=( const MixLocker& );
+};
+
+
+/*
+**	Internal Routines
+*/
+template <DTSMixSampleFormat F, int C>
+static bool		MixFrames( MixVoice * voice, int32_t * accum, size_t frames );
+static int32_t	FloatToGain( float value );
+
+
+/*
+**	DTSMixerPriv
+*/
+DTSDefineImplementFirmNoCopy(DTSMixerPriv)
+
+
+/*
+**	DTSMixerPriv::DTSMixerPriv()
+*/
+DTSMixerPriv::DTSMixerPriv() :
+	mixVoices( nullptr ),
+	mixNumVoices( 0 ),
+	mixOutputRate( 0 ),
+	mixMasterGain( kUnityGain ),
+	mixSerial( 0 ),
+	mixStolen( 0 ),
+	mixAccum( nullptr )
+{
+	pthread_mutex_init( &mixLock, nullptr );
+}
+
+
+/*
+**	DTSMixerPriv::~DTSMixerPriv()
+*/
+DTSMixerPriv::~DTSMixerPriv()
+{
+	StopAll();
+	
+	delete[] mixVoices;
+	delete[] mixAccum;
+	
+	pthread_mutex_destroy( &mixLock );
+}
+
+
+/*
+**	DTSMixer::Init()
+**
+**	set up the voice pool
+*/
+DTSError
+DTSMixer::Init( int numVoices, uint32_t outputRate )
+{
+	DTSMixerPriv * p = priv.p;
+	return p ? p->Init( numVoices, outputRate ) : -1;
+}
+
+
+/*
+**	DTSMixerPriv::Init()
+*/
+DTSError
+DTSMixerPriv::Init( int numVoices, uint32_t outputRate )
+{
+	if ( numVoices <= 0 || numVoices > kMixMaxVoices || 0 == outputRate )
+		return paramErr;
+	
+	// a re-Init() starts over from scratch
+	StopAll();
+	
+	MixLocker lock( &mixLock );
+	
+	delete[] mixVoices;
+	delete[] mixAccum;
+	mixNumVoices = 0;
+	
+	mixVoices = NEW_TAG("MixerVoices") MixVoice[ numVoices ];
+	mixAccum  = NEW_TAG("MixerAccum") int32_t[ 2 * kMixSliceFrames ];
+	if ( not mixVoices || not mixAccum )
+		return memFullErr;
+	
+	memset( mixVoices, 0, numVoices * sizeof *mixVoices );
+	mixNumVoices  = numVoices;
+	mixOutputRate = outputRate;
+	
+	return noErr;
+}
+
+
+/*
+**	DTSMixer::Play()
+**
+**	start a sound on a free (or stolen) voice.
+**	Volume runs from 0 to 1; pan from -1 (hard left) to +1 (hard right).
+*/
+DTSMixVoiceID
+DTSMixer::Play( const DTSMixSound& sound, float volume /* =1 */, float pan /* =0 */,
+				int priority /* =0 */ )
+{
+	DTSMixerPriv * p = priv.p;
+	return p ? p->Play( sound, volume, pan, priority ) : kMixNoVoice;
+}
+
+
+/*
+**	DTSMixerPriv::Play()
+**
+**	on failure the sound's release proc is not called; the caller still owns the samples.
+*/
+DTSMixVoiceID
+DTSMixerPriv::Play( const DTSMixSound& sound, float volume, float pan, int priority )
+{
+	// we only know how to play what 'snd ' resources hold
+	if ( not sound.msSamples || 0 == sound.msFrames || 0 == sound.msRate
+	||   sound.msChannels < 1 || sound.msChannels > 2
+	||   (kMixFormat8BitOffset != sound.msFormat && kMixFormat16BitBigEndian != sound.msFormat) )
+		{
+		return kMixNoVoice;
+		}
+	
+	// balance panning: the far side fades to nothing, the near side stays at full volume
+	if ( pan < -1.0F )
+		pan = -1.0F;
+	else
+	if ( pan > 1.0F )
+		pan = 1.0F;
+	float left  = pan > 0 ? 1.0F - pan : 1.0F;
+	float right = pan < 0 ? 1.0F + pan : 1.0F;
+	
+	MixLocker lock( &mixLock );
+	
+	MixVoice * voice = ChooseVoice( priority );
+	if ( not voice )
+		return kMixNoVoice;
+	
+	// IDs carry the slot in their low byte and a serial number above it, and are never
+	// zero. The serial wraps after 2^23 sounds, so a very stale ID could match again.
+	++mixSerial;
+	int slot = voice - mixVoices;
+	DTSMixVoiceID id = static_cast<DTSMixVoiceID>( ((mixSerial << 8) | slot) & 0x7FFFFFFF );
+	if ( kMixNoVoice == id )
+		id = static_cast<DTSMixVoiceID>( 1 << 8 | slot );
+	
+	voice->mvSound    = sound;
+	voice->mvPhase    = 0;
+	voice->mvStep     = static_cast<uint32_t>(
+							(static_cast<uint64_t>( sound.msRate ) << kPhaseShift) / mixOutputRate );
+	voice->mvGainL    = FloatToGain( volume * left );
+	voice->mvGainR    = FloatToGain( volume * right );
+	voice->mvPriority = priority;
+	voice->mvSerial   = mixSerial;
+	voice->mvID       = id;
+	
+	return id;
+}
+
+
+/*
+**	DTSMixerPriv::ChooseVoice()
+**
+**	a free voice if there is one; otherwise steal the least important and oldest,
+**	unless they're all more important than 'priority'.
+**	Call with the lock held.
+*/
+MixVoice *
+DTSMixerPriv::ChooseVoice( int priority )
+{
+	MixVoice * victim = nullptr;
+	
+	MixVoice * voice = mixVoices;
+	for ( int nnn = mixNumVoices;  nnn > 0;  --nnn, ++voice )
+		{
+		if ( kMixNoVoice == voice->mvID )
+			return voice;
+		
+		if ( not victim
+		||   voice->mvPriority < victim->mvPriority
+		||   (voice->mvPriority == victim->mvPriority && voice->mvSerial < victim->mvSerial) )
+			{
+			victim = voice;
+			}
+		}
+	
+	if ( victim && victim->mvPriority <= priority )
+		{
+		ReleaseVoice( victim );
+		++mixStolen;
+		return victim;
+		}
+	
+	return nullptr;
+}
+
+
+/*
+**	DTSMixerPriv::ReleaseVoice()
+**
+**	free up a voice slot, letting go of its samples.
+**	Call with the lock held.
+*/
+void
+DTSMixerPriv::ReleaseVoice( MixVoice * voice )
+{
+	if ( kMixNoVoice == voice->mvID )
+		return;
+	
+	voice->mvID = kMixNoVoice;
+	if ( DTSMixReleaseProc proc = voice->mvSound.msRelease )
+		proc( voice->mvSound.msRefCon );
+	voice->mvSound.msSamples = nullptr;
+}
+
+
+/*
+**	DTSMixerPriv::FindVoice()
+**
+**	the slot that's playing the given voice, if it still is.
+**	Call with the lock held.
+*/
+MixVoice *
+DTSMixerPriv::FindVoice( DTSMixVoiceID id ) const
+{
+	if ( kMixNoVoice == id )
+		return nullptr;
+	
+	int slot = id & 0xFF;
+	if ( slot >= mixNumVoices )
+		return nullptr;
+	
+	MixVoice * voice = &mixVoices[ slot ];
+	return id == voice->mvID ? voice : nullptr;
+}
+
+
+/*
+**	DTSMixer::Stop()
+**
+**	silence one voice. Harmless if it's already finished.
+*/
+void
+DTSMixer::Stop( DTSMixVoiceID voice )
+{
+	if ( DTSMixerPriv * p = priv.p )
+		p->Stop( voice );
+}
+
+
+/*
+**	DTSMixerPriv::Stop()
+*/
+void
+DTSMixerPriv::Stop( DTSMixVoiceID id )
+{
+	MixLocker lock( &mixLock );
+	
+	if ( MixVoice * voice = FindVoice( id ) )
+		ReleaseVoice( voice );
+}
+
+
+/*
+**	DTSMixer::StopAll()
+**
+**	silence every voice
+*/
+void
+DTSMixer::StopAll()
+{
+	if ( DTSMixerPriv * p = priv.p )
+		p->StopAll();
+}
+
+
+/*
+**	DTSMixerPriv::StopAll()
+*/
+void
+DTSMixerPriv::StopAll()
+{
+	MixLocker lock( &mixLock );
+	
+	MixVoice * voice = mixVoices;
+	for ( int nnn = mixNumVoices;  nnn > 0;  --nnn, ++voice )
+		ReleaseVoice( voice );
+}
+
+
+/*
+**	DTSMixer::IsPlaying()
+**
+**	is that voice still sounding?
+*/
+bool
+DTSMixer::IsPlaying( DTSMixVoiceID voice ) const
+{
+	const DTSMixerPriv * p = priv.p;
+	return p ? p->IsPlaying( voice ) : false;
+}
+
+
+/*
+**	DTSMixerPriv::IsPlaying()
+*/
+bool
+DTSMixerPriv::IsPlaying( DTSMixVoiceID id ) const
+{
+	MixLocker lock( &mixLock );
+	
+	return FindVoice( id ) != nullptr;
+}
+
+
+/*
+**	DTSMixer::CountPlaying()
+**
+**	how many voices are busy
+*/
+int
+DTSMixer::CountPlaying() const
+{
+	const DTSMixerPriv * p = priv.p;
+	return p ? p->CountPlaying() : 0;
+}
+
+
+/*
+**	DTSMixerPriv::CountPlaying()
+*/
+int
+DTSMixerPriv::CountPlaying() const
+{
+	MixLocker lock( &mixLock );
+	
+	int count = 0;
+	const MixVoice * voice = mixVoices;
+	for ( int nnn = mixNumVoices;  nnn > 0;  --nnn, ++voice )
+		{
+		if ( voice->mvID != kMixNoVoice )
+			++count;
+		}
+	
+	return count;
+}
+
+
+/*
+**	DTSMixer::SetVolume()
+**
+**	set the master volume, which applies to voices already playing too
+*/
+void
+DTSMixer::SetVolume( float volume )
+{
+	if ( DTSMixerPriv * p = priv.p )
+		p->mixMasterGain = FloatToGain( volume );
+}
+
+
+/*
+**	DTSMixer::GetOutputRate()
+*/
+uint32_t
+DTSMixer::GetOutputRate() const
+{
+	const DTSMixerPriv * p = priv.p;
+	return p ? p->mixOutputRate : 0;
+}
+
+
+/*
+**	DTSMixer::GetStolenCount()
+*/
+ulong
+DTSMixer::GetStolenCount() const
+{
+	const DTSMixerPriv * p = priv.p;
+	return p ? p->mixStolen : 0;
+}
+
+
+/*
+**	DTSMixer::Render()
+**
+**	produce the next 'frames' frames of output
+*/
+void
+DTSMixer::Render( int16_t * out, size_t frames )
+{
+	if ( DTSMixerPriv * p = priv.p )
+		p->Render( out, frames );
+	else
+		memset( out, 0, frames * 2 * sizeof *out );
+}
+
+
+/*
+**	DTSMixerPriv::Render()
+*/
+void
+DTSMixerPriv::Render( int16_t * out, size_t frames )
+{
+	MixLocker lock( &mixLock );
+	
+	if ( not mixAccum )
+		{
+		memset( out, 0, frames * 2 * sizeof *out );
+		return;
+		}
+	
+	while ( frames > 0 )
+		{
+		size_t slice = frames < kMixSliceFrames ? frames : kMixSliceFrames;
+		RenderSlice( out, slice );
+		
+		out    += 2 * slice;
+		frames -= slice;
+		}
+}
+
+
+/*
+**	DTSMixerPriv::RenderSlice()
+**
+**	sum every voice into the accumulator, then scale and clip into 'out'.
+**	Call with the lock held.
+*/
+void
+DTSMixerPriv::RenderSlice( int16_t * out, size_t frames )
+{
+	memset( mixAccum, 0, frames * 2 * sizeof *mixAccum );
+	
+	MixVoice * voice = mixVoices;
+	for ( int nnn = mixNumVoices;  nnn > 0;  --nnn, ++voice )
+		{
+		if ( voice->mvID != kMixNoVoice )
+			MixVoiceInto( voice, frames );
+		}
+	
+	const int32_t master = mixMasterGain;
+	const int32_t * accum = mixAccum;
+	for ( size_t nnn = 2 * frames;  nnn > 0;  --nnn )
+		{
+		// many loud voices can sum past what 32 bits can scale
+		int64_t sample = (static_cast<int64_t>( *accum++ ) * master) >> kGainShift;
+		if ( sample > 32767 )
+			sample = 32767;
+		else
+		if ( sample < -32768 )
+			sample = -32768;
+		*out++ = static_cast<int16_t>( sample );
+		}
+}
+
+
+/*
+**	DTSMixerPriv::MixVoiceInto()
+**
+**	dispatch to the right flavor of mixing loop; free the voice if it's finished.
+*/
+void
+DTSMixerPriv::MixVoiceInto( MixVoice * voice, size_t frames )
+{
+	bool bMore;
+	bool bStereo = (2 == voice->mvSound.msChannels);
+	if ( kMixFormat8BitOffset == voice->mvSound.msFormat )
+		{
+		bMore = bStereo ? MixFrames<kMixFormat8BitOffset, 2>( voice, mixAccum, frames )
+						: MixFrames<kMixFormat8BitOffset, 1>( voice, mixAccum, frames );
+		}
+	else
+		{
+		bMore = bStereo ? MixFrames<kMixFormat16BitBigEndian, 2>( voice, mixAccum, frames )
+						: MixFrames<kMixFormat16BitBigEndian, 1>( voice, mixAccum, frames );
+		}
+	
+	if ( not bMore )
+		ReleaseVoice( voice );
+}
+
+
+/*
+**	DTSMixer::RenderOffline()
+**
+**	mix the next 'seconds' of output into a newly-allocated buffer.
+**	The caller must eventually delete[] *oBuffer.
+*/
+DTSError
+DTSMixer::RenderOffline( double seconds, int16_t *& oBuffer, size_t * oFrames )
+{
+	oBuffer = nullptr;
+	if ( oFrames )
+		*oFrames = 0;
+	
+	DTSMixerPriv * p = priv.p;
+	if ( not p || not p->mixOutputRate || seconds < 0 )
+		return paramErr;
+	
+	size_t frames = static_cast<size_t>( seconds * p->mixOutputRate + 0.5 );
+	int16_t * buffer = NEW_TAG("MixerOffline") int16_t[ 2 * frames + 1 ];
+	if ( not buffer )
+		return memFullErr;
+	
+	p->Render( buffer, frames );
+	
+	oBuffer = buffer;
+	if ( oFrames )
+		*oFrames = frames;
+	
+	return noErr;
+}
+
+
+/*
+**	GetFrameSample()
+**
+**	fetch one channel of one frame, as a signed 16-bit value
+*/
+template <DTSMixSampleFormat F>
+static inline int32_t
+GetFrameSample( const uchar * frame, int channel )
+{
+	if ( kMixFormat8BitOffset == F )
+		return (static_cast<int32_t>( frame[ channel ] ) - 0x80) << 8;
+	
+	const uchar * p = frame + 2 * channel;
+	return static_cast<int16_t>( (p[0] << 8) | p[1] );
+}
+
+
+/*
+**	MixFrames()
+**
+**	resample one voice into the stereo accumulator, with linear interpolation.
+**	Mono sounds feed both sides; stereo ones keep their channels apart.
+**	Returns false once the sound has run out.
+*/
+template <DTSMixSampleFormat F, int C>
+bool
+MixFrames( MixVoice * voice, int32_t * accum, size_t frames )
+{
+	const size_t frameBytes = C * (kMixFormat8BitOffset == F ? 1 : 2);
+	const uchar * samples = voice->mvSound.msSamples;
+	const uint64_t lastFrame = voice->mvSound.msFrames - 1;
+	const uint64_t endPhase = static_cast<uint64_t>( voice->mvSound.msFrames ) << kPhaseShift;
+	const int32_t gainL = voice->mvGainL;
+	const int32_t gainR = voice->mvGainR;
+	const uint32_t step = voice->mvStep;
+	uint64_t phase = voice->mvPhase;
+	
+	for ( ;  frames > 0 && phase < endPhase;  --frames, phase += step )
+		{
+		uint64_t index = phase >> kPhaseShift;
+		int64_t frac = static_cast<int64_t>( phase & ((1 << kPhaseShift) - 1) );
+		const uchar * f0 = samples + index * frameBytes;
+		const uchar * f1 = index < lastFrame ? f0 + frameBytes : f0;
+		
+		int32_t s0 = GetFrameSample<F>( f0, 0 );
+		// the difference spans 17 bits and frac 16, too many for int32_t
+		int32_t left = s0 + static_cast<int32_t>(
+							((GetFrameSample<F>( f1, 0 ) - s0) * frac) >> kPhaseShift );
+		int32_t right = left;
+		if ( 2 == C )
+			{
+			s0 = GetFrameSample<F>( f0, 1 );
+			right = s0 + static_cast<int32_t>(
+							((GetFrameSample<F>( f1, 1 ) - s0) * frac) >> kPhaseShift );
+			}
+		
+		*accum++ += (left  * gainL) >> kGainShift;
+		*accum++ += (right * gainR) >> kGainShift;
+		}
+	
+	voice->mvPhase = phase;
+	return phase < endPhase;
+}
+
+
+/*
+**	FloatToGain()
+**
+**	0 .. 1 to fixed-point
+*/
+int32_t
+FloatToGain( float value )
+{
+	if ( value <= 0 )
+		return 0;
+	if ( value >= 1 )
+		return kUnityGain;
+	
+	return static_cast<int32_t>( value * kUnityGain + 0.5F );
+}
+
+
+#pragma mark -
+#pragma mark Benchmark
+
+/*
+**	struct BenchSound
+**	one of the synthetic sounds the benchmark plays
+*/
+struct BenchSound
+{
+	uint32_t			bsRate;
+	int					bsChannels;
+	DTSMixSampleFormat	bsFormat;
+	double				bsSeconds;
+	uchar *				bsSamples;
+	size_t				bsFrames;
+};
+
+
+/*
+**	struct BenchStart
+**	one sound CompareBenchMix() has started, as the reference mix sees it
+*/
+struct BenchStart
+{
+	const BenchSound *	stSound;
+	size_t				stStart;		// first output frame
+	uint32_t			stStep;			// the mixer's fixed-point rate ratio
+	double				stGainL;
+	double				stGainR;
+};
+
+
+/*
+**	MakeBenchSound()
+**
+**	fill in a noisy, decaying tone -- roughly a sword hit -- in the given format
+*/
+static DTSError
+MakeBenchSound( BenchSound * bs, uint32_t seed )
+{
+	bs->bsFrames = static_cast<size_t>( bs->bsSeconds * bs->bsRate );
+	size_t sampleBytes = kMixFormat8BitOffset == bs->bsFormat ? 1 : 2;
+	size_t len = bs->bsFrames * bs->bsChannels * sampleBytes;
+	bs->bsSamples = NEW_TAG("MixerBenchSound") uchar[ len ];
+	if ( not bs->bsSamples )
+		return memFullErr;
+	
+	uchar * p = bs->bsSamples;
+	for ( size_t ii = 0; ii < bs->bsFrames; ++ii )
+		{
+		for ( int ch = 0; ch < bs->bsChannels; ++ch )
+			{
+			seed = seed * 1103515245 + 12345;
+			int32_t noise = static_cast<int32_t>( (seed >> 16) & 0x7FFF ) - 0x4000;
+			int32_t tone = (ii / 20 & 1) ? 0x3000 : -0x3000;
+			int32_t sample = (noise + tone) * static_cast<int32_t>( bs->bsFrames - ii )
+								/ static_cast<int32_t>( bs->bsFrames );
+			
+			if ( 1 == sampleBytes )
+				*p++ = static_cast<uchar>( (sample >> 8) + 0x80 );
+			else
+				{
+				*p++ = static_cast<uchar>( sample >> 8 );
+				*p++ = static_cast<uchar>( sample );
+				}
+			}
+		}
+	
+	return noErr;
+}
+
+
+/*
+**	BenchSample()
+**
+**	one channel of one frame of a benchmark sound, as a signed 16-bit value
+*/
+static double
+BenchSample( const BenchSound& bs, size_t frame, int channel )
+{
+	if ( 1 == bs.bsChannels )
+		channel = 0;
+	
+	if ( kMixFormat8BitOffset == bs.bsFormat )
+		return ( bs.bsSamples[ frame * bs.bsChannels + channel ] - 0x80 ) * 256.0;
+	
+	const uchar * p = bs.bsSamples + 2 * ( frame * bs.bsChannels + channel );
+	return static_cast<int16_t>( (p[0] << 8) | p[1] );
+}
+
+
+/*
+**	CompareBenchMix()
+**
+**	mix a few of the benchmark sounds with the real mixer, and again the slow and
+**	obvious way, in floating point, one output sample at a time; count the samples
+**	that disagree by more than the mixer's fixed-point truncation can explain.
+**	There are never more sounds than voices, so nothing is stolen and the two
+**	should hear exactly the same scene.
+*/
+static DTSError
+CompareBenchMix( const BenchSound * sounds, int numSounds, int numVoices,
+				 uint32_t outputRate, int * oMismatches )
+{
+	*oMismatches = 0;
+	
+	// start one sound at the top of each of the first numVoices buffers,
+	// then keep going until the last of them must have finished
+	const size_t kBufferFrames = 512;
+	const size_t numBuffers = numVoices + 2 * outputRate / kBufferFrames;
+	
+	BenchStart * started = NEW_TAG("MixerBenchCheck") BenchStart[ numVoices ];
+	int16_t * buffer = NEW_TAG("MixerBenchOutput") int16_t[ 2 * kBufferFrames ];
+	
+	DTSMixer mixer;
+	DTSError result = noErr;
+	if ( not started || not buffer )
+		result = memFullErr;
+	if ( noErr == result )
+		result = mixer.Init( numVoices, outputRate );
+	
+	int numStarted = 0;
+	uint32_t seed = 7;
+	for ( size_t buf = 0;  buf < numBuffers && noErr == result;  ++buf )
+		{
+		if ( numStarted < numVoices )
+			{
+			seed = seed * 1103515245 + 12345;
+			const BenchSound& bs = sounds[ (seed >> 16) % numSounds ];
+			float volume = static_cast<int>( (seed >> 4) % 101 ) / 100.0F;
+			float pan = static_cast<int>( (seed >> 8) % 201 - 100 ) / 100.0F;
+			
+			DTSMixSound snd;
+			snd.msSamples  = bs.bsSamples;
+			snd.msFrames   = bs.bsFrames;
+			snd.msRate     = bs.bsRate;
+			snd.msChannels = bs.bsChannels;
+			snd.msFormat   = bs.bsFormat;
+			snd.msRelease  = nullptr;
+			snd.msRefCon   = nullptr;
+			if ( kMixNoVoice == mixer.Play( snd, volume, pan ) )
+				{
+				result = -1;
+				break;
+				}
+			
+			// the same balance pan and fixed-point gains that Play() promises
+			BenchStart& st = started[ numStarted++ ];
+			st.stSound = &bs;
+			st.stStart = buf * kBufferFrames;
+			st.stStep  = static_cast<uint32_t>(
+							(static_cast<uint64_t>( bs.bsRate ) << kPhaseShift) / outputRate );
+			st.stGainL = FloatToGain( volume * (pan > 0 ? 1.0F - pan : 1.0F) )
+							/ double( kUnityGain );
+			st.stGainR = FloatToGain( volume * (pan < 0 ? 1.0F + pan : 1.0F) )
+							/ double( kUnityGain );
+			}
+		
+		mixer.Render( buffer, kBufferFrames );
+		
+		const int16_t * out = buffer;
+		for ( size_t ff = 0;  ff < kBufferFrames;  ++ff, out += 2 )
+			{
+			size_t frame = buf * kBufferFrames + ff;
+			double left = 0;
+			double right = 0;
+			int sounding = 0;
+			for ( int nn = 0;  nn < numStarted;  ++nn )
+				{
+				const BenchStart& st = started[ nn ];
+				const BenchSound& bs = *st.stSound;
+				uint64_t phase = static_cast<uint64_t>( frame - st.stStart ) * st.stStep;
+				size_t index = static_cast<size_t>( phase >> kPhaseShift );
+				if ( index >= bs.bsFrames )
+					continue;
+				
+				size_t next = index + 1 < bs.bsFrames ? index + 1 : index;
+				double frac = ( phase & ((1 << kPhaseShift) - 1) ) / double( 1 << kPhaseShift );
+				for ( int ch = 0;  ch < 2;  ++ch )
+					{
+					double s0 = BenchSample( bs, index, ch );
+					double s1 = BenchSample( bs, next, ch );
+					double s = ( s0 + (s1 - s0) * frac ) * ( ch ? st.stGainR : st.stGainL );
+					if ( ch )
+						right += s;
+					else
+						left += s;
+					}
+				++sounding;
+				}
+			
+			// each voice can lose just under 2 in its two truncating shifts
+			double slop = 2.0 * sounding + 1.0;
+			if ( left > 32767 )
+				left = 32767;
+			else
+			if ( left < -32768 )
+				left = -32768;
+			if ( right > 32767 )
+				right = 32767;
+			else
+			if ( right < -32768 )
+				right = -32768;
+			if ( out[0] - left > slop || left - out[0] > slop )
+				++*oMismatches;
+			if ( out[1] - right > slop || right - out[1] > slop )
+				++*oMismatches;
+			}
+		}
+	
+	mixer.StopAll();
+	delete[] started;
+	delete[] buffer;
+	
+	return result;
+}
+
+
+/*
+**	DTSMixerBenchmark()
+**
+**	see Mixer_dts.h
+*/
+DTSError
+DTSMixerBenchmark( int numVoices, double seconds, DTSMixBenchmarkResult * oResult )
+{
+	__Check( oResult );
+	if ( not oResult || seconds <= 0 )
+		return paramErr;
+	memset( oResult, 0, sizeof *oResult );
+	
+	// the sort of thing CL_Sounds holds: mostly 8-bit mono at odd old Mac rates
+	BenchSound sounds[] =
+		{
+			{ 22254, 1, kMixFormat8BitOffset,		0.35 },
+			{ 11127, 1, kMixFormat8BitOffset,		0.60 },
+			{ 22050, 1, kMixFormat16BitBigEndian,	1.20 },
+			{ 44100, 2, kMixFormat16BitBigEndian,	0.80 },
+		};
+	const int kNumSounds = sizeof sounds / sizeof sounds[0];
+	
+	DTSError result = noErr;
+	for ( int ii = 0; ii < kNumSounds && noErr == result; ++ii )
+		result = MakeBenchSound( &sounds[ ii ], 17 + ii );
+	
+	const uint32_t kOutputRate = 44100;
+	DTSMixer mixer;
+	if ( noErr == result )
+		result = mixer.Init( numVoices, kOutputRate );
+	
+	// render in 512-frame buffers, as a real output device might ask for,
+	// starting three new sounds before each one
+	const size_t kBufferFrames = 512;
+	const int kSoundsPerBuffer = 3;
+	int16_t * buffer = nullptr;
+	if ( noErr == result )
+		{
+		buffer = NEW_TAG("MixerBenchOutput") int16_t[ 2 * kBufferFrames ];
+		if ( not buffer )
+			result = memFullErr;
+		}
+	
+	if ( noErr == result )
+		{
+		size_t totalFrames = static_cast<size_t>( seconds * kOutputRate );
+		ulong plays = 0;
+		uint32_t seed = 1;
+		
+		clock_t start = clock();
+		for ( size_t done = 0; done < totalFrames; done += kBufferFrames )
+			{
+			for ( int nn = 0; nn < kSoundsPerBuffer; ++nn )
+				{
+				seed = seed * 1103515245 + 12345;
+				const BenchSound& bs = sounds[ (seed >> 16) % kNumSounds ];
+				
+				DTSMixSound snd;
+				snd.msSamples  = bs.bsSamples;
+				snd.msFrames   = bs.bsFrames;
+				snd.msRate     = bs.bsRate;
+				snd.msChannels = bs.bsChannels;
+				snd.msFormat   = bs.bsFormat;
+				snd.msRelease  = nullptr;
+				snd.msRefCon   = nullptr;
+				
+				float pan = static_cast<int>( (seed >> 8) % 201 - 100 ) / 100.0F;
+				if ( mixer.Play( snd, 0.5F, pan ) != kMixNoVoice )
+					++plays;
+				}
+			
+			mixer.Render( buffer, kBufferFrames );
+			}
+		clock_t stop = clock();
+		
+		oResult->mbVoices         = numVoices;
+		oResult->mbAudioSeconds   = static_cast<double>( totalFrames ) / kOutputRate;
+		oResult->mbCPUSeconds     = static_cast<double>( stop - start ) / CLOCKS_PER_SEC;
+		oResult->mbRealtimeFactor = oResult->mbCPUSeconds > 0
+									? oResult->mbAudioSeconds / oResult->mbCPUSeconds : 0;
+		oResult->mbPlayCalls      = plays;
+		oResult->mbSteals         = mixer.GetStolenCount();
+		}
+	
+	// then make sure all that speed didn't cost anything
+	if ( noErr == result )
+		result = CompareBenchMix( sounds, kNumSounds, numVoices, kOutputRate,
+					&oResult->mbMismatches );
+	
+	// the mixer must let go of the samples before we free them
+	mixer.StopAll();
+	
+	delete[] buffer;
+	for ( int ii = 0; ii < kNumSounds; ++ii )
+		delete[] sounds[ ii ].bsSamples;
+	
+	return result;
+}
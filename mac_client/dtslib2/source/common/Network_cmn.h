@@ -61,6 +61,17 @@ DTSError	DTSNetUSendMulti( DTSEndPoint ep, DTSNetAddress& toaddr,
 							const void * d2, size_t s2 );
 #endif	// SEND_MULTI
 
+// for the client's receive thread
+struct DTSNetDatagram
+{
+	void *			dgData;
+	size_t			dgSize;			// in: room in dgData; out: bytes received
+	DTSNetAddress	dgFrom;
+};
+double		DTSNetTimestamp();			// seconds, monotonic, arbitrary origin
+DTSError	DTSNetWaitForData( const DTSEndPoint * eps, bool * oReady, int count, int msTimeout );
+DTSError	DTSNetUReceiveBatch( DTSEndPoint ep, DTSNetDatagram * grams, int count, int * oCount );
+
 #if RCV_MULTI
 // and corresponding reads (not yet implemented)
 DTSError	DTSNetRcvMulti( DTSEndPoint ep, void * d1, size_t * s1, void * d2, size_t * s2 );
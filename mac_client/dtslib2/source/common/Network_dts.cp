@@ -20,6 +20,9 @@
 # include "Prefix_dts.h"
 #endif
 
+#include <pthread.h>
+#include <unistd.h>
+
 #include "LinkedList_dts.h"
 #include "Memory_dts.h"
 #include "Network_dts.h"
@@ -209,6 +212,73 @@ public:
 };
 
 
+/*
+**	class DTSNetReceiver
+**
+**	[client] the receive thread, and the single-producer/single-consumer ring through
+**	which it hands messages to Read(). The thread fills slots at rxHead and Read()
+**	empties them at rxTail; each only ever advances its own index, and only after
+**	the slot is ready, so no lock is needed.
+*/
+struct DTSNetFrame
+{
+	uchar *				nfData;			// UDP messages still have their length prefix...
+	size_t				nfOffset;		// ... so the payload starts here
+	size_t				nfSize;			// of the payload
+	double				nfArrival;		// DTSNetTimestamp() when it was read
+	DTSError			nfResult;		// noErr, or why the thread gave up
+};
+
+class DTSNetReceiver
+{
+public:
+	enum
+		{
+		kRingSize		= 64,
+		kMaxBatch		= 16,			// datagrams per DTSNetUReceiveBatch()
+		kWaitMS			= 50			// how often the thread checks rxQuit
+		};
+	
+	DTSNetChannelPriv *	rxChannel;
+	DTSNetFrame			rxRing[ kRingSize ];
+	size_t				rxMaxMsgSize;
+	volatile uint32_t	rxHead;			// next slot for the thread to fill
+	volatile uint32_t	rxTail;			// next slot for Read() to empty
+	volatile bool		rxQuit;
+	bool				rxRunning;
+	pthread_t			rxThread;
+	DTSNetReceiveStats	rxStats;
+	
+	// constructor/destructor
+	explicit	DTSNetReceiver( DTSNetChannelPriv * channel );
+				~DTSNetReceiver();
+	
+	// interface
+	DTSError	Start( size_t maxMsgSize );
+	void		Stop();
+	DTSError	Read( void * data, size_t * sz );
+
+private:
+	// declared but not defined
+				DTSNetReceiver( const DTSNetReceiver& );
+	DTSNetReceiver&
+				operator=( const DTSNetReceiver& );
+	
+	static void *	ThreadProc( void * refCon );
+	void		Run();
+	DTSError	ReadTCP();
+	DTSError	ReadUDP();
+	void		PublishError( DTSError err );
+	int			Room() const	{ return kRingSize - int( rxHead - rxTail ); }
+	DTSNetFrame& Slot( uint32_t index )	{ return rxRing[ index % kRingSize ]; }
+	void		Publish( int count )
+					{
+					__sync_synchronize();	// the slots are filled before the index moves
+					rxHead += count;
+					}
+};
+
+
 /*
 **	DTSNetChannelPriv
 */
@@ -222,6 +292,7 @@ public:
 	DTSNetAddress		netDstAddr;
 	PartialPacket		netTCPPacket;
 	PartialPacketUDP	netUDPPacket;
+	DTSNetReceiver *	netReceiver;		// [client] nullptr unless there's a receive thread
 	DTSEndPoint			netTCP;
 	DTSEndPoint			netUDP;
 	int					netHostMax;			// size (log2) of hash table
@@ -237,6 +308,7 @@ public:
 					netDstAddr(),
 					netTCPPacket(),
 					netUDPPacket(),
+					netReceiver(),
 					netTCP( kClosedEndPoint ),
 					netUDP( kClosedEndPoint ),
 					netHostMax(),
@@ -425,6 +497,10 @@ DTSNetChannel::Close()
 void
 DTSNetChannelPriv::Close()
 {
+	// the receive thread must be gone before the endpoints are
+	delete netReceiver;
+	netReceiver = nullptr;
+	
 	RemoveFromHash();
 	DTSNetClose( netTCP );
 	DTSNetClose( netUDP );
@@ -1398,6 +1474,15 @@ DTSNetChannel::Read( void * data, size_t * psize )
 	// clear UDP packets from the host channel (no-op on client)
 	p->HandleHostQueue();
 	
+	// if the receive thread is running, it has already done the reading
+	if ( DTSNetReceiver * rx = p->netReceiver )
+		{
+		DTSError result = rx->Read( data, psize );
+		if ( kNetworkDisconnect == result )
+			p->netConnected = false;
+		return result;
+		}
+	
 	// read from the reliable TCP endpoint
 	size_t maxtoread = *psize;
 	DTSError result = p->netTCPPacket.ReadData( p->netTCP, data, psize );
@@ -1754,6 +1839,387 @@ DTSNetAddress::ToString( char * dst, size_t dstLen ) const
 }
 
 
+#pragma mark --- Receive Thread ---
+
+/*
+**	DTSNetChannel::StartReceiveThread()
+**
+**	[client]
+**	spin up a thread to do all the reading, as soon as anything arrives
+*/
+DTSError
+DTSNetChannel::StartReceiveThread( size_t maxMsgSize )
+{
+	DTSNetChannelPriv * p = priv.p;
+	if ( not p )
+		return -1;
+	
+	// already running?
+	if ( p->netReceiver )
+		return noErr;
+	
+	// clients only, and only once they're connected
+	if ( not p->netConnected
+	||   not IsEndPointOpen( p->netTCP )
+	||   not IsEndPointOpen( p->netUDP ) )
+		{
+		return kNetworkDisconnect;
+		}
+	
+	DTSNetReceiver * rx = NEW_TAG("DTSNetReceiver") DTSNetReceiver( p );
+	if ( not rx )
+		return memFullErr;
+	
+	DTSError result = rx->Start( maxMsgSize );
+	if ( noErr == result )
+		p->netReceiver = rx;
+	else
+		delete rx;
+	
+	return result;
+}
+
+
+/*
+**	DTSNetChannel::StopReceiveThread()
+**
+**	[client]
+**	go back to reading from the endpoints in Read(). Anything still queued is lost.
+*/
+void
+DTSNetChannel::StopReceiveThread()
+{
+	if ( DTSNetChannelPriv * p = priv.p )
+		{
+		delete p->netReceiver;
+		p->netReceiver = nullptr;
+		}
+}
+
+
+/*
+**	DTSNetChannel::GetReceiveStats()
+**
+**	[client]
+**	a snapshot of the receive thread's statistics; all zeroes if there isn't one
+*/
+void
+DTSNetChannel::GetReceiveStats( DTSNetReceiveStats * oStats ) const
+{
+	const DTSNetChannelPriv * p = priv.p;
+	if ( p && p->netReceiver )
+		*oStats = p->netReceiver->rxStats;
+	else
+		memset( oStats, 0, sizeof *oStats );
+}
+
+
+/*
+**	DTSNetReceiver::DTSNetReceiver()
+*/
+DTSNetReceiver::DTSNetReceiver( DTSNetChannelPriv * channel ) :
+	rxChannel( channel ),
+	rxMaxMsgSize( 0 ),
+	rxHead( 0 ),
+	rxTail( 0 ),
+	rxQuit( false ),
+	rxRunning( false ),
+	rxThread()
+{
+	memset( rxRing, 0, sizeof rxRing );
+	memset( &rxStats, 0, sizeof rxStats );
+}
+
+
+/*
+**	DTSNetReceiver::~DTSNetReceiver()
+*/
+DTSNetReceiver::~DTSNetReceiver()
+{
+	Stop();
+	
+	for ( int i = 0; i < kRingSize; ++i )
+		delete[] rxRing[ i ].nfData;
+}
+
+
+/*
+**	DTSNetReceiver::Start()
+**
+**	allocate the ring and start the thread
+*/
+DTSError
+DTSNetReceiver::Start( size_t maxMsgSize )
+{
+	rxMaxMsgSize = maxMsgSize;
+	
+	// room for the whole datagram, length prefix and all
+	for ( int i = 0; i < kRingSize; ++i )
+		{
+		rxRing[ i ].nfData = NEW_TAG("DTSNetFrame") uchar[ maxMsgSize + sizeof(uint16_t) ];
+		if ( not rxRing[ i ].nfData )
+			return memFullErr;
+		}
+	
+	rxQuit = false;
+	int err = pthread_create( &rxThread, nullptr, ThreadProc, this );
+	__Check( 0 == err );
+	if ( err )
+		return -1;
+	
+	rxRunning = true;
+	return noErr;
+}
+
+
+/*
+**	DTSNetReceiver::Stop()
+**
+**	ask the thread to quit, and wait till it has
+*/
+void
+DTSNetReceiver::Stop()
+{
+	if ( rxRunning )
+		{
+		rxQuit = true;
+		__Verify( 0 == pthread_join( rxThread, nullptr ) );
+		rxRunning = false;
+		}
+}
+
+
+/*
+**	DTSNetReceiver::ThreadProc()
+*/
+void *
+DTSNetReceiver::ThreadProc( void * refCon )
+{
+	static_cast<DTSNetReceiver *>( refCon )->Run();
+	return nullptr;
+}
+
+
+/*
+**	DTSNetReceiver::Run()
+**
+**	the thread itself: sleep until either endpoint is readable, then drain them both
+*/
+void
+DTSNetReceiver::Run()
+{
+	DTSNetChannelPriv * p = rxChannel;
+	
+	while ( not rxQuit )
+		{
+		// if the game loop has fallen behind, leave things in the socket for now
+		if ( 0 == Room() )
+			{
+			++rxStats.rsStalls;
+			usleep( 1000 );
+			continue;
+			}
+		
+		DTSEndPoint eps[ 2 ] = { p->netTCP, p->netUDP };
+		bool ready[ 2 ];
+		DTSError result = DTSNetWaitForData( eps, ready, 2, kWaitMS );
+		if ( kNetworkNoData == result )
+			continue;
+		
+		uint32_t before = rxHead;
+		if ( noErr == result && ready[ 0 ] )
+			result = ReadTCP();
+		if ( noErr == result && ready[ 1 ] )
+			result = ReadUDP();
+		
+		ulong batch = rxHead - before;
+		++rxStats.rsWakeups;
+		if ( batch > rxStats.rsLargestBatch )
+			rxStats.rsLargestBatch = batch;
+		
+		if ( result < noErr )
+			{
+			PublishError( result );
+			break;
+			}
+		}
+}
+
+
+/*
+**	DTSNetReceiver::ReadTCP()
+**
+**	queue every complete message waiting on the stream
+*/
+DTSError
+DTSNetReceiver::ReadTCP()
+{
+	DTSNetChannelPriv * p = rxChannel;
+	
+	while ( Room() > 0 )
+		{
+		DTSNetFrame& frame = Slot( rxHead );
+		size_t sz = rxMaxMsgSize;
+		DTSError result = p->netTCPPacket.ReadData( p->netTCP, frame.nfData, &sz );
+		if ( kNetworkNoData == result )
+			break;
+		if ( result < noErr )
+			return result;
+		if ( result > noErr )		// a handshake tag
+			continue;
+		
+		frame.nfOffset	= 0;
+		frame.nfSize	= sz;
+		frame.nfArrival	= DTSNetTimestamp();
+		frame.nfResult	= noErr;
+		Publish( 1 );
+		}
+	
+	return noErr;
+}
+
+
+/*
+**	DTSNetReceiver::ReadUDP()
+**
+**	queue a batch of datagrams, discarding the same ones PartialPacketUDP would
+*/
+DTSError
+DTSNetReceiver::ReadUDP()
+{
+	DTSNetChannelPriv * p = rxChannel;
+	
+	int room = Room();
+	if ( room > kMaxBatch )
+		room = kMaxBatch;
+	
+	DTSNetDatagram grams[ kMaxBatch ];
+	uint32_t head = rxHead;
+	for ( int i = 0; i < room; ++i )
+		{
+		grams[ i ].dgData = Slot( head + i ).nfData;
+		grams[ i ].dgSize = rxMaxMsgSize + sizeof(uint16_t);
+		}
+	
+	int count = 0;
+	DTSError result = DTSNetUReceiveBatch( p->netUDP, grams, room, &count );
+	double now = DTSNetTimestamp();
+	
+	int kept = 0;
+	for ( int i = 0; i < count; ++i )
+		{
+		const DTSNetDatagram& dg = grams[ i ];
+		const uchar * data = static_cast<const uchar *>( dg.dgData );
+		
+		// handshakes, runts, truncations, and strangers
+		if ( dg.dgSize < sizeof(uint16_t) )
+			continue;
+		uint16_t len = static_cast<uint16_t>( (data[0] << 8) + data[1] );
+		if ( kHandshakeTag == len
+		||   len + sizeof len != dg.dgSize )
+			{
+			continue;
+			}
+		if ( AF_INET == p->netDstAddr.Family()
+		&&   not ( dg.dgFrom == p->netDstAddr ) )
+			{
+			continue;
+			}
+		
+		// close up any gap left by a discard
+		DTSNetFrame& frame = Slot( head + kept );
+		if ( i != kept )
+			{
+			DTSNetFrame& from = Slot( head + i );
+			uchar * swap	= frame.nfData;
+			frame.nfData	= from.nfData;
+			from.nfData		= swap;
+			}
+		
+		frame.nfOffset	= sizeof len;
+		frame.nfSize	= len;
+		frame.nfArrival	= now;
+		frame.nfResult	= noErr;
+		++kept;
+		}
+	Publish( kept );
+	
+	if ( kNetworkNoData == result )
+		result = noErr;
+	return result;
+}
+
+
+/*
+**	DTSNetReceiver::PublishError()
+**
+**	tell Read() why we're giving up
+*/
+void
+DTSNetReceiver::PublishError( DTSError err )
+{
+	while ( 0 == Room() && not rxQuit )
+		usleep( 1000 );
+	if ( rxQuit )
+		return;
+	
+	DTSNetFrame& frame = Slot( rxHead );
+	frame.nfOffset	= 0;
+	frame.nfSize	= 0;
+	frame.nfArrival	= DTSNetTimestamp();
+	frame.nfResult	= err;
+	Publish( 1 );
+}
+
+
+/*
+**	DTSNetReceiver::Read()
+**
+**	[game thread]
+**	take the oldest message off the ring, and note how long it waited there
+*/
+DTSError
+DTSNetReceiver::Read( void * data, size_t * sz )
+{
+	uint32_t tail = rxTail;
+	if ( tail == rxHead )
+		{
+		*sz = 0;
+		return kNetworkNoData;
+		}
+	__sync_synchronize();		// see the slot as the thread left it
+	
+	const DTSNetFrame& frame = Slot( tail );
+	DTSError result = frame.nfResult;
+	
+	// an error stays at the head of the ring, for every later Read() to see
+	if ( noErr != result )
+		{
+		*sz = 0;
+		return result;
+		}
+	
+	size_t numread = frame.nfSize;
+	if ( numread > *sz )
+		numread = *sz;
+	memcpy( data, frame.nfData + frame.nfOffset, numread );
+	*sz = numread;
+	
+	double delay = DTSNetTimestamp() - frame.nfArrival;
+	rxStats.rsLastDelay = delay;
+	rxStats.rsMeanDelay += (delay - rxStats.rsMeanDelay) / 16;
+	if ( delay > rxStats.rsMaxDelay )
+		rxStats.rsMaxDelay = delay;
+	++rxStats.rsMessages;
+	rxStats.rsBytes += numread;
+	
+	__sync_synchronize();		// done with the slot before the thread may reuse it
+	rxTail = tail + 1;
+	
+	return noErr;
+}
+
+
 #pragma mark --- More Server Bits ---
 
 /*
@@ -45,7 +45,15 @@
 
 // Finally: if building with Xcode, then these custom allocators cause untold pain.
 
-#if (defined( DTS_Unix ) || defined( DTS_XCODE ) || TARGET_API_MAC_OSX ) && ! defined( DEBUG_VERSION_TAGS )
+// ... except that the allocation profiler (DTS_ALLOC_PROFILE) needs to see every new
+// and delete, so that it can charge each block to its NEW_TAG. In that case all of
+// these operators are still vectored through NewAlloc() and NewFree(), but those are
+// supplied by AllocProfile_dts.cp, which is a thin layer over plain malloc().
+
+#include "Memory_dts.h"
+
+#if (defined( DTS_Unix ) || defined( DTS_XCODE ) || TARGET_API_MAC_OSX ) \
+	&& ! defined( DEBUG_VERSION_TAGS ) && ! DTS_ALLOC_PROFILE
 # define DONT_USE_DTS_ALLOC		1
 #else
 # define DONT_USE_DTS_ALLOC		0
@@ -99,10 +107,10 @@ static void		DeleteTagFunc( void * ptr ) DOES_NOT_THROW;
 /*
 **	External routines
 **
-**	imported from Memory_dts.cp; we do NOT want these
+**	imported from Memory_dts.cp (or AllocProfile_dts.cp); we do NOT want these
 **	exposed in any external header.
 */
-#ifdef DEBUG_VERSION_TAGS
+#if DTS_NEW_TAGGED
 void *	NewAlloc( size_t size, const char * tagString ) DOES_NOT_THROW;
 #else
 void *	NewAlloc( size_t size ) DOES_NOT_THROW;
@@ -115,7 +123,7 @@ void	NewFree( void * ptr ) DOES_NOT_THROW;
 **
 **	called by operator new() to deal with new_handler issues.
 */
-#ifndef DEBUG_VERSION_TAGS
+#if ! DTS_NEW_TAGGED
 void *
 NewTagFunc( size_t size, const NewTag * ) DOES_NOT_THROW
 #else
@@ -126,7 +134,7 @@ NewTagFunc( size_t size, const NewTag * tagString ) DOES_NOT_THROW
 	void * ptr;
 	for (;;)
 		{
-#ifndef DEBUG_VERSION_TAGS
+#if ! DTS_NEW_TAGGED
 		ptr = NewAlloc( size );
 #else
 		ptr = NewAlloc( size, (const char *) tagString );
@@ -267,7 +275,7 @@ operator delete[]( void * ptr, std::size_t /* sz */ ) DOES_NOT_THROW
 }
 
 
-#ifdef DEBUG_VERSION_TAGS
+#if DTS_NEW_TAGGED
 /*
 **	operator new() -- NewTag version
 */
@@ -286,7 +294,7 @@ operator new[]( size_t size, const NewTag * tagString ) DOES_NOT_THROW
 {
 	return NewTagFunc( size, tagString );
 }
-#endif	// DEBUG_VERSION_TAGS
+#endif	// DTS_NEW_TAGGED
 
 #endif	// ! DONT_USE_DTS_ALLOC
 
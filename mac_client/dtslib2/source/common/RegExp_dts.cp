@@ -127,13 +127,20 @@ A special sequence, like \< or \> can be made into a literal character by droppi
  * mRegstart	char that must begin a match; '\0' if none obvious
  * mReganch		is the match anchored (at beginning-of-line only)?
  * mRegmust		string (pointer into mProgram) that match must include, or NULL
+ * mRegprefix	string that an anchored match must begin with, or NULL
  *
  * mRegstart and mReganch permit very fast decisions on suitable starting points
- * for a match, cutting down the work a lot.  mRegmust permits fast rejection
- * of lines that cannot possibly match.  The mRegmust tests are costly enough
- * that regcomp() supplies a mRegmust only if the r.e. contains something
- * potentially expensive (at present, the only such thing detected is * or +
- * at the start of the r.e., which can involve a lot of backup).
+ * for a match, cutting down the work a lot.  mRegmust and mRegprefix permit fast
+ * rejection of lines that cannot possibly match.  Spencer only supplied a mRegmust
+ * if the r.e. started with * or +, because strstr() was costly; FindLiteral()
+ * leaves the scanning to memchr(), which every libc we use vectorizes, so now
+ * any r.e. with a literal in its top-level sequence gets one.
+ *
+ * Most lines don't match, and finding that out by backtracking can take a while.
+ * So, unless the r.e. uses \< or \>, we also build a DFA from the program
+ * (see CHSRegExpDFA, below), and regexec() asks it first whether there's a match
+ * at all, and if so where the leftmost one starts. Only then does the original
+ * matcher run -- once, at that spot -- to fill in mStartPtrs and mEndPtrs.
  */
 
 /*
@@ -229,6 +236,94 @@ A special sequence, like \< or \> can be made into a literal character by droppi
 #define	WORST		0	/* Worst case. */
 
 
+/* **********************************************************************
+*****	CHSRegExpDFA - a DFA for a compiled program, built as it's	*****
+*****	used															*****
+*****																*****
+*****	Each DFA state stands for the set of places the program		*****
+*****	could have got to, having read the text so far; reading one	*****
+*****	more character takes every one of those places one step		*****
+*****	further at once, so there's never any backing up. States	*****
+*****	and the transitions between them are only worked out the	*****
+*****	first time they're needed, and then remembered. If there	*****
+*****	get to be too many, we forget them all and start over; if	*****
+*****	that keeps happening, we give up and let the caller			*****
+*****	backtrack after all.										*****
+*****																*****
+*****	A "floating" DFA restarts the program at every character,	*****
+*****	so it finds matches that start anywhere.					*****
+*****																*****
+*****	A place in the program is a node offset, in the low 16		*****
+*****	bits, plus (in the high bits) how far into an EXACTLY		*****
+*****	string we've got, or 1 for a PLUS that has matched once.	*****
+************************************************************************/
+class CHSRegExpDFA
+{
+public:
+	enum { kNoMatch, kMatch, kGaveUp };
+	
+				CHSRegExpDFA( const char * program, int progSize, bool floating );
+				~CHSRegExpDFA();
+	
+	static bool	CanRun( const char * program );
+	int			Search( const char * text, size_t len, bool atBOL, const char ** oEnd );
+
+private:
+	enum
+		{
+		kMaxStates	= 256,
+		kMaxResets	= 8,		// per Search()
+		
+		kAtBOL		= 1,		// flags for Add()
+		kAtEOS		= 2
+		};
+	
+	struct SState
+		{
+		int *		mPos;			// places in the program, sorted
+		int			mCount;
+		bool		mMatch;			// one of them is END
+		short		mNext[ 256 ];	// state after each character; -1 = not yet known
+		};
+	
+	const char *	mProgram;
+	int				mProgSize;
+	bool			mFloating;
+	SState *		mStates[ kMaxStates ];
+	int				mNumStates;
+	short			mStart[ 2 ];	// not at BOL, at BOL; -1 = not yet known
+	int				mResets;
+	
+	// scratch, for the state being built
+	int *			mWork;
+	int				mWorkCount;
+	uint *			mMark;			// per program byte: mGeneration when added
+	uint			mGeneration;
+	
+	// disable copying
+				CHSRegExpDFA( const CHSRegExpDFA& );
+	CHSRegExpDFA&	operator=( const CHSRegExpDFA& );
+	
+	static const char *	Next( const char * p );
+	static bool	MatchOne( const char * node, uchar c );
+	
+	void		BeginSet();
+	void		AddPos( int pos, int mark );
+	void		Add( const char * node, int flags );
+	short		Intern();
+	short		Start( bool atBOL );
+	short		Step( short from, uchar c );
+	bool		MatchAtEnd( short state, bool atBOL );
+	void		Reset();
+};
+
+
+/*
+ * Internal Routines
+ */
+static const char *	FindLiteral( const char * text, size_t len, const char * lit, size_t litLen );
+
+
 /* **********************************************************************
 *****	CHSRegExp - compile a regular expression into internal code	*****
 *****																*****
@@ -249,7 +344,13 @@ A special sequence, like \< or \> can be made into a literal character by droppi
 CHSRegExp::CHSRegExp( const char * theRegExp, tRegErrorProc proc /* =0 */ ) :
 	mRegErrorProc( proc ),
 	mRegmust(),
+	mRegmustlen(),
+	mRegprefix(),
+	mRegprefixlen(),
 	mProgram(),
+	mScanDFA(),
+	mAnchorDFA(),
+	mUseDFA( true ),
 	mRegparse( theRegExp ),
 	mRegnpar( 1 ),
 	mRegcode( &mRegdummy ),
@@ -312,30 +413,50 @@ CHSRegExp::CHSRegExp( const char * theRegExp, tRegErrorProc proc /* =0 */ ) :
 			mRegstart = *OPERAND( scan );
 		else
 		if ( OP(scan) == BOL )
+			{
 			mReganch = true;
+			
+			// does it start with a literal, too?
+			char * first = regnext( scan );
+			if ( first && OP(first) == EXACTLY )
+				{
+				mRegprefix    = OPERAND( first );
+				mRegprefixlen = std::strlen( mRegprefix );
+				}
+			}
 		
 		/*
-		 * If there's something expensive in the r.e., find the
-		 * longest literal string that must appear and make it the
-		 * mRegmust.  Resolve ties in favor of later strings, since
+		 * Find the longest literal string that must appear and make
+		 * it the mRegmust.  Resolve ties in favor of later strings, since
 		 * the mRegstart check works with the beginning of the r.e.
 		 * and avoiding duplication strengthens checking.  Not a
 		 * strong reason, but sufficient in the absence of others.
 		 */
-		if ( flags & SPSTART )
+		const char * longest = nullptr;
+		size_t len = 0;
+		for ( ; scan; scan = regnext( scan ) )
+			if ( OP(scan) == EXACTLY
+			&&   std::strlen( OPERAND(scan) ) >= len )
+				{
+				longest = OPERAND( scan );
+				len = std::strlen( longest );
+				}
+		
+		// an anchored prefix is checked anyway
+		if ( longest != mRegprefix )
 			{
-			const char * longest = nullptr;
-			size_t len = 0;
-			for ( ; scan; scan = regnext( scan ) )
-				if ( OP(scan) == EXACTLY
-				&&   std::strlen( OPERAND(scan) ) >= len )
-					{
-					longest = OPERAND( scan );
-					len = std::strlen( longest );
-					}
-			mRegmust = longest;
+			mRegmust    = longest;
+			mRegmustlen = len;
 			}
 		}
+	
+	// build the DFAs, if they can cope
+	if ( CHSRegExpDFA::CanRun( mProgram ) )
+		{
+		mAnchorDFA = NEW_TAG("RegExpDFA") CHSRegExpDFA( mProgram, mRegsize, false );
+		if ( not mReganch )
+			mScanDFA = NEW_TAG("RegExpDFA") CHSRegExpDFA( mProgram, mRegsize, true );
+		}
 }
 
 
@@ -344,6 +465,8 @@ CHSRegExp::CHSRegExp( const char * theRegExp, tRegErrorProc proc /* =0 */ ) :
 ************************************************************************/
 CHSRegExp::~CHSRegExp()
 {
+	delete mScanDFA;
+	delete mAnchorDFA;
 	delete[] mProgram;
 }
 
@@ -893,13 +1016,27 @@ CHSRegExp::regexec( const char * theData )
 		regError( "regexec: compiled regular expression is corrupted" );
 		// NOTREACHED
 	
+	size_t len = std::strlen( theData );
+	
+	/* If an anchored match must start with a string, check for it. */
+	if ( mRegprefix && std::strncmp( theData, mRegprefix, mRegprefixlen ) != 0 )
+		return false;
+	
 	/* If there is a "must appear" string, look for it. */
-	if ( mRegmust && not std::strstr( theData, mRegmust ) )
+	if ( mRegmust && not FindLiteral( theData, len, mRegmust, mRegmustlen ) )
 		return false;
 	
 	/* Mark beginning of line for ^ . */
 	mRegbol = theData;
 	
+	/* Let the DFA decide, if it can. */
+	if ( mAnchorDFA && mUseDFA )
+		{
+		int result = dfaexec( theData, len );
+		if ( result != CHSRegExpDFA::kGaveUp )
+			return CHSRegExpDFA::kMatch == result;
+		}
+	
 	/* Simplest case:  anchored match need be tried only once. */
 	if ( mReganch )
 		return regtry( theData );
@@ -928,6 +1065,67 @@ CHSRegExp::regexec( const char * theData )
 }
 
 
+/* **********************************************************************
+*****	dfaexec - match using the DFAs								*****
+*****																*****
+*****	The scanning DFA says whether there's a match anywhere at	*****
+*****	all, and where the first match to finish finishes. The		*****
+*****	leftmost match can't start any later than that one did, so	*****
+*****	we ask the anchored DFA about each possible start up to		*****
+*****	there, in turn. (If we know what char a match starts with,	*****
+*****	memchr() finds the possible starts faster than the			*****
+*****	scanning DFA would, so we skip straight to this.) The first	*****
+*****	yes is where the backtracker would have found its match; it	*****
+*****	goes there directly, and only to record the parenthesized	*****
+*****	subexpressions.												*****
+************************************************************************/
+int
+CHSRegExp::dfaexec( const char * theData, size_t len )
+{
+	const char * end;
+	int result;
+	
+	// anchored matches can only start in one place
+	if ( mReganch )
+		{
+		result = mAnchorDFA->Search( theData, len, true, &end );
+		if ( CHSRegExpDFA::kMatch == result && not regtry( theData ) )
+			result = CHSRegExpDFA::kGaveUp;		// "can't happen"
+		return result;
+		}
+	
+	if ( mRegstart )
+		end = theData + len;
+	else
+		{
+		result = mScanDFA->Search( theData, len, true, &end );
+		if ( result != CHSRegExpDFA::kMatch )
+			return result;
+		}
+	
+	for ( const char * s = theData;  s <= end;  ++s )
+		{
+		if ( mRegstart )
+			{
+			s = static_cast<const char *>( std::memchr( s, mRegstart, size_t(end - s) ) );
+			if ( not s )
+				return CHSRegExpDFA::kNoMatch;
+			}
+		
+		const char * e;
+		result = mAnchorDFA->Search( s, len - size_t(s - theData), s == theData, &e );
+		if ( CHSRegExpDFA::kNoMatch == result )
+			continue;
+		if ( CHSRegExpDFA::kMatch == result && not regtry( s ) )
+			result = CHSRegExpDFA::kGaveUp;		// "can't happen"
+		return result;
+		}
+	
+	return mRegstart ? CHSRegExpDFA::kNoMatch
+					 : CHSRegExpDFA::kGaveUp;		// "can't happen", either
+}
+
+
 /* **********************************************************************
 *****	regtry - try match at specific point						*****
 ************************************************************************/
@@ -1266,6 +1464,485 @@ CHSRegExp::regnext( char * p ) const
 }
 
 
+/* **********************************************************************
+*****	FindLiteral - find a string in some text					*****
+*****																*****
+*****	memchr() finds the candidates a vector at a time; this is	*****
+*****	a good deal quicker than strstr() on long lines.			*****
+************************************************************************/
+static const char *
+FindLiteral( const char * text, size_t len, const char * lit, size_t litLen )
+{
+	if ( litLen > len )
+		return nullptr;
+	
+	const char * last = text + len - litLen;
+	for ( const char * p = text;  p <= last;  ++p )
+		{
+		p = static_cast<const char *>( std::memchr( p, lit[0], size_t(last - p) + 1 ) );
+		if ( not p )
+			break;
+		if ( 0 == std::memcmp( p + 1, lit + 1, litLen - 1 ) )
+			return p;
+		}
+	
+	return nullptr;
+}
+
+
+/* **********************************************************************
+*****	CHSRegExpDFA - constructor									*****
+************************************************************************/
+CHSRegExpDFA::CHSRegExpDFA( const char * program, int progSize, bool floating ) :
+	mProgram( program ),
+	mProgSize( progSize ),
+	mFloating( floating ),
+	mNumStates(),
+	mResets(),
+	mWork(),
+	mWorkCount(),
+	mMark(),
+	mGeneration()
+{
+	mStart[0] = mStart[1] = -1;
+	
+	// no set can hold more places than the program has bytes
+	mWork = NEW_TAG("RegExpDFA") int[ unsigned( progSize ) ];
+	mMark = NEW_TAG("RegExpDFA") uint[ unsigned( progSize ) ];
+	std::memset( mMark, 0, unsigned( progSize ) * sizeof *mMark );
+}
+
+
+/* **********************************************************************
+*****	CHSRegExpDFA - destructor									*****
+************************************************************************/
+CHSRegExpDFA::~CHSRegExpDFA()
+{
+	Reset();
+	delete[] mWork;
+	delete[] mMark;
+}
+
+
+/* **********************************************************************
+*****	CanRun - is this program one we can do?						*****
+*****																*****
+*****	\< and \> look back at the previous character, which a		*****
+*****	set of places in the program can't tell us. Everything		*****
+*****	else is fine.												*****
+************************************************************************/
+bool
+CHSRegExpDFA::CanRun( const char * program )
+{
+	for ( const char * s = program + 1;  OP(s) != END;  )
+		{
+		char op = OP( s );
+		if ( WORDA == op || WORDZ == op )
+			return false;
+		
+		s += 3;
+		if ( ANYOF == op || ANYBUT == op || EXACTLY == op )
+			s += std::strlen( s ) + 1;
+		}
+	
+	return true;
+}
+
+
+/* **********************************************************************
+*****	Search - run the DFA over some text							*****
+*****																*****
+*****	Stop as soon as a match ends, and say where; or as soon as	*****
+*****	none can.													*****
+************************************************************************/
+int
+CHSRegExpDFA::Search( const char * text, size_t len, bool atBOL, const char ** oEnd )
+{
+	mResets = 0;
+	
+	short cur = Start( atBOL );
+	if ( cur < 0 )
+		return kGaveUp;
+	if ( mStates[ cur ]->mMatch )
+		{
+		*oEnd = text;
+		return kMatch;
+		}
+	
+	const uchar * p = reinterpret_cast<const uchar *>( text );
+	const uchar * end = p + len;
+	for ( ;  p < end;  ++p )
+		{
+		short next = mStates[ cur ]->mNext[ *p ];
+		if ( next < 0 )
+			{
+			next = Step( cur, *p );
+			if ( next < 0 )
+				return kGaveUp;
+			}
+		cur = next;
+		
+		const SState * state = mStates[ cur ];
+		if ( state->mMatch )
+			{
+			*oEnd = reinterpret_cast<const char *>( p + 1 );
+			return kMatch;
+			}
+		if ( 0 == state->mCount )
+			return kNoMatch;
+		}
+	
+	// at the end of the text, '$' matches too
+	if ( MatchAtEnd( cur, atBOL && 0 == len ) )
+		{
+		*oEnd = text + len;
+		return kMatch;
+		}
+	
+	return kNoMatch;
+}
+
+
+/* **********************************************************************
+*****	Next - dig the "next" pointer out of a node					*****
+************************************************************************/
+const char *
+CHSRegExpDFA::Next( const char * p )
+{
+	int offset = NEXT(p);
+	if ( 0 == offset )
+		return nullptr;
+	
+	if ( OP(p) == BACK )
+		return p - offset;
+	else
+		return p + offset;
+}
+
+
+/* **********************************************************************
+*****	MatchOne - does a STAR or PLUS operand match this char?		*****
+************************************************************************/
+bool
+CHSRegExpDFA::MatchOne( const char * node, uchar c )
+{
+	switch ( OP(node) )
+		{
+		case ANY:
+			return c != '\0';
+		
+		case EXACTLY:
+			return c == UCHARAT( OPERAND(node) );
+		
+		case ANYOF:
+			return c != '\0' && std::strchr( OPERAND(node), c ) != nullptr;
+		
+		case ANYBUT:
+			return c != '\0' && std::strchr( OPERAND(node), c ) == nullptr;
+		}
+	
+	return false;
+}
+
+
+/* **********************************************************************
+*****	BeginSet - start building a new set of places				*****
+************************************************************************/
+void
+CHSRegExpDFA::BeginSet()
+{
+	mWorkCount = 0;
+	
+	// once in four billion sets, clear the marks
+	if ( 0 == ++mGeneration )
+		{
+		std::memset( mMark, 0, unsigned( mProgSize ) * sizeof *mMark );
+		mGeneration = 1;
+		}
+}
+
+
+/* **********************************************************************
+*****	AddPos - add a place to the set, unless it's there already	*****
+*****																*****
+*****	'mark' is a program offset unique to the place: the node	*****
+*****	itself, or the EXACTLY char it's waiting for, or (for a		*****
+*****	PLUS that's matched once) the node plus 1.					*****
+************************************************************************/
+void
+CHSRegExpDFA::AddPos( int pos, int mark )
+{
+	if ( mMark[ mark ] != mGeneration )
+		{
+		mMark[ mark ] = mGeneration;
+		mWork[ mWorkCount++ ] = pos;
+		}
+}
+
+
+/* **********************************************************************
+*****	Add - add a node to the set, and everywhere it can get to	*****
+*****	without reading a character									*****
+*****																*****
+*****	This follows regmatch() case by case.						*****
+************************************************************************/
+void
+CHSRegExpDFA::Add( const char * node, int flags )
+{
+	int offset = int( node - mProgram );
+	
+	switch ( OP(node) )
+		{
+		case END:
+		case ANY:
+		case ANYOF:
+		case ANYBUT:
+		case EXACTLY:
+		case PLUS:
+			AddPos( offset, offset );
+			break;
+		
+		case STAR:
+			if ( mMark[ offset ] != mGeneration )
+				{
+				AddPos( offset, offset );
+				Add( Next( node ), flags );
+				}
+			break;
+		
+		case EOL:
+			if ( mMark[ offset ] != mGeneration )
+				{
+				AddPos( offset, offset );
+				if ( flags & kAtEOS )
+					Add( Next( node ), flags );
+				}
+			break;
+		
+		case BOL:
+			if ( flags & kAtBOL )
+				Add( Next( node ), flags );
+			break;
+		
+		case BRANCH:
+			if ( mMark[ offset ] == mGeneration )
+				break;
+			mMark[ offset ] = mGeneration;
+			
+			if ( OP(Next( node )) != BRANCH )		// No choice.
+				Add( OPERAND(node), flags );
+			else
+				{
+				for ( const char * scan = node;  scan && OP(scan) == BRANCH;  scan = Next( scan ) )
+					Add( OPERAND(scan), flags );
+				}
+			break;
+		
+		default:		// NOTHING, BACK, OPEN, CLOSE
+			if ( mMark[ offset ] == mGeneration )
+				break;
+			mMark[ offset ] = mGeneration;
+			
+			Add( Next( node ), flags );
+			break;
+		}
+}
+
+
+/* **********************************************************************
+*****	Intern - find or make the state for the set just built		*****
+*****																*****
+*****	Returns -1 if there's no room for it.						*****
+************************************************************************/
+short
+CHSRegExpDFA::Intern()
+{
+	// sort, so equal sets look equal
+	int * work = mWork;
+	int count = mWorkCount;
+	for ( int i = 1;  i < count;  ++i )
+		{
+		int pos = work[ i ];
+		int j = i;
+		for ( ;  j > 0 && work[ j - 1 ] > pos;  --j )
+			work[ j ] = work[ j - 1 ];
+		work[ j ] = pos;
+		}
+	
+	for ( int n = 0;  n < mNumStates;  ++n )
+		{
+		const SState * state = mStates[ n ];
+		if ( state->mCount == count
+		&&   0 == std::memcmp( state->mPos, work, count * sizeof *work ) )
+			{
+			return short( n );
+			}
+		}
+	
+	if ( mNumStates >= kMaxStates )
+		return -1;
+	
+	SState * state = NEW_TAG("RegExpDFA") SState;
+	state->mPos   = NEW_TAG("RegExpDFA") int[ count + 1 ];
+	state->mCount = count;
+	state->mMatch = false;
+	std::memcpy( state->mPos, work, count * sizeof *work );
+	for ( int n = 0;  n < count;  ++n )
+		if ( END == OP( mProgram + (work[ n ] & 0x0FFFF) ) )
+			state->mMatch = true;
+	for ( int c = 0;  c < 256;  ++c )
+		state->mNext[ c ] = -1;
+	
+	mStates[ mNumStates ] = state;
+	return short( mNumStates++ );
+}
+
+
+/* **********************************************************************
+*****	Start - the state before any text has been read				*****
+************************************************************************/
+short
+CHSRegExpDFA::Start( bool atBOL )
+{
+	short state = mStart[ atBOL ];
+	if ( state < 0 )
+		{
+		BeginSet();
+		Add( mProgram + 1, atBOL ? kAtBOL : 0 );
+		state = Intern();
+		if ( state < 0 )
+			{
+			Reset();
+			state = Intern();
+			}
+		mStart[ atBOL ] = state;
+		}
+	
+	return state;
+}
+
+
+/* **********************************************************************
+*****	Step - work out the state after reading one more character	*****
+************************************************************************/
+short
+CHSRegExpDFA::Step( short from, uchar c )
+{
+	BeginSet();
+	
+	const SState * state = mStates[ from ];
+	for ( int n = 0;  n < state->mCount;  ++n )
+		{
+		int pos = state->mPos[ n ];
+		int offset = pos & 0x0FFFF;
+		int sub = pos >> 16;
+		const char * node = mProgram + offset;
+		
+		switch ( OP(node) )
+			{
+			case ANY:
+			case ANYOF:
+			case ANYBUT:
+				if ( MatchOne( node, c ) )
+					Add( Next( node ), 0 );
+				break;
+			
+			case EXACTLY:
+				{
+				const char * opnd = OPERAND( node );
+				if ( UCHARAT( opnd + sub ) == c )
+					{
+					if ( opnd[ sub + 1 ] )
+						AddPos( offset | ((sub + 1) << 16), offset + 3 + sub + 1 );
+					else
+						Add( Next( node ), 0 );
+					}
+				}
+				break;
+			
+			case STAR:
+				if ( MatchOne( OPERAND(node), c ) )
+					{
+					// another, or else carry on
+					AddPos( offset, offset );
+					Add( Next( node ), 0 );
+					}
+				break;
+			
+			case PLUS:
+				if ( MatchOne( OPERAND(node), c ) )
+					{
+					AddPos( offset | (1 << 16), offset + 1 );
+					Add( Next( node ), 0 );
+					}
+				break;
+			
+			// END, EOL: they don't read anything
+			}
+		}
+	
+	// floating: a match could start here, too
+	if ( mFloating )
+		Add( mProgram + 1, 0 );
+	
+	short next = Intern();
+	if ( next >= 0 )
+		mStates[ from ]->mNext[ c ] = next;
+	else
+		{
+		// out of room: forget everything and start again, within reason
+		if ( ++mResets > kMaxResets )
+			return -1;
+		Reset();
+		next = Intern();
+		}
+	
+	return next;
+}
+
+
+/* **********************************************************************
+*****	MatchAtEnd - could this state match at the end of the text?	*****
+************************************************************************/
+bool
+CHSRegExpDFA::MatchAtEnd( short from, bool atBOL )
+{
+	const SState * state = mStates[ from ];
+	if ( state->mMatch )
+		return true;
+	
+	BeginSet();
+	for ( int n = 0;  n < state->mCount;  ++n )
+		{
+		const char * node = mProgram + (state->mPos[ n ] & 0x0FFFF);
+		if ( EOL == OP(node) )
+			Add( Next( node ), kAtEOS | (atBOL ? kAtBOL : 0) );
+		}
+	
+	for ( int n = 0;  n < mWorkCount;  ++n )
+		if ( END == OP( mProgram + (mWork[ n ] & 0x0FFFF) ) )
+			return true;
+	
+	return false;
+}
+
+
+/* **********************************************************************
+*****	Reset - forget all the states								*****
+************************************************************************/
+void
+CHSRegExpDFA::Reset()
+{
+	for ( int n = 0;  n < mNumStates;  ++n )
+		{
+		delete[] mStates[ n ]->mPos;
+		delete mStates[ n ];
+		}
+	mNumStates = 0;
+	mStart[0] = mStart[1] = -1;
+}
+
+
 #ifdef DEBUG_REGEXP
 
 /* **********************************************************************
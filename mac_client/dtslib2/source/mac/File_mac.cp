@@ -21,6 +21,9 @@
 #endif
 
 #include <sys/param.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
 #include <unistd.h>
 
 #include "File_mac.h"
@@ -49,6 +52,9 @@
 **	DTS_geteof();
 **	DTS_read();
 **	DTS_write();
+**	DTS_map();
+**	DTS_retainmap();
+**	DTS_releasemap();
 */
 
 // consider reimplementing DTSFileSpecPriv in terms of CFURLRefs
@@ -2682,6 +2688,96 @@ DTS_write( int fileref, const void * buffer, size_t size )
 }
 
 
+/*
+**	DTS_map()
+**
+**	map an entire file read-only into memory.
+**	The mapping is returned with a single reference; balance it with DTS_releasemap().
+**	Closing the descriptor right away is fine; the mapping keeps the vnode alive.
+*/
+DTSError
+DTS_map( DTSFileSpec * spec, DTSFileMapping ** oMapping )
+{
+	__Check( spec );
+	__Check( oMapping );
+	if ( not spec || not oMapping )
+		return paramErr;
+	*oMapping = nullptr;
+	
+	DTSFileSpecPriv * p = spec->priv.p;
+	__Check( p );
+	if ( not p )
+		return -1;
+	
+	FSRef ref;
+	OSStatus result = p->CopyToRef( &ref, true );
+	char path[ PATH_MAX ];
+	if ( noErr == result )
+		result = FSRefMakePath( &ref, reinterpret_cast<UInt8 *>( path ), sizeof path );
+	if ( noErr != result )
+		return result;
+	
+	int fd = open( path, O_RDONLY );
+	if ( fd < 0 )
+		return ioErr;
+	
+	struct stat sb;
+	void * data = MAP_FAILED;
+	if ( 0 == fstat( fd, &sb ) && sb.st_size > 0 )
+		data = mmap( nullptr, static_cast<size_t>( sb.st_size ), PROT_READ, MAP_SHARED, fd, 0 );
+	close( fd );
+	
+	if ( MAP_FAILED == data )
+		return ioErr;
+	
+	DTSFileMapping * mapping = NEW_TAG("DTSFileMapping") DTSFileMapping;
+	if ( not mapping )
+		{
+		munmap( data, static_cast<size_t>( sb.st_size ) );
+		return memFullErr;
+		}
+	mapping->mapData = static_cast<const uchar *>( data );
+	mapping->mapSize = static_cast<size_t>( sb.st_size );
+	mapping->mapRefCount = 1;
+	
+	*oMapping = mapping;
+	return noErr;
+}
+
+
+/*
+**	DTS_retainmap()
+**
+**	add a reference to a mapping. Safe to call from any thread.
+*/
+void
+DTS_retainmap( DTSFileMapping * mapping )
+{
+	if ( mapping )
+		__sync_add_and_fetch( &mapping->mapRefCount, 1 );
+}
+
+
+/*
+**	DTS_releasemap()
+**
+**	drop a reference; unmap the file when the last one goes away.
+**	Safe to call from any thread.
+*/
+void
+DTS_releasemap( DTSFileMapping * mapping )
+{
+	if ( not mapping )
+		return;
+	
+	if ( 0 == __sync_sub_and_fetch( &mapping->mapRefCount, 1 ) )
+		{
+		munmap( const_cast<uchar *>( mapping->mapData ), mapping->mapSize );
+		delete mapping;
+		}
+}
+
+
 /*
 **	Support for Navigation Services 3.0; largely borrowed from Metrowerks' PowerPlantX.
 */
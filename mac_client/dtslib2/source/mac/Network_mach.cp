@@ -29,6 +29,8 @@
 #include <netdb.h>
 #include <unistd.h>
 
+#include <mach/mach_time.h>
+
 #include "Network_cmn.h"
 
 
@@ -1165,6 +1167,112 @@ DTSNetURcvMulti( DTSEndPoint ep, DTSNetAddress& fromaddr,
 #endif  // RCV_MULTI
 
 
+/*
+**	DTSNetTimestamp()
+**
+**	a monotonic clock, in seconds, for stamping packet arrivals
+*/
+double
+DTSNetTimestamp()
+{
+	static double scale;
+	if ( 0 == scale )
+		{
+		mach_timebase_info_data_t tb;
+		mach_timebase_info( &tb );
+		scale = 1.0e-9 * tb.numer / tb.denom;
+		}
+	
+	return mach_absolute_time() * scale;
+}
+
+
+/*
+**	DTSNetWaitForData()
+**
+**	block until any of the endpoints has something to read, or the timeout expires.
+**	Closed endpoints are ignored. Returns kNetworkNoData on timeout.
+*/
+DTSError
+DTSNetWaitForData( const DTSEndPoint * eps, bool * oReady, int count, int msTimeout )
+{
+	fd_set fds;
+	FD_ZERO( &fds );
+	int maxfd = -1;
+	for ( int i = 0; i < count; ++i )
+		{
+		oReady[ i ] = false;
+		if ( IsEndPointOpen( eps[ i ] ) )
+			{
+			FD_SET( eps[ i ], &fds );
+			if ( eps[ i ] > maxfd )
+				maxfd = eps[ i ];
+			}
+		}
+	
+	timeval tv;
+	tv.tv_sec  = msTimeout / 1000;
+	tv.tv_usec = (msTimeout % 1000) * 1000;
+	
+	int nready = select( maxfd + 1, &fds, nullptr, nullptr, &tv );
+	if ( nready < 0 )
+		return ( EINTR == errno ) ? DTSError( kNetworkNoData ) : OSErrno();
+	if ( 0 == nready )
+		return kNetworkNoData;
+	
+	for ( int i = 0; i < count; ++i )
+		if ( IsEndPointOpen( eps[ i ] ) )
+			oReady[ i ] = FD_ISSET( eps[ i ], &fds );
+	
+	return noErr;
+}
+
+
+/*
+**	DTSNetUReceiveBatch()
+**
+**	read as many datagrams as are waiting, up to count of them.
+**	Darwin has no recvmmsg(), so it's a loop of recvfrom()s until the socket runs dry;
+**	a platform that has one should use it here.
+**	Returns kNetworkNoData if there was nothing at all.
+*/
+DTSError
+DTSNetUReceiveBatch( DTSEndPoint ep, DTSNetDatagram * grams, int count, int * oCount )
+{
+	DTSError result = noErr;
+	int numread = 0;
+	
+	while ( numread < count )
+		{
+		DTSNetDatagram& dg = grams[ numread ];
+		socklen_t len = dg.dgFrom.sa_len();
+		ssize_t nread = recvfrom( ep, dg.dgData, dg.dgSize, kNilFlags, dg.dgFrom.sa(), &len );
+		if ( nread < 0 )
+			{
+			if ( EINTR == errno )
+				continue;
+			if ( EAGAIN != errno )
+				{
+#if DEBUG_VERSION_NETWORK
+				Lg( "DTSNetUReceiveBatch(%d) failed (%d): %s\n", ep, errno, strerror(errno) );
+#endif
+				result = kNetworkDisconnect;
+				}
+			break;
+			}
+		
+		dg.dgSize = static_cast<size_t>( nread );
+		++numread;
+		}
+	
+	if ( noErr == result && 0 == numread )
+		result = kNetworkNoData;
+	
+	*oCount = numread;
+	return result;
+}
+
+
 /*
 **	DTSNetSetOption()
 **
@@ -35,18 +35,42 @@
 **
 **	DTSInitSound();
 **	DTSExitSound();
-**	DTSAreAllSoundsDone();
+**	DTSStopAllSounds();
+**	DTSSetSoundVolume();
 */
 
 /*
 **	Definitions
 */
-class SoundChannel;		// forward
+// all sounds are mixed, in software, down to a single stream at this rate;
+// the output queue asks for it in buffers this long (about 23 ms apiece)
+const uint32_t	kMixOutputRate			= 44100;
+const UInt32	kOutputBufferFrames		= 1024;
+const int		kNumOutputBuffers		= 3;
+
+// # of parsed 'snd ' headers remembered; must be a power of 2
+const int		kSoundHeaderIndexSize	= 64;
+
+
+/*
+**	struct SoundSamples
+**	a reference-counted owner of a sound's samples, which live either in a mapped
+**	file or in a private heap copy. The DTSSoundPriv holds one reference, and so
+**	does each mixer voice playing it; so a DTSSound may be re-Init()ed, or deleted,
+**	while its earlier playbacks carry on.
+*/
+struct SoundSamples
+{
+	int32_t				ssRefCount;
+	DTSFileMapping *	ssMapping;		// either this...
+	uchar *				ssCopy;			// ... or this
+};
+
 
 /*
 **	class DTSSoundPriv
-**	this stores a (private copy of a) sound's sample data & length,
-**	as well as the AudioStreamBasicDescription that characterizes it.
+**	this stores a sound's sample data & length -- either a private copy, or a pointer
+**	into a mapped keyfile -- as well as the AudioStreamBasicDescription that characterizes it.
 */
 class DTSSoundPriv
 {
@@ -56,7 +80,6 @@ public:
 					~DTSSoundPriv();
 	
 	// timing (for editor)
-	void			DidFinishPlayback( CFAbsoluteTime startTime );
 	CFTimeInterval	GetDuration() const { return sndDuration; }
 	
 	// no copying
@@ -66,102 +89,89 @@ private:
 	
 	void			Reset();
 	OSStatus		Init( const uchar * soundBytes, size_t len );
+	OSStatus		Init( DTSKeyFile * file, DTSKeyType type, DTSKeyID id );
 	
-	// 'snd ' decoder helper
+	// 'snd ' decoder helpers
+	OSStatus		ParseSndListBytes( const uchar * sndData, size_t len,
+						size_t * oDataOffset, size_t * oDataLen );
 	OSStatus		InitFromSndListBytes( const uchar * sndData, size_t len );
 	// we could conceivably have 'WAV', AIFF, etc. decoder helpers too...
 	
 	// stash the sample data, shorn of any headers
 	OSStatus		SaveSampleData( const uchar * inSampleData, size_t inLen );
 	
+	// hand the samples to the mixer
+	OSStatus		Play();
+	
 	AudioStreamBasicDescription	sndDesc;
 	const uchar *				sndBytes;
 	size_t						sndLen;
-	SoundChannel *				sndChannel;
+	SoundSamples *				sndSamples;		// owns sndBytes
+	DTSMixVoiceID				sndVoice;		// most recent playback
 	CFTimeInterval				sndDuration;
 	
 	friend class DTSSound;
-	friend class SoundChannel;
 };
 
 
-// a SoundChannel represents an AudioQueue and its associated buffer;
-// it exists only so long as the sound is being played back
-class SoundChannel : public DTSLinkedList<SoundChannel>
+/*
+**	struct SoundHeaderIndexEntry
+**	what we learned from parsing one mapped 'snd ' record, so that replaying it
+**	costs no more than a table lookup
+*/
+struct SoundHeaderIndexEntry
 {
-	// instance data
-	AudioQueueRef				mQueue;
-	AudioQueueBufferRef			mBuffer;
-	DTSSoundPriv *				mSource;
-	CFAbsoluteTime				mStartedTime;
-	volatile bool				mStillPlaying;
-	
-public:
-	// constructor/destructor
-							SoundChannel( DTSSoundPriv * );
-	virtual					~SoundChannel();
-	
-	// no copying
-private:
-							SoundChannel( const SoundChannel& );
-	SoundChannel&			operator=( const SoundChannel& );
-	
-	// interface
-public:
-	OSStatus				Play( const DTSSoundPriv * sound );
-	OSStatus				Stop();
-	bool					IsDone() const;
-	OSStatus				SetVolume( Float32 volume );
-	void					SetSource( DTSSoundPriv * s ) { mSource = s; }
-	
-	static SoundChannel *	FindChannelForSound( const DTSSoundPriv * test );
-	static int				NumInUse()	{ return gRootChannel->Count(); }
-	
-	// interface routines for non-class functions in Sound_dts.h
-	static OSStatus			Init();
-	static void				Exit();
-	static void				SetAllVolumes( Float32 volume );
-
-private:
-	// class data
-	static SoundChannel *		gRootChannel;
-	static EventLoopTimerRef	sCleanupTimer;
-	
-	// AudioToolbox callbacks
-#if MAC_OS_X_VERSION_MIN_REQUIRED <= MAC_OS_X_VERSION_10_5
-	// can't count on having __BLOCKS__, therefore we may need this callback
-	static void		BufferProc( void * ud, AudioQueueRef, AudioQueueBufferRef );
-#endif  // <= 10.5
-	static void		PropertyListenerProc( void * ud, AudioQueueRef, AudioQueuePropertyID );
-	static void		CleanupProc( EventLoopTimerRef, void * );
-	
-	// queue creation
-	OSStatus		CreateAudioQueue( const AudioStreamBasicDescription * );
+	const uchar *				shiRecord;		// start of the record, within sHeaderIndexMapping
+	AudioStreamBasicDescription	shiDesc;
+	size_t						shiDataOffset;	// from shiRecord to the first sample
+	size_t						shiDataLen;
 };
 
 
 /*
 **	Internal Variables
 */
-SoundChannel *		SoundChannel::gRootChannel;		// sounds currently or recently being played
-EventLoopTimerRef	SoundChannel::sCleanupTimer;	// harvester of finished sound channels
-static Float32		sDefaultVolume;					// 0.0 - 1.0
-static int			sMaxSounds;						// max # simultaneously-active sounds
+static DTSMixer			sMixer;							// where all sounds are played
+static AudioQueueRef	sOutputQueue;					// ... and what plays the mix
+static bool				sOutputRunning;
+static int				sMaxSounds;						// max # simultaneously-active sounds
+
+static SoundHeaderIndexEntry	sHeaderIndex[ kSoundHeaderIndexSize ];
+static DTSFileMapping *			sHeaderIndexMapping;	// the file sHeaderIndex describes
+
+
+/*
+**	Internal Routines
+*/
+static void				FlushSoundHeaderIndex();
+static SoundSamples *	NewSoundSamples( DTSFileMapping * mapping, uchar * copy );
+static void				RetainSoundSamples( SoundSamples * samples );
+static void				ReleaseSoundSamples( void * samples );
+static OSStatus			StartOutput();
+static void				StopOutput();
+static OSStatus			CreateOutputQueue( const AudioStreamBasicDescription * asbd );
+static void				FillOutputBuffer( AudioQueueRef queue, AudioQueueBufferRef buffer );
+#if MAC_OS_X_VERSION_MIN_REQUIRED <= MAC_OS_X_VERSION_10_5
+static void				OutputBufferProc( void * ud, AudioQueueRef, AudioQueueBufferRef );
+#endif  // <= 10.5
 
 #pragma mark -
 
 
 /*
 **	DTSInitSound()
+**
+**	set up the mixer. The output queue isn't started until there's something to play.
 */
 void
 DTSInitSound( int numChannels )
 {
 	sMaxSounds = numChannels;
-	sDefaultVolume = 1;			// max volume
+	if ( sMaxSounds > kMixMaxVoices )
+		sMaxSounds = kMixMaxVoices;
 	
-	// set up the timer that cleans up finished SoundChannel objects
-	SoundChannel::Init();
+	__Verify_noErr( sMixer.Init( sMaxSounds, kMixOutputRate ) );
+	sMixer.SetVolume( 1 );		// max volume
 }
 
 
@@ -171,8 +181,30 @@ DTSInitSound( int numChannels )
 void
 DTSExitSound()
 {
-	// remove the cleanup timer, and mop up any remaining sounds
-	SoundChannel::Exit();
+	// silence the output, and mop up any remaining sounds
+	StopOutput();
+	sMixer.StopAll();
+	
+	// let go of the mapped sound file
+	FlushSoundHeaderIndex();
+}
+
+
+/*
+**	DTSStopAllSounds()
+**
+**	silence every sound, and forget the headers parsed from mapped files.
+**	Call this before rewriting a key file that sounds are streamed from:
+**	a mapped file that shrinks under a playing voice would fault on its next
+**	read. The mixer stops its voices under the render lock, so once this
+**	returns nothing is reading the old mapping; DTSSounds re-map the file
+**	the next time they're played.
+*/
+void
+DTSStopAllSounds()
+{
+	sMixer.StopAll();
+	FlushSoundHeaderIndex();
 }
 
 
@@ -181,16 +213,13 @@ DTSExitSound()
 **
 **	Set the baseline sound channel for all channels.
 **	The theoretical range is 0 = silent to 0xFFFF = hardware maximum.
-**	(although AudioToolbox works with floats, unlike the old Sound Manager.)
+**	(although the mixer works in fractions, unlike the old Sound Manager.)
 */
 void
 DTSSetSoundVolume( ushort volume )
 {
-	// set default volume for sounds queued up in the future
-	sDefaultVolume = volume / 65535.0F;
-	
-	// ... also adjust any that are presently being played
-	SoundChannel::SetAllVolumes( sDefaultVolume );
+	// this applies to sounds already playing, too
+	sMixer.SetVolume( volume / 65535.0F );
 }
 
 
@@ -468,37 +497,15 @@ DTSDefineImplementFirmNoCopy(DTSSoundPriv)
 
 
 /*
-	It's important to note that the lifetimes of DTSSounds (and their -Privs) must be
-	totally independent of those of SoundChannels. The former is controlled by the
-	code that uses them; the latter lives only while the sound is actually being played.
-	Hence, at one extreme you might have a transiently-allocated DTSSound object that happens
-	to be asked to play a very lengthy sound (i.e. the channel sticks around for far longer
-	than the DTSSound); at the other extreme you might have a DTSSound on the stack that
-	receives multiple Play() requests (i.e. the channels come and go many times during the
-	lifetime of the single DTSSoundPriv).
-	
-	So far no big deal, but it gets tricky as soon as you realize that both kinds of objects
-	would like to have access to their counterparts. For example, DTSSound::Stop()
-	wants to talk to the associated running SoundChannel, if there is one; conversely,
-	SoundChannel::FindChannelForSound() obviously need to be able to find the channel (if any)
-	that's playing a given sound.
-	
-	This cross-referencing is handled by the 'DTSSoundPriv::sndChannel' and
-	'SoundChannel::mSource' fields. But then what about the problem of stale pointers,
-	if we have no guarantees about the classes' relative lifetimes?
-	My solution is to have the destructors for DTSSoundPrivs and SoundChannels cooperate
-	to implement mutual auto-zeroing of their correspondents' respective back-pointers.
-	Whenever either kind of object is destructed, if its counterpart still exists,
-	the reverse pointer in that counterpart gets zero'ed out.
-	
-	What this means is that, in (e.g.) DTSSoundPriv code, you can safely write
-	
-		if ( sndChannel )
-			sndChannel->DoStuff();
-	
-	with confidence that, had the channel already been deleted at that point, then the
-	'sndChannel' pointer would have been nulled out; and vice-versa for SoundChannels and
-	their 'mSource' pointers.
+	The lifetimes of DTSSounds (and their -Privs) are totally independent of their
+	playbacks. At one extreme you might have a transiently-allocated DTSSound object that
+	happens to be asked to play a very lengthy sound; at the other, a DTSSound that gets
+	re-Init()ed and replayed many times while its earlier sounds are still going.
+	
+	So nothing in the mixer ever points back at a DTSSoundPriv. Each voice holds its own
+	reference to the sound's SoundSamples, and the DTSSoundPriv merely remembers the ID of
+	the voice it last started, for Stop() and IsDone(); the mixer never reuses those IDs,
+	so a stale one is harmless.
 */
 
 
@@ -508,7 +515,8 @@ DTSDefineImplementFirmNoCopy(DTSSoundPriv)
 DTSSoundPriv::DTSSoundPriv() :
 	sndBytes( nullptr ),
 	sndLen( 0 ),
-	sndChannel( nullptr ),
+	sndSamples( nullptr ),
+	sndVoice( kMixNoVoice ),
 	sndDuration( -1 )	// -1 indicates "as yet undetermined"
 {
 	memset( &sndDesc, 0, sizeof sndDesc );
@@ -520,12 +528,8 @@ DTSSoundPriv::DTSSoundPriv() :
 */
 DTSSoundPriv::~DTSSoundPriv()
 {
-	// if we still have a channel, tell it we're gone
-	if ( sndChannel )
-		sndChannel->SetSource( nullptr );
-	
-	// release the sample buffer
-	delete[] sndBytes;
+	// release the samples; any voices still playing them have their own references
+	ReleaseSoundSamples( sndSamples );
 }
 
 
@@ -539,10 +543,11 @@ void
 DTSSoundPriv::Reset()
 {
 	memset( &sndDesc, 0, sizeof sndDesc );
-	delete[] sndBytes;
+	ReleaseSoundSamples( sndSamples );
+	sndSamples = nullptr;
 	sndBytes = nullptr;
 	sndLen = 0;
-	sndChannel = nullptr;
+	sndVoice = kMixNoVoice;	// any earlier playback carries on without us
 	sndDuration = -1;	// just in case
 }
 
@@ -552,7 +557,7 @@ DTSSoundPriv::Reset()
 **
 **	given a pointer to (and length of) a chunk of bytes -- which are assumed to be in the
 **	format of a (big-endian) SndListResource (i.e. the contents of a 'snd ' resource),
-**	prepare to play it via an AudioQueue.
+**	prepare to play it via the mixer.
 */
 OSStatus
 DTSSoundPriv::Init( const uchar * inSndBytes, size_t len )
@@ -573,31 +578,107 @@ DTSSoundPriv::Init( const uchar * inSndBytes, size_t len )
 }
 
 
+/*
+**	DTSSoundPriv::Init()
+**
+**	prepare to play a 'snd ' record straight out of a read-only keyfile.
+**	Nothing is copied: sndBytes points into the file's mapping, which we hold a
+**	reference to, and the parsed header is remembered in sHeaderIndex so that
+**	replaying the sound doesn't even need to look at it again.
+*/
+OSStatus
+DTSSoundPriv::Init( DTSKeyFile * file, DTSKeyType type, DTSKeyID id )
+{
+	// just in case
+	Reset();
+	
+	const void * record = nullptr;
+	size_t recordLen = 0;
+	DTSFileMapping * mapping = nullptr;
+	OSStatus err = file->MapRecord( type, id, &record, &recordLen, &mapping );
+	if ( noErr != err )
+		return err;
+	
+	// a different file (or a reopened one) invalidates everything we knew
+	if ( mapping != sHeaderIndexMapping )
+		{
+		FlushSoundHeaderIndex();
+		DTS_retainmap( mapping );
+		sHeaderIndexMapping = mapping;
+		}
+	
+	const uchar * bytes = static_cast<const uchar *>( record );
+	SoundHeaderIndexEntry * entry = &sHeaderIndex[ id & (kSoundHeaderIndexSize - 1) ];
+	if ( entry->shiRecord != bytes )
+		{
+		size_t dataOffset = 0;
+		size_t dataLen = 0;
+		err = ParseSndListBytes( bytes, recordLen, &dataOffset, &dataLen );
+		if ( noErr != err )
+			{
+			DTS_releasemap( mapping );
+			return err;
+			}
+		
+		entry->shiRecord     = bytes;
+		entry->shiDesc       = sndDesc;
+		entry->shiDataOffset = dataOffset;
+		entry->shiDataLen    = dataLen;
+		}
+	
+	// the samples take over our reference to the mapping
+	SoundSamples * samples = NewSoundSamples( mapping, nullptr );
+	if ( not samples )
+		{
+		DTS_releasemap( mapping );
+		return memFullErr;
+		}
+	
+	sndDesc    = entry->shiDesc;
+	sndBytes   = bytes + entry->shiDataOffset;
+	sndLen     = entry->shiDataLen;
+	sndSamples = samples;
+	
+	return noErr;
+}
+
+
 /*
 **	DTSSoundPriv::InitFromSndListBytes()
 **
 **	decode 'snd '-style data, yielding an AudioStreamBasicDescription (ASBD) as well as
 **	a pointer to (and length of) a newly-allocated sample buffer.
 **
-**	How it works:  First, we parse the 'snd ' header and its internal SoundHeader structure
-**	(which might actually be a CmpSoundHeader or an ExtSoundHeader), to determine the sound's
-**	characteristics.  From that, next, we can fill out our ASBD, and also make a private copy
-**	of the sound's sample data.
-**
-**	This copying may seem excessive and wasteful -- and it is! -- but is currently required
-**	by the client's data-caching architecture.
-**
-**	There might be a case to be made for adding a new public DTSSound entry point:
-**		DTSSound::Play( DTSKeyFile * file, DTSKeyType type, DTSKeyID sndID );
-**	since, after all, our sounds' data always comes exclusively from keyfile records.
-**	That way there'd be no need to store multiple copies of the sample data, which could
-**	instead be read and parsed just-in-time, viz., in the AudioQueue buffer-proc, which
-**	would also let us use more reasonably-sized (i.e. smaller) AQ buffers;
-**	moreover, the client could stop caching sounds entirely.  In fact we could probably
-**	mmap(2) the entirety of CL_Sounds and fill the AQ buffers directly from there.
+**	This copying may seem excessive and wasteful -- and it is -- which is why sounds that
+**	live in a keyfile should use the DTSKeyFile flavor of Init() instead; that one streams
+**	the samples straight out of the mapped file.
 */
 OSStatus
 DTSSoundPriv::InitFromSndListBytes( const uchar * inSndBytes, size_t inLen )
+{
+	size_t dataOffset = 0;
+	size_t dataLen = 0;
+	OSStatus err = ParseSndListBytes( inSndBytes, inLen, &dataOffset, &dataLen );
+	
+	// make a private copy (sigh) of just the sample data
+	if ( noErr == err )
+		err = SaveSampleData( inSndBytes + dataOffset, dataLen );
+	
+	return err;
+}
+
+
+/*
+**	DTSSoundPriv::ParseSndListBytes()
+**
+**	How it works:  We parse the 'snd ' header and its internal SoundHeader structure
+**	(which might actually be a CmpSoundHeader or an ExtSoundHeader), to determine the sound's
+**	characteristics.  From that we fill out sndDesc, and report where the samples start
+**	and how many bytes of them there are. The samples are left where they lie.
+*/
+OSStatus
+DTSSoundPriv::ParseSndListBytes( const uchar * inSndBytes, size_t inLen,
+	size_t * oDataOffset, size_t * oDataLen )
 {
 	// extract essential sound info
 	SoundComponentData cd;
@@ -640,8 +721,6 @@ DTSSoundPriv::InitFromSndListBytes( const uchar * inSndBytes, size_t inLen )
 #if 1
 			// as per comment below, there are no more compressed sounds in CL_Sounds
 			// so we need not support them any longer.
-# pragma unused( inLen )
-			
 			err = badFormat;
 #else
 			// the sound IS compressed.
@@ -699,9 +778,22 @@ DTSSoundPriv::InitFromSndListBytes( const uchar * inSndBytes, size_t inLen )
 			}
 		}
 	
-	// make a private copy (sigh) of just the sample data
+	// never let a bogus header send us past the end of the record;
+	// that matters all the more now that the record may be mapped straight from disk
 	if ( noErr == err )
-		err = SaveSampleData( inSndBytes + dataOffset, dataLen );
+		{
+		if ( dataOffset > inLen )
+			err = badFormat;
+		else
+		if ( dataLen > inLen - dataOffset )
+			dataLen = inLen - dataOffset;
+		}
+	
+	if ( noErr == err )
+		{
+		*oDataOffset = dataOffset;
+		*oDataLen    = dataLen;
+		}
 	
 	return err;
 }
@@ -711,230 +803,301 @@ DTSSoundPriv::InitFromSndListBytes( const uchar * inSndBytes, size_t inLen )
 **	DTSSoundPriv::SaveSampleData()
 **
 **	once we've fully decoded a 'snd ' header, make a local copy of its sample data,
-**	which we'll eventually pass on to a SoundChannel's audio-queue buffer. 
-**	(Our own copy will eventually be discarded by our destructor). 
+**	which the mixer will read from directly.
 */
 OSStatus
 DTSSoundPriv::SaveSampleData( const uchar * inData, size_t inLen )
 {
 	// cache our own private copy of just the sample data -- no headers at all
-	if ( uchar * sampleBytes = NEW_TAG("SoundSampleBuffer") uchar[ inLen ] )
+	uchar * sampleBytes = NEW_TAG("SoundSampleBuffer") uchar[ inLen ];
+	if ( not sampleBytes )
+		return memFullErr;
+	
+	memcpy( sampleBytes, inData, inLen );
+	
+	SoundSamples * samples = NewSoundSamples( nullptr, sampleBytes );
+	if ( not samples )
 		{
-		memcpy( sampleBytes, inData, inLen );
-		
-		// and set instance vars to point to it
-		sndBytes = sampleBytes;
-		sndLen = inLen;
-		
-		return noErr;
+		delete[] sampleBytes;
+		return memFullErr;
 		}
 	
-	// failed to allocate memory
-	return memFullErr;
+	// and set instance vars to point to it
+	sndSamples = samples;
+	sndBytes = sampleBytes;
+	sndLen = inLen;
+	
+	return noErr;
 }
 
 
 /*
-**	DTSSoundPriv::DidFinishPlayback()
+**	DTSSoundPriv::Play()
 **
-**	update timing statistic, once the sound is done
+**	describe our samples to the mixer, and start them on a voice.
 */
-void
-DTSSoundPriv::DidFinishPlayback( CFAbsoluteTime startTime )
+OSStatus
+DTSSoundPriv::Play()
 {
-	sndDuration = CFAbsoluteTimeGetCurrent() - startTime;
+	if ( not sndSamples || 0 == sndDesc.mBytesPerFrame )
+		return paramErr;
+	
+	DTSMixSound snd;
+	snd.msSamples  = sndBytes;
+	snd.msFrames   = sndLen / sndDesc.mBytesPerFrame;
+	snd.msRate     = static_cast<uint32_t>( sndDesc.mSampleRate + 0.5 );
+	snd.msChannels = sndDesc.mChannelsPerFrame;
+	snd.msRelease  = ReleaseSoundSamples;
+	snd.msRefCon   = sndSamples;
+	
+	// the 'snd ' parser only lets through 8-bit offset-binary and 16-bit big-endian
+	if ( 8 == sndDesc.mBitsPerChannel )
+		snd.msFormat = kMixFormat8BitOffset;
+	else
+	if ( 16 == sndDesc.mBitsPerChannel
+	&&   (sndDesc.mFormatFlags & kLinearPCMFormatFlagIsBigEndian) )
+		{
+		snd.msFormat = kMixFormat16BitBigEndian;
+		}
+	else
+		return badFormat;
+	
+	OSStatus err = StartOutput();
+	if ( noErr != err )
+		return err;
+	
+	// the voice gets its own reference to the samples
+	RetainSoundSamples( sndSamples );
+	sndVoice = sMixer.Play( snd );
+	if ( kMixNoVoice == sndVoice )
+		{
+		ReleaseSoundSamples( sndSamples );
+		return noErr;	// not an error; there was just no room
+		}
+	
+	// we can't time the playback any more, but we can do better: work it out
+	sndDuration = static_cast<CFTimeInterval>( snd.msFrames ) / sndDesc.mSampleRate;
+	
+	return noErr;
 }
 
 
-#pragma mark -
-#pragma mark SoundChannel
-
 /*
-**	SoundChannel::SoundChannel()
+**	FlushSoundHeaderIndex()
 **
-**	constructor
+**	forget every parsed header, and let go of the file they came from
 */
-SoundChannel::SoundChannel( DTSSoundPriv * sp ) :
-	mQueue( nullptr ),
-	mBuffer( nullptr ),
-	mSource( sp ),
-	mStartedTime( 0 ),
-	mStillPlaying( false )		// we haven't finished playing yet
+void
+FlushSoundHeaderIndex()
 {
-	// insert ourselves into the linked list
-	InstallFirst( gRootChannel );
+	memset( sHeaderIndex, 0, sizeof sHeaderIndex );
+	
+	DTS_releasemap( sHeaderIndexMapping );
+	sHeaderIndexMapping = nullptr;
 }
 
-
 /*
-**	SoundChannel::~SoundChannel()
+**	NewSoundSamples()
 **
-**	destructor
+**	wrap a mapping reference, or a heap copy, in a SoundSamples with one reference
 */
-SoundChannel::~SoundChannel()
+SoundSamples *
+NewSoundSamples( DTSFileMapping * mapping, uchar * copy )
 {
-	// if we still have a source sound, tell it we're gone
-	if ( mSource )
-		mSource->sndChannel = nullptr;
-	
-	// unlink ourselves from root
-	Remove( gRootChannel );
-	
-	// get rid of the AudioQueue
-	if ( mQueue )
+	SoundSamples * samples = NEW_TAG("SoundSamples") SoundSamples;
+	if ( samples )
 		{
-		Stop();		// just in case
-		__Verify_noErr( AudioQueueDispose( mQueue, false ) );
+		samples->ssRefCount = 1;
+		samples->ssMapping  = mapping;
+		samples->ssCopy     = copy;
 		}
+	return samples;
 }
 
 
-#if MAC_OS_X_VERSION_MIN_REQUIRED <= MAC_OS_X_VERSION_10_5
 /*
-**	SoundChannel::BufferProc()		[static; not needed for 10.6+]
-**
-**	When this function is called, we merely have to note that the sound has finished.
-**	There's no buffer refilling to be done.
+**	RetainSoundSamples()
 */
 void
-SoundChannel::BufferProc( void * /* ud */, AudioQueueRef inAQ, AudioQueueBufferRef /* inBuf */ )
+RetainSoundSamples( SoundSamples * samples )
 {
-//	SoundChannel * channel = static_cast<SoundChannel *>( ud );
-//	fprintf( stderr, "BufPrc: ch %p, q %p\n", channel, inAQ );
-	
-	// tell the stream to stop
-	__Verify_noErr( AudioQueueStop( inAQ, false ) );
+	if ( samples )
+		__sync_add_and_fetch( &samples->ssRefCount, 1 );
 }
-#endif  // <= 10.5
 
 
 /*
-**	SoundChannel::PropertyListenerProc()		[static]
+**	ReleaseSoundSamples()
 **
-**	a callback invoked whenever a certain queue property changes.
-**	Currently we only register to watch the _IsRunning property
+**	also serves as the mixer voices' release proc, so it may be called on the
+**	audio thread
 */
 void
-SoundChannel::PropertyListenerProc( void * ud, AudioQueueRef inAQ, AudioQueuePropertyID inID )
+ReleaseSoundSamples( void * ud )
 {
-	SoundChannel * channel = static_cast<SoundChannel *>( ud );
+	SoundSamples * samples = static_cast<SoundSamples *>( ud );
+	if ( not samples )
+		return;
 	
-//	__Check( kAudioQueueProperty_IsRunning == inID );
-	if ( kAudioQueueProperty_IsRunning == inID )
+	if ( 0 == __sync_sub_and_fetch( &samples->ssRefCount, 1 ) )
 		{
-		UInt32 isRunning = false;
-		UInt32 size = sizeof isRunning;
-		__Verify_noErr( AudioQueueGetProperty( inAQ, kAudioQueueProperty_IsRunning,
-							&isRunning, &size ) );
-		
-//		fprintf( stderr, "PropListnr: i %p, q %p: %s\n", channel, inAQ,
-//					channel->mStillPlaying ? "running" : "done" );
-		
-//		__Check( inAQ == channel->mQueue );
-		
-		channel->mStillPlaying = (isRunning != 0);
-		
-		// once playback stops, we can calculate the sound's duration
-		if ( not isRunning && channel->mSource )
-			channel->mSource->DidFinishPlayback( channel->mStartedTime );
+		DTS_releasemap( samples->ssMapping );
+		delete[] samples->ssCopy;
+		delete samples;
 		}
 }
 
 
+#pragma mark -
+#pragma mark Output
+
 /*
-**	SoundChannel::CleanupProc()
+**	StartOutput()
 **
-**	EventLoopTimer callback.  This function is called 4x/sec, so long as any
-**	SoundQueues are still actively playing.
-**	We scan the list of SoundQueues, deleting any which are now finished.
-**	If no busy sounds are encountered, then we disable the timer callback.
+**	create the output queue, and get it running, if that hasn't been done already.
+**	It then runs until DTSExitSound(), playing silence when there's nothing to mix.
 */
-void
-SoundChannel::CleanupProc( EventLoopTimerRef /* timer */, void * /* ud */ )
+OSStatus
+StartOutput()
 {
-	// assume they're all done playing
-	bool bAllSoundsDone = true;
+	if ( sOutputRunning )
+		return noErr;
 	
-	// examine each one
-	const SoundChannel * next = nullptr;
-	for ( const SoundChannel * chan = gRootChannel; chan; chan = next )
+	OSStatus err = noErr;
+	if ( not sOutputQueue )
 		{
-		next = chan->linkNext;
+		// 16-bit native-endian stereo, just as the mixer makes it
+		AudioStreamBasicDescription asbd;
+		FillOutASBDForLPCM( asbd,
+			kMixOutputRate,				// sample rate
+			2,							// channels per frame
+			16,							// valid bits per sample
+			16,							// total bits per sample
+			false,						// not float
+			TARGET_RT_BIG_ENDIAN );		// native-endian
 		
-		if ( chan->IsDone() )
+		err = CreateOutputQueue( &asbd );
+		__Check_noErr( err );
+		
+		// prime the buffers
+		for ( int nn = 0; noErr == err && nn < kNumOutputBuffers; ++nn )
 			{
-			// finished sounds need to have their resources reclaimed.
-			// don't allow exceptions to propagate out
-			try
-				{
-				delete chan;
-				}
-			catch ( ... ) {}
+			AudioQueueBufferRef buffer = nullptr;
+			err = AudioQueueAllocateBuffer( sOutputQueue,
+						kOutputBufferFrames * asbd.mBytesPerFrame, &buffer );
+			__Check_noErr( err );
+			
+			if ( noErr == err )
+				FillOutputBuffer( sOutputQueue, buffer );
 			}
-		else
+		
+		if ( noErr != err && sOutputQueue )
 			{
-			// at least one sound is not yet done
-			bAllSoundsDone = false;
+			__Verify_noErr( AudioQueueDispose( sOutputQueue, true ) );
+			sOutputQueue = nullptr;
 			}
 		}
 	
-	// if no sounds are active, then we can put the timer to sleep
-	if ( bAllSoundsDone && sCleanupTimer )
-		__Verify_noErr( SetEventLoopTimerNextFireTime( sCleanupTimer,
-							kEventDurationForever ) );
+	// start playback!
+	if ( noErr == err )
+		{
+		err = AudioQueueStart( sOutputQueue, nullptr );
+		__Check_noErr( err );
+		}
+	
+	sOutputRunning = (noErr == err);
+	
+	return err;
 }
 
 
 /*
-**	SoundChannel::FindChannelForSound()		[static]
+**	StopOutput()
 **
-**	try to look up which SoundChannel is currently assigned to the given DTSSound
+**	stop, synchronously, and dispose of the output queue
 */
-SoundChannel *
-SoundChannel::FindChannelForSound( const DTSSoundPriv * sp )
+void
+StopOutput()
 {
-	for ( SoundChannel * chan = gRootChannel; chan; chan = chan->linkNext )
+	if ( sOutputQueue )
 		{
-		if ( sp == chan->mSource )
-			return chan;
+		__Verify_noErr( AudioQueueStop( sOutputQueue, true ) );
+		__Verify_noErr( AudioQueueDispose( sOutputQueue, true ) );
+		sOutputQueue = nullptr;
 		}
+	sOutputRunning = false;
+}
+
+
+/*
+**	FillOutputBuffer()
+**
+**	mix the next buffer's worth of sound, and send it back to the queue.
+**	Called on the queue's own thread.
+*/
+void
+FillOutputBuffer( AudioQueueRef queue, AudioQueueBufferRef buffer )
+{
+	const UInt32 kBytesPerFrame = 2 * sizeof(int16_t);
+	UInt32 frames = buffer->mAudioDataBytesCapacity / kBytesPerFrame;
 	
-	return nullptr;
+	sMixer.Render( static_cast<int16_t *>( buffer->mAudioData ), frames );
+	buffer->mAudioDataByteSize = frames * kBytesPerFrame;
+#if MAC_OS_X_VERSION_MAX_ALLOWED > MAC_OS_X_VERSION_10_5
+	// this field not present in 10.5 SDK -- weird
+	buffer->mPacketDescriptionCount = 0;
+#endif  // 10.6+
+	
+	__Verify_noErr( AudioQueueEnqueueBuffer( queue, buffer, 0, nullptr ) );
 }
 
 
+#if MAC_OS_X_VERSION_MIN_REQUIRED <= MAC_OS_X_VERSION_10_5
+/*
+**	OutputBufferProc()		[not needed for 10.6+]
+**
+**	the queue is finished with one of our buffers
+*/
+void
+OutputBufferProc( void * /* ud */, AudioQueueRef inAQ, AudioQueueBufferRef inBuf )
+{
+	FillOutputBuffer( inAQ, inBuf );
+}
+#endif  // <= 10.5
+
+
 // deal with __BLOCKS__
 
 #if MAC_OS_X_VERSION_MIN_REQUIRED > MAC_OS_X_VERSION_10_5 && defined( __BLOCKS__ )
 /*
-**	SoundChannel::CreateAudioQueue()
+**	CreateOutputQueue()
 **
 **	encapsulates creation of the AudioQueue
 **	This version, for runtimes known to be 10.6 or higher, avoids the weak-link test
 **	and pre-BLOCKS fallback code path.
 */
 OSStatus
-SoundChannel::CreateAudioQueue( const AudioStreamBasicDescription * asbd )
+CreateOutputQueue( const AudioStreamBasicDescription * asbd )
 {
-	return AudioQueueNewOutputWithDispatchQueue( &mQueue,
+	return AudioQueueNewOutputWithDispatchQueue( &sOutputQueue,
 				asbd,
 				kNilOptions,
-				dispatch_get_global_queue( DISPATCH_QUEUE_PRIORITY_DEFAULT, 0 ),
-				^( AudioQueueRef q, AudioQueueBufferRef /* b */ )
+				dispatch_get_global_queue( DISPATCH_QUEUE_PRIORITY_HIGH, 0 ),
+				^( AudioQueueRef q, AudioQueueBufferRef b )
 					{
-					AudioQueueStop( q, false );
+					FillOutputBuffer( q, b );
 					} );
 }
 
 #else  // < 10.6
 
 /*
-**	SoundChannel::CreateAudioQueue()
+**	CreateOutputQueue()
 **
 **	encapsulates creation of the AudioQueue
 */
 OSStatus
-SoundChannel::CreateAudioQueue( const AudioStreamBasicDescription * asbd )
+CreateOutputQueue( const AudioStreamBasicDescription * asbd )
 {
 	OSStatus result;
 	
@@ -944,13 +1107,13 @@ SoundChannel::CreateAudioQueue( const AudioStreamBasicDescription * asbd )
 	if ( &AudioQueueNewOutputWithDispatchQueue != nullptr )
 		{
 		// same as above
-		result = AudioQueueNewOutputWithDispatchQueue( &mQueue,
+		result = AudioQueueNewOutputWithDispatchQueue( &sOutputQueue,
 					asbd,
 					kNilOptions,
-					dispatch_get_global_queue( DISPATCH_QUEUE_PRIORITY_DEFAULT, 0 ),
-					^( AudioQueueRef q, AudioQueueBufferRef /* b */ )
+					dispatch_get_global_queue( DISPATCH_QUEUE_PRIORITY_HIGH, 0 ),
+					^( AudioQueueRef q, AudioQueueBufferRef b )
 						{
-						AudioQueueStop( q, false );
+						FillOutputBuffer( q, b );
 						} );
 		}
 	else
@@ -959,278 +1122,91 @@ SoundChannel::CreateAudioQueue( const AudioStreamBasicDescription * asbd )
 		// we get here if building on a pre-10.6 SDK, or on a non-Blocks-capable compiler,
 		// or (hopefully, and most importantly) if _running_ under 10.5.
 		result = AudioQueueNewOutput( asbd,				// description
-									 BufferProc,		// buffer-filler callback
-									 this,				// "refcon"
+									 OutputBufferProc,	// buffer-filler callback
+									 nullptr,			// "refcon"
 									 nullptr,			// use default runloop
 									 nullptr,			// i.e. kCFRunLoopCommonModes
 									 kNilOptions,		// no options
-									 &mQueue );			// resultant AudioQueueRef
+									 &sOutputQueue );	// resultant AudioQueueRef
 		}
 	
 	return result;
 }
 #endif  // 10.6+
 
-
-/*
-**	SoundChannel::Play()
-**
-**	given a sound sample buffer (etc.) in 'p', start playing it via an AudioQueue.
-*/
-OSStatus
-SoundChannel::Play( const DTSSoundPriv * p )
-{
-	// rearm the clean-up timer, at 4Hz
-	if ( sCleanupTimer )
-		__Verify_noErr( SetEventLoopTimerNextFireTime( sCleanupTimer, 0.25 ) );
-	
-	// create our AudioQueue
-	OSStatus err = CreateAudioQueue( &p->sndDesc );
-	__Check_noErr( err );
-	
-	// allocate the queue's sole buffer
-	if ( noErr == err )
-		{
-		err = AudioQueueAllocateBuffer( mQueue, p->sndLen, &mBuffer );
-		__Check_noErr( err );
-		}
-	
-	// fill the buffer with the sample data
-	if ( noErr == err )
-		{
-		// paranoia
-		__Check( mBuffer->mAudioDataBytesCapacity >= p->sndLen );
-		
-		memcpy( mBuffer->mAudioData, p->sndBytes, p->sndLen );
-		mBuffer->mAudioDataByteSize = p->sndLen;
-		
-#if MAC_OS_X_VERSION_MAX_ALLOWED > MAC_OS_X_VERSION_10_5
-		// this field not present in 10.5 SDK -- weird
-		mBuffer->mPacketDescriptionCount = 0;
-#endif  // 10.6+
-		
-		// queue it up
-		err = AudioQueueEnqueueBuffer( mQueue, mBuffer, 0, nullptr );
-		__Check_noErr( err );
-		}
-	
-	// install our is-done property listener, so we know when the sound finishes
-	if ( noErr == err )
-		{
-		err = AudioQueueAddPropertyListener( mQueue,
-					kAudioQueueProperty_IsRunning, PropertyListenerProc, this );
-		__Check_noErr( err );
-		}
-	
-	// set the volume
-	if ( noErr == err )
-		{
-		err = AudioQueueSetParameter( mQueue, kAudioQueueParam_Volume, sDefaultVolume );
-		__Check_noErr( err );
-		}
-	
-	// start playback!
-	mStartedTime = CFAbsoluteTimeGetCurrent();
-	if ( noErr == err )
-		{
-		err = AudioQueueStart( mQueue, nullptr );
-//		__Check_noErr( err );
-		}
-	
-	// if all the above worked, great: we're off and running. Otherwise, let's at least
-	// mark this SoundChannel as being deletable by the CleanupProc routine.
-	mStillPlaying = (noErr == err);
-	
-	return err;
-}
+#pragma mark -
+#pragma mark DTSSound
 
 
 /*
-**	SoundChannel::Stop()
+**	DTSSound::Init()
 **
-**	stop a currently-playing sound queue.
+**	Load a sound from memory, which is expected to conform to the structure of
+**	a 'snd ' resource, in standard (big-endian) orientation.
 */
-OSStatus
-SoundChannel::Stop()
+DTSError
+DTSSound::Init( const void * ptr, size_t len )
 {
-	OSStatus result = noErr;
-	if ( mQueue && mStillPlaying )
-		{
-		// this is an async stop, since that makes the coding easier (no need
-		// to call AudioQueueFlush before AudioQueueStop).
-		// Should we support synchronous stops too?
-		result = AudioQueueStop( mQueue, false );
-		__Check_noErr( result );
-//		mStillPlaying = false;	// the listener proc will do this, at the right time
-		}
+	if ( DTSSoundPriv * p = priv.p )
+		return p->Init( static_cast<const uchar *>( ptr ), len );
 	
-	return result;
+	return -1;
 }
 
 
 /*
-**	SoundChannel::IsDone()
+**	DTSSound::Init()
 **
-**	test whether or not this channel is currently emitting a sound
+**	Prepare to play a 'snd ' record directly from a keyfile opened read-only.
+**	The samples are never copied into memory of our own; the mixer reads them
+**	straight from a mapping of the file.
 */
-bool
-SoundChannel::IsDone() const
+DTSError
+DTSSound::Init( DTSKeyFile * file, DTSKeyType type, DTSKeyID id )
 {
-	if ( mQueue )
-		return not mStillPlaying;
+	__Check( file );
+	if ( not file )
+		return paramErr;
 	
-	return true;	// ? never been queued; does that count as "done"?
-}
-
-
-/*
-**	SoundChannel::SetVolume()
-**
-**	change the volume of a currently-playing sound
-*/
-OSStatus
-SoundChannel::SetVolume( Float32 newVolume )
-{
-	OSStatus result = noErr;
-	if ( mQueue && mStillPlaying )
-		{
-		result = AudioQueueSetParameter( mQueue, kAudioQueueParam_Volume, newVolume );
-		__Check_noErr( result );
-		}
-	return result;
-}
-
-
-// static "entry" points, accessed via non-class functions in Sound_dts.h
-
-/*
-**	SoundChannel::Init()		[static]
-**
-**	install the cleanup timer.
-*/
-OSStatus
-SoundChannel::Init()
-{
-	// it's initially disabled, but will recur at 4Hz when/if re-enabled
-	OSStatus err = InstallEventLoopTimer( GetMainEventLoop(),
-						kEventDurationForever,
-						0.25,
-						CleanupProc,
-						nullptr,
-						&sCleanupTimer );
-	__Check_noErr( err );
-	return err;
-}
-
-
-/*
-**	SoundChannel::Exit()		[static]
-**
-**	disable & remove the cleanup timer, and mop up any remaining sounds
-*/
-void
-SoundChannel::Exit()
-{
-	if ( sCleanupTimer )
-		{
-		__Verify_noErr( SetEventLoopTimerNextFireTime( sCleanupTimer,
-							kEventDurationForever ) );
-		__Verify_noErr( RemoveEventLoopTimer( sCleanupTimer ) );
-		sCleanupTimer = nullptr;
-		}
+	if ( DTSSoundPriv * p = priv.p )
+		return p->Init( file, type, id );
 	
-	DeleteLinkedList( gRootChannel );
+	return -1;
 }
 
 
 /*
-**	SoundChannel::SetAllVolumes()		[static]
+**	DTSSound::Play()
 **
-**	change the volume of all currently-playing sounds
+**	start playing the sound, on a mixer voice.
+**	There are only as many voices as set by DTSInitSound(); if they're all busy,
+**	the oldest sound is cut off to make room for this one.
+**	
+**	I didn't bother to re-implement the old DTSSound's ability to play looping sounds,
+**	via the 'bContinuous' argument, since the CL client has no need for that feature.
 */
 void
-SoundChannel::SetAllVolumes( Float32 volume )
-{
-	for ( SoundChannel * channel = gRootChannel; channel; channel = channel->linkNext )
-		channel->SetVolume( volume );
-}
-
-#pragma mark -
-#pragma mark DTSSound
-
-
-/*
-**	DTSSound::Init()
-**
-**	Load a sound from memory, which is expected to conform to the structure of
-**	a 'snd ' resource, in standard (big-endian) orientation.
-*/
-DTSError
-DTSSound::Init( const void * ptr, size_t len )
+DTSSound::Play()
 {
 	if ( DTSSoundPriv * p = priv.p )
-		return p->Init( static_cast<const uchar *>( ptr ), len );
-	
-	return -1;
+		(void) p->Play();
 }
 
 
 /*
 **	DTSSound::Play()
 **
-**	start playing the sound, on a newly-allocated sound channel.
-**	Don't allocate more channels than the maximum, as set by DTSInitSound().
-**	If no more channels are permitted, nothing gets played. (This is not an error.)
-**	
-**	[However... Do we really need to honor that limit? Why not play every sound we're asked
-**	to emit?  Are there cases where the CL client tries to play many, many sounds simultaneously?]
-**
-**	I didn't bother to re-implement the old DTSSound's ability to play looping sounds,
-**	via the 'bContinuous' argument, since the CL client has no need for that feature.
+**	Init() from the keyfile record, then Play().
+**	Any earlier playback of this DTSSound is left to finish on its own voice.
 */
-void
-DTSSound::Play()
+DTSError
+DTSSound::Play( DTSKeyFile * file, DTSKeyType type, DTSKeyID id )
 {
-	DTSSoundPriv * p = priv.p;
-	if ( not p )
-		return;
-	
-	// it turn out that if we reject duplicate sounds (by enabling this next section),
-	// then if you visit "noisy" environments in the client (lots of repeated/recurring
-	// sounds), there'll be a lot of unwanted sound drop-outs.
-	// Playing _all_ sounds, as requested -- even dupes -- seems to cure the dropout problem.
-#if 0
-	// are we already being played?
-	if ( SoundChannel::FindChannelForSound( p ) )
-		{
-# ifdef DEBUG_VERSION
-		fprintf( stderr, "Not playing sound: duplicate\n" );
-# endif
-		return;
-		}
-#endif
-	
-	// don't play too many sounds at the same time
-	int numInUse = SoundChannel::NumInUse();
-	if ( numInUse >= sMaxSounds )
-		{
-#if 0 && defined( DEBUG_VERSION )
-		// suggest maybe raising the channel limit
-		fprintf( stderr, "too many sounds: only %d allowed\n", sMaxSounds );
-#endif
-		return;	// comment this line out if we decide to not actually honor the limit
-		}
+	DTSError result = Init( file, type, id );
+	if ( noErr == result )
+		Play();
 	
-	// allocate a new SoundChannel to play on. The channel will be reclaimed, once it's done
-	// playing, by the channel's timer function
-	if ( SoundChannel * chan = NEW_TAG("SoundChannel") SoundChannel( p ) )
-		{
-		// remember it
-		p->sndChannel = chan;
-		
-		// make it go
-		(void) chan->Play( p );
-		}
+	return result;
 }
 
 
@@ -1243,8 +1219,7 @@ void
 DTSSound::Stop()
 {
 	if ( DTSSoundPriv * p = priv.p )
-		if ( SoundChannel * channel = p->sndChannel )
-			channel->Stop();
+		sMixer.Stop( p->sndVoice );
 }
 
 
@@ -1257,11 +1232,10 @@ bool
 DTSSound::IsDone() const
 {
 	if ( const DTSSoundPriv * p = priv.p )
-		if ( const SoundChannel * channel = p->sndChannel )
-			return channel->IsDone();
+		return not sMixer.IsPlaying( p->sndVoice );
 	
 	// this sound never started being played
-	// or else it has already completed and its queue's been disposed of.
+	// or else it has already completed.
 	// Either way, it's assuredly not still running.
 	return true;
 }